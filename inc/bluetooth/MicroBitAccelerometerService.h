@@ -31,6 +31,13 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitAccelerometer.h"
 #include "EventModel.h"
 
+// The largest number of samples that can be packed into one notification in streaming mode:
+// a 2 byte timestamp and 3 samples of 6 bytes fill the default 20 byte ATT payload.
+#define MICROBIT_ACCELEROMETER_SERVICE_MAX_SAMPLES      3
+
+// The size of the data characteristic, in 16 bit words.
+#define MICROBIT_ACCELEROMETER_SERVICE_DATA_WORDS       (1 + 3 * MICROBIT_ACCELEROMETER_SERVICE_MAX_SAMPLES)
+
 // UUIDs for our service and characteristics
 extern const uint8_t  MicroBitAccelerometerServiceUUID[];
 extern const uint8_t  MicroBitAccelerometerServiceDataUUID[];
@@ -53,6 +60,26 @@ class MicroBitAccelerometerService
       */
     MicroBitAccelerometerService(BLEDevice &_ble, MicroBitAccelerometer &_acclerometer);
 
+    /**
+      * Configures how accelerometer samples are delivered via Bluetooth.
+      *
+      * By default, every sample is notified as it is taken, as 3 signed 16 bit values (x, y, z).
+      * In streaming mode, several samples are instead packed into each notification, preceded by a 16 bit
+      * timestamp: the low 16 bits of system time (in milliseconds) at which the first sample was taken.
+      * The following samples are each period * decimation milliseconds apart.
+      *
+      * @param samples The number of samples per notification, from 1 to MICROBIT_ACCELEROMETER_SERVICE_MAX_SAMPLES,
+      *        or 0 to return to the default format.
+      *
+      * @param decimation Only one of every this many samples is sent. Defaults to 1.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if either value is out of range.
+      *
+      * @note If the Bluetooth stack has no room for a notification, it is dropped rather than queued,
+      *       so a slow link reduces the sample rate rather than delaying samples.
+      */
+    int setStreaming(int samples, int decimation = 1);
+
 
     private:
 
@@ -71,9 +98,17 @@ class MicroBitAccelerometerService
 	MicroBitAccelerometer	&accelerometer;
 
     // memory for our 8 bit control characteristics.
-    uint16_t            accelerometerDataCharacteristicBuffer[3];
+    uint16_t            accelerometerDataCharacteristicBuffer[MICROBIT_ACCELEROMETER_SERVICE_DATA_WORDS];
     uint16_t            accelerometerPeriodCharacteristicBuffer;
 
+    // streaming configuration: samples per notification (0 if not streaming), and the decimation rate.
+    uint8_t             streamSamples;
+    uint8_t             streamDecimation;
+
+    // the number of samples skipped since the last one used, and the number held in our buffer.
+    uint8_t             decimationCount;
+    uint8_t             sampleCount;
+
     // Handles to access each characteristic when they are held by Soft Device.
     GattAttribute::Handle_t accelerometerDataCharacteristicHandle;
     GattAttribute::Handle_t accelerometerPeriodCharacteristicHandle;
@@ -54,6 +54,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitLEDService.h"
 #include "MicroBitAccelerometerService.h"
 #include "MicroBitMagnetometerService.h"
+#include "MicroBitSensorService.h"
 #include "MicroBitButtonService.h"
 #include "MicroBitIOPinService.h"
 #include "MicroBitTemperatureService.h"
@@ -77,9 +78,34 @@ DEALINGS IN THE SOFTWARE.
 // MicroBitComponent status flags
 #define MICROBIT_BLE_STATUS_STORE_SYSATTR       0x02
 #define MICROBIT_BLE_STATUS_DISCONNECT          0x04
+#define MICROBIT_BLE_STATUS_ROTATING            0x08
+
+// Core services brought up by MicroBitBLEManager, if compiled in. See setServices().
+#define MICROBIT_BLE_SERVICE_DFU                    0x01
+#define MICROBIT_BLE_SERVICE_DEVICE_INFORMATION     0x02
+#define MICROBIT_BLE_SERVICE_EVENT                  0x04
+
+#define MICROBIT_BLE_DEFAULT_SERVICES   ((CONFIG_ENABLED(MICROBIT_BLE_DFU_SERVICE) ? MICROBIT_BLE_SERVICE_DFU : 0) | \
+                                         (CONFIG_ENABLED(MICROBIT_BLE_DEVICE_INFORMATION_SERVICE) ? MICROBIT_BLE_SERVICE_DEVICE_INFORMATION : 0) | \
+                                         (CONFIG_ENABLED(MICROBIT_BLE_EVENT_SERVICE) ? MICROBIT_BLE_SERVICE_EVENT : 0))
+
+// Types of precomputed advertising frame.
+#define MICROBIT_BLE_FRAME_STATIC               0       // Advertised as precomputed.
+#define MICROBIT_BLE_FRAME_TLM                  1       // Recomputed each time it is advertised.
 
 extern const int8_t MICROBIT_BLE_POWER_LEVEL[];
 
+/**
+  * Connection parameter profiles that may be requested of the connected central device.
+  * Each trades data throughput and latency against power consumption.
+  */
+enum MicroBitBLEConnectionProfile
+{
+    MICROBIT_BLE_PROFILE_THROUGHPUT,    // 10-20 ms connection interval, no slave latency. Best for bulk transfers.
+    MICROBIT_BLE_PROFILE_BALANCED,      // 30-50 ms connection interval, no slave latency.
+    MICROBIT_BLE_PROFILE_LOW_POWER      // 100-200 ms connection interval, and the micro:bit may skip 4 connection events when idle.
+};
+
 struct BLESysAttribute
 {
     uint8_t sys_attr[8];
@@ -151,6 +177,44 @@ class MicroBitBLEManager : MicroBitComponent
       */
     void init(ManagedString deviceName, ManagedString serialNumber, EventModel &messageBus, bool enableBonding);
 
+    /**
+      * Selects the core services brought up by init(). Services that are not selected cost neither
+      * RAM nor space in the GATT table, and are not initialised at startup.
+      *
+      * @param services A bitmask of MICROBIT_BLE_SERVICE_DFU, MICROBIT_BLE_SERVICE_DEVICE_INFORMATION and
+      *        MICROBIT_BLE_SERVICE_EVENT. Services not compiled in are ignored. Defaults to MICROBIT_BLE_DEFAULT_SERVICES.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if init() has already been called.
+      *
+      * @code
+      * // Keep over the air programming, but nothing else.
+      * bleManager.setServices(MICROBIT_BLE_SERVICE_DFU);
+      * bleManager.init(uBit.getName(), uBit.getSerial(), uBit.messageBus, true);
+      * @endcode
+      */
+    int setServices(uint8_t services);
+
+    /**
+      * Brings up the given core services, if they are not already running. Before init(), this adds
+      * to the services that init() brings up. Afterwards, the services are instantiated immediately.
+      *
+      * @param services A bitmask of MICROBIT_BLE_SERVICE_DFU, MICROBIT_BLE_SERVICE_DEVICE_INFORMATION and
+      *        MICROBIT_BLE_SERVICE_EVENT. Services not compiled in are ignored.
+      *
+      * @return MICROBIT_OK on success.
+      *
+      * @note Central devices often cache the services of a device they have connected to, so services
+      *       added after a device has connected may not be seen by it.
+      */
+    int enableServices(uint8_t services);
+
+    /**
+      * Determines which core services are running.
+      *
+      * @return A bitmask of MICROBIT_BLE_SERVICE_DFU, MICROBIT_BLE_SERVICE_DEVICE_INFORMATION and MICROBIT_BLE_SERVICE_EVENT.
+      */
+    uint8_t getServices();
+
     /**
      * Change the output power level of the transmitter to the given value.
      *
@@ -165,6 +229,55 @@ class MicroBitBLEManager : MicroBitComponent
      */
     int setTransmitPower(int power);
 
+    /**
+     * Requests that the connected central device use connection parameters from the given profile.
+     * The profile is also used as our preferred parameters for any future connections, and may be set before init().
+     *
+     * The central device chooses the parameters actually used. Those granted at connection are
+     * reported with a MICROBIT_BLE_EVT_CONNECTION_PARAMS event, and can be read with getConnectionParams().
+     *
+     * @param profile One of MICROBIT_BLE_PROFILE_THROUGHPUT, MICROBIT_BLE_PROFILE_BALANCED or MICROBIT_BLE_PROFILE_LOW_POWER.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the profile is not recognised, or MICROBIT_NOT_SUPPORTED
+     *         if the Bluetooth stack refused the request.
+     *
+     * @code
+     * // about to send lots of data...
+     * bleManager.setConnectionProfile(MICROBIT_BLE_PROFILE_THROUGHPUT);
+     * @endcode
+     */
+    int setConnectionProfile(MicroBitBLEConnectionProfile profile);
+
+    /**
+     * Determines the connection parameter profile most recently requested.
+     *
+     * @return The current profile.
+     */
+    MicroBitBLEConnectionProfile getConnectionProfile();
+
+    /**
+     * Reads the connection parameters granted by the connected central device.
+     *
+     * @param params The structure to populate with the connection parameters. Intervals are in units of 1.25 ms,
+     *        and the supervision timeout in units of 10 ms.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack has not been initialised,
+     *         or MICROBIT_NO_DATA if no device is connected.
+     */
+    int getConnectionParams(Gap::ConnectionParams_t &params);
+
+    /**
+     * Records the connection parameters granted by the central device, and raises a
+     * MICROBIT_BLE_EVT_CONNECTION_PARAMS event.
+     *
+     * @param handle The handle of the connection.
+     *
+     * @param params The parameters in use on the connection.
+     *
+     * @note for internal use only.
+     */
+    void connectionParamsGranted(Gap::Handle_t handle, const Gap::ConnectionParams_t *params);
+
     /**
      * Enter pairing mode. This is mode is called to initiate pairing, and to enable FOTA programming
      * of the micro:bit in cases where BLE is disabled during normal operation.
@@ -210,7 +323,8 @@ class MicroBitBLEManager : MicroBitComponent
 
     /**
      * Periodic callback in thread context.
-     * We use this here purely to safely issue a disconnect operation after a pairing operation is complete.
+     * We use this here to safely issue a disconnect operation after a pairing operation is complete,
+     * and to move on to the next advertising frame when rotating between them.
 	 */
     void idleTick();
 
@@ -281,7 +395,106 @@ class MicroBitBLEManager : MicroBitComponent
     int advertiseEddystoneUid(const char* uid_namespace, const char* uid_instance, int8_t calibratedPower = MICROBIT_BLE_EDDYSTONE_DEFAULT_POWER, bool connectable = true, uint16_t interval = MICROBIT_BLE_EDDYSTONE_ADV_INTERVAL);
 #endif
 
+#if MICROBIT_BLE_ADVERTISING_SLOTS > 0
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_URL)
+    /**
+      * Precomputes an Eddystone URL frame, and adds it to those advertised by rotateAdvertising().
+      *
+      * @param url The url to broadcast
+      *
+      * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the url is empty,
+      *         or MICROBIT_NO_RESOURCES if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+      */
+    int addEddystoneUrlFrame(const char *url, int8_t calibratedPower = MICROBIT_BLE_EDDYSTONE_DEFAULT_POWER);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_UID)
+    /**
+      * Precomputes an Eddystone UID frame, and adds it to those advertised by rotateAdvertising().
+      *
+      * @param uid_namespace: the uid namespace. Must 10 bytes long.
+      *
+      * @param uid_instance:  the uid instance value. Must 6 bytes long.
+      *
+      * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if either id is NULL,
+      *         or MICROBIT_NO_RESOURCES if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+      */
+    int addEddystoneUidFrame(const char* uid_namespace, const char* uid_instance, int8_t calibratedPower = MICROBIT_BLE_EDDYSTONE_DEFAULT_POWER);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_TLM)
+    /**
+      * Adds an Eddystone TLM (telemetry) frame to those advertised by rotateAdvertising(). Its temperature,
+      * advertising count and uptime are brought up to date each time it is advertised.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+      */
+    int addEddystoneTlmFrame();
+#endif
+
+    /**
+      * Removes all the frames added for rotateAdvertising(), and stops rotating between them.
+      * Any current advertising continues with the frame last advertised, until stopAdvertising() is called.
+      */
+    void clearAdvertisingFrames();
+
+    /**
+      * Begins advertising the precomputed frames in turn, moving to the next one every period milliseconds.
+      * Each change of frame is a single call to the BLE stack, made from the idle thread.
+      *
+      * @param period the time to advertise each frame for, in milliseconds.
+      *
+      * @param connectable true to keep bluetooth connectable for other services, false otherwise. (Defaults to false)
+      *
+      * @param interval the interval between advertising packets, in milliseconds. Longer intervals save power,
+      *        at the cost of discoverability. (Defaults to MICROBIT_BLE_EDDYSTONE_ADV_INTERVAL)
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if period is 0 or no frames have been added.
+      *
+      * @code
+      * bleManager.addEddystoneUrlFrame("https://microbit.org");
+      * bleManager.addEddystoneTlmFrame();
+      * bleManager.rotateAdvertising(1000);
+      * @endcode
+      */
+    int rotateAdvertising(uint16_t period, bool connectable = false, uint16_t interval = MICROBIT_BLE_EDDYSTONE_ADV_INTERVAL);
+#endif
+
   private:
+
+    /**
+      * Instantiates any selected core services that are not yet running.
+      */
+    void startServices();
+
+#if MICROBIT_BLE_ADVERTISING_SLOTS > 0
+    /**
+      * Claims the next free advertising frame, and initialises it with the flags common to all frames.
+      *
+      * @param type The type of the frame, MICROBIT_BLE_FRAME_STATIC or MICROBIT_BLE_FRAME_TLM.
+      *
+      * @return The frame, or NULL if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+      */
+    GapAdvertisingData *newAdvertisingFrame(uint8_t type);
+
+    /**
+      * Hands the current advertising frame to the BLE stack, recomputing it first if necessary, and
+      * schedules the next change of frame.
+      */
+    void showAdvertisingFrame();
+
+    GapAdvertisingData advertisingFrames[MICROBIT_BLE_ADVERTISING_SLOTS];   // The precomputed frames.
+    uint8_t advertisingFrameTypes[MICROBIT_BLE_ADVERTISING_SLOTS];          // The type of each frame.
+    uint8_t advertisingFrameCount;                                          // The number of frames in use.
+    uint8_t advertisingFrameIndex;                                          // The frame currently advertised.
+    uint16_t advertisingPeriod;                                             // The time to advertise each frame for (ms).
+    uint16_t advertisingInterval;                                           // The interval between advertising packets (ms).
+    uint32_t advertisingFrameTime;                                          // The time the current frame was shown (ms).
+#endif
     /**
 	* Displays the device's ID code as a histogram on the provided MicroBitDisplay instance.
     *
@@ -294,7 +507,16 @@ class MicroBitBLEManager : MicroBitComponent
 
     int pairingStatus;
     ManagedString passKey;
+
+    MicroBitBLEConnectionProfile connectionProfile;     // The profile most recently requested.
+    Gap::Handle_t connectionHandle;                     // The handle of the current connection, if any.
+    Gap::ConnectionParams_t connectionParams;           // The parameters granted on the current connection.
     ManagedString deviceName;
+
+    uint8_t services;                                   // The core services selected.
+    uint8_t servicesRunning;                            // The core services instantiated so far.
+    EventModel *messageBus;                             // The EventModel given to init(), used by the event service.
+    ManagedString serialNumber;                         // The serial number given to init(), used by the device information service.
 };
 
 #endif
@@ -73,6 +73,21 @@ class MicroBitEddystone
       */
     int setURL(BLEDevice* ble, ManagedString url, int8_t calibratedPower = 0xF0);
 
+    /**
+      * Adds an Eddystone URL frame to the given advertising data, such that it may be precomputed and
+      * later advertised with a single call to the BLE stack.
+      *
+      * @param data The advertising data to add the frame to.
+      *
+      * @param url The url to broadcast
+      *
+      * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+      *
+      * @note The calibratedPower value ranges from -100 to +20 to a resolution of 1. The calibrated power should be binary encoded.
+      * More information can be found at https://github.com/google/eddystone/tree/master/eddystone-uid#tx-power
+      */
+    int setURL(GapAdvertisingData &data, const char *url, int8_t calibratedPower = 0xF0);
+
 #endif
 
 #if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_UID)
@@ -89,10 +104,80 @@ class MicroBitEddystone
       * More information can be found at https://github.com/google/eddystone/tree/master/eddystone-uid#tx-power
       */
     int setUID(BLEDevice* ble, const char* uid_namespace, const char* uid_instance, int8_t calibratedPower = 0xF0);
+
+    /**
+      * Adds an Eddystone UID frame to the given advertising data, such that it may be precomputed and
+      * later advertised with a single call to the BLE stack.
+      *
+      * @param data The advertising data to add the frame to.
+      *
+      * @param uid_namespace the uid namespace. Must 10 bytes long.
+      *
+      * @param uid_instance  the uid instance value. Must 6 bytes long.
+      *
+      * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+      *
+      * @note The calibratedPower value ranges from -100 to +20 to a resolution of 1. The calibrated power should be binary encoded.
+      * More information can be found at https://github.com/google/eddystone/tree/master/eddystone-uid#tx-power
+      */
+    int setUID(GapAdvertisingData &data, const char* uid_namespace, const char* uid_instance, int8_t calibratedPower = 0xF0);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_TLM)
+    /**
+      * Adds an unencrypted Eddystone TLM (telemetry) frame to the given advertising data.
+      *
+      * @param data The advertising data to add the frame to.
+      *
+      * @param batteryVoltage The battery voltage in millivolts, or 0 if unknown.
+      *
+      * @param temperature The temperature in degrees Celsius, as an 8.8 fixed point value, or -128 (0x8000) if unknown.
+      *
+      * @param advertisingCount The number of advertising frames sent since power on.
+      *
+      * @param uptime The time since power on, in units of 0.1 seconds.
+      *
+      * @return MICROBIT_OK on success.
+      *
+      * @note More information can be found at https://github.com/google/eddystone/tree/master/eddystone-tlm
+      */
+    int setTLM(GapAdvertisingData &data, uint16_t batteryVoltage, int16_t temperature, uint32_t advertisingCount, uint32_t uptime);
 #endif
 
   private:
 
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_URL)
+    /**
+      * Encodes the service data of an Eddystone URL frame.
+      *
+      * @param rawFrame The buffer to encode into. Must be at least EDDYSTONE_URL_MAX_LENGTH + 4 bytes long.
+      *
+      * @param url The url to broadcast
+      *
+      * @param calibratedPower the transmission range of the beacon.
+      *
+      * @return The length of the frame, or MICROBIT_INVALID_PARAMETER if the url is empty.
+      */
+    static int encodeURL(uint8_t *rawFrame, const char *url, int8_t calibratedPower);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_UID)
+    /**
+      * Encodes the service data of an Eddystone UID frame.
+      *
+      * @param rawFrame The buffer to encode into. Must be at least 20 bytes long.
+      *
+      * @param uid_namespace the uid namespace. Must 10 bytes long.
+      *
+      * @param uid_instance  the uid instance value. Must 6 bytes long.
+      *
+      * @param calibratedPower the transmission range of the beacon.
+      *
+      * @return The length of the frame, or MICROBIT_INVALID_PARAMETER if either id is NULL.
+      */
+    static int encodeUID(uint8_t *rawFrame, const char* uid_namespace, const char* uid_instance, int8_t calibratedPower);
+#endif
+
     /**
       * Private constructor.
       */
@@ -37,6 +37,10 @@ extern const uint8_t  MicroBitEventServiceMicroBitEventCharacteristicUUID[];
 extern const uint8_t  MicroBitEventServiceClientEventCharacteristicUUID[];
 extern const uint8_t  MicroBitEventServiceMicroBitRequirementsCharacteristicUUID[];
 extern const uint8_t  MicroBitEventServiceClientRequirementsCharacteristicUUID[];
+extern const uint8_t  MicroBitEventServiceClientRateLimitCharacteristicUUID[];
+
+// The largest number of events sent in one notification: five events fill the default 20 byte ATT payload.
+#define MICROBIT_EVENT_SERVICE_MAX_EVENTS       5
 
 struct EventServiceEvent
 {
@@ -44,6 +48,12 @@ struct EventServiceEvent
     uint16_t    reason;
 };
 
+struct EventServiceRateLimit
+{
+    uint16_t    type;
+    uint16_t    interval;
+};
+
 
 /**
   * Class definition for a MicroBit BLE Event Service.
@@ -84,22 +94,64 @@ class MicroBitEventService : public MicroBitComponent
       */
     void onRequirementsRead(GattReadAuthCallbackParams *params);
 
+    /**
+      * Sends any queued events to the client, as many to each notification as will fit.
+      *
+      * If the Bluetooth stack has no room for a notification, the remaining events are kept, and sent on a later idle tick.
+      */
+    void flush();
+
     private:
 
+    /**
+      * Determines if an event from the given source should be dropped, due to a rate limit set by the client.
+      *
+      * @param type The source of the event.
+      *
+      * @return true if the event should be dropped, false otherwise.
+      */
+    bool isRateLimited(uint16_t type);
+
+    /**
+      * Sets, or clears, the minimum interval between events sent from a given source.
+      *
+      * @param type The source to limit.
+      *
+      * @param interval The minimum time between events from this source, in milliseconds, or 0 to remove the limit.
+      */
+    void setRateLimit(uint16_t type, uint16_t interval);
+
+    /**
+      * Called by fiber_defer() to send the events queued by onMicroBitEvent().
+      */
+    static void flushDeferred(void *service);
+
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
 	EventModel	        &messageBus;
 
     // memory for our event characteristics.
     EventServiceEvent   clientEventBuffer;
-    EventServiceEvent   microBitEventBuffer;
+    EventServiceEvent   microBitEventBuffer[MICROBIT_EVENT_SERVICE_MAX_EVENTS];
     EventServiceEvent   microBitRequirementsBuffer;
     EventServiceEvent   clientRequirementsBuffer;
+    EventServiceRateLimit clientRateLimitBuffer;
+
+    // events waiting to be notified, held as a ring buffer.
+    EventServiceEvent   eventQueue[MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE];
+    volatile uint8_t    eventQueueHead;
+    volatile uint8_t    eventQueueLength;
+    volatile bool       flushPending;
+
+    // the rate limits set by the client, and when an event from each source was last queued.
+    EventServiceRateLimit rateLimits[MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS];
+    uint32_t            rateLimitLastEvent[MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS];
 
     // handles on this service's characterisitics.
     GattAttribute::Handle_t microBitEventCharacteristicHandle;
     GattAttribute::Handle_t clientRequirementsCharacteristicHandle;
     GattAttribute::Handle_t clientEventCharacteristicHandle;
+    GattAttribute::Handle_t clientRateLimitCharacteristicHandle;
     GattCharacteristic *microBitRequirementsCharacteristic;
 
     // Message bus offset last sent to the client...
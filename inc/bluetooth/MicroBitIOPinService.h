@@ -29,10 +29,12 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "ble/BLE.h"
 #include "MicroBitIO.h"
+#include "EventModel.h"
 
 #define MICROBIT_IO_PIN_SERVICE_PINCOUNT       19
 #define MICROBIT_IO_PIN_SERVICE_DATA_SIZE      10
 #define MICROBIT_PWM_PIN_SERVICE_DATA_SIZE     2
+#define MICROBIT_IO_PIN_SERVICE_SAMPLING_SIZE  5
 
 // UUIDs for our service and characteristics
 extern const uint8_t  MicroBitIOPinServiceUUID[];
@@ -40,6 +42,7 @@ extern const uint8_t  MicroBitIOPinServiceADConfigurationUUID[];
 extern const uint8_t  MicroBitIOPinServiceIOConfigurationUUID[];
 extern const uint8_t  MicroBitIOPinServicePWMControlUUID[];
 extern const uint8_t  MicroBitIOPinServiceDataUUID[];
+extern const uint8_t  MicroBitIOPinServiceSamplingUUID[];
 extern MicroBitPin * const MicroBitIOPins[];
 
 /**
@@ -61,6 +64,17 @@ struct IOPWMData
     uint32_t    period;
 } __attribute__((packed));
 
+/**
+  * Sampling control type definition, as used to set how often an analog input is read over BLE,
+  * and how much it must change by before a notification is sent.
+  */
+struct IOSamplingData
+{
+    uint8_t     pin;
+    uint8_t     deadband;
+    uint16_t    period;
+} __attribute__((packed));
+
 /**
   * Class definition for the custom MicroBit IOPin Service.
   * Provides a BLE service to remotely read the state of the I/O Pin, and configure its behaviour.
@@ -132,6 +146,21 @@ class MicroBitIOPinService : public MicroBitComponent
       */
     int isOutput(int i);
 
+    /**
+      * Places each pin into the mode selected by the BLE configuration characteristics.
+      *
+      * Digital inputs are configured to raise events on each rising and falling edge, so that they need only be
+      * read when they change. Analog inputs are read periodically, from idleTick().
+      */
+    void configurePins();
+
+    /**
+      * Callback. Invoked when a pin raises a rise or fall event.
+      *
+      * Marks our digital inputs as needing to be read on the next idle tick.
+      */
+    void onPinEvent(MicroBitEvent evt);
+
 
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
@@ -142,14 +171,25 @@ class MicroBitIOPinService : public MicroBitComponent
     uint32_t            ioPinServiceIOCharacteristicBuffer;
     IOPWMData           ioPinServicePWMCharacteristicBuffer[MICROBIT_PWM_PIN_SERVICE_DATA_SIZE];
     IOData              ioPinServiceDataCharacteristicBuffer[MICROBIT_IO_PIN_SERVICE_DATA_SIZE];
+    IOSamplingData      ioPinServiceSamplingCharacteristicBuffer[MICROBIT_IO_PIN_SERVICE_SAMPLING_SIZE];
 
     // Historic information about our pin data data.
-    uint8_t             ioPinServiceIOData[MICROBIT_IO_PIN_SERVICE_PINCOUNT];
+    uint16_t            ioPinServiceIOData[MICROBIT_IO_PIN_SERVICE_PINCOUNT];
+
+    // Sampling period (in milliseconds) and deadband for each analog input, and when each was last read.
+    uint16_t            ioPinServiceSamplePeriod[MICROBIT_IO_PIN_SERVICE_PINCOUNT];
+    uint8_t             ioPinServiceDeadband[MICROBIT_IO_PIN_SERVICE_PINCOUNT];
+    uint32_t            ioPinServiceLastSample[MICROBIT_IO_PIN_SERVICE_PINCOUNT];
+
+    // Bitmap of the digital inputs currently raising edge events, and whether any have raised one since last read.
+    uint32_t            ioPinServiceEdgePins;
+    bool                ioPinServiceEdgeSeen;
 
     // Handles to access each characteristic when they are held by Soft Device.
     GattAttribute::Handle_t ioPinServiceADCharacteristicHandle;
     GattAttribute::Handle_t ioPinServiceIOCharacteristicHandle;
     GattAttribute::Handle_t ioPinServicePWMCharacteristicHandle;
+    GattAttribute::Handle_t ioPinServiceSamplingCharacteristicHandle;
     GattCharacteristic *ioPinServiceDataCharacteristic;
 };
 
@@ -34,9 +34,14 @@ DEALINGS IN THE SOFTWARE.
 // the maximum string length that can be scrolled via the BLE service.
 #define MICROBIT_BLE_MAXIMUM_SCROLLTEXT         20
 
+// The largest frame that can be streamed to the display, in bytes: a format byte followed by
+// a 5x5 bitmap at one byte per pixel.
+#define MICROBIT_BLE_MAXIMUM_FRAME              (1 + 5 * 5)
+
 // UUIDs for our service and characteristics
 extern const uint8_t  MicroBitLEDServiceUUID[];
 extern const uint8_t  MicroBitLEDServiceMatrixUUID[];
+extern const uint8_t  MicroBitLEDServiceFrameUUID[];
 extern const uint8_t  MicroBitLEDServiceTextUUID[];
 extern const uint8_t  MicroBitLEDServiceScrollingSpeedUUID[];
 
@@ -69,6 +74,19 @@ class MicroBitLEDService
 
     private:
 
+    /**
+      * Writes a frame received on the frame characteristic into the display image.
+      *
+      * The first byte of the frame is the MicroBitImageFormat of the bitmap that follows, which must match
+      * the dimensions of the display image. The frame is decoded in place, without any heap allocation,
+      * so frames can be streamed at the rate the BLE connection allows.
+      *
+      * @param data The frame.
+      *
+      * @param length The length of the frame, in bytes.
+      */
+    void writeFrame(const uint8_t *data, int length);
+
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
     MicroBitDisplay     &display;
@@ -77,11 +95,16 @@ class MicroBitLEDService
     uint8_t             matrixCharacteristicBuffer[5];
     uint16_t            scrollingSpeedCharacteristicBuffer;
     uint8_t             textCharacteristicBuffer[MICROBIT_BLE_MAXIMUM_SCROLLTEXT];
+    uint8_t             frameCharacteristicBuffer;
+
+    // An image literal, into which each streamed frame is copied so the display can paste it without allocation.
+    uint32_t            frameImage[(sizeof(ImageData) + MICROBIT_BLE_MAXIMUM_FRAME + 3) / 4];
 
     // Handles to access each characteristic when they are held by Soft Device.
     GattAttribute::Handle_t matrixCharacteristicHandle;
     GattAttribute::Handle_t textCharacteristicHandle;
     GattAttribute::Handle_t scrollingSpeedCharacteristicHandle;
+    GattAttribute::Handle_t frameCharacteristicHandle;
 
     // We hold a copy of the GattCharacteristic, as mbed's BLE API requires this to provide read callbacks (pity!).
     GattCharacteristic  matrixCharacteristic;
@@ -0,0 +1,100 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_SENSOR_SERVICE_H
+#define MICROBIT_SENSOR_SERVICE_H
+
+#include "MicroBitConfig.h"
+#include "ble/BLE.h"
+#include "MicroBitAccelerometer.h"
+#include "MicroBitCompass.h"
+#include "EventModel.h"
+
+// The value reported in place of a heading while the compass is uncalibrated.
+#define MICROBIT_SENSOR_SERVICE_NO_HEADING      0xFFFF
+
+// The size of the data characteristic, in 16 bit words:
+// accelerometer x, y, z, magnetometer x, y, z and heading.
+#define MICROBIT_SENSOR_SERVICE_DATA_WORDS      7
+
+// UUIDs for our service and characteristics
+extern const uint8_t  MicroBitSensorServiceUUID[];
+extern const uint8_t  MicroBitSensorServiceDataUUID[];
+extern const uint8_t  MicroBitSensorServicePeriodUUID[];
+
+
+/**
+  * Class definition for the MicroBit BLE Sensor Service.
+  * Provides accelerometer, magnetometer and heading data via BLE as a single notification,
+  * for clients that would otherwise subscribe to the accelerometer and magnetometer services together.
+  *
+  * Both sensors are read in the same callback, so each notification holds a consistent set of samples,
+  * and the heading is computed at most once per period.
+  */
+class MicroBitSensorService
+{
+    public:
+
+    /**
+      * Constructor.
+      * Create a representation of the SensorService.
+      * @param _ble The instance of a BLE device that we're running on.
+      * @param _accelerometer An instance of MicroBitAccelerometer.
+      * @param _compass An instance of MicroBitCompass.
+      */
+    MicroBitSensorService(BLEDevice &_ble, MicroBitAccelerometer &_accelerometer, MicroBitCompass &_compass);
+
+    private:
+
+    /**
+      * Callback. Invoked when any of our attributes are written via BLE.
+      */
+    void onDataWritten(const GattWriteCallbackParams *params);
+
+    /**
+      * Accelerometer update callback. Samples both sensors and notifies the result,
+      * at most once per period.
+      */
+    void sensorUpdate(MicroBitEvent e);
+
+    // Bluetooth stack we're running on.
+    BLEDevice               &ble;
+    MicroBitAccelerometer   &accelerometer;
+    MicroBitCompass         &compass;
+
+    // memory for our characteristics.
+    int16_t             sensorDataCharacteristicBuffer[MICROBIT_SENSOR_SERVICE_DATA_WORDS];
+    uint16_t            sensorPeriodCharacteristicBuffer;
+
+    // the system time (in milliseconds) at which we last sent a notification.
+    uint64_t            lastUpdate;
+
+    // Handles to access each characteristic when they are held by Soft Device.
+    GattAttribute::Handle_t sensorDataCharacteristicHandle;
+    GattAttribute::Handle_t sensorPeriodCharacteristicHandle;
+};
+
+
+#endif
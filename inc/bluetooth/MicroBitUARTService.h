@@ -30,10 +30,15 @@ DEALINGS IN THE SOFTWARE.
 #include "ble/UUID.h"
 #include "ble/BLE.h"
 #include "MicroBitConfig.h"
+#include "MicroBitComponent.h"
+#include "MicroBitRingBuffer.h"
 #include "MicroBitSerial.h"
 
 #define MICROBIT_UART_S_DEFAULT_BUF_SIZE    20
 
+// The largest number of bytes carried by a single indication: the default ATT MTU of 23, less the 3 byte ATT header.
+#define MICROBIT_UART_S_MAX_PAYLOAD         20
+
 #define MICROBIT_UART_S_EVT_DELIM_MATCH     1
 #define MICROBIT_UART_S_EVT_HEAD_MATCH      2
 #define MICROBIT_UART_S_EVT_RX_FULL         3
@@ -43,14 +48,9 @@ DEALINGS IN THE SOFTWARE.
   * Provides a BLE service that acts as a UART port, enabling the reception and transmission
   * of an arbitrary number of bytes.
   */
-class MicroBitUARTService
+class MicroBitUARTService : public MicroBitComponent
 {
-    uint8_t* rxBuffer;
-
-    uint8_t* txBuffer;
-
-    uint8_t rxBufferHead;
-    uint8_t rxBufferTail;
+    MicroBitRingBuffer<uint8_t> rxBuff;
     uint8_t rxBufferSize;
 
     uint8_t txBufferSize;
@@ -71,20 +71,6 @@ class MicroBitUARTService
       */
     void onDataWritten(const GattWriteCallbackParams *params);
 
-    /**
-      * An internal method that copies values from a circular buffer to a linear buffer.
-      *
-      * @param circularBuff a pointer to the source circular buffer
-      * @param circularBuffSize the size of the circular buffer
-      * @param linearBuff a pointer to the destination linear buffer
-      * @param tailPosition the tail position in the circular buffer you want to copy from
-      * @param headPosition the head position in the circular buffer you want to copy to
-      *
-      * @note this method assumes that the linear buffer has the appropriate amount of
-      *       memory to contain the copy operation
-      */
-    void circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition);
-
     public:
 
     /**
@@ -294,6 +280,33 @@ class MicroBitUARTService
       * @return The currently buffered number of bytes in our txBuff.
       */
     int txBufferedSize();
+
+    /**
+      * @return The number of bytes that may be added to our txBuff without waiting.
+      */
+    int txBufferFree();
+
+    /**
+      * Configures the coalescing of small writes into fewer, fuller indications.
+      *
+      * When enabled, bytes given to send() in ASYNC mode are held back until enough have accumulated
+      * to fill an indication, or until the oldest of them has waited for the given delay.
+      * This trades a little latency for many fewer indications when sending small amounts of data,
+      * such as with putc(). Sends in SYNC_SLEEP mode are always transmitted immediately.
+      *
+      * @param delay the longest time a byte may be held back, in milliseconds, or 0 to send every write
+      *        immediately (the default).
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if delay is negative.
+      */
+    int setCoalescing(int delay);
+
+    /**
+      * Periodic callback from MicroBit idle thread.
+      * Sends any coalesced bytes that have waited for longer than the configured delay, and retries
+      * any indication the Bluetooth stack was previously unable to accept.
+      */
+    virtual void idleTick();
 };
 
 extern const uint8_t  UARTServiceBaseUUID[UUID::LENGTH_OF_LONG_UUID];
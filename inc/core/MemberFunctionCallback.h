@@ -72,7 +72,10 @@ class MemberFunctionCallback
       *
       * @param e The event to deliver to the method
       */
-    void fire(MicroBitEvent e);
+    void fire(MicroBitEvent e)
+    {
+        invoke(object, method, e);
+    }
 };
 
 /**
@@ -67,7 +67,11 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_ID_RADIO_DATA_READY    30
 #define MICROBIT_ID_MULTIBUTTON_ATTACH  31
 #define MICROBIT_ID_SERIAL              32
+#define MICROBIT_ID_ANALOG_SAMPLER      33
+#define MICROBIT_ID_TOUCH_SENSOR        34
+#define MICROBIT_ID_BENCHMARK           35
 
+#define MICROBIT_ID_MESSAGE_BUS                     1020          // Message bus status events, such as its queue reaching a high water mark.
 #define MICROBIT_ID_MESSAGE_BUS_LISTENER            1021          // Message bus indication that a handler for a given ID has been registered.
 #define MICROBIT_ID_NOTIFY_ONE                      1022          // Notfication channel, for general purpose synchronisation
 #define MICROBIT_ID_NOTIFY                          1023          // Notfication channel, for general purpose synchronisation
@@ -104,7 +108,7 @@ class MicroBitComponent
     protected:
 
     uint16_t id;                    // Event Bus ID of this component
-    uint8_t status;                 // Component defined state.
+    uint16_t status;                // Component defined state.
 
     public:
 
@@ -127,8 +131,8 @@ class MicroBitComponent
     }
 
     /**
-      * The idle thread will call this member function once the component has been added to the array
-      * of idle components using fiber_add_idle_component. 
+      * The idle thread will call this member function once the component has been added to the registry
+      * of idle components using fiber_add_idle_component, at the interval requested there.
       */
     virtual void idleTick()
     {
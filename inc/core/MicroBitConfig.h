@@ -114,6 +114,28 @@ extern uint32_t __etext;
 #define MICROBIT_HEAP_BLOCK_SIZE                4
 #endif
 
+// Enables or disables size class lists in the MicroBitHeapAllocator. If enabled, small blocks that are freed
+// are held in a list for their size, and reused directly by subsequent allocations of the same size.
+// This avoids searching the heap for most small allocations. Cached blocks are returned to the heap
+// if an allocation cannot otherwise be satisfied.
+// Set '1' to enable.
+#ifndef MICROBIT_HEAP_SIZE_CLASSES
+#define MICROBIT_HEAP_SIZE_CLASSES              1
+#endif
+
+// The largest allocation, in bytes, that is served from a size class list. One list is maintained
+// for each multiple of MICROBIT_HEAP_BLOCK_SIZE up to this value.
+#ifndef MICROBIT_HEAP_SIZE_CLASS_LIMIT
+#define MICROBIT_HEAP_SIZE_CLASS_LIMIT          32
+#endif
+
+// The largest number of blocks held in each size class list. Blocks freed once a list is full are
+// returned directly to the heap. This bounds the memory held in the lists, and the time spent with
+// interrupts disabled whilst the lists are released.
+#ifndef MICROBIT_HEAP_SIZE_CLASS_DEPTH
+#define MICROBIT_HEAP_SIZE_CLASS_DEPTH          8
+#endif
+
 // The proportion of SRAM available on the mbed heap to reserve for the micro:bit heap.
 #ifndef MICROBIT_NESTED_HEAP_SIZE
 #define MICROBIT_NESTED_HEAP_SIZE               0.75
@@ -121,6 +143,7 @@ extern uint32_t __etext;
 
 // If defined, reuse any unused SRAM normally reserved for SoftDevice (Nordic's memory resident BLE stack) as heap memory.
 // The amount of memory reused depends upon whether or not BLE is enabled using MICROBIT_BLE_ENABLED.
+// Programs that never start BLE can reclaim all of the SoftDevice's memory through microbit_create_sd_heap().
 // Set '1' to enable.
 #ifndef MICROBIT_HEAP_REUSE_SD
 #define MICROBIT_HEAP_REUSE_SD                  1
@@ -133,6 +156,14 @@ extern uint32_t __etext;
 #define MICROBIT_SD_GATT_TABLE_SIZE             0x300
 #endif
 
+// The longest string held by a ManagedString within itself, without a heap allocation.
+// Longer strings are held in a reference counted StringData on the heap. Each ManagedString
+// grows by around this many bytes, so the default of 0 keeps ManagedString to a single pointer.
+// Note that the characters of an inline string move with the ManagedString, so are often on the stack.
+#ifndef MICROBIT_STRING_INLINE_LENGTH
+#define MICROBIT_STRING_INLINE_LENGTH           0
+#endif
+
 //
 // Fiber scheduler configuration
 //
@@ -143,6 +174,109 @@ extern uint32_t __etext;
 #define SYSTEM_TICK_PERIOD_MS                   6
 #endif
 
+// Enable this to drive the system timer from a one shot timeout rather than a fixed ticker.
+// The next interrupt is then programmed for the earliest of the next tick period (only if a component
+// has registered for periodic callbacks) or the earliest wake up time requested through
+// system_timer_wake_at(), such as that of the next sleeping fiber. This allows the processor to remain
+// asleep through long idle periods.
+// Set '1' to enable.
+#ifndef MICROBIT_SYSTEM_TIMER_TICKLESS
+#define MICROBIT_SYSTEM_TIMER_TICKLESS          0
+#endif
+
+// The longest interval between system timer interrupts in tickless mode (milliseconds).
+// This must be short enough that the underlying 32 bit us_ticker does not wrap between interrupts (71 minutes).
+#ifndef MICROBIT_SYSTEM_TIMER_TICKLESS_MAX_MS
+#define MICROBIT_SYSTEM_TIMER_TICKLESS_MAX_MS   60000
+#endif
+
+// Enable this to maintain a reference to the tail of each fiber queue, making queue_fiber() and
+// dequeue_fiber() constant time operations. The tail is held in the prev field of the fiber at the
+// head of each queue, at the cost of slightly more complex queue maintenance.
+// Otherwise, queue_fiber() scans to the end of the queue on each operation.
+// Set '1' to enable.
+#ifndef MICROBIT_FIBER_QUEUE_TAIL
+#define MICROBIT_FIBER_QUEUE_TAIL               0
+#endif
+
+// The number of wait queues used to hold fibers blocked on events. Fibers are distributed across
+// these queues by event ID, such that only fibers that may match a given event need be inspected when
+// that event is raised. Must be a power of two.
+#ifndef MICROBIT_FIBER_WAIT_BUCKETS
+#define MICROBIT_FIBER_WAIT_BUCKETS             4
+#endif
+
+// The number of fiber priority levels. Runnable fibers are held on one run queue per level, and the
+// scheduler always runs fibers from the highest priority level that has any runnable fibers.
+// Must be between 1 and 7.
+#ifndef MICROBIT_FIBER_PRIORITY_LEVELS
+#define MICROBIT_FIBER_PRIORITY_LEVELS          3
+#endif
+
+// The time a fiber may hold the processor while other fibers are runnable, in milliseconds. Once exceeded, the
+// scheduler requests that the fiber yields, which it does at its next call to fiber_yield_if_needed().
+// Fibers are never preempted, so this only bounds latency for code that calls fiber_yield_if_needed(),
+// which within the runtime is limited to MicroBitCompassCalibrator.
+// Set to zero to disable.
+#ifndef MICROBIT_FIBER_TIME_SLICE
+#define MICROBIT_FIBER_TIME_SLICE               0
+#endif
+
+// Enable this to allocate fiber stack buffers in power of two size classes, and to retain released
+// buffers in a pool for reuse by other fibers. Buffers grow as soon as a fiber's stack outgrows them,
+// but are only exchanged for a smaller pooled buffer once the stack shrinks to a quarter of their size,
+// such that steady state context switching makes no heap calls.
+// Otherwise, stack buffers are sized to the nearest 32 bytes and reallocated from the heap on growth.
+// Set '1' to enable.
+#ifndef MICROBIT_FIBER_STACK_POOL
+#define MICROBIT_FIBER_STACK_POOL               1
+#endif
+
+// The size of the smallest fiber stack buffer size class, in bytes. Must be a multiple of 4.
+#ifndef MICROBIT_FIBER_STACK_POOL_MIN
+#define MICROBIT_FIBER_STACK_POOL_MIN           64
+#endif
+
+// The number of fiber stack buffer size classes. Each is twice the size of the last.
+// Larger stacks are allocated directly from the heap.
+#ifndef MICROBIT_FIBER_STACK_POOL_CLASSES
+#define MICROBIT_FIBER_STACK_POOL_CLASSES       6
+#endif
+
+// The maximum number of unused stack buffers retained in the pool for each size class.
+#ifndef MICROBIT_FIBER_STACK_POOL_DEPTH
+#define MICROBIT_FIBER_STACK_POOL_DEPTH         2
+#endif
+
+// Enable this to record per fiber statistics: the number of times each fiber is scheduled in, the total
+// time it has held the processor and the deepest stack copied on its behalf, along with the proportion of
+// time the scheduler spends idle, the time spent in each idle state, and how often functions run through
+// invoke() block and fork a fiber.
+// Adds a timer read to each context switch.
+// Set '1' to enable.
+#ifndef MICROBIT_FIBER_STATS
+#define MICROBIT_FIBER_STATS                    0
+#endif
+
+// Enable this to choose how deeply to sleep each time the scheduler is idle, based on the time until the next
+// timed event is due: waiting with the processor ready to resume at once, in the System ON low power mode, or
+// in low power with the high frequency crystal stopped. Long idle periods only arise in tickless mode.
+// Set '1' to enable.
+#ifndef MICROBIT_IDLE_GOVERNOR
+#define MICROBIT_IDLE_GOVERNOR                  0
+#endif
+
+// The shortest predicted idle period for which the idle governor selects the System ON low power mode (microseconds).
+#ifndef MICROBIT_IDLE_LOW_POWER_THRESHOLD_US
+#define MICROBIT_IDLE_LOW_POWER_THRESHOLD_US    1000
+#endif
+
+// The shortest predicted idle period for which the idle governor also stops the high frequency crystal (milliseconds).
+// The crystal takes around a millisecond to restart, during which the processor runs from its internal oscillator.
+#ifndef MICROBIT_IDLE_DEEP_SLEEP_THRESHOLD_MS
+#define MICROBIT_IDLE_DEEP_SLEEP_THRESHOLD_MS   50
+#endif
+
 //
 // Message Bus:
 // Default behaviour for event handlers, if not specified in the listen() call
@@ -165,6 +299,92 @@ extern uint32_t __etext;
 #define MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH    10
 #endif
 
+//
+// The number of MicroBitEventQueueItems to statically allocate for use by the message bus and listener event queues.
+// Queued events are stored in this pool where possible, and fall back to the heap once it is exhausted.
+// Set to zero to always allocate queued events from the heap.
+//
+#ifndef MICROBIT_EVENT_QUEUE_POOL_SIZE
+#define MICROBIT_EVENT_QUEUE_POOL_SIZE          MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH
+#endif
+
+//
+// The number of MicroBitListeners to statically allocate. Listeners are taken from this pool where possible,
+// and fall back to the heap once it is exhausted, so that programs which listen and ignore repeatedly
+// (including fibers waiting for events) do not fragment the heap.
+// Set to zero to always allocate listeners from the heap.
+//
+#ifndef MICROBIT_LISTENER_POOL_SIZE
+#define MICROBIT_LISTENER_POOL_SIZE             8
+#endif
+
+//
+// The number of bits of timestamp carried by each MicroBitEvent:
+//   64 - Microseconds since power on. Events occupy 16 bytes.
+//   32 - Microseconds since power on, wrapping every 71 minutes. Events occupy 8 bytes.
+//    0 - No timestamp. Events occupy 4 bytes. Note that the pulse durations and edge counts
+//        reported by MicroBitPin through the timestamp are then lost.
+// Smaller events save RAM in every queued event, and airtime for events forwarded by MicroBitRadioEvent.
+// MicroBitEvent::getTimestamp() returns a full 64 bit time in every case.
+//
+#ifndef MICROBIT_EVENT_TIMESTAMP_BITS
+#define MICROBIT_EVENT_TIMESTAMP_BITS           64
+#endif
+
+//
+// The number of chains used by the message bus to hold event listeners. Listeners are distributed across
+// these chains by event ID, such that only listeners that may match a given event need be inspected when
+// that event is processed. Listeners for MICROBIT_ID_ANY are always held in a separate chain.
+// Must be a power of two, no greater than 16.
+//
+#ifndef MESSAGE_BUS_LISTENER_BUCKETS
+#define MESSAGE_BUS_LISTENER_BUCKETS            8
+#endif
+
+// Enable this to have the message bus process its event queue in batches. All pending events are taken from
+// the queue at once, and events for MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY listeners are gathered so that each
+// such listener handles its run of events in turn, within a single fiber, rather than being interleaved
+// with other listeners. Other listeners continue to receive each event as it is processed.
+// Set '1' to enable.
+#ifndef MESSAGE_BUS_BATCH_DISPATCH
+#define MESSAGE_BUS_BATCH_DISPATCH              0
+#endif
+
+// Enable this to have the message bus learn which event handlers block. A handler that forks a fiber on
+// MESSAGE_BUS_LISTENER_ADAPTIVE_THRESHOLD consecutive events is given a fiber of its own for each later
+// event, rather than first being called in fork on block context. Every MESSAGE_BUS_LISTENER_ADAPTIVE_RETRY
+// events, the handler is called in fork on block context again, in case its behaviour has changed.
+// Set '1' to enable.
+#ifndef MESSAGE_BUS_LISTENER_ADAPTIVE
+#define MESSAGE_BUS_LISTENER_ADAPTIVE           0
+#endif
+
+#ifndef MESSAGE_BUS_LISTENER_ADAPTIVE_THRESHOLD
+#define MESSAGE_BUS_LISTENER_ADAPTIVE_THRESHOLD 4
+#endif
+
+#ifndef MESSAGE_BUS_LISTENER_ADAPTIVE_RETRY
+#define MESSAGE_BUS_LISTENER_ADAPTIVE_RETRY     16
+#endif
+
+//
+// The number of distinct event sources for which the message bus keeps a count of dropped events.
+// Once this many sources have been seen, the source with the fewest drops is replaced.
+// Set to zero to keep only the total number of events dropped.
+//
+#ifndef MESSAGE_BUS_DROP_SOURCES
+#define MESSAGE_BUS_DROP_SOURCES                4
+#endif
+
+//
+// The depth of the message bus event queue at which a MESSAGE_BUS_EVT_HIGH_WATER event is raised.
+// The event is raised again only once the queue has drained below half of this depth.
+// Must be less than MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH. Set to zero to disable.
+//
+#ifndef MESSAGE_BUS_HIGH_WATER_MARK
+#define MESSAGE_BUS_HIGH_WATER_MARK             0
+#endif
+
 //
 // Core micro:bit services
 //
@@ -178,11 +398,18 @@ extern uint32_t __etext;
 
 // To reduce memory cost and complexity, the micro:bit allows components to register for
 // periodic callback events when the processor is idle.
-// This defines the maximum size of the idle callback list.
+// This defines the initial size of the idle callback registry, which doubles in size whenever it is full.
 #ifndef MICROBIT_IDLE_COMPONENTS
 #define MICROBIT_IDLE_COMPONENTS                6
 #endif
 
+// Interrupt handlers can defer short pieces of work, such as raising events, to the idle task using fiber_defer().
+// This defines the maximum number of work items that can be waiting at any one time. Each uses 8 bytes of RAM.
+// Must be a power of two. Set to zero to disable.
+#ifndef MICROBIT_FIBER_DEFER_QUEUE_SIZE
+#define MICROBIT_FIBER_DEFER_QUEUE_SIZE         8
+#endif
+
 //
 // BLE options
 //
@@ -251,6 +478,12 @@ extern uint32_t __etext;
 #define MICROBIT_BLE_ADVERTISING_TIMEOUT        0
 #endif
 
+// The interval between advertising packets when advertising this micro:bit's name (milliseconds).
+// Longer intervals save power, at the cost of taking longer to be discovered.
+#ifndef MICROBIT_BLE_ADVERTISING_INTERVAL
+#define MICROBIT_BLE_ADVERTISING_INTERVAL       200
+#endif
+
 // Defines default power level of the BLE radio transmitter.
 // Valid values are in the range 0..7 inclusive, with 0 being the lowest power and 7 the highest power.
 // Based on trials undertaken by the BBC, the radio is normally set to its lowest power level
@@ -278,6 +511,19 @@ extern uint32_t __etext;
 #define MICROBIT_BLE_EDDYSTONE_UID               0
 #endif
 
+// Enable/Disable availability of Eddystone TLM (telemetry) frames.
+// These may only be advertised in rotation with other frames. See MICROBIT_BLE_ADVERTISING_SLOTS.
+// Set '1' to enable.
+#ifndef MICROBIT_BLE_EDDYSTONE_TLM
+#define MICROBIT_BLE_EDDYSTONE_TLM               0
+#endif
+
+// The number of precomputed advertising frames (e.g. Eddystone URL, UID and TLM) that MicroBitBLEManager
+// can rotate between. Each occupies around 32 bytes of RAM. Set to '0' to disable rotation.
+#ifndef MICROBIT_BLE_ADVERTISING_SLOTS
+#define MICROBIT_BLE_ADVERTISING_SLOTS           0
+#endif
+
 // Enable/Disable BLE Service: MicroBitEventService
 // This allows routing of events from the micro:bit message bus over BLE.
 // Set '1' to enable.
@@ -285,6 +531,18 @@ extern uint32_t __etext;
 #define MICROBIT_BLE_EVENT_SERVICE              1
 #endif
 
+// The number of events MicroBitEventService can hold while waiting to notify them.
+// Events raised in quick succession are sent together, several to a notification.
+// Events raised while this queue is full are dropped.
+#ifndef MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE
+#define MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE   10
+#endif
+
+// The number of event sources a connected client can rate limit in MicroBitEventService at once.
+#ifndef MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS
+#define MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS  4
+#endif
+
 // Enable/Disable BLE Service: MicroBitDeviceInformationService
 // This enables the standard BLE device information service.
 // Set '1' to enable.
@@ -292,6 +550,19 @@ extern uint32_t __etext;
 #define MICROBIT_BLE_DEVICE_INFORMATION_SERVICE 1
 #endif
 
+// Enable/Disable use of MicroBitRadio whilst the BLE stack is running.
+// The radio protocols then run in timeslots granted by the SoftDevice, in the gaps between BLE activity.
+// Set '1' to enable.
+#ifndef MICROBIT_RADIO_BLE_COEXISTENCE
+#define MICROBIT_RADIO_BLE_COEXISTENCE          0
+#endif
+
+// The length of each timeslot requested from the SoftDevice for MicroBitRadio, in microseconds.
+// Timeslots are extended for as long as BLE allows, so this mainly bounds the latency of returning to BLE.
+#ifndef MICROBIT_RADIO_TIMESLOT_LENGTH
+#define MICROBIT_RADIO_TIMESLOT_LENGTH          10000
+#endif
+
 //
 // Accelerometer options
 //
@@ -303,6 +574,48 @@ extern uint32_t __etext;
 #define USE_ACCEL_LSB                           0
 #endif
 
+// Enable this to sample the accelerometer and compass from their data ready interrupt lines,
+// reading new samples in the background via MicroBitI2C::submit(). Otherwise, the data ready
+// lines are polled whenever the scheduler is idle.
+// Set '1' to enable.
+#ifndef MICROBIT_SENSOR_INTERRUPT_SAMPLING
+#define MICROBIT_SENSOR_INTERRUPT_SAMPLING      0
+#endif
+
+// Enable this to calculate pitch, roll and compass bearings using fixed point CORDIC trigonometry,
+// rather than the floating point library. The cortex-m0 has no FPU, so this is considerably faster,
+// with results within a few thousandths of a degree of the floating point implementation.
+// Set '1' to enable.
+#ifndef MICROBIT_FIXED_POINT_TRIG
+#define MICROBIT_FIXED_POINT_TRIG               0
+#endif
+
+// Enable this to calibrate the compass continuously from the samples seen during normal use, rather than
+// by blocking the user program with an interactive calibration. Hard iron offsets are estimated from the
+// running extremes of each axis, and are only written to persistent storage when they change significantly.
+// Until enough rotation has been seen, heading() returns MICROBIT_CALIBRATION_IN_PROGRESS.
+// Set '1' to enable.
+#ifndef MICROBIT_COMPASS_ONLINE_CALIBRATION
+#define MICROBIT_COMPASS_ONLINE_CALIBRATION     0
+#endif
+
+// The range of field strength, in nano teslas, that must be seen on an axis before its offset can be estimated.
+// The geomagnetic field is 25 to 65 micro teslas, and a full rotation sees up to twice that.
+#ifndef MICROBIT_COMPASS_ONLINE_CALIBRATION_SPAN
+#define MICROBIT_COMPASS_ONLINE_CALIBRATION_SPAN 40000
+#endif
+
+// The change in any offset, in nano teslas, required before the calibration is written to persistent storage.
+#ifndef MICROBIT_COMPASS_ONLINE_CALIBRATION_THRESHOLD
+#define MICROBIT_COMPASS_ONLINE_CALIBRATION_THRESHOLD 2000
+#endif
+
+// The number of samples between each contraction of the running extremes, so that the calibration
+// can recover from transient disturbances and follow changes in the hard iron environment.
+#ifndef MICROBIT_COMPASS_ONLINE_CALIBRATION_DECAY
+#define MICROBIT_COMPASS_ONLINE_CALIBRATION_DECAY 100
+#endif
+
 //
 // Display options
 //
@@ -337,6 +650,26 @@ extern uint32_t __etext;
 #define MICROBIT_DISPLAY_DEFAULT_BRIGHTNESS     MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS
 #endif
 
+// Enable this to compose each frame of a scrolling or animated display in a dedicated fiber, woken by
+// the system timer, rather than in the system timer interrupt itself. This keeps the timer interrupt short.
+// If the fiber falls behind, it skips the display of missed frames to catch up, within one frame period.
+// Set '1' to enable.
+#ifndef MICROBIT_DISPLAY_DEFERRED_ANIMATION
+#define MICROBIT_DISPLAY_DEFERRED_ANIMATION     0
+#endif
+
+// Selects how often the display pauses to take a light reading, when light sensing is in use.
+// Each reading holds the display dark for two system ticks, once every this many frames.
+#ifndef MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES
+#define MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES     4
+#endif
+
+// Selects how heavily light readings are smoothed. Each new reading contributes 1/n of the moving average
+// kept for its part of the display.
+#ifndef MICROBIT_LIGHT_SENSOR_SMOOTHING
+#define MICROBIT_LIGHT_SENSOR_SMOOTHING         4
+#endif
+
 // Selects the default scroll speed for the display.
 // The time taken to move a single pixel (ms).
 #ifndef MICROBIT_DEFAULT_SCROLL_SPEED
@@ -359,6 +692,13 @@ extern uint32_t __etext;
 #define MICROBIT_DEFAULT_SERIAL_MODE            SYNC_SLEEP
 #endif
 
+// Enable/Disable timing of the MicroBitSerial interrupt handlers, as reported by MicroBitSerial::getStats().
+// This adds two reads of the microsecond ticker to every serial interrupt.
+// Set '1' to enable.
+#ifndef MICROBIT_SERIAL_PROFILING
+#define MICROBIT_SERIAL_PROFILING               0
+#endif
+
 //
 // File System configuration defaults
 //
@@ -374,10 +714,53 @@ extern uint32_t __etext;
 //
 // FileSystem writeback cache size, in bytes. Defines how many bytes will be stored
 // in RAM before being written back to FLASH. Set to zero to disable this feature.
-// Should be <= MBFS_BLOCK_SIZE.
+// Should be <= MBFS_BLOCK_SIZE. A cache is allocated for each file opened with MB_WRITE,
+// and can be resized for each file using MicroBitFileSystem::setCacheSize().
 //
 #ifndef MBFS_CACHE_SIZE
-#define MBFS_CACHE_SIZE	    0	
+#define MBFS_CACHE_SIZE	    64
+#endif
+
+//
+// The total number of bytes of RAM that may be used by writeback caches, across all open files.
+// Files opened once this is exhausted are given a smaller cache, or none at all.
+//
+#ifndef MBFS_CACHE_BUDGET
+#define MBFS_CACHE_BUDGET   256
+#endif
+
+//
+// The number of slots in the RAM index used to find files by name, without scanning their directory.
+// Each slot uses 8 bytes of RAM. Set to zero to disable this feature.
+//
+#ifndef MBFS_DIRECTORY_INDEX_SIZE
+#define MBFS_DIRECTORY_INDEX_SIZE   16
+#endif
+
+//
+// Enable/Disable background garbage collection in MicroBitFileSystem.
+// When enabled, pages holding deleted blocks are erased from the idle task, one page per idle tick,
+// so that writes rarely have to wait for FLASH to be recycled. Set '1' to enable.
+//
+#ifndef MBFS_BACKGROUND_GC
+#define MBFS_BACKGROUND_GC          0
+#endif
+
+//
+// The number of slots in the RAM index used by MicroBitStorage to find keys without scanning FLASH.
+// Each slot uses 1 byte of RAM, and there should be more slots than KeyValuePairs fit in a page (21).
+// Set to zero to disable this feature.
+//
+#ifndef MICROBIT_STORAGE_INDEX_SIZE
+#define MICROBIT_STORAGE_INDEX_SIZE 32
+#endif
+
+//
+// The maximum number of changes MicroBitStorage can hold in a single transaction, between begin() and commit().
+// Each uses 48 bytes of heap while the transaction is open.
+//
+#ifndef MICROBIT_STORAGE_TRANSACTION_SIZE
+#define MICROBIT_STORAGE_TRANSACTION_SIZE 8
 #endif
 
 //
@@ -393,6 +776,106 @@ extern uint32_t __etext;
 #define MICROBIT_DEFAULT_PULLMODE                PullDown
 #endif
 
+// Enable this to sample buttons (and touch pins) only whilst they are changing state. An edge interrupt brings
+// a button into the system tick, and it leaves again once its debounce has settled and any hold event is raised.
+// Otherwise, every button is sampled on every system tick.
+// Set '1' to enable.
+#ifndef MICROBIT_BUTTON_SENSE_ON_EDGE
+#define MICROBIT_BUTTON_SENSE_ON_EDGE            0
+#endif
+
+//
+// PWM options
+//
+
+// The number of PWM channels generated in software once the hardware channels are exhausted.
+// These are timed by TIMER1, and so cannot be used at the same time as MICROBIT_PIN_EVENT_ON_CAPTURE.
+// A non-zero value also defines TIMER1_IRQHandler, which then can't be provided by the application.
+// Set to zero to leave TIMER1 untouched by DynamicPwm.
+#ifndef MICROBIT_PWM_SOFTWARE_CHANNELS
+#define MICROBIT_PWM_SOFTWARE_CHANNELS          0
+#endif
+
+//
+// Touch sensing options
+//
+
+// Enable this to measure touch on MicroBitPin::isTouched() capacitively, by the time taken for the pin to charge,
+// using a single MicroBitTouchSensor shared by all pins. Contact with GND is still detected, as the pin then never charges.
+// Otherwise, each touched pin is sampled as a resistive MicroBitButton.
+// Set '1' to enable.
+#ifndef MICROBIT_PIN_TOUCH_CAPACITIVE
+#define MICROBIT_PIN_TOUCH_CAPACITIVE           0
+#endif
+
+// The default time between measurements of the pins of a MicroBitTouchSensor (milliseconds).
+// This is rounded to a whole number of system ticks.
+#ifndef MICROBIT_TOUCH_SENSOR_PERIOD
+#define MICROBIT_TOUCH_SENSOR_PERIOD            30
+#endif
+
+// The longest time a pin is given to charge, in iterations of the measurement loop (around 0.5us each).
+// Pins that have not charged by then are recorded at this value.
+#ifndef MICROBIT_TOUCH_SENSOR_TIMEOUT
+#define MICROBIT_TOUCH_SENSOR_TIMEOUT           2000
+#endif
+
+// The default thresholds at which a pin becomes touched, and released again, as a percentage increase in charge time
+// over the pin's untouched baseline.
+#ifndef MICROBIT_TOUCH_SENSOR_THRESHOLD_HI
+#define MICROBIT_TOUCH_SENSOR_THRESHOLD_HI      40
+#endif
+
+#ifndef MICROBIT_TOUCH_SENSOR_THRESHOLD_LO
+#define MICROBIT_TOUCH_SENSOR_THRESHOLD_LO      20
+#endif
+
+//
+// Pin capture options
+//
+
+// Enable this to support the MICROBIT_PIN_EVENT_ON_CAPTURE mode, which runs TIMER1 freely whilst in use.
+// Otherwise, that mode is refused with MICROBIT_NOT_SUPPORTED and TIMER1 is left untouched.
+// Set '1' to enable.
+#ifndef MICROBIT_PIN_CAPTURE
+#define MICROBIT_PIN_CAPTURE                    0
+#endif
+
+// The GPIOTE and PPI channels used to timestamp edges in hardware, in the MICROBIT_PIN_EVENT_ON_CAPTURE mode.
+// Edges are captured against TIMER1, running freely at 1MHz. Channels 0-2 of each are used by mbed's PwmOut,
+// and PPI channels 8-15 are reserved by the SoftDevice.
+#ifndef MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL
+#define MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL     3
+#endif
+
+#ifndef MICROBIT_PIN_CAPTURE_PPI_CHANNEL
+#define MICROBIT_PIN_CAPTURE_PPI_CHANNEL        7
+#endif
+
+// The number of edges buffered in the MICROBIT_PIN_EVENT_ON_CAPTURE mode, awaiting collection.
+// This is rounded up to a power of two.
+#ifndef MICROBIT_PIN_CAPTURE_BUFFER_SIZE
+#define MICROBIT_PIN_CAPTURE_BUFFER_SIZE        64
+#endif
+
+// The default window, in milliseconds, over which edges are aggregated into a single MICROBIT_PIN_EVT_EDGE_COUNT
+// event in the MICROBIT_PIN_EVENT_ON_COUNT mode. This may be changed at runtime with MicroBitPin::setEdgeWindow().
+#ifndef MICROBIT_PIN_DEFAULT_EDGE_WINDOW
+#define MICROBIT_PIN_DEFAULT_EDGE_WINDOW        100
+#endif
+
+//
+// Random number options
+//
+
+// The number of bytes of hardware entropy held ready for microbit_random(). The pool is refilled in the
+// background from the processor's random number generator, and each call to microbit_random() mixes four bytes
+// into its pseudo random generator while they last. Must be a multiple of 4, and no more than 252.
+// Set '0' to disable, and rely on the pseudo random generator alone.
+#ifndef MICROBIT_RANDOM_POOL_SIZE
+#define MICROBIT_RANDOM_POOL_SIZE               16
+#endif
+
 //
 // Panic options
 //
@@ -421,6 +904,19 @@ extern uint32_t __etext;
 #define MICROBIT_HEAP_DBG                       0
 #endif
 
+// Enable this to record events, fiber context switches and interrupt handler entry and exit into a trace buffer,
+// which can be read back or printed after the fact. See MicroBitTrace.h.
+// Set '1' to enable.
+#ifndef MICROBIT_TRACE
+#define MICROBIT_TRACE                          0
+#endif
+
+// The number of records held in the trace buffer. Each record occupies 12 bytes.
+// Must be a power of two.
+#ifndef MICROBIT_TRACE_BUFFER_SIZE
+#define MICROBIT_TRACE_BUFFER_SIZE              64
+#endif
+
 // Versioning options.
 // We use semantic versioning (http://semver.org/) to identify differnet versions of the micro:bit runtime.
 // Where possible we use yotta (an ARM mbed build tool) to help us track versions.
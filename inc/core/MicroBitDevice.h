@@ -102,6 +102,9 @@ void microbit_panic_timeout(int iterations);
   * than the hardware random number generator built int the processor, which takes
   * a long time and uses a lot of energy.
   *
+  * Unless seeded with a given value, the LFSR is stirred on each call with entropy that the hardware
+  * generator collects in the background, while any is available. See MICROBIT_RANDOM_POOL_SIZE.
+  *
   * KIDS: You shouldn't use this is the real world to generte cryptographic keys though...
   * have a think why not. :-)
   *
@@ -127,7 +130,8 @@ void microbit_seed_random();
 
 /**
   * Seed the pseudo random number generator (RNG) using the given 32-bit value.
-  * This function does not use the NRF51822's in built cryptographic random number generator.
+  * This function does not use the NRF51822's in built cryptographic random number generator,
+  * and no hardware entropy is mixed into the sequence that follows.
   *
   * @param seed The value to use as a seed.
   */
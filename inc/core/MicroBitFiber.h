@@ -50,6 +50,27 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_FIBER_FLAG_PARENT          0x02
 #define MICROBIT_FIBER_FLAG_CHILD           0x04
 #define MICROBIT_FIBER_FLAG_DO_NOT_PAGE     0x08
+#define MICROBIT_FIBER_FLAG_DEDICATED_STACK 0x10
+#define MICROBIT_FIBER_FLAG_PRIORITY_MASK   0x0700
+#define MICROBIT_FIBER_FLAG_PRIORITY_SHIFT  8
+
+// Fiber priorities. Higher values are scheduled in preference to lower ones.
+#define MICROBIT_FIBER_PRIORITY_LOW         0
+#define MICROBIT_FIBER_PRIORITY_NORMAL      ((MICROBIT_FIBER_PRIORITY_LEVELS - 1) / 2)
+#define MICROBIT_FIBER_PRIORITY_HIGH        (MICROBIT_FIBER_PRIORITY_LEVELS - 1)
+
+// Requests that a fiber takes the priority of the fiber that created it.
+#define MICROBIT_FIBER_PRIORITY_INHERIT     -1
+
+// Intervals for idle components, in place of a time in milliseconds.
+#define MICROBIT_IDLE_EVERY_PASS            0           // Called every time the processor is idle.
+#define MICROBIT_IDLE_ON_DEMAND             0xFFFF      // Called only when woken by fiber_wake_idle_component().
+
+// Power states entered by the idle task, from the shallowest to the deepest.
+#define MICROBIT_IDLE_STATE_WAIT            0   // Wait for an event, in the constant latency mode.
+#define MICROBIT_IDLE_STATE_LOW_POWER       1   // Wait for an event, in the System ON low power mode.
+#define MICROBIT_IDLE_STATE_DEEP            2   // As above, with the high frequency crystal stopped.
+#define MICROBIT_IDLE_STATES                3
 
 /**
   *  Thread Context for an ARM Cortex M0 core.
@@ -77,6 +98,29 @@ struct Cortex_M0_TCB
     uint32_t stack_base;
 };
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+/**
+  * Execution statistics recorded for a single Fiber.
+  */
+struct FiberStats
+{
+    uint64_t run_time;                  // The total time this Fiber has been scheduled in, in microseconds.
+    uint32_t switches;                  // The number of times this Fiber has been scheduled in.
+    uint32_t max_stack;                 // The deepest stack copied out of the system stack for this Fiber, in bytes.
+};
+
+/**
+  * Residency statistics recorded for a single idle power state.
+  */
+struct IdleStateStats
+{
+    uint64_t time;                      // The total time spent in this state, in microseconds.
+    uint32_t entries;                   // The number of times this state has been entered.
+};
+#endif
+
+class MicroBitHeapArena;
+
 /**
   * Representation of a single Fiber
   */
@@ -89,9 +133,14 @@ struct Fiber
     uint32_t flags;                     // Information about this fiber.
     Fiber **queue;                      // The queue this fiber is stored on.
     Fiber *next, *prev;                 // Position of this Fiber on the run queue.
+    MicroBitHeapArena *arena;           // The innermost heap arena created by this Fiber, or NULL.
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+    FiberStats stats;                   // Execution statistics for this Fiber.
+#endif
 };
 
 extern Fiber *currentFiber;
+extern volatile bool fiber_yield_requested;
 
 
 /**
@@ -174,6 +223,52 @@ Fiber *create_fiber(void (*entry_fn)(void), void (*completion_fn)(void) = releas
   */
 Fiber *create_fiber(void (*entry_fn)(void *), void *param, void (*completion_fn)(void *) = release_fiber);
 
+/**
+  * Creates a new Fiber with its own dedicated stack, and launches it.
+  *
+  * Unlike other fibers, whose stacks are copied in and out of the system stack on each context switch,
+  * a fiber with a dedicated stack executes directly from a stack region allocated for its lifetime. This
+  * makes switching to and from the fiber a simple register save and restore, at the cost of holding the
+  * full stack allocation in memory. This is intended for latency critical fibers.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param stack_size The size of the stack to allocate for the fiber, in bytes. This must be sufficient
+  *                   to hold the deepest call chain of the fiber, and any interrupt handlers that may run on top of it.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  *
+  * @note Calls to invoke() made from a fiber with a dedicated stack always execute the given function in a new fiber.
+  */
+Fiber *create_fiber_with_stack(void (*entry_fn)(void), uint32_t stack_size, void (*completion_fn)(void) = release_fiber);
+
+/**
+  * Creates a new parameterised Fiber with its own dedicated stack, and launches it.
+  *
+  * Unlike other fibers, whose stacks are copied in and out of the system stack on each context switch,
+  * a fiber with a dedicated stack executes directly from a stack region allocated for its lifetime. This
+  * makes switching to and from the fiber a simple register save and restore, at the cost of holding the
+  * full stack allocation in memory. This is intended for latency critical fibers.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param param an untyped parameter passed into the entry_fn and completion_fn.
+  *
+  * @param stack_size The size of the stack to allocate for the fiber, in bytes. This must be sufficient
+  *                   to hold the deepest call chain of the fiber, and any interrupt handlers that may run on top of it.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  *
+  * @note Calls to invoke() made from a fiber with a dedicated stack always execute the given function in a new fiber.
+  */
+Fiber *create_fiber_with_stack(void (*entry_fn)(void *), void *param, uint32_t stack_size, void (*completion_fn)(void *) = release_fiber);
+
 
 /**
   * Calls the Fiber scheduler.
@@ -242,6 +337,40 @@ int fiber_wait_for_event(uint16_t id, uint16_t value);
   */
 int fiber_wake_on_event(uint16_t id, uint16_t value);
 
+/**
+  * Blocks the calling fiber on the given wait queue.
+  * The calling fiber will be immediately descheduled, and will remain on the queue until woken
+  * by fiber_wake_one() or fiber_wake_all(). Unlike fiber_wait_for_event(), no message bus
+  * listener is involved, so this is a lightweight basis for synchronisation primitives.
+  *
+  * @param queue The wait queue to block on. This should be initialised to NULL before first use.
+  *
+  * @return MICROBIT_OK once woken, MICROBIT_NOT_SUPPORTED if the fiber scheduler is not running, or
+  *         MICROBIT_NO_RESOURCES if called in fork on block context and no fiber could be allocated.
+  *
+  * @note the fiber will not be be made runnable until after it is woken, but there
+  * are no guarantees precisely when the fiber will next be scheduled.
+  */
+int fiber_wait_on_queue(Fiber **queue);
+
+/**
+  * Makes the fiber that has waited longest on the given wait queue runnable (if any).
+  *
+  * @param queue The wait queue to wake a fiber from.
+  *
+  * @return 1 if a fiber was woken, or 0 if the queue was empty.
+  */
+int fiber_wake_one(Fiber **queue);
+
+/**
+  * Makes all fibers waiting on the given wait queue runnable.
+  *
+  * @param queue The wait queue to wake fibers from.
+  *
+  * @return The number of fibers woken.
+  */
+int fiber_wake_all(Fiber **queue);
+
 /**
   * Executes the given function asynchronously if necessary.
   *
@@ -270,9 +399,36 @@ int invoke(void (*entry_fn)(void));
   *
   * @param param an untyped parameter passed into the entry_fn and completion_fn.
   *
-  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+  * @param priority The priority of the fiber created should entry_fn block, or MICROBIT_FIBER_PRIORITY_INHERIT
+  *                 to use the priority of the calling fiber. Defaults to MICROBIT_FIBER_PRIORITY_INHERIT.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if entry_fn is NULL or the priority is out of range.
   */
-int invoke(void (*entry_fn)(void *), void *param);
+int invoke(void (*entry_fn)(void *), void *param, int priority = MICROBIT_FIBER_PRIORITY_INHERIT);
+
+/**
+  * Sets the scheduling priority of the given fiber.
+  *
+  * Fibers are created with the priority of the fiber that created them, or MICROBIT_FIBER_PRIORITY_NORMAL
+  * if created outside of the scheduler. The scheduler always runs fibers of the highest priority that are
+  * runnable, and shares the processor in a round robin fashion between runnable fibers of equal priority.
+  *
+  * @param f The fiber to update.
+  *
+  * @param priority The new priority, in the range MICROBIT_FIBER_PRIORITY_LOW to MICROBIT_FIBER_PRIORITY_HIGH.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the fiber is NULL or the priority is out of range.
+  */
+int fiber_set_priority(Fiber *f, int priority);
+
+/**
+  * Determines the scheduling priority of the given fiber.
+  *
+  * @param f The fiber to inspect.
+  *
+  * @return The priority of the fiber, or MICROBIT_INVALID_PARAMETER if the fiber is NULL.
+  */
+int fiber_get_priority(Fiber *f);
 
 /**
   * Resizes the stack allocation of the current fiber if necessary to hold the system stack.
@@ -280,6 +436,10 @@ int invoke(void (*entry_fn)(void *), void *param);
   * If the stack allocation is large enough to hold the current system stack, then this function does nothing.
   * Otherwise, the the current allocation of the fiber is freed, and a larger block is allocated.
   *
+  * If MICROBIT_FIBER_STACK_POOL is enabled, buffers are drawn from and released to a pool of power of two
+  * size classes, and an oversized buffer is exchanged for a smaller pooled one once the stack shrinks to a
+  * quarter of its size.
+  *
   * @param f The fiber context to verify.
   *
   * @return The stack depth of the given fiber.
@@ -317,6 +477,19 @@ int scheduler_runqueue_empty();
   */
 void queue_fiber(Fiber *f, Fiber **queue);
 
+/**
+  * Utility function to add the given fiber to a queue that is held in ascending order of
+  * its fibers' context field. Fibers with an equal context retain FIFO ordering.
+  *
+  * This is used to maintain the sleep queue ordered by wakeup time, such that the system timer
+  * need only inspect the head of the queue on each tick.
+  *
+  * @param f The fiber to add to the queue
+  *
+  * @param queue The queue to add the fiber to.
+  */
+void queue_fiber_ordered(Fiber *f, Fiber **queue);
+
 /**
   * Utility function to the given fiber from whichever queue it is currently stored on.
   *
@@ -338,22 +511,129 @@ void idle();
 void idle_task();
 
 /**
-  * Adds a component to the array of idle thread components, which are processed
-  * when the run queue is empty.
+  * Adds a component to the registry of idle thread components, which are processed
+  * when the run queue is empty. If the component is already registered, its interval is updated.
+  *
+  * @param component The component to add.
+  *
+  * @param interval The time between calls to the component's idleTick(), in milliseconds. If MICROBIT_IDLE_EVERY_PASS,
+  *                 the component is called every time the processor is idle. If MICROBIT_IDLE_ON_DEMAND, it is only
+  *                 called after it has been woken by fiber_wake_idle_component(). Defaults to MICROBIT_IDLE_EVERY_PASS.
   *
-  * @param component The component to add to the array.
-  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the fiber components array is full.
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the component is NULL, or MICROBIT_NO_RESOURCES
+  *         if the registry could not be grown.
   */
-int fiber_add_idle_component(MicroBitComponent *component);
+int fiber_add_idle_component(MicroBitComponent *component, uint16_t interval = MICROBIT_IDLE_EVERY_PASS);
 
 /**
-  * remove a component from the array of idle thread components
+  * Removes a component from the registry of idle thread components.
+  *
+  * @param component The component to remove.
   *
-  * @param component the component to remove from the idle component array.
   * @return MICROBIT_OK on success. MICROBIT_INVALID_PARAMETER is returned if the given component has not been previously added.
   */
 int fiber_remove_idle_component(MicroBitComponent *component);
 
+/**
+  * Requests that a registered idle component is called on the next idle pass, whatever its interval.
+  * Components registered with MICROBIT_IDLE_ON_DEMAND use this to indicate that they have work pending.
+  *
+  * This may be called from interrupt context.
+  *
+  * @param component The component to wake.
+  *
+  * @return MICROBIT_OK on success. MICROBIT_INVALID_PARAMETER is returned if the given component has not been previously added.
+  */
+int fiber_wake_idle_component(MicroBitComponent *component);
+
+/**
+  * Prevents the idle task from stopping the high frequency crystal, for components that need an accurate clock
+  * even while the processor sleeps, such as the radio or a serial or I2C transfer. Each call must be balanced by a call to
+  * scheduler_idle_release().
+  */
+void scheduler_idle_hold();
+
+/**
+  * Releases a hold placed by scheduler_idle_hold().
+  */
+void scheduler_idle_release();
+
+/**
+  * Defers the given function to be called later from the idle task, rather than in the current context.
+  *
+  * This is intended for use by interrupt handlers, to keep work such as raising events, which must
+  * search the listeners registered with the message bus, out of interrupt context. The function is
+  * called, in order with other deferred work, the next time the processor is idle.
+  *
+  * @param fn The function to call. This should complete quickly, and must not block.
+  *
+  * @param arg An untyped parameter passed to fn.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if fn is NULL, MICROBIT_NOT_SUPPORTED if the
+  *         scheduler is not running, or MICROBIT_NO_RESOURCES if MICROBIT_FIBER_DEFER_QUEUE_SIZE items are already waiting.
+  *
+  * @code
+  * void onData(void *arg)
+  * {
+  *     // Called from the idle task.
+  * }
+  *
+  * void interruptHandler()
+  * {
+  *     fiber_defer(onData, NULL);
+  * }
+  * @endcode
+  */
+int fiber_defer(void (*fn)(void *), void *arg);
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+/**
+  * Reads the execution statistics of a given fiber.
+  *
+  * @param f The fiber to inspect, for example as returned by create_fiber(), or currentFiber.
+  *
+  * @param stats The structure to populate with the statistics of the fiber.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the fiber is NULL.
+  */
+int fiber_get_stats(Fiber *f, FiberStats &stats);
+
+/**
+  * Determines the proportion of time the scheduler has spent idle since it was started, or
+  * since the last call to scheduler_reset_idle_time().
+  *
+  * @return The percentage of time spent in the idle task, in the range 0 to 100.
+  */
+int scheduler_idle_percentage();
+
+/**
+  * Reads the time spent in a given idle power state since the scheduler was started, or
+  * since the last call to scheduler_reset_idle_time().
+  *
+  * @param state The state to inspect, for example MICROBIT_IDLE_STATE_LOW_POWER.
+  *
+  * @param stats The structure to populate with the statistics of the state.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the state is not valid.
+  */
+int scheduler_get_idle_state_stats(int state, IdleStateStats &stats);
+
+/**
+  * Restarts the measurement period used by scheduler_idle_percentage() and scheduler_get_idle_state_stats().
+  */
+void scheduler_reset_idle_time();
+
+/**
+  * Reads the number of functions executed through invoke(), and how many of them blocked
+  * and so were given a fiber of their own.
+  *
+  * @param invocations Set to the number of calls made to invoke() while the scheduler was running.
+  *
+  * @param forks Set to the number of those calls that resulted in a new fiber being created.
+  */
+void scheduler_get_invoke_stats(uint32_t &invocations, uint32_t &forks);
+#endif
+
 /**
   * Determines if the processor is executing in interrupt context.
   *
@@ -364,6 +644,29 @@ inline int inInterruptContext()
     return (((int)__get_IPSR()) & 0x003F) > 0;
 }
 
+/**
+  * Yields the processor if the calling fiber has overrun its time slice while other fibers are waiting to run.
+  * Otherwise, returns immediately.
+  *
+  * This is cheap enough to call regularly from long running loops, bounding the time for which they
+  * delay other fibers. It has no effect in interrupt context, or if MICROBIT_FIBER_TIME_SLICE is zero.
+  *
+  * In fork on block context, yielding counts as blocking, so the remainder of the caller is given a fiber of its own.
+  */
+inline void fiber_yield_if_needed()
+{
+#if MICROBIT_FIBER_TIME_SLICE > 0
+    if (fiber_yield_requested && !inInterruptContext())
+    {
+        // schedule() alone cannot fork, so block through fiber_sleep() if we need to.
+        if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB)
+            fiber_sleep(0);
+        else
+            schedule();
+    }
+#endif
+}
+
 /**
   * Assembler Context switch routing.
   * Defined in CortexContextSwitch.s.
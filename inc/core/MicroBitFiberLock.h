@@ -0,0 +1,137 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_FIBER_LOCK_H
+#define MICROBIT_FIBER_LOCK_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitFiber.h"
+
+/**
+  * Class definition for a FiberMutex.
+  *
+  * A mutual exclusion lock for fibers. A fiber that attempts to take a mutex that is already held
+  * is placed directly onto the mutex's own wait queue, and is woken when the mutex is released.
+  * Ownership passes directly to the fiber that has waited longest, so waiters are served in order.
+  *
+  * @note A FiberMutex may only be used from fiber context, never from an interrupt handler.
+  */
+class FiberMutex
+{
+    Fiber               *waitQueue;     // Fibers blocked waiting for this mutex, in the order they arrived.
+    bool                locked;         // true if a fiber currently holds this mutex.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create an unlocked FiberMutex.
+      */
+    FiberMutex();
+
+    /**
+      * Takes this mutex, blocking the calling fiber until it is available.
+      *
+      * @return MICROBIT_OK once the mutex is held, MICROBIT_NOT_SUPPORTED if the mutex is held and the
+      *         fiber scheduler is not running, or MICROBIT_NO_RESOURCES if the calling fiber could not be blocked.
+      */
+    int lock();
+
+    /**
+      * Takes this mutex, only if it is available.
+      *
+      * @return MICROBIT_OK if the mutex is now held, or MICROBIT_NO_RESOURCES if another fiber holds it.
+      */
+    int tryLock();
+
+    /**
+      * Releases this mutex. If any fibers are waiting, the mutex is passed to the one that has waited longest.
+      */
+    void unlock();
+
+    /**
+      * Determines if this mutex is currently held.
+      *
+      * @return true if the mutex is held, false otherwise.
+      */
+    bool isLocked();
+};
+
+/**
+  * Class definition for a FiberSemaphore.
+  *
+  * A counting semaphore for fibers. Fibers that wait on a semaphore with no remaining permits are
+  * placed directly onto the semaphore's own wait queue, and are woken in the order they arrived
+  * as permits are released.
+  *
+  * @note A FiberSemaphore may only be used from fiber context, never from an interrupt handler.
+  */
+class FiberSemaphore
+{
+    Fiber               *waitQueue;     // Fibers blocked waiting for a permit, in the order they arrived.
+    int                 permits;        // The number of permits currently available.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create a FiberSemaphore with the given number of permits.
+      *
+      * @param permits The number of permits initially available. Defaults to 1.
+      */
+    FiberSemaphore(int permits = 1);
+
+    /**
+      * Takes a permit from this semaphore, blocking the calling fiber until one is available.
+      *
+      * @return MICROBIT_OK once a permit is held, MICROBIT_NOT_SUPPORTED if no permit is available and the
+      *         fiber scheduler is not running, or MICROBIT_NO_RESOURCES if the calling fiber could not be blocked.
+      */
+    int wait();
+
+    /**
+      * Takes a permit from this semaphore, only if one is available.
+      *
+      * @return MICROBIT_OK if a permit is now held, or MICROBIT_NO_RESOURCES if none are available.
+      */
+    int tryWait();
+
+    /**
+      * Releases a permit to this semaphore. If any fibers are waiting, the permit is passed to the one that has waited longest.
+      */
+    void signal();
+
+    /**
+      * Determines the number of permits currently available.
+      *
+      * @return The number of permits that could be taken without blocking.
+      */
+    int getPermits();
+};
+
+#endif
@@ -56,11 +56,31 @@ DEALINGS IN THE SOFTWARE.
 #include <new>
 
 // The maximum number of heap segments that can be created.
+// A standard boot creates two: the unused part of the GATT table, and the nested heap. Allow for the SoftDevice's memory too.
+#ifndef MICROBIT_MAXIMUM_HEAPS
+#if CONFIG_ENABLED(MICROBIT_HEAP_REUSE_SD)
+#define MICROBIT_MAXIMUM_HEAPS          3
+#else
 #define MICROBIT_MAXIMUM_HEAPS          2
+#endif
+#endif
 
 // Flag to indicate that a given block is FREE/USED
 #define MICROBIT_HEAP_BLOCK_FREE		0x80000000
 
+/**
+  * A snapshot of the usage of a heap region, as returned by microbit_heap_get_stats().
+  */
+struct MicroBitHeapStats
+{
+    uint32_t totalBytes;            // The size of the heap region, in bytes.
+    uint32_t freeBytes;             // The number of bytes not currently allocated, including block headers.
+    uint32_t largestFreeBlock;      // The largest single allocation the heap could currently satisfy, in bytes.
+    uint32_t allocations;           // The number of blocks currently allocated from the heap.
+    uint32_t highWaterMark;         // The largest number of bytes allocated from the heap at any one time.
+    uint32_t failedAllocations;     // The number of allocations no registered heap could satisfy (across all heaps).
+};
+
 /**
   * Create and initialise a given memory region as for heap storage.
   * After this is called, any future calls to malloc, new, free or delete may use the new heap.
@@ -92,6 +112,28 @@ int microbit_create_heap(uint32_t start, uint32_t end);
   */
 int microbit_create_nested_heap(float ratio);
 
+/**
+  * Reclaim the SRAM normally reserved for the SoftDevice as an additional heap region, for programs that do not use BLE.
+  *
+  * The region runs from MICROBIT_SRAM_BASE up to MICROBIT_SD_LIMIT, stopping short of any heap already created
+  * within it (such as one reclaiming the unused part of the GATT table). Once reclaimed, the BLE stack can
+  * no longer be started.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if MICROBIT_HEAP_REUSE_SD is disabled, the SoftDevice is
+  *         already enabled or the memory has already been reclaimed, or MICROBIT_NO_RESOURCES if
+  *         MICROBIT_MAXIMUM_HEAPS heaps already exist.
+  *
+  * @note This should be called early during startup, and only if BLE will not be used.
+  */
+int microbit_create_sd_heap();
+
+/**
+  * Determines if the SRAM normally reserved for the SoftDevice has been reclaimed as heap memory.
+  *
+  * @return true if microbit_create_sd_heap() has succeeded, false otherwise.
+  */
+bool microbit_sd_heap_created();
+
 /**
   * Attempt to allocate a given amount of memory from any of our configured heap areas.
   *
@@ -109,6 +151,33 @@ void *microbit_malloc(size_t size);
   */
 void microbit_free(void *mem);
 
+/**
+  * Read the usage statistics of a given heap.
+  *
+  * @param index The index of the heap to inspect, in the order the heaps were created.
+  *
+  * @param stats The structure to populate with the statistics of the heap.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no heap exists with the given index.
+  *
+  * @note This walks the block list of the heap with interrupts disabled, so its cost is proportional
+  * to the number of blocks in the heap. Blocks held in size class lists are counted as free, but are left in place.
+  */
+int microbit_heap_get_stats(int index, MicroBitHeapStats &stats);
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+/**
+  * Release all blocks held in size class lists back to their heaps, such that they can be
+  * merged with neighbouring free blocks.
+  *
+  * This is performed automatically if an allocation cannot otherwise be satisfied. Interrupts are disabled
+  * throughout, but each list holds at most MICROBIT_HEAP_SIZE_CLASS_DEPTH blocks.
+  *
+  * @return The number of blocks released.
+  */
+int microbit_heap_release_size_classes();
+#endif
+
 /*
  * Wrapper function to ensure we have an explicit handle on the heap allocator provided
  * by our underlying platform.
@@ -0,0 +1,147 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_HEAP_ARENA_H
+#define MICROBIT_HEAP_ARENA_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+struct Fiber;
+
+// The word stored before each allocation taken from an arena. It can never be a valid heap block header,
+// so microbit_free() can recognise arena memory without consulting the arena itself.
+#define MICROBIT_HEAP_ARENA_BLOCK               0x7A5A0000
+
+/**
+  * A scoped, bump pointer allocator for short lived objects.
+  *
+  * Whilst a MicroBitHeapArena exists, every allocation made by the fiber that created it through microbit_malloc()
+  * (and so new, malloc, ManagedString, MicroBitImage, PacketBuffer and so on) is taken from the arena instead of
+  * the heap. Each allocation simply advances a pointer, and freeing memory from the arena does nothing. All of it is
+  * reclaimed at once when the arena is destroyed, so a burst of temporary objects costs the heap a single block,
+  * and leaves it no more fragmented than before.
+  *
+  * Allocations made by other fibers or by interrupt handlers are unaffected. If the arena is full, allocations are
+  * taken from the heap as normal. Arenas may be nested; the innermost is used. Arenas created before the scheduler
+  * is running reserve no memory.
+  *
+  * Each fiber keeps its own list of arenas, so an arena may live on the stack of a fiber that later blocks. If an
+  * event handler run by invoke() blocks, its arenas move with it to the fiber created to run the rest of it.
+  *
+  * Memory the runtime allocates for its own use, such as fiber contexts and stacks, event queues and driver buffers,
+  * is always taken from the heap, even when it is allocated on behalf of a fiber with an active arena.
+  *
+  * @note Any object allocated from the arena must be destroyed, or abandoned, before the arena is. In particular,
+  *       objects that outlive the scope, such as a ManagedString stored in a member variable, must not be created
+  *       whilst an arena is active.
+  *
+  * @code
+  * void onButtonA(MicroBitEvent)
+  * {
+  *     MicroBitHeapArena arena(256);
+  *
+  *     ManagedString s = ManagedString("Temperature: ") + ManagedString(uBit.thermometer.getTemperature());
+  *     uBit.serial.send(s + "\r\n", SYNC_SLEEP);
+  * }
+  * @endcode
+  */
+class MicroBitHeapArena
+{
+    uint8_t             *base;          // The start of the arena's memory, or NULL if none could be allocated.
+    uint8_t             *top;           // The next free byte.
+    uint8_t             *end;           // The end of the arena's memory.
+    MicroBitHeapArena   *next;          // The arena made active before this one by the same fiber.
+
+    public:
+
+    // The number of calls to suspend() not yet matched by a call to resume().
+    static int suspended;
+
+    /**
+      * Constructor.
+      *
+      * Allocates the arena's memory as a single block, and makes it the source of the calling fiber's allocations.
+      *
+      * @param size The amount of memory to reserve, in bytes.
+      *
+      * @note If the memory cannot be allocated, the arena has a size of zero, and allocations are taken from the heap.
+      */
+    MicroBitHeapArena(int size);
+
+    /**
+      * Destructor.
+      *
+      * Returns the arena's memory to the heap, releasing everything allocated from it.
+      */
+    ~MicroBitHeapArena();
+
+    /**
+      * Determines the capacity of the arena.
+      *
+      * @return The amount of memory reserved by the arena, in bytes.
+      */
+    int size();
+
+    /**
+      * Determines how much of the arena has been allocated.
+      *
+      * @return The amount of memory allocated from the arena, in bytes.
+      */
+    int used();
+
+    /**
+      * Allocates memory for the caller from the innermost arena it has active, if any.
+      *
+      * @param size The amount of memory, in bytes, to allocate.
+      *
+      * @return A pointer to the allocated memory, or NULL if the caller has no active arena, or it is full.
+      */
+    static void *allocate(size_t size);
+
+    /**
+      * Determines if the given memory was allocated from an arena, by any fiber.
+      *
+      * @param mem The memory to test, which must have been returned by microbit_malloc().
+      *
+      * @return true if the memory belongs to an arena, and must not be freed to the heap.
+      */
+    static bool contains(void *mem);
+
+    /**
+      * Takes all allocations from the heap until resume() is called, even those made by a fiber with an active arena.
+      *
+      * Used by the runtime around allocations that must outlive any arena, such as fiber stacks and event queues.
+      * Calls may be nested, but must not span a context switch.
+      */
+    static void suspend();
+
+    /**
+      * Undoes a call to suspend().
+      */
+    static void resume();
+};
+
+#endif
@@ -26,6 +26,7 @@ DEALINGS IN THE SOFTWARE.
 #ifndef MICROBIT_LISTENER_H
 #define MICROBIT_LISTENER_H
 
+#include <new>
 #include "mbed.h"
 #include "MicroBitConfig.h"
 #include "MicroBitEvent.h"
@@ -41,10 +42,18 @@ DEALINGS IN THE SOFTWARE.
 #define MESSAGE_BUS_LISTENER_DROP_IF_BUSY           0x0020
 #define MESSAGE_BUS_LISTENER_NONBLOCKING            0x0040
 #define MESSAGE_BUS_LISTENER_URGENT                 0x0080
+#define MESSAGE_BUS_LISTENER_PRIORITY_MASK          0x0700
+#define MESSAGE_BUS_LISTENER_PRIORITY_SHIFT         8
+#define MESSAGE_BUS_LISTENER_COALESCE               0x0800
+#define MESSAGE_BUS_LISTENER_FORKING                0x1000
 #define MESSAGE_BUS_LISTENER_DELETING               0x8000
 
 #define MESSAGE_BUS_LISTENER_IMMEDIATE              (MESSAGE_BUS_LISTENER_NONBLOCKING |  MESSAGE_BUS_LISTENER_URGENT)
 
+// Requests that the fiber created if a listener's handler blocks runs at the given fiber priority.
+// By default, it takes the priority of the fiber that processed the event.
+#define MESSAGE_BUS_LISTENER_PRIORITY(p)            ((((p) + 1) << MESSAGE_BUS_LISTENER_PRIORITY_SHIFT) & MESSAGE_BUS_LISTENER_PRIORITY_MASK)
+
 /**
   *	This structure defines a MicroBitListener used to invoke functions, or member
   * functions if an instance of EventModel receives an event whose id and value
@@ -55,12 +64,16 @@ struct MicroBitListener
 	uint16_t		id;				// The ID of the component that this listener is interested in.
 	uint16_t 		value;			// Value this listener is interested in receiving.
     uint16_t        flags;          // Status and configuration options codes for this listener.
+    uint16_t        dropped;        // The number of events this listener has discarded because it was busy or its queue was full.
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_ADAPTIVE)
+    uint8_t         streak;         // The number of consecutive events for which the handler has forked, or been given its own fiber.
+#endif
 
     union
     {
         void (*cb)(MicroBitEvent);
         void (*cb_param)(MicroBitEvent, void *);
-        MemberFunctionCallback *cb_method;
+        uint32_t cb_method_storage[(sizeof(MemberFunctionCallback) + 3) / 4];  // Holds the MemberFunctionCallback of a MESSAGE_BUS_LISTENER_METHOD listener.
     };
 
 	void*			cb_arg;			// Optional argument to be passed to the caller.
@@ -130,12 +143,49 @@ struct MicroBitListener
       */
     ~MicroBitListener();
 
+    /**
+      * Retrieves the callback of a listener created with a C++ member function (MESSAGE_BUS_LISTENER_METHOD).
+      * This is held within the listener itself, so needs no allocation of its own.
+      *
+      * @return The MemberFunctionCallback to fire.
+      */
+    MemberFunctionCallback *cb_method()
+    {
+        return (MemberFunctionCallback *) cb_method_storage;
+    }
+
     /**
       * Queues and event up to be processed.
+      *
+      * If this listener was created with MESSAGE_BUS_LISTENER_COALESCE, an identical event (same source and value)
+      * already in the queue is replaced with the given event instead.
+      *
+      * If the queue is already MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH events deep, the event is dropped,
+      * and recorded in this listener's dropped count.
 	  *
       * @param e The event to queue
       */
     void queue(MicroBitEvent e);
+
+    /**
+      * Allocates storage for a MicroBitListener.
+      *
+      * Listeners are taken from a statically allocated pool of MICROBIT_LISTENER_POOL_SIZE listeners where possible,
+      * such that listening for an event does not normally require a heap allocation. If the pool is exhausted,
+      * the listener is allocated from the heap.
+      *
+      * @param size The amount of memory required, in bytes.
+      *
+      * @return A pointer to the memory allocated, or NULL if no memory is available.
+      */
+    static void *operator new(size_t size);
+
+    /**
+      * Releases storage for a MicroBitListener, returning it to the pool if it was taken from there.
+      *
+      * @param ptr The memory to release.
+      */
+    static void operator delete(void *ptr);
 };
 
 /**
@@ -159,11 +209,15 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, T* object, void
 {
 	this->id = id;
 	this->value = value;
-    this->cb_method = new MemberFunctionCallback(object, method);
+    new (cb_method_storage) MemberFunctionCallback(object, method);
 	this->cb_arg = NULL;
     this->flags = flags | MESSAGE_BUS_LISTENER_METHOD;
     this->evt_queue = NULL;
 	this->next = NULL;
+    this->dropped = 0;
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_ADAPTIVE)
+    this->streak = 0;
+#endif
 }
 
 #endif
@@ -42,6 +42,10 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitComponent.h"
 
+// Period given to system_timer_add_component() for components that are called at every timer interrupt,
+// but do not require periodic callbacks themselves.
+#define MICROBIT_SYSTEM_TICK_ON_DEMAND      0
+
 /**
   * Initialises a system wide timer, used to drive the various components used in the runtime.
   *
@@ -72,8 +76,11 @@ int system_timer_get_period();
 /**
   * Updates the current time in microseconds, since power on.
   *
-  * If the mbed Timer hasn't been initialised, it will be initialised
+  * If the system timer hasn't been initialised, it will be initialised
   * on the first call to this function.
+  *
+  * This also starts a new epoch, and so must be called at least once every 71 minutes, before the
+  * us_ticker wraps. The system timer interrupt does so.
   */
 inline void update_time();
 
@@ -87,6 +94,9 @@ uint64_t system_timer_current_time();
 /**
   * Determines the time since the device was powered on.
   *
+  * This only reads the us_ticker and the current epoch, and so is cheap enough to timestamp every event.
+  * It never blocks interrupts: if the epoch changes whilst it is being read, it is simply read again.
+  *
   * @return the current time since power on in microseconds
   */
 uint64_t system_timer_current_time_us();
@@ -99,12 +109,38 @@ uint64_t system_timer_current_time_us();
   */
 void system_timer_tick();
 
+/**
+  * Requests that the system timer interrupt occurs no later than the given time.
+  *
+  * In tickless mode, this is used to wake the processor for the next timed event, such as the
+  * wake up time of a sleeping fiber. Otherwise, the periodic tick is sufficient, and this has no effect.
+  *
+  * @param time The time since power on at which an interrupt is required, in milliseconds.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int system_timer_wake_at(uint64_t time);
+
+/**
+  * Determines when the next system timer interrupt is expected.
+  *
+  * Used to estimate how long the processor may sleep for. Other interrupts may of course occur sooner.
+  *
+  * @return The time since power on at which the next system timer interrupt is due, in microseconds.
+  */
+uint64_t system_timer_next_interrupt_us();
+
 /**
   * Add a component to the array of system components. This component will then receive
-  * periodic callbacks, once every tick period in interrupt context.
+  * periodic callbacks, once every given number of tick periods in interrupt context.
   *
   * @param component The component to add.
   *
+  * @param ticks The number of tick periods between callbacks to the component. If MICROBIT_SYSTEM_TICK_ON_DEMAND,
+  *              the component is called at every timer interrupt, but does not itself require any. In tickless mode,
+  *              such components are only called at interrupts that occur for other reasons, for example those
+  *              requested through system_timer_wake_at(). Defaults to 1.
+  *
   * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the component array is full.
   *
   * @code
@@ -114,7 +150,7 @@ void system_timer_tick();
   * system_timer_add_component(display);
   * @endcode
   */
-int system_timer_add_component(MicroBitComponent *component);
+int system_timer_add_component(MicroBitComponent *component, uint16_t ticks = 1);
 
 /**
   * Remove a component from the array of system components. This component will no longer receive
@@ -147,12 +183,14 @@ class MicroBitSystemTimerCallback : MicroBitComponent
      * and, in turn, calls a plain C function as provided as a parameter.
      *
      * @param function the function to invoke upon a systemTick.
+     *
+     * @param ticks The number of tick periods between callbacks, or MICROBIT_SYSTEM_TICK_ON_DEMAND. Defaults to 1.
      */
     public:
-    MicroBitSystemTimerCallback(void (*function)(void))
+    MicroBitSystemTimerCallback(void (*function)(void), uint16_t ticks = 1)
     {
         fn = function;
-        system_timer_add_component(this);
+        system_timer_add_component(this, ticks);
     }
 
     void systemTick()
@@ -0,0 +1,131 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Definitions for the MicroBit trace buffer.
+  *
+  * The trace buffer records a fixed number of compact binary records describing what the runtime has been doing:
+  * events sent on the message bus, fiber context switches and entry to and exit from the major interrupt handlers.
+  * Recording a trace costs a few stores with interrupts briefly disabled, so unlike MICROBIT_DBG it does not
+  * significantly perturb the timing being investigated. Once the buffer is full the oldest records are overwritten.
+  * The records can be read back or printed after the fact.
+  *
+  * Tracing is compiled in only when MICROBIT_TRACE is enabled.
+  */
+
+#ifndef MICROBIT_TRACE_H
+#define MICROBIT_TRACE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+// Types of trace record.
+#define MICROBIT_TRACE_EVENT                1       // An event sent on the message bus. id is the source, value the event value.
+#define MICROBIT_TRACE_FIBER_SWITCH         2       // A context switch. value is the address of the fiber scheduled in.
+#define MICROBIT_TRACE_ISR_ENTER            3       // Entry to an interrupt handler. id is one of MICROBIT_TRACE_ISR_*.
+#define MICROBIT_TRACE_ISR_EXIT             4       // Exit from an interrupt handler. id is one of MICROBIT_TRACE_ISR_*.
+#define MICROBIT_TRACE_USER                 5       // Free for use by applications.
+
+// Interrupt handlers identified in MICROBIT_TRACE_ISR_ENTER and MICROBIT_TRACE_ISR_EXIT records.
+#define MICROBIT_TRACE_ISR_SYSTEM_TIMER     1
+#define MICROBIT_TRACE_ISR_RADIO            2
+#define MICROBIT_TRACE_ISR_I2C              3
+#define MICROBIT_TRACE_ISR_ADC              4
+#define MICROBIT_TRACE_ISR_PWM              5
+#define MICROBIT_TRACE_ISR_PIN              6       // value is the id of the pin.
+#define MICROBIT_TRACE_ISR_TEMP             7
+
+/**
+  * A single entry in the trace buffer.
+  */
+struct MicroBitTraceRecord
+{
+    uint32_t    time;       // The value of the microsecond ticker when the record was made.
+    uint16_t    type;       // The type of record, one of MICROBIT_TRACE_*.
+    uint16_t    id;         // Meaning depends on the type of record.
+    uint32_t    value;      // Meaning depends on the type of record.
+};
+
+#if CONFIG_ENABLED(MICROBIT_TRACE)
+#define MICROBIT_TRACE_RECORD(type, id, value)  microbit_trace((type), (id), (value))
+#else
+#define MICROBIT_TRACE_RECORD(type, id, value)  do {} while (0)
+#endif
+
+/**
+  * Adds a record to the trace buffer, overwriting the oldest record if the buffer is full.
+  *
+  * May be called from interrupt context. Has no effect whilst recording is disabled.
+  * Normally used through the MICROBIT_TRACE_RECORD macro, which compiles to nothing unless MICROBIT_TRACE is enabled.
+  *
+  * @param type The type of record, one of MICROBIT_TRACE_*.
+  *
+  * @param id The first record specific value.
+  *
+  * @param value The second record specific value.
+  */
+void microbit_trace(uint16_t type, uint16_t id, uint32_t value);
+
+/**
+  * Enables or disables recording into the trace buffer. Recording is enabled by default.
+  *
+  * Disabling recording freezes the contents of the buffer, for example once the problem of interest has occurred.
+  *
+  * @param enable true to record, false to stop recording.
+  */
+void microbit_trace_enable(bool enable);
+
+/**
+  * Discards all records held in the trace buffer.
+  */
+void microbit_trace_clear();
+
+/**
+  * Copies records out of the trace buffer, oldest first, such that they can be sent elsewhere (for example over BLE).
+  *
+  * @param buffer The memory to copy records into.
+  *
+  * @param length The maximum number of records to copy.
+  *
+  * @param start The number of records to skip, counting from the oldest. Defaults to 0.
+  *
+  * @return The number of records copied, or MICROBIT_INVALID_PARAMETER if buffer is NULL or length is negative.
+  *
+  * @note Recording should be disabled whilst reading the buffer in several parts, so that it does not move between reads.
+  */
+int microbit_trace_read(MicroBitTraceRecord *buffer, int length, int start = 0);
+
+/**
+  * Prints the contents of the trace buffer, oldest first, one record per line.
+  *
+  * Recording is disabled whilst the buffer is printed, and restored afterwards.
+  *
+  * @param serial The serial port to print to, for example uBit.serial.
+  *
+  * @return The number of records printed.
+  */
+int microbit_trace_dump(RawSerial &serial);
+
+#endif
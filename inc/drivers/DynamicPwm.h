@@ -31,40 +31,119 @@ DEALINGS IN THE SOFTWARE.
 
 #define MICROBIT_DEFAULT_PWM_PERIOD 20000
 
+// The number of PWM channels provided by mbed's PwmOut on the nRF51.
+#define MICROBIT_PWM_HARDWARE_CHANNELS  3
+
+// The total number of PWM channels that may be in use at once.
+#define MICROBIT_PWM_CHANNELS           (MICROBIT_PWM_HARDWARE_CHANNELS + MICROBIT_PWM_SOFTWARE_CHANNELS)
+
+// The longest period supported by software channels, which are timed by a 16 bit timer at 1MHz.
+#define MICROBIT_PWM_SOFTWARE_MAX_PERIOD 65535
+
 /**
   * Class definition for DynamicPwm.
   *
   * This class addresses a few issues found in the underlying libraries.
   * This provides the ability for a neat, clean swap between PWM channels.
+  *
+  * Channels are held in a fixed pool, and are obtained with allocate() and returned with release(), so that pins
+  * may move in and out of PWM use without churning the heap. The first MICROBIT_PWM_HARDWARE_CHANNELS channels
+  * are generated in hardware by mbed's PwmOut. Once these are in use, up to MICROBIT_PWM_SOFTWARE_CHANNELS more
+  * are generated from the TIMER1 interrupt, with the same period. These are suited to servos and LEDs, but
+  * their edges may be delayed by other interrupts, including those of the Bluetooth stack. Software channels,
+  * and the TIMER1 interrupt handler, are only built when MICROBIT_PWM_SOFTWARE_CHANNELS is non-zero.
   */
-class DynamicPwm : public PwmOut
+class DynamicPwm
 {
     private:
     static uint32_t period;
+    static DynamicPwm *pool[MICROBIT_PWM_CHANNELS];
+
+    PwmOut *hardware;           // The PwmOut driving a hardware channel, or NULL for a software channel.
+    PinName pin;                // The pin driven by this channel.
+    uint8_t channel;            // The position of this channel in the pool.
+    bool allocated;             // true if this channel is in use.
+    volatile uint16_t width;    // The pulse width of a software channel, in microseconds.
     float lastValue;
 
+    /**
+      * Constructor. Creates the given entry in the pool of channels.
+      *
+      * @param channel the position of the channel in the pool.
+      */
+    DynamicPwm(int channel);
+
+    /**
+      * Brings this channel into use on the given pin, with a duty cycle of zero.
+      *
+      * @param pin the name of the pin for the pwm to target
+      */
+    void attach(PinName pin);
+
     public:
 
     /**
-      * An internal constructor used when allocating a new DynamicPwm instance.
+      * Obtains a PWM channel for the given pin. A channel already driving the pin is returned if there is one,
+      * otherwise the first free channel is used, preferring hardware channels.
       *
       * @param pin the name of the pin for the pwm to target
       *
-      * @param persistance the level of persistence for this pin PWM_PERSISTENCE_PERSISTENT (can not be replaced until freed, should only be used for system services really.)
-      *                    or PWM_PERSISTENCE_TRANSIENT (can be replaced at any point if a channel is required.)
+      * @return The channel, or NULL if every channel is in use.
+      *
+      * @code
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
+      * @endcode
+      */
+    static DynamicPwm* allocate(PinName pin);
+
+#if MICROBIT_PWM_SOFTWARE_CHANNELS > 0
+    /**
+      * Generates the edges of the software channels. Called from the TIMER1 interrupt, at the start of each
+      * period and at each falling edge.
+      *
+      * @note should only be called from TIMER1_IRQHandler...
       */
-    DynamicPwm(PinName pin);
+    static void onTimer();
+#endif
+
+    /**
+      * Determines the number of PWM channels in use.
+      *
+      * @return The number of channels in use.
+      */
+    static int getChannelsInUse();
+
+    /**
+      * Determines the number of software PWM channels in use.
+      *
+      * @return The number of software channels in use. Whilst non-zero, TIMER1 is unavailable for hardware capture.
+      */
+    static int getSoftwareChannelsInUse();
+
+    /**
+      * Determines the number of PWM channels that could still be allocated.
+      *
+      * @return The number of free channels. Software channels are not available whilst TIMER1 is used for hardware capture.
+      */
+    static int getChannelsFree();
 
     /**
       * Frees this DynamicPwm instance for reuse.
       *
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate();
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       * pwm->release();
       * @endcode
       */
     void release();
 
+    /**
+      * Determines if this channel is generated in hardware.
+      *
+      * @return true for a hardware channel, or false for a channel generated in software.
+      */
+    bool isHardware();
+
     /**
       * A lightweight wrapper around the super class' write in order to capture the value
       *
@@ -73,19 +152,33 @@ class DynamicPwm : public PwmOut
       * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range
       *
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate();
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       * pwm->write(0.5);
       * @endcode
       */
     int write(float value);
 
+    /**
+      * Sets the pulse width of this channel.
+      *
+      * @param width the time for which the output is high in each period, in microseconds.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if width is negative.
+      *
+      * @code
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
+      * pwm->pulsewidth_us(1500);
+      * @endcode
+      */
+    int pulsewidth_us(int width);
+
     /**
       * Retrieves the PinName associated with this DynamicPwm instance.
       *
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       *
-      * // returns the PinName n.
+      * // returns MICROBIT_PIN_P0.
       * pwm->getPinName();
       * @endcode
       *
@@ -99,7 +192,7 @@ class DynamicPwm : public PwmOut
       * in the range 0 - 1023 inclusive.
       *
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       * pwm->write(0.5);
       *
       * // will return 512.
@@ -113,7 +206,7 @@ class DynamicPwm : public PwmOut
       *
       * Example:
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       * pwm->getPeriod();
       * @endcode
       */
@@ -124,7 +217,7 @@ class DynamicPwm : public PwmOut
       *
       * Example:
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       * pwm->setPeriodUs(20000);
       *
       * // will return 20000
@@ -142,7 +235,7 @@ class DynamicPwm : public PwmOut
       *
       * Example:
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       *
       * // period now is 20ms
       * pwm->setPeriodUs(20000);
@@ -161,15 +254,13 @@ class DynamicPwm : public PwmOut
       *
       * Example:
       * @code
-      * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+      * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
       *
       * // period now is 20ms
       * pwm->setPeriod(20);
       * @endcode
       */
       int setPeriod(uint32_t period);
-
-      ~DynamicPwm();
 };
 
 #endif
@@ -31,6 +31,8 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitComponent.h"
 #include "MicroBitCoordinateSystem.h"
 #include "MicroBitI2C.h"
+#include "MicroBitRingBuffer.h"
+#include "MicroBitFixedMath.h"
 
 /**
   * Relevant pin assignments
@@ -42,6 +44,8 @@ DEALINGS IN THE SOFTWARE.
   */
 #define MICROBIT_ACCEL_PITCH_ROLL_VALID           0x02
 #define MICROBIT_ACCEL_ADDED_TO_IDLE              0x04
+#define MICROBIT_ACCEL_INTERRUPT_ENABLED          0x08
+#define MICROBIT_ACCEL_SAMPLE_PENDING             0x10
 
 /**
   * I2C constants
@@ -74,6 +78,7 @@ DEALINGS IN THE SOFTWARE.
   * Accelerometer events
   */
 #define MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE              1
+#define MICROBIT_ACCELEROMETER_EVT_BATCH_READY              2
 
 /**
   * Gesture events
@@ -119,6 +124,17 @@ struct MMA8653Sample
     int16_t         z;
 };
 
+/**
+  * A single sample delivered in batch mode, in milli-g in the accelerometer's own coordinate system.
+  */
+struct MicroBitAccelerometerBatchSample
+{
+    uint32_t        timestamp;          // The time the sample became ready, in microseconds.
+    int16_t         x;
+    int16_t         y;
+    int16_t         z;
+};
+
 struct MMA8653SampleRateConfig
 {
     uint32_t        sample_period;
@@ -162,15 +178,31 @@ class MicroBitAccelerometer : public MicroBitComponent
     uint16_t        samplePeriod;       // The time between samples, in milliseconds.
     uint8_t         sampleRange;        // The sample range of the accelerometer in g.
     MMA8653Sample   sample;             // The last sample read.
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+    InterruptIn     int1;               // Data ready interrupt.
+    I2CTransaction  transaction;        // Background read of the output registers.
+    uint8_t         sampleRegister;     // The first output register.
+    uint8_t         sampleData[6];      // The raw output registers, read in the background.
+    uint32_t        sampleTime;         // The time the sample being read became ready, in microseconds.
+#else
     DigitalIn       int1;               // Data ready interrupt.
+#endif
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    int16_t         pitch;              // Pitch of the device, as a binary angle.
+    int16_t         roll;               // Roll of the device, as a binary angle.
+#else
     float           pitch;              // Pitch of the device, in radians.
-    MicroBitI2C&    i2c;                // The I2C interface to use.
     float           roll;               // Roll of the device, in radians.
+#endif
+    MicroBitI2C&    i2c;                // The I2C interface to use.
     uint8_t         sigma;              // the number of ticks that the instantaneous gesture has been stable.
     uint8_t         impulseSigma;       // the number of ticks since an impulse event has been generated.
     uint16_t        lastGesture;        // the last, stable gesture recorded.
     uint16_t        currentGesture;     // the instantaneous, unfiltered gesture detected.
     ShakeHistory    shake;              // State information needed to detect shake events.
+    uint16_t        batchSize;          // The number of samples per batch, or zero if batch mode is disabled.
+    uint16_t        batchCount;         // The number of samples added to the current batch.
+    MicroBitRingBuffer<MicroBitAccelerometerBatchSample> batch;   // Samples awaiting collection in batch mode.
 
     public:
 
@@ -277,6 +309,22 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     int whoAmI();
 
+    /**
+      * Reads all three axes from the latest update retrieved from the accelerometer.
+      *
+      * This checks for a new sample and applies the coordinate transform once, so is cheaper than
+      * calling getX(), getY() and getZ() in turn, and guarantees that all three values come from the same sample.
+      *
+      * @param system The coordinate system to use. By default, a simple cartesian system is provided.
+      *
+      * @return The force measured in each axis, in milli-g.
+      *
+      * @code
+      * MMA8653Sample s = accelerometer.getSample();
+      * @endcode
+      */
+    MMA8653Sample getSample(MicroBitCoordinateSystem system = SIMPLE_CARTESIAN);
+
     /**
       * Reads the value of the X axis from the latest update retrieved from the accelerometer.
       *
@@ -334,6 +382,17 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     float getPitchRadians();
 
+    /**
+      * Provides a rotation compensated pitch of the device, based on the latest update retrieved from the accelerometer.
+      *
+      * @return The pitch of the device, as a binary angle where MICROBIT_FIXED_ANGLE_TURN units make one full turn.
+      *
+      * @code
+      * accelerometer.getPitchAngle();
+      * @endcode
+      */
+    int getPitchAngle();
+
     /**
       * Provides a rotation compensated roll of the device, based on the latest update retrieved from the accelerometer.
       *
@@ -356,6 +415,17 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     float getRollRadians();
 
+    /**
+      * Provides a rotation compensated roll of the device, based on the latest update retrieved from the accelerometer.
+      *
+      * @return The roll of the device, as a binary angle where MICROBIT_FIXED_ANGLE_TURN units make one full turn.
+      *
+      * @code
+      * accelerometer.getRollAngle();
+      * @endcode
+      */
+    int getRollAngle();
+
     /**
       * Retrieves the last recorded gesture.
       *
@@ -371,6 +441,66 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     uint16_t getGesture();
 
+    /**
+      * Enables or disables batch mode. In batch mode, each sample is timestamped and buffered for collection
+      * with readBatch(), and a single MICROBIT_ACCELEROMETER_EVT_BATCH_READY event is raised each time batchSize
+      * further samples have been buffered, in place of a MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE event per sample.
+      *
+      * @param batchSize The number of samples per batch, or zero to disable batch mode.
+      *
+      * @param capacity The number of samples that can be buffered. This must be at least batchSize.
+      *        Defaults to twice batchSize, so that one batch can be collected while the next is gathered.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the parameters are out of range,
+      *         or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+      *
+      * @code
+      * // 800Hz vibration logging, in batches of 100 samples.
+      * accelerometer.setPeriod(1);
+      * accelerometer.setBatchMode(100);
+      * @endcode
+      *
+      * @note Any buffered samples are discarded. Samples that arrive whilst the buffer is full are dropped.
+      *       For high sample rates, enable MICROBIT_SENSOR_INTERRUPT_SAMPLING.
+      */
+    int setBatchMode(int batchSize, int capacity = 0);
+
+    /**
+      * Reads the number of samples per batch.
+      *
+      * @return The batch size, or zero if batch mode is disabled.
+      */
+    int getBatchSize();
+
+    /**
+      * Determines the number of buffered samples awaiting collection in batch mode.
+      *
+      * @return The number of samples that can be read with readBatch().
+      */
+    int getBatchLevel();
+
+    /**
+      * Removes buffered samples in batch mode, oldest first.
+      *
+      * @param samples The location to store the samples.
+      *
+      * @param len The maximum number of samples to read.
+      *
+      * @return The number of samples read, or MICROBIT_INVALID_PARAMETER if samples is NULL or len is negative.
+      *
+      * @code
+      * MicroBitAccelerometerBatchSample samples[100];
+      *
+      * void onBatch(MicroBitEvent)
+      * {
+      *     int n = accelerometer.readBatch(samples, 100);
+      * }
+      *
+      * messageBus.listen(MICROBIT_ID_ACCELEROMETER, MICROBIT_ACCELEROMETER_EVT_BATCH_READY, onBatch);
+      * @endcode
+      */
+    int readBatch(MicroBitAccelerometerBatchSample *samples, int len);
+
     /**
       * A periodic callback invoked by the fiber scheduler idle thread.
       *
@@ -447,6 +577,42 @@ class MicroBitAccelerometer : public MicroBitComponent
      * @return A 'best guess' of the current posture of the device, based on instanataneous data.
      */
     uint16_t instantaneousPosture();
+
+    /**
+      * Converts the raw contents of the output registers into a new sample, and
+      * signals that it is available.
+      *
+      * @param data The six output registers, starting with the X axis MSB.
+      *
+      * @param timestamp The time the sample became ready, in microseconds.
+      */
+    void processSample(uint8_t *data, uint32_t timestamp);
+
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+    /**
+      * Interrupt handler for the data ready line. Begins a background read of the new sample.
+      */
+    void onDataReady();
+
+    /**
+      * Queues a background read of the output registers, unless one is already in progress.
+      */
+    void startSampleRead();
+
+    /**
+      * Called from interrupt context when a background read completes, to process the sample from the idle task.
+      *
+      * @param t The completed transaction.
+      */
+    static void onSampleRead(I2CTransaction *t);
+
+    /**
+      * Processes a sample read in the background. Called from the idle task.
+      *
+      * @param device The instance that read the sample.
+      */
+    static void processSampleRead(void *device);
+#endif
 };
 
 #endif
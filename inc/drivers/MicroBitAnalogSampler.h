@@ -0,0 +1,204 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_ANALOG_SAMPLER_H
+#define MICROBIT_ANALOG_SAMPLER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitComponent.h"
+#include "MicroBitPin.h"
+#include "MicroBitRingBuffer.h"
+
+// The number of analog inputs of the nRF51 ADC.
+#define MICROBIT_ANALOG_SAMPLER_MAX_CHANNELS    8
+
+// The time taken by a single 10 bit conversion, in microseconds.
+#define MICROBIT_ANALOG_SAMPLER_CONVERSION_TIME 68
+
+/*
+ * Analog sampler events
+ */
+#define MICROBIT_ANALOG_SAMPLER_EVT_BLOCK_READY 1
+
+/**
+  * Class definition for MicroBitAnalogSampler.
+  *
+  * Periodically scans a set of analog pins in the background, storing each scan as a frame of samples,
+  * one per pin, in a buffer. An event is raised each time a block of frames is ready, so that waveforms
+  * can be captured without the cost of a getAnalogValue() call for every sample.
+  *
+  * The nRF51 ADC converts only one input at a time, so each scan is started by a Ticker, and the
+  * remaining inputs are converted in turn from the ADC interrupt.
+  *
+  * Only one instance may sample at a time. Whilst sampling, the ADC is owned by this instance:
+  * getAnalogValue() and the display's light sensing mode should not be used.
+  */
+class MicroBitAnalogSampler : public MicroBitComponent
+{
+    Ticker                          trigger;                                            // Starts each scan.
+    MicroBitPin                     *pins[MICROBIT_ANALOG_SAMPLER_MAX_CHANNELS];        // The pins scanned, in order.
+    uint8_t                         inputs[MICROBIT_ANALOG_SAMPLER_MAX_CHANNELS];       // The ADC input of each pin.
+    uint16_t                        frame[MICROBIT_ANALOG_SAMPLER_MAX_CHANNELS];        // The scan in progress.
+    uint8_t                         channels;                                           // The number of pins scanned.
+    volatile uint8_t                channel;                                            // The pin being converted, or channels if no scan is in progress.
+    uint16_t                        blockSize;                                          // The number of frames in each block.
+    uint16_t                        blockCount;                                         // The number of frames stored since the last block was reported.
+    volatile uint32_t               dropped;                                            // The number of frames lost since sampling started.
+    MicroBitRingBuffer<uint16_t>    samples;                                            // Frames awaiting collection.
+
+    /**
+      * Begins a conversion of the current channel.
+      */
+    void startConversion();
+
+    /**
+      * Periodic callback from the Ticker. Begins a scan of all the channels.
+      */
+    void onTick();
+
+    public:
+
+    // The instance currently sampling, if any.
+    static MicroBitAnalogSampler *instance;
+
+    /**
+      * Constructor.
+      *
+      * Create a representation of an analog sampler, with no pins.
+      *
+      * @param id the unique EventModel id of this component. Defaults to MICROBIT_ID_ANALOG_SAMPLER.
+      *
+      * @code
+      * MicroBitAnalogSampler sampler;
+      * @endcode
+      */
+    MicroBitAnalogSampler(uint16_t id = MICROBIT_ID_ANALOG_SAMPLER);
+
+    /**
+      * Adds a pin to the end of the list of pins scanned. The pin is configured for analog input.
+      *
+      * @param pin The pin to sample.
+      *
+      * @return The position of the pin's sample in each frame, MICROBIT_NOT_SUPPORTED if the pin is not connected to the ADC,
+      *         MICROBIT_NO_RESOURCES if every channel is in use, or MICROBIT_BUSY if sampling is in progress.
+      *
+      * @code
+      * sampler.addChannel(uBit.io.P0);
+      * sampler.addChannel(uBit.io.P1);
+      * @endcode
+      */
+    int addChannel(MicroBitPin &pin);
+
+    /**
+      * Removes all the pins from the list of pins scanned.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_BUSY if sampling is in progress.
+      */
+    int clearChannels();
+
+    /**
+      * Determines the number of pins scanned, which is also the number of samples in each frame.
+      *
+      * @return The number of pins scanned.
+      */
+    int getChannels();
+
+    /**
+      * Starts sampling. Any frames left from an earlier run are discarded.
+      *
+      * @param period The time between the start of each scan, in microseconds. This must allow each pin
+      *               to be converted in turn, taking MICROBIT_ANALOG_SAMPLER_CONVERSION_TIME per pin.
+      *
+      * @param blockSize The number of frames in each block. A MICROBIT_ANALOG_SAMPLER_EVT_BLOCK_READY event is raised
+      *                  each time a block of frames has been stored.
+      *
+      * @param capacity The number of frames that may be held awaiting collection. If 0, space for four blocks is provided.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there are no pins or any parameter is out of range,
+      *         MICROBIT_BUSY if another instance is sampling, or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+      *
+      * @code
+      * // Sample at 2kHz, and collect the samples ten times a second.
+      * sampler.start(500, 200);
+      * @endcode
+      */
+    int start(int period, int blockSize, int capacity = 0);
+
+    /**
+      * Stops sampling. Frames already stored remain available to read().
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if this instance is not sampling.
+      */
+    int stop();
+
+    /**
+      * Removes stored frames, oldest first. The samples of each frame are in the order their pins were added.
+      *
+      * @param buffer The location to store the samples, each in the range 0 - 1023.
+      *
+      * @param len The size of the buffer, in samples. Only whole frames are read.
+      *
+      * @return The number of samples read, or MICROBIT_INVALID_PARAMETER if buffer is NULL or len is negative.
+      *
+      * @code
+      * uint16_t block[400];
+      *
+      * void onBlock(MicroBitEvent)
+      * {
+      *     int n = sampler.read(block, 400);
+      * }
+      *
+      * uBit.messageBus.listen(MICROBIT_ID_ANALOG_SAMPLER, MICROBIT_ANALOG_SAMPLER_EVT_BLOCK_READY, onBlock);
+      * @endcode
+      */
+    int read(uint16_t *buffer, int len);
+
+    /**
+      * Determines the number of stored frames awaiting collection.
+      *
+      * @return The number of frames that can currently be read.
+      */
+    int getFrames();
+
+    /**
+      * Determines the number of frames lost since sampling was started, either because the buffer was full
+      * or because a scan had not finished by the time the next was due.
+      *
+      * @return The number of frames lost.
+      */
+    int getDropped();
+
+    /**
+      * Interrupt handler for the ADC. Stores the result of the conversion, then begins the next.
+      */
+    void onConversion();
+
+    /**
+      * Destructor. Stops sampling, if in progress.
+      */
+    ~MicroBitAnalogSampler();
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_BENCHMARK_H
+#define MICROBIT_BENCHMARK_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "EventModel.h"
+#include "MicroBitFileSystem.h"
+
+// The number of times each operation is repeated by default, to average out the resolution of the system timer.
+#define MICROBIT_BENCHMARK_DEFAULT_ITERATIONS   1000
+
+// The name of the file created by the file system benchmark.
+#define MICROBIT_BENCHMARK_FILENAME             "benchmark.bin"
+
+// The size of the file written by the file system benchmark, in bytes.
+#define MICROBIT_BENCHMARK_FILE_SIZE            4096
+
+/**
+  * Class definition for MicroBitBenchmark.
+  *
+  * Measures the cost of the runtime's hot paths on the device itself, and prints a report
+  * over serial that can be compared between builds to catch performance regressions.
+  *
+  * Each result is printed as one comma separated line:
+  *
+  *     benchmark,<name>,<parameter>,<operations>,<total_us>,<ns_per_op>
+  *
+  * Operations are timed in bulk with system_timer_current_time_us(), as the Cortex-M0 has no cycle counter.
+  * Results are most repeatable when no other fibers are runnable and BLE is inactive.
+  */
+class MicroBitBenchmark
+{
+    RawSerial       &serial;
+    int             iterations;
+
+    /**
+      * Prints a single result line.
+      *
+      * @param name The name of the benchmark.
+      *
+      * @param parameter The parameter the benchmark was run with, such as a number of listeners.
+      *
+      * @param operations The number of operations timed.
+      *
+      * @param time The total time taken, in microseconds.
+      */
+    void report(const char *name, int parameter, int operations, uint32_t time);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * @param serial The serial port to print results to, for example uBit.serial.
+      *
+      * @param iterations The number of times each operation is repeated. Defaults to MICROBIT_BENCHMARK_DEFAULT_ITERATIONS.
+      *
+      * @code
+      * MicroBitBenchmark benchmark(uBit.serial);
+      * benchmark.run(uBit.messageBus);
+      * @endcode
+      */
+    MicroBitBenchmark(RawSerial &serial, int iterations = MICROBIT_BENCHMARK_DEFAULT_ITERATIONS);
+
+    /**
+      * Runs every benchmark over a representative range of parameters.
+      *
+      * @param bus The message bus to benchmark.
+      *
+      * @param fs The file system to benchmark, or NULL to skip the file system benchmarks. Defaults to NULL.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory ran out.
+      */
+    int run(EventModel &bus, MicroBitFileSystem *fs = NULL);
+
+    /**
+      * Measures the cost of a malloc and free pair, once the heap has been fragmented.
+      *
+      * @param fragmentation The percentage of small blocks freed between blocks that remain allocated, 0 to 100.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory ran out.
+      */
+    int heap(int fragmentation);
+
+    /**
+      * Measures the cost of sending an event on the message bus, when the chain holding its listeners
+      * contains the given number of listeners. Each event is delivered to one MESSAGE_BUS_LISTENER_IMMEDIATE listener.
+      *
+      * @param bus The message bus to benchmark.
+      *
+      * @param listeners The number of listeners to register.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if listeners is less than 1.
+      */
+    int messageBus(EventModel &bus, int listeners);
+
+    /**
+      * Measures the cost of a context switch through schedule(), between this fiber and
+      * another fiber using the given amount of stack.
+      *
+      * @param depth The approximate stack used by the other fiber, in bytes.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the fiber could not be created.
+      */
+    int contextSwitch(int depth);
+
+    /**
+      * Measures the cost of MicroBitImage::paste(), pasting a square image onto another of the same size.
+      *
+      * @param size The width and height of the images, in pixels.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if size is less than 1.
+      */
+    int imagePaste(int size);
+
+    /**
+      * Measures file system throughput, by writing and then reading back a file of MICROBIT_BENCHMARK_FILE_SIZE bytes.
+      * The file is removed afterwards.
+      *
+      * @param fs The file system to benchmark.
+      *
+      * @param chunk The number of bytes passed to each write() and read() call.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if chunk is out of range,
+      *         or the error returned by the file system.
+      */
+    int fileSystem(MicroBitFileSystem &fs, int chunk);
+};
+
+#endif
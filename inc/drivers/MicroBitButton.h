@@ -49,6 +49,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_BUTTON_STATE_HOLD_TRIGGERED    2
 #define MICROBIT_BUTTON_STATE_CLICK             4
 #define MICROBIT_BUTTON_STATE_LONG_CLICK        8
+#define MICROBIT_BUTTON_STATE_SAMPLING          16
 
 #define MICROBIT_BUTTON_SIGMA_MIN               0
 #define MICROBIT_BUTTON_SIGMA_MAX               12
@@ -56,6 +57,8 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_BUTTON_SIGMA_THRESH_LO         2
 #define MICROBIT_BUTTON_DOUBLE_CLICK_THRESH     50
 
+class MicroBitMultiButton;
+
 enum MicroBitButtonEventConfiguration
 {
     MICROBIT_BUTTON_SIMPLE_EVENTS,
@@ -71,11 +74,25 @@ enum MicroBitButtonEventConfiguration
 class MicroBitButton : public MicroBitComponent
 {
     PinName name;                                           // mbed pin name for this button.
-    DigitalIn pin;                                          // The mbed object looking after this pin at any point in time (may change!).
+    InterruptIn pin;                                        // The mbed object looking after this pin at any point in time (may change!).
 
     unsigned long downStartTime;                            // used to store the current system clock when a button down event occurs
     uint8_t sigma;                                          // integration of samples over time. We use this for debouncing, and noise tolerance for touch sensing
     MicroBitButtonEventConfiguration eventConfiguration;    // Do we want to generate high level event (clicks), or defer this to another service.
+    MicroBitMultiButton *multiButton;                       // The MicroBitMultiButton informed directly of changes in state, if any.
+
+    /**
+      * Interrupt handler for an edge on the pin. Begins sampling the pin on each system tick, if we are not already.
+      */
+    void onEdge();
+
+    /**
+      * Determines if the debounced state of this button has settled, with no hold event outstanding,
+      * such that it need not be sampled again until the pin changes.
+      *
+      * @return true if this button is idle, false otherwise.
+      */
+    bool isIdle();
 
     public:
 
@@ -111,6 +128,21 @@ class MicroBitButton : public MicroBitComponent
       */
     int isPressed();
 
+    /**
+      * Retrieves the event bus ID of this button.
+      *
+      * @return The ID given to the constructor.
+      */
+    uint16_t getId();
+
+    /**
+      * Informs the given MicroBitMultiButton of each change in the state of this button directly from
+      * systemTick(), rather than through the EventModel. Used by MicroBitMultiButton.
+      *
+      * @param multiButton The MicroBitMultiButton to inform, or NULL to inform none.
+      */
+    void setMultiButton(MicroBitMultiButton *multiButton);
+
     /**
       * Changes the event configuration used by this button to the given MicroBitButtonEventConfiguration.
       *
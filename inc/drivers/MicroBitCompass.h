@@ -95,6 +95,8 @@ extern const MAG3110SampleRateConfig MAG3110SampleRate[];
 #define MICROBIT_COMPASS_STATUS_CALIBRATED      2
 #define MICROBIT_COMPASS_STATUS_CALIBRATING     4
 #define MICROBIT_COMPASS_STATUS_ADDED_TO_IDLE   8
+#define MICROBIT_COMPASS_STATUS_INTERRUPT_ENABLED 16
+#define MICROBIT_COMPASS_STATUS_SAMPLE_PENDING  32
 
 /**
   * Term to convert sample data into SI units
@@ -151,10 +153,23 @@ class MicroBitCompass : public MicroBitComponent
 
     CompassSample           average;                  // Centre point of sample data.
     CompassSample           sample;                   // The latest sample data recorded.
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+    InterruptIn             int1;                     // Data ready interrupt.
+    I2CTransaction          transaction;              // Background read of the output registers.
+    uint8_t                 sampleRegister;           // The first output register.
+    uint8_t                 sampleData[6];            // The raw output registers, read in the background.
+#else
     DigitalIn               int1;                     // Data ready interrupt.
+#endif
     MicroBitI2C&		    i2c;                      // The I2C interface the sensor is connected to.
     MicroBitAccelerometer*  accelerometer;            // The accelerometer to use for tilt compensation.
     MicroBitStorage*        storage;                  // An instance of MicroBitStorage used for persistence.
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+    CompassSample           calibrationMin;           // The smallest values seen on each axis, for online calibration.
+    CompassSample           calibrationMax;           // The largest values seen on each axis, for online calibration.
+    CompassSample           calibrationStored;        // The calibration last written to persistent storage.
+    uint16_t                calibrationSamples;       // The number of samples since the extremes were last contracted.
+#endif
 
     public:
 
@@ -308,6 +323,22 @@ class MicroBitCompass : public MicroBitComponent
       */
     int whoAmI();
 
+    /**
+      * Reads all three axes from the latest update retrieved from the magnetometer.
+      *
+      * This checks for a new sample and applies the coordinate transform once, so is cheaper than
+      * calling getX(), getY() and getZ() in turn, and guarantees that all three values come from the same sample.
+      *
+      * @param system The coordinate system to use. By default, a simple cartesian system is provided.
+      *
+      * @return The magnetic force measured in each axis, in nano teslas.
+      *
+      * @code
+      * CompassSample s = compass.getSample();
+      * @endcode
+      */
+    CompassSample getSample(MicroBitCoordinateSystem system = SIMPLE_CARTESIAN);
+
     /**
       * Reads the value of the X axis from the latest update retrieved from the magnetometer.
       *
@@ -408,6 +439,8 @@ class MicroBitCompass : public MicroBitComponent
       *
       * @note Can be used to trigger manual updates, if the device is running without a scheduler.
       *       Also called internally by all get[X,Y,Z]() member functions.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the magnetometer could not be accessed.
       */
     int updateSample();
 
@@ -508,6 +541,59 @@ class MicroBitCompass : public MicroBitComponent
       * @param address the base address of the magnetometer on the i2c bus.
       */
     void init(uint16_t id, uint16_t address);
+
+    /**
+      * Converts the raw contents of the output registers into a new sample, and
+      * signals that it is available.
+      *
+      * @param data The six output registers, starting with the X axis MSB.
+      */
+    void processSample(uint8_t *data);
+
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+    /**
+      * Refines the calibration using the latest sample. Once every axis of interest has seen enough of the
+      * field, the offsets are taken as the centre of the extremes seen, and persisted if they have changed
+      * significantly.
+      *
+      * The Z axis often sees little rotation when the device is used flat, so its offset is only updated
+      * once it has seen enough of the field in its own right.
+      */
+    void updateOnlineCalibration();
+
+    /**
+      * Writes the given calibration to persistent storage, if any.
+      *
+      * @param calibration The calibration to store.
+      */
+    void storeCalibration(CompassSample calibration);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+    /**
+      * Interrupt handler for the data ready line. Begins a background read of the new sample.
+      */
+    void onDataReady();
+
+    /**
+      * Queues a background read of the output registers, unless one is already in progress.
+      */
+    void startSampleRead();
+
+    /**
+      * Called from interrupt context when a background read completes, to process the sample from the idle task.
+      *
+      * @param t The completed transaction.
+      */
+    static void onSampleRead(I2CTransaction *t);
+
+    /**
+      * Processes a sample read in the background. Called from the idle task.
+      *
+      * @param device The instance that read the sample.
+      */
+    static void processSampleRead(void *device);
+#endif
 };
 
 #endif
@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "ManagedString.h"
 #include "MicroBitComponent.h"
+#include "MicroBitFiber.h"
 #include "MicroBitImage.h"
 #include "MicroBitFont.h"
 #include "MicroBitMatrixMaps.h"
@@ -49,6 +50,9 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH    8
 #define MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS    -255
 
+// Status flag, set if the display is wired as described by MICROBIT_DISPLAY_TYPE in MicroBitMatrixMaps.h.
+#define MICROBIT_DISPLAY_BUILTIN_LAYOUT         0x02
+
 enum AnimationMode {
     ANIMATION_MODE_NONE,
     ANIMATION_MODE_STOPPED,
@@ -86,10 +90,24 @@ class MicroBitDisplay : public MicroBitComponent
     uint8_t strobeRow;
     uint8_t rotation;
     uint8_t mode;
-    uint8_t greyscaleBitMsk;
     uint8_t timingCount;
     uint32_t col_mask;
 
+    // The bit pattern to write for each bit plane of the row being rendered, when in greyscale mode.
+    uint32_t greyscalePlanes[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH];
+
+    // The frame currently being displayed. This is a copy of the image, taken as each frame begins,
+    // so that a frame is never rendered from an image that is part way through an update.
+    uint8_t *frameBuffer;
+    int frameBufferSize;
+
+    // Set whilst an animation frame is being composed into the image, to hold the current frame.
+    volatile bool composing;
+
+    // For each row and column drive position, the index into the image bitmap of the pixel it displays.
+    // Held row by row, and rebuilt whenever the rotation changes.
+    uint16_t *pixelIndex;
+
     Timeout renderTimer;
     PortOut *LEDMatrix;
 
@@ -106,6 +124,21 @@ class MicroBitDisplay : public MicroBitComponent
     // The time in milliseconds since the frame update.
     uint16_t animationTick;
 
+    // Fibers blocked in waitForFreeDisplay(), in the order they arrived.
+    Fiber *waitQueue;
+
+    // The fiber that composes animation frames, or NULL if frames are composed in the system timer interrupt.
+    Fiber *animationFiber;
+
+    // The animation fiber, whilst it waits for a frame to fall due.
+    Fiber *animationQueue;
+
+    // The number of animation frames that have fallen due, but are yet to be composed by the animation fiber.
+    volatile uint16_t framesDue;
+
+    // The time in microseconds taken by the animation fiber to compose the most recent frame(s).
+    uint32_t animationStepTime;
+
     // Stop playback of any animations
     void stopAnimation(int delay);
 
@@ -149,6 +182,9 @@ class MicroBitDisplay : public MicroBitComponent
     // A pointer to an instance of light sensor, if in use
     MicroBitLightSensor* lightSensor;
 
+    // The number of frames rendered since the last light reading.
+    uint8_t lightSenseFrame;
+
     // Flag to indicate if image has been rendered to screen yet (or not)
     bool scrollingImageRendered;
 
@@ -156,6 +192,47 @@ class MicroBitDisplay : public MicroBitComponent
 
     // Internal methods to handle animation.
 
+    /**
+      * Rebuilds the table mapping each LED drive position to the image pixel it displays, for the current rotation.
+      */
+    void updatePixelIndex();
+
+    /**
+      * Takes a copy of the image to display as the next frame, unless an animation frame is being composed.
+      */
+    void latchFrame();
+
+    /**
+      * Moves any ongoing animation on to its next frame, composing that frame into the image.
+      */
+    void updateAnimation();
+
+    /**
+      * Creates the fiber used to compose animation frames, if it is enabled and does not yet exist.
+      *
+      * Until it exists, frames are composed in the system timer interrupt. The fiber is only created from
+      * thread context while the display is enabled, as creating a fiber allocates memory.
+      */
+    void startAnimationFiber();
+
+    /**
+      * Retires the animation fiber, if it exists. The fiber exits, and its memory is released, once it next runs.
+      *
+      * Frames are then composed in the system timer interrupt, until the fiber is started again.
+      */
+    void stopAnimationFiber();
+
+    /**
+      * The animation fiber, which composes each animation frame as it falls due, outside of interrupt context.
+      *
+      * If the fiber falls behind, it catches up by composing the missed frames without showing them,
+      * spending no more than one frame period doing so. Any frames still outstanding are then dropped,
+      * so a costly animation runs more slowly, rather than falling ever further behind.
+      *
+      * @param display The MicroBitDisplay to update.
+      */
+    static void animationTask(void *display);
+
     /**
       *  Periodic callback, that we use to perform any animations we have running.
       */
@@ -174,11 +251,16 @@ class MicroBitDisplay : public MicroBitComponent
     void render();
 
     /**
-      * Renders the current image, and drops the fourth frame to allow for
-      * sensors that require the display to operate.
+      * Renders the display whilst interleaving light readings, which are taken once every
+      * MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES frames. All other frames are rendered back to back.
       */
     void renderWithLightSense();
 
+    /**
+      * Calculates the bit pattern to write for each bit plane of the current row, for greyscale rendering.
+      */
+    void updateGreyscalePlanes();
+
     /**
       * Translates a bit mask into a timer interrupt that gives the appearence of greyscale.
       */
@@ -549,6 +631,17 @@ public:
       */
     int getBrightness();
 
+    /**
+      * Fetches the time taken to compose the most recent animation frame, when frames are composed in a fiber.
+      *
+      * @return the time in microseconds, or 0 if no frame has been composed by the animation fiber.
+      *
+      * @code
+      * display.getAnimationStepTime(); //the cost of the last scroll step
+      * @endcode
+      */
+    int getAnimationStepTime();
+
     /**
       * Rotates the display to the given position.
       *
@@ -567,7 +660,8 @@ public:
       * display.enable(); //Enables the display mechanics
       * @endcode
       *
-      * @note Only enables the display if the display is currently disabled.
+      * @note Only enables the display if the display is currently disabled. The animation fiber is created
+      *       here in either case, if it does not yet exist.
       */
     void enable();
 
@@ -3,6 +3,7 @@
 
 #include "MicroBitConfig.h"
 #include "MicroBitFlash.h"
+#include "MicroBitComponent.h"
 
 
 // Configuration options.
@@ -14,6 +15,7 @@
 #define MB_WRITE    0x02
 #define MB_CREAT    0x04
 #define MB_APPEND   0x08
+#define MB_LOG      0x10
 
 // seek() flags.
 #define MB_SEEK_SET 0x01
@@ -22,6 +24,7 @@
 
 // Status flags
 #define MBFS_STATUS_INITIALISED           0x01
+#define MBFS_STATUS_PAGES_COUNTED         0x02
 
 // FileTable codes
 #define MBFS_UNUSED                       0xFFFF
@@ -32,6 +35,7 @@
 #define MBFS_DIRECTORY_ENTRY_FREE         0x8000
 #define MBFS_DIRECTORY_ENTRY_VALID        0x4000
 #define MBFS_DIRECTORY_ENTRY_DIRECTORY    0x2000
+#define MBFS_DIRECTORY_ENTRY_SUMMARY      0x1000
 #define MBFS_DIRECTORY_ENTRY_NEW          0xffff
 #define MBFS_DIRECTORY_ENTRY_DELETED      0x0000
 
@@ -76,6 +80,11 @@ struct FileDescriptor
     // current file position, in bytes.
     uint32_t seek;
 
+    // a recently used block of this file, and the position of its first byte, so that
+    // sequential access need not walk the file table from the start of the file each time.
+    uint16_t seekBlock;
+    uint32_t seekBlockPosition;
+
     // the current file size. n.b. this may be different to that stored in the DirectoryEntry.
     uint32_t length;
 
@@ -89,8 +98,55 @@ struct FileDescriptor
     FileDescriptor *next;
 
     // Optional writeback cache, to minimise FLASH write operations at the expense of RAM.
+    // The cached bytes belong at the current seek position. cache is NULL if the file has no cache.
     uint16_t cacheLength;
-    uint8_t cache[MBFS_CACHE_SIZE];
+    uint16_t cacheSize;
+    uint8_t *cache;
+};
+
+//
+// A summary of the file table, written to the root directory once all files are closed.
+// It allows the file system to be mounted without scanning the file table, and is
+// invalidated by the first change to the file table after it is written.
+// Laid out as a DirectoryEntry with an empty file name, so it never matches a lookup.
+//
+struct FileSystemSummary
+{
+    uint16_t marker;                            // Always zero (an empty file name).
+    uint16_t lastBlockAllocated;                // The last block allocated, to continue round robin allocation.
+    uint16_t freeBlocks;                        // Number of UNUSED blocks in the file table.
+    uint16_t deletedBlocks;                     // Number of DELETED blocks in the file table.
+    uint16_t fileSystemTableSize;               // Size of the file table (blocks).
+    uint16_t checksum;                          // Sum of the fields above, to detect a partially written summary.
+    uint16_t reserved[2];
+    uint16_t rootBlock;                         // First block of the root directory (DirectoryEntry::first_block).
+    uint16_t flags;                             // MBFS_DIRECTORY_ENTRY_VALID | MBFS_DIRECTORY_ENTRY_SUMMARY.
+    uint32_t fileSystemSize;                    // Size of the file system (DirectoryEntry::length).
+};
+
+//
+// A slot in the RAM index of directory entries, recording where a file in a given directory was last found.
+//
+struct DirectoryIndexEntry
+{
+    // the directory entry of the file.
+    DirectoryEntry *dirent;
+
+    // the first block of the directory holding the file.
+    uint16_t directory;
+};
+
+//
+// The position of an enumeration of a directory, as used by openDirectory() and readDirectory().
+// It is held by the caller, so listing a directory needs no heap memory.
+//
+struct DirectoryIterator
+{
+    // the directory block being read, or MBFS_EOF once every entry has been returned.
+    uint16_t block;
+
+    // the index of the next entry to read within that block.
+    uint16_t entry;
 };
 
 /**
@@ -106,7 +162,7 @@ struct FileDescriptor
   *
   * Only a single instance shoud exist at any given time.
   */
-class MicroBitFileSystem
+class MicroBitFileSystem : public MicroBitComponent
 {
     private:
 
@@ -134,6 +190,23 @@ class MicroBitFileSystem
     // Chain of open files.
     FileDescriptor *openFiles;
 
+    // The number of bytes of RAM currently allocated to writeback caches.
+    uint16_t cacheBytesAllocated;
+
+    // The number of UNUSED and DELETED blocks in each physical page, mirroring the file table.
+    // Allocated when the file system is mounted. If NULL, the file table is scanned instead.
+    uint8_t *pageFreeBlocks;
+    uint8_t *pageDeletedBlocks;
+
+    // The summary of the file table held in the root directory, or NULL if there is no up to date summary.
+    FileSystemSummary *mountSummary;
+
+#if MBFS_DIRECTORY_INDEX_SIZE > 0
+    // Hash table of recently used directory entries, indexed by directory and filename.
+    // Slots are checked against FLASH before use, so a stale slot only costs a directory scan.
+    DirectoryIndexEntry directoryIndex[MBFS_DIRECTORY_INDEX_SIZE];
+#endif
+
     /**
       * Initialize the flash storage system
       *
@@ -162,6 +235,17 @@ class MicroBitFileSystem
       */
     uint16_t getFreeBlock();
 
+    /**
+      * Find a run of consecutive UNUSED logical blocks.
+      * The run starting at the given block is preferred, so that a file can be extended in place.
+      * Otherwise, the table is searched round robin from the last block allocated, to even out wear.
+      *
+      * @param start The preferred first block of the run.
+      * @param count The number of blocks required.
+      * @return the first block of the run on success, or zero if no such run is available.
+      */
+    uint16_t getFreeBlocks(uint16_t start, int count);
+
     /**
     * Allocates a free physical block.
     * A round robin algorithm is used to even out the wear on the physical device.
@@ -169,6 +253,40 @@ class MicroBitFileSystem
     */
     uint32_t* getFreePage();
 
+    /**
+    * Rebuild the per-page counts of UNUSED and DELETED blocks from the file table, allocating them if necessary.
+    */
+    void buildPageSummary();
+
+    /**
+    * Determine how many blocks of a physical page are UNUSED, and how many are DELETED.
+    *
+    * @param page The number of the first block in the page.
+    * @param freeBlocks Set to the number of UNUSED blocks in the page.
+    * @param deletedBlocks Set to the number of DELETED blocks in the page.
+    */
+    void getPageSummary(uint16_t page, int *freeBlocks, int *deletedBlocks);
+
+    /**
+      * Calculate the checksum of a file system summary.
+      *
+      * @param summary The summary to check.
+      * @return the checksum of the summary.
+      */
+    uint16_t getSummaryChecksum(FileSystemSummary *summary);
+
+    /**
+      * Record a summary of the file table in the root directory, if there is not already an up to date one.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the root directory is full.
+      */
+    int writeSummary();
+
+    /**
+      * Mark the summary of the file table as out of date, as the file table is about to change.
+      */
+    void invalidateSummary();
+
     /**
     * Retrieve the DirectoryEntry assoiated with the given file's DIRECTORY (not the file itself).
     *
@@ -185,6 +303,24 @@ class MicroBitFileSystem
     * @return A pointer to the DirectoryEntry for the given file, or NULL if no entry is found.
     */
     DirectoryEntry* getDirectoryEntry(char const * filename, const DirectoryEntry *directory = NULL);
+
+    /**
+    * Record the location of a directory entry in the RAM directory index, so that it can be found without a directory scan.
+    * Does nothing if MBFS_DIRECTORY_INDEX_SIZE is zero.
+    *
+    * @param dirent The directory entry to record.
+    * @param directory The directory holding the entry.
+    */
+    void indexDirectoryEntry(DirectoryEntry *dirent, const DirectoryEntry *directory);
+
+    /**
+    * Determine the slot of the RAM directory index used for the given file.
+    *
+    * @param file The name of the file, without any path.
+    * @param directory The directory holding the file.
+    * @return The index of the slot for this file.
+    */
+    int getDirectoryIndexSlot(char const * file, const DirectoryEntry *directory);
     
     /**
     * Create a new DirectoryEntry with the given filename and flags.
@@ -224,6 +360,22 @@ class MicroBitFileSystem
     */
     int recycleFileTable();
 
+    /**
+    * Determines if the given block is fully erased, such that it can be reused without a page erase.
+    *
+    * @param block The block to test.
+    * @return true if every byte of the block is erased, false otherwise.
+    */
+    bool isBlockErased(uint16_t block);
+
+    /**
+    * Performs one step of garbage collection: erasing one page holding deleted blocks, or once all deleted
+    * blocks are erased, refreshing one page of the file table so that they are marked UNUSED.
+    *
+    * @return MICROBIT_OK if some work was done, or MICROBIT_NO_DATA if there was nothing to collect.
+    */
+    int collectGarbage();
+
     /**
     * Retrieve a memory pointer for the start of the physical memory page containing the given block.
     *
@@ -251,6 +403,20 @@ class MicroBitFileSystem
     */
     uint16_t getNextFileBlock(uint16_t block);
 
+    /**
+    * Retrieve the block of a file holding its current seek position.
+    *
+    * The walk starts from the last block used by this file descriptor if it lies at or before the seek position,
+    * or from the start of the file otherwise.
+    *
+    * @param file The file descriptor to search.
+    *
+    * @param position Set to the position, in bytes, of the first byte of the returned block.
+    *
+    * @return The block number holding the current seek position.
+    */
+    uint16_t getSeekBlock(FileDescriptor *file, uint32_t *position);
+
     /**
     * Determine the logical block that contains the given address.
     *
@@ -301,6 +467,16 @@ class MicroBitFileSystem
       */
     int writeBack(FileDescriptor *file);
 
+    /**
+      * Allocate a writeback cache for the given file, replacing any it already has.
+      * The cache may be smaller than requested, if MBFS_CACHE_BUDGET would otherwise be exceeded.
+      *
+      * @param file File descriptor to allocate a cache for. Any data in its existing cache must already have been written back.
+      * @param size The requested size of the cache, in bytes. Zero releases the cache.
+      * @return The size of the cache allocated, in bytes.
+      */
+    int allocateCache(FileDescriptor *file, int size);
+
     /**
       * Write a given buffer to the file provided.
       * 
@@ -331,18 +507,27 @@ class MicroBitFileSystem
       */
     MicroBitFileSystem(uint32_t flashStart = 0, int flashPages = 0);
 
+    /**
+      * Periodic callback from the MicroBit scheduler.
+      * Erases pages holding deleted blocks in the background, one step at a time, if MBFS_BACKGROUND_GC is enabled.
+      */
+    virtual void idleTick();
+
     /**
       * Open a new file, and obtain a new file handle (int) to
       * read/write/seek the file. The flags are:
       *  - MB_READ : read from the file.
       *  - MB_WRITE : write to the file.
       *  - MB_CREAT : create a new file, if it doesn't already exist.
+      *  - MB_APPEND : start with the seek position at the end of the file.
+      *  - MB_LOG : append-only. Every write() goes to the end of the file, so only ever fills erased FLASH,
+      *    and the next block is linked as soon as one is filled. Best used with MB_WRITE for data logging.
       *
       * If a file is opened that doesn't exist, and MB_CREAT isn't passed,
       * an error is returned, otherwise the file is created.
       *
       * @param filename name of the file to open, must contain only printable characters.
-      * @param flags One or more of MB_READ, MB_WRITE or MB_CREAT. 
+      * @param flags One or more of MB_READ, MB_WRITE, MB_CREAT, MB_APPEND or MB_LOG.
       * @return return the file handle,MICROBIT_NOT_SUPPORTED if the file system has
       *         not been initialised MICROBIT_INVALID_PARAMETER if the filename is
       *         too large, MICROBIT_NO_RESOURCES if the file system is full.
@@ -421,6 +606,26 @@ class MicroBitFileSystem
       */
     int seek(int fd, int offset, uint8_t flags);
 
+    /**
+      * Set the size of the writeback cache used for an open file.
+      *
+      * Writes smaller than the cache are gathered in RAM, and written to FLASH once the cache is full,
+      * or a block boundary is reached. Any cached data is written back before the cache is resized.
+      * The total RAM used is bounded by MBFS_CACHE_BUDGET.
+      *
+      * @param fd file handle, obtained with open()
+      * @param size the requested cache size in bytes, up to MBFS_BLOCK_SIZE. Zero disables caching for this file.
+      * @return the size of the cache now in use on success, MICROBIT_NOT_SUPPORTED if the file system
+      *         is not intiialised, MICROBIT_INVALID_PARAMETER if the size is invalid or the file handle is invalid.
+      *
+      * @code
+      * MicroBitFileSystem f;
+      * int fd = f.open("log.txt", MB_WRITE | MB_CREAT);
+      * f.setCacheSize(fd, MBFS_BLOCK_SIZE);
+      * @endcode
+      */
+    int setCacheSize(int fd, int size);
+
     /**
       * Write data to the file.
       *
@@ -469,6 +674,65 @@ class MicroBitFileSystem
       */
     int read(int fd, uint8_t* buffer, int size);
 
+    /**
+      * Obtain direct, read-only access to part of a file's contents, without copying.
+      *
+      * Files are held in memory mapped FLASH, so their contents can be read in place. This returns a pointer to
+      * the byte at the given offset, and the number of bytes from there that are contiguous in memory.
+      * Where a file's blocks are allocated consecutively, this may span several blocks, or the whole file.
+      * Call repeatedly, advancing the offset by the value returned each time, to visit every extent of the file.
+      *
+      * The seek position of the file is not affected. Any data held in the file's writeback cache is written back first.
+      *
+      * @param fd File handle, obtained with open()
+      * @param offset the position in the file, in bytes, of the first byte to access.
+      * @param data set to the address of the byte at the given offset.
+      * @return the number of contiguous bytes available at data, zero if the offset is at the end of the file,
+      *         MICROBIT_NOT_SUPPORTED if the file system is not initialised, or MICROBIT_INVALID_PARAMETER
+      *         if the file handle is invalid or the offset lies beyond the end of the file.
+      *
+      * @note The memory returned must not be written to, and reflects the file contents only until the file is next written or removed.
+      *
+      * @code
+      * MicroBitFileSystem f;
+      * int fd = f.open("image.bin", MB_READ);
+      * uint8_t *data;
+      * uint32_t offset = 0;
+      * int length;
+      *
+      * while ((length = f.map(fd, offset, &data)) > 0)
+      * {
+      *     process(data, length);
+      *     offset += length;
+      * }
+      * @endcode
+      */
+    int map(int fd, uint32_t offset, uint8_t **data);
+
+    /**
+      * Reserve FLASH for a file up front, so that it can grow to at least the given size.
+      *
+      * Blocks are allocated as a single physically contiguous run where possible, following the
+      * last block of the file if that space is free. Later writes then fill the reserved blocks
+      * without further allocation, and a contiguous file can be accessed in one piece with map().
+      * If no contiguous run is available, blocks are allocated individually.
+      *
+      * The length of the file is not changed. Reserved blocks remain part of the file until it is removed.
+      *
+      * @param fd File handle, obtained with open()
+      * @param size The number of bytes the file should be able to hold.
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+      *         MICROBIT_INVALID_PARAMETER if the file handle is invalid or not open for writing, or
+      *         MICROBIT_NO_RESOURCES if the file system is full.
+      *
+      * @code
+      * MicroBitFileSystem f;
+      * int fd = f.open("image.bin", MB_WRITE | MB_CREAT);
+      * f.preallocate(fd, 4096);
+      * @endcode
+      */
+    int preallocate(int fd, uint32_t size);
+
     /**
       * Remove a file from the system, and free allocated assets
       * (including assigned blocks which are returned for use by other files).
@@ -494,6 +758,53 @@ class MicroBitFileSystem
     * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the path is invalid, or MICROBT_NO_RESOURCES if the FileSystem is full.
     */
     int createDirectory(char const *name);
+
+    /**
+      * Prepare to list the contents of a directory.
+      *
+      * No memory is allocated: all of the state of the listing is held in the given iterator.
+      *
+      * @param name The fully qualified name of the directory, or NULL or "" for the root directory.
+      *             A trailing "/" is optional.
+      * @param it The iterator to initialise, to be passed to readDirectory().
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+      *         or MICROBIT_INVALID_PARAMETER if the directory does not exist.
+      */
+    int openDirectory(char const *name, DirectoryIterator &it);
+
+    /**
+      * Retrieve the next file or directory in a listing started with openDirectory().
+      *
+      * The directory blocks are walked once, in order. The entry returned refers directly to FLASH,
+      * so is only valid until the file system is next modified. Its length is that last written to FLASH,
+      * which is 0xffffffff for a file that has been created but not yet closed. Use stat() for the current length.
+      *
+      * @param it An iterator initialised by openDirectory().
+      * @return The next DirectoryEntry in the directory, or NULL if there are no more entries.
+      *
+      * @code
+      * MicroBitFileSystem f;
+      * DirectoryIterator it;
+      * DirectoryEntry const *dirent;
+      *
+      * if (f.openDirectory("logs", it) == MICROBIT_OK)
+      *     while ((dirent = f.readDirectory(it)) != NULL)
+      *         printf("%s\n", dirent->file_name);
+      * @endcode
+      */
+    DirectoryEntry const * readDirectory(DirectoryIterator &it);
+
+    /**
+      * Determine the length of a file, and optionally retrieve its DirectoryEntry, without opening it.
+      *
+      * The length reported includes any data written to a file that is currently open.
+      *
+      * @param filename The fully qualified name of the file or directory.
+      * @param dirent If not NULL, set to the DirectoryEntry of the file in FLASH, which is valid until the file system is next modified.
+      * @return The length of the file in bytes, MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+      *         or MICROBIT_INVALID_PARAMETER if the file does not exist.
+      */
+    int stat(char const *filename, DirectoryEntry const **dirent = NULL);
 };
 
 #endif
@@ -5,6 +5,11 @@
 
 #define PAGE_SIZE 1024
 
+// The largest number of words flash_write() burns in a single operation.
+// Each burn is a separate SoftDevice request when BLE is running, so longer runs are much faster,
+// at the cost of 4 bytes of stack per word.
+#define MICROBIT_FLASH_BURN_WORDS 32
+
 class MicroBitFlash
 {
     private:
@@ -31,6 +31,27 @@ DEALINGS IN THE SOFTWARE.
 
 #define MICROBIT_I2C_MAX_RETRIES 9
 
+#define MICROBIT_I2C_IRQ_PRIORITY 3
+
+/**
+  * A single I2C transfer, to be queued with MicroBitI2C::submit().
+  *
+  * Any bytes in txData are written first, followed by a read of rxLength bytes into rxData using a
+  * repeated start, so that a register of a device can be read in a single transaction.
+  */
+struct I2CTransaction
+{
+    int address;                                // 8-bit I2C slave address.
+    const uint8_t *txData;                      // Bytes to write, or NULL.
+    int txLength;                               // Number of bytes to write.
+    uint8_t *rxData;                            // Buffer to read into, or NULL.
+    int rxLength;                               // Number of bytes to read.
+    void (*callback)(I2CTransaction *);         // Called from interrupt context upon completion, or NULL.
+    void *context;                              // For use by the callback.
+    volatile int status;                        // MICROBIT_BUSY while queued, then MICROBIT_OK or MICROBIT_I2C_ERROR.
+    I2CTransaction *next;                       // Used internally to queue transactions.
+};
+
 /**
   * Class definition for MicroBitI2C.
   *
@@ -47,8 +68,58 @@ class MicroBitI2C : public I2C
 {
     uint8_t retries;
 
+    // Queue of transactions submitted with submit(). The head of the queue is in progress.
+    I2CTransaction * volatile queueHead;
+    I2CTransaction *queueTail;
+
+    // Progress through the transaction in progress.
+    int txIndex;
+    int rxIndex;
+    bool transactionError;
+    uint8_t transactionRetries;
+
+    // Set while a blocking read() or write() owns the bus, including across a repeated start.
+    volatile bool busLocked;
+
+    /**
+      * Waits for any queued transactions to complete, then claims the bus for a blocking transfer.
+      */
+    void lockBus();
+
+    /**
+      * Releases the bus after a blocking transfer, starting any transactions queued meanwhile.
+      *
+      * @param repeated true if the transfer ended without a stop, so the bus remains claimed.
+      */
+    void unlockBus(bool repeated);
+
+    /**
+      * Resets and restarts the I2C hardware, to recover from the PAN56 lockup.
+      */
+    void resetBus();
+
+    /**
+      * Begins the transaction at the head of the queue.
+      */
+    void startTransaction();
+
+    /**
+      * Configures the hardware to receive the bytes of the current transaction.
+      */
+    void startReceive();
+
+    /**
+      * Completes the transaction at the head of the queue, retrying it if it failed,
+      * and begins the next.
+      *
+      * @param status MICROBIT_OK on success, or MICROBIT_I2C_ERROR.
+      */
+    void completeTransaction(int status);
+
     public:
 
+    static MicroBitI2C *instance;
+
     /**
       * Constructor.
       *
@@ -102,6 +173,36 @@ class MicroBitI2C : public I2C
       * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved write failure is detected.
       */
     int write(int address, const char *data, int length, bool repeated = false);
+
+    /**
+      * Queues a transaction to be performed in the background, driven by interrupts.
+      * Transactions are performed in the order submitted, so transfers for several devices can be
+      * queued together without blocking the caller.
+      *
+      * The transaction must remain valid until it completes. Its status is MICROBIT_BUSY until then.
+      * Blocking calls to read() and write() wait for any queued transactions to complete.
+      *
+      * @param t The transaction to perform.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the transaction is invalid.
+      *
+      * @code
+      * void onSample(I2CTransaction *t) { ... }
+      *
+      * uint8_t reg = 0x01;
+      * uint8_t data[6];
+      * I2CTransaction t = { 0x1C, &reg, 1, data, 6, onSample, NULL };
+      * i2c.submit(&t);
+      * @endcode
+      */
+    int submit(I2CTransaction *t);
+
+    /**
+      * Interrupt handler for the I2C hardware, driving the transaction in progress.
+      *
+      * @note should only be called from the TWI interrupt handler.
+      */
+    void onInterrupt();
 };
 
 #endif
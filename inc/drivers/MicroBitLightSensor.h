@@ -47,9 +47,15 @@ DEALINGS IN THE SOFTWARE.
 class MicroBitLightSensor
 {
 
-    //contains the results from each section of the display
+    //contains a moving average of the readings from each section of the display, scaled by MICROBIT_LIGHT_SENSOR_SMOOTHING
     int results[MICROBIT_LIGHT_SENSOR_CHAN_NUM];
 
+    //a bit mask of the sections of the display that have been read at least once
+    uint8_t sampled;
+
+    //the light level last reported by a MICROBIT_DISPLAY_EVT_LIGHT_SENSE event, or -1 if none has been
+    int lastLevel;
+
     //holds the current channel (also used to index the results array)
     uint8_t chan;
 
@@ -66,7 +72,8 @@ class MicroBitLightSensor
       * MICROBIT_LIGHT_SENSOR_AN_SET_TIME after.
       *
       * It will then read from the currently selected channel using the AnalogIn
-      * that was configured in the startSensing method.
+      * that was configured in the startSensing method, and update the moving
+      * average for that channel.
       */
     void analogReady();
 
@@ -117,8 +124,11 @@ class MicroBitLightSensor
     int read();
 
     /**
-      * The method that is invoked by sending MICROBIT_DISPLAY_EVT_LIGHT_SENSE
-      * using the id MICROBIT_ID_DISPLAY.
+      * Takes a light reading from the next section of the display. This is invoked by MicroBitDisplay
+      * whilst the display is held dark, in DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE.
+      *
+      * When the resulting light level differs from the one last reported, a MICROBIT_DISPLAY_EVT_LIGHT_SENSE
+      * event is raised using the id MICROBIT_ID_DISPLAY.
       *
       * @note this can be manually driven by calling this member function, with
       *       a MicroBitEvent using the CREATE_ONLY option of the MicroBitEvent
@@ -129,7 +139,7 @@ class MicroBitLightSensor
     /**
       * A destructor for MicroBitLightSensor.
       *
-      * The destructor removes the listener, used by MicroBitLightSensor from the default EventModel.
+      * The destructor cancels any reading in progress.
       */
     ~MicroBitLightSensor();
 };
@@ -33,6 +33,18 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitListener.h"
 #include "EventModel.h"
 
+// Message bus status events, raised with an ID of MICROBIT_ID_MESSAGE_BUS.
+#define MESSAGE_BUS_EVT_HIGH_WATER                  1
+
+/**
+  * Records the number of events from a given source that the message bus has dropped.
+  */
+struct MicroBitEventDropCount
+{
+    uint16_t        id;             // The ID of the component whose events have been dropped.
+    uint16_t        count;          // The number of events dropped from that component.
+};
+
 /**
   * Class definition for the MicroBitMessageBus.
   *
@@ -139,25 +151,121 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     virtual int remove(MicroBitListener *newListener);
 
+    /**
+      * Determines the total number of events that have been dropped because the event queue was full.
+      *
+      * @return The number of events dropped since this MicroBitMessageBus was created.
+      *
+      * @note Events dropped by individual listeners are recorded in the dropped field of each MicroBitListener.
+      */
+    uint32_t getDropCount();
+
+    /**
+      * Determines the number of events from the given source that have been dropped because the event queue was full.
+      *
+      * @param id The ID of the component of interest.
+      *
+      * @return The number of events dropped from the given component, or 0 if it is not one of the
+      *         MESSAGE_BUS_DROP_SOURCES sources with recorded drops.
+      */
+    int getDropCount(uint16_t id);
+
+    /**
+      * Determines the greatest number of events that have been waiting on the event queue at any one time.
+      *
+      * @return The high water mark of the event queue.
+      */
+    int getQueueHighWaterMark();
+
 	private:
 
-    MicroBitListener            *listeners;		    // Chain of active listeners.
+    MicroBitListener            *wildcardListeners; // Chain of active listeners registered for MICROBIT_ID_ANY.
+    MicroBitListener            *listeners[MESSAGE_BUS_LISTENER_BUCKETS];   // Chains of active listeners, indexed by event ID.
+    uint32_t                    deletePending;      // Chains holding listeners marked for deletion. Bit 0 is the wildcard chain, bit n+1 is listeners[n].
     MicroBitEventQueueItem      *evt_queue_head;    // Head of queued events to be processed.
     MicroBitEventQueueItem      *evt_queue_tail;    // Tail of queued events to be processed.
     uint16_t                    nonce_val;          // The last nonce issued.
     uint16_t                    queueLength;        // The number of events currently waiting to be processed.
+    uint16_t                    queueHighWater;     // The greatest number of events that have been waiting to be processed.
+    uint32_t                    dropCount;          // The total number of events dropped because the queue was full.
+    bool                        deleteRetrying;     // Set whilst we are called on every idle pass, to retry removing busy listeners.
+#if MESSAGE_BUS_DROP_SOURCES > 0
+    MicroBitEventDropCount      drops[MESSAGE_BUS_DROP_SOURCES];  // Dropped event counts for the sources with the most drops.
+#endif
+#if MESSAGE_BUS_HIGH_WATER_MARK > 0
+    bool                        highWaterRaised;    // Set once a high water event has been raised, until the queue drains.
+#endif
+
+    /**
+      * Records that an event has been dropped because the event queue was full.
+      *
+      * @param evt The event that was dropped.
+      */
+    void recordDrop(MicroBitEvent &evt);
+
+    /**
+      * Determines the chain of listeners that holds listeners for the given event ID.
+      *
+      * @param id The event ID of interest.
+      *
+      * @return A pointer to the head of the chain used to store listeners for the given ID.
+      */
+    MicroBitListener** listenerChain(uint16_t id);
+
+	/**
+      * Internal function, used to deliver the given event to all relevant recipients held in the
+      * given chain of listeners.
+	  *
+      * @param l The head of the chain of listeners to process.
+      *
+	  * @param evt The event to send.
+      *
+      * @param urgent The type of listeners to process.
+      *
+      * @param batch If true, the event is queued on any standard MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY listeners
+      *              rather than delivered, for later delivery by dispatchBatch(). Defaults to false.
+      *
+      * @return 1 if all matching listeners were processed, 0 if further processing is required.
+      */
+	int processChain(MicroBitListener *l, MicroBitEvent &evt, bool urgent, bool batch = false);
+
+    /**
+      * Delivers the events gathered by processChain() in batch mode, by invoking each listener that
+      * has events queued but is not already busy. Each listener then processes its run of events in turn.
+      */
+    void dispatchBatch();
 
     /**
       * Cleanup any MicroBitListeners marked for deletion from the list.
       *
-      * @return The number of listeners removed from the list.
+      * Only those chains recorded in deletePending as holding listeners marked for deletion are inspected,
+      * so this costs nothing when no listeners have been removed.
+      *
+      * @return The number of listeners marked for deletion that are still busy, and so could not yet be removed.
       */
     int deleteMarkedListeners();
 
+    /**
+      * Determines if all standard listeners that would receive the given event have been created with
+      * MESSAGE_BUS_LISTENER_COALESCE, such that only the latest identical event need be kept on the queue.
+      *
+      * @param l The head of the chain of listeners to inspect.
+      *
+      * @param evt The event of interest.
+      *
+      * @param matched Incremented for each listener that would receive the event.
+      *
+      * @return true if all matching listeners in the chain coalesce events, false otherwise.
+      */
+    bool coalescingChain(MicroBitListener *l, MicroBitEvent &evt, int &matched);
+
     /**
       * Queue the given event for processing at a later time.
       * Add the given event at the tail of our queue.
       *
+      * If all of the listeners that will receive the event have been created with MESSAGE_BUS_LISTENER_COALESCE,
+      * and an identical event (same source and value) is already queued, that event is replaced with the given one.
+      *
       * @param The event to queue.
       */
     void queueEvent(MicroBitEvent &evt);
@@ -169,11 +277,20 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     MicroBitEventQueueItem* dequeueEvent();
 
+    /**
+      * Extract all events from the event queue at once.
+      *
+      * @return a pointer to the MicroBitEventQueueItem that was at the head of the list, or NULL if the queue was empty.
+      */
+    MicroBitEventQueueItem* dequeueEvents();
+
     /**
       * Periodic callback from MicroBit.
       *
       * Process at least one event from the event queue, if it is not empty.
       * We then continue processing events until something appears on the runqueue.
+      *
+      * If MESSAGE_BUS_BATCH_DISPATCH is enabled, all events on the queue are processed together instead.
       */
     virtual void idleTick();
 };
@@ -49,6 +49,8 @@ class MicroBitMultiButton : public MicroBitComponent
 {
     uint16_t    button1;        // ID of the first button we're monitoring
     uint16_t    button2;        // ID of the second button we're monitoring
+    MicroBitButton *subButton1; // The first button, if it informs us directly (MICROBIT_MULTI_BUTTON_ATTACHED).
+    MicroBitButton *subButton2; // The second button, if it informs us directly (MICROBIT_MULTI_BUTTON_ATTACHED).
     MicroBitButtonEventConfiguration eventConfiguration;    // Do we want to generate high level event (clicks), or defer this to another service.
 
     /**
@@ -134,6 +136,30 @@ class MicroBitMultiButton : public MicroBitComponent
       */
     MicroBitMultiButton(uint16_t button1, uint16_t button2, uint16_t id);
 
+    /**
+      * Constructor.
+      *
+      * Create a representation of a virtual button, that generates events based upon the combination
+      * of two given buttons. The buttons inform this MicroBitMultiButton of each change in their state directly
+      * from their systemTick(), so that no listeners are needed, and no events are dispatched to reach us.
+      *
+      * @param button1 the first button to watch.
+      *
+      * @param button2 the second button to watch.
+      *
+      * @param id the unique EventModel id of this MicroBitMultiButton instance.
+      *
+      * @code
+      * multiButton(buttonA, buttonB, MICROBIT_ID_BUTTON_AB);
+      * @endcode
+      */
+    MicroBitMultiButton(MicroBitButton &button1, MicroBitButton &button2, uint16_t id);
+
+    /**
+      * Destructor. Stops listening to, or being informed by, the two buttons.
+      */
+    ~MicroBitMultiButton();
+
     /**
       * Tests if this MicroBitMultiButton instance is virtually pressed.
       *
@@ -162,6 +188,23 @@ class MicroBitMultiButton : public MicroBitComponent
       */
     void setEventConfiguration(MicroBitButtonEventConfiguration config);
 
+    /**
+      * Updates the state of this MicroBitMultiButton after a change in the state of one of its buttons,
+      * and generates any events for the combination.
+      *
+      * @param button the id of the button whose state has changed.
+      *
+      * @param value the MicroBitButton event describing the change (MICROBIT_BUTTON_EVT_DOWN, MICROBIT_BUTTON_EVT_UP or MICROBIT_BUTTON_EVT_HOLD).
+      */
+    void subButtonEvent(uint16_t button, uint16_t value);
+
+    /**
+      * Stops being informed by the given button, typically as it is destroyed.
+      *
+      * @param button the button to forget.
+      */
+    void detach(MicroBitButton *button);
+
     private:
 
     /**
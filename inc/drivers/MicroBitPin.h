@@ -29,6 +29,7 @@ DEALINGS IN THE SOFTWARE.
 #include "mbed.h"
 #include "MicroBitConfig.h"
 #include "MicroBitComponent.h"
+#include "TimedInterruptIn.h"
                                                         // Status Field flags...
 #define IO_STATUS_DIGITAL_IN                0x01        // Pin is configured as a digital input, with no pull up.
 #define IO_STATUS_DIGITAL_OUT               0x02        // Pin is configured as a digital output
@@ -37,6 +38,12 @@ DEALINGS IN THE SOFTWARE.
 #define IO_STATUS_TOUCH_IN                  0x10        // Pin is a makey-makey style touch sensor
 #define IO_STATUS_EVENT_ON_EDGE             0x20        // Pin will generate events on pin change
 #define IO_STATUS_EVENT_PULSE_ON_EDGE       0x40        // Pin will generate events on pin change
+#define IO_STATUS_EVENT_CAPTURE             0x80        // Pin will timestamp edges in hardware, into a buffer
+#define IO_STATUS_EVENT_COUNT               0x100       // Pin will count edges, without generating an event for each
+#define IO_STATUS_EDGE_WINDOW               0x200       // Pin will generate an event summarising the edges counted in each window
+
+// The modes in which this pin is driven by a TimedInterruptIn.
+#define IO_STATUS_TIMED_INTERRUPT           (IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE | IO_STATUS_EVENT_CAPTURE | IO_STATUS_EVENT_COUNT)
 
 //#defines for each edge connector pin
 #define MICROBIT_PIN_P0                     P0_3        //P0 is the left most pad (ANALOG/DIGITAL) used to be P0_3 on green board
@@ -69,11 +76,15 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_PIN_EVENT_ON_EDGE          1
 #define MICROBIT_PIN_EVENT_ON_PULSE         2
 #define MICROBIT_PIN_EVENT_ON_TOUCH         3
+#define MICROBIT_PIN_EVENT_ON_CAPTURE       4
+#define MICROBIT_PIN_EVENT_ON_COUNT         5
 
 #define MICROBIT_PIN_EVT_RISE               2
 #define MICROBIT_PIN_EVT_FALL               3
 #define MICROBIT_PIN_EVT_PULSE_HI           4
 #define MICROBIT_PIN_EVT_PULSE_LO           5
+#define MICROBIT_PIN_EVT_CAPTURE            6
+#define MICROBIT_PIN_EVT_EDGE_COUNT         7
 
 /**
   * Pin capabilities enum.
@@ -111,7 +122,9 @@ class MicroBitPin : public MicroBitComponent
 
     /**
       * Performs a check to ensure that the current Pin is in control of a
-      * DynamicPwm instance, and if it's not, allocates a new DynamicPwm instance.
+      * DynamicPwm instance, and if it's not, obtains one from the pool held by DynamicPwm.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if every PWM channel is in use.
       */
     int obtainAnalogChannel();
 
@@ -133,6 +146,20 @@ class MicroBitPin : public MicroBitComponent
       */
     void pulseWidthEvent(int eventValue);
 
+    /**
+      * Records an edge timestamped in hardware whilst in the MICROBIT_PIN_EVENT_ON_CAPTURE mode, and
+      * signals its arrival if the buffer was empty.
+      *
+      * @param level The level of the pin after the edge.
+      */
+    void captureEvent(int level);
+
+    /**
+      * Periodic callback from the system timer whilst in the MICROBIT_PIN_EVENT_ON_COUNT mode. Generates
+      * a single MICROBIT_PIN_EVT_EDGE_COUNT event summarising the edges seen during the last window.
+      */
+    virtual void systemTick();
+
     /**
       * This member function will construct an TimedInterruptIn instance, and configure
       * interrupts for rise and fall.
@@ -223,8 +250,8 @@ class MicroBitPin : public MicroBitComponent
       *
       * @param value the level to set on the output pin, in the range 0 - 1024
       *
-      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, or MICROBIT_NOT_SUPPORTED
-      *         if the given pin does not have analog capability.
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, MICROBIT_NO_RESOURCES if every
+      *         PWM channel is in use, or MICROBIT_NOT_SUPPORTED if the given pin does not have analog capability.
       */
     int setAnalogValue(int value);
 
@@ -292,9 +319,13 @@ class MicroBitPin : public MicroBitComponent
       * Configures this IO pin as a "makey makey" style touch sensor (if necessary)
       * and tests its current debounced state.
       *
+      * With MICROBIT_PIN_TOUCH_CAPACITIVE, the pin is measured capacitively by a MicroBitTouchSensor shared with
+      * other touched pins, so the pin need not be touched together with GND. Otherwise, it is sampled as a MicroBitButton.
+      *
       * Users can also subscribe to MicroBitButton events generated from this pin.
       *
-      * @return 1 if pin is touched, 0 if not, or MICROBIT_NOT_SUPPORTED if this pin does not support touch capability.
+      * @return 1 if pin is touched, 0 if not, MICROBIT_NO_RESOURCES if no more pins can be measured,
+      *         or MICROBIT_NOT_SUPPORTED if this pin does not support touch capability.
       *
       * @code
       * MicroBitMessageBus bus;
@@ -317,8 +348,8 @@ class MicroBitPin : public MicroBitComponent
       *
       * @param pulseWidth the desired pulse width in microseconds.
       *
-      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, or MICROBIT_NOT_SUPPORTED
-      *         if the given pin does not have analog capability.
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, MICROBIT_NO_RESOURCES if every
+      *         PWM channel is in use, or MICROBIT_NOT_SUPPORTED if the given pin does not have analog capability.
       */
     int setServoPulseUs(int pulseWidth);
 
@@ -374,9 +405,11 @@ class MicroBitPin : public MicroBitComponent
       * MICROBIT_PIN_EVENT_ON_EDGE - Configures this pin to a digital input, and generates events whenever a rise/fall is detected on this pin. (MICROBIT_PIN_EVT_RISE, MICROBIT_PIN_EVT_FALL)
       * MICROBIT_PIN_EVENT_ON_PULSE - Configures this pin to a digital input, and generates events where the timestamp is the duration that this pin was either HI or LO. (MICROBIT_PIN_EVT_PULSE_HI, MICROBIT_PIN_EVT_PULSE_LO)
       * MICROBIT_PIN_EVENT_ON_TOUCH - Configures this pin as a makey makey style touch sensor, in the form of a MicroBitButton. Normal button events will be generated using the ID of this pin.
+      * MICROBIT_PIN_EVENT_ON_CAPTURE - Configures this pin to a digital input, and timestamps every edge in hardware into a buffer, to be collected with readCapture(). A MICROBIT_PIN_EVT_CAPTURE event is generated whenever edges arrive in an empty buffer. Only one pin may use this mode at a time.
+      * MICROBIT_PIN_EVENT_ON_COUNT - Configures this pin to a digital input, and counts edges without generating an event for each. A single MICROBIT_PIN_EVT_EDGE_COUNT event is generated for each window in which edges were seen, where the timestamp is the number of edges in that window. See setEdgeWindow().
       * MICROBIT_PIN_EVENT_NONE - Disables events for this pin.
       *
-      * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_NONE
+      * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_ON_CAPTURE, MICROBIT_PIN_EVENT_ON_COUNT, MICROBIT_PIN_EVENT_NONE
       *
       * @code
       * MicroBitMessageBus bus;
@@ -392,12 +425,81 @@ class MicroBitPin : public MicroBitComponent
       * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_PULSE_HI, onPulse, MESSAGE_BUS_LISTENER_IMMEDIATE)
       * @endcode
       *
-      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the given eventype does not match
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the given eventype does not match,
+      *         MICROBIT_BUSY if MICROBIT_PIN_EVENT_ON_CAPTURE is requested whilst another pin or a software PWM channel is using TIMER1,
+      *         MICROBIT_NOT_SUPPORTED if MICROBIT_PIN_EVENT_ON_CAPTURE is requested whilst MICROBIT_PIN_CAPTURE is disabled,
+      *         or MICROBIT_NO_RESOURCES if MICROBIT_PIN_EVENT_ON_COUNT is requested and the system timer has no free slots.
       *
       * @note In the MICROBIT_PIN_EVENT_ON_PULSE mode, the smallest pulse that was reliably detected was 85us, around 5khz. If more precision is required,
       *       please use the InterruptIn class supplied by ARM mbed.
       */
     int eventOn(int eventType);
+
+    /**
+      * Removes edges timestamped in hardware, whilst in the MICROBIT_PIN_EVENT_ON_CAPTURE mode, oldest first.
+      *
+      * @param edges The location to store the edges.
+      *
+      * @param len The maximum number of edges to read.
+      *
+      * @return The number of edges read, MICROBIT_INVALID_PARAMETER if edges is NULL or len is negative,
+      *         or MICROBIT_NOT_SUPPORTED if this pin is not in the MICROBIT_PIN_EVENT_ON_CAPTURE mode.
+      *
+      * @code
+      * TimedEdge edges[32];
+      *
+      * void onCapture(MicroBitEvent)
+      * {
+      *     int n;
+      *
+      *     while ((n = P0.readCapture(edges, 32)) > 0)
+      *         decode(edges, n);
+      * }
+      *
+      * P0.eventOn(MICROBIT_PIN_EVENT_ON_CAPTURE);
+      * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_CAPTURE, onCapture);
+      * @endcode
+      */
+    int readCapture(TimedEdge *edges, int len);
+
+    /**
+      * Retrieves the total number of edges seen on this pin, whilst in any of the MICROBIT_PIN_EVENT_ON_EDGE,
+      * MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_CAPTURE or MICROBIT_PIN_EVENT_ON_COUNT modes.
+      *
+      * The count is reset whenever the pin leaves these modes. It wraps at 2^31, so intervals
+      * should be measured by taking the difference between two readings.
+      *
+      * @return The number of edges seen, or MICROBIT_NOT_SUPPORTED if this pin is not in one of these modes.
+      *
+      * @code
+      * P0.eventOn(MICROBIT_PIN_EVENT_ON_COUNT);
+      * int revolutions = P0.getEdgeCount() / 2;
+      * @endcode
+      */
+    int getEdgeCount();
+
+    /**
+      * Sets the window over which edges are aggregated into a single MICROBIT_PIN_EVT_EDGE_COUNT event,
+      * whilst in the MICROBIT_PIN_EVENT_ON_COUNT mode. No event is generated for a window without edges.
+      *
+      * @param period The length of the window, in milliseconds. This is rounded to a multiple of the system tick
+      *               period. If 0, no events are generated, but edges are still counted.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is negative, MICROBIT_NOT_SUPPORTED if this pin
+      *         is not in the MICROBIT_PIN_EVENT_ON_COUNT mode, or MICROBIT_NO_RESOURCES if the system timer has no free slots.
+      *
+      * @code
+      * void onCount(MicroBitEvent evt)
+      * {
+      *     int edges = evt.timestamp;
+      * }
+      *
+      * P0.eventOn(MICROBIT_PIN_EVENT_ON_COUNT);
+      * P0.setEdgeWindow(1000);
+      * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_EDGE_COUNT, onCount);
+      * @endcode
+      */
+    int setEdgeWindow(int period);
 };
 
 #endif
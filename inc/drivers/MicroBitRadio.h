@@ -32,8 +32,12 @@ struct FrameBuffer;
 #include "mbed.h"
 #include "MicroBitConfig.h"
 #include "PacketBuffer.h"
+#include "MicroBitRingBuffer.h"
 #include "MicroBitRadioDatagram.h"
 #include "MicroBitRadioEvent.h"
+#include "MicroBitRadioMessage.h"
+#include "MicroBitRadioReliable.h"
+#include "MicroBitRadioMesh.h"
 
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -68,14 +72,41 @@ struct FrameBuffer;
 #define MICROBIT_RADIO_DEFAULT_FREQUENCY        7
 #define MICROBIT_RADIO_MAX_PACKET_SIZE          32
 #define MICROBIT_RADIO_HEADER_SIZE              4
-#define MICROBIT_RADIO_MAXIMUM_RX_BUFFERS       4
+#define MICROBIT_RADIO_MAXIMUM_RX_BUFFERS       4       // The default receive queue depth. See MicroBitRadio::setRxQueueDepth().
+
+// The number of receive buffers needed for a queue of the given depth: enough for the hardware,
+// the queue itself, and the same number again held by the datagram layer awaiting the application.
+#define MICROBIT_RADIO_RX_POOL_SIZE(depth)      (2 * (depth) + 1)
+#define MICROBIT_RADIO_MAXIMUM_TX_BUFFERS       4
+
+// The states of the transceiver, as it is driven by the interrupt handler.
+#define MICROBIT_RADIO_STATE_RECEIVING          0       // Listening for packets.
+#define MICROBIT_RADIO_STATE_TURNAROUND_TO_TX   1       // Disabling the receiver, before transmitting the packets queued.
+#define MICROBIT_RADIO_STATE_TRANSMITTING       2       // Transmitting the packet at the head of the transmit queue.
+#define MICROBIT_RADIO_STATE_TURNAROUND_TO_RX   3       // Disabling the transmitter, before listening once more.
+#define MICROBIT_RADIO_STATE_SLEEPING           4       // Turned off, between the wake windows of a duty cycle.
+
+// The number of duty cycle periods a device may go without hearing a beacon, before it stays awake to resynchronise.
+#define MICROBIT_RADIO_DUTY_CYCLE_SYNC_TIMEOUT  8
+
+// The time, in milliseconds, after which an unanswered request for a timeslot is made again when sharing the radio with BLE.
+#define MICROBIT_RADIO_TIMESLOT_RETRY           2000
 
 // Known Protocol Numbers
 #define MICROBIT_RADIO_PROTOCOL_DATAGRAM        1       // A simple, single frame datagram. a little like UDP but with smaller packets. :-)
 #define MICROBIT_RADIO_PROTOCOL_EVENTBUS        2       // Transparent propogation of events from one micro:bit to another.
+#define MICROBIT_RADIO_PROTOCOL_MESSAGE         3       // A message larger than a single frame, sent as a sequence of fragments.
+#define MICROBIT_RADIO_PROTOCOL_RELIABLE        4       // Acknowledged, ordered delivery of frames to a single micro:bit.
+#define MICROBIT_RADIO_PROTOCOL_BEACON          5       // The network time, broadcast by the coordinator of a duty cycle.
+#define MICROBIT_RADIO_PROTOCOL_MESH            6       // A packet flooded across a multi-hop mesh.
 
 // Events
 #define MICROBIT_RADIO_EVT_DATAGRAM             1       // Event to signal that a new datagram has been received.
+#define MICROBIT_RADIO_EVT_TX_COMPLETE          2       // Event to signal that a packet has been transmitted.
+#define MICROBIT_RADIO_EVT_MESSAGE              3       // Event to signal that a complete message has been received.
+#define MICROBIT_RADIO_EVT_RELIABLE_DATA        4       // Event to signal that a reliable frame has been received.
+#define MICROBIT_RADIO_EVT_RELIABLE_FAILED      5       // Event to signal that a reliable frame could not be delivered.
+#define MICROBIT_RADIO_EVT_MESH                 6       // Event to signal that a packet has been received from the mesh.
 
 
 struct FrameBuffer
@@ -88,20 +119,119 @@ struct FrameBuffer
     uint8_t         payload[MICROBIT_RADIO_MAX_PACKET_SIZE];    // User / higher layer protocol data
     FrameBuffer     *next;                              // Linkage, to allow this and other protocols to queue packets pending processing.
     int             rssi;                               // Received signal strength of this frame.
+
+    /**
+      * Releases a FrameBuffer. Buffers taken from the radio's receive pool are returned to it,
+      * so that packets returned by MicroBitRadio::recv() may be deleted as any other.
+      *
+      * @param p The buffer to release.
+      */
+    static void operator delete(void *p);
 };
 
 
 class MicroBitRadio : MicroBitComponent
 {
     uint8_t                 group;      // The radio group to which this micro:bit belongs.
-    uint8_t                 queueDepth; // The number of packets in the receiver queue.
     int                     rssi;
-    FrameBuffer             *rxQueue;   // A linear list of incoming packets, queued awaiting processing.
+    MicroBitRingBuffer<FrameBuffer *> rxQueue;  // Incoming packets, queued by the interrupt handler awaiting processing.
+    FrameBuffer             *rxPool;    // A fixed pool of receive buffers, allocated once when first enabled. See MICROBIT_RADIO_RX_POOL_SIZE.
+    FrameBuffer             *rxFree;    // The receive buffers in the pool not in use, linked through their next field.
     FrameBuffer             *rxBuf;     // A pointer to the buffer being actively used by the RADIO hardware.
+    MicroBitRingBuffer<FrameBuffer *> txQueue;  // Outgoing packets, awaiting transmission by the interrupt handler. The head is the one being sent.
+    MicroBitRingBuffer<FrameBuffer *> txDone;   // Packets that have been transmitted, awaiting release.
+    FrameBuffer             *txPool;    // A fixed pool of MICROBIT_RADIO_MAXIMUM_TX_BUFFERS transmit buffers, allocated once when first enabled.
+    FrameBuffer             *txFree;    // The transmit buffers in the pool not in use, linked through their next field.
+    volatile uint8_t        radioState; // The MICROBIT_RADIO_STATE_* the transceiver is in.
+    uint16_t                txQueued;   // The number of packets ever queued for transmission. Runs freely.
+    volatile uint16_t       txSent;     // The number of packets ever transmitted (or discarded by disable()). Runs freely.
+    uint16_t                rxQueueDepth;       // The maximum number of received packets held awaiting processing.
+    volatile uint32_t       rxOverflowCount;    // The number of packets dropped because the receive queue was full.
+    volatile uint32_t       rxCrcErrorCount;    // The number of packets dropped because they failed their CRC check.
+    uint32_t                rxProtocols[8];     // A bitmap of the protocol numbers accepted by the receiver. Others are discarded on arrival.
+    uint16_t                dutyPeriod;         // The length of each duty cycle, in milliseconds, or 0 if the radio is always on.
+    uint16_t                dutyWindow;         // The time for which the radio is awake at the start of each duty cycle, in milliseconds.
+    bool                    dutyCoordinator;    // true if we send the beacons others synchronise to.
+    bool                    dutySynced;         // true once we have heard a beacon.
+    volatile bool           dutyAwake;          // true whilst the transceiver may be in use.
+    int32_t                 dutyOffset;         // The network time, less the local time, in milliseconds.
+    uint32_t                dutyLastSync;       // The local time at which we last heard a beacon.
+    uint32_t                dutyLastBeacon;     // The number of the duty cycle in which we last sent a beacon.
+    uint8_t                 txPower;            // The transmit power level last set, applied whenever the hardware is configured.
+    uint8_t                 frequencyBand;      // The frequency band last set, applied whenever the hardware is configured.
+    volatile bool           inTimeslot;         // true whilst the SoftDevice has granted us the radio, when BLE is running.
+    uint32_t                timeslotRequested;  // The time at which we last asked the SoftDevice for a timeslot, in milliseconds.
+
+    /**
+      * Takes an empty buffer from the receive pool.
+      *
+      * @return The buffer, or NULL if all are in use.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    FrameBuffer * allocRxBuf();
+
+    /**
+      * Releases the packets the interrupt handler has finished transmitting, raising MICROBIT_RADIO_EVT_TX_COMPLETE for each.
+      *
+      * @note should only be called from thread context.
+      */
+    void releaseTxBuffers();
+
+    /**
+      * Returns a transmit buffer to the pool.
+      *
+      * @param buffer The buffer to release.
+      */
+    void releaseTxBuf(FrameBuffer *buffer);
+
+    /**
+      * Queues a copy of the given packet for transmission, starting the transmitter if it is idle.
+      *
+      * @param buffer The packet contents to transmit.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the transmit queue is full.
+      */
+    int queueTxBuf(FrameBuffer *buffer);
+
+    /**
+      * Deschedules the calling fiber until the next MICROBIT_RADIO_EVT_TX_COMPLETE event.
+      *
+      * If the scheduler is not running, releases any packets already transmitted instead, so that the caller can poll.
+      */
+    void waitForTxComplete();
+
+    /**
+      * Writes our configuration to the RADIO hardware module.
+      */
+    void configureHardware();
+
+    /**
+      * Asks the SoftDevice for a timeslot, in which to use the radio whilst BLE is running.
+      */
+    void requestTimeslot();
+
+    /**
+      * Turns the transceiver on at the start of a wake window, first sending any packets deferred whilst it was asleep.
+      */
+    void wake();
+
+    /**
+      * Turns the transceiver off at the end of a wake window, once any transmission in progress is complete.
+      */
+    void sleep();
+
+    /**
+      * Handles a beacon, adopting the network time it carries if we are following a duty cycle.
+      */
+    void beaconReceived();
 
     public:
     MicroBitRadioDatagram   datagram;   // A simple datagram service.
     MicroBitRadioEvent      event;      // A simple event handling service.
+    MicroBitRadioMessage    message;    // A service for messages larger than a single packet.
+    MicroBitRadioReliable   reliable;   // A service for acknowledged delivery to a single micro:bit.
+    MicroBitRadioMesh       mesh;       // A service for flooding packets across several hops.
     static MicroBitRadio    *instance;  // A singleton reference, used purely by the interrupt service routine.
 
     /**
@@ -144,11 +274,31 @@ class MicroBitRadio : MicroBitComponent
     /**
       * Attempt to queue a buffer received by the radio hardware, if sufficient space is available.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if a replacement receiver buffer
-      *         could not be allocated (either by policy or memory exhaustion).
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the receive queue is full or no
+      *         spare receive buffer is available.
+      *
+      * @note should only be called from RADIO_IRQHandler...
       */
     int queueRxBuf();
 
+    /**
+      * Records that the packet just received failed its CRC check, and has been discarded.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    void rxCrcError();
+
+    /**
+      * Returns a buffer to the receive pool, once it is no longer needed.
+      *
+      * @param buffer The buffer to release.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is not from the receive pool.
+      *
+      * @note This is called automatically when a buffer is deleted.
+      */
+    int releaseRxBuf(FrameBuffer *buffer);
+
     /**
       * Sets the RSSI for the most recent packet.
       * The value is measured in -dbm. The higher the value, the stronger the signal.
@@ -160,6 +310,49 @@ class MicroBitRadio : MicroBitComponent
       */
     int setRSSI(int rssi);
 
+    /**
+      * Moves on from the packet just transmitted, starting the next one queued or returning the transceiver to receive mode.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    void txComplete();
+
+    /**
+      * Completes a turnaround of the transceiver, once it has been disabled, by enabling it in its new direction.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    void turnaroundComplete();
+
+    /**
+      * Takes control of the RADIO hardware module, at the start of a timeslot granted by the SoftDevice.
+      *
+      * @note should only be called from the timeslot callback...
+      */
+    void timeslotStart();
+
+    /**
+      * Hands the RADIO hardware module back to the SoftDevice, at the end of a timeslot.
+      * Any packet being received is lost. Any packet being transmitted is sent again in the next timeslot.
+      *
+      * @note should only be called from the timeslot callback...
+      */
+    void timeslotEnd();
+
+    /**
+      * Determines if the transceiver is transmitting the packet at the head of the transmit queue.
+      *
+      * @return true if a packet is being transmitted, false otherwise.
+      */
+    bool isTransmitting();
+
+    /**
+      * Determines if the transceiver is listening for packets, rather than transmitting or changing direction.
+      *
+      * @return true if the receiver is in use, false otherwise.
+      */
+    bool isReceiving();
+
     /**
       * Retrieves the current RSSI for the most recent packet.
       * The return value is measured in -dbm. The higher the value, the stronger the signal.
@@ -169,6 +362,46 @@ class MicroBitRadio : MicroBitComponent
       */
     int getRSSI();
 
+    /**
+      * Sets the maximum number of received packets held awaiting processing, and so the number of receive buffers
+      * allocated. Larger queues allow bursts of packets to be received between idle ticks, at the cost of
+      * 2 * sizeof(FrameBuffer) bytes of RAM for each extra packet.
+      *
+      * @param depth The number of packets to queue, defaults to MICROBIT_RADIO_MAXIMUM_RX_BUFFERS.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if depth is less than 1 or too large, or
+      *         MICROBIT_NOT_SUPPORTED if the radio has already been enabled, as its buffers are allocated at that point.
+      */
+    int setRxQueueDepth(int depth);
+
+    /**
+      * Determines the maximum number of received packets held awaiting processing.
+      *
+      * @return The receive queue depth.
+      */
+    int getRxQueueDepth();
+
+    /**
+      * Determines the number of received packets dropped since the radio was created, or the counters last reset,
+      * because the receive queue was full.
+      *
+      * @return The number of packets dropped.
+      */
+    uint32_t getRxOverflowCount();
+
+    /**
+      * Determines the number of received packets dropped since the radio was created, or the counters last reset,
+      * because they were corrupted, and failed their CRC check.
+      *
+      * @return The number of packets dropped.
+      */
+    uint32_t getRxCrcErrorCount();
+
+    /**
+      * Resets the counts of received packets dropped to zero.
+      */
+    void resetRxCounters();
+
     /**
       * Initialises the radio for use as a multipoint sender/receiver
       *
@@ -192,6 +425,60 @@ class MicroBitRadio : MicroBitComponent
       */
     int setGroup(uint8_t group);
 
+    /**
+      * Configures a synchronised duty cycle, in which the radio is only awake for a short window at the start of
+      * each period, and turned off for the rest.
+      *
+      * One device, the coordinator, broadcasts a beacon carrying its time at the start of each window. The others
+      * adopt that time, so that all devices wake together. A device that has not heard a beacon for
+      * MICROBIT_RADIO_DUTY_CYCLE_SYNC_TIMEOUT periods stays awake until it does. Packets sent whilst the radio is
+      * asleep are held until the next window. send() deschedules the calling fiber until then, but returns at once
+      * when called from interrupt context, as sendAsync() always does.
+      *
+      * @param period The length of each cycle in milliseconds, or 0 to leave the radio awake permanently.
+      *
+      * @param window The time for which the radio is awake at the start of each cycle, in milliseconds.
+      *
+      * @param coordinator true if this device should send the beacons that others synchronise to. Defaults to false.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the window does not fit within the period,
+      *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      */
+    int setDutyCycle(int period, int window, bool coordinator = false);
+
+    /**
+      * Determines the time agreed by the devices in a duty cycle: that of the coordinator.
+      *
+      * @return The network time in milliseconds, or the local time if no beacon has been heard.
+      */
+    uint32_t getNetworkTime();
+
+    /**
+      * Periodic callback from the system timer. Turns the radio on and off, at the start and end of each wake window.
+      */
+    virtual void systemTick();
+
+    /**
+      * Chooses whether packets of the given protocol are accepted by the receiver.
+      *
+      * Packets of protocols that are not accepted are discarded by the interrupt handler as they arrive,
+      * without taking a receive buffer or a place in the receive queue. All protocols are accepted by default.
+      *
+      * @param protocol The protocol number, e.g. MICROBIT_RADIO_PROTOCOL_DATAGRAM.
+      *
+      * @param accept true to receive packets of this protocol, false to discard them.
+      */
+    void acceptProtocol(uint8_t protocol, bool accept);
+
+    /**
+      * Determines if packets of the given protocol are accepted by the receiver.
+      *
+      * @param protocol The protocol number, e.g. MICROBIT_RADIO_PROTOCOL_DATAGRAM.
+      *
+      * @return true if packets of this protocol are received, false if they are discarded.
+      */
+    bool isProtocolAccepted(uint8_t protocol);
+
     /**
       * A background, low priority callback that is triggered whenever the processor is idle.
       * Here, we empty our queue of received packets, and pass them onto higher level protocol handlers.
@@ -221,11 +508,31 @@ class MicroBitRadio : MicroBitComponent
       * Transmits the given buffer onto the broadcast radio.
       * The call will wait until the transmission of the packet has completed before returning.
       *
+      * A calling fiber is descheduled whilst it waits. If called from interrupt context, the transceiver is driven
+      * directly until the packet is sent. If the duty cycle has the radio asleep, or BLE is running and no timeslot
+      * is in progress, the packet is instead left queued to be sent in the next wake window or timeslot.
+      *
       * @param data The packet contents to transmit.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the packet is invalid, MICROBIT_NO_RESOURCES
+      *         if called from interrupt context whilst the transmit queue is full, or MICROBIT_NOT_SUPPORTED if the
+      *         BLE stack is running or the radio is not enabled.
       */
     int send(FrameBuffer *buffer);
+
+    /**
+      * Queues the given buffer for transmission onto the broadcast radio, and returns immediately.
+      *
+      * A copy of the packet is taken, so the buffer may be reused as soon as this call returns.
+      * Packets are sent in the order queued. A MICROBIT_RADIO_EVT_TX_COMPLETE event is raised as each is sent.
+      *
+      * @param data The packet contents to transmit.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the packet is invalid, MICROBIT_NO_RESOURCES
+      *         if MICROBIT_RADIO_MAXIMUM_TX_BUFFERS packets are already queued, or
+      *         MICROBIT_NOT_SUPPORTED if the BLE stack is running or the radio is not enabled.
+      */
+    int sendAsync(FrameBuffer *buffer);
 };
 
 #endif
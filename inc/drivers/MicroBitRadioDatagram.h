@@ -46,6 +46,8 @@ class MicroBitRadioDatagram
 {
     MicroBitRadio   &radio;     // The underlying radio module used to send and receive data.
     FrameBuffer     *rxQueue;   // A linear list of incoming packets, queued awaiting processing.
+    FrameBuffer     *rxTail;    // The last packet in rxQueue, to which new packets are linked.
+    int             queueDepth; // The number of packets in rxQueue.
 
     public:
 
@@ -83,6 +85,16 @@ class MicroBitRadioDatagram
       */
     PacketBuffer recv();
 
+    /**
+      * Takes the next packet from the receive queue, without copying it.
+      *
+      * The payload is held in the packet's payload field, and is length - (MICROBIT_RADIO_HEADER_SIZE - 1) bytes long.
+      * The caller owns the packet, and must delete it once finished with it. This returns it to the radio's receive pool.
+      *
+      * @return the packet, or NULL if none is available.
+      */
+    FrameBuffer *recvFrame();
+
     /**
       * Transmits the given buffer onto the broadcast radio.
       *
@@ -111,6 +123,29 @@ class MicroBitRadioDatagram
       */
     int send(PacketBuffer data);
 
+    /**
+      * Transmits the concatenation of the given buffers onto the broadcast radio, as a single packet.
+      *
+      * Each part is copied straight into the radio frame, so a packet built from separate headers and payloads
+      * need never be joined into one buffer first.
+      *
+      * This is a synchronous call that will wait until the transmission of the packet
+      * has completed before returning.
+      *
+      * @param parts The buffers to transmit, in order.
+      *
+      * @param count The number of buffers.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if parts is NULL,
+      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+      *
+      * @code
+      * PacketBuffer parts[2] = { header, body };
+      * radio.datagram.send(parts, 2);
+      * @endcode
+      */
+    int send(PacketBuffer *parts, int count);
+
     /**
       * Transmits the given string onto the broadcast radio.
       *
@@ -31,6 +31,13 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitRadio.h"
 #include "EventModel.h"
 
+// Packet formats, identified by the version field of each EVENTBUS frame.
+#define MICROBIT_RADIO_EVENT_VERSION_SINGLE     1       // A single, complete MicroBitEvent. Its length depends on MICROBIT_EVENT_TIMESTAMP_BITS.
+#define MICROBIT_RADIO_EVENT_VERSION_BATCH      2       // A sequence of (source, value) pairs, one per event.
+
+// The number of events carried by a single batched packet: a MICROBIT_RADIO_MAX_PACKET_SIZE payload of 4 byte pairs.
+#define MICROBIT_RADIO_EVENT_BATCH_SIZE         8
+
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
  *
@@ -48,6 +55,21 @@ class MicroBitRadioEvent
 {
     bool            suppressForwarding;     // A private flag used to prevent event forwarding loops.
     MicroBitRadio   &radio;                 // A reference to the underlying radio module to use.
+    uint16_t        batch[2 * MICROBIT_RADIO_EVENT_BATCH_SIZE];   // (source, value) pairs awaiting transmission, when batching is enabled.
+    uint8_t         batchCount;             // The number of events in the batch.
+    uint16_t        batchDelay;             // The longest time an event may wait in the batch, in milliseconds. 0 disables batching.
+    uint32_t        batchStart;             // The time at which the first event was added to the batch, in milliseconds.
+
+    /**
+      * Transmits a batched packet of events.
+      *
+      * @param buf The packet to send, with the (source, value) pairs of the events already in its payload.
+      *
+      * @param count The number of events in the packet.
+      *
+      * @return MICROBIT_OK on success, or an error code from MicroBitRadio::sendAsync().
+      */
+    int sendBatch(FrameBuffer *buf, int count);
 
     public:
 
@@ -138,6 +160,32 @@ class MicroBitRadioEvent
       * a radio packet and transmitted to any other micro:bits in the same group.
       */
     void eventReceived(MicroBitEvent e);
+
+    /**
+      * Enables or disables batching of the events forwarded onto the radio.
+      *
+      * When enabled, up to MICROBIT_RADIO_EVENT_BATCH_SIZE events are gathered into each packet, which is sent
+      * once it is full, or once the first event in it has waited for the given time. This greatly reduces the
+      * airtime and time spent sending bursts of events, at the cost of some latency, and of the sender's timestamps.
+      * Batched packets are understood by any micro:bit running this version or newer.
+      *
+      * @param delay The longest time an event may wait to be sent, in milliseconds, or 0 to send each event at once.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if delay is out of range.
+      */
+    int setBatching(int delay);
+
+    /**
+      * Sends any events waiting in the batch immediately.
+      *
+      * @return MICROBIT_OK on success, or an error code from MicroBitRadio::sendAsync().
+      */
+    int flush();
+
+    /**
+      * Called by the radio whenever the processor is idle. Sends the batch once its delay has expired.
+      */
+    void idleTick();
 };
 
 #endif
@@ -0,0 +1,153 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RADIO_GATEWAY_H
+#define MICROBIT_RADIO_GATEWAY_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "MicroBitSerial.h"
+#include "MicroBitUARTService.h"
+
+// The first byte of every frame forwarded by a gateway, to help the host find the start of each frame.
+#define MICROBIT_RADIO_GATEWAY_SYNC             0xA5
+
+/**
+  * Forwards the datagrams received by the radio to a host, over a serial line or the Bluetooth UART service.
+  *
+  * Each datagram is forwarded as a frame of MICROBIT_RADIO_HEADER_SIZE header bytes followed by its payload.
+  * The header is MICROBIT_RADIO_GATEWAY_SYNC, the payload length, the radio group, and the received signal
+  * strength in dBm as a signed byte.
+  *
+  * The header is written over the radio header at the front of the receive buffer, so no copy of the datagram
+  * is made on its way to the host. Over serial, the frame is sent straight from the receive buffer, which is
+  * returned to the radio's pool once the last byte has been written. Over Bluetooth, the frame is appended to the
+  * UART service's transmit queue, and the receive buffer returned at once. Frames are only queued whole,
+  * so that service needs a transmit buffer of at least MICROBIT_RADIO_HEADER_SIZE + MICROBIT_RADIO_MAX_PACKET_SIZE
+  * bytes to forward the largest datagrams. Any larger than its buffer are dropped.
+  *
+  * Only one frame is in flight at a time. Whilst the host link is busy, datagrams wait in the radio's receive
+  * queue, so a slow link drops datagrams at the radio rather than holding on to memory.
+  *
+  * @code
+  * MicroBitRadioGateway gateway(uBit.radio, uBit.serial);
+  *
+  * uBit.radio.enable();
+  * gateway.start();
+  * @endcode
+  */
+class MicroBitRadioGateway
+{
+    MicroBitRadio           &radio;     // The radio from which datagrams are forwarded.
+    MicroBitSerial          *serial;    // The serial line to which datagrams are forwarded, or NULL.
+    MicroBitUARTService     *uart;      // The Bluetooth UART to which datagrams are forwarded, or NULL.
+    FrameBuffer             *txFrame;   // The datagram being forwarded, or NULL.
+    int                     txLength;   // The length of the frame held in txFrame, in bytes.
+    bool                    running;    // true once start() has been called.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates a gateway that forwards datagrams received by the given radio over a serial line.
+      *
+      * @param r The radio from which datagrams are forwarded.
+      *
+      * @param s The serial line to which datagrams are forwarded.
+      */
+    MicroBitRadioGateway(MicroBitRadio &r, MicroBitSerial &s);
+
+    /**
+      * Constructor.
+      *
+      * Creates a gateway that forwards datagrams received by the given radio over the Bluetooth UART service.
+      *
+      * @param r The radio from which datagrams are forwarded.
+      *
+      * @param u The Bluetooth UART service to which datagrams are forwarded.
+      */
+    MicroBitRadioGateway(MicroBitRadio &r, MicroBitUARTService &u);
+
+    /**
+      * Destructor.
+      *
+      * Stops forwarding. A frame still being sent over serial keeps the gateway's receive buffer until
+      * it completes, so the gateway must not be destroyed until then.
+      */
+    ~MicroBitRadioGateway();
+
+    /**
+      * Starts forwarding datagrams, including any already waiting to be received.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if there is no default event bus.
+      *
+      * @note Whilst started, the gateway receives every datagram. Calls to radio.datagram.recv() will find none.
+      */
+    int start();
+
+    /**
+      * Stops forwarding datagrams. Any frame already being sent is completed.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int stop();
+
+    private:
+
+    /**
+      * Event handler, called when the radio receives a datagram.
+      */
+    void onDatagram(MicroBitEvent);
+
+    /**
+      * Event handler, called when the Bluetooth UART has sent everything queued.
+      */
+    void onUARTEmpty(MicroBitEvent);
+
+    /**
+      * Forwards waiting datagrams for as long as the host link can accept them.
+      */
+    void forward();
+
+    /**
+      * Called from the idle task once the serial line has sent txFrame.
+      *
+      * @param gateway The gateway whose frame has been sent.
+      */
+    static void txComplete(void *gateway);
+
+    /**
+      * Writes the gateway frame header over the radio header of the given datagram.
+      *
+      * @param p The datagram.
+      *
+      * @return The length of the frame, starting at the first byte of p, in bytes.
+      */
+    static int frame(FrameBuffer *p);
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RADIO_MESH_H
+#define MICROBIT_RADIO_MESH_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "PacketBuffer.h"
+
+// Each packet begins with a small header: the originator's address (2 bytes), a message id (1 byte) chosen by the
+// originator, and the number of further hops the packet may take (1 byte).
+#define MICROBIT_RADIO_MESH_HEADER_SIZE         4
+
+// The data carried by each packet: a MICROBIT_RADIO_MAX_PACKET_SIZE payload, less the mesh header.
+#define MICROBIT_RADIO_MESH_MAX_PAYLOAD         28
+
+// The number of hops a packet may take by default.
+#define MICROBIT_RADIO_MESH_DEFAULT_TTL         4
+
+// The number of recently seen packets remembered, so that each is delivered and relayed only once.
+#define MICROBIT_RADIO_MESH_HISTORY_SIZE        16
+
+// The number of packets that may be held awaiting rebroadcast.
+#define MICROBIT_RADIO_MESH_RELAY_SLOTS         4
+
+// The default upper bound of the random delay before a packet is rebroadcast, in milliseconds.
+#define MICROBIT_RADIO_MESH_DEFAULT_JITTER      10
+
+/**
+ * Provides a simple flooding mesh, in which every micro:bit rebroadcasts the packets it hears, so that they reach
+ * devices beyond the range of the originator.
+ *
+ * Each packet carries its originator's address and a message id, which together identify it. Each micro:bit
+ * remembers the last MICROBIT_RADIO_MESH_HISTORY_SIZE packets it has seen, and ignores any repeats. Packets are
+ * rebroadcast until their time to live (TTL) is exhausted. To make collisions between relays less likely, each waits
+ * a random time before rebroadcasting; with no delay, relays rebroadcast as soon as they have processed a packet,
+ * which keeps the copies closely synchronised.
+ *
+ * Every packet is also delivered locally, exactly once, so a gateway simply receives from the mesh.
+ */
+class MicroBitRadioMesh
+{
+    MicroBitRadio   &radio;             // The underlying radio module used to send and receive data.
+    uint8_t         txId;               // The message id of the next packet we originate.
+    bool            relay;              // true if we rebroadcast the packets of others.
+    uint16_t        jitter;             // The upper bound of the random delay before a packet is rebroadcast, in milliseconds.
+
+    uint32_t        history[MICROBIT_RADIO_MESH_HISTORY_SIZE];     // The (originator, id) pairs of packets we have seen recently.
+    uint8_t         historyNext;        // The next entry in history to replace.
+    uint8_t         historyLength;      // The number of valid entries in history.
+
+    FrameBuffer     *relayQueue[MICROBIT_RADIO_MESH_RELAY_SLOTS];  // Packets awaiting rebroadcast, or NULL.
+    uint32_t        relayTime[MICROBIT_RADIO_MESH_RELAY_SLOTS];    // The time at which each packet should be rebroadcast, in milliseconds.
+
+    FrameBuffer     *rxQueue;           // A linear list of packets received, awaiting recv().
+    FrameBuffer     *rxTail;            // The last packet in rxQueue.
+    int             rxQueueLength;      // The number of packets in rxQueue.
+
+    /**
+      * Records that we've seen the given packet.
+      *
+      * @param origin The address of the packet's originator.
+      *
+      * @param id The packet's message id.
+      *
+      * @return true if the packet had already been seen, false otherwise.
+      */
+    bool seen(uint16_t origin, uint8_t id);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an instance of a MicroBitRadioMesh, which offers the ability to
+      * send packets beyond the range of a single micro:bit.
+      *
+      * @param r The underlying radio module used to send and receive data.
+      */
+    MicroBitRadioMesh(MicroBitRadio &r);
+
+    /**
+      * Sends the given data to every micro:bit in the mesh.
+      *
+      * @param buffer The data to send.
+      *
+      * @param len The number of bytes to send.
+      *
+      * @param ttl The number of times the packet may be rebroadcast. Defaults to MICROBIT_RADIO_MESH_DEFAULT_TTL.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes
+      *         to send is greater than MICROBIT_RADIO_MESH_MAX_PAYLOAD, or an error code from MicroBitRadio::send().
+      */
+    int send(uint8_t *buffer, int len, int ttl = MICROBIT_RADIO_MESH_DEFAULT_TTL);
+
+    /**
+      * Sends the given data to every micro:bit in the mesh.
+      *
+      * @param data The data to send.
+      *
+      * @param ttl The number of times the packet may be rebroadcast. Defaults to MICROBIT_RADIO_MESH_DEFAULT_TTL.
+      *
+      * @return MICROBIT_OK on success, or an error code as for send(uint8_t *, int, int).
+      */
+    int send(PacketBuffer data, int ttl = MICROBIT_RADIO_MESH_DEFAULT_TTL);
+
+    /**
+      * Retrieves the oldest packet received from the mesh.
+      *
+      * @param origin If not NULL, set to the address of the micro:bit that originated the packet.
+      *
+      * @return The data received, or an empty PacketBuffer if no data is available.
+      */
+    PacketBuffer recv(uint16_t *origin = NULL);
+
+    /**
+      * Chooses whether we rebroadcast the packets of others. Relaying is enabled by default.
+      *
+      * @param enable true to rebroadcast packets, false to only send and receive them.
+      *
+      * @param jitter The upper bound of the random delay before each packet is rebroadcast, in milliseconds,
+      *        or 0 to rebroadcast as soon as possible. Defaults to MICROBIT_RADIO_MESH_DEFAULT_JITTER.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if jitter is out of range.
+      */
+    int setRelay(bool enable, int jitter = MICROBIT_RADIO_MESH_DEFAULT_JITTER);
+
+    /**
+      * Protocol handler callback. This is called when the radio receives a packet marked as using the mesh protocol.
+      */
+    void packetReceived();
+
+    /**
+      * Called by the radio whenever the processor is idle. Rebroadcasts any packets that are due.
+      */
+    void idleTick();
+};
+
+#endif
@@ -0,0 +1,131 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RADIO_MESSAGE_H
+#define MICROBIT_RADIO_MESSAGE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "PacketBuffer.h"
+
+// Each fragment begins with a small header: the sender's id (2 bytes), the message sequence number (1 byte),
+// and the fragment index (1 byte). The top bit of the index marks the last fragment of the message.
+#define MICROBIT_RADIO_MESSAGE_HEADER_SIZE      4
+#define MICROBIT_RADIO_MESSAGE_LAST_FRAGMENT    0x80
+
+// The data carried by each fragment: a MICROBIT_RADIO_MAX_PACKET_SIZE payload, less the fragment header.
+#define MICROBIT_RADIO_MESSAGE_FRAGMENT_SIZE    28
+#define MICROBIT_RADIO_MESSAGE_MAX_FRAGMENTS    128
+
+// The largest message that can be sent or reassembled. At most MICROBIT_RADIO_MESSAGE_MAX_FRAGMENTS * MICROBIT_RADIO_MESSAGE_FRAGMENT_SIZE.
+#define MICROBIT_RADIO_MESSAGE_MAX_SIZE         1024
+
+// The number of complete messages held awaiting recv().
+#define MICROBIT_RADIO_MESSAGE_QUEUE_SIZE       2
+
+/**
+ * Provides the ability to send messages larger than a single radio packet.
+ *
+ * Each message is split into a sequence of fragments, which are reassembled by the receiver into a single PacketBuffer.
+ * A MICROBIT_RADIO_EVT_MESSAGE event is raised once a message is complete. Messages that are missing fragments are
+ * discarded: as with MicroBitRadioDatagram, delivery is not guaranteed.
+ *
+ * Only one message is reassembled at a time, in a buffer of MICROBIT_RADIO_MESSAGE_MAX_SIZE bytes allocated
+ * when the first fragment arrives. Fragments of a new message, from this or any other sender, abandon a partial one.
+ */
+class MicroBitRadioMessage
+{
+    MicroBitRadio   &radio;             // The underlying radio module used to send and receive data.
+    uint8_t         txSeq;              // The sequence number of the next message we send.
+
+    uint8_t         *rxBuffer;          // The message being reassembled, or NULL if none has been allocated.
+    bool            rxActive;           // true if a message is being reassembled.
+    uint16_t        rxSender;           // The id of the sender of the message being reassembled.
+    uint8_t         rxSeq;              // The sequence number of the message being reassembled.
+    uint8_t         rxReceived;         // The number of fragments received so far.
+    uint8_t         rxTotal;            // The number of fragments in the message, or 0 if the last is yet to arrive.
+    uint16_t        rxLength;           // The length of the message, once the last fragment has arrived.
+    uint32_t        rxFragments[MICROBIT_RADIO_MESSAGE_MAX_FRAGMENTS / 32];    // A bitmap of the fragments received so far.
+
+    PacketBuffer    rxQueue[MICROBIT_RADIO_MESSAGE_QUEUE_SIZE];    // Complete messages, awaiting recv().
+    uint8_t         rxQueueHead;        // The index of the oldest message in rxQueue.
+    uint8_t         rxQueueLength;      // The number of messages in rxQueue.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an instance of a MicroBitRadioMessage which offers the ability
+      * to broadcast messages larger than a single packet to other micro:bits in the vicinity.
+      *
+      * @param r The underlying radio module used to send and receive data.
+      */
+    MicroBitRadioMessage(MicroBitRadio &r);
+
+    /**
+      * Retrieves the oldest complete message received.
+      *
+      * @return the message received, or an empty PacketBuffer if no message is available.
+      */
+    PacketBuffer recv();
+
+    /**
+      * Transmits the given buffer onto the broadcast radio, as a sequence of fragments.
+      *
+      * The call returns once every fragment has been queued for transmission.
+      *
+      * @param buffer The message contents to transmit.
+      *
+      * @param len The number of bytes to transmit.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes
+      *         to transmit is greater than MICROBIT_RADIO_MESSAGE_MAX_SIZE, or an error code from MicroBitRadio::send().
+      */
+    int send(uint8_t *buffer, int len);
+
+    /**
+      * Transmits the given buffer onto the broadcast radio, as a sequence of fragments.
+      *
+      * The call returns once every fragment has been queued for transmission.
+      *
+      * @param data The message contents to transmit.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the message is greater than
+      *         MICROBIT_RADIO_MESSAGE_MAX_SIZE bytes, or an error code from MicroBitRadio::send().
+      */
+    int send(PacketBuffer data);
+
+    /**
+      * Protocol handler callback. This is called when the radio receives a packet marked as a message fragment.
+      *
+      * This function adds the fragment to the message being reassembled, and queues the message for user
+      * reception once it is complete.
+      */
+    void packetReceived();
+};
+
+#endif
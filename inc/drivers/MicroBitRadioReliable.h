@@ -0,0 +1,221 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RADIO_RELIABLE_H
+#define MICROBIT_RADIO_RELIABLE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "MicroBitFiber.h"
+#include "PacketBuffer.h"
+
+// Each frame begins with a small header: flags (1 byte), the sender's address (2 bytes), the destination's address (2 bytes),
+// and a sequence number (1 byte). Acknowledgements use the sequence number for the next frame expected, and add a bitmap (1 byte)
+// of the frames after it that have also been received.
+#define MICROBIT_RADIO_RELIABLE_HEADER_SIZE     6
+#define MICROBIT_RADIO_RELIABLE_FLAG_ACK        0x01    // This frame acknowledges those received, rather than carrying data.
+#define MICROBIT_RADIO_RELIABLE_FLAG_SYN        0x02    // The sender has yet to hear from the receiver, so its sequence number should be adopted.
+
+// The data carried by each frame: a MICROBIT_RADIO_MAX_PACKET_SIZE payload, less the frame header.
+#define MICROBIT_RADIO_RELIABLE_MAX_PAYLOAD     26
+
+// The number of frames that may be in flight, awaiting acknowledgement. At most 8.
+#define MICROBIT_RADIO_RELIABLE_WINDOW          4
+
+// The time to wait for the acknowledgement of a frame before sending it again, and the number of times to do so.
+#define MICROBIT_RADIO_RELIABLE_TIMEOUT         20
+#define MICROBIT_RADIO_RELIABLE_MAX_RETRIES     8
+
+// The number of other micro:bits whose sequence numbers are tracked at any one time.
+#define MICROBIT_RADIO_RELIABLE_PEERS           4
+
+/**
+  * The state held for each micro:bit we are exchanging frames with.
+  */
+struct MicroBitRadioReliablePeer
+{
+    uint16_t        address;            // The address of the peer.
+    bool            used;               // true if this entry is in use.
+    bool            txSynced;           // true once the peer has acknowledged our sequence numbers.
+    bool            rxSynced;           // true once we have adopted the peer's sequence numbers.
+    uint8_t         txSeq;              // The sequence number of the next frame we send to the peer.
+    uint8_t         rxSeq;              // The sequence number of the next frame we expect from the peer.
+    FrameBuffer     *held[MICROBIT_RADIO_RELIABLE_WINDOW];     // Frames received out of order, indexed by sequence number modulo the window.
+};
+
+/**
+ * Provides reliable, ordered delivery of packets from one micro:bit to another.
+ *
+ * Each frame is addressed to a single micro:bit, and carries a sequence number. The receiver acknowledges the frames
+ * it has received, holding any that arrive out of order until those before them are received. The sender keeps up
+ * to MICROBIT_RADIO_RELIABLE_WINDOW frames in flight, resending only those that have not been acknowledged within
+ * MICROBIT_RADIO_RELIABLE_TIMEOUT milliseconds. If a frame has still not been acknowledged after
+ * MICROBIT_RADIO_RELIABLE_MAX_RETRIES attempts, those in flight are abandoned, and a MICROBIT_RADIO_EVT_RELIABLE_FAILED
+ * event is raised for each.
+ *
+ * Addresses are derived from the serial number of each micro:bit. See getAddress().
+ */
+class MicroBitRadioReliable
+{
+    MicroBitRadio   &radio;             // The underlying radio module used to send and receive data.
+    MicroBitRadioReliablePeer peers[MICROBIT_RADIO_RELIABLE_PEERS];    // The micro:bits we are exchanging frames with.
+    uint8_t         nextPeer;           // The next entry in peers to replace, when a new one is needed.
+
+    uint16_t        txDest;             // The address of the micro:bit the frames in flight are being sent to.
+    uint8_t         txBase;             // The sequence number of the oldest frame in flight.
+    uint8_t         txNext;             // The sequence number of the next frame to send.
+    uint8_t         txCount;            // The number of frames in flight.
+    FrameBuffer     *txWindow[MICROBIT_RADIO_RELIABLE_WINDOW];         // Frames in flight, indexed by sequence number modulo the window.
+    uint32_t        txTime[MICROBIT_RADIO_RELIABLE_WINDOW];            // The time at which each frame in flight was last sent, in milliseconds.
+    uint8_t         txRetries[MICROBIT_RADIO_RELIABLE_WINDOW];         // The number of times each frame in flight has been resent.
+    Fiber           *txWaiters;         // Fibers waiting for space in the window.
+
+    FrameBuffer     *rxQueue;           // A linear list of frames received in order, awaiting recv().
+    FrameBuffer     *rxTail;            // The last frame in rxQueue.
+    int             rxQueueLength;      // The number of frames in rxQueue.
+
+    /**
+      * Finds the entry for the given micro:bit, optionally creating one if none exists.
+      *
+      * @param address The address of the micro:bit.
+      *
+      * @param create true to replace the least recently created entry if there is none for this micro:bit.
+      *
+      * @return The entry, or NULL if none exists and create is false.
+      */
+    MicroBitRadioReliablePeer *getPeer(uint16_t address, bool create);
+
+    /**
+      * Discards any frames received out of order from the given micro:bit.
+      *
+      * @param peer The entry for the micro:bit.
+      */
+    void releaseHeld(MicroBitRadioReliablePeer *peer);
+
+    /**
+      * Abandons the frames in flight, after one has gone unacknowledged too many times.
+      */
+    void abandon();
+
+    /**
+      * Handles an acknowledgement of frames we have sent.
+      *
+      * @param p The acknowledgement received.
+      */
+    void ackReceived(FrameBuffer *p);
+
+    /**
+      * Handles a data frame addressed to us, and acknowledges it if it was accepted.
+      *
+      * @param p The frame received.
+      */
+    void dataReceived(FrameBuffer *p);
+
+    /**
+      * Takes a copy of the given frame, and queues it for recv().
+      *
+      * @param p The frame to deliver.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the queue is full or no memory is available.
+      */
+    int deliver(FrameBuffer *p);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an instance of a MicroBitRadioReliable, which offers the ability to
+      * send packets reliably to another micro:bit in the vicinity.
+      *
+      * @param r The underlying radio module used to send and receive data.
+      */
+    MicroBitRadioReliable(MicroBitRadio &r);
+
+    /**
+      * Determines the address of this micro:bit, to which others may send frames.
+      *
+      * @return This micro:bit's address.
+      */
+    static uint16_t getAddress();
+
+    /**
+      * Sends the given data reliably to another micro:bit.
+      *
+      * The call returns once the frame has been sent for the first time, waiting first for space in the window
+      * if necessary. If frames are in flight to a different micro:bit, it waits for them to be acknowledged.
+      *
+      * @param destination The address of the micro:bit to send to.
+      *
+      * @param buffer The data to send.
+      *
+      * @param len The number of bytes to send.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes
+      *         to send is greater than MICROBIT_RADIO_RELIABLE_MAX_PAYLOAD, MICROBIT_NO_RESOURCES if no memory is
+      *         available, or MICROBIT_NOT_SUPPORTED if the fiber scheduler is not running.
+      */
+    int send(uint16_t destination, uint8_t *buffer, int len);
+
+    /**
+      * Sends the given data reliably to another micro:bit.
+      *
+      * @param destination The address of the micro:bit to send to.
+      *
+      * @param data The data to send.
+      *
+      * @return MICROBIT_OK on success, or an error code as for send(uint16_t, uint8_t *, int).
+      */
+    int send(uint16_t destination, PacketBuffer data);
+
+    /**
+      * Retrieves the oldest frame received, in the order it was sent.
+      *
+      * @param sender If not NULL, set to the address of the micro:bit that sent the frame.
+      *
+      * @return The data received, or an empty PacketBuffer if no data is available.
+      */
+    PacketBuffer recv(uint16_t *sender = NULL);
+
+    /**
+      * Determines the number of frames we have sent that are yet to be acknowledged.
+      *
+      * @return The number of frames in flight.
+      */
+    int pending();
+
+    /**
+      * Protocol handler callback. This is called when the radio receives a packet marked as using the reliable protocol.
+      */
+    void packetReceived();
+
+    /**
+      * Called by the radio whenever the processor is idle. Resends any frames whose acknowledgement is overdue.
+      */
+    void idleTick();
+};
+
+#endif
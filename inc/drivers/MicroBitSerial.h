@@ -28,6 +28,9 @@ DEALINGS IN THE SOFTWARE.
 
 #include "mbed.h"
 #include "ManagedString.h"
+#include "PacketBuffer.h"
+#include "MicroBitRingBuffer.h"
+#include "MicroBitFiberLock.h"
 
 #define MICROBIT_SERIAL_DEFAULT_BAUD_RATE   115200
 #define MICROBIT_SERIAL_DEFAULT_BUFFER_SIZE 20
@@ -35,13 +38,29 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_SERIAL_EVT_DELIM_MATCH     1
 #define MICROBIT_SERIAL_EVT_HEAD_MATCH      2
 #define MICROBIT_SERIAL_EVT_RX_FULL         3
+#define MICROBIT_SERIAL_EVT_TERMINATOR_MATCH 4
+
+// The longest multi-byte terminator that eventOnTerminator() can match.
+#define MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH 8
 
-#define MICROBIT_SERIAL_RX_IN_USE           1
-#define MICROBIT_SERIAL_TX_IN_USE           2
 #define MICROBIT_SERIAL_RX_BUFF_INIT        4
 #define MICROBIT_SERIAL_TX_BUFF_INIT        8
 
 
+/**
+  * A snapshot of the activity of a MicroBitSerial instance, as returned by MicroBitSerial::getStats().
+  */
+struct MicroBitSerialStats
+{
+    uint32_t rxBytes;               // The number of bytes received and stored in the rxBuff.
+    uint32_t rxDropped;             // The number of bytes received and discarded, as the rxBuff was full.
+    uint32_t rxInterrupts;          // The number of receive interrupts taken.
+    uint32_t rxInterruptTime;       // The total time spent in the receive interrupt handler, in microseconds (if MICROBIT_SERIAL_PROFILING).
+    uint32_t txBytes;               // The number of bytes transmitted.
+    uint32_t txInterrupts;          // The number of transmit interrupts taken.
+    uint32_t txInterruptTime;       // The total time spent in the transmit interrupt handler, in microseconds (if MICROBIT_SERIAL_PROFILING).
+};
+
 enum MicroBitSerialMode
 {
     ASYNC,
@@ -57,37 +76,108 @@ enum MicroBitSerialMode
 class MicroBitSerial : public RawSerial
 {
 
-    //holds that state of the mutex locks for all MicroBitSerial instances.
+    //holds the state of the buffers for all MicroBitSerial instances.
     static uint8_t status;
 
+    //held by the fiber currently receiving and transmitting on any MicroBitSerial instance.
+    static FiberMutex rxMutex;
+    static FiberMutex txMutex;
+
     //holds the state of the baudrate for all MicroBitSerial instances.
     static int baudrate;
 
-    //delimeters used for matching on receive.
-    ManagedString delimeters;
+    //delimeters used for matching on receive, as a bitmap indexed by character.
+    uint32_t delimeterMap[8];
+    bool delimeterMatch;
+
+    //a multi-byte terminator used for matching on receive, the KMP failure table used to match it,
+    //and the number of its bytes matched by the most recently received characters.
+    uint8_t terminator[MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH];
+    uint8_t terminatorFailure[MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH];
+    uint8_t terminatorLength;
+    uint8_t terminatorState;
 
-    //a variable used when a user calls the eventAfter() method.
+    //a copy of a line returned by readLine() that wrapped around the end of rxBuff, and the number of
+    //characters to remove from rxBuff when the caller releases it.
+    uint8_t *rxLine;
+    int rxLineSize;
+    int rxLineConsume;
+
+    //a variable used when a user calls the eventAfter() method: the number of buffered bytes to wait for.
     int rxBuffHeadMatch;
 
-    uint8_t *rxBuff;
-    uint8_t rxBuffSize;
-    volatile uint16_t rxBuffHead;
-    uint16_t rxBuffTail;
+    //the number of bytes ever stored by the receive interrupt, and the number of those checked for a match by rxProcess().
+    volatile uint32_t rxReceived;
+    uint32_t rxScanned;
 
+    //counters reported by getStats().
+    MicroBitSerialStats stats;
 
-    uint8_t *txBuff;
+    //set whilst a call to rxProcess() is waiting to run, and if bytes have been dropped since it last ran.
+    volatile bool rxProcessPending;
+    volatile bool rxOverflow;
+
+    //filled by the receive interrupt, and emptied by fibers.
+    MicroBitRingBuffer<uint8_t> rxBuff;
+    uint8_t rxBuffSize;
+
+    //filled by fibers, and emptied by the transmit interrupt.
+    MicroBitRingBuffer<uint8_t> txBuff;
     uint8_t txBuffSize;
-    uint16_t txBuffHead;
-    volatile uint16_t txBuffTail;
+
+    //a buffer being transmitted in place, once txBuff is empty, and the PacketBuffer holding it (if any).
+    uint8_t * volatile txData;
+    volatile int txDataLen;
+    volatile int txDataOffset;
+    PacketBuffer txPacket;
+
+    //called from the idle task to release a buffer sent in place, once it has been transmitted (if any).
+    void (*txRelease)(void *);
+    void *txReleaseContext;
+
+    //set whilst the transmit interrupt is attached, during which we hold the high frequency clock running.
+    volatile bool txIdleHeld;
 
     /**
       * An internal interrupt callback for MicroBitSerial configured for when a
       * character is received.
       *
-      * Each time a character is received fill our circular buffer!
+      * Moves every character waiting in the UART into our circular buffer, and leaves
+      * any matching against them to rxProcess(), outside of interrupt context.
       */
     void dataReceived();
 
+    /**
+      * Schedules a call to rxProcess() from the idle task, if one is needed and not already waiting.
+      */
+    void rxProcessLater();
+
+    /**
+      * Checks the characters received since the last call against our delimeters and head match,
+      * and raises any events due as a result. Called from the idle task.
+      */
+    void rxProcess();
+
+    /**
+      * Replaces the delimeters matched on receive.
+      *
+      * @param delimeters the characters to match received characters against, or an empty ManagedString for none.
+      */
+    void setDelimeters(ManagedString delimeters);
+
+    /**
+      * Replaces the multi-byte terminator matched on receive. Any part of it already at the end
+      * of the rxBuff counts towards a match.
+      *
+      * @param terminator the sequence of characters to match.
+      *
+      * @param len the number of characters in the terminator, or 0 to match none.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the terminator is longer
+      *         than MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH.
+      */
+    int setTerminator(const char *terminator, int len);
+
     /**
       * An internal interrupt callback for MicroBitSerial.
       *
@@ -113,15 +203,72 @@ class MicroBitSerial : public RawSerial
       */
     int setTxInterrupt(uint8_t *string, int len, MicroBitSerialMode mode);
 
+    /**
+      * An internal method to configure an interrupt on tx buffer, and transmit the given
+      * bytes from where they are, once everything in txBuff has been sent.
+      *
+      * @param data a pointer to the first byte to send. This must remain valid and unchanged
+      *        until transmission is complete.
+      *
+      * @param len the number of bytes to send.
+      *
+      * @param mode if SYNC_SLEEP, the current fiber context is configured to wake once transmission is complete.
+      */
+    void setTxDirect(uint8_t *data, int len, MicroBitSerialMode mode);
+
+    /**
+      * Attaches the transmit interrupt, and prevents the idle task from stopping the high frequency
+      * clock until transmission is complete.
+      */
+    void attachTx();
+
+    /**
+      * Detaches the transmit interrupt, and releases the hold placed on the idle task by attachTx().
+      */
+    void detachTx();
+
+    /**
+      * The idle task's entry point for releasing txPacket, once it has been transmitted.
+      *
+      * @param serial the MicroBitSerial instance whose packet is complete.
+      */
+    static void txPacketComplete(void *serial);
+
+    /**
+      * Releases the buffer last sent in place, if its transmission is complete.
+      */
+    void releaseTxData();
+
+    /**
+      * Prepares to send a buffer in place: takes the transmit lock, initialises the txBuff if
+      * needed, and waits for any buffer already being sent in place, as permitted by the mode.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP.
+      *
+      * @return MICROBIT_OK with the transmit lock held, or MICROBIT_SERIAL_IN_USE or
+      *         MICROBIT_NO_RESOURCES with the lock released.
+      */
+    int lockTxDirect(MicroBitSerialMode mode);
+
     /**
       * Locks the mutex so that others can't use this serial instance for reception
+      *
+      * @param mode if SYNC_SLEEP, the calling fiber waits its turn if another fiber holds the mutex.
+      *        Otherwise, this call fails immediately in that case. Defaults to ASYNC.
+      *
+      * @return MICROBIT_OK if the mutex is now held, or MICROBIT_SERIAL_IN_USE.
       */
-    void lockRx();
+    int lockRx(MicroBitSerialMode mode = ASYNC);
 
     /**
       * Locks the mutex so that others can't use this serial instance for transmission
+      *
+      * @param mode if SYNC_SLEEP, the calling fiber waits its turn if another fiber holds the mutex.
+      *        Otherwise, this call fails immediately in that case. Defaults to ASYNC.
+      *
+      * @return MICROBIT_OK if the mutex is now held, or MICROBIT_SERIAL_IN_USE.
       */
-    void lockTx();
+    int lockTx(MicroBitSerialMode mode = ASYNC);
 
     /**
       * Unlocks the mutex so that others can use this serial instance for reception
@@ -178,22 +325,11 @@ class MicroBitSerial : public RawSerial
     int getChar(MicroBitSerialMode mode);
 
     /**
-      * An internal method that copies values from a circular buffer to a linear buffer.
-      *
-      * @param circularBuff a pointer to the source circular buffer
-      *
-      * @param circularBuffSize the size of the circular buffer
-      *
-      * @param linearBuff a pointer to the destination linear buffer
-      *
-      * @param tailPosition the tail position in the circular buffer you want to copy from
+      * The idle task's entry point into rxProcess().
       *
-      * @param headPosition the head position in the circular buffer you want to copy to
-      *
-      * @note this method assumes that the linear buffer has the appropriate amount of
-      *       memory to contain the copy operation
+      * @param serial the MicroBitSerial instance to process.
       */
-    void circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition);
+    static void rxProcessDeferred(void *serial);
 
     public:
 
@@ -241,7 +377,7 @@ class MicroBitSerial : public RawSerial
       *         Defaults to SYNC_SLEEP.
       *
       * @return the number of bytes written, or MICROBIT_SERIAL_IN_USE if another fiber
-      *         is using the serial instance for transmission.
+      *         is using the serial instance for transmission and the mode is not SYNC_SLEEP.
       */
     int sendChar(char c, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
 
@@ -266,7 +402,7 @@ class MicroBitSerial : public RawSerial
       *         Defaults to SYNC_SLEEP.
       *
       * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
-      *         is using the serial instance for transmission, MICROBIT_INVALID_PARAMETER
+      *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, MICROBIT_INVALID_PARAMETER
       *         if buffer is invalid, or the given bufferLen is <= 0.
       */
     int send(ManagedString s, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
@@ -283,22 +419,93 @@ class MicroBitSerial : public RawSerial
       *
       *            ASYNC - bytes are copied into the txBuff and returns immediately.
       *
-      *            SYNC_SPINWAIT - bytes are copied into the txBuff and this method
+      *            SYNC_SPINWAIT - bytes are sent directly from the given buffer, and this method
       *                            will spin (lock up the processor) until all bytes
       *                            have been sent.
       *
-      *            SYNC_SLEEP - bytes are copied into the txBuff and the fiber sleeps
+      *            SYNC_SLEEP - bytes are sent directly from the given buffer, and the fiber sleeps
       *                         until all bytes have been sent. This allows other fibers
       *                         to continue execution.
       *
       *         Defaults to SYNC_SLEEP.
       *
       * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
-      *         is using the serial instance for transmission, MICROBIT_INVALID_PARAMETER
+      *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, MICROBIT_INVALID_PARAMETER
       *         if buffer is invalid, or the given bufferLen is <= 0.
       */
     int send(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
 
+    /**
+      * Sends the contents of a PacketBuffer over the serial line, directly from the PacketBuffer
+      * rather than through the txBuff. A reference to the PacketBuffer is held until it has been sent,
+      * so the caller may release its own at any time. Completion is signalled by the event
+      * MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY.
+      *
+      * @param buffer the PacketBuffer to send.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+      *        gives a different behaviour:
+      *
+      *            ASYNC - transmission is started and this method returns immediately. If a
+      *                    PacketBuffer is already being sent, MICROBIT_SERIAL_IN_USE is returned.
+      *
+      *            SYNC_SPINWAIT - this method will spin (lock up the processor) until all bytes
+      *                            have been sent.
+      *
+      *            SYNC_SLEEP - the fiber sleeps until all bytes have been sent. This allows other fibers
+      *                         to continue execution.
+      *
+      *         Defaults to ASYNC.
+      *
+      * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
+      *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, or MICROBIT_INVALID_PARAMETER
+      *         if the buffer is empty.
+      *
+      * @code
+      * PacketBuffer log(64);
+      *
+      * // fill in the log...
+      *
+      * serial.send(log);
+      * @endcode
+      */
+    int send(PacketBuffer buffer, MicroBitSerialMode mode = ASYNC);
+
+    /**
+      * Sends the given bytes over the serial line directly from where they are, rather than through
+      * the txBuff, and hands them back once they have been sent. This allows buffers owned by another
+      * component, such as a radio receive buffer, to be forwarded without being copied.
+      *
+      * @param buffer a pointer to the first byte to send. This must remain valid and unchanged
+      *        until release is called.
+      *
+      * @param bufferLen the number of bytes to send.
+      *
+      * @param release called from the idle task with the given context once the last byte has been
+      *        written, or from clearTxBuffer() if the transmission is abandoned. May be NULL.
+      *
+      * @param context passed to release.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+      *        gives a different behaviour:
+      *
+      *            ASYNC - transmission is started and this method returns immediately. If a
+      *                    buffer is already being sent in place, MICROBIT_SERIAL_IN_USE is returned.
+      *
+      *            SYNC_SPINWAIT - this method will spin (lock up the processor) until all bytes
+      *                            have been sent.
+      *
+      *            SYNC_SLEEP - the fiber sleeps until all bytes have been sent. This allows other fibers
+      *                         to continue execution.
+      *
+      *         Defaults to ASYNC.
+      *
+      * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
+      *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, or MICROBIT_INVALID_PARAMETER
+      *         if buffer is NULL, or the given bufferLen is <= 0. If an error is returned, release is not called.
+      */
+    int send(uint8_t *buffer, int bufferLen, void (*release)(void *), void *context, MicroBitSerialMode mode = ASYNC);
+
     /**
       * Reads a single character from the rxBuff
       *
@@ -318,7 +525,8 @@ class MicroBitSerial : public RawSerial
       *
       *         Defaults to SYNC_SLEEP.
       *
-      * @return a character, MICROBIT_SERIAL_IN_USE if another fiber is using the serial instance for reception,
+      * @return a character, MICROBIT_SERIAL_IN_USE if another fiber is using the serial instance for reception
+      *         and the mode is not SYNC_SLEEP,
       *         MICROBIT_NO_RESOURCES if buffer allocation did not complete successfully, or MICROBIT_NO_DATA if
       *         the rx buffer is empty and the mode given is ASYNC.
       */
@@ -375,7 +583,7 @@ class MicroBitSerial : public RawSerial
       *         Defaults to SYNC_SLEEP.
       *
       * @return the number of characters read, or MICROBIT_SERIAL_IN_USE if another fiber
-      *         is using the instance for receiving.
+      *         is using the instance for receiving and the mode is not SYNC_SLEEP.
       */
     int read(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
 
@@ -404,12 +612,66 @@ class MicroBitSerial : public RawSerial
       *         Defaults to SYNC_SLEEP.
       *
       * @return A ManagedString containing the characters up to a delimeter, or an Empty ManagedString,
-      *         if another fiber is currently using this instance for reception.
+      *         if another fiber is currently using this instance for reception and the mode is not SYNC_SLEEP.
       *
       * @note delimeters are matched on a per byte basis.
       */
     ManagedString readUntil(ManagedString delimeters, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
 
+    /**
+      * Reads the next line from the rxBuff without copying it, where possible. The line is returned as a pointer
+      * directly into the rxBuff, unless it wraps around the end of the rxBuff's storage, in which case only then is
+      * it copied (into a buffer allocated once and reused).
+      *
+      * The line remains valid, and this instance remains locked for reception, until releaseLine() is called.
+      * This must be called once the caller has finished with the line, whenever this method returns a value >= 0.
+      *
+      * @param line set to the first character of the line. The terminator is not included, and the line is not NUL terminated.
+      *
+      * @param terminator a NUL terminated sequence of up to MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH characters that ends each line e.g. "\r\n".
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+      *        gives a different behaviour:
+      *
+      *            ASYNC - If a complete line is already in the rxBuff, it is returned.
+      *                    Otherwise, MICROBIT_NO_DATA is returned immediately.
+      *
+      *            SYNC_SPINWAIT - If a complete line is already in the rxBuff, it is returned.
+      *                            Otherwise, this method will spin (lock up the processor) until one is received.
+      *
+      *            SYNC_SLEEP - If a complete line is already in the rxBuff, it is returned.
+      *                         Otherwise, the calling fiber sleeps until one is received.
+      *
+      *         Defaults to SYNC_SLEEP.
+      *
+      * @return the length of the line, MICROBIT_NO_DATA if no line is available and the mode is ASYNC, MICROBIT_SERIAL_IN_USE
+      *         if another fiber is currently using this instance for reception and the mode is not SYNC_SLEEP, or
+      *         MICROBIT_INVALID_PARAMETER if the terminator is empty or too long.
+      *
+      * @note If the rxBuff fills without a terminator being seen, its entire contents are returned as a line,
+      *       so that a line longer than the rxBuff cannot stall reception.
+      *
+      * @code
+      * uint8_t *line;
+      * int len = serial.readLine(line, "\r\n");
+      *
+      * if (len >= 0)
+      * {
+      *     // parse the line...
+      *     serial.releaseLine();
+      * }
+      * @endcode
+      */
+    int readLine(uint8_t *&line, const char *terminator, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
+    /**
+      * Removes the line returned by the last call to readLine() from the rxBuff, and unlocks this
+      * instance for reception.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if there is no line to release.
+      */
+    int releaseLine();
+
     /**
       * A wrapper around the inherited method "baud" so we can trap the baud rate
       * as it changes and restore it if redirect() is called.
@@ -479,6 +741,31 @@ class MicroBitSerial : public RawSerial
       */
     int eventOn(ManagedString delimeters, MicroBitSerialMode mode = ASYNC);
 
+    /**
+      * Configures an event to be fired on a match with a multi-byte terminator, such as "\r\n".
+      *
+      * Will generate an event with the ID: MICROBIT_ID_SERIAL and the value MICROBIT_SERIAL_EVT_TERMINATOR_MATCH.
+      * Unlike eventOn(), the whole sequence must be received, in order, for a match.
+      * Matches do not overlap: "\r\n\r\n" contains two matches of "\r\n", and "aaaa" two matches of "aa".
+      *
+      * @param terminator the sequence of characters to match received characters against e.g. ManagedString("\r\n"),
+      *        or an empty ManagedString to stop matching.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+      *        gives a different behaviour:
+      *
+      *            ASYNC - Will configure the event and return immediately.
+      *
+      *            SYNC_SPINWAIT - will return MICROBIT_INVALID_PARAMETER
+      *
+      *            SYNC_SLEEP - Will configure the event and block the current fiber until the
+      *                         event is received.
+      *
+      * @return MICROBIT_INVALID_PARAMETER if the mode given is SYNC_SPINWAIT, or the terminator is longer than
+      *         MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH, otherwise MICROBIT_OK.
+      */
+    int eventOnTerminator(ManagedString terminator, MicroBitSerialMode mode = ASYNC);
+
     /**
       * Determines whether there is any data waiting in our Rx buffer.
       *
@@ -585,6 +872,29 @@ class MicroBitSerial : public RawSerial
       */
     int txInUse();
 
+    /**
+      * Reads the activity counters of this instance, for example to measure throughput and
+      * interrupt cost when validating changes on real hardware.
+      *
+      * @param stats The structure to populate with the current counters.
+      *
+      * @note Interrupt times are only recorded if MICROBIT_SERIAL_PROFILING is enabled, and are otherwise zero.
+      *
+      * @code
+      * MicroBitSerialStats s;
+      *
+      * serial.resetStats();
+      * // run a loopback test...
+      * serial.getStats(s);
+      * @endcode
+      */
+    void getStats(MicroBitSerialStats &stats);
+
+    /**
+      * Resets all the activity counters of this instance to zero.
+      */
+    void resetStats();
+
     /**
       * Detaches a previously configured interrupt
       *
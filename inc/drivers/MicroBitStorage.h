@@ -72,12 +72,14 @@ struct KeyValueStore
   * This class operates as a key value store, it allows the retrieval, addition
   * and deletion of KeyValuePairs.
   *
-  * The first 8 bytes are reserved for the KeyValueStore struct which gives core
-  * information such as the number of KeyValuePairs in the store, and whether the
-  * store has been initialised.
+  * The first 8 bytes are reserved for the KeyValueStore struct, whose magic number
+  * shows the store has been initialised.
   *
-  * After the KeyValueStore struct, KeyValuePairs are arranged contiguously until
-  * the end of the block used as persistent storage.
+  * After the KeyValueStore struct, KeyValuePairs form an append-only log until
+  * the end of the block used as persistent storage. Each update appends a new record,
+  * and the latest record for a key holds its value. A removal appends a record with an
+  * empty key, holding the key removed. Only when the log is full is it compacted,
+  * via the scratch page, down to the latest value of each key.
   *
   * |-------8-------|--------48-------|-----|---------48--------|
   * | KeyValueStore | KeyValuePair[0] | ... | KeyValuePair[N-1] |
@@ -85,6 +87,43 @@ struct KeyValueStore
   */
 class MicroBitStorage
 {
+    // Changes made since begin(), to be applied together by commit(). NULL if no transaction is open.
+    KeyValuePair *pending;
+    int pendingCount;
+
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
+    // Hash table of the stored keys, holding the position in the log of the latest record of each key (plus one).
+    // Zero marks an empty slot.
+    uint8_t keyIndex[MICROBIT_STORAGE_INDEX_SIZE];
+
+    // The position of the first unused record in the log, when the index was last updated.
+    int logEnd;
+
+    // Set if the index describes every stored key.
+    bool indexed;
+
+    /**
+      * Determines the slot of the index used by the given key.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @return the slot holding the key, or the empty slot it should be placed in, or -1 if the index is full.
+      */
+    int getIndexSlot(const char *key);
+
+    /**
+      * Rebuilds the index from the log held in flash.
+      */
+    void buildIndex();
+
+    /**
+      * Determines if the index still describes the log, which may have been changed by another instance.
+      *
+      * @return 1 if the index can be used, 0 otherwise.
+      */
+    int isIndexCurrent();
+#endif
+
     /**
       * Function for copying words from one location to another.
       *
@@ -97,22 +136,139 @@ class MicroBitStorage
     void flashCopy(uint32_t* from, uint32_t* to, int sizeInWords);
 
     /**
-      * Function for populating the scratch page with a KeyValueStore.
+      * Determines the number of KeyValuePair records that fit in the storage page.
+      *
+      * @return the capacity of the log, in records.
+      */
+    int getCapacity();
+
+    /**
+      * Determines where a given record of the log is held in FLASH.
+      *
+      * @param page the storage or scratch page.
+      *
+      * @param index the position of the record in the log.
+      *
+      * @return a pointer to the record.
+      */
+    KeyValuePair* getRecord(uint32_t *page, int index);
+
+    /**
+      * Validates the storage page, returning its address.
+      *
+      * If the page holds no log, it is recovered from the scratch page if a compaction was
+      * interrupted, or formatted as an empty log otherwise.
+      *
+      * @return the address of the storage page.
+      */
+    uint32_t* getStorePage();
+
+    /**
+      * Searches the log for the latest record of the given key.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @param end set to the index of the first unused record in the log.
+      *
+      * @return the index of the latest record holding the key, or -1 if the key is not stored.
+      */
+    int findRecord(const char *key, int *end);
+
+    /**
+      * Determines if a record of the log holds the current value of its key.
+      *
+      * @param page the page holding the log.
+      *
+      * @param index the position of the record in the log.
+      *
+      * @param end the index of the first unused record in the log.
+      *
+      * @return 1 if the record is the latest one for a stored key, 0 otherwise.
+      */
+    int isLive(uint32_t *page, int index, int end);
+
+    /**
+      * Determines if a record is completely erased.
+      *
+      * @param record the record to test.
+      *
+      * @return 1 if every word of the record is erased, 0 otherwise.
+      */
+    int isErased(KeyValuePair *record);
+
+    /**
+      * Writes a record to the given slot of the log.
+      *
+      * The value is written before the key, so a record interrupted by a reset is never
+      * mistaken for a valid one.
+      *
+      * @param record the unused slot to write to.
+      *
+      * @param pair the KeyValuePair to store.
+      */
+    void writeRecord(KeyValuePair *record, KeyValuePair *pair);
+
+    /**
+      * Determines the key a record applies to.
+      *
+      * @param pair the record.
       *
-      * @param store the KeyValueStore struct to write to the scratch page.
+      * @return the key stored, or for a removal, the key removed.
       */
-    void scratchKeyValueStore(KeyValueStore store);
+    const char* getRecordKey(KeyValuePair *pair);
 
     /**
-      * Function for populating the scratch page with a KeyValuePair.
+      * Determines if a record is superseded by one of a given set of new records.
+      *
+      * @param record the record to test.
       *
-      * @param pair the KeyValuePair struct to write to the scratch page.
+      * @param pairs the new records.
       *
-      * @param flashPointer the pointer in flash where this KeyValuePair resides. This pointer
-      * is used to determine the offset into the scratch page, where the KeyValuePair should
-      * be written.
+      * @param count the number of new records.
+      *
+      * @return 1 if one of the new records applies to the same key, 0 otherwise.
       */
-    void scratchKeyValuePair(KeyValuePair pair, uint32_t* flashPointer);
+    int isReplaced(KeyValuePair *record, KeyValuePair *pairs, int count);
+
+    /**
+      * Appends records to the log, compacting the log first if they do not fit.
+      *
+      * Several records are preceded by a marker holding their number, so that they are applied
+      * together or not at all. Compaction copies the current value of every key (other than those
+      * being written) into the scratch page, followed by the new records, then copies the result
+      * back to the storage page.
+      *
+      * @param pairs the records to store. Removals hold an empty key, followed by the key removed.
+      *
+      * @param count the number of records.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_RESOURCES if the storage page is full.
+      */
+    int appendRecords(KeyValuePair *pairs, int count);
+
+    /**
+      * Discards a group of records left incomplete at the end of the log, such as by a reset during commit().
+      * The records are cleared to zero, which needs no erase, and is ignored when reading the log.
+      */
+    void discardIncompleteRecords();
+
+    /**
+      * Finds the change to the given key held in the current transaction.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @return the pending record for the key, or NULL if there is none.
+      */
+    KeyValuePair* getPendingRecord(const char *key);
+
+    /**
+      * Adds a change to the current transaction, replacing any earlier change to the same key.
+      *
+      * @param pair the new record.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_RESOURCES if the transaction is full.
+      */
+    int addPendingRecord(KeyValuePair *pair);
 
     public:
 
@@ -151,7 +307,7 @@ class MicroBitStorage
       *
       * @param dataSize the size of the data to be persisted
       *
-      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is empty or the key or size is too large,
       *         MICROBIT_NO_RESOURCES if the storage page is full
       */
     int put(const char* key, uint8_t* data, int dataSize);
@@ -167,7 +323,7 @@ class MicroBitStorage
       *
       * @param dataSize the size of the data to be persisted
       *
-      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is empty or the key or size is too large,
       *         MICROBIT_NO_RESOURCES if the storage page is full
       */
     int put(ManagedString key, uint8_t* data, int dataSize);
@@ -196,6 +352,55 @@ class MicroBitStorage
       */
     KeyValuePair* get(ManagedString key);
 
+    /**
+      * Retreives a KeyValuePair identified by a given key, without allocating memory.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @param pair the buffer to copy the KeyValuePair into.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the key was not found in storage.
+      */
+    int get(const char* key, KeyValuePair *pair);
+
+    /**
+      * Finds a KeyValuePair identified by a given key, in place in flash.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @return a pointer to the KeyValuePair in flash, or NULL if the key was not found in storage.
+      *
+      * @note the pointer is only valid until the next put() or remove().
+      */
+    const KeyValuePair* find(const char* key);
+
+    /**
+      * Starts a transaction. Subsequent calls to put() and remove() are held in RAM, and applied
+      * to flash together by commit(), in a single log append or page rewrite. Either all of the
+      * changes are stored, or, if a reset interrupts commit(), none of them are.
+      *
+      * Values written in the transaction are returned by get() and find() until it is committed.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if a transaction is already open,
+      *         or MICROBIT_NO_RESOURCES if there is not enough memory.
+      *
+      * @code
+      * storage.begin();
+      * storage.put("x", (uint8_t *)&x, sizeof(x));
+      * storage.put("y", (uint8_t *)&y, sizeof(y));
+      * storage.commit();
+      * @endcode
+      */
+    int begin();
+
+    /**
+      * Applies every change made since begin() to flash, and closes the transaction.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if no transaction is open,
+      *         or MICROBIT_NO_RESOURCES if the storage page is full, in which case no changes are made.
+      */
+    int commit();
+
     /**
       * Removes a KeyValuePair identified by a given key.
       *
@@ -42,6 +42,10 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_THERMOMETER_EVT_UPDATE         1
 
 #define MICROBIT_THERMOMETER_ADDED_TO_IDLE      2
+#define MICROBIT_THERMOMETER_SAMPLING           4
+
+// The value held in place of a temperature until the first conversion completes.
+#define MICROBIT_THERMOMETER_NO_SAMPLE          INT16_MIN
 
 /**
   * Class definition for MicroBit Thermometer.
@@ -54,12 +58,15 @@ class MicroBitThermometer : public MicroBitComponent
 {
     unsigned long           sampleTime;
     uint32_t                samplePeriod;
-    int16_t                 temperature;
+    volatile int16_t        temperature;
     int16_t                 offset;
     MicroBitStorage*        storage;
 
     public:
 
+    // The instance whose conversion is in progress, if any.
+    static MicroBitThermometer *instance;
+
     /**
       * Constructor.
       * Create new MicroBitThermometer that gives an indication of the current temperature.
@@ -151,6 +158,9 @@ class MicroBitThermometer : public MicroBitComponent
       * This call also will add the thermometer to fiber components to receive
       * periodic callbacks.
       *
+      * Unless Bluetooth is enabled, this only starts a conversion and returns immediately.
+      * The new sample is recorded from the sensor's interrupt, which raises MICROBIT_THERMOMETER_EVT_UPDATE.
+      *
       * @return MICROBIT_OK on success.
       */
     int updateSample();
@@ -160,6 +170,12 @@ class MicroBitThermometer : public MicroBitComponent
       */
     virtual void idleTick();
 
+    /**
+      * Interrupt handler for the temperature sensor. Records the result of the conversion
+      * started by updateSample(), and raises MICROBIT_THERMOMETER_EVT_UPDATE.
+      */
+    void onConversion();
+
     private:
 
     /**
@@ -168,6 +184,20 @@ class MicroBitThermometer : public MicroBitComponent
       * @return 1 if we're due to take a temperature reading, 0 otherwise.
       */
     int isSampleNeeded();
+
+    /**
+      * Records a new reading from the temperature sensor, schedules the next, and raises
+      * MICROBIT_THERMOMETER_EVT_UPDATE.
+      *
+      * @param processorTemperature The raw reading, in units of 0.25 degrees celsius.
+      */
+    void recordSample(int32_t processorTemperature);
+
+    /**
+      * Waits for the first conversion to complete, if no temperature has yet been read.
+      * A conversion takes tens of microseconds, so this only ever delays the very first reading.
+      */
+    void waitForSample();
 };
 
 #endif
@@ -0,0 +1,220 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef MICROBIT_TOUCH_SENSOR_H
+#define MICROBIT_TOUCH_SENSOR_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitComponent.h"
+
+// The largest number of pins measured by a single MicroBitTouchSensor.
+#define MICROBIT_TOUCH_SENSOR_MAX_PINS          6
+
+// The time each pin is held low to discharge it before a measurement, in microseconds.
+#define MICROBIT_TOUCH_SENSOR_DISCHARGE_TIME    10
+
+// The weight given to each new reading when tracking the baseline of an untouched pin, as a power of two.
+// A value of 4 gives each reading a weight of 1/16.
+#define MICROBIT_TOUCH_SENSOR_BASELINE_SHIFT    4
+
+/**
+  * The state of a single pin measured by a MicroBitTouchSensor.
+  */
+struct MicroBitTouchChannel
+{
+    PinName         name;                   // The pin measured.
+    uint16_t        id;                     // The id used for the events of this pin.
+    uint16_t        reading;                // The most recent charge time, in iterations of the measurement loop.
+    uint32_t        baseline;               // The untouched charge time, scaled by 2^MICROBIT_TOUCH_SENSOR_BASELINE_SHIFT, or 0 if not yet measured.
+    uint8_t         state;                  // MICROBIT_BUTTON_STATE flags.
+    unsigned long   downStartTime;          // The system time at which the pin was touched.
+};
+
+/**
+  * Class definition for MicroBitTouchSensor.
+  *
+  * Measures the capacitance of a set of pins by the time each takes to charge through its pull up resistor,
+  * after being discharged to GND. A finger on the pin adds capacitance, and so lengthens the charge time.
+  * All of the pins are measured together, in a single pass, once every period.
+  *
+  * Each pin tracks its own untouched baseline, so that slow drift is ignored. A pin is touched once its charge time
+  * rises above the baseline by the upper threshold, and released once it falls back below the lower threshold.
+  * Contact with GND is also reported as a touch, since the pin then fails to charge at all.
+  *
+  * Changes are reported as MICROBIT_BUTTON_EVT_DOWN, MICROBIT_BUTTON_EVT_UP, MICROBIT_BUTTON_EVT_CLICK,
+  * MICROBIT_BUTTON_EVT_LONG_CLICK and MICROBIT_BUTTON_EVT_HOLD events, with the id given for each pin,
+  * as for a MicroBitButton.
+  *
+  * @note P0, P1 and P2 of the edge connector have external 10M pull up resistors, which suit this measurement.
+  *       Other pins are charged by the internal pull up, which is too strong to resolve a touch reliably.
+  */
+class MicroBitTouchSensor : public MicroBitComponent
+{
+    MicroBitTouchChannel    channels[MICROBIT_TOUCH_SENSOR_MAX_PINS];   // The pins measured.
+    uint8_t                 count;                                      // The number of pins measured.
+    uint8_t                 thresholdHi;                                // The percentage increase in charge time at which a pin is touched.
+    uint8_t                 thresholdLo;                                // The percentage increase in charge time below which a pin is released.
+    uint16_t                period;                                     // The time between measurements, in system ticks.
+
+    /**
+      * Determines the channel measuring the given pin.
+      *
+      * @param name The pin.
+      *
+      * @return The channel, or NULL if the pin is not measured.
+      */
+    MicroBitTouchChannel* getChannel(PinName name);
+
+    /**
+      * Measures the charge time of every pin, in a single pass.
+      */
+    void measure();
+
+    /**
+      * Updates the baseline and touch state of the given channel from its latest reading, raising events on any change.
+      *
+      * @param c The channel.
+      */
+    void update(MicroBitTouchChannel &c);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create a representation of a touch sensor, with no pins.
+      *
+      * @param id the unique EventModel id of this component. Defaults to MICROBIT_ID_TOUCH_SENSOR.
+      *
+      * @code
+      * MicroBitTouchSensor touch;
+      * @endcode
+      */
+    MicroBitTouchSensor(uint16_t id = MICROBIT_ID_TOUCH_SENSOR);
+
+    /**
+      * Adds a pin to the set of pins measured. The pin is configured as an input with no pull, and its baseline
+      * is taken from the first measurement, so it should not be touched until then.
+      *
+      * @param name The pin to measure.
+      *
+      * @param id The id used for the events of this pin, typically that of the MicroBitPin.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if MICROBIT_TOUCH_SENSOR_MAX_PINS pins are already measured.
+      *
+      * @code
+      * touch.addPin(MICROBIT_PIN_P0, MICROBIT_ID_IO_P0);
+      * @endcode
+      */
+    int addPin(PinName name, uint16_t id);
+
+    /**
+      * Removes a pin from the set of pins measured.
+      *
+      * @param name The pin.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+      */
+    int removePin(PinName name);
+
+    /**
+      * Tests if the given pin is currently touched.
+      *
+      * @param name The pin.
+      *
+      * @return 1 if the pin is touched, 0 if not, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+      *
+      * @code
+      * if (touch.isTouched(MICROBIT_PIN_P0))
+      *     display.scroll("Touched!");
+      * @endcode
+      */
+    int isTouched(PinName name);
+
+    /**
+      * Retrieves the most recent charge time of the given pin. This, with getBaseline(), is useful when tuning thresholds.
+      *
+      * @param name The pin.
+      *
+      * @return The charge time, in iterations of the measurement loop, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+      */
+    int getReading(PinName name);
+
+    /**
+      * Retrieves the untouched charge time of the given pin.
+      *
+      * @param name The pin.
+      *
+      * @return The baseline charge time, in iterations of the measurement loop, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+      */
+    int getBaseline(PinName name);
+
+    /**
+      * Sets the time between measurements.
+      *
+      * @param period The time between measurements, in milliseconds. This is rounded to a whole number of system ticks.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if period is not positive.
+      */
+    int setPeriod(int period);
+
+    /**
+      * Retrieves the time between measurements.
+      *
+      * @return The time between measurements, in milliseconds.
+      */
+    int getPeriod();
+
+    /**
+      * Sets the thresholds at which pins are touched and released.
+      *
+      * @param hi The percentage increase in charge time over the baseline at which a pin becomes touched.
+      *
+      * @param lo The percentage increase in charge time over the baseline below which a touched pin is released.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER unless 0 <= lo < hi <= 255.
+      *
+      * @code
+      * // Make the pins more sensitive.
+      * touch.setThreshold(20, 10);
+      * @endcode
+      */
+    int setThreshold(int hi, int lo);
+
+    /**
+      * Periodic callback from MicroBit system timer.
+      *
+      * Measures every pin, and raises events on any change.
+      */
+    virtual void systemTick();
+
+    /**
+      * Destructor, where we deregister this instance from the system timer.
+      */
+    ~MicroBitTouchSensor();
+};
+
+#endif
@@ -27,13 +27,33 @@ DEALINGS IN THE SOFTWARE.
 
 #include "mbed.h"
 #include "MicroBitConfig.h"
+#include "MicroBitRingBuffer.h"
+
+/**
+  * An edge recorded in hardware capture mode.
+  */
+struct TimedEdge
+{
+    uint32_t        timestamp;          // The time of the edge, in microseconds. This wraps every 71 minutes.
+    uint8_t         level;              // The level of the pin after the edge: 1 for a rising edge, 0 for a falling edge.
+};
 
 class TimedInterruptIn : public InterruptIn
 {
     uint64_t timestamp;
+    PinName name;
 
     public:
 
+    // Edges awaiting collection in hardware capture mode.
+    MicroBitRingBuffer<TimedEdge> edges;
+
+    // The total number of edges seen on the pin. This wraps, so should be compared by difference.
+    volatile uint32_t edgeCount;
+
+    // The value of edgeCount at the end of the last counting window.
+    uint32_t windowCount;
+
     /**
       * Constructor.
       *
@@ -54,6 +74,46 @@ class TimedInterruptIn : public InterruptIn
       * @return the timestamp held by this instance.
       */
     uint64_t getTimestamp();
+
+    /**
+      * Enables hardware capture. Each edge on the pin is timestamped by TIMER1 via GPIOTE and PPI, free of
+      * interrupt latency. The rise and fall handlers can then record the edge with captureEdge().
+      *
+      * Only one instance may use hardware capture at a time, and not whilst TIMER1 is generating software PWM channels.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_BUSY if another instance is using hardware capture or TIMER1 is in use
+      *         by DynamicPwm, MICROBIT_NO_RESOURCES if the edge buffer could not be allocated, or MICROBIT_NOT_SUPPORTED
+      *         if MICROBIT_PIN_CAPTURE is disabled.
+      */
+    int enableCapture();
+
+    /**
+      * Disables hardware capture, releasing the timer, GPIOTE and PPI channels for use by another instance.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if this instance is not using hardware capture.
+      */
+    int disableCapture();
+
+    /**
+      * Records the most recent edge captured in hardware. Called from the rise and fall handlers.
+      *
+      * @param level The level of the pin after the edge.
+      *
+      * @return The number of edges now waiting, or MICROBIT_NO_RESOURCES if the buffer is full and the edge was dropped.
+      */
+    int captureEdge(int level);
+
+    /**
+      * Determines if any instance is using hardware capture, and so holds TIMER1.
+      *
+      * @return true if hardware capture is in use, false otherwise.
+      */
+    static bool isCaptureActive();
+
+    /**
+      * Destructor. Releases hardware capture, if in use.
+      */
+    ~TimedInterruptIn();
 };
 
 #endif
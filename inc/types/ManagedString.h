@@ -36,6 +36,24 @@ struct StringData : RefCounted
     char data[0];
 };
 
+/**
+  * Defines a string literal, laid out as a read only StringData and held in flash, for use with
+  * ManagedString(StringData *). This costs no RAM and no heap allocation, however often it is used.
+  *
+  * @param name The name of the literal to define.
+  *
+  * @param text The string literal to hold.
+  *
+  * @code
+  * MICROBIT_STRING_LITERAL(hello, "Hello World!");
+  *
+  * display.scroll(ManagedString((StringData*)(void*)&hello));
+  * @endcode
+  */
+#define MICROBIT_STRING_LITERAL(name, text)                                                                           \
+    static const struct { uint16_t refCount; uint16_t len; char data[sizeof(text)]; }                                 \
+        name __attribute__ ((aligned (4))) = { 0xffff, sizeof(text) - 1, text }
+
 
 /**
   * Class definition for a ManagedString.
@@ -64,6 +82,13 @@ class ManagedString
     // We control access to this to proide immutability and reference counting.
     StringData *ptr;
 
+#if MICROBIT_STRING_INLINE_LENGTH > 0
+    // Strings of up to MICROBIT_STRING_INLINE_LENGTH characters are held here rather than on the heap,
+    // laid out as a read only StringData so that ptr can refer to them as to any other.
+    // Being read only, they are never counted, and so are copied rather than shared.
+    uint32_t inlineData[(4 + MICROBIT_STRING_INLINE_LENGTH + 1 + 3) / 4];
+#endif
+
     public:
 
     /**
@@ -71,6 +96,7 @@ class ManagedString
       * Create a managed string from a specially prepared string literal.
       *
       * @param ptr The literal - first two bytes should be 0xff, then the length in little endian, then the literal. The literal has to be 4-byte aligned.
+      *        MICROBIT_STRING_LITERAL lays one out from an ordinary string literal.
       *
       * @code
       * static const char hello[] __attribute__ ((aligned (4))) = "\xff\xff\x05\x00" "Hello";
@@ -83,6 +109,7 @@ class ManagedString
       * Get current ptr, do not decr() it, and set the current instance to empty string.
       *
       * This is to be used by specialized runtimes which pass StringData around.
+      * A string held inline is first copied to the heap, so the result always outlives this instance.
       */
     StringData *leakData();
 
@@ -162,7 +189,8 @@ class ManagedString
       * Copy constructor.
       * Makes a new ManagedString identical to the one supplied.
       *
-      * Shares the character buffer and reference count with the supplied ManagedString.
+      * Shares the character buffer and reference count with the supplied ManagedString,
+      * or copies it if it is short enough to be held inline.
       *
       * @param s The ManagedString to copy.
       *
@@ -382,6 +410,31 @@ class ManagedString
       */
     void initString(const char *str);
 
+    /**
+      * Internal constructor helper.
+      *
+      * Provides storage for a string of the given length, inline if it fits and otherwise on the heap.
+      *
+      * @param len The number of characters in the string.
+      *
+      * @return The location at which the len characters and their terminating null should be written.
+      */
+    char *initBuffer(int len);
+
+    /**
+      * Internal constructor helper.
+      *
+      * Makes this ManagedString identical to the one supplied, sharing its character buffer unless it is held inline.
+      */
+    void initCopy(const ManagedString &s);
+
+    /**
+      * Determines if this ManagedString holds its characters inline.
+      *
+      * @return true if the string is held inline, false if it is on the heap or in flash.
+      */
+    bool isInline() const;
+
     /**
       * Private Constructor.
       *
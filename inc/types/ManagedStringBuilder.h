@@ -0,0 +1,198 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef MANAGED_STRING_BUILDER_H
+#define MANAGED_STRING_BUILDER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedString.h"
+
+// The capacity given to a ManagedStringBuilder on its first append, if none was reserved.
+#define MANAGED_STRING_BUILDER_MIN_CAPACITY     16
+
+// The longest string a ManagedStringBuilder can hold, which is the longest ManagedString.
+#define MANAGED_STRING_BUILDER_MAX_CAPACITY     32767
+
+/**
+  * Class definition for a ManagedStringBuilder.
+  *
+  * Builds a string from many parts in a single growable buffer, without the intermediate copy and allocation
+  * that each use of ManagedString's operator+ would make. The buffer doubles in size as required, and is
+  * laid out as a StringData, so that toManagedString() can pass it on to a ManagedString without copying.
+  * Reserving the expected capacity up front avoids any growth.
+  *
+  * @code
+  * ManagedStringBuilder line(32);
+  *
+  * line.append("t=").append(t).append(",x=").append(x).append('\n');
+  * serial.send(line.toManagedString());
+  * @endcode
+  */
+class ManagedStringBuilder
+{
+    StringData      *buffer;            // The string so far, with its length and terminating null, or NULL if nothing is held.
+    uint16_t        capacity;           // The number of characters the buffer can hold, excluding the terminating null.
+
+    /**
+      * Moves the string built so far into a new buffer of the given capacity.
+      *
+      * @param capacity The number of characters the new buffer can hold, which must be at least length().
+      */
+    void resize(int capacity);
+
+    /**
+      * Ensures the buffer can hold at least the given number of characters, growing it if necessary.
+      *
+      * @param size The number of characters required.
+      *
+      * @return true if the buffer can hold size characters, false if size exceeds MANAGED_STRING_BUILDER_MAX_CAPACITY.
+      */
+    bool grow(int size);
+
+    // ManagedStringBuilder holds its buffer exclusively, so may not be copied.
+    ManagedStringBuilder(const ManagedStringBuilder &);
+    ManagedStringBuilder& operator = (const ManagedStringBuilder &);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create an empty ManagedStringBuilder.
+      *
+      * @param capacity The number of characters to reserve space for. If 0, no space is allocated until the first append.
+      *
+      * @code
+      * ManagedStringBuilder b(64);
+      * @endcode
+      */
+    ManagedStringBuilder(int capacity = 0);
+
+    /**
+      * Ensures the builder can hold at least the given number of characters without growing.
+      *
+      * @param capacity The number of characters to reserve space for.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if capacity is negative or exceeds MANAGED_STRING_BUILDER_MAX_CAPACITY.
+      */
+    int reserve(int capacity);
+
+    /**
+      * Appends the given characters.
+      *
+      * @param str The characters to append.
+      *
+      * @param len The number of characters to append.
+      *
+      * @return this ManagedStringBuilder, so that appends may be chained. Characters beyond MANAGED_STRING_BUILDER_MAX_CAPACITY are discarded.
+      */
+    ManagedStringBuilder& append(const char *str, int len);
+
+    /**
+      * Appends the given null terminated string.
+      *
+      * @param str The string to append. NULL is ignored.
+      *
+      * @return this ManagedStringBuilder, so that appends may be chained.
+      *
+      * @code
+      * b.append("x=");
+      * @endcode
+      */
+    ManagedStringBuilder& append(const char *str);
+
+    /**
+      * Appends the given ManagedString.
+      *
+      * @param s The string to append.
+      *
+      * @return this ManagedStringBuilder, so that appends may be chained.
+      */
+    ManagedStringBuilder& append(const ManagedString &s);
+
+    /**
+      * Appends a single character.
+      *
+      * @param c The character to append.
+      *
+      * @return this ManagedStringBuilder, so that appends may be chained.
+      */
+    ManagedStringBuilder& append(char c);
+
+    /**
+      * Appends the given integer, in decimal, without allocating an intermediate ManagedString.
+      *
+      * @param value The integer to append.
+      *
+      * @return this ManagedStringBuilder, so that appends may be chained.
+      *
+      * @code
+      * b.append("t=").append(1234);    // "t=1234"
+      * @endcode
+      */
+    ManagedStringBuilder& append(int value);
+
+    /**
+      * Determines the length of the string built so far.
+      *
+      * @return The number of characters held.
+      */
+    int length() const;
+
+    /**
+      * Provides the string built so far, without creating a ManagedString. This suits calls that take
+      * a character array and length, such as MicroBitFile::write().
+      *
+      * @return The characters held, with a terminating null. This remains valid until the builder is next changed.
+      */
+    const char *toCharArray() const;
+
+    /**
+      * Discards the string built so far, keeping the buffer for reuse.
+      */
+    void clear();
+
+    /**
+      * Creates a ManagedString holding the string built so far, and empties the builder.
+      *
+      * A string short enough to be held inline by ManagedString is copied, and the buffer is kept for reuse.
+      * Otherwise, the buffer itself is passed to the ManagedString, without copying.
+      *
+      * @return The string built.
+      *
+      * @code
+      * ManagedString s = b.toManagedString();
+      * @endcode
+      */
+    ManagedString toManagedString();
+
+    /**
+      * Destructor. Frees the buffer, unless it has been passed to a ManagedString.
+      */
+    ~ManagedStringBuilder();
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef MANAGED_STRING_VIEW_H
+#define MANAGED_STRING_VIEW_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedString.h"
+
+/**
+  * Class definition for a ManagedStringView.
+  *
+  * Refers to a range of characters within a ManagedString, without copying them. The ManagedString is
+  * retained by the view, so the characters remain valid for as long as the view exists. Taking substrings,
+  * searching, comparing and parsing numbers are all done in place, so a parser can walk over a line of
+  * input without any allocation. A ManagedString is only created when toManagedString() is called.
+  *
+  * The range is held as an offset rather than a pointer, since short strings are held within the
+  * ManagedString itself, and so move when the view is copied.
+  *
+  * @note The characters of a view are not null terminated, so should be used with length().
+  *
+  * @code
+  * ManagedStringView line(serial.readUntil("\n"));
+  * int comma = line.indexOf(',');
+  *
+  * int x, y;
+  * if (line.substring(0, comma).toInt(&x) == MICROBIT_OK && line.substring(comma + 1).toInt(&y) == MICROBIT_OK)
+  *     display.scroll(x + y);
+  * @endcode
+  */
+class ManagedStringView
+{
+    ManagedString   source;             // The string referred to.
+    int16_t         start;              // The index of the first character of the view within source.
+    int16_t         len;                // The number of characters in the view.
+
+    public:
+
+    /**
+      * Default constructor.
+      *
+      * Create an empty view.
+      */
+    ManagedStringView();
+
+    /**
+      * Constructor.
+      *
+      * Create a view of the whole of the given string.
+      *
+      * @param s The string to view.
+      */
+    ManagedStringView(const ManagedString &s);
+
+    /**
+      * Constructor.
+      *
+      * Create a view of part of the given string. The range is clipped to the bounds of the string.
+      *
+      * @param s The string to view.
+      *
+      * @param start The index of the first character of the view.
+      *
+      * @param length The number of characters in the view.
+      */
+    ManagedStringView(const ManagedString &s, int start, int length);
+
+    /**
+      * Provides the characters of this view.
+      *
+      * @return The first character of the view. This is not null terminated.
+      */
+    const char *getBytes() const;
+
+    /**
+      * Determines the number of characters in this view.
+      *
+      * @return The length of the view.
+      */
+    int length() const;
+
+    /**
+      * Provides the character at the given position within this view.
+      *
+      * @param index The position of the character, indexed from zero.
+      *
+      * @return The character, or zero if index is invalid.
+      */
+    char charAt(int index) const;
+
+    /**
+      * Creates a view of part of this view, referring to the same ManagedString. Nothing is copied.
+      *
+      * @param start The index of the first character, relative to this view.
+      *
+      * @param length The number of characters. The range is clipped to the end of this view. Defaults to the rest of the view.
+      *
+      * @return The requested view.
+      *
+      * @code
+      * ManagedStringView cmd("SET 42");
+      * cmd.substring(4);          // "42"
+      * @endcode
+      */
+    ManagedStringView substring(int start, int length = 32767) const;
+
+    /**
+      * Creates a view of this view without any leading or trailing spaces, tabs, carriage returns or newlines.
+      *
+      * @return The trimmed view.
+      */
+    ManagedStringView trim() const;
+
+    /**
+      * Finds the first occurrence of the given character.
+      *
+      * @param c The character to find.
+      *
+      * @param from The index at which to begin the search. Defaults to the start of the view.
+      *
+      * @return The index of the character within this view, or -1 if it is not found.
+      */
+    int indexOf(char c, int from = 0) const;
+
+    /**
+      * Finds the first occurrence of the given string.
+      *
+      * @param str The null terminated string to find.
+      *
+      * @param from The index at which to begin the search. Defaults to the start of the view.
+      *
+      * @return The index of the string within this view, or -1 if it is not found.
+      */
+    int indexOf(const char *str, int from = 0) const;
+
+    /**
+      * Tests if this view begins with the given string.
+      *
+      * @param str The null terminated string to test for.
+      *
+      * @return true if this view begins with str, false otherwise.
+      */
+    bool startsWith(const char *str) const;
+
+    /**
+      * Compares this view with another, in the manner of strcmp().
+      *
+      * @param v The view to compare against.
+      *
+      * @return A negative value if this view is alphabetically before v, zero if they are equal, or a positive value otherwise.
+      */
+    int compare(const ManagedStringView &v) const;
+
+    /**
+      * Equality operation.
+      *
+      * @param v The view to test ourselves against.
+      *
+      * @return true if the views hold the same characters, false otherwise.
+      */
+    bool operator== (const ManagedStringView &v) const;
+
+    /**
+      * Equality operation.
+      *
+      * @param str The null terminated string to test ourselves against.
+      *
+      * @return true if this view holds the same characters as str, false otherwise.
+      *
+      * @code
+      * if (cmd.substring(0, 3) == "SET")
+      *     ...
+      * @endcode
+      */
+    bool operator== (const char *str) const;
+
+    /**
+      * Parses this view as a decimal integer, with an optional leading sign.
+      *
+      * @param value The location to store the result.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if value is NULL, or the view is empty,
+      *         holds anything other than the integer, or holds a value outside the range of an int.
+      */
+    int toInt(int *value) const;
+
+    /**
+      * Creates a ManagedString holding the characters of this view. If the view covers the whole of its
+      * ManagedString, that string is returned. Otherwise, the characters are copied.
+      *
+      * @return The characters of this view, as a ManagedString.
+      */
+    ManagedString toManagedString() const;
+};
+
+#endif
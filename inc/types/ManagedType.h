@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_MANAGED_TYPE_H
 
 #include "MicroBitConfig.h"
+#include "RefCounted.h"
 
 /**
   * Class definition for a Generic Managed Type.
@@ -34,6 +35,10 @@ DEALINGS IN THE SOFTWARE.
   * Represents a reference counted object.
   *
   * @note When the destructor is called, delete is called on the object - implicitly calling the given objects destructor.
+  *
+  * @note If T derives from RefCounted, the reference count is kept inside the object itself, and no
+  *       separate counter is allocated. Such objects are initialised with one reference when first wrapped,
+  *       and objects marked as read only (e.g. held in flash) are never deleted.
   */
 template <class T>
 class ManagedType
@@ -42,6 +47,76 @@ protected:
 
     int *ref;
 
+private:
+
+    // Reference counting for types that derive from RefCounted, using the count held within the object.
+    // Overload resolution prefers these for any T* convertible to RefCounted*.
+    static void initRef(RefCounted *o, int *&ref)
+    {
+        ref = NULL;
+
+        // Leave the marker of an object held in flash intact. A new object's count is not yet initialised,
+        // so we test for the marker directly, rather than through isReadOnly(), which would panic on it.
+        if (o && o->refCount != 0xffff)
+            o->init();
+    }
+
+    static void incrRef(RefCounted *o, int *)
+    {
+        if (o)
+            o->incr();
+    }
+
+    static bool decrRef(RefCounted *o, int *)
+    {
+        if (o == NULL || o->isReadOnly())
+            return false;
+
+        o->refCount -= 2;
+        return o->refCount == 1;
+    }
+
+    static int countRef(RefCounted *o, int *)
+    {
+        return o ? o->refCount >> 1 : 0;
+    }
+
+    // Reference counting for all other types, using a separately allocated counter.
+    static void initRef(void *o, int *&ref)
+    {
+        ref = (int *)malloc(sizeof(int));
+        *ref = o ? 1 : 0;
+    }
+
+    static void incrRef(void *, int *ref)
+    {
+        (*ref)++;
+    }
+
+    static bool decrRef(void *, int *ref)
+    {
+        // Special case - we were created using a default constructor, and never assigned a value.
+        // Simply destroy our reference counter and we're done.
+        if (*ref == 0)
+        {
+            free(ref);
+            return false;
+        }
+
+        if (--(*ref) == 0)
+        {
+            free(ref);
+            return true;
+        }
+
+        return false;
+    }
+
+    static int countRef(void *, int *ref)
+    {
+        return *ref;
+    }
+
 public:
 
     T *object;
@@ -168,8 +243,7 @@ template<typename T>
 ManagedType<T>::ManagedType(T* object)
 {
     this->object = object;
-    ref = (int *)malloc(sizeof(int));
-    *ref = 1;
+    initRef(object, ref);
 }
 
 /**
@@ -179,8 +253,7 @@ template<typename T>
 ManagedType<T>::ManagedType()
 {
     this->object = NULL;
-    ref = (int *)malloc(sizeof(int));
-    *ref = 0;
+    initRef(object, ref);
 }
 
 /**
@@ -199,7 +272,7 @@ ManagedType<T>::ManagedType(const ManagedType<T> &t)
 {
     this->object = t.object;
     this->ref = t.ref;
-    (*ref)++;
+    incrRef(object, ref);
 }
 
 /**
@@ -208,20 +281,9 @@ ManagedType<T>::ManagedType(const ManagedType<T> &t)
 template<typename T>
 ManagedType<T>::~ManagedType()
 {
-    // Special case - we were created using a default constructor, and never assigned a value.
-    if (*ref == 0)
-    {
-        // Simply destroy our reference counter and we're done.
-        free(ref);
-    }
-
-    // Normal case - we have a valid piece of data.
     // Decrement our reference counter and free all allocated memory if we're deleting the last reference.
-    else if (--(*ref) == 0)
-    {
+    if (decrRef(object, ref))
         delete object;
-        free(ref);
-    }
 }
 
 /**
@@ -239,23 +301,13 @@ ManagedType<T>& ManagedType<T>::operator = (const ManagedType<T>&t)
     if (this == &t)
         return *this;
 
-    // Special case - we were created using a default constructor, and never assigned a value.
-    if (*ref == 0)
-    {
-        // Simply destroy our reference counter, as we're about to adopt another.
-        free(ref);
-    }
-
-    else if (--(*ref) == 0)
-    {
+    if (decrRef(object, ref))
         delete object;
-        free(ref);
-    }
 
     object = t.object;
     ref = t.ref;
 
-    (*ref)++;
+    incrRef(object, ref);
 
     return *this;
 }
@@ -274,6 +326,6 @@ ManagedType<T>& ManagedType<T>::operator = (const ManagedType<T>&t)
 template<typename T>
 int ManagedType<T>::getReferences()
 {
-    return (*ref);
+    return countRef(object, ref);
 }
 #endif
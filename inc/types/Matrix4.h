@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_MATRIX4_H
 
 #include "MicroBitConfig.h"
+#include "ErrorNo.h"
 
 /**
 * Class definition for a simple matrix, that is optimised for nx4 or 4xn matrices.
@@ -74,6 +75,16 @@ public:
 	  */
 	Matrix4(const Matrix4 &matrix);
 
+	/**
+	  * Copy assignment operator.
+	  * Makes this matrix an identical copy of the given matrix. Existing storage is reused if it is the right size.
+	  *
+	  * @param matrix The matrix to copy.
+	  *
+	  * @return A reference to this matrix.
+	  */
+	Matrix4& operator=(const Matrix4 &matrix);
+
 	/**
 	  * Determines the number of columns in this matrix.
 	  *
@@ -137,6 +148,20 @@ public:
 	  */
 	Matrix4 transpose();
 
+	/**
+	  * Transposes this matrix into the given matrix, without allocating memory.
+	  *
+	  * @param result The matrix to store the result in, which must have the transposed dimensions of this matrix.
+	  *        This may be the matrix itself, if it is square.
+	  *
+	  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if result is not of the right size.
+	  *
+	  * @code
+	  * matrix.transpose(matrix);     // in place.
+	  * @endcode
+	  */
+	int transpose(Matrix4 &result);
+
 	/**
 	  * Multiplies this matrix with the given matrix (if possible).
 	  *
@@ -152,6 +177,25 @@ public:
 	  */
 	Matrix4 multiply(Matrix4 &matrix, bool transpose = false);
 
+	/**
+	  * Multiplies this matrix with the given matrix into a third matrix, without allocating memory.
+	  *
+	  * @param matrix the matrix to multiply this matrix's values against.
+	  *
+	  * @param result The matrix to store the result in, which must be of the right size.
+	  *        This must not be either of the matrices being multiplied.
+	  *
+	  * @param transpose Transpose this matrix before multiplication. Defaults to false.
+	  *
+	  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the matrices are not of compatible sizes.
+	  *
+	  * @code
+	  * Matrix4 result(a.height(), b.width());
+	  * a.multiply(b, result);
+	  * @endcode
+	  */
+	int multiply(Matrix4 &matrix, Matrix4 &result, bool transpose = false);
+
 	/**
 	  * Multiplies the transpose of this matrix with the given matrix (if possible).
       *
@@ -166,8 +210,20 @@ public:
 	Matrix4 multiplyT(Matrix4 &matrix);
 
 	/**
-	  * Performs an optimised inversion of a 4x4 matrix.
-	  * Only 4x4 matrices are supported by this operation.
+	  * Multiplies the transpose of this matrix with the given matrix into a third matrix, without allocating memory.
+	  *
+	  * @param matrix the matrix to multiply this matrix's values against.
+	  *
+	  * @param result The matrix to store the result in, which must be of the right size.
+	  *        This must not be either of the matrices being multiplied.
+	  *
+	  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the matrices are not of compatible sizes.
+	  */
+	int multiplyT(Matrix4 &matrix, Matrix4 &result);
+
+	/**
+	  * Performs an optimised inversion of a 3x3 or 4x4 matrix.
+	  * Only 3x3 and 4x4 matrices are supported by this operation.
 	  *
 	  * @return the resultant matrix. An empty matrix is returned if the operation canot be completed.
 	  *
@@ -177,6 +233,42 @@ public:
 	  */
 	Matrix4 invert();
 
+	/**
+	  * Inverts this 3x3 or 4x4 matrix into the given matrix, without allocating memory.
+	  *
+	  * @param result The matrix to store the result in, which must be of the same size. This may be the matrix itself.
+	  *
+	  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if result is not of the right size,
+	  *         MICROBIT_NOT_SUPPORTED if this matrix is not 3x3 or 4x4, or MICROBIT_NO_DATA if it is singular.
+	  *
+	  * @code
+	  * matrix.invert(matrix);        // in place.
+	  * @endcode
+	  */
+	int invert(Matrix4 &result);
+
+	/**
+	  * Inverts a 3x3 matrix, held in row major order.
+	  *
+	  * @param m The matrix to invert.
+	  *
+	  * @param result The location to store the inverse. This may be the same as m.
+	  *
+	  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the matrix is singular.
+	  */
+	static int invert3(const float *m, float *result);
+
+	/**
+	  * Inverts a 4x4 matrix, held in row major order.
+	  *
+	  * @param m The matrix to invert.
+	  *
+	  * @param result The location to store the inverse. This may be the same as m.
+	  *
+	  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the matrix is singular.
+	  */
+	static int invert4(const float *m, float *result);
+
 	/**
 	  * Destructor.
 	  *
@@ -199,4 +291,181 @@ inline Matrix4 Matrix4::multiplyT(Matrix4 &matrix)
     return multiply(matrix, true);
 }
 
+/**
+  * Multiplies the transpose of this matrix with the given matrix into a third matrix, without allocating memory.
+  *
+  * @param matrix the matrix to multiply this matrix's values against.
+  *
+  * @param result The matrix to store the result in, which must be of the right size.
+  *        This must not be either of the matrices being multiplied.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the matrices are not of compatible sizes.
+  */
+inline int Matrix4::multiplyT(Matrix4 &matrix, Matrix4 &result)
+{
+    return multiply(matrix, result, true);
+}
+
+/**
+  * Class definition for a matrix of fixed size.
+  *
+  * The elements are stored inline, so a FixedMatrix can live on the stack or within another object,
+  * and no operation on it allocates memory. The dimensions of each operation are checked at compile time.
+  */
+template <int ROWS, int COLS>
+class FixedMatrix
+{
+	public:
+
+	float	data[ROWS * COLS];		// The elements of the matrix, in row major order.
+
+	/**
+	  * Constructor.
+	  * Create a matrix with all elements set to zero.
+	  */
+	FixedMatrix()
+	{
+		for (int i = 0; i < ROWS * COLS; i++)
+			data[i] = 0.0f;
+	}
+
+	/**
+	  * Determines the number of columns in this matrix.
+	  *
+	  * @return The number of columns in the matrix.
+	  */
+	int width() const
+	{
+		return COLS;
+	}
+
+	/**
+	  * Determines the number of rows in this matrix.
+	  *
+	  * @return The number of rows in the matrix.
+	  */
+	int height() const
+	{
+		return ROWS;
+	}
+
+	/**
+	  * Reads the matrix element at the given position. No bounds checking is performed.
+	  *
+	  * @param row The row of the element to read.
+	  *
+	  * @param col The column of the element to read.
+	  *
+	  * @return The value of the matrix element at the given position.
+	  */
+	float get(int row, int col) const
+	{
+		return data[COLS * row + col];
+	}
+
+	/**
+	  * Writes the matrix element at the given position. No bounds checking is performed.
+	  *
+	  * @param row The row of the element to write.
+	  *
+	  * @param col The column of the element to write.
+	  *
+	  * @param v The new value of the element.
+	  */
+	void set(int row, int col, float v)
+	{
+		data[COLS * row + col] = v;
+	}
+
+	/**
+	  * Transposes this matrix into the given matrix.
+	  *
+	  * @param result The matrix to store the result in. This must not be the matrix itself.
+	  */
+	void transpose(FixedMatrix<COLS, ROWS> &result) const
+	{
+		for (int r = 0; r < ROWS; r++)
+			for (int c = 0; c < COLS; c++)
+				result.data[ROWS * c + r] = data[COLS * r + c];
+	}
+
+	/**
+	  * Multiplies this matrix with the given matrix into a third matrix.
+	  *
+	  * @param matrix the matrix to multiply this matrix's values against.
+	  *
+	  * @param result The matrix to store the result in. This must not be either of the matrices being multiplied.
+	  *
+	  * @code
+	  * FixedMatrix<3, 3> a, b, result;
+	  * a.multiply(b, result);
+	  * @endcode
+	  */
+	template <int K>
+	void multiply(const FixedMatrix<COLS, K> &matrix, FixedMatrix<ROWS, K> &result) const
+	{
+		for (int r = 0; r < ROWS; r++)
+		{
+			for (int c = 0; c < K; c++)
+			{
+				float v = 0.0f;
+
+				for (int i = 0; i < COLS; i++)
+					v += data[COLS * r + i] * matrix.data[K * i + c];
+
+				result.data[K * r + c] = v;
+			}
+		}
+	}
+
+	/**
+	  * Multiplies the transpose of this matrix with the given matrix into a third matrix.
+	  *
+	  * @param matrix the matrix to multiply this matrix's values against.
+	  *
+	  * @param result The matrix to store the result in. This must not be either of the matrices being multiplied.
+	  */
+	template <int K>
+	void multiplyT(const FixedMatrix<ROWS, K> &matrix, FixedMatrix<COLS, K> &result) const
+	{
+		for (int r = 0; r < COLS; r++)
+		{
+			for (int c = 0; c < K; c++)
+			{
+				float v = 0.0f;
+
+				for (int i = 0; i < ROWS; i++)
+					v += data[COLS * i + r] * matrix.data[K * i + c];
+
+				result.data[K * r + c] = v;
+			}
+		}
+	}
+
+	/**
+	  * Inverts this matrix into the given matrix. Only 3x3 and 4x4 matrices are supported by this operation.
+	  *
+	  * @param result The matrix to store the result in. This may be the matrix itself.
+	  *
+	  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if this matrix is not 3x3 or 4x4,
+	  *         or MICROBIT_NO_DATA if it is singular.
+	  */
+	int invert(FixedMatrix<ROWS, COLS> &) const
+	{
+		return MICROBIT_NOT_SUPPORTED;
+	}
+};
+
+template <>
+inline int FixedMatrix<3, 3>::invert(FixedMatrix<3, 3> &result) const
+{
+	return Matrix4::invert3(data, result.data);
+}
+
+template <>
+inline int FixedMatrix<4, 4>::invert(FixedMatrix<4, 4> &result) const
+{
+	return Matrix4::invert4(data, result.data);
+}
+
 #endif
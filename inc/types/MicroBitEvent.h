@@ -36,7 +36,8 @@ DEALINGS IN THE SOFTWARE.
 enum MicroBitEventLaunchMode
 {
     CREATE_ONLY,
-    CREATE_AND_FIRE
+    CREATE_AND_FIRE,
+    CREATE_AND_DEFER
 };
 
 #define MICROBIT_EVENT_DEFAULT_LAUNCH_MODE     CREATE_AND_FIRE
@@ -52,7 +53,11 @@ class MicroBitEvent
 
     uint16_t source;         // ID of the MicroBit Component that generated the event e.g. MICROBIT_ID_BUTTON_A.
     uint16_t value;          // Component specific code indicating the cause of the event.
+#if MICROBIT_EVENT_TIMESTAMP_BITS == 64
     uint64_t timestamp;      // Time at which the event was generated. us since power on.
+#elif MICROBIT_EVENT_TIMESTAMP_BITS == 32
+    uint32_t timestamp;      // Time at which the event was generated. us since power on, wrapping every 71 minutes.
+#endif
 
     /**
       * Constructor.
@@ -64,6 +69,8 @@ class MicroBitEvent
       * @param mode Optional definition of how the event should be processed after construction (if at all):
       *                 CREATE_ONLY: MicroBitEvent is initialised, and no further processing takes place.
       *                 CREATE_AND_FIRE: MicroBitEvent is initialised, and its event handlers are immediately fired (not suitable for use in interrupts!).
+      *                 CREATE_AND_DEFER: MicroBitEvent is initialised, and fired later from the idle task using fiber_defer().
+      *                                   Intended for use in interrupts. The event delivered carries the time at which it was fired.
       *
       * @code
       * // Create and launch an event using the default configuration
@@ -84,6 +91,24 @@ class MicroBitEvent
       * Fires this MicroBitEvent onto the Default EventModel, or a custom one!
       */
     void fire();
+
+    /**
+      * Retrieves the time at which this event was generated, regardless of MICROBIT_EVENT_TIMESTAMP_BITS.
+      *
+      * With a 32 bit timestamp, the upper bits are reconstructed from the current time, assuming that the
+      * event is less than 71 minutes old. With no timestamp, the current time is returned.
+      *
+      * @return The time at which the event was generated, in microseconds since power on.
+      */
+    uint64_t getTimestamp() const;
+
+    /**
+      * Sets the timestamp of this event, truncating it to MICROBIT_EVENT_TIMESTAMP_BITS.
+      * This has no effect if events carry no timestamp.
+      *
+      * @param t The new timestamp.
+      */
+    void setTimestamp(uint64_t t);
 };
 
 /**
@@ -101,6 +126,26 @@ struct MicroBitEventQueueItem
       * @param evt The event to be queued.
       */
     MicroBitEventQueueItem(MicroBitEvent evt);
+
+    /**
+      * Allocates storage for a MicroBitEventQueueItem.
+      *
+      * Items are taken from a statically allocated pool of MICROBIT_EVENT_QUEUE_POOL_SIZE items where possible,
+      * such that queuing an event does not normally require a heap allocation. If the pool is exhausted,
+      * the item is allocated from the heap.
+      *
+      * @param size The amount of memory required, in bytes.
+      *
+      * @return A pointer to the memory allocated, or NULL if no memory is available.
+      */
+    static void *operator new(size_t size);
+
+    /**
+      * Releases storage for a MicroBitEventQueueItem, returning it to the pool if it was taken from there.
+      *
+      * @param ptr The memory to release.
+      */
+    static void operator delete(void *ptr);
 };
 
 #endif
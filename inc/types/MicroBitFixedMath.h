@@ -0,0 +1,68 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_FIXED_MATH_H
+#define MICROBIT_FIXED_MATH_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+/**
+  * Fixed point trigonometry, for use in place of the floating point library on processors without an FPU.
+  *
+  * Angles are binary angles, where MICROBIT_FIXED_ANGLE_TURN units make one full turn, so an angle wraps
+  * naturally at 16 bits. Sines and cosines are scaled such that 1.0 == MICROBIT_FIXED_ONE.
+  */
+#define MICROBIT_FIXED_ANGLE_TURN           65536
+#define MICROBIT_FIXED_ONE                  65536
+
+/**
+  * Computes the angle of the vector (x, y) from the positive X axis, in the manner of atan2(y, x).
+  *
+  * @param y The Y component of the vector.
+  *
+  * @param x The X component of the vector.
+  *
+  * @return The angle, as a binary angle between -MICROBIT_FIXED_ANGLE_TURN/2 and MICROBIT_FIXED_ANGLE_TURN/2 - 1.
+  *         Zero is returned if both components are zero.
+  *
+  * @code
+  * microbit_fixed_atan2(1, 1);     // returns 8192, which is 45 degrees.
+  * @endcode
+  */
+int microbit_fixed_atan2(int y, int x);
+
+/**
+  * Computes the sine and cosine of the given angle.
+  *
+  * @param angle The angle, as a binary angle. Only the lowest 16 bits are significant.
+  *
+  * @param sine Set to the sine of the angle, where 1.0 == MICROBIT_FIXED_ONE.
+  *
+  * @param cosine Set to the cosine of the angle, where 1.0 == MICROBIT_FIXED_ONE.
+  */
+void microbit_fixed_sincos(int angle, int &sine, int &cosine);
+
+#endif
@@ -31,11 +31,56 @@ DEALINGS IN THE SOFTWARE.
 #include "ManagedString.h"
 #include "RefCounted.h"
 
+// The largest height of image that can be represented. The top bits of the height field hold the pixel format.
+#define MICROBIT_IMAGE_MAX_HEIGHT       16383
+
+/**
+  * The ways in which the pixels of an image may be stored.
+  *
+  * Each row of a packed image starts on a byte boundary. Within a byte, the leftmost pixel occupies the least significant bits.
+  */
+enum MicroBitImageFormat
+{
+    IMAGE_FORMAT_8BPP = 0,      // One byte per pixel, holding its brightness (0-255).
+    IMAGE_FORMAT_4BPP = 1,      // Two pixels per byte, each holding one of 16 brightness levels.
+    IMAGE_FORMAT_1BPP = 2       // Eight pixels per byte, each either on or off.
+};
+
+// The number of bytes in each row of an image of the given format and width. Usable in constant expressions.
+#define MICROBIT_IMAGE_STRIDE(format, width)    ((format) == IMAGE_FORMAT_1BPP ? ((width) + 7) >> 3 : (format) == IMAGE_FORMAT_4BPP ? ((width) + 1) >> 1 : (width))
+
+/**
+  * Defines an image literal, laid out as an ImageData and held in flash, for use with MicroBitImage(ImageData *).
+  * This costs no RAM and no construction time, until the image is modified.
+  *
+  * @param name The name of the array to define.
+  *
+  * @param format The MicroBitImageFormat of the bitmap given.
+  *
+  * @param width The width of the image, in pixels.
+  *
+  * @param height The height of the image, in pixels.
+  *
+  * @param ... The bytes of the bitmap, row by row. Compilation fails if there are too few or too many.
+  *
+  * @code
+  * MICROBIT_IMAGE_LITERAL(heart, IMAGE_FORMAT_8BPP, 5, 5, 0,1,0,1,0, 1,1,1,1,1, 1,1,1,1,1, 0,1,1,1,0, 0,0,1,0,0);
+  * MICROBIT_IMAGE_LITERAL(smallHeart, IMAGE_FORMAT_1BPP, 5, 5, 0x0A, 0x1F, 0x1F, 0x0E, 0x04);
+  *
+  * MicroBitImage i((ImageData*)(void*)heart);
+  * @endcode
+  */
+#define MICROBIT_IMAGE_LITERAL(name, format, width, height, ...)                                                       \
+    static const uint8_t name[] __attribute__ ((aligned (4))) =                                                         \
+        { 0xff, 0xff, (width) & 0xff, ((width) >> 8) & 0xff, (height) & 0xff, (((height) >> 8) & 0x3f) | ((format) << 6), __VA_ARGS__ }; \
+    typedef char name##_size_check[(sizeof(name) == 6 + MICROBIT_IMAGE_STRIDE(format, width) * (height)) ? 1 : -1] __attribute__ ((unused))
+
 struct ImageData : RefCounted
 {
-    uint16_t width;     // Width in pixels
-    uint16_t height;    // Height in pixels
-    uint8_t data[0];    // 2D array representing the bitmap image
+    uint16_t width;         // Width in pixels
+    uint16_t height : 14;   // Height in pixels
+    uint16_t format : 2;    // The MicroBitImageFormat of the bitmap. Zero in literals, which are therefore 8 bits per pixel.
+    uint8_t data[0];        // 2D array representing the bitmap image
 };
 
 /**
@@ -57,14 +102,45 @@ class MicroBitImage
       * @param y the height of the image
       *
       * @param bitmap an array of integers that make up an image.
+      *
+      * @param format the MicroBitImageFormat in which to store the image.
       */
-    void init(const int16_t x, const int16_t y, const uint8_t *bitmap);
+    void init(const int16_t x, const int16_t y, const uint8_t *bitmap, MicroBitImageFormat format);
 
     /**
       * Internal constructor which defaults to the Empty Image instance variable
       */
     void init_empty();
 
+    /**
+      * Ensures this image may be modified, by taking a private copy in RAM of any bitmap held in flash.
+      *
+      * Other images that reference the same flash bitmap are unaffected.
+      */
+    void makeWritable();
+
+    /**
+      * Reads a pixel, without bounds checking.
+      *
+      * @param x The x co-ordinate of the pixel to read.
+      *
+      * @param y The y co-ordinate of the pixel to read.
+      *
+      * @return The brightness of the pixel (0-255).
+      */
+    uint8_t readPixel(int x, int y) const;
+
+    /**
+      * Writes a pixel, without bounds checking.
+      *
+      * @param x The x co-ordinate of the pixel to write.
+      *
+      * @param y The y co-ordinate of the pixel to write.
+      *
+      * @param value The brightness of the pixel (0-255). This is rounded up to the nearest level the image can represent.
+      */
+    void writePixel(int x, int y, uint8_t value);
+
     public:
     static MicroBitImage EmptyImage;    // Shared representation of a null image.
 
@@ -77,6 +153,8 @@ class MicroBitImage
 
     /**
       * Return a 2D array representing the bitmap image.
+      *
+      * The layout of the array depends upon the format of the image. See getFormat() and getStride().
       */
     uint8_t *getBitmap()
     {
@@ -89,6 +167,8 @@ class MicroBitImage
       *
       * @param ptr The literal - first two bytes should be 0xff, then width, 0, height, 0, and the bitmap. Width and height are 16 bit. The literal has to be 4-byte aligned.
       *
+      * A literal held in flash uses no RAM until the image is first modified, at which point this image takes its own copy.
+      *
       * @code
       * static const uint8_t heart[] __attribute__ ((aligned (4))) = { 0xff, 0xff, 10, 0, 5, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, }; // a cute heart
       * MicroBitImage i((ImageData*)(void*)heart);
@@ -140,15 +220,18 @@ class MicroBitImage
       *
       * @param y the height of the image.
       *
+      * @param format the MicroBitImageFormat in which to store the image. Defaults to IMAGE_FORMAT_8BPP.
+      *
       * Bitmap buffer is linear, with 8 bits per pixel, row by row,
       * top to bottom with no word alignment. Stride is therefore the image width in pixels.
+      * Packed formats hold several pixels per byte, with each row starting on a byte boundary.
       * in where w and h are width and height respectively, the layout is therefore:
       *
       * |[0,0]...[w,o][1,0]...[w,1]  ...  [[w,h]
       *
       * A copy of the image is made in RAM, as images are mutable.
       */
-    MicroBitImage(const int16_t x, const int16_t y);
+    MicroBitImage(const int16_t x, const int16_t y, MicroBitImageFormat format = IMAGE_FORMAT_8BPP);
 
     /**
       * Constructor.
@@ -158,14 +241,17 @@ class MicroBitImage
       *
       * @param y the height of the image.
       *
-      * @param bitmap a 2D array representing the image.
+      * @param bitmap a 2D array representing the image, with one byte per pixel.
+      *
+      * @param format the MicroBitImageFormat in which to store the image. Defaults to IMAGE_FORMAT_8BPP.
       *
       * @code
       * const uint8_t heart[] = { 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, }; // a cute heart
       * MicroBitImage i(10,5,heart);
+      * MicroBitImage small(10,5,heart,IMAGE_FORMAT_1BPP); // the same heart, in 10 bytes
       * @endcode
       */
-    MicroBitImage(const int16_t x, const int16_t y, const uint8_t *bitmap);
+    MicroBitImage(const int16_t x, const int16_t y, const uint8_t *bitmap, MicroBitImageFormat format = IMAGE_FORMAT_8BPP);
 
     /**
       * Destructor.
@@ -419,7 +505,7 @@ class MicroBitImage
     }
 
     /**
-      * Gets number of bytes in the bitmap, ie., width * height.
+      * Gets number of pixels in the image, ie., width * height. For 8 bit per pixel images, this is also the number of bytes in the bitmap.
       *
       * @return The size of the bitmap.
       *
@@ -434,6 +520,51 @@ class MicroBitImage
         return ptr->width * ptr->height;
     }
 
+    /**
+      * Gets the format in which the pixels of this image are stored.
+      *
+      * @return The MicroBitImageFormat of this image.
+      *
+      * @code
+      * MicroBitImage i(10,5,IMAGE_FORMAT_1BPP);
+      * i.getFormat(); // equals IMAGE_FORMAT_1BPP...
+      * @endcode
+      */
+    MicroBitImageFormat getFormat() const
+    {
+        return (MicroBitImageFormat)ptr->format;
+    }
+
+    /**
+      * Gets the number of bytes used to store each row of this image.
+      *
+      * @return The stride of the bitmap, in bytes.
+      *
+      * @code
+      * MicroBitImage i(10,5,IMAGE_FORMAT_4BPP);
+      * i.getStride(); // equals 5...
+      * @endcode
+      */
+    int getStride() const
+    {
+        return MICROBIT_IMAGE_STRIDE(ptr->format, ptr->width);
+    }
+
+    /**
+      * Gets the number of bytes in the bitmap, ie., stride * height.
+      *
+      * @return The number of bytes used to store the pixels of this image.
+      *
+      * @code
+      * MicroBitImage i(10,5,IMAGE_FORMAT_1BPP);
+      * i.getBitmapSize(); // equals 10...
+      * @endcode
+      */
+    int getBitmapSize() const
+    {
+        return getStride() * ptr->height;
+    }
+
     /**
       * Converts the bitmap to a csv ManagedString.
       *
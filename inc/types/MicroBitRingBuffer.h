@@ -0,0 +1,500 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RING_BUFFER_H
+#define MICROBIT_RING_BUFFER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ErrorNo.h"
+
+// The largest number of items a MicroBitRingBuffer can hold.
+#define MICROBIT_RING_BUFFER_MAX_CAPACITY       32768
+
+/**
+  * Class definition for a MicroBitRingBuffer.
+  *
+  * A fixed capacity, first in first out queue of items, intended to pass data between an interrupt
+  * handler and a fiber. Exactly one context may add items (the producer), and exactly one context may
+  * remove them (the consumer). Under those conditions no locking is required: the producer only ever
+  * writes the head index, and the consumer only ever writes the tail index.
+  *
+  * The capacity is always a power of two, and storage is allocated only when the buffer is sized, so
+  * adding and removing items takes constant time and never allocates memory.
+  */
+template <class T>
+class MicroBitRingBuffer
+{
+    T                   *buffer;    // Storage for the items in the ring, or NULL if none has been allocated.
+    uint16_t            mask;       // The capacity of the ring, less one.
+    volatile uint16_t   head;       // The number of items ever added. These run freely, and are masked to index the buffer.
+    volatile uint16_t   tail;       // The number of items ever removed.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create an empty MicroBitRingBuffer, with no storage. Call resize() before use.
+      */
+    MicroBitRingBuffer();
+
+    /**
+      * Constructor.
+      *
+      * Create an empty MicroBitRingBuffer, able to hold at least the given number of items.
+      *
+      * @param capacity The number of items required. This is rounded up to a power of two.
+      */
+    MicroBitRingBuffer(int capacity);
+
+    /**
+      * Destructor. Releases the storage used by this buffer.
+      */
+    ~MicroBitRingBuffer();
+
+    /**
+      * Discards the contents of this buffer, and reallocates its storage to hold at least the given number of items.
+      *
+      * @param capacity The number of items required. This is rounded up to a power of two. If 0, the storage is
+      *        released, and the buffer holds nothing until resized again.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if capacity is not between 0 and
+      *         MICROBIT_RING_BUFFER_MAX_CAPACITY, or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+      *
+      * @note Neither the producer nor the consumer may be using the buffer whilst it is resized.
+      */
+    int resize(int capacity);
+
+    /**
+      * Determines the number of items this buffer can hold.
+      *
+      * @return The capacity of the buffer, or 0 if it has no storage.
+      */
+    int capacity();
+
+    /**
+      * Determines the number of items waiting in this buffer.
+      *
+      * @return The number of items that can currently be removed.
+      */
+    int size();
+
+    /**
+      * Determines if this buffer holds no items.
+      *
+      * @return true if the buffer is empty, false otherwise.
+      */
+    bool isEmpty();
+
+    /**
+      * Determines if this buffer has no space for further items.
+      *
+      * @return true if the buffer is full, false otherwise.
+      */
+    bool isFull();
+
+    /**
+      * Adds an item to the buffer. Called only by the producer.
+      *
+      * @param item The item to add.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the buffer is full.
+      */
+    int push(const T &item);
+
+    /**
+      * Adds a number of items to the buffer, for as long as there is space. Called only by the producer.
+      *
+      * @param items The items to add.
+      *
+      * @param len The number of items to add.
+      *
+      * @return The number of items added.
+      */
+    int push(const T *items, int len);
+
+    /**
+      * Removes the oldest item from the buffer. Called only by the consumer.
+      *
+      * @param item Set to the item removed.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the buffer is empty.
+      */
+    int pop(T &item);
+
+    /**
+      * Removes a number of items from the buffer, oldest first. Called only by the consumer.
+      *
+      * @param items The location to store the items removed, or NULL to simply discard them.
+      *
+      * @param len The maximum number of items to remove.
+      *
+      * @return The number of items removed.
+      */
+    int pop(T *items, int len);
+
+    /**
+      * Reads an item from the buffer, without removing it. Called only by the consumer.
+      *
+      * @param item Set to the item read.
+      *
+      * @param offset The position of the item to read, where 0 is the oldest item. Defaults to 0.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if fewer than offset + 1 items are waiting.
+      */
+    int peek(T &item, int offset = 0);
+
+    /**
+      * Provides direct access to the items in the buffer, without removing them. Called only by the consumer.
+      * The items are not copied, so only those held in one contiguous run of storage are available: the run
+      * may end early, where the buffer wraps around.
+      *
+      * @param items Set to the location of the item at the given offset.
+      *
+      * @param offset The position of the first item required, where 0 is the oldest item. Defaults to 0.
+      *
+      * @return The number of items available at items, or 0 if fewer than offset + 1 items are waiting.
+      *
+      * @note The items remain valid until they are removed with pop().
+      */
+    int peekContiguous(T *&items, int offset = 0);
+
+    /**
+      * Discards all the items in the buffer. Called only by the consumer, or by the producer once the consumer
+      * has been stopped (e.g. its interrupt disabled).
+      */
+    void clear();
+};
+
+/**
+  * Constructor.
+  *
+  * Create an empty MicroBitRingBuffer, with no storage. Call resize() before use.
+  */
+template <class T>
+MicroBitRingBuffer<T>::MicroBitRingBuffer()
+{
+    this->buffer = NULL;
+    this->mask = 0;
+    this->head = 0;
+    this->tail = 0;
+}
+
+/**
+  * Constructor.
+  *
+  * Create an empty MicroBitRingBuffer, able to hold at least the given number of items.
+  *
+  * @param capacity The number of items required. This is rounded up to a power of two.
+  */
+template <class T>
+MicroBitRingBuffer<T>::MicroBitRingBuffer(int capacity)
+{
+    this->buffer = NULL;
+    this->mask = 0;
+    this->head = 0;
+    this->tail = 0;
+
+    resize(capacity);
+}
+
+/**
+  * Destructor. Releases the storage used by this buffer.
+  */
+template <class T>
+MicroBitRingBuffer<T>::~MicroBitRingBuffer()
+{
+    if (buffer != NULL)
+        delete[] buffer;
+}
+
+/**
+  * Discards the contents of this buffer, and reallocates its storage to hold at least the given number of items.
+  *
+  * @param capacity The number of items required. This is rounded up to a power of two. If 0, the storage is
+  *        released, and the buffer holds nothing until resized again.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if capacity is not between 0 and
+  *         MICROBIT_RING_BUFFER_MAX_CAPACITY, or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+  *
+  * @note Neither the producer nor the consumer may be using the buffer whilst it is resized.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::resize(int capacity)
+{
+    if (capacity < 0 || capacity > MICROBIT_RING_BUFFER_MAX_CAPACITY)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    if (buffer != NULL)
+        delete[] buffer;
+
+    head = 0;
+    tail = 0;
+    mask = 0;
+    buffer = NULL;
+
+    if (capacity == 0)
+        return MICROBIT_OK;
+
+    buffer = new T[size];
+
+    if (buffer == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    mask = size - 1;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the number of items this buffer can hold.
+  *
+  * @return The capacity of the buffer, or 0 if it has no storage.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::capacity()
+{
+    return buffer == NULL ? 0 : mask + 1;
+}
+
+/**
+  * Determines the number of items waiting in this buffer.
+  *
+  * @return The number of items that can currently be removed.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::size()
+{
+    return (uint16_t)(head - tail);
+}
+
+/**
+  * Determines if this buffer holds no items.
+  *
+  * @return true if the buffer is empty, false otherwise.
+  */
+template <class T>
+bool MicroBitRingBuffer<T>::isEmpty()
+{
+    return head == tail;
+}
+
+/**
+  * Determines if this buffer has no space for further items.
+  *
+  * @return true if the buffer is full, false otherwise.
+  */
+template <class T>
+bool MicroBitRingBuffer<T>::isFull()
+{
+    return size() >= capacity();
+}
+
+/**
+  * Adds an item to the buffer. Called only by the producer.
+  *
+  * @param item The item to add.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the buffer is full.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::push(const T &item)
+{
+    uint16_t h = head;
+
+    if (buffer == NULL || (uint16_t)(h - tail) > mask)
+        return MICROBIT_NO_RESOURCES;
+
+    buffer[h & mask] = item;
+
+    // Ensure the item is stored before the consumer can see it.
+    __DMB();
+
+    head = h + 1;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Adds a number of items to the buffer, for as long as there is space. Called only by the producer.
+  *
+  * @param items The items to add.
+  *
+  * @param len The number of items to add.
+  *
+  * @return The number of items added.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::push(const T *items, int len)
+{
+    uint16_t h = head;
+    int space = buffer == NULL ? 0 : mask + 1 - (uint16_t)(h - tail);
+
+    if (len > space)
+        len = space;
+
+    for (int i = 0; i < len; i++)
+        buffer[(uint16_t)(h + i) & mask] = items[i];
+
+    // Ensure the items are stored before the consumer can see them.
+    __DMB();
+
+    head = h + len;
+
+    return len;
+}
+
+/**
+  * Removes the oldest item from the buffer. Called only by the consumer.
+  *
+  * @param item Set to the item removed.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the buffer is empty.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::pop(T &item)
+{
+    uint16_t t = tail;
+
+    if (t == head)
+        return MICROBIT_NO_DATA;
+
+    // Ensure we read the item only once we have seen that the producer has stored it.
+    __DMB();
+
+    item = buffer[t & mask];
+
+    // Ensure the item has been read before the producer can reuse its slot.
+    __DMB();
+
+    tail = t + 1;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Removes a number of items from the buffer, oldest first. Called only by the consumer.
+  *
+  * @param items The location to store the items removed, or NULL to simply discard them.
+  *
+  * @param len The maximum number of items to remove.
+  *
+  * @return The number of items removed.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::pop(T *items, int len)
+{
+    uint16_t t = tail;
+    int available = (uint16_t)(head - t);
+
+    if (len > available)
+        len = available;
+
+    __DMB();
+
+    if (items != NULL)
+        for (int i = 0; i < len; i++)
+            items[i] = buffer[(uint16_t)(t + i) & mask];
+
+    __DMB();
+
+    tail = t + len;
+
+    return len;
+}
+
+/**
+  * Reads an item from the buffer, without removing it. Called only by the consumer.
+  *
+  * @param item Set to the item read.
+  *
+  * @param offset The position of the item to read, where 0 is the oldest item. Defaults to 0.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if fewer than offset + 1 items are waiting.
+  */
+template <class T>
+int MicroBitRingBuffer<T>::peek(T &item, int offset)
+{
+    uint16_t t = tail;
+
+    if (offset < 0 || offset >= (uint16_t)(head - t))
+        return MICROBIT_NO_DATA;
+
+    __DMB();
+
+    item = buffer[(uint16_t)(t + offset) & mask];
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Provides direct access to the items in the buffer, without removing them. Called only by the consumer.
+  * The items are not copied, so only those held in one contiguous run of storage are available: the run
+  * may end early, where the buffer wraps around.
+  *
+  * @param items Set to the location of the item at the given offset.
+  *
+  * @param offset The position of the first item required, where 0 is the oldest item. Defaults to 0.
+  *
+  * @return The number of items available at items, or 0 if fewer than offset + 1 items are waiting.
+  *
+  * @note The items remain valid until they are removed with pop().
+  */
+template <class T>
+int MicroBitRingBuffer<T>::peekContiguous(T *&items, int offset)
+{
+    uint16_t t = tail;
+    int available = (uint16_t)(head - t);
+
+    if (offset < 0 || offset >= available)
+        return 0;
+
+    __DMB();
+
+    uint16_t start = (uint16_t)(t + offset) & mask;
+    int run = mask + 1 - start;
+
+    items = &buffer[start];
+
+    return (available - offset < run) ? available - offset : run;
+}
+
+/**
+  * Discards all the items in the buffer. Called only by the consumer, or by the producer once the consumer
+  * has been stopped (e.g. its interrupt disabled).
+  */
+template <class T>
+void MicroBitRingBuffer<T>::clear()
+{
+    tail = head;
+}
+
+#endif
@@ -33,7 +33,7 @@ DEALINGS IN THE SOFTWARE.
 struct PacketData : RefCounted
 {
     int             rssi;               // The radio signal strength this packet was received.
-    uint8_t         length;             // The length of the payload in bytes
+    uint8_t         length;             // The length of the payload in bytes, including any headroom
     uint8_t         payload[0];         // User / higher layer protocol data
 };
 
@@ -41,11 +41,17 @@ struct PacketData : RefCounted
   * Class definition for a PacketBuffer.
   * A PacketBuffer holds a series of bytes that can be sent or received from the MicroBitRadio channel.
   *
+  * A PacketBuffer may refer to only part of its payload. Slices share the payload of the PacketBuffer they
+  * are taken from, so protocol layers can each see their own part of a packet without copying it. Space may
+  * also be reserved before the data, so that the headers of lower layers can be prepended in place.
+  *
   * @note This is a mutable, managed type.
   */
 class PacketBuffer
 {
     PacketData      *ptr;     // Pointer to payload data
+    uint8_t         offset;   // The index within the payload of the first byte of this buffer
+    uint8_t         size;     // The number of bytes in this buffer
 
     public:
 
@@ -78,6 +84,20 @@ class PacketBuffer
       */
     PacketBuffer(int length);
 
+    /**
+      * Constructor.
+      * Creates a new PacketBuffer of the given size, with space reserved before it for headers to be prepended.
+      *
+      * @param length The length of the buffer to create.
+      *
+      * @param headroom The number of bytes to reserve before the buffer. The length and headroom together may not exceed 255 bytes.
+      *
+      * @code
+      * PacketBuffer p(16, 4);      // Creates a PacketBuffer 16 bytes long, that can grow to 20 bytes by prepend().
+      * @endcode
+      */
+    PacketBuffer(int length, int headroom);
+
     /**
       * Constructor.
       * Creates an empty Packet Buffer of the given size,
@@ -117,8 +137,10 @@ class PacketBuffer
       * @param length The length of the buffer to create.
       *
       * @param rssi The radio signal strength at the time this packet was recieved.
+      *
+      * @param headroom The number of bytes to reserve before the buffer. Defaults to 0.
       */
-    void init(uint8_t *data, int length, int rssi);
+    void init(uint8_t *data, int length, int rssi, int headroom = 0);
 
     /**
       * Destructor.
@@ -264,6 +286,47 @@ class PacketBuffer
       */
     void setRSSI(uint8_t rssi);
 
+    /**
+      * Creates a PacketBuffer referring to part of this one. The bytes are shared rather than copied,
+      * so changes made through either are seen by both.
+      *
+      * @param offset The index of the first byte of the slice.
+      *
+      * @param length The number of bytes in the slice. The slice is clipped to the end of this buffer. Defaults to the rest of the buffer.
+      *
+      * @return The slice.
+      *
+      * @code
+      * PacketBuffer packet = radio.datagram.recv();
+      * PacketBuffer body = packet.slice(2);         // Everything after a two byte header.
+      * @endcode
+      */
+    PacketBuffer slice(int offset, int length = 255);
+
+    /**
+      * Determines the number of bytes that may be prepended to this buffer without copying it.
+      *
+      * @return The number of bytes available before the start of this buffer.
+      */
+    int getHeadroom();
+
+    /**
+      * Extends this buffer by the given number of bytes at its start, to hold a header. The headroom
+      * before the buffer is used if there is enough. Otherwise, the buffer is copied into a new payload,
+      * which is no longer shared with any other PacketBuffer.
+      *
+      * @param length The number of bytes to add.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if length is negative, or the buffer would exceed 255 bytes.
+      *
+      * @code
+      * PacketBuffer p(16, 2);
+      * p.prepend(2);           // p is now 18 bytes long, without any copy.
+      * p[0] = 0x42;
+      * @endcode
+      */
+    int prepend(int length);
+
     static PacketBuffer EmptyPacket;
 };
 
@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 #include "ble/UUID.h"
 
 #include "MicroBitAccelerometerService.h"
+#include "MicroBitSystemTimer.h"
 
 /**
   * Constructor.
@@ -55,6 +56,11 @@ MicroBitAccelerometerService::MicroBitAccelerometerService(BLEDevice &_ble, Micr
     accelerometerDataCharacteristicBuffer[2] = 0;
     accelerometerPeriodCharacteristicBuffer = accelerometer.getPeriod();
 
+    streamSamples = 0;
+    streamDecimation = 1;
+    decimationCount = 0;
+    sampleCount = 0;
+
     // Set default security requirements
     accelerometerDataCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     accelerometerPeriodCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
@@ -67,7 +73,7 @@ MicroBitAccelerometerService::MicroBitAccelerometerService(BLEDevice &_ble, Micr
     accelerometerDataCharacteristicHandle = accelerometerDataCharacteristic.getValueHandle();
     accelerometerPeriodCharacteristicHandle = accelerometerPeriodCharacteristic.getValueHandle();
 
-    ble.gattServer().write(accelerometerDataCharacteristicHandle,(uint8_t *)accelerometerDataCharacteristicBuffer, sizeof(accelerometerDataCharacteristicBuffer));
+    ble.gattServer().write(accelerometerDataCharacteristicHandle,(uint8_t *)accelerometerDataCharacteristicBuffer, 3 * sizeof(uint16_t));
     ble.gattServer().write(accelerometerPeriodCharacteristicHandle, (const uint8_t *)&accelerometerPeriodCharacteristicBuffer, sizeof(accelerometerPeriodCharacteristicBuffer));
 
     ble.onDataWritten(this, &MicroBitAccelerometerService::onDataWritten);
@@ -98,14 +104,77 @@ void MicroBitAccelerometerService::onDataWritten(const GattWriteCallbackParams *
   */
 void MicroBitAccelerometerService::accelerometerUpdate(MicroBitEvent)
 {
-    if (ble.getGapState().connected)
+    if (!ble.getGapState().connected)
+    {
+        sampleCount = 0;
+        return;
+    }
+
+    // Only use one in every streamDecimation samples.
+    if (++decimationCount < streamDecimation)
+        return;
+
+    decimationCount = 0;
+
+    MMA8653Sample s = accelerometer.getSample();
+
+    if (streamSamples == 0)
     {
-        accelerometerDataCharacteristicBuffer[0] = accelerometer.getX();
-        accelerometerDataCharacteristicBuffer[1] = accelerometer.getY();
-        accelerometerDataCharacteristicBuffer[2] = accelerometer.getZ();
+        accelerometerDataCharacteristicBuffer[0] = s.x;
+        accelerometerDataCharacteristicBuffer[1] = s.y;
+        accelerometerDataCharacteristicBuffer[2] = s.z;
 
-        ble.gattServer().notify(accelerometerDataCharacteristicHandle,(uint8_t *)accelerometerDataCharacteristicBuffer, sizeof(accelerometerDataCharacteristicBuffer));
+        ble.gattServer().notify(accelerometerDataCharacteristicHandle,(uint8_t *)accelerometerDataCharacteristicBuffer, 3 * sizeof(uint16_t));
+        return;
     }
+
+    // Timestamp each batch by its first sample.
+    if (sampleCount == 0)
+        accelerometerDataCharacteristicBuffer[0] = (uint16_t) system_timer_current_time();
+
+    uint16_t *sample = &accelerometerDataCharacteristicBuffer[1 + 3 * sampleCount];
+
+    sample[0] = s.x;
+    sample[1] = s.y;
+    sample[2] = s.z;
+
+    if (++sampleCount < streamSamples)
+        return;
+
+    // If the stack has no transmit buffers free, this batch is lost. We start afresh either way.
+    ble.gattServer().notify(accelerometerDataCharacteristicHandle, (uint8_t *)accelerometerDataCharacteristicBuffer, (1 + 3 * sampleCount) * sizeof(uint16_t));
+    sampleCount = 0;
+}
+
+/**
+  * Configures how accelerometer samples are delivered via Bluetooth.
+  *
+  * By default, every sample is notified as it is taken, as 3 signed 16 bit values (x, y, z).
+  * In streaming mode, several samples are instead packed into each notification, preceded by a 16 bit
+  * timestamp: the low 16 bits of system time (in milliseconds) at which the first sample was taken.
+  * The following samples are each period * decimation milliseconds apart.
+  *
+  * @param samples The number of samples per notification, from 1 to MICROBIT_ACCELEROMETER_SERVICE_MAX_SAMPLES,
+  *        or 0 to return to the default format.
+  *
+  * @param decimation Only one of every this many samples is sent. Defaults to 1.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if either value is out of range.
+  *
+  * @note If the Bluetooth stack has no room for a notification, it is dropped rather than queued,
+  *       so a slow link reduces the sample rate rather than delaying samples.
+  */
+int MicroBitAccelerometerService::setStreaming(int samples, int decimation)
+{
+    if (samples < 0 || samples > MICROBIT_ACCELEROMETER_SERVICE_MAX_SAMPLES || decimation < 1 || decimation > 255)
+        return MICROBIT_INVALID_PARAMETER;
+
+    streamSamples = samples;
+    streamDecimation = decimation;
+    decimationCount = 0;
+    sampleCount = 0;
+
+    return MICROBIT_OK;
 }
 
 const uint8_t  MicroBitAccelerometerServiceUUID[] = {
@@ -29,6 +29,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitStorage.h"
 #include "MicroBitFiber.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitDevice.h"
 
 /* The underlying Nordic libraries that support BLE do not compile cleanly with the stringent GCC settings we employ.
  * If we're compiling under GCC, then we suppress any warnings generated from this code (but not the rest of the DAL)
@@ -42,6 +43,7 @@ DEALINGS IN THE SOFTWARE.
 #endif
 
 #include "ble.h"
+#include "nrf_soc.h"
 
 extern "C" {
 #include "device_manager.h"
@@ -86,14 +88,66 @@ const int8_t MICROBIT_BLE_POWER_LEVEL[] = {-30, -20, -16, -12, -8, -4, 0, 4};
  */
 MicroBitBLEManager *MicroBitBLEManager::manager = NULL; // Singleton reference to the BLE manager. many mbed BLE API callbacks still do not support member funcions yet. :-(
 
+// Connection parameters for each MicroBitBLEConnectionProfile: minimum and maximum interval (1.25 ms units),
+// slave latency (connection events) and supervision timeout (10 ms units).
+static const Gap::ConnectionParams_t connectionProfiles[] = {
+    {8, 16, 0, 400},
+    {24, 40, 0, 400},
+    {80, 160, 4, 600}
+};
+
+MICROBIT_STRING_LITERAL(bleSysAttrsKey, "bleSysAttrs");
+MICROBIT_STRING_LITERAL(pairingNamePrefix, "BBC micro:bit [");
+MICROBIT_STRING_LITERAL(pairingMessage, "PAIRING MODE!");
+
 static uint8_t deviceID = 255;          // Unique ID for the peer that has connected to us.
 static Gap::Handle_t pairingHandle = 0; // The connection handle used during a pairing process. Used to ensure that connections are dropped elegantly.
 
+#if CONFIG_ENABLED(MICROBIT_BLE_DFU_SERVICE)
+static void createDFUService(BLEDevice &ble, EventModel &, ManagedString &)
+{
+    new MicroBitDFUService(ble);
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_DEVICE_INFORMATION_SERVICE)
+static void createDeviceInformationService(BLEDevice &ble, EventModel &, ManagedString &serialNumber)
+{
+    DeviceInformationService ble_device_information_service(ble, MICROBIT_BLE_MANUFACTURER, MICROBIT_BLE_MODEL, serialNumber.toCharArray(), MICROBIT_BLE_HARDWARE_VERSION, MICROBIT_BLE_FIRMWARE_VERSION, MICROBIT_BLE_SOFTWARE_VERSION);
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EVENT_SERVICE)
+static void createEventService(BLEDevice &ble, EventModel &messageBus, ManagedString &)
+{
+    new MicroBitEventService(ble, messageBus);
+}
+#endif
+
+// The core services, in the order they are added to the GATT table. Terminated by an entry with no factory.
+static const struct
+{
+    uint8_t service;
+    void (*create)(BLEDevice &ble, EventModel &messageBus, ManagedString &serialNumber);
+} bleServices[] =
+{
+#if CONFIG_ENABLED(MICROBIT_BLE_DFU_SERVICE)
+    { MICROBIT_BLE_SERVICE_DFU, createDFUService },
+#endif
+#if CONFIG_ENABLED(MICROBIT_BLE_DEVICE_INFORMATION_SERVICE)
+    { MICROBIT_BLE_SERVICE_DEVICE_INFORMATION, createDeviceInformationService },
+#endif
+#if CONFIG_ENABLED(MICROBIT_BLE_EVENT_SERVICE)
+    { MICROBIT_BLE_SERVICE_EVENT, createEventService },
+#endif
+    { 0, NULL }
+};
+
 static void storeSystemAttributes(Gap::Handle_t handle)
 {
     if (MicroBitBLEManager::manager->storage != NULL && deviceID < MICROBIT_BLE_MAXIMUM_BONDS)
     {
-        ManagedString key("bleSysAttrs");
+        ManagedString key((StringData*)(void*)&bleSysAttrsKey);
 
         KeyValuePair *bleSysAttrs = MicroBitBLEManager::manager->storage->get(key);
 
@@ -137,9 +191,12 @@ static void bleDisconnectionCallback(const Gap::DisconnectionCallbackParams_t *r
 /**
   * Callback when a BLE connection is established.
   */
-static void bleConnectionCallback(const Gap::ConnectionCallbackParams_t *)
+static void bleConnectionCallback(const Gap::ConnectionCallbackParams_t *params)
 {
     MicroBitEvent(MICROBIT_ID_BLE, MICROBIT_BLE_EVT_CONNECTED);
+
+    if (MicroBitBLEManager::manager)
+        MicroBitBLEManager::manager->connectionParamsGranted(params->handle, params->connectionParams);
 }
 
 /**
@@ -159,7 +216,7 @@ static void bleSysAttrMissingCallback(const GattSysAttrMissingCallbackParams *pa
 
     if (MicroBitBLEManager::manager->storage != NULL && deviceID < MICROBIT_BLE_MAXIMUM_BONDS)
     {
-        ManagedString key("bleSysAttrs");
+        ManagedString key((StringData*)(void*)&bleSysAttrsKey);
 
         KeyValuePair *bleSysAttrs = MicroBitBLEManager::manager->storage->get(key);
 
@@ -229,7 +286,16 @@ MicroBitBLEManager::MicroBitBLEManager(MicroBitStorage &_storage) : storage(&_st
     manager = this;
     this->ble = NULL;
     this->pairingStatus = 0;
+    this->connectionProfile = MICROBIT_BLE_PROFILE_THROUGHPUT;
+    this->connectionHandle = 0;
     this->status = MICROBIT_COMPONENT_RUNNING;
+    this->services = MICROBIT_BLE_DEFAULT_SERVICES;
+    this->servicesRunning = 0;
+    this->messageBus = NULL;
+#if MICROBIT_BLE_ADVERTISING_SLOTS > 0
+    this->advertisingFrameCount = 0;
+    this->advertisingFrameIndex = 0;
+#endif
 }
 
 /**
@@ -245,6 +311,15 @@ MicroBitBLEManager::MicroBitBLEManager() : storage(NULL)
     manager = this;
     this->ble = NULL;
     this->pairingStatus = 0;
+    this->connectionProfile = MICROBIT_BLE_PROFILE_THROUGHPUT;
+    this->connectionHandle = 0;
+    this->services = MICROBIT_BLE_DEFAULT_SERVICES;
+    this->servicesRunning = 0;
+    this->messageBus = NULL;
+#if MICROBIT_BLE_ADVERTISING_SLOTS > 0
+    this->advertisingFrameCount = 0;
+    this->advertisingFrameIndex = 0;
+#endif
 }
 
 /**
@@ -305,6 +380,12 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
     BLEName = BLEName + namePrefix + deviceName + namePostfix;
 #endif
 
+#if CONFIG_ENABLED(MICROBIT_HEAP_ALLOCATOR)
+    // The SoftDevice's memory is in use as heap, so starting the BLE stack would corrupt the heap.
+    if (microbit_sd_heap_created())
+        microbit_panic(MICROBIT_HEAP_ERROR);
+#endif
+
 // Start the BLE stack.
 #if CONFIG_ENABLED(MICROBIT_HEAP_REUSE_SD)
     btle_set_gatt_table_size(MICROBIT_SD_GATT_TABLE_SIZE);
@@ -381,29 +462,12 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
     setTransmitPower(MICROBIT_BLE_DEFAULT_TX_POWER);
 
 // Bring up core BLE services.
-#if CONFIG_ENABLED(MICROBIT_BLE_DFU_SERVICE)
-    new MicroBitDFUService(*ble);
-#endif
+    this->messageBus = &messageBus;
+    this->serialNumber = serialNumber;
+    startServices();
 
-#if CONFIG_ENABLED(MICROBIT_BLE_DEVICE_INFORMATION_SERVICE)
-    DeviceInformationService ble_device_information_service(*ble, MICROBIT_BLE_MANUFACTURER, MICROBIT_BLE_MODEL, serialNumber.toCharArray(), MICROBIT_BLE_HARDWARE_VERSION, MICROBIT_BLE_FIRMWARE_VERSION, MICROBIT_BLE_SOFTWARE_VERSION);
-#else
-    (void)serialNumber;
-#endif
-
-#if CONFIG_ENABLED(MICROBIT_BLE_EVENT_SERVICE)
-    new MicroBitEventService(*ble, messageBus);
-#else
-    (void)messageBus;
-#endif
-
-    // Configure for high speed mode where possible.
-    Gap::ConnectionParams_t fast;
-    ble->getPreferredConnectionParams(&fast);
-    fast.minConnectionInterval = 8;  // 10 ms
-    fast.maxConnectionInterval = 16; // 20 ms
-    fast.slaveLatency = 0;
-    ble->setPreferredConnectionParams(&fast);
+    // Configure for high speed mode where possible, unless another profile has already been requested.
+    setConnectionProfile(connectionProfile);
 
 // Setup advertising.
 #if CONFIG_ENABLED(MICROBIT_BLE_WHITELIST)
@@ -414,7 +478,7 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
 
     ble->accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LOCAL_NAME, (uint8_t *)BLEName.toCharArray(), BLEName.length());
     ble->setAdvertisingType(GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED);
-    ble->setAdvertisingInterval(200);
+    ble->setAdvertisingInterval(MICROBIT_BLE_ADVERTISING_INTERVAL);
 
 #if (MICROBIT_BLE_ADVERTISING_TIMEOUT > 0)
     ble->gap().setAdvertisingTimeout(MICROBIT_BLE_ADVERTISING_TIMEOUT);
@@ -429,6 +493,79 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
         ble->startAdvertising();
 }
 
+/**
+  * Selects the core services brought up by init(). Services that are not selected cost neither
+  * RAM nor space in the GATT table, and are not initialised at startup.
+  *
+  * @param services A bitmask of MICROBIT_BLE_SERVICE_DFU, MICROBIT_BLE_SERVICE_DEVICE_INFORMATION and
+  *        MICROBIT_BLE_SERVICE_EVENT. Services not compiled in are ignored. Defaults to MICROBIT_BLE_DEFAULT_SERVICES.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if init() has already been called.
+  *
+  * @code
+  * // Keep over the air programming, but nothing else.
+  * bleManager.setServices(MICROBIT_BLE_SERVICE_DFU);
+  * bleManager.init(uBit.getName(), uBit.getSerial(), uBit.messageBus, true);
+  * @endcode
+  */
+int MicroBitBLEManager::setServices(uint8_t services)
+{
+    // Services cannot be removed from the GATT table once added.
+    if (ble)
+        return MICROBIT_NOT_SUPPORTED;
+
+    this->services = services;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Brings up the given core services, if they are not already running. Before init(), this adds
+  * to the services that init() brings up. Afterwards, the services are instantiated immediately.
+  *
+  * @param services A bitmask of MICROBIT_BLE_SERVICE_DFU, MICROBIT_BLE_SERVICE_DEVICE_INFORMATION and
+  *        MICROBIT_BLE_SERVICE_EVENT. Services not compiled in are ignored.
+  *
+  * @return MICROBIT_OK on success.
+  *
+  * @note Central devices often cache the services of a device they have connected to, so services
+  *       added after a device has connected may not be seen by it.
+  */
+int MicroBitBLEManager::enableServices(uint8_t services)
+{
+    this->services |= services;
+
+    if (ble)
+        startServices();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines which core services are running.
+  *
+  * @return A bitmask of MICROBIT_BLE_SERVICE_DFU, MICROBIT_BLE_SERVICE_DEVICE_INFORMATION and MICROBIT_BLE_SERVICE_EVENT.
+  */
+uint8_t MicroBitBLEManager::getServices()
+{
+    return servicesRunning;
+}
+
+/**
+  * Instantiates any selected core services that are not yet running.
+  */
+void MicroBitBLEManager::startServices()
+{
+    for (int i = 0; bleServices[i].create != NULL; i++)
+    {
+        if ((services & bleServices[i].service) && !(servicesRunning & bleServices[i].service))
+        {
+            bleServices[i].create(*ble, *messageBus, serialNumber);
+            servicesRunning |= bleServices[i].service;
+        }
+    }
+}
+
 /**
  * Change the output power level of the transmitter to the given value.
  *
@@ -452,6 +589,96 @@ int MicroBitBLEManager::setTransmitPower(int power)
     return MICROBIT_OK;
 }
 
+/**
+ * Requests that the connected central device use connection parameters from the given profile.
+ * The profile is also used as our preferred parameters for any future connections, and may be set before init().
+ *
+ * The central device chooses the parameters actually used. Those granted at connection are
+ * reported with a MICROBIT_BLE_EVT_CONNECTION_PARAMS event, and can be read with getConnectionParams().
+ *
+ * @param profile One of MICROBIT_BLE_PROFILE_THROUGHPUT, MICROBIT_BLE_PROFILE_BALANCED or MICROBIT_BLE_PROFILE_LOW_POWER.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the profile is not recognised, or MICROBIT_NOT_SUPPORTED
+ *         if the Bluetooth stack refused the request.
+ *
+ * @code
+ * // about to send lots of data...
+ * bleManager.setConnectionProfile(MICROBIT_BLE_PROFILE_THROUGHPUT);
+ * @endcode
+ */
+int MicroBitBLEManager::setConnectionProfile(MicroBitBLEConnectionProfile profile)
+{
+    if (profile < MICROBIT_BLE_PROFILE_THROUGHPUT || profile > MICROBIT_BLE_PROFILE_LOW_POWER)
+        return MICROBIT_INVALID_PARAMETER;
+
+    connectionProfile = profile;
+
+    // If the stack isn't running yet, init() will apply the profile.
+    if (ble == NULL)
+        return MICROBIT_OK;
+
+    if (ble->setPreferredConnectionParams(&connectionProfiles[profile]) != BLE_ERROR_NONE)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // If we're connected, ask the central to switch now. It will respond in its own time, if at all.
+    if (ble->getGapState().connected && ble->gap().updateConnectionParams(connectionHandle, &connectionProfiles[profile]) != BLE_ERROR_NONE)
+        return MICROBIT_NOT_SUPPORTED;
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Determines the connection parameter profile most recently requested.
+ *
+ * @return The current profile.
+ */
+MicroBitBLEConnectionProfile MicroBitBLEManager::getConnectionProfile()
+{
+    return connectionProfile;
+}
+
+/**
+ * Reads the connection parameters granted by the connected central device.
+ *
+ * @param params The structure to populate with the connection parameters. Intervals are in units of 1.25 ms,
+ *        and the supervision timeout in units of 10 ms.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack has not been initialised,
+ *         or MICROBIT_NO_DATA if no device is connected.
+ */
+int MicroBitBLEManager::getConnectionParams(Gap::ConnectionParams_t &params)
+{
+    if (ble == NULL)
+        return MICROBIT_NOT_SUPPORTED;
+
+    if (!ble->getGapState().connected)
+        return MICROBIT_NO_DATA;
+
+    params = connectionParams;
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Records the connection parameters granted by the central device, and raises a
+ * MICROBIT_BLE_EVT_CONNECTION_PARAMS event.
+ *
+ * @param handle The handle of the connection.
+ *
+ * @param params The parameters in use on the connection.
+ *
+ * @note for internal use only.
+ */
+void MicroBitBLEManager::connectionParamsGranted(Gap::Handle_t handle, const Gap::ConnectionParams_t *params)
+{
+    connectionHandle = handle;
+
+    if (params != NULL)
+        connectionParams = *params;
+
+    MicroBitEvent(MICROBIT_ID_BLE, MICROBIT_BLE_EVT_CONNECTION_PARAMS);
+}
+
 /**
  * Determines the number of devices currently bonded with this micro:bit.
  * @return The number of active bonds.
@@ -502,10 +729,19 @@ void MicroBitBLEManager::pairingComplete(bool success)
 
 /**
  * Periodic callback in thread context.
- * We use this here purely to safely issue a disconnect operation after a pairing operation is complete.
+ * We use this here to safely issue a disconnect operation after a pairing operation is complete,
+ * and to move on to the next advertising frame when rotating between them.
  */
 void MicroBitBLEManager::idleTick()
 {
+#if MICROBIT_BLE_ADVERTISING_SLOTS > 0
+    if ((this->status & MICROBIT_BLE_STATUS_ROTATING) && (uint32_t)system_timer_current_time() - advertisingFrameTime >= advertisingPeriod)
+    {
+        advertisingFrameIndex = (advertisingFrameIndex + 1) % advertisingFrameCount;
+        showAdvertisingFrame();
+    }
+#endif
+
     if (this->status & MICROBIT_BLE_STATUS_DISCONNECT)
     {
         if((system_timer_current_time() - pairing_completed_at_time) >= MICROBIT_BLE_DISCONNECT_AFTER_PAIRING_DELAY) {
@@ -528,6 +764,10 @@ void MicroBitBLEManager::idleTick()
 */
 void MicroBitBLEManager::stopAdvertising()
 {
+#if MICROBIT_BLE_ADVERTISING_SLOTS > 0
+    this->status &= ~MICROBIT_BLE_STATUS_ROTATING;
+#endif
+
     ble->gap().stopAdvertising();
 }
 
@@ -548,6 +788,8 @@ void MicroBitBLEManager::stopAdvertising()
   */
 int MicroBitBLEManager::advertiseEddystoneUrl(const char* url, int8_t calibratedPower, bool connectable, uint16_t interval)
 {
+    this->status &= ~MICROBIT_BLE_STATUS_ROTATING;
+
     ble->gap().stopAdvertising();
     ble->clearAdvertisingPayload();
 
@@ -605,6 +847,8 @@ int MicroBitBLEManager::advertiseEddystoneUrl(ManagedString url, int8_t calibrat
   */
 int MicroBitBLEManager::advertiseEddystoneUid(const char* uid_namespace, const char* uid_instance, int8_t calibratedPower, bool connectable, uint16_t interval)
 {
+    this->status &= ~MICROBIT_BLE_STATUS_ROTATING;
+
     ble->gap().stopAdvertising();
     ble->clearAdvertisingPayload();
 
@@ -624,6 +868,190 @@ int MicroBitBLEManager::advertiseEddystoneUid(const char* uid_namespace, const c
 }
 #endif
 
+#if MICROBIT_BLE_ADVERTISING_SLOTS > 0
+/**
+  * Claims the next free advertising frame, and initialises it with the flags common to all frames.
+  *
+  * @param type The type of the frame, MICROBIT_BLE_FRAME_STATIC or MICROBIT_BLE_FRAME_TLM.
+  *
+  * @return The frame, or NULL if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+  */
+GapAdvertisingData *MicroBitBLEManager::newAdvertisingFrame(uint8_t type)
+{
+    if (advertisingFrameCount >= MICROBIT_BLE_ADVERTISING_SLOTS)
+        return NULL;
+
+    GapAdvertisingData *frame = &advertisingFrames[advertisingFrameCount];
+
+    frame->clear();
+    frame->addFlags(GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
+    advertisingFrameTypes[advertisingFrameCount] = type;
+
+    return frame;
+}
+
+/**
+  * Hands the current advertising frame to the BLE stack, recomputing it first if necessary, and
+  * schedules the next change of frame.
+  */
+void MicroBitBLEManager::showAdvertisingFrame()
+{
+    uint32_t now = (uint32_t) system_timer_current_time();
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_TLM)
+    if (advertisingFrameTypes[advertisingFrameIndex] == MICROBIT_BLE_FRAME_TLM)
+    {
+        GapAdvertisingData *frame = &advertisingFrames[advertisingFrameIndex];
+        int32_t temperature;
+        int16_t tlmTemperature = (int16_t) 0x8000;
+
+        // The SoftDevice reports in units of 0.25 degrees, and TLM in 8.8 fixed point.
+        if (sd_temp_get(&temperature) == NRF_SUCCESS)
+            tlmTemperature = temperature * 64;
+
+        // The micro:bit cannot measure its supply voltage, so report it as unknown. The number of frames
+        // sent since power on is estimated from the advertising interval.
+        frame->clear();
+        frame->addFlags(GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
+        MicroBitEddystone::getInstance()->setTLM(*frame, 0, tlmTemperature, now / advertisingInterval, now / 100);
+    }
+#endif
+
+    ble->gap().setAdvertisingPayload(advertisingFrames[advertisingFrameIndex]);
+
+    advertisingFrameTime = now;
+    system_timer_wake_at(now + advertisingPeriod);
+}
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_URL)
+/**
+  * Precomputes an Eddystone URL frame, and adds it to those advertised by rotateAdvertising().
+  *
+  * @param url The url to broadcast
+  *
+  * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the url is empty,
+  *         or MICROBIT_NO_RESOURCES if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+  */
+int MicroBitBLEManager::addEddystoneUrlFrame(const char *url, int8_t calibratedPower)
+{
+    GapAdvertisingData *frame = newAdvertisingFrame(MICROBIT_BLE_FRAME_STATIC);
+
+    if (frame == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    int ret = MicroBitEddystone::getInstance()->setURL(*frame, url, calibratedPower);
+
+    if (ret == MICROBIT_OK)
+        advertisingFrameCount++;
+
+    return ret;
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_UID)
+/**
+  * Precomputes an Eddystone UID frame, and adds it to those advertised by rotateAdvertising().
+  *
+  * @param uid_namespace: the uid namespace. Must 10 bytes long.
+  *
+  * @param uid_instance:  the uid instance value. Must 6 bytes long.
+  *
+  * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if either id is NULL,
+  *         or MICROBIT_NO_RESOURCES if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+  */
+int MicroBitBLEManager::addEddystoneUidFrame(const char* uid_namespace, const char* uid_instance, int8_t calibratedPower)
+{
+    GapAdvertisingData *frame = newAdvertisingFrame(MICROBIT_BLE_FRAME_STATIC);
+
+    if (frame == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    int ret = MicroBitEddystone::getInstance()->setUID(*frame, uid_namespace, uid_instance, calibratedPower);
+
+    if (ret == MICROBIT_OK)
+        advertisingFrameCount++;
+
+    return ret;
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_TLM)
+/**
+  * Adds an Eddystone TLM (telemetry) frame to those advertised by rotateAdvertising(). Its temperature,
+  * advertising count and uptime are brought up to date each time it is advertised.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if all MICROBIT_BLE_ADVERTISING_SLOTS frames are in use.
+  */
+int MicroBitBLEManager::addEddystoneTlmFrame()
+{
+    if (newAdvertisingFrame(MICROBIT_BLE_FRAME_TLM) == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    advertisingFrameCount++;
+
+    return MICROBIT_OK;
+}
+#endif
+
+/**
+  * Removes all the frames added for rotateAdvertising(), and stops rotating between them.
+  * Any current advertising continues with the frame last advertised, until stopAdvertising() is called.
+  */
+void MicroBitBLEManager::clearAdvertisingFrames()
+{
+    this->status &= ~MICROBIT_BLE_STATUS_ROTATING;
+    advertisingFrameCount = 0;
+    advertisingFrameIndex = 0;
+}
+
+/**
+  * Begins advertising the precomputed frames in turn, moving to the next one every period milliseconds.
+  * Each change of frame is a single call to the BLE stack, made from the idle thread.
+  *
+  * @param period the time to advertise each frame for, in milliseconds.
+  *
+  * @param connectable true to keep bluetooth connectable for other services, false otherwise. (Defaults to false)
+  *
+  * @param interval the interval between advertising packets, in milliseconds. Longer intervals save power,
+  *        at the cost of discoverability. (Defaults to MICROBIT_BLE_EDDYSTONE_ADV_INTERVAL)
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if period is 0 or no frames have been added.
+  *
+  * @code
+  * bleManager.addEddystoneUrlFrame("https://microbit.org");
+  * bleManager.addEddystoneTlmFrame();
+  * bleManager.rotateAdvertising(1000);
+  * @endcode
+  */
+int MicroBitBLEManager::rotateAdvertising(uint16_t period, bool connectable, uint16_t interval)
+{
+    if (period == 0 || interval == 0 || advertisingFrameCount == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    ble->gap().stopAdvertising();
+
+    ble->setAdvertisingType(connectable ? GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED : GapAdvertisingParams::ADV_NON_CONNECTABLE_UNDIRECTED);
+    ble->setAdvertisingInterval(interval);
+
+    advertisingPeriod = period;
+    advertisingInterval = interval;
+    advertisingFrameIndex = 0;
+    showAdvertisingFrame();
+
+    // Rotating frames are advertised until stopped, regardless of MICROBIT_BLE_ADVERTISING_TIMEOUT.
+    ble->gap().setAdvertisingTimeout(0);
+    ble->gap().startAdvertising();
+
+    this->status |= MICROBIT_BLE_STATUS_ROTATING;
+
+    return MICROBIT_OK;
+}
+#endif
+
 /**
  * Enter pairing mode. This is mode is called to initiate pairing, and to enable FOTA programming
  * of the micro:bit in cases where BLE is disabled during normal operation.
@@ -638,16 +1066,17 @@ int MicroBitBLEManager::advertiseEddystoneUid(const char* uid_namespace, const c
  */
 void MicroBitBLEManager::pairingMode(MicroBitDisplay &display, MicroBitButton &authorisationButton)
 {
-    ManagedString namePrefix("BBC micro:bit [");
+    ManagedString namePrefix((StringData*)(void*)&pairingNamePrefix);
     ManagedString namePostfix("]");
     ManagedString BLEName = namePrefix + deviceName + namePostfix;
 
-    ManagedString msg("PAIRING MODE!");
+    ManagedString msg((StringData*)(void*)&pairingMessage);
 
     int timeInPairingMode = 0;
     int brightness = 255;
     int fadeDirection = 0;
 
+    this->status &= ~MICROBIT_BLE_STATUS_ROTATING;
     ble->gap().stopAdvertising();
 
 // Clear the whitelist (if we have one), so that we're discoverable by all BLE devices.
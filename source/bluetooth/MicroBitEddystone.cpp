@@ -63,6 +63,12 @@ const int EDDYSTONE_UID_INSTANCE_MAX_LENGTH = 6;
 const uint8_t EDDYSTONE_UID_FRAME_TYPE = 0x00;
 #endif
 
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_TLM)
+const int EDDYSTONE_TLM_LENGTH = 14;
+const uint8_t EDDYSTONE_TLM_FRAME_TYPE = 0x20;
+const uint8_t EDDYSTONE_TLM_VERSION = 0x00;
+#endif
+
 /**
  * Constructor.
  *
@@ -88,16 +94,17 @@ MicroBitEddystone* MicroBitEddystone::getInstance()
 #if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_URL)
 
 /**
-  * Set the content of Eddystone URL frames
+  * Encodes the service data of an Eddystone URL frame.
+  *
+  * @param rawFrame The buffer to encode into. Must be at least EDDYSTONE_URL_MAX_LENGTH + 4 bytes long.
   *
   * @param url The url to broadcast
   *
-  * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+  * @param calibratedPower the transmission range of the beacon.
   *
-  * @note The calibratedPower value ranges from -100 to +20 to a resolution of 1. The calibrated power should be binary encoded.
-  * More information can be found at https://github.com/google/eddystone/tree/master/eddystone-uid#tx-power
+  * @return The length of the frame, or MICROBIT_INVALID_PARAMETER if the url is empty.
   */
-int MicroBitEddystone::setURL(BLEDevice* ble, const char* url, int8_t calibratedPower)
+int MicroBitEddystone::encodeURL(uint8_t *rawFrame, const char* url, int8_t calibratedPower)
 {
     int urlDataLength = 0;
     char urlData[EDDYSTONE_URL_MAX_LENGTH];
@@ -141,7 +148,6 @@ int MicroBitEddystone::setURL(BLEDevice* ble, const char* url, int8_t calibrated
         }
     }
 
-    uint8_t rawFrame[EDDYSTONE_URL_MAX_LENGTH + 4];
     size_t index = 0;
     rawFrame[index++] = EDDYSTONE_UUID[0];
     rawFrame[index++] = EDDYSTONE_UUID[1];
@@ -149,8 +155,56 @@ int MicroBitEddystone::setURL(BLEDevice* ble, const char* url, int8_t calibrated
     rawFrame[index++] = calibratedPower;
     memcpy(rawFrame + index, urlData, urlDataLength);
 
+    return index + urlDataLength;
+}
+
+/**
+  * Set the content of Eddystone URL frames
+  *
+  * @param url The url to broadcast
+  *
+  * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+  *
+  * @note The calibratedPower value ranges from -100 to +20 to a resolution of 1. The calibrated power should be binary encoded.
+  * More information can be found at https://github.com/google/eddystone/tree/master/eddystone-uid#tx-power
+  */
+int MicroBitEddystone::setURL(BLEDevice* ble, const char* url, int8_t calibratedPower)
+{
+    uint8_t rawFrame[EDDYSTONE_URL_MAX_LENGTH + 4];
+    int length = encodeURL(rawFrame, url, calibratedPower);
+
+    if (length < 0)
+        return length;
+
     ble->accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, EDDYSTONE_UUID, sizeof(EDDYSTONE_UUID));
-    ble->accumulateAdvertisingPayload(GapAdvertisingData::SERVICE_DATA, rawFrame, index + urlDataLength);
+    ble->accumulateAdvertisingPayload(GapAdvertisingData::SERVICE_DATA, rawFrame, length);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Adds an Eddystone URL frame to the given advertising data, such that it may be precomputed and
+  * later advertised with a single call to the BLE stack.
+  *
+  * @param data The advertising data to add the frame to.
+  *
+  * @param url The url to broadcast
+  *
+  * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+  *
+  * @note The calibratedPower value ranges from -100 to +20 to a resolution of 1. The calibrated power should be binary encoded.
+  * More information can be found at https://github.com/google/eddystone/tree/master/eddystone-uid#tx-power
+  */
+int MicroBitEddystone::setURL(GapAdvertisingData &data, const char* url, int8_t calibratedPower)
+{
+    uint8_t rawFrame[EDDYSTONE_URL_MAX_LENGTH + 4];
+    int length = encodeURL(rawFrame, url, calibratedPower);
+
+    if (length < 0)
+        return length;
+
+    data.addData(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, EDDYSTONE_UUID, sizeof(EDDYSTONE_UUID));
+    data.addData(GapAdvertisingData::SERVICE_DATA, rawFrame, length);
 
     return MICROBIT_OK;
 }
@@ -173,6 +227,41 @@ int MicroBitEddystone::setURL(BLEDevice* ble, ManagedString url, int8_t calibrat
 
 #if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_UID)
 
+/**
+  * Encodes the service data of an Eddystone UID frame.
+  *
+  * @param rawFrame The buffer to encode into. Must be at least 20 bytes long.
+  *
+  * @param uid_namespace the uid namespace. Must 10 bytes long.
+  *
+  * @param uid_instance  the uid instance value. Must 6 bytes long.
+  *
+  * @param calibratedPower the transmission range of the beacon.
+  *
+  * @return The length of the frame, or MICROBIT_INVALID_PARAMETER if either id is NULL.
+  */
+int MicroBitEddystone::encodeUID(uint8_t *rawFrame, const char* uid_namespace, const char* uid_instance, int8_t calibratedPower)
+{
+    if (uid_namespace == NULL || uid_instance == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    size_t index = 0;
+    rawFrame[index++] = EDDYSTONE_UUID[0];
+    rawFrame[index++] = EDDYSTONE_UUID[1];
+    rawFrame[index++] = EDDYSTONE_UID_FRAME_TYPE;
+    rawFrame[index++] = calibratedPower;
+
+    // UID namespace
+    memcpy(rawFrame + index, uid_namespace, EDDYSTONE_UID_NAMESPACE_MAX_LENGTH);
+    index += EDDYSTONE_UID_NAMESPACE_MAX_LENGTH;
+
+    // UID instance
+    memcpy(rawFrame + index, uid_instance, EDDYSTONE_UID_INSTANCE_MAX_LENGTH);
+    index += EDDYSTONE_UID_INSTANCE_MAX_LENGTH;
+
+    return index;
+}
+
 /**
   * Set the content of Eddystone UID frames
   *
@@ -187,27 +276,91 @@ int MicroBitEddystone::setURL(BLEDevice* ble, ManagedString url, int8_t calibrat
   */
 int MicroBitEddystone::setUID(BLEDevice* ble, const char* uid_namespace, const char* uid_instance, int8_t calibratedPower)
 {
-    if (uid_namespace == NULL || uid_instance == NULL)
-        return MICROBIT_INVALID_PARAMETER;
+    uint8_t rawFrame[EDDYSTONE_UID_NAMESPACE_MAX_LENGTH + EDDYSTONE_UID_INSTANCE_MAX_LENGTH + 4];
+    int length = encodeUID(rawFrame, uid_namespace, uid_instance, calibratedPower);
 
-    char uidData[EDDYSTONE_UID_NAMESPACE_MAX_LENGTH + EDDYSTONE_UID_INSTANCE_MAX_LENGTH];
+    if (length < 0)
+        return length;
 
-    // UID namespace
-    memcpy(uidData, uid_namespace, EDDYSTONE_UID_NAMESPACE_MAX_LENGTH);
+    ble->accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, EDDYSTONE_UUID, sizeof(EDDYSTONE_UUID));
+    ble->accumulateAdvertisingPayload(GapAdvertisingData::SERVICE_DATA, rawFrame, length);
 
-    // UID instance
-    memcpy(uidData + EDDYSTONE_UID_NAMESPACE_MAX_LENGTH, uid_instance, EDDYSTONE_UID_INSTANCE_MAX_LENGTH);
+    return MICROBIT_OK;
+}
 
+/**
+  * Adds an Eddystone UID frame to the given advertising data, such that it may be precomputed and
+  * later advertised with a single call to the BLE stack.
+  *
+  * @param data The advertising data to add the frame to.
+  *
+  * @param uid_namespace the uid namespace. Must 10 bytes long.
+  *
+  * @param uid_instance  the uid instance value. Must 6 bytes long.
+  *
+  * @param calibratedPower the transmission range of the beacon (Defaults to: 0xF0 ~10m).
+  *
+  * @note The calibratedPower value ranges from -100 to +20 to a resolution of 1. The calibrated power should be binary encoded.
+  * More information can be found at https://github.com/google/eddystone/tree/master/eddystone-uid#tx-power
+  */
+int MicroBitEddystone::setUID(GapAdvertisingData &data, const char* uid_namespace, const char* uid_instance, int8_t calibratedPower)
+{
     uint8_t rawFrame[EDDYSTONE_UID_NAMESPACE_MAX_LENGTH + EDDYSTONE_UID_INSTANCE_MAX_LENGTH + 4];
+    int length = encodeUID(rawFrame, uid_namespace, uid_instance, calibratedPower);
+
+    if (length < 0)
+        return length;
+
+    data.addData(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, EDDYSTONE_UUID, sizeof(EDDYSTONE_UUID));
+    data.addData(GapAdvertisingData::SERVICE_DATA, rawFrame, length);
+
+    return MICROBIT_OK;
+}
+
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_TLM)
+
+/**
+  * Adds an unencrypted Eddystone TLM (telemetry) frame to the given advertising data.
+  *
+  * @param data The advertising data to add the frame to.
+  *
+  * @param batteryVoltage The battery voltage in millivolts, or 0 if unknown.
+  *
+  * @param temperature The temperature in degrees Celsius, as an 8.8 fixed point value, or -128 (0x8000) if unknown.
+  *
+  * @param advertisingCount The number of advertising frames sent since power on.
+  *
+  * @param uptime The time since power on, in units of 0.1 seconds.
+  *
+  * @return MICROBIT_OK on success.
+  *
+  * @note More information can be found at https://github.com/google/eddystone/tree/master/eddystone-tlm
+  */
+int MicroBitEddystone::setTLM(GapAdvertisingData &data, uint16_t batteryVoltage, int16_t temperature, uint32_t advertisingCount, uint32_t uptime)
+{
+    uint8_t rawFrame[EDDYSTONE_TLM_LENGTH + 2];
     size_t index = 0;
+
+    // All fields are big endian.
     rawFrame[index++] = EDDYSTONE_UUID[0];
     rawFrame[index++] = EDDYSTONE_UUID[1];
-    rawFrame[index++] = EDDYSTONE_UID_FRAME_TYPE;
-    rawFrame[index++] = calibratedPower;
-    memcpy(rawFrame + index, uidData, EDDYSTONE_UID_NAMESPACE_MAX_LENGTH + EDDYSTONE_UID_INSTANCE_MAX_LENGTH);
+    rawFrame[index++] = EDDYSTONE_TLM_FRAME_TYPE;
+    rawFrame[index++] = EDDYSTONE_TLM_VERSION;
+    rawFrame[index++] = batteryVoltage >> 8;
+    rawFrame[index++] = batteryVoltage;
+    rawFrame[index++] = (uint16_t)temperature >> 8;
+    rawFrame[index++] = temperature;
 
-    ble->accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, EDDYSTONE_UUID, sizeof(EDDYSTONE_UUID));
-    ble->accumulateAdvertisingPayload(GapAdvertisingData::SERVICE_DATA, rawFrame, index + EDDYSTONE_UID_NAMESPACE_MAX_LENGTH + EDDYSTONE_UID_INSTANCE_MAX_LENGTH);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        rawFrame[index++] = advertisingCount >> shift;
+
+    for (int shift = 24; shift >= 0; shift -= 8)
+        rawFrame[index++] = uptime >> shift;
+
+    data.addData(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, EDDYSTONE_UUID, sizeof(EDDYSTONE_UUID));
+    data.addData(GapAdvertisingData::SERVICE_DATA, rawFrame, index);
 
     return MICROBIT_OK;
 }
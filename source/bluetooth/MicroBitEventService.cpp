@@ -33,6 +33,7 @@ DEALINGS IN THE SOFTWARE.
 #include "ble/UUID.h"
 #include "ExternalEvents.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 
 /**
   * Constructor.
@@ -43,7 +44,7 @@ DEALINGS IN THE SOFTWARE.
 MicroBitEventService::MicroBitEventService(BLEDevice &_ble, EventModel &_messageBus) :
         ble(_ble),messageBus(_messageBus)
 {
-    GattCharacteristic  microBitEventCharacteristic(MicroBitEventServiceMicroBitEventCharacteristicUUID, (uint8_t *)&microBitEventBuffer, 0, sizeof(EventServiceEvent),
+    GattCharacteristic  microBitEventCharacteristic(MicroBitEventServiceMicroBitEventCharacteristicUUID, (uint8_t *)microBitEventBuffer, 0, sizeof(microBitEventBuffer),
     GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
 
     GattCharacteristic  clientEventCharacteristic(MicroBitEventServiceClientEventCharacteristicUUID, (uint8_t *)&clientEventBuffer, 0, sizeof(EventServiceEvent),
@@ -51,6 +52,8 @@ MicroBitEventService::MicroBitEventService(BLEDevice &_ble, EventModel &_message
 
     GattCharacteristic  clientRequirementsCharacteristic(MicroBitEventServiceClientRequirementsCharacteristicUUID, (uint8_t *)&clientRequirementsBuffer, 0, sizeof(EventServiceEvent), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE);
 
+    GattCharacteristic  clientRateLimitCharacteristic(MicroBitEventServiceClientRateLimitCharacteristicUUID, (uint8_t *)&clientRateLimitBuffer, 0, sizeof(EventServiceRateLimit), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE);
+
     microBitRequirementsCharacteristic = new GattCharacteristic(MicroBitEventServiceMicroBitRequirementsCharacteristicUUID, (uint8_t *)&microBitRequirementsBuffer, 0, sizeof(EventServiceEvent), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
 
     microBitRequirementsCharacteristic->setReadAuthorizationCallback(this, &MicroBitEventService::onRequirementsRead);
@@ -58,7 +61,17 @@ MicroBitEventService::MicroBitEventService(BLEDevice &_ble, EventModel &_message
     clientEventBuffer.type = 0x00;
     clientEventBuffer.reason = 0x00;
 
-    microBitEventBuffer = microBitRequirementsBuffer = clientRequirementsBuffer = clientEventBuffer;
+    microBitEventBuffer[0] = microBitRequirementsBuffer = clientRequirementsBuffer = clientEventBuffer;
+
+    clientRateLimitBuffer.type = 0;
+    clientRateLimitBuffer.interval = 0;
+
+    for (int i = 0; i < MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS; i++)
+        rateLimits[i] = clientRateLimitBuffer;
+
+    eventQueueHead = 0;
+    eventQueueLength = 0;
+    flushPending = false;
 
     messageBusListenerOffset = 0;
 
@@ -67,8 +80,9 @@ MicroBitEventService::MicroBitEventService(BLEDevice &_ble, EventModel &_message
     clientEventCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     clientRequirementsCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     microBitRequirementsCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    clientRateLimitCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
 
-    GattCharacteristic *characteristics[] = {&microBitEventCharacteristic, &clientEventCharacteristic, &clientRequirementsCharacteristic, microBitRequirementsCharacteristic};
+    GattCharacteristic *characteristics[] = {&microBitEventCharacteristic, &clientEventCharacteristic, &clientRequirementsCharacteristic, microBitRequirementsCharacteristic, &clientRateLimitCharacteristic};
     GattService         service(MicroBitEventServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
 
     ble.addService(service);
@@ -76,6 +90,7 @@ MicroBitEventService::MicroBitEventService(BLEDevice &_ble, EventModel &_message
     microBitEventCharacteristicHandle = microBitEventCharacteristic.getValueHandle();
     clientEventCharacteristicHandle = clientEventCharacteristic.getValueHandle();
     clientRequirementsCharacteristicHandle = clientRequirementsCharacteristic.getValueHandle();
+    clientRateLimitCharacteristicHandle = clientRateLimitCharacteristic.getValueHandle();
 
     ble.onDataWritten(this, &MicroBitEventService::onDataWritten);
 
@@ -114,6 +129,20 @@ void MicroBitEventService::onDataWritten(const GattWriteCallbackParams *params)
         }
         return;
     }
+
+    if (params->handle == clientRateLimitCharacteristicHandle) {
+        EventServiceRateLimit *r = (EventServiceRateLimit *)params->data;
+
+        // Apply each of the rate limits given...
+        while (len >= 4)
+        {
+            setRateLimit(r->type, r->interval);
+
+            len-=4;
+            r++;
+        }
+        return;
+    }
 }
 
 /**
@@ -121,26 +150,173 @@ void MicroBitEventService::onDataWritten(const GattWriteCallbackParams *params)
   */
 void MicroBitEventService::onMicroBitEvent(MicroBitEvent evt)
 {
-    EventServiceEvent *e = &microBitEventBuffer;
+    bool schedule = false;
+
+    if (!ble.getGapState().connected || isRateLimited(evt.source))
+        return;
+
+    // Queue the event. It is sent from the idle task, along with any others raised before then.
+    __disable_irq();
+
+    if (eventQueueLength < MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE)
+    {
+        EventServiceEvent *e = &eventQueue[(eventQueueHead + eventQueueLength) % MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE];
 
-    if (ble.getGapState().connected) {
         e->type = evt.source;
         e->reason = evt.value;
+        eventQueueLength++;
+
+        schedule = !flushPending;
+        flushPending = true;
+    }
+
+    __enable_irq();
+
+    // If we can't defer the work, idleTick() will pick it up instead.
+    if (schedule && fiber_defer(MicroBitEventService::flushDeferred, this) != MICROBIT_OK)
+        flushPending = false;
+}
+
+/**
+  * Called by fiber_defer() to send the events queued by onMicroBitEvent().
+  */
+void MicroBitEventService::flushDeferred(void *service)
+{
+    ((MicroBitEventService *)service)->flush();
+}
+
+/**
+  * Sends any queued events to the client, as many to each notification as will fit.
+  *
+  * If the Bluetooth stack has no room for a notification, the remaining events are kept, and sent on a later idle tick.
+  */
+void MicroBitEventService::flush()
+{
+    // Events queued from here on will schedule another flush, if this one doesn't send them.
+    flushPending = false;
+
+    while (eventQueueLength > 0)
+    {
+        int count = 0;
+
+        __disable_irq();
+
+        while (count < eventQueueLength && count < MICROBIT_EVENT_SERVICE_MAX_EVENTS)
+        {
+            microBitEventBuffer[count] = eventQueue[(eventQueueHead + count) % MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE];
+            count++;
+        }
+
+        __enable_irq();
+
+        if (ble.gattServer().notify(microBitEventCharacteristicHandle, (const uint8_t *)microBitEventBuffer, count * sizeof(EventServiceEvent)) != BLE_ERROR_NONE)
+            return;
+
+        __disable_irq();
+
+        eventQueueHead = (eventQueueHead + count) % MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE;
+        eventQueueLength -= count;
 
-        ble.gattServer().notify(microBitEventCharacteristicHandle, (const uint8_t *)e, sizeof(EventServiceEvent));
+        __enable_irq();
     }
 }
 
+/**
+  * Determines if an event from the given source should be dropped, due to a rate limit set by the client.
+  *
+  * @param type The source of the event.
+  *
+  * @return true if the event should be dropped, false otherwise.
+  */
+bool MicroBitEventService::isRateLimited(uint16_t type)
+{
+    uint32_t now = (uint32_t) system_timer_current_time();
+    bool limited = false;
+
+    __disable_irq();
+
+    for (int i = 0; i < MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS; i++)
+    {
+        if (rateLimits[i].interval != 0 && rateLimits[i].type == type)
+        {
+            if (now - rateLimitLastEvent[i] < rateLimits[i].interval)
+                limited = true;
+            else
+                rateLimitLastEvent[i] = now;
+
+            break;
+        }
+    }
+
+    __enable_irq();
+
+    return limited;
+}
+
+/**
+  * Sets, or clears, the minimum interval between events sent from a given source.
+  *
+  * @param type The source to limit.
+  *
+  * @param interval The minimum time between events from this source, in milliseconds, or 0 to remove the limit.
+  */
+void MicroBitEventService::setRateLimit(uint16_t type, uint16_t interval)
+{
+    int slot = -1;
+
+    __disable_irq();
+
+    // Reuse this source's entry if it has one, otherwise take the first free one.
+    for (int i = 0; i < MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS; i++)
+    {
+        if (rateLimits[i].interval != 0 && rateLimits[i].type == type)
+        {
+            slot = i;
+            break;
+        }
+
+        if (slot < 0 && rateLimits[i].interval == 0)
+            slot = i;
+    }
+
+    // If the table is full, the new limit is ignored.
+    if (slot >= 0)
+    {
+        rateLimits[slot].type = type;
+        rateLimits[slot].interval = interval;
+        rateLimitLastEvent[slot] = (uint32_t) system_timer_current_time() - interval;
+    }
+
+    __enable_irq();
+}
+
 /**
   * Periodic callback from MicroBit scheduler.
   * If we're no longer connected, remove any registered Message Bus listeners.
   */
 void MicroBitEventService::idleTick()
 {
-    if (!ble.getGapState().connected && messageBusListenerOffset >0) {
-        messageBusListenerOffset = 0;
-        messageBus.ignore(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, this, &MicroBitEventService::onMicroBitEvent);
+    if (!ble.getGapState().connected) {
+        // Discard anything left over from the last connection.
+        __disable_irq();
+
+        eventQueueLength = 0;
+        for (int i = 0; i < MICROBIT_BLE_EVENT_SERVICE_RATE_LIMITS; i++)
+            rateLimits[i].interval = 0;
+
+        __enable_irq();
+
+        if (messageBusListenerOffset >0) {
+            messageBusListenerOffset = 0;
+            messageBus.ignore(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, this, &MicroBitEventService::onMicroBitEvent);
+        }
+
+        return;
     }
+
+    // Retry any events the stack had no room for.
+    if (eventQueueLength > 0 && !flushPending)
+        flush();
 }
 
 /**
@@ -186,3 +362,7 @@ const uint8_t  MicroBitEventServiceMicroBitRequirementsCharacteristicUUID[] = {
 const uint8_t  MicroBitEventServiceClientRequirementsCharacteristicUUID[] = {
     0xe9,0x5d,0x23,0xc4,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
 };
+
+const uint8_t  MicroBitEventServiceClientRateLimitCharacteristicUUID[] = {
+    0xe9,0x5d,0x3c,0x62,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
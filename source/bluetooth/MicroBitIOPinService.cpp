@@ -32,6 +32,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitIOPinService.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 
 /**
   * Constructor.
@@ -55,20 +56,29 @@ MicroBitIOPinService::MicroBitIOPinService(BLEDevice &_ble, MicroBitIO &_io) :
     // Create the Data characteristic, that allows the actual read and write operations.
     ioPinServiceDataCharacteristic = new GattCharacteristic(MicroBitIOPinServiceDataUUID, (uint8_t *)ioPinServiceDataCharacteristicBuffer, 0, sizeof(ioPinServiceDataCharacteristicBuffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
 
+    // Create the Sampling characteristic, that sets how often each analog input is read, and by how much it must change to be reported.
+    GattCharacteristic ioPinServiceSamplingCharacteristic(MicroBitIOPinServiceSamplingUUID, (uint8_t *)ioPinServiceSamplingCharacteristicBuffer, 0, sizeof(ioPinServiceSamplingCharacteristicBuffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE);
+
     ioPinServiceDataCharacteristic->setReadAuthorizationCallback(this, &MicroBitIOPinService::onDataRead);
 
     ioPinServiceADCharacteristicBuffer = 0;
     ioPinServiceIOCharacteristicBuffer = 0;
     memset(ioPinServiceIOData, 0, sizeof(ioPinServiceIOData));
     memset(ioPinServicePWMCharacteristicBuffer, 0, sizeof(ioPinServicePWMCharacteristicBuffer));
+    memset(ioPinServiceSamplePeriod, 0, sizeof(ioPinServiceSamplePeriod));
+    memset(ioPinServiceDeadband, 0, sizeof(ioPinServiceDeadband));
+    memset(ioPinServiceLastSample, 0, sizeof(ioPinServiceLastSample));
+    ioPinServiceEdgePins = 0;
+    ioPinServiceEdgeSeen = false;
 
     // Set default security requirements
     ioPinServiceADCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     ioPinServiceIOCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     ioPinServicePWMCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     ioPinServiceDataCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    ioPinServiceSamplingCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
 
-    GattCharacteristic *characteristics[] = {&ioPinServiceADCharacteristic, &ioPinServiceIOCharacteristic, &ioPinServicePWMCharacteristic, ioPinServiceDataCharacteristic};
+    GattCharacteristic *characteristics[] = {&ioPinServiceADCharacteristic, &ioPinServiceIOCharacteristic, &ioPinServicePWMCharacteristic, ioPinServiceDataCharacteristic, &ioPinServiceSamplingCharacteristic};
     GattService         service(MicroBitIOPinServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
 
     ble.addService(service);
@@ -76,6 +86,7 @@ MicroBitIOPinService::MicroBitIOPinService(BLEDevice &_ble, MicroBitIO &_io) :
     ioPinServiceADCharacteristicHandle = ioPinServiceADCharacteristic.getValueHandle();
     ioPinServiceIOCharacteristicHandle = ioPinServiceIOCharacteristic.getValueHandle();
     ioPinServicePWMCharacteristicHandle = ioPinServicePWMCharacteristic.getValueHandle();
+    ioPinServiceSamplingCharacteristicHandle = ioPinServiceSamplingCharacteristic.getValueHandle();
 
     ble.gattServer().write(ioPinServiceADCharacteristicHandle, (const uint8_t *)&ioPinServiceADCharacteristicBuffer, sizeof(ioPinServiceADCharacteristicBuffer));
     ble.gattServer().write(ioPinServiceIOCharacteristicHandle, (const uint8_t *)&ioPinServiceIOCharacteristicBuffer, sizeof(ioPinServiceIOCharacteristicBuffer));
@@ -129,6 +140,69 @@ int MicroBitIOPinService::isOutput(int i)
     return ((ioPinServiceIOCharacteristicBuffer & (1 << i)) == 0);
 }
 
+/**
+  * Places each pin into the mode selected by the BLE configuration characteristics.
+  *
+  * Digital inputs are configured to raise events on each rising and falling edge, so that they need only be
+  * read when they change. Analog inputs are read periodically, from idleTick().
+  */
+void MicroBitIOPinService::configurePins()
+{
+    uint32_t edgePins = 0;
+
+    for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
+    {
+        if(isDigital(i) && isInput(i))
+        {
+            if (!(ioPinServiceEdgePins & (1 << i)))
+                io.pin[i].eventOn(MICROBIT_PIN_EVENT_ON_EDGE);
+
+            edgePins |= (1 << i);
+            continue;
+        }
+
+        if (ioPinServiceEdgePins & (1 << i))
+            io.pin[i].eventOn(MICROBIT_PIN_EVENT_NONE);
+
+        if(isAnalog(i) && isInput(i))
+        {
+            io.pin[i].getAnalogValue();
+            ioPinServiceLastSample[i] = (uint32_t) system_timer_current_time() - ioPinServiceSamplePeriod[i];
+        }
+    }
+
+    // Pins don't expose their event bus IDs, so we listen for edges from any source,
+    // and read all of our digital inputs when one is seen. We only listen whilst we have digital inputs.
+    if (EventModel::defaultEventBus && (edgePins == 0) != (ioPinServiceEdgePins == 0))
+    {
+        if (edgePins)
+        {
+            EventModel::defaultEventBus->listen(MICROBIT_ID_ANY, MICROBIT_PIN_EVT_RISE, this, &MicroBitIOPinService::onPinEvent, MESSAGE_BUS_LISTENER_IMMEDIATE);
+            EventModel::defaultEventBus->listen(MICROBIT_ID_ANY, MICROBIT_PIN_EVT_FALL, this, &MicroBitIOPinService::onPinEvent, MESSAGE_BUS_LISTENER_IMMEDIATE);
+        }
+        else
+        {
+            EventModel::defaultEventBus->ignore(MICROBIT_ID_ANY, MICROBIT_PIN_EVT_RISE, this, &MicroBitIOPinService::onPinEvent);
+            EventModel::defaultEventBus->ignore(MICROBIT_ID_ANY, MICROBIT_PIN_EVT_FALL, this, &MicroBitIOPinService::onPinEvent);
+        }
+    }
+
+    ioPinServiceEdgePins = edgePins;
+
+    // Read the new digital inputs on the next idle tick, in case they've changed while not being watched.
+    ioPinServiceEdgeSeen = true;
+}
+
+/**
+  * Callback. Invoked when a pin raises a rise or fall event.
+  *
+  * Marks our digital inputs as needing to be read on the next idle tick.
+  */
+void MicroBitIOPinService::onPinEvent(MicroBitEvent)
+{
+    ioPinServiceEdgeSeen = true;
+}
+
 /**
   * Callback. Invoked when any of our attributes are written via BLE.
   */
@@ -144,16 +218,7 @@ void MicroBitIOPinService::onDataWritten(const GattWriteCallbackParams *params)
         ble.gattServer().write(ioPinServiceIOCharacteristicHandle, (const uint8_t *)&ioPinServiceIOCharacteristicBuffer, sizeof(ioPinServiceIOCharacteristicBuffer));
 
         // Also, drop any selected pins into input mode, so we can pick up changes later
-        for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
-        {
-            if(isDigital(i) && isInput(i))
-               io.pin[i].getDigitalValue();
-               //MicroBitIOPins[i]->getDigitalValue();
-
-            if(isAnalog(i) && isInput(i))
-               io.pin[i].getAnalogValue();
-               //MicroBitIOPins[i]->getAnalogValue();
-        }
+        configurePins();
     }
 
     // Check for writes to the IO configuration characteristic
@@ -166,16 +231,7 @@ void MicroBitIOPinService::onDataWritten(const GattWriteCallbackParams *params)
         ble.gattServer().write(ioPinServiceADCharacteristicHandle, (const uint8_t *)&ioPinServiceADCharacteristicBuffer, sizeof(ioPinServiceADCharacteristicBuffer));
 
         // Also, drop any selected pins into input mode, so we can pick up changes later
-        for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
-        {
-            if(isDigital(i) && isInput(i))
-               io.pin[i].getDigitalValue();
-               //MicroBitIOPins[i]->getDigitalValue();
-
-            if(isAnalog(i) && isInput(i))
-               io.pin[i].getAnalogValue();
-               //MicroBitIOPins[i]->getAnalogValue();
-        }
+        configurePins();
     }
 
     // Check for writes to the PWM Control characteristic
@@ -205,6 +261,25 @@ void MicroBitIOPinService::onDataWritten(const GattWriteCallbackParams *params)
         }        
     }
 
+    // Check for writes to the Sampling characteristic
+    if (params->handle == ioPinServiceSamplingCharacteristicHandle)
+    {
+        uint16_t len = params->len;
+        IOSamplingData *sampling = (IOSamplingData *)params->data;
+
+        while (len >= sizeof(IOSamplingData))
+        {
+            if (sampling->pin < MICROBIT_IO_PIN_SERVICE_PINCOUNT)
+            {
+                ioPinServiceSamplePeriod[sampling->pin] = sampling->period;
+                ioPinServiceDeadband[sampling->pin] = sampling->deadband;
+            }
+
+            sampling++;
+            len -= sizeof(IOSamplingData);
+        }
+    }
+
     if (params->handle == ioPinServiceDataCharacteristic->getValueHandle())
     {
         // We have some pin data to change...
@@ -247,7 +322,7 @@ void MicroBitIOPinService::onDataRead(GattReadAuthCallbackParams *params)
         {
             if (isInput(i))
             {
-                uint8_t value;
+                uint16_t value;
 
                 if (isDigital(i))
                		value = io.pin[i].getDigitalValue();
@@ -287,23 +362,44 @@ void MicroBitIOPinService::idleTick()
         return;
 
     // Scan through all pins that our BLE client may be listening for. If any have changed value, update the BLE characterisitc, and NOTIFY our client.
+    // Digital inputs need only be read when one has raised an edge event, and analog inputs once per sampling period.
     int pairs = 0;
+    bool readDigital = ioPinServiceEdgeSeen;
+    uint32_t now = (uint32_t) system_timer_current_time();
+
+    ioPinServiceEdgeSeen = false;
 
     for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
     {
         if (isInput(i))
         {
-            uint8_t value;
+            uint16_t value;
+            bool changed;
 
             if (isDigital(i))
+            {
+                if (!readDigital)
+                    continue;
+
                	value = io.pin[i].getDigitalValue();
                 //value = MicroBitIOPins[i]->getDigitalValue();
+                changed = value != ioPinServiceIOData[i];
+            }
             else
+            {
+                if (now - ioPinServiceLastSample[i] < ioPinServiceSamplePeriod[i])
+                    continue;
+
+                ioPinServiceLastSample[i] = now;
+
                	value = io.pin[i].getAnalogValue();
                 //value = MicroBitIOPins[i]->getAnalogValue();
+                int delta = value - ioPinServiceIOData[i];
+                changed = delta > ioPinServiceDeadband[i] || -delta > ioPinServiceDeadband[i];
+            }
 
             // If the data has changed, send an update.
-            if (value != ioPinServiceIOData[i])
+            if (changed)
             {
                 ioPinServiceIOData[i] = value;
 
@@ -312,8 +408,12 @@ void MicroBitIOPinService::idleTick()
 
                 pairs++;
 
+                // If there's no more room, pick up any remaining digital changes next time.
                 if (pairs >= MICROBIT_IO_PIN_SERVICE_DATA_SIZE)
+                {
+                    ioPinServiceEdgeSeen = ioPinServiceEdgeSeen || readDigital;
                     break;
+                }
             }
         }
     }
@@ -343,6 +443,10 @@ const uint8_t MicroBitIOPinServiceDataUUID[] = {
     0xe9,0x5d,0x8d,0x00,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
 };
 
+const uint8_t MicroBitIOPinServiceSamplingUUID[] = {
+    0xe9,0x5d,0x3c,0x63,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
+
 /*
 MicroBitPin * const MicroBitIOPins[] = {
     &uBit.io.P0,
@@ -50,19 +50,28 @@ MicroBitLEDService::MicroBitLEDService(BLEDevice &_ble, MicroBitDisplay &_displa
     GattCharacteristic  scrollingSpeedCharacteristic(MicroBitLEDServiceScrollingSpeedUUID, (uint8_t *)&scrollingSpeedCharacteristicBuffer, 0,
     sizeof(scrollingSpeedCharacteristicBuffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
 
+    // Frames may be written without response, so a phone can stream them at the connection interval.
+    GattCharacteristic  frameCharacteristic(MicroBitLEDServiceFrameUUID, &frameCharacteristicBuffer, 0, MICROBIT_BLE_MAXIMUM_FRAME,
+    GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE);
+
     // Initialise our characteristic values.
     memclr(matrixCharacteristicBuffer, sizeof(matrixCharacteristicBuffer));
     textCharacteristicBuffer[0] = 0;
+    frameCharacteristicBuffer = 0;
     scrollingSpeedCharacteristicBuffer = MICROBIT_DEFAULT_SCROLL_SPEED;
 
+    // Streamed frames are held as an image literal, so they are never reference counted or freed.
+    ((ImageData *)frameImage)->refCount = 0xffff;
+
     matrixCharacteristic.setReadAuthorizationCallback(this, &MicroBitLEDService::onDataRead);
 
     // Set default security requirements
     matrixCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     textCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     scrollingSpeedCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    frameCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
 
-    GattCharacteristic *characteristics[] = {&matrixCharacteristic, &textCharacteristic, &scrollingSpeedCharacteristic};
+    GattCharacteristic *characteristics[] = {&matrixCharacteristic, &textCharacteristic, &scrollingSpeedCharacteristic, &frameCharacteristic};
     GattService         service(MicroBitLEDServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
 
     ble.addService(service);
@@ -70,6 +79,7 @@ MicroBitLEDService::MicroBitLEDService(BLEDevice &_ble, MicroBitDisplay &_displa
     matrixCharacteristicHandle = matrixCharacteristic.getValueHandle();
     textCharacteristicHandle = textCharacteristic.getValueHandle();
     scrollingSpeedCharacteristicHandle = scrollingSpeedCharacteristic.getValueHandle();
+    frameCharacteristicHandle = frameCharacteristic.getValueHandle();
 
     ble.gattServer().write(scrollingSpeedCharacteristicHandle, (const uint8_t *)&scrollingSpeedCharacteristicBuffer, sizeof(scrollingSpeedCharacteristicBuffer));
     ble.gattServer().write(matrixCharacteristicHandle, (const uint8_t *)&matrixCharacteristicBuffer, sizeof(matrixCharacteristicBuffer));
@@ -113,6 +123,44 @@ void MicroBitLEDService::onDataWritten(const GattWriteCallbackParams *params)
         // We use this as the speed for all scroll operations subsquently initiated from BLE.
         scrollingSpeedCharacteristicBuffer = *((uint16_t *)params->data);
     }
+
+    else if (params->handle == frameCharacteristicHandle)
+    {
+        writeFrame(params->data, params->len);
+    }
+}
+
+/**
+  * Writes a frame received on the frame characteristic into the display image.
+  *
+  * The first byte of the frame is the MicroBitImageFormat of the bitmap that follows, which must match
+  * the dimensions of the display image. The frame is decoded in place, without any heap allocation,
+  * so frames can be streamed at the rate the BLE connection allows.
+  *
+  * @param data The frame.
+  *
+  * @param length The length of the frame, in bytes.
+  */
+void MicroBitLEDService::writeFrame(const uint8_t *data, int length)
+{
+    ImageData *frame = (ImageData *)frameImage;
+    int width = display.image.getWidth();
+    int height = display.image.getHeight();
+
+    // Ignore frames in an unknown format, or that do not exactly cover the display.
+    if (length < 1 || length > MICROBIT_BLE_MAXIMUM_FRAME || data[0] > IMAGE_FORMAT_1BPP || length != 1 + MICROBIT_IMAGE_STRIDE(data[0], width) * height)
+        return;
+
+    frame->width = width;
+    frame->height = height;
+    frame->format = data[0];
+    memcpy(frame->data, data + 1, length - 1);
+
+    // interrupt any animation that might be currently going on
+    display.stopAnimation();
+
+    // The display takes a copy of its image as each frame begins, so a partly written frame is never shown.
+    display.image.paste(MicroBitImage(frame));
 }
 
 /**
@@ -146,6 +194,10 @@ const uint8_t  MicroBitLEDServiceMatrixUUID[] = {
     0xe9,0x5d,0x7b,0x77,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
 };
 
+const uint8_t  MicroBitLEDServiceFrameUUID[] = {
+    0xe9,0x5d,0x7b,0x78,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
+
 const uint8_t  MicroBitLEDServiceTextUUID[] = {
     0xe9,0x5d,0x93,0xee,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
 };
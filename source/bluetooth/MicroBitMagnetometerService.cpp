@@ -104,9 +104,11 @@ void MicroBitMagnetometerService::magnetometerUpdate(MicroBitEvent)
 {
     if (ble.getGapState().connected)
     {
-        magnetometerDataCharacteristicBuffer[0] = compass.getX();
-        magnetometerDataCharacteristicBuffer[1] = compass.getY();
-        magnetometerDataCharacteristicBuffer[2] = compass.getZ();
+        CompassSample s = compass.getSample();
+
+        magnetometerDataCharacteristicBuffer[0] = s.x;
+        magnetometerDataCharacteristicBuffer[1] = s.y;
+        magnetometerDataCharacteristicBuffer[2] = s.z;
         magnetometerPeriodCharacteristicBuffer = compass.getPeriod();
 
         ble.gattServer().write(magnetometerPeriodCharacteristicHandle, (const uint8_t *)&magnetometerPeriodCharacteristicBuffer, sizeof(magnetometerPeriodCharacteristicBuffer));
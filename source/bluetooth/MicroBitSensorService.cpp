@@ -0,0 +1,147 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for the custom MicroBit Sensor Service.
+  * Provides a BLE service that reports the accelerometer, magnetometer and heading together.
+  */
+#include "MicroBitConfig.h"
+#include "ble/UUID.h"
+
+#include "MicroBitSensorService.h"
+#include "MicroBitSystemTimer.h"
+
+/**
+  * Constructor.
+  * Create a representation of the SensorService.
+  * @param _ble The instance of a BLE device that we're running on.
+  * @param _accelerometer An instance of MicroBitAccelerometer.
+  * @param _compass An instance of MicroBitCompass.
+  */
+MicroBitSensorService::MicroBitSensorService(BLEDevice &_ble, MicroBitAccelerometer &_accelerometer, MicroBitCompass &_compass) :
+        ble(_ble), accelerometer(_accelerometer), compass(_compass)
+{
+    // Create the data structures that represent each of our characteristics in Soft Device.
+    GattCharacteristic  sensorDataCharacteristic(MicroBitSensorServiceDataUUID, (uint8_t *)sensorDataCharacteristicBuffer, 0,
+    sizeof(sensorDataCharacteristicBuffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+
+    GattCharacteristic  sensorPeriodCharacteristic(MicroBitSensorServicePeriodUUID, (uint8_t *)&sensorPeriodCharacteristicBuffer, 0,
+    sizeof(sensorPeriodCharacteristicBuffer),
+    GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE);
+
+    // Initialise our characteristic values.
+    memset(sensorDataCharacteristicBuffer, 0, sizeof(sensorDataCharacteristicBuffer));
+    sensorDataCharacteristicBuffer[6] = (int16_t) MICROBIT_SENSOR_SERVICE_NO_HEADING;
+    sensorPeriodCharacteristicBuffer = accelerometer.getPeriod();
+
+    lastUpdate = 0;
+
+    // Set default security requirements
+    sensorDataCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    sensorPeriodCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    GattCharacteristic *characteristics[] = {&sensorDataCharacteristic, &sensorPeriodCharacteristic};
+    GattService         service(MicroBitSensorServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
+
+    ble.addService(service);
+
+    sensorDataCharacteristicHandle = sensorDataCharacteristic.getValueHandle();
+    sensorPeriodCharacteristicHandle = sensorPeriodCharacteristic.getValueHandle();
+
+    ble.gattServer().write(sensorDataCharacteristicHandle, (uint8_t *)sensorDataCharacteristicBuffer, sizeof(sensorDataCharacteristicBuffer));
+    ble.gattServer().write(sensorPeriodCharacteristicHandle, (const uint8_t *)&sensorPeriodCharacteristicBuffer, sizeof(sensorPeriodCharacteristicBuffer));
+
+    ble.onDataWritten(this, &MicroBitSensorService::onDataWritten);
+
+    if (EventModel::defaultEventBus)
+        EventModel::defaultEventBus->listen(MICROBIT_ID_ACCELEROMETER, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE, this, &MicroBitSensorService::sensorUpdate, MESSAGE_BUS_LISTENER_IMMEDIATE);
+}
+
+/**
+  * Callback. Invoked when any of our attributes are written via BLE.
+  */
+void MicroBitSensorService::onDataWritten(const GattWriteCallbackParams *params)
+{
+    if (params->handle == sensorPeriodCharacteristicHandle && params->len >= sizeof(sensorPeriodCharacteristicBuffer))
+    {
+        sensorPeriodCharacteristicBuffer = *((uint16_t *)params->data);
+
+        // The accelerometer drives our updates, so run it no faster than needed.
+        // It will choose the nearest period it can support, which may be shorter than that requested;
+        // sensorUpdate() makes up the difference.
+        accelerometer.setPeriod(sensorPeriodCharacteristicBuffer);
+
+        ble.gattServer().write(sensorPeriodCharacteristicHandle, (const uint8_t *)&sensorPeriodCharacteristicBuffer, sizeof(sensorPeriodCharacteristicBuffer));
+    }
+}
+
+/**
+  * Accelerometer update callback. Samples both sensors and notifies the result,
+  * at most once per period.
+  */
+void MicroBitSensorService::sensorUpdate(MicroBitEvent)
+{
+    if (!ble.getGapState().connected)
+        return;
+
+    uint64_t now = system_timer_current_time();
+
+    if (now - lastUpdate < sensorPeriodCharacteristicBuffer)
+        return;
+
+    lastUpdate = now;
+
+    MMA8653Sample a = accelerometer.getSample();
+    CompassSample m = compass.getSample();
+
+    sensorDataCharacteristicBuffer[0] = a.x;
+    sensorDataCharacteristicBuffer[1] = a.y;
+    sensorDataCharacteristicBuffer[2] = a.z;
+
+    sensorDataCharacteristicBuffer[3] = m.x;
+    sensorDataCharacteristicBuffer[4] = m.y;
+    sensorDataCharacteristicBuffer[5] = m.z;
+
+    // heading() would start an interactive calibration on an uncalibrated compass, so only ask once it has one.
+    // Its tilt compensation reuses the accelerometer sample read above.
+    if (compass.isCalibrated())
+        sensorDataCharacteristicBuffer[6] = compass.heading();
+    else
+        sensorDataCharacteristicBuffer[6] = (int16_t) MICROBIT_SENSOR_SERVICE_NO_HEADING;
+
+    ble.gattServer().notify(sensorDataCharacteristicHandle, (uint8_t *)sensorDataCharacteristicBuffer, sizeof(sensorDataCharacteristicBuffer));
+}
+
+const uint8_t  MicroBitSensorServiceUUID[] = {
+    0xe9,0x5d,0x5a,0x00,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
+
+const uint8_t  MicroBitSensorServiceDataUUID[] = {
+    0xe9,0x5d,0x5a,0x01,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
+
+const uint8_t  MicroBitSensorServicePeriodUUID[] = {
+    0xe9,0x5d,0x5a,0x02,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
@@ -34,22 +34,104 @@ DEALINGS IN THE SOFTWARE.
 #include "ExternalEvents.h"
 #include "MicroBitUARTService.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitCompat.h"
 #include "ErrorNo.h"
 #include "NotifyEvents.h"
 
-static uint8_t txBufferHead = 0;
-static uint8_t txBufferTail = 0;
+// Bytes awaiting transmission to, or confirmation by, the connected device. These are appended by send(), and consumed by on_confirmation().
+static MicroBitRingBuffer<uint8_t> txBuff;
 
 static GattCharacteristic* txCharacteristic = NULL;
+static BLEDevice* txDevice = NULL;
+
+// The number of bytes at the head of txBuff carried by the indication awaiting confirmation, or -1 whilst one is being sent.
+static volatile int txInFlight = 0;
+
+// The largest number of bytes to place in one indication.
+static int txPayload = MICROBIT_UART_S_MAX_PAYLOAD;
+
+// If non zero, the longest time small writes may be held back to coalesce them, in milliseconds.
+static int txCoalesceDelay = 0;
+
+// The time at which the oldest unsent byte was buffered, and whether bytes should now be sent without waiting for more.
+static volatile uint32_t txOldest = 0;
+static volatile bool txFlush = false;
+
+/**
+  * Sends the next indication from txBuff, if none is already awaiting confirmation and we have enough to send.
+  *
+  * @note This may be called from both fibers and the Bluetooth event handler.
+  */
+static void send_pending()
+{
+    int size = txBuff.size();
+
+    if(size == 0 || (txCoalesceDelay > 0 && size < txPayload && !txFlush))
+        return;
+
+    // Claim the right to send. We cannot hold interrupts off over the call into the Bluetooth stack.
+    __disable_irq();
+
+    if(txInFlight != 0)
+    {
+        __enable_irq();
+        return;
+    }
+
+    txInFlight = -1;
+
+    __enable_irq();
+
+    int len = min(size, txPayload);
+
+    uint8_t temp[len];
+
+    // Only on_confirmation() removes from txBuff, and only once this indication is confirmed.
+    for(int i = 0; i < len; i++)
+        txBuff.peek(temp[i], i);
+
+    if(txDevice->gattServer().write(txCharacteristic->getValueAttribute().getHandle(), temp, len) == BLE_ERROR_NONE)
+        txInFlight = len;
+    else
+        txInFlight = 0;
+}
 
 /**
   * A callback function for whenever a Bluetooth device consumes our TX Buffer
   */
 void on_confirmation(uint16_t handle)
 {
-    if(handle == txCharacteristic->getValueAttribute().getHandle())
+    if(handle == txCharacteristic->getValueAttribute().getHandle() && txInFlight > 0)
     {
-        txBufferTail = txBufferHead;
+        txBuff.pop(NULL, txInFlight);
+        txInFlight = 0;
+
+        if(txBuff.isEmpty())
+        {
+            txFlush = false;
+            MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY);
+        }
+        else
+        {
+            // Keep the link busy with whatever remains.
+            send_pending();
+        }
+    }
+}
+
+/**
+  * A callback function for whenever the connected device goes away. Any bytes still to be sent are
+  * discarded, and fibers waiting for their confirmation are released.
+  */
+static void on_disconnection(const Gap::DisconnectionCallbackParams_t *)
+{
+    if(!txBuff.isEmpty() || txInFlight != 0)
+    {
+        txBuff.clear();
+        txInFlight = 0;
+        txFlush = false;
+
         MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY);
     }
 }
@@ -64,23 +146,23 @@ void on_confirmation(uint16_t handle)
  */
 MicroBitUARTService::MicroBitUARTService(BLEDevice &_ble, uint8_t rxBufferSize, uint8_t txBufferSize) : ble(_ble)
 {
-    rxBufferSize += 1;
-    txBufferSize += 1;
-
-    txBuffer = (uint8_t *)malloc(txBufferSize);
-    rxBuffer = (uint8_t *)malloc(rxBufferSize);
+    rxBuff.resize(rxBufferSize);
+    txBuff.resize(txBufferSize);
 
-    rxBufferHead = 0;
-    rxBufferTail = 0;
     this->rxBufferSize = rxBufferSize;
-
-    txBufferHead = 0;
-    txBufferTail = 0;
     this->txBufferSize = txBufferSize;
 
-    GattCharacteristic rxCharacteristic(UARTServiceRXCharacteristicUUID, rxBuffer, 1, rxBufferSize, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE);
+    this->rxBuffHeadMatch = -1;
+
+    // The initial value of each characteristic is copied by the Bluetooth stack when the service is added.
+    uint8_t initialValue = 0;
+
+    GattCharacteristic rxCharacteristic(UARTServiceRXCharacteristicUUID, &initialValue, 1, rxBufferSize, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE);
 
-    txCharacteristic = new GattCharacteristic(UARTServiceTXCharacteristicUUID, txBuffer, 1, txBufferSize, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE);
+    txDevice = &_ble;
+    txPayload = min(txBufferSize, MICROBIT_UART_S_MAX_PAYLOAD);
+
+    txCharacteristic = new GattCharacteristic(UARTServiceTXCharacteristicUUID, &initialValue, 1, txBufferSize, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE);
 
     GattCharacteristic *charTable[] = {txCharacteristic, &rxCharacteristic};
 
@@ -92,6 +174,9 @@ MicroBitUARTService::MicroBitUARTService(BLEDevice &_ble, uint8_t rxBufferSize,
 
     _ble.gattServer().onDataWritten(this, &MicroBitUARTService::onDataWritten);
     _ble.gattServer().onConfirmationReceived(on_confirmation);
+    _ble.gap().onDisconnection(on_disconnection);
+
+    fiber_add_idle_component(this);
 }
 
 /**
@@ -104,9 +189,7 @@ void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
 
         for(int byteIterator = 0; byteIterator <  bytesWritten; byteIterator++)
         {
-            int newHead = (rxBufferHead + 1) % rxBufferSize;
-
-            if(newHead != rxBufferTail)
+            if(!rxBuff.isFull())
             {
                 char c = params->data[byteIterator];
 
@@ -123,11 +206,9 @@ void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
                     delimeterOffset++;
                 }
 
-                rxBuffer[rxBufferHead] = c;
+                rxBuff.push(c);
 
-                rxBufferHead = newHead;
-
-                if(rxBufferHead == rxBuffHeadMatch)
+                if(rxBuffHeadMatch >= 0 && rxBuff.size() >= rxBuffHeadMatch)
                 {
                     rxBuffHeadMatch = -1;
                     MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_HEAD_MATCH);
@@ -139,30 +220,6 @@ void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
     }
 }
 
-/**
-  * An internal method that copies values from a circular buffer to a linear buffer.
-  *
-  * @param circularBuff a pointer to the source circular buffer
-  * @param circularBuffSize the size of the circular buffer
-  * @param linearBuff a pointer to the destination linear buffer
-  * @param tailPosition the tail position in the circular buffer you want to copy from
-  * @param headPosition the head position in the circular buffer you want to copy to
-  *
-  * @note this method assumes that the linear buffer has the appropriate amount of
-  *       memory to contain the copy operation
-  */
-void MicroBitUARTService::circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition)
-{
-    int toBuffIndex = 0;
-
-    while(tailPosition != headPosition)
-    {
-        linearBuff[toBuffIndex++] = circularBuff[tailPosition];
-
-        tailPosition = (tailPosition + 1) % circularBuffSize;
-    }
-}
-
 /**
   * Retreives a single character from our RxBuffer.
   *
@@ -195,9 +252,9 @@ int MicroBitUARTService::getc(MicroBitSerialMode mode)
             eventAfter(1, mode);
     }
 
-    char c = rxBuffer[rxBufferTail];
+    uint8_t c = 0;
 
-    rxBufferTail = (rxBufferTail + 1) % rxBufferSize;
+    rxBuff.pop(c);
 
     return c;
 }
@@ -263,33 +320,19 @@ int MicroBitUARTService::send(const uint8_t *buf, int length, MicroBitSerialMode
 
     while(bytesWritten < length && ble.getGapState().connected && updatesEnabled)
     {
-        for(int bufferIterator = bytesWritten; bufferIterator < length; bufferIterator++)
-        {
-            int nextHead = (txBufferHead + 1) % txBufferSize;
-
-            if(nextHead != txBufferTail)
-            {
-                txBuffer[txBufferHead] = buf[bufferIterator];
-
-                txBufferHead = nextHead;
-
-                bytesWritten++;
-            }
-        }
-
-        int size = txBufferedSize();
-
-        uint8_t temp[size];
-
-        memclr(&temp, size);
-
-        circularCopy(txBuffer, txBufferSize, temp, txBufferTail, txBufferHead);
+        if(txBuff.isEmpty())
+            txOldest = (uint32_t) system_timer_current_time();
 
+        bytesWritten += txBuff.push(buf + bytesWritten, length - bytesWritten);
 
+        // If we are going to wait for confirmation, there's no point holding anything back.
         if(mode == SYNC_SLEEP)
+        {
+            txFlush = true;
             fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY);
+        }
 
-        ble.gattServer().write(txCharacteristic->getValueAttribute().getHandle(), temp, size);
+        send_pending();
 
         if(mode == SYNC_SLEEP)
             schedule();
@@ -433,22 +476,21 @@ ManagedString MicroBitUARTService::readUntil(ManagedString delimeters, MicroBitS
     if(mode == SYNC_SPINWAIT)
         return MICROBIT_INVALID_PARAMETER;
 
-    int localTail = rxBufferTail;
-    int preservedTail = rxBufferTail;
+    //offsets are relative to the oldest character in our buffer, so are unaffected by incoming data.
+    int localOffset = 0;
 
     int foundIndex = -1;
 
+    uint8_t c;
+
     //ASYNC mode just iterates through our stored characters checking for any matches.
-    while(localTail != rxBufferHead && foundIndex  == -1)
+    while(foundIndex == -1 && rxBuff.peek(c, localOffset) == MICROBIT_OK)
     {
-        //we use localTail to prevent modification of the actual tail.
-        char c = rxBuffer[localTail];
-
         for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
             if(delimeters.charAt(delimeterIterator) == c)
-                foundIndex = localTail;
+                foundIndex = localOffset;
 
-        localTail = (localTail + 1) % rxBufferSize;
+        localOffset++;
     }
 
     //if our mode is SYNC_SLEEP, we set up an event to be fired when we see a
@@ -457,24 +499,24 @@ ManagedString MicroBitUARTService::readUntil(ManagedString delimeters, MicroBitS
     {
         eventOn(delimeters, mode);
 
-        foundIndex = rxBufferHead - 1;
+        foundIndex = rxBuff.size() - 1;
 
         this->delimeters = ManagedString();
     }
 
     if(foundIndex >= 0)
     {
-        //calculate our local buffer size
-        int localBuffSize = (preservedTail > foundIndex) ? (rxBufferSize - preservedTail) + foundIndex : foundIndex - preservedTail;
+        //our local buffer holds everything before the matching character
+        int localBuffSize = foundIndex;
 
         uint8_t localBuff[localBuffSize + 1];
 
         memclr(&localBuff, localBuffSize + 1);
 
-        circularCopy(rxBuffer, rxBufferSize, localBuff, preservedTail, foundIndex);
+        rxBuff.pop(localBuff, localBuffSize);
 
-        //plus one for the character we listened for...
-        rxBufferTail = (rxBufferTail + localBuffSize + 1) % rxBufferSize;
+        //discard the character we listened for...
+        rxBuff.pop(NULL, 1);
 
         return ManagedString((char *)localBuff, localBuffSize);
     }
@@ -537,7 +579,7 @@ int MicroBitUARTService::eventAfter(int len, MicroBitSerialMode mode)
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->rxBuffHeadMatch = (rxBufferHead + len) % rxBufferSize;
+    this->rxBuffHeadMatch = rxBuff.size() + len;
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -556,7 +598,7 @@ int MicroBitUARTService::eventAfter(int len, MicroBitSerialMode mode)
   */
 int MicroBitUARTService::isReadable()
 {
-    return (rxBufferTail != rxBufferHead) ? 1 : 0;
+    return rxBuff.isEmpty() ? 0 : 1;
 }
 
 /**
@@ -564,10 +606,7 @@ int MicroBitUARTService::isReadable()
   */
 int MicroBitUARTService::rxBufferedSize()
 {
-    if(rxBufferTail > rxBufferHead)
-        return (rxBufferSize - rxBufferTail) + rxBufferHead;
-
-    return rxBufferHead - rxBufferTail;
+    return rxBuff.size();
 }
 
 /**
@@ -575,8 +614,56 @@ int MicroBitUARTService::rxBufferedSize()
   */
 int MicroBitUARTService::txBufferedSize()
 {
-    if(txBufferTail > txBufferHead)
-        return (txBufferSize - txBufferTail) + txBufferHead;
+    return txBuff.size();
+}
+
+/**
+  * @return The number of bytes that may be added to our txBuff without waiting.
+  */
+int MicroBitUARTService::txBufferFree()
+{
+    return txBuff.capacity() - txBuff.size();
+}
+
+/**
+  * Configures the coalescing of small writes into fewer, fuller indications.
+  *
+  * When enabled, bytes given to send() in ASYNC mode are held back until enough have accumulated
+  * to fill an indication, or until the oldest of them has waited for the given delay.
+  * This trades a little latency for many fewer indications when sending small amounts of data,
+  * such as with putc(). Sends in SYNC_SLEEP mode are always transmitted immediately.
+  *
+  * @param delay the longest time a byte may be held back, in milliseconds, or 0 to send every write
+  *        immediately (the default).
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if delay is negative.
+  */
+int MicroBitUARTService::setCoalescing(int delay)
+{
+    if(delay < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    txCoalesceDelay = delay;
+
+    // Anything held back under the old setting should go now.
+    if(delay == 0)
+        send_pending();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Periodic callback from MicroBit idle thread.
+  * Sends any coalesced bytes that have waited for longer than the configured delay, and retries
+  * any indication the Bluetooth stack was previously unable to accept.
+  */
+void MicroBitUARTService::idleTick()
+{
+    if(txBuff.isEmpty() || txInFlight != 0)
+        return;
+
+    if(txCoalesceDelay > 0 && (uint32_t) system_timer_current_time() - txOldest >= (uint32_t) txCoalesceDelay)
+        txFlush = true;
 
-    return txBufferHead - txBufferTail;
+    send_pending();
 }
@@ -37,16 +37,6 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MemberFunctionCallback.h"
 
-/**
-  * Calls the method reference held by this MemberFunctionCallback.
-  *
-  * @param e The event to deliver to the method
-  */
-void MemberFunctionCallback::fire(MicroBitEvent e)
-{
-    invoke(object, method, e);
-}
-
 /**
   * A comparison of two MemberFunctionCallback objects.
   *
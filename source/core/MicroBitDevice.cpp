@@ -60,6 +60,12 @@ static const uint8_t panicFace[5] = {0x1B, 0x1B,0x0,0x0E,0x11};
 static int panic_timeout = 0;
 static uint32_t random_value = 0;
 
+#if MICROBIT_RANDOM_POOL_SIZE > 0
+static uint8_t random_pool[MICROBIT_RANDOM_POOL_SIZE];     // Hardware entropy, waiting to be used.
+static volatile uint8_t random_pool_length = 0;             // The number of bytes in random_pool.
+static bool random_pool_enabled = false;                    // Cleared when explicitly seeded, so that sequences are repeatable.
+#endif
+
 /**
   * Determines if a BLE stack is currently running.
   *
@@ -267,6 +273,95 @@ void microbit_panic(int statusCode)
     microbit_reset();
 }
 
+#if MICROBIT_RANDOM_POOL_SIZE > 0
+/**
+  * Interrupt handler for the hardware random number generator.
+  * Adds each byte generated to the pool, and stops the generator once the pool is full, to save power.
+  */
+extern "C" void RNG_IRQHandler()
+{
+    NRF_RNG->EVENTS_VALRDY = 0;
+
+    if (random_pool_length < MICROBIT_RANDOM_POOL_SIZE)
+        random_pool[random_pool_length++] = NRF_RNG->VALUE;
+
+    if (random_pool_length >= MICROBIT_RANDOM_POOL_SIZE)
+    {
+        NRF_RNG->TASKS_STOP = 1;
+        NRF_RNG->INTENCLR = RNG_INTENCLR_VALRDY_Msk;
+        NVIC_DisableIRQ(RNG_IRQn);
+    }
+}
+
+/**
+  * Starts refilling the entropy pool, without waiting for it to fill.
+  */
+static void random_pool_fill()
+{
+    if (ble_running())
+    {
+        // If Bluetooth is enabled, the SoftDevice owns the generator and keeps its own pool. Take what it has.
+        uint8_t available = 0;
+
+        sd_rand_application_bytes_available_get(&available);
+
+        __disable_irq();
+
+        int length = random_pool_length;
+
+        if (available > MICROBIT_RANDOM_POOL_SIZE - length)
+            available = MICROBIT_RANDOM_POOL_SIZE - length;
+
+        if (available > 0 && sd_rand_application_vector_get(&random_pool[length], available) == NRF_SUCCESS)
+            random_pool_length = length + available;
+
+        __enable_irq();
+    }
+    else
+    {
+        // Otherwise, run the generator with bias correction, and collect its output by interrupt.
+        NRF_RNG->CONFIG = RNG_CONFIG_DERCEN_Msk;
+        NRF_RNG->EVENTS_VALRDY = 0;
+        NRF_RNG->INTENSET = RNG_INTENSET_VALRDY_Msk;
+        NVIC_ClearPendingIRQ(RNG_IRQn);
+        NVIC_EnableIRQ(RNG_IRQn);
+        NRF_RNG->TASKS_START = 1;
+    }
+}
+
+/**
+  * Takes four bytes of hardware entropy from the pool, if there are that many, and starts refilling the
+  * pool once it is half empty.
+  *
+  * @param value Set to the entropy taken.
+  *
+  * @return true if the entropy was available, false otherwise.
+  */
+static bool random_pool_take(uint32_t &value)
+{
+    bool taken = false;
+
+    __disable_irq();
+
+    if (random_pool_length >= 4)
+    {
+        random_pool_length -= 4;
+        uint8_t *b = &random_pool[random_pool_length];
+        value = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24);
+        taken = true;
+    }
+
+    bool low = random_pool_length <= MICROBIT_RANDOM_POOL_SIZE / 2;
+
+    __enable_irq();
+
+    if (low)
+        random_pool_fill();
+
+    return taken;
+}
+#endif
+
 /**
   * Generate a random number in the given range.
   * We use a simple Galois LFSR random number generator here,
@@ -274,6 +369,9 @@ void microbit_panic(int statusCode)
   * than the hardware random number generator built int the processor, which takes
   * a long time and uses a lot of energy.
   *
+  * Unless seeded with a given value, the LFSR is stirred on each call with entropy that the hardware
+  * generator collects in the background, while any is available. See MICROBIT_RANDOM_POOL_SIZE.
+  *
   * KIDS: You shouldn't use this is the real world to generte cryptographic keys though...
   * have a think why not. :-)
   *
@@ -292,6 +390,20 @@ int microbit_random(int max)
     if(max <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
+#if MICROBIT_RANDOM_POOL_SIZE > 0
+    // Mix in hardware entropy while we have it. If the pool has run dry, the LFSR carries on alone.
+    uint32_t entropy;
+
+    if (random_pool_enabled && random_pool_take(entropy))
+    {
+        random_value ^= entropy;
+
+        // The LFSR must never be zero.
+        if (random_value == 0)
+            random_value = 0xBBC5EED;
+    }
+#endif
+
     // Our maximum return value is actually one less than passed
     max--;
 
@@ -350,6 +462,12 @@ void microbit_seed_random()
     {
         // Othwerwise we can access the hardware RNG directly.
 
+#if MICROBIT_RANDOM_POOL_SIZE > 0
+        // Poll the generator here, rather than letting the pool's interrupt handler take its output.
+        NRF_RNG->INTENCLR = RNG_INTENCLR_VALRDY_Msk;
+        NVIC_DisableIRQ(RNG_IRQn);
+#endif
+
         // Start the Random number generator. No need to leave it running... I hope. :-)
         NRF_RNG->TASKS_START = 1;
 
@@ -367,15 +485,27 @@ void microbit_seed_random()
         // Disable the generator to save power.
         NRF_RNG->TASKS_STOP = 1;
     }
+
+#if MICROBIT_RANDOM_POOL_SIZE > 0
+    // Keep drawing on hardware entropy from now on.
+    random_pool_enabled = true;
+    random_pool_fill();
+#endif
 }
 
 /**
   * Seed the pseudo random number generator (RNG) using the given 32-bit value.
-  * This function does not use the NRF51822's in built cryptographic random number generator.
+  * This function does not use the NRF51822's in built cryptographic random number generator,
+  * and no hardware entropy is mixed into the sequence that follows.
   *
   * @param seed The value to use as a seed.
   */
 void microbit_seed_random(uint32_t seed)
 {
     random_value = seed;
+
+#if MICROBIT_RANDOM_POOL_SIZE > 0
+    // The caller expects the sequence that follows from this seed, so stop mixing in hardware entropy.
+    random_pool_enabled = false;
+#endif
 }
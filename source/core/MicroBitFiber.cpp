@@ -34,6 +34,10 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitFiber.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitDevice.h"
+#include "MicroBitTrace.h"
+#include "MicroBitHeapArena.h"
+#include "nrf_soc.h"
 
 /*
  * Statically allocated values used to create and destroy Fibers.
@@ -41,14 +45,16 @@ DEALINGS IN THE SOFTWARE.
  */
 Fiber *currentFiber = NULL;                        // The context in which the current fiber is executing.
 static Fiber *forkedFiber = NULL;                  // The context in which a newly created child fiber is executing.
+static MicroBitHeapArena *forkArena = NULL;         // The arenas of the current fiber when it entered fork on block mode.
 static Fiber *idleFiber = NULL;                    // the idle task - performs a power efficient sleep, and system maintenance tasks.
+volatile bool fiber_yield_requested = false;       // Set once the current fiber has overrun its time slice while other fibers are runnable.
 
 /*
  * Scheduler state.
  */
-static Fiber *runQueue = NULL;                     // The list of runnable fibers.
+static Fiber *runQueue[MICROBIT_FIBER_PRIORITY_LEVELS];    // The lists of runnable fibers, indexed by priority.
 static Fiber *sleepQueue = NULL;                   // The list of blocked fibers waiting on a fiber_sleep() operation.
-static Fiber *waitQueue = NULL;                    // The list of blocked fibers waiting on an event.
+static Fiber *waitQueue[MICROBIT_FIBER_WAIT_BUCKETS];  // The lists of blocked fibers waiting on an event, hashed by event ID.
 static Fiber *fiberPool = NULL;                    // Pool of unused fibers, just waiting for a job to do.
 
 /*
@@ -56,14 +62,83 @@ static Fiber *fiberPool = NULL;                    // Pool of unused fibers, jus
  */
 static uint8_t fiber_flags = 0;
 
+/*
+ * The priority given to the fiber created if a fork on block operation blocks.
+ */
+static uint8_t forkPriority = MICROBIT_FIBER_PRIORITY_NORMAL;
+
 
 /*
  * Fibers may perform wait/notify semantics on events. If set, these operations will be permitted on this EventModel.
  */
 static EventModel *messageBus = NULL;
 
-// Array of components which are iterated during idle thread execution.
-static MicroBitComponent* idleThreadComponents[MICROBIT_IDLE_COMPONENTS];
+// Determines the priority of a fiber, and the run queue on which it is held when runnable.
+#define FIBER_PRIORITY(f)       (((f)->flags & MICROBIT_FIBER_FLAG_PRIORITY_MASK) >> MICROBIT_FIBER_FLAG_PRIORITY_SHIFT)
+#define FIBER_RUN_QUEUE(f)      (&runQueue[FIBER_PRIORITY(f)])
+
+// Determines the wait queue on which fibers blocked on an event with the given ID are held.
+#define FIBER_WAIT_QUEUE(id)    (&waitQueue[(id) & (MICROBIT_FIBER_WAIT_BUCKETS - 1)])
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+// Lists of unused stack buffers, indexed by size class. The first word of each refers to the next buffer in the list.
+static uint32_t *stackPool[MICROBIT_FIBER_STACK_POOL_CLASSES];
+static uint8_t stackPoolDepth[MICROBIT_FIBER_STACK_POOL_CLASSES];
+#endif
+
+// Determines the buffer a fiber's stack is copied to and from on a context switch.
+// Fibers with a dedicated stack run in place, so have no stack to copy.
+#define FIBER_STACK_BUFFER(f)   ((f)->flags & MICROBIT_FIBER_FLAG_DEDICATED_STACK ? 0 : (f)->stack_top)
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+static uint64_t fiber_switch_time = 0;              // The time at which the current fiber was scheduled in.
+static uint64_t idle_time = 0;                      // The time spent in the idle task during the current measurement period.
+static uint64_t idle_period_start = 0;              // The time at which the current measurement period began.
+static uint32_t invoke_count = 0;                   // The number of functions executed through invoke().
+static uint32_t invoke_fork_count = 0;              // The number of those functions that were given a fiber of their own.
+static IdleStateStats idle_state_stats[MICROBIT_IDLE_STATES];  // The time spent in each idle state during the current measurement period.
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_IDLE_GOVERNOR)
+static uint8_t idle_power_mode = MICROBIT_IDLE_STATE_LOW_POWER;    // The System ON sub mode currently selected. Low power from reset.
+#endif
+static uint8_t idle_holds = 0;                      // The number of components requiring the high frequency crystal while idle.
+
+#if MICROBIT_FIBER_TIME_SLICE > 0
+static uint32_t slice_start = 0;                    // The time at which the current fiber's time slice began, in milliseconds.
+#endif
+
+/**
+  * A component registered to be called from the idle task.
+  */
+struct IdleComponent
+{
+    MicroBitComponent *component;   // The component, or NULL if this entry is unused.
+    uint32_t due;                   // The time at which the component is next due, in milliseconds, for those called at an interval.
+    uint16_t interval;              // The time between calls, in milliseconds, or MICROBIT_IDLE_EVERY_PASS or MICROBIT_IDLE_ON_DEMAND.
+    uint8_t pending;                // Set by fiber_wake_idle_component() to request a call on the next idle pass.
+};
+
+// The registry of components which are called during idle thread execution. Grows as required.
+static IdleComponent *idleComponents = NULL;
+static int idleComponentCapacity = 0;
+
+#if MICROBIT_FIBER_DEFER_QUEUE_SIZE > 0
+/**
+  * A piece of work deferred to the idle task by fiber_defer().
+  */
+struct FiberDeferredWork
+{
+    void    (*fn)(void *);
+    void    *arg;
+};
+
+// Ring of deferred work. The indices run freely, and are masked to index the ring.
+// Only interrupt handlers (and fiber_defer()) advance the head, and only the idle task advances the tail.
+static FiberDeferredWork deferQueue[MICROBIT_FIBER_DEFER_QUEUE_SIZE];
+static volatile uint16_t deferHead = 0;
+static volatile uint16_t deferTail = 0;
+#endif
 
 /**
   * Utility function to add the currenty running fiber to the given queue.
@@ -89,17 +164,27 @@ void queue_fiber(Fiber *f, Fiber **queue)
     if (*queue == NULL)
     {
         f->next = NULL;
+#if CONFIG_ENABLED(MICROBIT_FIBER_QUEUE_TAIL)
+        f->prev = f;
+#else
         f->prev = NULL;
+#endif
         *queue = f;
     }
     else
     {
+#if CONFIG_ENABLED(MICROBIT_FIBER_QUEUE_TAIL)
+        // The prev field of the head of the queue refers to the tail of the queue.
+        Fiber *last = (*queue)->prev;
+        (*queue)->prev = f;
+#else
         // Scan to the end of the queue.
         // We don't maintain a tail pointer to save RAM (queues are nrmally very short).
         Fiber *last = *queue;
 
         while (last->next != NULL)
             last = last->next;
+#endif
 
         last->next = f;
         f->prev = last;
@@ -109,6 +194,73 @@ void queue_fiber(Fiber *f, Fiber **queue)
     __enable_irq();
 }
 
+/**
+  * Utility function to add the given fiber to a queue that is held in ascending order of
+  * its fibers' context field. Fibers with an equal context retain FIFO ordering.
+  *
+  * This is used to maintain the sleep queue ordered by wakeup time, such that the system timer
+  * need only inspect the head of the queue on each tick.
+  *
+  * @param f The fiber to add to the queue
+  *
+  * @param queue The queue to add the fiber to.
+  */
+void queue_fiber_ordered(Fiber *f, Fiber **queue)
+{
+    __disable_irq();
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_QUEUE_TAIL)
+    // Fibers are commonly added with the latest context in the queue (e.g. sleeps of similar periods),
+    // in which case we can simply add to the tail.
+    if (*queue == NULL || (*queue)->prev->context <= f->context)
+    {
+        __enable_irq();
+        queue_fiber(f, queue);
+        return;
+    }
+#endif
+
+    // Record which queue this fiber is on.
+    f->queue = queue;
+
+    // Find the last fiber that should be woken no later than this one.
+    Fiber *prev = NULL;
+    Fiber *next = *queue;
+
+    while (next != NULL && next->context <= f->context)
+    {
+        prev = next;
+        next = next->next;
+    }
+
+    f->next = next;
+
+    if (prev == NULL)
+    {
+#if CONFIG_ENABLED(MICROBIT_FIBER_QUEUE_TAIL)
+        // We're the new head of the queue, so inherit the reference to the tail.
+        f->prev = next != NULL ? next->prev : f;
+#else
+        f->prev = NULL;
+#endif
+        *queue = f;
+    }
+    else
+    {
+        f->prev = prev;
+        prev->next = f;
+    }
+
+    if (next != NULL)
+        next->prev = f;
+#if CONFIG_ENABLED(MICROBIT_FIBER_QUEUE_TAIL)
+    else
+        (*queue)->prev = f;
+#endif
+
+    __enable_irq();
+}
+
 /**
   * Utility function to the given fiber from whichever queue it is currently stored on.
   *
@@ -123,6 +275,27 @@ void dequeue_fiber(Fiber *f)
     // Remove this fiber fromm whichever queue it is on.
     __disable_irq();
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_QUEUE_TAIL)
+    Fiber *head = *(f->queue);
+
+    if (f == head)
+    {
+        // The new head of the queue (if any) inherits the reference to the tail.
+        *(f->queue) = f->next;
+
+        if(f->next)
+            f->next->prev = f->prev;
+    }
+    else
+    {
+        f->prev->next = f->next;
+
+        if(f->next)
+            f->next->prev = f->prev;
+        else
+            head->prev = f->prev;
+    }
+#else
     if (f->prev != NULL)
         f->prev->next = f->next;
     else
@@ -130,6 +303,7 @@ void dequeue_fiber(Fiber *f)
 
     if(f->next)
         f->next->prev = f->prev;
+#endif
 
     f->next = NULL;
     f->prev = NULL;
@@ -158,7 +332,10 @@ Fiber *getFiberContext()
     {
         __enable_irq();
 
+        // Fiber contexts are reused long after any arena of the current fiber is destroyed, so always use the heap.
+        MicroBitHeapArena::suspend();
         f = new Fiber();
+        MicroBitHeapArena::resume();
 
         if (f == NULL)
             return NULL;
@@ -168,8 +345,16 @@ Fiber *getFiberContext()
     }
 
     // Ensure this fiber is in suitable state for reuse.
-    f->flags = 0;
+    // New fibers take the priority of the fiber that created them.
+    f->flags = (currentFiber ? FIBER_PRIORITY(currentFiber) : MICROBIT_FIBER_PRIORITY_NORMAL) << MICROBIT_FIBER_FLAG_PRIORITY_SHIFT;
     f->tcb.stack_base = CORTEX_M0_STACK_BASE;
+    f->arena = NULL;
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+    f->stats.run_time = 0;
+    f->stats.switches = 0;
+    f->stats.max_stack = 0;
+#endif
 
     return f;
 }
@@ -197,7 +382,7 @@ void scheduler_init(EventModel &_messageBus)
     currentFiber = getFiberContext();
 
     // Add ourselves to the run queue.
-    queue_fiber(currentFiber, &runQueue);
+    queue_fiber(currentFiber, FIBER_RUN_QUEUE(currentFiber));
 
     // Create the IDLE fiber.
     // Configure the fiber to directly enter the idle task.
@@ -213,7 +398,17 @@ void scheduler_init(EventModel &_messageBus)
 	}
 
 	// register a period callback to drive the scheduler and any other registered components.
+    // In tickless mode, the scheduler only needs to run when the next sleeping fiber is due.
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    new MicroBitSystemTimerCallback(scheduler_tick, MICROBIT_SYSTEM_TICK_ON_DEMAND);
+#else
     new MicroBitSystemTimerCallback(scheduler_tick);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+    fiber_switch_time = system_timer_current_time_us();
+    idle_period_start = fiber_switch_time;
+#endif
 
 	fiber_flags |= MICROBIT_SCHEDULER_RUNNING;
 }
@@ -231,53 +426,145 @@ int fiber_scheduler_running()
 	return 0;
 }
 
+#if MICROBIT_FIBER_TIME_SLICE > 0
+/**
+  * Determines if any fiber other than the current fiber is waiting to run at the same or a higher priority.
+  *
+  * @return true if the current fiber should yield when its time slice expires, false otherwise.
+  */
+static bool scheduler_contended()
+{
+    for (int i = MICROBIT_FIBER_PRIORITY_LEVELS - 1; i >= 0; i--)
+        if (runQueue[i] != NULL)
+            return currentFiber->queue != &runQueue[i] || runQueue[i] != currentFiber || currentFiber->next != NULL;
+
+    return false;
+}
+
+/**
+  * Begins the time slice of the fiber just chosen to run.
+  */
+static void scheduler_start_slice()
+{
+    fiber_yield_requested = false;
+    slice_start = (uint32_t) system_timer_current_time();
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    // Ensure the scheduler is called when the slice expires, as other fibers are already waiting.
+    // Fibers made runnable later are noticed at the next timer interrupt.
+    if (currentFiber != idleFiber && scheduler_contended())
+        system_timer_wake_at(slice_start + MICROBIT_FIBER_TIME_SLICE);
+#endif
+}
+#endif
+
 /**
   * The timer callback, called from interrupt context once every SYSTEM_TICK_PERIOD_MS milliseconds.
   * This function checks to determine if any fibers blocked on the sleep queue need to be woken up
-  * and made runnable.
+  * and made runnable, and whether the current fiber has overrun its time slice.
   */
 void scheduler_tick()
 {
-    Fiber *f = sleepQueue;
-    Fiber *t;
+    uint32_t now = system_timer_current_time();
 
-    // Check the sleep queue, and wake up any fibers as necessary.
-    while (f != NULL)
+#if MICROBIT_FIBER_TIME_SLICE > 0
+    // Ask the current fiber to yield at its next opportunity, if it has held the processor for too long
+    // while others are waiting.
+    if (!fiber_yield_requested && currentFiber != idleFiber && now - slice_start >= MICROBIT_FIBER_TIME_SLICE && scheduler_contended())
+        fiber_yield_requested = true;
+#endif
+
+    // Nothing more to do if no fibers are sleeping.
+    if (sleepQueue == NULL)
+        return;
+
+    // The sleep queue is held in order of wakeup time, so we need only wake fibers from the
+    // head of the queue until we find one that is not yet due.
+    while (sleepQueue != NULL && now >= sleepQueue->context)
     {
-        t = f->next;
+        // Wakey wakey!
+        Fiber *f = sleepQueue;
+        dequeue_fiber(f);
+        queue_fiber(f, FIBER_RUN_QUEUE(f));
+    }
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    // Ensure we're called again when the next sleeping fiber is due.
+    if (sleepQueue != NULL)
+        system_timer_wake_at(sleepQueue->context);
+#endif
+}
+
+/**
+  * Determines if any fiber on the given wait queue is blocked on the given event context.
+  *
+  * @param queue The wait queue to search.
+  *
+  * @param context The encoded event ID and value to search for.
+  *
+  * @return true if a fiber on the queue is blocked on the given context, false otherwise.
+  */
+static bool fiber_waiting_on(Fiber *queue, uint32_t context)
+{
+    for (Fiber *f = queue; f != NULL; f = f->next)
+        if (f->context == context)
+            return true;
+
+    return false;
+}
+
+/**
+  * Removes the listener registered on behalf of fibers waiting on the given event ID and value.
+  *
+  * @param id The event ID the listener was registered with.
+  *
+  * @param value The event value the listener was registered with.
+  */
+static void scheduler_release_listener(uint16_t id, uint16_t value)
+{
+    messageBus->ignore(id, value, scheduler_event);
 
-        if (system_timer_current_time() >= f->context)
+    // A wildcard removal also marks listeners held on behalf of other fibers for deletion,
+    // so reinstate any that are still required.
+    if (id == MICROBIT_ID_ANY || value == MICROBIT_EVT_ANY)
+    {
+        if (id == MICROBIT_ID_ANY)
         {
-            // Wakey wakey!
-            dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
+            messageBus->listen(MICROBIT_ID_NOTIFY, MICROBIT_EVT_ANY, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+            messageBus->listen(MICROBIT_ID_NOTIFY_ONE, MICROBIT_EVT_ANY, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
         }
 
-        f = t;
+        for (int i = 0; i < MICROBIT_FIBER_WAIT_BUCKETS; i++)
+        {
+            for (Fiber *f = waitQueue[i]; f != NULL; f = f->next)
+            {
+                uint16_t fid = f->context & 0xFFFF;
+                uint16_t fvalue = (f->context & 0xFFFF0000) >> 16;
+
+                if ((id == MICROBIT_ID_ANY || id == fid) && fid != MICROBIT_ID_NOTIFY && fid != MICROBIT_ID_NOTIFY_ONE)
+                    messageBus->listen(fid, fvalue, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+            }
+        }
     }
 }
 
 /**
-  * Event callback. Called from an instance of MicroBitMessageBus whenever an event is raised.
+  * Wakes any fibers on the given wait queue that are blocked on the given event.
   *
-  * This function checks to determine if any fibers blocked on the wait queue need to be woken up
-  * and made runnable due to the event.
+  * Once the last fiber waiting on a given event ID and value is woken, the listener registered
+  * on behalf of those fibers is removed from the message bus.
   *
-  * @param evt the event that has just been raised on an instance of MicroBitMessageBus.
+  * @param queue The wait queue to process.
+  *
+  * @param evt The event that has just been raised.
+  *
+  * @param notifyOneComplete Set once a fiber has been woken by an event on the NOTIFY_ONE channel.
   */
-void scheduler_event(MicroBitEvent evt)
+static void scheduler_event_wake(Fiber **queue, MicroBitEvent &evt, int &notifyOneComplete)
 {
-    Fiber *f = waitQueue;
+    Fiber *f = *queue;
     Fiber *t;
-    int notifyOneComplete = 0;
-
-	// This should never happen.
-	// It is however, safe to simply ignore any events provided, as if no messageBus if recorded,
-	// no fibers are permitted to block on events.
-	if (messageBus == NULL)
-		return;
 
-    // Check the wait queue, and wake up any fibers as necessary.
     while (f != NULL)
     {
         t = f->next;
@@ -285,33 +572,69 @@ void scheduler_event(MicroBitEvent evt)
         // extract the event data this fiber is blocked on.
         uint16_t id = f->context & 0xFFFF;
         uint16_t value = (f->context & 0xFFFF0000) >> 16;
+        bool wake = false;
 
         // Special case for the NOTIFY_ONE channel...
         if ((evt.source == MICROBIT_ID_NOTIFY_ONE && id == MICROBIT_ID_NOTIFY) && (value == MICROBIT_EVT_ANY || value == evt.value))
         {
             if (!notifyOneComplete)
             {
-                // Wakey wakey!
-                dequeue_fiber(f);
-                queue_fiber(f,&runQueue);
+                wake = true;
                 notifyOneComplete = 1;
             }
         }
 
         // Normal case.
         else if ((id == MICROBIT_ID_ANY || id == evt.source) && (value == MICROBIT_EVT_ANY || value == evt.value))
+        {
+            wake = true;
+        }
+
+        if (wake)
         {
             // Wakey wakey!
             dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
+            queue_fiber(f, FIBER_RUN_QUEUE(f));
+
+            // Unregister this event if we've woken up the last fiber waiting on it.
+            // Special case for the notify channel, as we always stay registered for that.
+            if (id != MICROBIT_ID_NOTIFY && id != MICROBIT_ID_NOTIFY_ONE && !fiber_waiting_on(*queue, f->context))
+                scheduler_release_listener(id, value);
         }
 
         f = t;
     }
+}
+
+/**
+  * Event callback. Called from an instance of MicroBitMessageBus whenever an event is raised.
+  *
+  * This function checks to determine if any fibers blocked on the wait queue need to be woken up
+  * and made runnable due to the event.
+  *
+  * @param evt the event that has just been raised on an instance of MicroBitMessageBus.
+  */
+void scheduler_event(MicroBitEvent evt)
+{
+    int notifyOneComplete = 0;
+    Fiber **queue;
+
+	// This should never happen.
+	// It is however, safe to simply ignore any events provided, as if no messageBus if recorded,
+	// no fibers are permitted to block on events.
+	if (messageBus == NULL)
+		return;
 
-    // Unregister this event, as we've woken up all the fibers with this match.
-    if (evt.source != MICROBIT_ID_NOTIFY && evt.source != MICROBIT_ID_NOTIFY_ONE)
-        messageBus->ignore(evt.source, evt.value, scheduler_event);
+    // Only fibers waiting on the event's source, or on any source, can match this event.
+    // Events on the NOTIFY_ONE channel may also wake fibers waiting on the NOTIFY channel.
+    queue = FIBER_WAIT_QUEUE(evt.source);
+    scheduler_event_wake(queue, evt, notifyOneComplete);
+
+    if (evt.source == MICROBIT_ID_NOTIFY_ONE && FIBER_WAIT_QUEUE(MICROBIT_ID_NOTIFY) != queue)
+        scheduler_event_wake(FIBER_WAIT_QUEUE(MICROBIT_ID_NOTIFY), evt, notifyOneComplete);
+
+    if (FIBER_WAIT_QUEUE(MICROBIT_ID_ANY) != queue)
+        scheduler_event_wake(FIBER_WAIT_QUEUE(MICROBIT_ID_ANY), evt, notifyOneComplete);
 }
 
 
@@ -357,7 +680,12 @@ void fiber_sleep(unsigned long t)
     dequeue_fiber(f);
 
     // Add fiber to the sleep queue. We maintain strict ordering here to reduce lookup times.
-    queue_fiber(f, &sleepQueue);
+    queue_fiber_ordered(f, &sleepQueue);
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    // Ensure the scheduler is called when this fiber is due.
+    system_timer_wake_at(f->context);
+#endif
 
     // Finally, enter the scheduler.
     schedule();
@@ -431,7 +759,7 @@ int fiber_wake_on_event(uint16_t id, uint16_t value)
         {
             f = forkedFiber;
             dequeue_fiber(f);
-            queue_fiber(f, &runQueue);
+            queue_fiber(f, FIBER_RUN_QUEUE(f));
             schedule();
         }
     }
@@ -439,20 +767,104 @@ int fiber_wake_on_event(uint16_t id, uint16_t value)
     // Encode the event data in the context field. It's handy having a 32 bit core. :-)
     f->context = value << 16 | id;
 
+    // Register to receive this event, so we can wake up the fiber when it happens.
+    // Special case for the notify channel, as we always stay registered for that.
+    // If another fiber is already waiting on this event, then the listener is already in place.
+    if (id != MICROBIT_ID_NOTIFY && id != MICROBIT_ID_NOTIFY_ONE && !fiber_waiting_on(*FIBER_WAIT_QUEUE(id), f->context))
+        messageBus->listen(id, value, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
     // Remove ourselves from the run queue
     dequeue_fiber(f);
 
-    // Add ourselves to the sleep queue. We maintain strict ordering here to reduce lookup times.
-    queue_fiber(f, &waitQueue);
+    // Add ourselves to the wait queue for this event ID.
+    queue_fiber(f, FIBER_WAIT_QUEUE(id));
 
-    // Register to receive this event, so we can wake up the fiber when it happens.
-    // Special case for the notify channel, as we always stay registered for that.
-    if (id != MICROBIT_ID_NOTIFY && id != MICROBIT_ID_NOTIFY_ONE)
-        messageBus->listen(id, value, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    return MICROBIT_OK;
+}
+
+/**
+  * Blocks the calling fiber on the given wait queue.
+  * The calling fiber will be immediately descheduled, and will remain on the queue until woken
+  * by fiber_wake_one() or fiber_wake_all(). Unlike fiber_wait_for_event(), no message bus
+  * listener is involved, so this is a lightweight basis for synchronisation primitives.
+  *
+  * @param queue The wait queue to block on. This should be initialised to NULL before first use.
+  *
+  * @return MICROBIT_OK once woken, MICROBIT_NOT_SUPPORTED if the fiber scheduler is not running, or
+  *         MICROBIT_NO_RESOURCES if called in fork on block context and no fiber could be allocated.
+  *
+  * @note the fiber will not be be made runnable until after it is woken, but there
+  * are no guarantees precisely when the fiber will next be scheduled.
+  */
+int fiber_wait_on_queue(Fiber **queue)
+{
+    Fiber *f = currentFiber;
+
+    if (!fiber_scheduler_running())
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Waiting is a blocking call, so if we're in a fork on block context,
+    // it's time to spawn a new fiber...
+    if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB)
+    {
+        forkedFiber = getFiberContext();
+
+        // If we're out of memory, we cannot block on behalf of the caller.
+        if (forkedFiber == NULL)
+            return MICROBIT_NO_RESOURCES;
+
+        f = forkedFiber;
+    }
+
+    // Remove fiber from the run queue
+    dequeue_fiber(f);
+
+    // Add fiber to the tail of the wait queue, so that fibers are woken in the order they arrived.
+    queue_fiber(f, queue);
+
+    // Finally, enter the scheduler.
+    schedule();
 
     return MICROBIT_OK;
 }
 
+/**
+  * Makes the fiber that has waited longest on the given wait queue runnable (if any).
+  *
+  * @param queue The wait queue to wake a fiber from.
+  *
+  * @return 1 if a fiber was woken, or 0 if the queue was empty.
+  */
+int fiber_wake_one(Fiber **queue)
+{
+    Fiber *f = *queue;
+
+    if (f == NULL)
+        return 0;
+
+    dequeue_fiber(f);
+    queue_fiber(f, FIBER_RUN_QUEUE(f));
+
+    return 1;
+}
+
+/**
+  * Makes all fibers waiting on the given wait queue runnable.
+  *
+  * @param queue The wait queue to wake fibers from.
+  *
+  * @return The number of fibers woken.
+  */
+int fiber_wake_all(Fiber **queue)
+{
+    int woken = 0;
+
+    while (fiber_wake_one(queue))
+        woken++;
+
+    return woken;
+}
+
 /**
   * Executes the given function asynchronously if necessary.
   *
@@ -475,11 +887,17 @@ int invoke(void (*entry_fn)(void))
     if (!fiber_scheduler_running())
 		return MICROBIT_NOT_SUPPORTED;
 
-    if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB)
+    if (currentFiber->flags & (MICROBIT_FIBER_FLAG_FOB | MICROBIT_FIBER_FLAG_DEDICATED_STACK))
     {
         // If we attempt a fork on block whilst already in  fork n block context,
         // simply launch a fiber to deal with the request and we're done.
+        // The same applies to fibers with a dedicated stack, as a forked fiber can only be created from the system stack.
         create_fiber(entry_fn);
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+        invoke_count++;
+        invoke_fork_count++;
+#endif
         return MICROBIT_OK;
     }
 
@@ -502,6 +920,11 @@ int invoke(void (*entry_fn)(void))
     // Otherwise, we're here for the first time. Enter FORK ON BLOCK mode, and
     // execute the function directly. If the code tries to block, we detect this and
     // spawn a thread to deal with it.
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+    invoke_count++;
+#endif
+    forkPriority = FIBER_PRIORITY(currentFiber);
+    forkArena = currentFiber->arena;
     currentFiber->flags |= MICROBIT_FIBER_FLAG_FOB;
     entry_fn();
     currentFiber->flags &= ~MICROBIT_FIBER_FLAG_FOB;
@@ -527,22 +950,36 @@ int invoke(void (*entry_fn)(void))
   *
   * @param param an untyped parameter passed into the entry_fn and completion_fn.
   *
-  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+  * @param priority The priority of the fiber created should entry_fn block, or MICROBIT_FIBER_PRIORITY_INHERIT
+  *                 to use the priority of the calling fiber.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if entry_fn is NULL or the priority is out of range.
   */
-int invoke(void (*entry_fn)(void *), void *param)
+int invoke(void (*entry_fn)(void *), void *param, int priority)
 {
     // Validate our parameters.
-    if (entry_fn == NULL)
+    if (entry_fn == NULL || priority >= MICROBIT_FIBER_PRIORITY_LEVELS)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (priority < 0 && priority != MICROBIT_FIBER_PRIORITY_INHERIT)
         return MICROBIT_INVALID_PARAMETER;
 
     if (!fiber_scheduler_running())
 		return MICROBIT_NOT_SUPPORTED;
 
-    if (currentFiber->flags & (MICROBIT_FIBER_FLAG_FOB | MICROBIT_FIBER_FLAG_PARENT | MICROBIT_FIBER_FLAG_CHILD))
+    if (currentFiber->flags & (MICROBIT_FIBER_FLAG_FOB | MICROBIT_FIBER_FLAG_PARENT | MICROBIT_FIBER_FLAG_CHILD | MICROBIT_FIBER_FLAG_DEDICATED_STACK))
     {
         // If we attempt a fork on block whilst already in a fork on block context,
         // simply launch a fiber to deal with the request and we're done.
-        create_fiber(entry_fn, param);
+        Fiber *f = create_fiber(entry_fn, param);
+
+        if (f != NULL && priority != MICROBIT_FIBER_PRIORITY_INHERIT)
+            fiber_set_priority(f, priority);
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+        invoke_count++;
+        invoke_fork_count++;
+#endif
         return MICROBIT_OK;
     }
 
@@ -565,6 +1002,11 @@ int invoke(void (*entry_fn)(void *), void *param)
     // Otherwise, we're here for the first time. Enter FORK ON BLOCK mode, and
     // execute the function directly. If the code tries to block, we detect this and
     // spawn a thread to deal with it.
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+    invoke_count++;
+#endif
+    forkPriority = priority == MICROBIT_FIBER_PRIORITY_INHERIT ? FIBER_PRIORITY(currentFiber) : priority;
+    forkArena = currentFiber->arena;
     currentFiber->flags |= MICROBIT_FIBER_FLAG_FOB;
     entry_fn(param);
     currentFiber->flags &= ~MICROBIT_FIBER_FLAG_FOB;
@@ -617,7 +1059,7 @@ void launch_new_fiber_param(void (*ep)(void *), void (*cp)(void *), void *pm)
     release_fiber(pm);
 }
 
-Fiber *__create_fiber(uint32_t ep, uint32_t cp, uint32_t pm, int parameterised)
+Fiber *__create_fiber(uint32_t ep, uint32_t cp, uint32_t pm, int parameterised, uint32_t stackSize = 0)
 {
     // Validate our parameters.
     if (ep == 0 || cp == 0)
@@ -635,12 +1077,42 @@ Fiber *__create_fiber(uint32_t ep, uint32_t cp, uint32_t pm, int parameterised)
     newFiber->tcb.R1 = (uint32_t) cp;
     newFiber->tcb.R2 = (uint32_t) pm;
 
+    // If a dedicated stack has been requested, reuse the fiber's existing stack buffer if it is large enough,
+    // or allocate a new one. The stack then runs directly from this buffer, rather than the system stack.
+    if (stackSize > 0)
+    {
+        stackSize = (stackSize + 7) & 0xfffffff8;
+
+        if (newFiber->stack_top - newFiber->stack_bottom < stackSize)
+        {
+            if (newFiber->stack_bottom != 0)
+                free((void *)newFiber->stack_bottom);
+
+            MicroBitHeapArena::suspend();
+            newFiber->stack_bottom = (uint32_t) malloc(stackSize);
+            MicroBitHeapArena::resume();
+
+            if (newFiber->stack_bottom == 0)
+            {
+                newFiber->stack_top = 0;
+                queue_fiber(newFiber, &fiberPool);
+                return NULL;
+            }
+
+            newFiber->stack_top = newFiber->stack_bottom + stackSize;
+        }
+
+        // Align the base of the stack to a double word boundary, as required by the ARM procedure call standard.
+        newFiber->flags |= MICROBIT_FIBER_FLAG_DEDICATED_STACK;
+        newFiber->tcb.stack_base = newFiber->stack_top & 0xfffffff8;
+    }
+
     // Set the stack and assign the link register to refer to the appropriate entry point wrapper.
-    newFiber->tcb.SP = CORTEX_M0_STACK_BASE - 0x04;
+    newFiber->tcb.SP = newFiber->tcb.stack_base - 0x04;
     newFiber->tcb.LR = parameterised ? (uint32_t) &launch_new_fiber_param : (uint32_t) &launch_new_fiber;
 
     // Add new fiber to the run queue.
-    queue_fiber(newFiber, &runQueue);
+    queue_fiber(newFiber, FIBER_RUN_QUEUE(newFiber));
 
     return newFiber;
 }
@@ -685,27 +1157,85 @@ Fiber *create_fiber(void (*entry_fn)(void *), void *param, void (*completion_fn)
 }
 
 /**
-  * Exit point for all fibers.
+  * Creates a new Fiber with its own dedicated stack, and launches it.
   *
-  * Any fiber reaching the end of its entry function will return here  for recycling.
+  * Unlike other fibers, whose stacks are copied in and out of the system stack on each context switch,
+  * a fiber with a dedicated stack executes directly from a stack region allocated for its lifetime. This
+  * makes switching to and from the fiber a simple register save and restore, at the cost of holding the
+  * full stack allocation in memory. This is intended for latency critical fibers.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param stack_size The size of the stack to allocate for the fiber, in bytes. This must be sufficient
+  *                   to hold the deepest call chain of the fiber, and any interrupt handlers that may run on top of it.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  *
+  * @note Calls to invoke() made from a fiber with a dedicated stack always execute the given function in a new fiber.
   */
-void release_fiber(void *)
+Fiber *create_fiber_with_stack(void (*entry_fn)(void), uint32_t stack_size, void (*completion_fn)(void))
 {
-    if (!fiber_scheduler_running())
-		return;
+    if (!fiber_scheduler_running() || stack_size == 0)
+		return NULL;
 
-    release_fiber();
+    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, 0, 0, stack_size);
 }
 
 /**
-  * Exit point for all fibers.
+  * Creates a new parameterised Fiber with its own dedicated stack, and launches it.
   *
-  * Any fiber reaching the end of its entry function will return here  for recycling.
+  * Unlike other fibers, whose stacks are copied in and out of the system stack on each context switch,
+  * a fiber with a dedicated stack executes directly from a stack region allocated for its lifetime. This
+  * makes switching to and from the fiber a simple register save and restore, at the cost of holding the
+  * full stack allocation in memory. This is intended for latency critical fibers.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param param an untyped parameter passed into the entry_fn and completion_fn.
+  *
+  * @param stack_size The size of the stack to allocate for the fiber, in bytes. This must be sufficient
+  *                   to hold the deepest call chain of the fiber, and any interrupt handlers that may run on top of it.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  *
+  * @note Calls to invoke() made from a fiber with a dedicated stack always execute the given function in a new fiber.
   */
-void release_fiber(void)
+Fiber *create_fiber_with_stack(void (*entry_fn)(void *), void *param, uint32_t stack_size, void (*completion_fn)(void *))
 {
-    if (!fiber_scheduler_running())
-		return;
+    if (!fiber_scheduler_running() || stack_size == 0)
+		return NULL;
+
+    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, (uint32_t) param, 1, stack_size);
+}
+
+/**
+  * Exit point for all fibers.
+  *
+  * Any fiber reaching the end of its entry function will return here  for recycling.
+  */
+void release_fiber(void *)
+{
+    if (!fiber_scheduler_running())
+		return;
+
+    release_fiber();
+}
+
+/**
+  * Exit point for all fibers.
+  *
+  * Any fiber reaching the end of its entry function will return here  for recycling.
+  */
+void release_fiber(void)
+{
+    if (!fiber_scheduler_running())
+		return;
 
     // Remove ourselves form the runqueue.
     dequeue_fiber(currentFiber);
@@ -717,12 +1247,131 @@ void release_fiber(void)
     schedule();
 }
 
+/**
+  * Sets the scheduling priority of the given fiber.
+  *
+  * Fibers are created with the priority of the fiber that created them, or MICROBIT_FIBER_PRIORITY_NORMAL
+  * if created outside of the scheduler. The scheduler always runs fibers of the highest priority that are
+  * runnable, and shares the processor in a round robin fashion between runnable fibers of equal priority.
+  *
+  * @param f The fiber to update.
+  *
+  * @param priority The new priority, in the range MICROBIT_FIBER_PRIORITY_LOW to MICROBIT_FIBER_PRIORITY_HIGH.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the fiber is NULL or the priority is out of range.
+  */
+int fiber_set_priority(Fiber *f, int priority)
+{
+    if (f == NULL || priority < 0 || priority >= MICROBIT_FIBER_PRIORITY_LEVELS)
+        return MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+
+    bool runnable = (f->queue == FIBER_RUN_QUEUE(f));
+
+    f->flags = (f->flags & ~MICROBIT_FIBER_FLAG_PRIORITY_MASK) | (priority << MICROBIT_FIBER_FLAG_PRIORITY_SHIFT);
+
+    __enable_irq();
+
+    // If the fiber is runnable, move it to the run queue of its new priority.
+    if (runnable && f->queue != FIBER_RUN_QUEUE(f))
+    {
+        dequeue_fiber(f);
+        queue_fiber(f, FIBER_RUN_QUEUE(f));
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the scheduling priority of the given fiber.
+  *
+  * @param f The fiber to inspect.
+  *
+  * @return The priority of the fiber, or MICROBIT_INVALID_PARAMETER if the fiber is NULL.
+  */
+int fiber_get_priority(Fiber *f)
+{
+    if (f == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return FIBER_PRIORITY(f);
+}
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+/**
+  * Determines the stack buffer size class able to hold a stack of the given depth.
+  *
+  * @param size The stack depth, in bytes.
+  *
+  * @return The index of the smallest size class large enough, or -1 if the stack is larger than all size classes.
+  */
+static int stack_pool_class(uint32_t size)
+{
+    for (int c = 0; c < MICROBIT_FIBER_STACK_POOL_CLASSES; c++)
+        if (size <= (MICROBIT_FIBER_STACK_POOL_MIN << c))
+            return c;
+
+    return -1;
+}
+
+/**
+  * Obtains a stack buffer of the given size, reusing a pooled buffer if one is available.
+  *
+  * @param size The size of the buffer, in bytes.
+  *
+  * @return The start address of the buffer, or 0 if no memory is available.
+  */
+static uint32_t stack_pool_allocate(uint32_t size)
+{
+    int c = stack_pool_class(size);
+
+    if (c >= 0 && size == (MICROBIT_FIBER_STACK_POOL_MIN << c) && stackPool[c] != NULL)
+    {
+        uint32_t *buffer = stackPool[c];
+        stackPool[c] = (uint32_t *) *buffer;
+        stackPoolDepth[c]--;
+
+        return (uint32_t) buffer;
+    }
+
+    return (uint32_t) malloc(size);
+}
+
+/**
+  * Returns a stack buffer to the pool, or to the heap if it does not fit a size class or the pool is full.
+  *
+  * @param buffer The start address of the buffer.
+  *
+  * @param size The size of the buffer, in bytes.
+  */
+static void stack_pool_release(uint32_t buffer, uint32_t size)
+{
+    int c = stack_pool_class(size);
+
+    if (c >= 0 && size == (MICROBIT_FIBER_STACK_POOL_MIN << c) && stackPoolDepth[c] < MICROBIT_FIBER_STACK_POOL_DEPTH)
+    {
+        *((uint32_t *) buffer) = (uint32_t) stackPool[c];
+        stackPool[c] = (uint32_t *) buffer;
+        stackPoolDepth[c]++;
+
+        return;
+    }
+
+    free((void *)buffer);
+}
+#endif
+
 /**
   * Resizes the stack allocation of the current fiber if necessary to hold the system stack.
   *
   * If the stack allocation is large enough to hold the current system stack, then this function does nothing.
   * Otherwise, the the current allocation of the fiber is freed, and a larger block is allocated.
   *
+  * If MICROBIT_FIBER_STACK_POOL is enabled, buffers are drawn from and released to a pool of power of two
+  * size classes, and an oversized buffer is exchanged for a smaller pooled one once the stack shrinks to a
+  * quarter of its size.
+  *
   * @param f The fiber context to verify.
   *
   * @return The stack depth of the given fiber.
@@ -739,6 +1388,36 @@ void verify_stack_size(Fiber *f)
     // Calculate the size of our allocated stack buffer
     bufferSize = f->stack_top - f->stack_bottom;
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+    if (stackDepth > f->stats.max_stack)
+        f->stats.max_stack = stackDepth;
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+    // If we're too small, or much larger than we need to be, consider moving to another size class.
+    if (bufferSize < stackDepth || stackDepth < bufferSize / 4)
+    {
+        int c = stack_pool_class(stackDepth);
+        uint32_t newSize = c < 0 ? (stackDepth + 32) & 0xffffffe0 : MICROBIT_FIBER_STACK_POOL_MIN << c;
+
+        // Always grow, but only shrink if a buffer of the smaller size is already pooled, to avoid heap churn.
+        if (newSize > bufferSize || (c >= 0 && stackPool[c] != NULL))
+        {
+            // Release the old buffer
+            if (f->stack_bottom != 0)
+                stack_pool_release(f->stack_bottom, bufferSize);
+
+            // Obtain a new one of the appropriate size. This may be called on behalf of a fiber other than the current one,
+            // and the buffer outlives any arena, so always use the heap.
+            MicroBitHeapArena::suspend();
+            f->stack_bottom = stack_pool_allocate(newSize);
+            MicroBitHeapArena::resume();
+
+            // Recalculate where the top of the stack is and we're done.
+            f->stack_top = f->stack_bottom + newSize;
+        }
+    }
+#else
     // If we're too small, increase our buffer size.
     if (bufferSize < stackDepth)
     {
@@ -749,12 +1428,30 @@ void verify_stack_size(Fiber *f)
         if (f->stack_bottom != 0)
             free((void *)f->stack_bottom);
 
-        // Allocate a new one of the appropriate size.
+        // Allocate a new one of the appropriate size. This may be called on behalf of a fiber other than the current one,
+        // and the buffer outlives any arena, so always use the heap.
+        MicroBitHeapArena::suspend();
         f->stack_bottom = (uint32_t) malloc(bufferSize);
+        MicroBitHeapArena::resume();
 
         // Recalculate where the top of the stack is and we're done.
         f->stack_top = f->stack_bottom + bufferSize;
     }
+#endif
+}
+
+/**
+  * Determines the highest priority run queue that holds any runnable fibers.
+  *
+  * @return The run queue, or NULL if no fibers are runnable.
+  */
+static Fiber **scheduler_runqueue()
+{
+    for (int i = MICROBIT_FIBER_PRIORITY_LEVELS - 1; i >= 0; i--)
+        if (runQueue[i] != NULL)
+            return &runQueue[i];
+
+    return NULL;
 }
 
 /**
@@ -764,8 +1461,31 @@ void verify_stack_size(Fiber *f)
   */
 int scheduler_runqueue_empty()
 {
-    return (runQueue == NULL);
+    return (scheduler_runqueue() == NULL);
+}
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+/**
+  * Records the time spent by the outgoing fiber, and the scheduling of the incoming fiber.
+  *
+  * @param from The fiber being scheduled out.
+  *
+  * @param to The fiber being scheduled in.
+  */
+static void scheduler_record_switch(Fiber *from, Fiber *to)
+{
+    uint64_t now = system_timer_current_time_us();
+    uint64_t elapsed = now - fiber_switch_time;
+
+    if (from == idleFiber)
+        idle_time += elapsed;
+
+    from->stats.run_time += elapsed;
+    to->stats.switches++;
+
+    fiber_switch_time = now;
 }
+#endif
 
 /**
   * Calls the Fiber scheduler.
@@ -780,6 +1500,10 @@ void schedule()
     // First, take a reference to the currently running fiber;
     Fiber *oldFiber = currentFiber;
 
+    // Set if we idle on the stack of the old fiber, in which case the switches in and out of the idle task are already recorded
+    // and traced.
+    bool idledInPlace = false;
+
     // First, see if we're in Fork on Block context. If so, we simply want to store the full context
     // of the currently running thread in a newly created fiber, and restore the context of the
     // currently running fiber, back to the point where it entered FOB.
@@ -790,6 +1514,17 @@ void schedule()
         currentFiber->flags |= MICROBIT_FIBER_FLAG_PARENT;
         forkedFiber->flags |= MICROBIT_FIBER_FLAG_CHILD;
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+        invoke_fork_count++;
+#endif
+
+        // The forked fiber runs at the priority requested when the fork on block operation began.
+        fiber_set_priority(forkedFiber, forkPriority);
+
+        // Any arenas created since then live on the stack we are about to hand to the forked fiber, so they go with it.
+        forkedFiber->arena = currentFiber->arena;
+        currentFiber->arena = forkArena;
+
         // Define the stack base of the forked fiber to be align with the entry point of the parent fiber
         forkedFiber->tcb.stack_base = currentFiber->tcb.SP;
 
@@ -810,18 +1545,21 @@ void schedule()
         return;
     }
 
-    // We're in a normal scheduling context, so perform a round robin algorithm across runnable fibers.
+    // We're in a normal scheduling context, so perform a round robin algorithm across the runnable fibers
+    // of the highest priority.
+    Fiber **queue = scheduler_runqueue();
+
     // OK - if we've nothing to do, then run the IDLE task (power saving sleep)
-    if (runQueue == NULL)
+    if (queue == NULL)
         currentFiber = idleFiber;
 
-    else if (currentFiber->queue == &runQueue)
+    else if (currentFiber->queue == queue)
         // If the current fiber is on the run queue, round robin.
-        currentFiber = currentFiber->next == NULL ? runQueue : currentFiber->next;
+        currentFiber = currentFiber->next == NULL ? *queue : currentFiber->next;
 
     else
         // Otherwise, just pick the head of the run queue.
-        currentFiber = runQueue;
+        currentFiber = *queue;
 
     if (currentFiber == idleFiber && oldFiber->flags & MICROBIT_FIBER_FLAG_DO_NOT_PAGE)
     {
@@ -831,22 +1569,48 @@ void schedule()
         // Run in the context of the original fiber, to preserve state of flags...
         // as we are running on top of this fiber's stack.
         currentFiber = oldFiber;
+        idledInPlace = true;
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+        scheduler_record_switch(oldFiber, idleFiber);
+#endif
+
+        MICROBIT_TRACE_RECORD(MICROBIT_TRACE_FIBER_SWITCH, 0, (uint32_t)idleFiber);
 
         do
         {
             idle();
         }
-        while (runQueue == NULL);
+        while (scheduler_runqueue_empty());
 
         // Switch to a non-idle fiber.
         // If this fiber is the same as the old one then there'll be no switching at all.
-        currentFiber = runQueue;
+        currentFiber = *scheduler_runqueue();
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+        scheduler_record_switch(idleFiber, currentFiber);
+#endif
+
+        MICROBIT_TRACE_RECORD(MICROBIT_TRACE_FIBER_SWITCH, 0, (uint32_t)currentFiber);
     }
 
+#if MICROBIT_FIBER_TIME_SLICE > 0
+    scheduler_start_slice();
+#endif
+
     // Swap to the context of the chosen fiber, and we're done.
     // Don't bother with the overhead of switching if there's only one fiber on the runqueue!
     if (currentFiber != oldFiber)
     {
+        if (!idledInPlace)
+        {
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+            scheduler_record_switch(oldFiber, currentFiber);
+#endif
+
+            MICROBIT_TRACE_RECORD(MICROBIT_TRACE_FIBER_SWITCH, 0, (uint32_t)currentFiber);
+        }
+
         // Special case for the idle task, as we don't maintain a stack context (just to save memory).
         if (currentFiber == idleFiber)
         {
@@ -857,76 +1621,514 @@ void schedule()
         if (oldFiber == idleFiber)
         {
             // Just swap in the new fiber, and discard changes to stack and register context.
-            swap_context(NULL, &currentFiber->tcb, 0, currentFiber->stack_top);
+            swap_context(NULL, &currentFiber->tcb, 0, FIBER_STACK_BUFFER(currentFiber));
         }
         else
         {
             // Ensure the stack allocation of the fiber being scheduled out is large enough
-            verify_stack_size(oldFiber);
+            if (!(oldFiber->flags & MICROBIT_FIBER_FLAG_DEDICATED_STACK))
+                verify_stack_size(oldFiber);
 
             // Schedule in the new fiber.
-            swap_context(&oldFiber->tcb, &currentFiber->tcb, oldFiber->stack_top, currentFiber->stack_top);
+            swap_context(&oldFiber->tcb, &currentFiber->tcb, FIBER_STACK_BUFFER(oldFiber), FIBER_STACK_BUFFER(currentFiber));
         }
     }
 }
 
 /**
-  * Adds a component to the array of idle thread components, which are processed
-  * when the run queue is empty.
+  * Adds a component to the registry of idle thread components, which are processed
+  * when the run queue is empty. If the component is already registered, its interval is updated.
   *
-  * @param component The component to add to the array.
-  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the fiber components array is full.
+  * @param component The component to add.
+  *
+  * @param interval The time between calls to the component's idleTick(), in milliseconds. If MICROBIT_IDLE_EVERY_PASS,
+  *                 the component is called every time the processor is idle. If MICROBIT_IDLE_ON_DEMAND, it is only
+  *                 called after it has been woken by fiber_wake_idle_component(). Defaults to MICROBIT_IDLE_EVERY_PASS.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the component is NULL, or MICROBIT_NO_RESOURCES
+  *         if the registry could not be grown.
   */
-int fiber_add_idle_component(MicroBitComponent *component)
+int fiber_add_idle_component(MicroBitComponent *component, uint16_t interval)
 {
-    int i = 0;
+    if (component == NULL)
+        return MICROBIT_INVALID_PARAMETER;
 
-    while(idleThreadComponents[i] != NULL && i < MICROBIT_IDLE_COMPONENTS)
-        i++;
+    while (1)
+    {
+        int slot = -1;
 
-    if(i == MICROBIT_IDLE_COMPONENTS)
-        return MICROBIT_NO_RESOURCES;
+        // Components may be woken from interrupt context, so update the registry atomically.
+        __disable_irq();
 
-    idleThreadComponents[i] = component;
+        for (int i = 0; i < idleComponentCapacity; i++)
+        {
+            if (idleComponents[i].component == component)
+            {
+                slot = i;
+                break;
+            }
 
-    return MICROBIT_OK;
+            if (idleComponents[i].component == NULL && slot < 0)
+                slot = i;
+        }
+
+        if (slot >= 0)
+        {
+            // Call the component on the next idle pass, whatever its interval.
+            idleComponents[slot].component = component;
+            idleComponents[slot].interval = interval;
+            idleComponents[slot].due = 0;
+            idleComponents[slot].pending = 1;
+
+            __enable_irq();
+
+            return MICROBIT_OK;
+        }
+
+        int capacity = idleComponentCapacity;
+
+        __enable_irq();
+
+        // The registry is full, so grow it. The heap allocator manages interrupts itself, so allocate outside the
+        // critical section, and check that nobody else has grown the registry in the meantime before adopting it.
+        int newCapacity = capacity ? capacity * 2 : MICROBIT_IDLE_COMPONENTS;
+        MicroBitHeapArena::suspend();
+        IdleComponent *c = (IdleComponent *) malloc(newCapacity * sizeof(IdleComponent));
+        MicroBitHeapArena::resume();
+
+        if (c == NULL)
+            return MICROBIT_NO_RESOURCES;
+
+        __disable_irq();
+
+        if (idleComponentCapacity == capacity)
+        {
+            IdleComponent *old = idleComponents;
+
+            for (int i = 0; i < newCapacity; i++)
+            {
+                if (i < capacity)
+                    c[i] = old[i];
+                else
+                    c[i].component = NULL;
+            }
+
+            idleComponents = c;
+            idleComponentCapacity = newCapacity;
+            c = old;
+        }
+
+        __enable_irq();
+
+        free(c);
+    }
 }
 
 /**
-  * remove a component from the array of idle thread components
+  * Removes a component from the registry of idle thread components.
+  *
+  * @param component The component to remove.
   *
-  * @param component the component to remove from the idle component array.
   * @return MICROBIT_OK on success. MICROBIT_INVALID_PARAMETER is returned if the given component has not been previously added.
   */
 int fiber_remove_idle_component(MicroBitComponent *component)
 {
-    int i = 0;
+    __disable_irq();
+
+    for (int i = 0; i < idleComponentCapacity; i++)
+    {
+        if (idleComponents[i].component == component)
+        {
+            idleComponents[i].component = NULL;
+            __enable_irq();
+            return MICROBIT_OK;
+        }
+    }
+
+    __enable_irq();
+
+    return MICROBIT_INVALID_PARAMETER;
+}
+
+/**
+  * Requests that a registered idle component is called on the next idle pass, whatever its interval.
+  * Components registered with MICROBIT_IDLE_ON_DEMAND use this to indicate that they have work pending.
+  *
+  * This may be called from interrupt context.
+  *
+  * @param component The component to wake.
+  *
+  * @return MICROBIT_OK on success. MICROBIT_INVALID_PARAMETER is returned if the given component has not been previously added.
+  */
+int fiber_wake_idle_component(MicroBitComponent *component)
+{
+    __disable_irq();
+
+    for (int i = 0; i < idleComponentCapacity; i++)
+    {
+        if (idleComponents[i].component == component)
+        {
+            idleComponents[i].pending = 1;
+            __enable_irq();
+
+            // Ensure the idle task notices the new work, should it be about to sleep.
+            __SEV();
 
-    while(idleThreadComponents[i] != component && i < MICROBIT_IDLE_COMPONENTS)
-        i++;
+            return MICROBIT_OK;
+        }
+    }
 
-    if(i == MICROBIT_IDLE_COMPONENTS)
+    __enable_irq();
+
+    return MICROBIT_INVALID_PARAMETER;
+}
+
+/**
+  * Prevents the idle task from stopping the high frequency crystal, for components that need an accurate clock
+  * even while the processor sleeps, such as the radio or a serial or I2C transfer. Each call must be balanced by a call to
+  * scheduler_idle_release().
+  */
+void scheduler_idle_hold()
+{
+    __disable_irq();
+    idle_holds++;
+    __enable_irq();
+}
+
+/**
+  * Releases a hold placed by scheduler_idle_hold().
+  */
+void scheduler_idle_release()
+{
+    __disable_irq();
+    if (idle_holds > 0)
+        idle_holds--;
+    __enable_irq();
+}
+
+/**
+  * Defers the given function to be called later from the idle task, rather than in the current context.
+  *
+  * This is intended for use by interrupt handlers, to keep work such as raising events, which must
+  * search the listeners registered with the message bus, out of interrupt context. The function is
+  * called, in order with other deferred work, the next time the processor is idle.
+  *
+  * @param fn The function to call. This should complete quickly, and must not block.
+  *
+  * @param arg An untyped parameter passed to fn.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if fn is NULL, MICROBIT_NOT_SUPPORTED if the
+  *         scheduler is not running, or MICROBIT_NO_RESOURCES if MICROBIT_FIBER_DEFER_QUEUE_SIZE items are already waiting.
+  *
+  * @code
+  * void onData(void *arg)
+  * {
+  *     // Called from the idle task.
+  * }
+  *
+  * void interruptHandler()
+  * {
+  *     fiber_defer(onData, NULL);
+  * }
+  * @endcode
+  */
+int fiber_defer(void (*fn)(void *), void *arg)
+{
+    if (fn == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+#if MICROBIT_FIBER_DEFER_QUEUE_SIZE > 0
+    if (!fiber_scheduler_running())
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Interrupt handlers of different priorities may both defer work, so claim and fill our slot atomically.
+    // The idle task never needs to wait on this.
+    __disable_irq();
+
+    if ((uint16_t)(deferHead - deferTail) >= MICROBIT_FIBER_DEFER_QUEUE_SIZE)
+    {
+        __enable_irq();
+        return MICROBIT_NO_RESOURCES;
+    }
+
+    FiberDeferredWork *w = &deferQueue[deferHead & (MICROBIT_FIBER_DEFER_QUEUE_SIZE - 1)];
+    w->fn = fn;
+    w->arg = arg;
+    deferHead++;
+
+    __enable_irq();
+
+    // Ensure the idle task notices the new work, should it be about to sleep.
+    __SEV();
+
+    return MICROBIT_OK;
+#else
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+#if MICROBIT_FIBER_DEFER_QUEUE_SIZE > 0
+/**
+  * Calls each piece of work deferred by fiber_defer(), in the order it was deferred.
+  */
+static void fiber_run_deferred()
+{
+    while (deferTail != deferHead)
+    {
+        FiberDeferredWork w = deferQueue[deferTail & (MICROBIT_FIBER_DEFER_QUEUE_SIZE - 1)];
+
+        // Release the slot before calling the function, so that it may itself defer further work.
+        deferTail++;
+
+        w.fn(w.arg);
+    }
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+/**
+  * Reads the execution statistics of a given fiber.
+  *
+  * @param f The fiber to inspect, for example as returned by create_fiber(), or currentFiber.
+  *
+  * @param stats The structure to populate with the statistics of the fiber.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the fiber is NULL.
+  */
+int fiber_get_stats(Fiber *f, FiberStats &stats)
+{
+    if (f == NULL)
         return MICROBIT_INVALID_PARAMETER;
 
-    idleThreadComponents[i] = NULL;
+    stats = f->stats;
+
+    // Include the time the current fiber has been running since it was scheduled in.
+    if (f == currentFiber)
+        stats.run_time += system_timer_current_time_us() - fiber_switch_time;
 
     return MICROBIT_OK;
 }
 
+/**
+  * Determines the proportion of time the scheduler has spent idle since it was started, or
+  * since the last call to scheduler_reset_idle_time().
+  *
+  * @return The percentage of time spent in the idle task, in the range 0 to 100.
+  */
+int scheduler_idle_percentage()
+{
+    uint64_t period = system_timer_current_time_us() - idle_period_start;
+
+    if (period == 0)
+        return 0;
+
+    return (int) ((idle_time * 100) / period);
+}
+
+/**
+  * Reads the time spent in a given idle power state since the scheduler was started, or
+  * since the last call to scheduler_reset_idle_time().
+  *
+  * @param state The state to inspect, for example MICROBIT_IDLE_STATE_LOW_POWER.
+  *
+  * @param stats The structure to populate with the statistics of the state.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the state is not valid.
+  */
+int scheduler_get_idle_state_stats(int state, IdleStateStats &stats)
+{
+    if (state < 0 || state >= MICROBIT_IDLE_STATES)
+        return MICROBIT_INVALID_PARAMETER;
+
+    stats = idle_state_stats[state];
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Restarts the measurement period used by scheduler_idle_percentage() and scheduler_get_idle_state_stats().
+  */
+void scheduler_reset_idle_time()
+{
+    idle_time = 0;
+    idle_period_start = system_timer_current_time_us();
+
+    for (int i = 0; i < MICROBIT_IDLE_STATES; i++)
+    {
+        idle_state_stats[i].time = 0;
+        idle_state_stats[i].entries = 0;
+    }
+}
+
+/**
+  * Reads the number of functions executed through invoke(), and how many of them blocked
+  * and so were given a fiber of their own.
+  *
+  * @param invocations Set to the number of calls made to invoke() while the scheduler was running.
+  *
+  * @param forks Set to the number of those calls that resulted in a new fiber being created.
+  */
+void scheduler_get_invoke_stats(uint32_t &invocations, uint32_t &forks)
+{
+    invocations = invoke_count;
+    forks = invoke_fork_count;
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_IDLE_GOVERNOR)
+/**
+  * Chooses how deeply to sleep, from the time until the next timed event is due.
+  *
+  * @param now The current time since power on, in microseconds.
+  *
+  * @return The MICROBIT_IDLE_STATE to enter.
+  */
+static int idle_select_state(uint64_t now)
+{
+    uint64_t next = system_timer_next_interrupt_us();
+
+    // In tickless mode the system timer is already set to wake the first sleeping fiber, but not otherwise.
+    if (sleepQueue != NULL && sleepQueue->context * 1000 < next)
+        next = sleepQueue->context * 1000;
+
+    if (next <= now + MICROBIT_IDLE_LOW_POWER_THRESHOLD_US)
+        return MICROBIT_IDLE_STATE_WAIT;
+
+    if (next - now >= (uint64_t) MICROBIT_IDLE_DEEP_SLEEP_THRESHOLD_MS * 1000 && idle_holds == 0)
+        return MICROBIT_IDLE_STATE_DEEP;
+
+    return MICROBIT_IDLE_STATE_LOW_POWER;
+}
+
+/**
+  * Sleeps until the next event, as deeply as the time until the next timed event allows.
+  *
+  * @return The MICROBIT_IDLE_STATE entered.
+  */
+static int idle_sleep()
+{
+    int state = idle_select_state(system_timer_current_time_us());
+    int mode = state == MICROBIT_IDLE_STATE_WAIT ? MICROBIT_IDLE_STATE_WAIT : MICROBIT_IDLE_STATE_LOW_POWER;
+    uint32_t crystal = 0;
+
+    // Select the System ON sub mode. When Bluetooth is enabled, the power peripheral belongs to the SoftDevice.
+    if (mode != idle_power_mode)
+    {
+        if (ble_running())
+            sd_power_mode_set(mode == MICROBIT_IDLE_STATE_WAIT ? NRF_POWER_MODE_CONSTLAT : NRF_POWER_MODE_LOWPWR);
+        else if (mode == MICROBIT_IDLE_STATE_WAIT)
+            NRF_POWER->TASKS_CONSTLAT = 1;
+        else
+            NRF_POWER->TASKS_LOWPWR = 1;
+
+        idle_power_mode = mode;
+    }
+
+    // Stop the high frequency crystal, unless the SoftDevice is managing the clocks. The processor runs
+    // from its internal oscillator until the crystal has restarted, which we request as soon as we wake.
+    if (state == MICROBIT_IDLE_STATE_DEEP && !ble_running())
+    {
+        crystal = NRF_CLOCK->HFCLKSTAT & CLOCK_HFCLKSTAT_SRC_Msk;
+
+        if (crystal)
+            NRF_CLOCK->TASKS_HFCLKSTOP = 1;
+    }
+
+    __WFE();
+
+    if (crystal)
+        NRF_CLOCK->TASKS_HFCLKSTART = 1;
+
+    return state;
+}
+#else
+/**
+  * Sleeps until the next event.
+  *
+  * @return The MICROBIT_IDLE_STATE entered.
+  */
+static int idle_sleep()
+{
+    __WFE();
+
+    return MICROBIT_IDLE_STATE_WAIT;
+}
+#endif
+
 /**
   * Set of tasks to perform when idle.
   * Service any background tasks that are required, and attempt a power efficient sleep.
   */
 void idle()
 {
-    // Service background tasks
-    for(int i = 0; i < MICROBIT_IDLE_COMPONENTS; i++)
-        if(idleThreadComponents[i] != NULL)
-            idleThreadComponents[i]->idleTick();
+#if MICROBIT_FIBER_DEFER_QUEUE_SIZE > 0
+    // Complete any work deferred from interrupt context, as it may create more work for the components below.
+    fiber_run_deferred();
+#endif
+
+    // Service background tasks that are due, or have work pending.
+    // The registry may grow or shrink as components are called, so we index it afresh each time.
+    uint64_t now = 0;
+    uint32_t next = 0;
+    bool waiting = false;
+
+    for(int i = 0; i < idleComponentCapacity; i++)
+    {
+        IdleComponent *c = &idleComponents[i];
+        bool timed = c->interval != MICROBIT_IDLE_EVERY_PASS && c->interval != MICROBIT_IDLE_ON_DEMAND;
+
+        if (c->component == NULL)
+            continue;
+
+        if (timed && now == 0)
+            now = system_timer_current_time();
+
+        if (!c->pending)
+        {
+            if (c->interval == MICROBIT_IDLE_ON_DEMAND)
+                continue;
+
+            if (timed && (int32_t)((uint32_t) now - c->due) < 0)
+            {
+                if (!waiting || (int32_t)(c->due - next) < 0)
+                    next = c->due;
+
+                waiting = true;
+                continue;
+            }
+        }
+
+        if (timed)
+        {
+            c->due = (uint32_t) now + c->interval;
+
+            if (!waiting || (int32_t)(c->due - next) < 0)
+                next = c->due;
+
+            waiting = true;
+        }
+
+        c->pending = 0;
+        c->component->idleTick();
+    }
+
+    // In tickless mode, nothing else may wake the processor in time for the next timed component.
+    if (waiting)
+        system_timer_wake_at(now + (int32_t)(next - (uint32_t) now));
 
     // If the above did create any useful work, enter power efficient sleep.
     if(scheduler_runqueue_empty())
-    	__WFE();
+    {
+#if CONFIG_ENABLED(MICROBIT_FIBER_STATS)
+        uint64_t start = system_timer_current_time_us();
+        int state = idle_sleep();
+
+        idle_state_stats[state].entries++;
+        idle_state_stats[state].time += system_timer_current_time_us() - start;
+#else
+        idle_sleep();
+#endif
+    }
 }
 
 /**
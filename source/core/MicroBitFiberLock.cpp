@@ -0,0 +1,160 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Synchronisation primitives for fibers.
+  *
+  * Both primitives block fibers on a wait queue of their own, rather than on message bus events,
+  * so contended operations neither register listeners nor raise events.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitFiberLock.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * Create an unlocked FiberMutex.
+  */
+FiberMutex::FiberMutex()
+{
+    this->waitQueue = NULL;
+    this->locked = false;
+}
+
+/**
+  * Takes this mutex, blocking the calling fiber until it is available.
+  *
+  * @return MICROBIT_OK once the mutex is held, MICROBIT_NOT_SUPPORTED if the mutex is held and the
+  *         fiber scheduler is not running, or MICROBIT_NO_RESOURCES if the calling fiber could not be blocked.
+  */
+int FiberMutex::lock()
+{
+    if (!locked)
+    {
+        locked = true;
+        return MICROBIT_OK;
+    }
+
+    // When we're woken, the mutex has been handed directly to us by unlock().
+    return fiber_wait_on_queue(&waitQueue);
+}
+
+/**
+  * Takes this mutex, only if it is available.
+  *
+  * @return MICROBIT_OK if the mutex is now held, or MICROBIT_NO_RESOURCES if another fiber holds it.
+  */
+int FiberMutex::tryLock()
+{
+    if (locked)
+        return MICROBIT_NO_RESOURCES;
+
+    locked = true;
+    return MICROBIT_OK;
+}
+
+/**
+  * Releases this mutex. If any fibers are waiting, the mutex is passed to the one that has waited longest.
+  */
+void FiberMutex::unlock()
+{
+    if (!fiber_wake_one(&waitQueue))
+        locked = false;
+}
+
+/**
+  * Determines if this mutex is currently held.
+  *
+  * @return true if the mutex is held, false otherwise.
+  */
+bool FiberMutex::isLocked()
+{
+    return locked;
+}
+
+/**
+  * Constructor.
+  *
+  * Create a FiberSemaphore with the given number of permits.
+  *
+  * @param permits The number of permits initially available. Defaults to 1.
+  */
+FiberSemaphore::FiberSemaphore(int permits)
+{
+    this->waitQueue = NULL;
+    this->permits = permits;
+}
+
+/**
+  * Takes a permit from this semaphore, blocking the calling fiber until one is available.
+  *
+  * @return MICROBIT_OK once a permit is held, MICROBIT_NOT_SUPPORTED if no permit is available and the
+  *         fiber scheduler is not running, or MICROBIT_NO_RESOURCES if the calling fiber could not be blocked.
+  */
+int FiberSemaphore::wait()
+{
+    if (permits > 0)
+    {
+        permits--;
+        return MICROBIT_OK;
+    }
+
+    // When we're woken, a permit has been handed directly to us by signal().
+    return fiber_wait_on_queue(&waitQueue);
+}
+
+/**
+  * Takes a permit from this semaphore, only if one is available.
+  *
+  * @return MICROBIT_OK if a permit is now held, or MICROBIT_NO_RESOURCES if none are available.
+  */
+int FiberSemaphore::tryWait()
+{
+    if (permits <= 0)
+        return MICROBIT_NO_RESOURCES;
+
+    permits--;
+    return MICROBIT_OK;
+}
+
+/**
+  * Releases a permit to this semaphore. If any fibers are waiting, the permit is passed to the one that has waited longest.
+  */
+void FiberSemaphore::signal()
+{
+    if (!fiber_wake_one(&waitQueue))
+        permits++;
+}
+
+/**
+  * Determines the number of permits currently available.
+  *
+  * @return The number of permits that could be taken without blocking.
+  */
+int FiberSemaphore::getPermits()
+{
+    return permits;
+}
@@ -50,19 +50,42 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 #include "MicroBitHeapAllocator.h"
+#include "MicroBitHeapArena.h"
 #include "MicroBitDevice.h"
 #include "ErrorNo.h"
+#include "nrf_sdm.h"
 
 struct HeapDefinition
 {
     uint32_t *heap_start;		// Physical address of the start of this heap.
     uint32_t *heap_end;		    // Physical address of the end of this heap.
+    uint32_t allocations;       // The number of blocks currently allocated from this heap.
+    uint32_t used;              // The number of bytes currently allocated from this heap, including block headers.
+    uint32_t high_water_mark;   // The largest value of used seen since this heap was created.
 };
 
 // A list of all active heap regions, and their dimensions in memory.
 HeapDefinition heap[MICROBIT_MAXIMUM_HEAPS] = { };
 uint8_t heap_count = 0;
 
+// The number of allocations that could not be satisfied by any registered heap.
+static uint32_t heap_failures = 0;
+
+// Set once the SRAM reserved for the SoftDevice has been reclaimed as heap memory.
+static bool sd_heap_created = false;
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+// The number of size classes maintained, one per word up to MICROBIT_HEAP_SIZE_CLASS_LIMIT bytes.
+#define MICROBIT_HEAP_SIZE_CLASS_COUNT      (MICROBIT_HEAP_SIZE_CLASS_LIMIT / MICROBIT_HEAP_BLOCK_SIZE)
+
+// Lists of recently freed blocks, indexed by size class. Cached blocks remain marked as used in the heap,
+// and the first word of each refers to the next block in the list.
+static uint32_t *heap_size_class[MICROBIT_HEAP_SIZE_CLASS_COUNT] = { };
+
+// The number of blocks held in each size class list, up to MICROBIT_HEAP_SIZE_CLASS_DEPTH.
+static uint16_t heap_size_class_depth[MICROBIT_HEAP_SIZE_CLASS_COUNT] = { };
+#endif
+
 #if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
 // Diplays a usage summary about a given heap...
 void microbit_heap_print(HeapDefinition &heap)
@@ -165,6 +188,9 @@ int microbit_create_heap(uint32_t start, uint32_t end)
     // Record the dimensions of this new heap
     heap[heap_count].heap_start = (uint32_t *)start;
     heap[heap_count].heap_end = (uint32_t *)end;
+    heap[heap_count].allocations = 0;
+    heap[heap_count].used = 0;
+    heap[heap_count].high_water_mark = 0;
 
     // Initialise the heap as being completely empty and available for use.
     microbit_initialise_heap(heap[heap_count]);
@@ -224,9 +250,88 @@ int microbit_create_nested_heap(float ratio)
     }
 
     uint32_t start = (uint32_t) p;
-    microbit_create_heap(start, start + length);
+    int result = microbit_create_heap(start, start + length);
 
-    return MICROBIT_OK;
+    // If the heap could not be registered, don't leave its memory stranded.
+    if (result != MICROBIT_OK)
+        native_free(p);
+
+    return result;
+}
+
+/**
+  * Reclaim the SRAM normally reserved for the SoftDevice as an additional heap region, for programs that do not use BLE.
+  *
+  * The region runs from MICROBIT_SRAM_BASE up to MICROBIT_SD_LIMIT, stopping short of any heap already created
+  * within it (such as one reclaiming the unused part of the GATT table). Once reclaimed, the BLE stack can
+  * no longer be started.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if MICROBIT_HEAP_REUSE_SD is disabled, the SoftDevice is
+  *         already enabled or the memory has already been reclaimed, or MICROBIT_NO_RESOURCES if
+  *         MICROBIT_MAXIMUM_HEAPS heaps already exist.
+  *
+  * @note This should be called early during startup, and only if BLE will not be used.
+  */
+int microbit_create_sd_heap()
+{
+#if CONFIG_ENABLED(MICROBIT_HEAP_REUSE_SD)
+    uint8_t enabled = 0;
+    uint32_t end = MICROBIT_SD_LIMIT;
+    int result;
+
+    if (sd_heap_created)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Once enabled, the SoftDevice owns this memory.
+    sd_softdevice_is_enabled(&enabled);
+
+    if (enabled)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Stop short of any heap already reclaimed from within this region.
+    for (int i = 0; i < heap_count; i++)
+        if ((uint32_t) heap[i].heap_start >= MICROBIT_SRAM_BASE && (uint32_t) heap[i].heap_start < end)
+            end = (uint32_t) heap[i].heap_start;
+
+    result = microbit_create_heap(MICROBIT_SRAM_BASE, end);
+
+    if (result == MICROBIT_OK)
+        sd_heap_created = true;
+
+#if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
+    else if(SERIAL_DEBUG) SERIAL_DEBUG->printf("--- SD HEAP NOT CREATED: %d ---\n", result);
+#endif
+
+    return result;
+#else
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/**
+  * Determines if the SRAM normally reserved for the SoftDevice has been reclaimed as heap memory.
+  *
+  * @return true if microbit_create_sd_heap() has succeeded, false otherwise.
+  */
+bool microbit_sd_heap_created()
+{
+    return sd_heap_created;
+}
+
+/**
+  * Record the allocation of a given block in the statistics of the heap it belongs to.
+  * Must be called with interrupts disabled.
+  *
+  * @param heap The heap the block was allocated from.
+  * @param block The header word of the block allocated.
+  */
+static inline void microbit_heap_allocated(HeapDefinition &heap, uint32_t *block)
+{
+    heap.allocations++;
+    heap.used += (*block & ~MICROBIT_HEAP_BLOCK_FREE) * MICROBIT_HEAP_BLOCK_SIZE;
+
+    if (heap.used > heap.high_water_mark)
+        heap.high_water_mark = heap.used;
 }
 
 /**
@@ -314,12 +419,109 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 		*block = blocksNeeded;
 	}
 
+    microbit_heap_allocated(heap, block);
+
 	// Enable Interrupts
     __enable_irq();
 
 	return block+1;
 }
 
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+/**
+  * Attempt to allocate a given amount of memory from the list of cached blocks of the appropriate size class.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if no suitable block is cached.
+  */
+void *microbit_malloc_size_class(size_t size)
+{
+    uint32_t *block = NULL;
+
+    if (size == 0 || size > MICROBIT_HEAP_SIZE_CLASS_LIMIT)
+        return NULL;
+
+    int c = (size + MICROBIT_HEAP_BLOCK_SIZE - 1) / MICROBIT_HEAP_BLOCK_SIZE - 1;
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    if (heap_size_class[c] != NULL)
+    {
+        block = heap_size_class[c];
+        heap_size_class[c] = (uint32_t *) *block;
+        heap_size_class_depth[c]--;
+
+        for (int i=0; i < heap_count; i++)
+            if (block > heap[i].heap_start && block < heap[i].heap_end)
+                microbit_heap_allocated(heap[i], block-1);
+    }
+
+	// Enable Interrupts
+    __enable_irq();
+
+    return block;
+}
+
+/**
+  * Release all blocks held in size class lists back to their heaps, such that they can be
+  * merged with neighbouring free blocks.
+  *
+  * @return The number of blocks released.
+  */
+int microbit_heap_release_size_classes()
+{
+    int released = 0;
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    for (int c = 0; c < MICROBIT_HEAP_SIZE_CLASS_COUNT; c++)
+    {
+        while (heap_size_class[c] != NULL)
+        {
+            uint32_t *block = heap_size_class[c];
+            heap_size_class[c] = (uint32_t *) *block;
+
+            // Mark the block as free in its heap.
+            *(block-1) |= MICROBIT_HEAP_BLOCK_FREE;
+            released++;
+        }
+
+        heap_size_class_depth[c] = 0;
+    }
+
+	// Enable Interrupts
+    __enable_irq();
+
+    return released;
+}
+
+/**
+  * Determines if the given block is held in the list for its size class.
+  *
+  * @param block The header of the block to look for.
+  *
+  * @return true if the block is cached, false otherwise.
+  *
+  * @note should be called with interrupts disabled, as the lists are walked directly.
+  */
+static bool microbit_heap_is_cached(uint32_t *block)
+{
+    uint32_t words = (*block & ~MICROBIT_HEAP_BLOCK_FREE) - 1;
+
+    if (words == 0 || words > MICROBIT_HEAP_SIZE_CLASS_COUNT)
+        return false;
+
+    for (uint32_t *p = heap_size_class[words-1]; p != NULL; p = (uint32_t *) *p)
+        if (p == block+1)
+            return true;
+
+    return false;
+}
+#endif
+
 /**
   * Attempt to allocate a given amount of memory from any of our configured heap areas.
   *
@@ -331,6 +533,23 @@ void *microbit_malloc(size_t size)
 {
     void *p;
 
+    // Transient allocations are taken from the caller's arena, if it has one.
+    p = MicroBitHeapArena::allocate(size);
+    if (p != NULL)
+        return p;
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+    // Small allocations are served from recently freed blocks of the same size where possible.
+    p = microbit_malloc_size_class(size);
+    if (p != NULL)
+    {
+#if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
+        if(SERIAL_DEBUG) SERIAL_DEBUG->printf("microbit_malloc: ALLOCATED: %d [%p]\n", size, p);
+#endif
+        return p;
+    }
+#endif
+
     // Assign the memory from the first heap created that has space.
     for (int i=0; i < heap_count; i++)
     {
@@ -344,8 +563,16 @@ void *microbit_malloc(size_t size)
         }
     }
 
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+    // If no heap can satisfy the request, release any cached blocks back to their heaps and try again.
+    if (microbit_heap_release_size_classes() > 0)
+        return microbit_malloc(size);
+#endif
+
     // If we reach here, then either we have no memory available, or our heap spaces
     // haven't been initialised. Either way, we try the native allocator.
+    if (heap_count > 0)
+        heap_failures++;
 
     p = native_malloc(size);
     if (p != NULL)
@@ -390,11 +617,45 @@ void microbit_free(void *mem)
 	if (memory == NULL)
        return;
 
+    // Memory taken from an arena is reclaimed only when the arena is destroyed.
+    if (MicroBitHeapArena::contains(mem))
+        return;
+
     // If this memory was created from a heap registered with us, free it.
     for (int i=0; i < heap_count; i++)
     {
         if(memory > heap[i].heap_start && memory < heap[i].heap_end)
         {
+            __disable_irq();
+
+            heap[i].allocations--;
+            heap[i].used -= (*cb & ~MICROBIT_HEAP_BLOCK_FREE) * MICROBIT_HEAP_BLOCK_SIZE;
+
+            __enable_irq();
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+            // If the block is small enough, cache it in the list for its size class, ready for reuse.
+            // Once that list is full, the block is freed as normal.
+            uint32_t words = *cb - 1;
+
+            if (words > 0 && words <= MICROBIT_HEAP_SIZE_CLASS_COUNT)
+            {
+                __disable_irq();
+
+                if (heap_size_class_depth[words-1] < MICROBIT_HEAP_SIZE_CLASS_DEPTH)
+                {
+                    *memory = (uint32_t) heap_size_class[words-1];
+                    heap_size_class[words-1] = memory;
+                    heap_size_class_depth[words-1]++;
+
+                    __enable_irq();
+                    return;
+                }
+
+                __enable_irq();
+            }
+#endif
+
             // The memory block given is part of this heap, so we can simply
 	        // flag that this memory area is now free, and we're done.
 	        *cb |= MICROBIT_HEAP_BLOCK_FREE;
@@ -406,3 +667,70 @@ void microbit_free(void *mem)
     // Forward it to the native heap allocator, and let nature take its course...
     native_free(mem);
 }
+
+/**
+  * Read the usage statistics of a given heap.
+  *
+  * @param index The index of the heap to inspect, in the order the heaps were created.
+  *
+  * @param stats The structure to populate with the statistics of the heap.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no heap exists with the given index.
+  *
+  * @note This walks the block list of the heap with interrupts disabled, so its cost is proportional
+  * to the number of blocks in the heap. Blocks held in size class lists are counted as free, but are left in place.
+  */
+int microbit_heap_get_stats(int index, MicroBitHeapStats &stats)
+{
+    uint32_t *block;
+    uint32_t blockSize;
+    uint32_t run = 0;
+    uint32_t largest = 0;
+
+    if (index < 0 || index >= heap_count)
+        return MICROBIT_INVALID_PARAMETER;
+
+    HeapDefinition &h = heap[index];
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    // Find the longest run of adjacent free blocks, as these will be merged on demand.
+    // Cached blocks would be returned to the heap before an allocation failed, so are treated as free.
+    block = h.heap_start;
+    while (block < h.heap_end)
+    {
+        blockSize = *block & ~MICROBIT_HEAP_BLOCK_FREE;
+        bool isFree = *block & MICROBIT_HEAP_BLOCK_FREE;
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+        if (!isFree)
+            isFree = microbit_heap_is_cached(block);
+#endif
+
+        if (isFree)
+        {
+            run += blockSize;
+            if (run > largest)
+                largest = run;
+        }
+        else
+        {
+            run = 0;
+        }
+
+        block += blockSize;
+    }
+
+    stats.totalBytes = (uint32_t)h.heap_end - (uint32_t)h.heap_start;
+    stats.freeBytes = stats.totalBytes - h.used;
+    stats.largestFreeBlock = largest > 0 ? (largest - 1) * MICROBIT_HEAP_BLOCK_SIZE : 0;
+    stats.allocations = h.allocations;
+    stats.highWaterMark = h.high_water_mark;
+    stats.failedAllocations = heap_failures;
+
+	// Enable Interrupts
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
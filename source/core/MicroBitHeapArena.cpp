@@ -0,0 +1,158 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitHeapArena.h"
+#include "MicroBitFiber.h"
+
+int MicroBitHeapArena::suspended = 0;
+
+/**
+  * Constructor.
+  *
+  * Allocates the arena's memory as a single block, and makes it the source of the calling fiber's allocations.
+  *
+  * @param size The amount of memory to reserve, in bytes.
+  *
+  * @note If the memory cannot be allocated, the arena has a size of zero, and allocations are taken from the heap.
+  */
+MicroBitHeapArena::MicroBitHeapArena(int size)
+{
+    // If an arena is already active, ours is carved from it.
+    base = (size > 0 && currentFiber != NULL) ? (uint8_t *) malloc(size) : NULL;
+    top = base;
+    end = base ? base + size : NULL;
+    next = NULL;
+
+    // The list is only ever used by the fiber that owns it, so needs no protection from interrupts.
+    if (currentFiber != NULL)
+    {
+        next = currentFiber->arena;
+        currentFiber->arena = this;
+    }
+}
+
+/**
+  * Destructor.
+  *
+  * Returns the arena's memory to the heap, releasing everything allocated from it.
+  */
+MicroBitHeapArena::~MicroBitHeapArena()
+{
+    // Arenas are scoped, so we are normally the innermost arena of the fiber running us.
+    if (currentFiber != NULL)
+    {
+        MicroBitHeapArena **a = &currentFiber->arena;
+
+        while (*a != NULL && *a != this)
+            a = &(*a)->next;
+
+        if (*a == this)
+            *a = next;
+    }
+
+    free(base);
+}
+
+/**
+  * Determines the capacity of the arena.
+  *
+  * @return The amount of memory reserved by the arena, in bytes.
+  */
+int MicroBitHeapArena::size()
+{
+    return end - base;
+}
+
+/**
+  * Determines how much of the arena has been allocated.
+  *
+  * @return The amount of memory allocated from the arena, in bytes.
+  */
+int MicroBitHeapArena::used()
+{
+    return top - base;
+}
+
+/**
+  * Allocates memory for the caller from the innermost arena it has active, if any.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if the caller has no active arena, or it is full.
+  */
+void *MicroBitHeapArena::allocate(size_t size)
+{
+    if (currentFiber == NULL || currentFiber->arena == NULL || suspended || inInterruptContext())
+        return NULL;
+
+    MicroBitHeapArena *a = currentFiber->arena;
+
+    // Keep every allocation word aligned, and leave room for the word that marks it as arena memory.
+    size = ((size + 3) & ~3) + sizeof(uint32_t);
+
+    if (size > (size_t)(a->end - a->top))
+        return NULL;
+
+    uint32_t *p = (uint32_t *) a->top;
+    a->top += size;
+
+    *p = MICROBIT_HEAP_ARENA_BLOCK;
+
+    return p + 1;
+}
+
+/**
+  * Determines if the given memory was allocated from an arena, by any fiber.
+  *
+  * @param mem The memory to test, which must have been returned by microbit_malloc().
+  *
+  * @return true if the memory belongs to an arena, and must not be freed to the heap.
+  */
+bool MicroBitHeapArena::contains(void *mem)
+{
+    // The arenas of other fibers may be on stacks that are not currently in place, so we never walk them.
+    // Instead, each allocation is marked where a heap block would hold its header.
+    return *((uint32_t *) mem - 1) == MICROBIT_HEAP_ARENA_BLOCK;
+}
+/**
+  * Takes all allocations from the heap until resume() is called, even those made by a fiber with an active arena.
+  *
+  * Used by the runtime around allocations that must outlive any arena, such as fiber stacks and event queues.
+  * Calls may be nested, but must not span a context switch.
+  */
+void MicroBitHeapArena::suspend()
+{
+    // Interrupt handlers always balance their own calls, so an interrupted update leaves the count unchanged.
+    suspended++;
+}
+
+/**
+  * Undoes a call to suspend().
+  */
+void MicroBitHeapArena::resume()
+{
+    suspended--;
+}
@@ -30,6 +30,14 @@ DEALINGS IN THE SOFTWARE.
   */
 #include "MicroBitConfig.h"
 #include "MicroBitListener.h"
+#include "MicroBitHeapArena.h"
+
+#if MICROBIT_LISTENER_POOL_SIZE > 0
+// Storage for the pool of MicroBitListeners. Whilst free, the first word of each listener refers to the next free one.
+static uint32_t listenerPool[MICROBIT_LISTENER_POOL_SIZE][(sizeof(MicroBitListener) + 3) / 4];
+static void *listenerFreeList = NULL;
+static bool listenerPoolInitialised = false;
+#endif
 
 /**
   * Constructor.
@@ -54,6 +62,10 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, void (*handler)(
     this->flags = flags;
 	this->next = NULL;
     this->evt_queue = NULL;
+    this->dropped = 0;
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_ADAPTIVE)
+    this->streak = 0;
+#endif
 }
 
 /**
@@ -82,6 +94,10 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, void (*handler)(
     this->flags = flags | MESSAGE_BUS_LISTENER_PARAMETERISED;
 	this->next = NULL;
     this->evt_queue = NULL;
+    this->dropped = 0;
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_ADAPTIVE)
+    this->streak = 0;
+#endif
 }
 
 /**
@@ -89,13 +105,18 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, void (*handler)(
   */
 MicroBitListener::~MicroBitListener()
 {
-    if(this->flags & MESSAGE_BUS_LISTENER_METHOD)
-        delete cb_method;
+    // Any MemberFunctionCallback is held within the listener, and has nothing to release.
 }
 
 /**
   * Queues and event up to be processed.
   *
+  * If this listener was created with MESSAGE_BUS_LISTENER_COALESCE, an identical event (same source and value)
+  * already in the queue is replaced with the given event instead.
+  *
+  * If the queue is already MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH events deep, the event is dropped,
+  * and recorded in this listener's dropped count.
+  *
   * @param e The event to queue
   */
 void MicroBitListener::queue(MicroBitEvent e)
@@ -110,13 +131,100 @@ void MicroBitListener::queue(MicroBitEvent e)
     {
         queueDepth = 1;
 
-        while (p->next != NULL)
+        while (1)
         {
+            // If we only want the latest of each event, replace any identical event already waiting.
+            if ((flags & MESSAGE_BUS_LISTENER_COALESCE) && p->evt.source == e.source && p->evt.value == e.value)
+            {
+                p->evt = e;
+                return;
+            }
+
+            if (p->next == NULL)
+                break;
+
             p = p->next;
             queueDepth++;
         }
 
         if (queueDepth < MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH)
             p->next = new MicroBitEventQueueItem(e);
+        else if (dropped < 0xFFFF)
+            dropped++;
+    }
+}
+
+/**
+  * Allocates storage for a MicroBitListener.
+  *
+  * Listeners are taken from a statically allocated pool of MICROBIT_LISTENER_POOL_SIZE listeners where possible,
+  * such that listening for an event does not normally require a heap allocation. If the pool is exhausted,
+  * the listener is allocated from the heap.
+  *
+  * @param size The amount of memory required, in bytes.
+  *
+  * @return A pointer to the memory allocated, or NULL if no memory is available.
+  */
+void *MicroBitListener::operator new(size_t size)
+{
+#if MICROBIT_LISTENER_POOL_SIZE > 0
+    void *listener = NULL;
+
+    // Listeners may be created by components from interrupt context, so ensure no race conditions.
+    __disable_irq();
+
+    // Thread all listeners in the pool onto the free list on first use.
+    if (!listenerPoolInitialised)
+    {
+        for (int i = 0; i < MICROBIT_LISTENER_POOL_SIZE; i++)
+        {
+            *(void **)listenerPool[i] = listenerFreeList;
+            listenerFreeList = listenerPool[i];
+        }
+
+        listenerPoolInitialised = true;
     }
+
+    if (size <= sizeof(listenerPool[0]) && listenerFreeList != NULL)
+    {
+        listener = listenerFreeList;
+        listenerFreeList = *(void **)listener;
+    }
+
+    __enable_irq();
+
+    if (listener != NULL)
+        return listener;
+#endif
+
+    // Listeners outlive any arena of the fiber that registers them, so always use the heap.
+    MicroBitHeapArena::suspend();
+    void *p = malloc(size);
+    MicroBitHeapArena::resume();
+
+    return p;
+}
+
+/**
+  * Releases storage for a MicroBitListener, returning it to the pool if it was taken from there.
+  *
+  * @param ptr The memory to release.
+  */
+void MicroBitListener::operator delete(void *ptr)
+{
+#if MICROBIT_LISTENER_POOL_SIZE > 0
+    if (ptr >= (void *)listenerPool[0] && ptr < (void *)listenerPool[MICROBIT_LISTENER_POOL_SIZE])
+    {
+        __disable_irq();
+
+        *(void **)ptr = listenerFreeList;
+        listenerFreeList = ptr;
+
+        __enable_irq();
+
+        return;
+    }
+#endif
+
+    free(ptr);
 }
@@ -36,24 +36,59 @@ DEALINGS IN THE SOFTWARE.
   */
 #include "MicroBitConfig.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitTrace.h"
 #include "ErrorNo.h"
 
 /*
- * Time since power on. Measured in milliseconds.
- * When stored as an unsigned long, this gives us approx 50 days between rollover, which is ample. :-)
+ * Time since power on, in microseconds, as of the most recent call to update_time().
  */
 static uint64_t time_us = 0;
 static unsigned int tick_period = 0;
 
+/*
+ * System time is extended from the free running 32 bit us_ticker, which wraps every 71 minutes.
+ * Each epoch records the system time at a given ticker value. update_time() writes a new epoch into
+ * the unused slot before publishing it, so readers never see one half written, and need no lock.
+ */
+struct SystemTimerEpoch
+{
+    uint64_t time_us;
+    uint32_t ticker_us;
+};
+
+static SystemTimerEpoch epochs[2];
+static volatile uint32_t epoch_index = 0;
+
 // Array of components which are iterated during a system tick
 static MicroBitComponent* systemTickComponents[MICROBIT_SYSTEM_COMPONENTS];
 
+// The number of tick periods between callbacks to each system component, and the number remaining until each is next due.
+static uint16_t systemTickPeriod[MICROBIT_SYSTEM_COMPONENTS];
+static uint16_t systemTickCountdown[MICROBIT_SYSTEM_COMPONENTS];
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+// The shortest interval the one shot timer is programmed for, in microseconds.
+#define SYSTEM_TIMER_MIN_INTERVAL_US    100
+
+// Sentinel value indicating that no wake up time has been requested.
+#define SYSTEM_TIMER_NO_WAKE        0xFFFFFFFFFFFFFFFFULL
+
+// The earliest wake up time requested through system_timer_wake_at(), in microseconds.
+static uint64_t wake_time_us = SYSTEM_TIMER_NO_WAKE;
+
+// The time at which the next timer interrupt is programmed to occur, in microseconds.
+static uint64_t next_tick_us = 0;
+
+// The time of the next tick period boundary, at which periodic components may become due, in microseconds.
+static uint64_t period_tick_us = 0;
+#else
+// The time of the most recent periodic timer interrupt, in microseconds.
+static uint64_t last_tick_us = 0;
+#endif
+
 // Periodic callback interrupt
 static Ticker *ticker = NULL;
 
-// System timer.
-static Timer *timer = NULL;
-
 
 /**
   * Initialises a system wide timer, used to drive the various components used in the runtime.
@@ -67,16 +102,53 @@ static Timer *timer = NULL;
 int system_timer_init(int period)
 {
     if (ticker == NULL)
+    {
+        // Time since power on is measured from here.
+        epochs[epoch_index & 1].ticker_us = us_ticker_read();
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+        ticker = new Timeout();
+#else
         ticker = new Ticker();
+#endif
+    }
+
+    return system_timer_set_period(period);
+}
 
-    if (timer == NULL)
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+/**
+  * Programs the next system timer interrupt for the earliest time it is required: the tick period at which
+  * the next periodic component is due, or the earliest requested wake up time.
+  *
+  * Must be called with up to date time, and with interrupts disabled or from the timer interrupt itself.
+  */
+static void system_timer_reschedule()
+{
+    uint64_t next = time_us + (uint64_t) MICROBIT_SYSTEM_TIMER_TICKLESS_MAX_MS * 1000;
+
+    for (int i = 0; i < MICROBIT_SYSTEM_COMPONENTS; i++)
     {
-        timer = new Timer();
-        timer->start();
+        if (systemTickComponents[i] != NULL && systemTickPeriod[i] != MICROBIT_SYSTEM_TICK_ON_DEMAND)
+        {
+            uint64_t due = period_tick_us + (uint64_t)(systemTickCountdown[i] - 1) * tick_period * 1000;
+
+            if (due < next)
+                next = due;
+        }
     }
 
-    return system_timer_set_period(period);
+    if (wake_time_us < next)
+        next = wake_time_us;
+
+    // Don't set deadlines in the past, or so close that they may be missed.
+    if (next < time_us + SYSTEM_TIMER_MIN_INTERVAL_US)
+        next = time_us + SYSTEM_TIMER_MIN_INTERVAL_US;
+
+    next_tick_us = next;
+    ticker->attach_us(system_timer_tick, (uint32_t)(next - time_us));
 }
+#endif
 
 /**
   * Reconfigures the system wide timer to the given period in milliseconds.
@@ -96,7 +168,13 @@ int system_timer_set_period(int period)
 
 	// register a period callback to drive the scheduler and any other registered components.
     tick_period = period;
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    update_time();
+    system_timer_reschedule();
+#else
     ticker->attach_us(system_timer_tick, period * 1000);
+#endif
 
     return MICROBIT_OK;
 }
@@ -114,17 +192,34 @@ int system_timer_get_period()
 /**
   * Updates the current time in microseconds, since power on.
   *
-  * If the mbed Timer hasn't been initialised, it will be initialised
+  * If the system timer hasn't been initialised, it will be initialised
   * on the first call to this function.
+  *
+  * This also starts a new epoch, and so must be called at least once every 71 minutes, before the
+  * us_ticker wraps. The system timer interrupt does so.
   */
 void update_time()
 {
     // If we haven't been initialized, bring up the timer with the default period.
-    if (timer == NULL || ticker == NULL)
+    if (ticker == NULL)
         system_timer_init(SYSTEM_TICK_PERIOD_MS);
 
-    time_us += timer->read_us();
-    timer->reset();
+    // This may be called both from thread context and the timer interrupt, so updates must not interleave.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t index = epoch_index;
+    SystemTimerEpoch *current = &epochs[index & 1];
+    SystemTimerEpoch *next = &epochs[(index + 1) & 1];
+    uint32_t now = us_ticker_read();
+
+    time_us = current->time_us + (uint32_t)(now - current->ticker_us);
+
+    next->time_us = time_us;
+    next->ticker_us = now;
+    epoch_index = index + 1;
+
+    __set_PRIMASK(primask);
 }
 
 /**
@@ -140,12 +235,29 @@ uint64_t system_timer_current_time()
 /**
   * Determines the time since the device was powered on.
   *
+  * This only reads the us_ticker and the current epoch, and so is cheap enough to timestamp every event.
+  * It never blocks interrupts: if the epoch changes whilst it is being read, it is simply read again.
+  *
   * @return the current time since power on in microseconds
   */
 uint64_t system_timer_current_time_us()
 {
-    update_time();
-    return time_us;
+    uint32_t index;
+    uint32_t now;
+    SystemTimerEpoch epoch;
+
+    // If we haven't been initialized, bring up the timer with the default period.
+    if (ticker == NULL)
+        system_timer_init(SYSTEM_TICK_PERIOD_MS);
+
+    do
+    {
+        index = epoch_index;
+        epoch = epochs[index & 1];
+        now = us_ticker_read();
+    } while (index != epoch_index);
+
+    return epoch.time_us + (uint32_t)(now - epoch.ticker_us);
 }
 
 /**
@@ -156,12 +268,109 @@ uint64_t system_timer_current_time_us()
   */
 void system_timer_tick()
 {
+    // The number of tick periods that have passed since the last interrupt.
+    uint32_t elapsed = 1;
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_SYSTEM_TIMER, 0);
+
     update_time();
 
-    // Update any components registered for a callback
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    // Any requested wake up time has now been reached. Components will request another if necessary.
+    if (wake_time_us <= time_us)
+        wake_time_us = SYSTEM_TIMER_NO_WAKE;
+
+    // Interrupts may occur off the tick period, or skip several, so determine how many boundaries we have crossed.
+    elapsed = 0;
+    if (period_tick_us <= time_us)
+    {
+        elapsed = (time_us - period_tick_us) / (tick_period * 1000) + 1;
+        period_tick_us += (uint64_t) elapsed * tick_period * 1000;
+    }
+#else
+    last_tick_us = time_us;
+#endif
+
+    // Update any components registered for a callback that are now due.
     for(int i = 0; i < MICROBIT_SYSTEM_COMPONENTS; i++)
-        if(systemTickComponents[i] != NULL)
-            systemTickComponents[i]->systemTick();
+    {
+        if(systemTickComponents[i] == NULL)
+            continue;
+
+        if (systemTickPeriod[i] != MICROBIT_SYSTEM_TICK_ON_DEMAND)
+        {
+            if (systemTickCountdown[i] > elapsed)
+            {
+                systemTickCountdown[i] -= elapsed;
+                continue;
+            }
+
+            systemTickCountdown[i] = systemTickPeriod[i];
+        }
+
+        systemTickComponents[i]->systemTick();
+    }
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    system_timer_reschedule();
+#endif
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_SYSTEM_TIMER, 0);
+}
+
+/**
+  * Requests that the system timer interrupt occurs no later than the given time.
+  *
+  * In tickless mode, this is used to wake the processor for the next timed event, such as the
+  * wake up time of a sleeping fiber. Otherwise, the periodic tick is sufficient, and this has no effect.
+  *
+  * @param time The time since power on at which an interrupt is required, in milliseconds.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int system_timer_wake_at(uint64_t time)
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    uint64_t t = time * 1000;
+
+    // If we haven't been initialized, bring up the timer with the default period.
+    if (ticker == NULL)
+        system_timer_init(SYSTEM_TICK_PERIOD_MS);
+
+    __disable_irq();
+
+    if (t < wake_time_us)
+    {
+        wake_time_us = t;
+
+        // Bring the next interrupt forward if necessary.
+        if (wake_time_us < next_tick_us)
+        {
+            update_time();
+            system_timer_reschedule();
+        }
+    }
+
+    __enable_irq();
+#endif
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines when the next system timer interrupt is expected.
+  *
+  * Used to estimate how long the processor may sleep for. Other interrupts may of course occur sooner.
+  *
+  * @return The time since power on at which the next system timer interrupt is due, in microseconds.
+  */
+uint64_t system_timer_next_interrupt_us()
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    return next_tick_us;
+#else
+    return last_tick_us + (uint64_t) tick_period * 1000;
+#endif
 }
 
 /**
@@ -170,25 +379,55 @@ void system_timer_tick()
   *
   * @param component The component to add.
   *
+  * @param ticks The number of tick periods between callbacks to the component. If MICROBIT_SYSTEM_TICK_ON_DEMAND,
+  *              the component is called at every timer interrupt, but does not itself require any. In tickless mode,
+  *              such components are only called at interrupts that occur for other reasons, for example those
+  *              requested through system_timer_wake_at().
+  *
   * @return MICROBIT_OK on success. MICROBIT_NO_RESOURCES is returned if the component array is full.
   *
   * @note The callback will be in interrupt context.
   */
-int system_timer_add_component(MicroBitComponent *component)
+int system_timer_add_component(MicroBitComponent *component, uint16_t ticks)
 {
     int i = 0;
 
     // If we haven't been initialized, bring up the timer with the default period.
-    if (timer == NULL || ticker == NULL)
+    if (ticker == NULL)
         system_timer_init(SYSTEM_TICK_PERIOD_MS);
 
-    while(systemTickComponents[i] != NULL && i < MICROBIT_SYSTEM_COMPONENTS)
+    // Components may be added from interrupt context, so claim a slot atomically.
+    __disable_irq();
+
+    while(i < MICROBIT_SYSTEM_COMPONENTS && systemTickComponents[i] != NULL)
         i++;
 
     if(i == MICROBIT_SYSTEM_COMPONENTS)
+    {
+        __enable_irq();
         return MICROBIT_NO_RESOURCES;
+    }
 
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    // If no other component requires periodic callbacks, the tick period boundaries may have lapsed, so restart them.
+    update_time();
+
+    if (ticks != MICROBIT_SYSTEM_TICK_ON_DEMAND && period_tick_us <= time_us)
+        period_tick_us = time_us + tick_period * 1000;
+#endif
+
+    systemTickPeriod[i] = ticks;
+    systemTickCountdown[i] = ticks;
     systemTickComponents[i] = component;
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_TICKLESS)
+    // The new component may be due before the timer is next programmed to fire.
+    if (ticks != MICROBIT_SYSTEM_TICK_ON_DEMAND)
+        system_timer_reschedule();
+#endif
+
+    __enable_irq();
+
     return MICROBIT_OK;
 }
 
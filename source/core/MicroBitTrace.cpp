@@ -0,0 +1,184 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A fixed size ring buffer of binary trace records, used to debug timing issues without
+  * the perturbation caused by printing debug messages as they occur.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitTrace.h"
+#include "ErrorNo.h"
+
+#if CONFIG_ENABLED(MICROBIT_TRACE)
+// The trace records. The oldest record is overwritten once the buffer is full.
+static MicroBitTraceRecord traceBuffer[MICROBIT_TRACE_BUFFER_SIZE];
+
+// The total number of records made. Records are written at traceCount modulo the buffer size, which is a power of two.
+static uint32_t traceCount = 0;
+
+// Set whilst records are being made.
+static volatile bool traceEnabled = true;
+#endif
+
+/**
+  * Adds a record to the trace buffer, overwriting the oldest record if the buffer is full.
+  *
+  * May be called from interrupt context. Has no effect whilst recording is disabled.
+  * Normally used through the MICROBIT_TRACE_RECORD macro, which compiles to nothing unless MICROBIT_TRACE is enabled.
+  *
+  * @param type The type of record, one of MICROBIT_TRACE_*.
+  *
+  * @param id The first record specific value.
+  *
+  * @param value The second record specific value.
+  */
+void microbit_trace(uint16_t type, uint16_t id, uint32_t value)
+{
+#if CONFIG_ENABLED(MICROBIT_TRACE)
+    if (!traceEnabled)
+        return;
+
+    // Interrupt handlers record traces too, so ensure each record is written whole.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    MicroBitTraceRecord *r = &traceBuffer[traceCount++ & (MICROBIT_TRACE_BUFFER_SIZE - 1)];
+    r->time = us_ticker_read();
+    r->type = type;
+    r->id = id;
+    r->value = value;
+
+    __set_PRIMASK(primask);
+#else
+    (void) type;
+    (void) id;
+    (void) value;
+#endif
+}
+
+/**
+  * Enables or disables recording into the trace buffer. Recording is enabled by default.
+  *
+  * Disabling recording freezes the contents of the buffer, for example once the problem of interest has occurred.
+  *
+  * @param enable true to record, false to stop recording.
+  */
+void microbit_trace_enable(bool enable)
+{
+#if CONFIG_ENABLED(MICROBIT_TRACE)
+    traceEnabled = enable;
+#else
+    (void) enable;
+#endif
+}
+
+/**
+  * Discards all records held in the trace buffer.
+  */
+void microbit_trace_clear()
+{
+#if CONFIG_ENABLED(MICROBIT_TRACE)
+    __disable_irq();
+    traceCount = 0;
+    __enable_irq();
+#endif
+}
+
+/**
+  * Copies records out of the trace buffer, oldest first, such that they can be sent elsewhere (for example over BLE).
+  *
+  * @param buffer The memory to copy records into.
+  *
+  * @param length The maximum number of records to copy.
+  *
+  * @param start The number of records to skip, counting from the oldest. Defaults to 0.
+  *
+  * @return The number of records copied, or MICROBIT_INVALID_PARAMETER if buffer is NULL or length is negative.
+  *
+  * @note Recording should be disabled whilst reading the buffer in several parts, so that it does not move between reads.
+  */
+int microbit_trace_read(MicroBitTraceRecord *buffer, int length, int start)
+{
+    if (buffer == NULL || length < 0 || start < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+#if CONFIG_ENABLED(MICROBIT_TRACE)
+    int copied = 0;
+
+    __disable_irq();
+
+    // The oldest record still held, and the number of records held.
+    uint32_t oldest = traceCount > MICROBIT_TRACE_BUFFER_SIZE ? traceCount - MICROBIT_TRACE_BUFFER_SIZE : 0;
+    uint32_t held = traceCount - oldest;
+
+    for (uint32_t i = start; i < held && copied < length; i++)
+        buffer[copied++] = traceBuffer[(oldest + i) & (MICROBIT_TRACE_BUFFER_SIZE - 1)];
+
+    __enable_irq();
+
+    return copied;
+#else
+    return 0;
+#endif
+}
+
+/**
+  * Prints the contents of the trace buffer, oldest first, one record per line.
+  *
+  * Recording is disabled whilst the buffer is printed, and restored afterwards.
+  *
+  * @param serial The serial port to print to, for example uBit.serial.
+  *
+  * @return The number of records printed.
+  */
+int microbit_trace_dump(RawSerial &serial)
+{
+#if CONFIG_ENABLED(MICROBIT_TRACE)
+    MicroBitTraceRecord r;
+    bool enabled = traceEnabled;
+    int printed = 0;
+
+    traceEnabled = false;
+
+    // Times are printed relative to the oldest record, which is simpler to read than the raw ticker.
+    uint32_t base = 0;
+
+    while (microbit_trace_read(&r, 1, printed) == 1)
+    {
+        if (printed == 0)
+            base = r.time;
+
+        serial.printf("%lu %u %u %lu\r\n", (unsigned long)(r.time - base), r.type, r.id, (unsigned long)r.value);
+        printed++;
+    }
+
+    traceEnabled = enabled;
+
+    return printed;
+#else
+    (void) serial;
+    return 0;
+#endif
+}
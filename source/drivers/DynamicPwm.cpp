@@ -33,35 +33,310 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "DynamicPwm.h"
 #include "MicroBitPin.h"
+#include "TimedInterruptIn.h"
 #include "ErrorNo.h"
+#include "MicroBitTrace.h"
 
 uint32_t DynamicPwm::period = MICROBIT_DEFAULT_PWM_PERIOD;
+DynamicPwm* DynamicPwm::pool[MICROBIT_PWM_CHANNELS] = { NULL };
 
+#if MICROBIT_PWM_SOFTWARE_CHANNELS > 0
 /**
-  * An internal constructor used when allocating a new DynamicPwm instance.
+  * Interrupt handler for TIMER1, whilst it times the software channels.
+  */
+extern "C" void TIMER1_IRQHandler(void)
+{
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_PWM, 0);
+    DynamicPwm::onTimer();
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_PWM, 0);
+}
+
+/**
+  * Starts TIMER1 counting out the period of the software channels, at 1MHz.
+  * CC[1] marks the end of each period, and CC[0] the next falling edge.
+  */
+static void startSoftwareTimer(uint32_t period)
+{
+    NRF_TIMER1->TASKS_STOP = 1;
+    NRF_TIMER1->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER1->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+    NRF_TIMER1->PRESCALER = 4;
+    NRF_TIMER1->CC[1] = period;
+    NRF_TIMER1->SHORTS = TIMER_SHORTS_COMPARE1_CLEAR_Msk;
+    NRF_TIMER1->EVENTS_COMPARE[0] = 0;
+    NRF_TIMER1->EVENTS_COMPARE[1] = 0;
+    NRF_TIMER1->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk;
+    NRF_TIMER1->INTENSET = TIMER_INTENSET_COMPARE1_Msk;
+
+    NVIC_ClearPendingIRQ(TIMER1_IRQn);
+    NVIC_EnableIRQ(TIMER1_IRQn);
+
+    NRF_TIMER1->TASKS_CLEAR = 1;
+    NRF_TIMER1->TASKS_START = 1;
+}
+
+/**
+  * Stops TIMER1, leaving it free for use elsewhere.
+  */
+static void stopSoftwareTimer()
+{
+    NVIC_DisableIRQ(TIMER1_IRQn);
+
+    NRF_TIMER1->TASKS_STOP = 1;
+    NRF_TIMER1->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk | TIMER_INTENCLR_COMPARE1_Msk;
+    NRF_TIMER1->SHORTS = 0;
+}
+#endif
+
+/**
+  * Constructor. Creates the given entry in the pool of channels.
+  *
+  * @param channel the position of the channel in the pool.
+  */
+DynamicPwm::DynamicPwm(int channel)
+{
+    this->hardware = NULL;
+    this->pin = NC;
+    this->channel = channel;
+    this->allocated = false;
+    this->width = 0;
+    this->lastValue = 0;
+}
+
+/**
+  * Brings this channel into use on the given pin, with a duty cycle of zero.
+  *
+  * @param pin the name of the pin for the pwm to target
+  */
+void DynamicPwm::attach(PinName pin)
+{
+    this->pin = pin;
+    this->width = 0;
+    this->lastValue = 0;
+
+    if (channel < MICROBIT_PWM_HARDWARE_CHANNELS)
+    {
+        // mbed resets the period of the whole module as each channel is created, so restore our own.
+        hardware = new PwmOut(pin);
+        hardware->period_us(period);
+        hardware->write(0);
+
+        for (int i = 0; i < MICROBIT_PWM_HARDWARE_CHANNELS; i++)
+            if (pool[i] && pool[i]->allocated)
+                pool[i]->write(pool[i]->lastValue);
+    }
+#if MICROBIT_PWM_SOFTWARE_CHANNELS > 0
+    else
+    {
+        NRF_GPIO->OUTCLR = 1 << pin;
+        NRF_GPIO->DIRSET = 1 << pin;
+
+        if (getSoftwareChannelsInUse() == 0)
+            startSoftwareTimer(period);
+    }
+#endif
+
+    allocated = true;
+}
+
+/**
+  * Obtains a PWM channel for the given pin. A channel already driving the pin is returned if there is one,
+  * otherwise the first free channel is used, preferring hardware channels.
   *
   * @param pin the name of the pin for the pwm to target
   *
-  * @param persistance the level of persistence for this pin PWM_PERSISTENCE_PERSISTENT (can not be replaced until freed, should only be used for system services really.)
-  *                    or PWM_PERSISTENCE_TRANSIENT (can be replaced at any point if a channel is required.)
+  * @return The channel, or NULL if every channel is in use.
+  *
+  * @code
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
+  * @endcode
+  */
+DynamicPwm* DynamicPwm::allocate(PinName pin)
+{
+    for (int i = 0; i < MICROBIT_PWM_CHANNELS; i++)
+        if (pool[i] && pool[i]->allocated && pool[i]->pin == pin)
+            return pool[i];
+
+    for (int i = 0; i < MICROBIT_PWM_CHANNELS; i++)
+    {
+        // Software channels share TIMER1 with hardware capture, and can't time a longer period.
+        if (i >= MICROBIT_PWM_HARDWARE_CHANNELS && (TimedInterruptIn::isCaptureActive() || period > MICROBIT_PWM_SOFTWARE_MAX_PERIOD))
+            break;
+
+        if (pool[i] == NULL)
+            pool[i] = new DynamicPwm(i);
+
+        if (!pool[i]->allocated)
+        {
+            pool[i]->attach(pin);
+            return pool[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+  * Determines the number of PWM channels in use.
+  *
+  * @return The number of channels in use.
+  */
+int DynamicPwm::getChannelsInUse()
+{
+    int count = 0;
+
+    for (int i = 0; i < MICROBIT_PWM_CHANNELS; i++)
+        if (pool[i] && pool[i]->allocated)
+            count++;
+
+    return count;
+}
+
+/**
+  * Determines the number of software PWM channels in use.
+  *
+  * @return The number of software channels in use. Whilst non-zero, TIMER1 is unavailable for hardware capture.
+  */
+int DynamicPwm::getSoftwareChannelsInUse()
+{
+    int count = 0;
+
+    for (int i = MICROBIT_PWM_HARDWARE_CHANNELS; i < MICROBIT_PWM_CHANNELS; i++)
+        if (pool[i] && pool[i]->allocated)
+            count++;
+
+    return count;
+}
+
+/**
+  * Determines the number of PWM channels that could still be allocated.
+  *
+  * @return The number of free channels. Software channels are not available whilst TIMER1 is used for hardware capture.
   */
-DynamicPwm::DynamicPwm(PinName pin) : PwmOut(pin)
+int DynamicPwm::getChannelsFree()
 {
+    int count = 0;
+
+    for (int i = 0; i < MICROBIT_PWM_CHANNELS; i++)
+    {
+        if (i >= MICROBIT_PWM_HARDWARE_CHANNELS && (TimedInterruptIn::isCaptureActive() || period > MICROBIT_PWM_SOFTWARE_MAX_PERIOD))
+            break;
+
+        if (pool[i] == NULL || !pool[i]->allocated)
+            count++;
+    }
+
+    return count;
 }
 
 /**
   * Frees this DynamicPwm instance for reuse.
   *
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate();
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   * pwm->release();
   * @endcode
   */
-DynamicPwm::~DynamicPwm()
+void DynamicPwm::release()
+{
+    if (!allocated)
+        return;
+
+    allocated = false;
+
+    if (hardware)
+    {
+        delete hardware;
+        hardware = NULL;
+    }
+#if MICROBIT_PWM_SOFTWARE_CHANNELS > 0
+    else
+    {
+        NRF_GPIO->OUTCLR = 1 << pin;
+
+        if (getSoftwareChannelsInUse() == 0)
+            stopSoftwareTimer();
+    }
+#endif
+
+    pin = NC;
+}
+
+/**
+  * Determines if this channel is generated in hardware.
+  *
+  * @return true for a hardware channel, or false for a channel generated in software.
+  */
+bool DynamicPwm::isHardware()
+{
+    return channel < MICROBIT_PWM_HARDWARE_CHANNELS;
+}
+
+#if MICROBIT_PWM_SOFTWARE_CHANNELS > 0
+/**
+  * Generates the edges of the software channels. Called from the TIMER1 interrupt, at the start of each
+  * period and at each falling edge.
+  *
+  * @note should only be called from TIMER1_IRQHandler...
+  */
+void DynamicPwm::onTimer()
 {
-    //free the pwm instance.
-    pwmout_free(&_pwm);
+    uint32_t high = 0;
+
+    if (NRF_TIMER1->EVENTS_COMPARE[1])
+    {
+        NRF_TIMER1->EVENTS_COMPARE[1] = 0;
+        NRF_TIMER1->EVENTS_COMPARE[0] = 0;
+
+        for (int i = MICROBIT_PWM_HARDWARE_CHANNELS; i < MICROBIT_PWM_CHANNELS; i++)
+            if (pool[i] && pool[i]->allocated && pool[i]->width > 0)
+                high |= 1 << pool[i]->pin;
+
+        NRF_GPIO->OUTSET = high;
+    }
+
+    NRF_TIMER1->EVENTS_COMPARE[0] = 0;
+
+    // Lower every channel whose pulse has ended, and wait for the next. Interrupts may have delayed us past
+    // several edges, so measure the time directly rather than trusting CC[0], and check again after setting it.
+    while (true)
+    {
+        uint32_t low = 0;
+        uint32_t next = period;
+
+        NRF_TIMER1->TASKS_CAPTURE[2] = 1;
+        uint32_t now = NRF_TIMER1->CC[2];
+
+        for (int i = MICROBIT_PWM_HARDWARE_CHANNELS; i < MICROBIT_PWM_CHANNELS; i++)
+        {
+            if (pool[i] == NULL || !pool[i]->allocated)
+                continue;
+
+            uint32_t w = pool[i]->width;
+
+            if (w <= now)
+                low |= 1 << pool[i]->pin;
+            else if (w < next)
+                next = w;
+        }
+
+        NRF_GPIO->OUTCLR = low;
+
+        if (next >= period)
+        {
+            NRF_TIMER1->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk;
+            break;
+        }
+
+        NRF_TIMER1->CC[0] = next;
+        NRF_TIMER1->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+
+        NRF_TIMER1->TASKS_CAPTURE[2] = 1;
+        if (NRF_TIMER1->CC[2] < next)
+            break;
+    }
 }
+#endif
 
 /**
   * A lightweight wrapper around the super class' write in order to capture the value
@@ -71,7 +346,7 @@ DynamicPwm::~DynamicPwm()
   * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range
   *
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate();
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   * pwm->write(0.5);
   * @endcode
   */
@@ -80,19 +355,53 @@ int DynamicPwm::write(float value){
     if(value < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    PwmOut::write(value);
+    if (hardware)
+        hardware->write(value);
+    else
+        width = value >= 1.0f ? period : (uint16_t)(value * period);
+
     lastValue = value;
 
     return MICROBIT_OK;
 }
 
+/**
+  * Sets the pulse width of this channel.
+  *
+  * @param width the time for which the output is high in each period, in microseconds.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if width is negative.
+  *
+  * @code
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
+  * pwm->pulsewidth_us(1500);
+  * @endcode
+  */
+int DynamicPwm::pulsewidth_us(int width)
+{
+    if (width < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if ((uint32_t)width > period)
+        width = period;
+
+    if (hardware)
+        hardware->pulsewidth_us(width);
+    else
+        this->width = width;
+
+    lastValue = (float)width / (float)period;
+
+    return MICROBIT_OK;
+}
+
 /**
   * Retrieves the PinName associated with this DynamicPwm instance.
   *
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   *
-  * // returns the PinName n.
+  * // returns MICROBIT_PIN_P0.
   * pwm->getPinName();
   * @endcode
   *
@@ -101,15 +410,14 @@ int DynamicPwm::write(float value){
   */
 PinName DynamicPwm::getPinName()
 {
-    return _pwm.pin;
+    return pin;
 }
-
 /**
   * Retrieves the last value that has been written to this DynamicPwm instance.
   * in the range 0 - 1023 inclusive.
   *
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   * pwm->write(0.5);
   *
   * // will return 512.
@@ -126,7 +434,7 @@ int DynamicPwm::getValue()
   *
   * Example:
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   * pwm->getPeriod();
   * @endcode
   */
@@ -140,7 +448,7 @@ uint32_t DynamicPwm::getPeriodUs()
   *
   * Example:
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   * pwm->setPeriodUs(20000);
   *
   * // will return 20000
@@ -161,7 +469,7 @@ uint32_t DynamicPwm::getPeriod()
   *
   * Example:
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   *
   * // period now is 20ms
   * pwm->setPeriodUs(20000);
@@ -171,11 +479,38 @@ uint32_t DynamicPwm::getPeriod()
   */
 int DynamicPwm::setPeriodUs(uint32_t period)
 {
-    period_us(period);
-    write(lastValue);
+    if (period == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Software channels are timed by a 16 bit counter.
+    if (period > MICROBIT_PWM_SOFTWARE_MAX_PERIOD && getSoftwareChannelsInUse())
+        return MICROBIT_INVALID_PARAMETER;
 
     this->period = period;
 
+    // The hardware channels share a single timer, so this sets the period of all of them.
+    for (int i = 0; i < MICROBIT_PWM_HARDWARE_CHANNELS; i++)
+    {
+        if (pool[i] && pool[i]->allocated)
+        {
+            pool[i]->hardware->period_us(period);
+            break;
+        }
+    }
+
+#if MICROBIT_PWM_SOFTWARE_CHANNELS > 0
+    if (getSoftwareChannelsInUse())
+    {
+        NRF_TIMER1->CC[1] = period;
+        NRF_TIMER1->TASKS_CLEAR = 1;
+    }
+#endif
+
+    // Hold the duty cycle of every channel, now that the period has changed beneath them.
+    for (int i = 0; i < MICROBIT_PWM_CHANNELS; i++)
+        if (pool[i] && pool[i]->allocated)
+            pool[i]->write(pool[i]->lastValue);
+
     return MICROBIT_OK;
 }
 
@@ -188,7 +523,7 @@ int DynamicPwm::setPeriodUs(uint32_t period)
   *
   * Example:
   * @code
-  * DynamicPwm* pwm = DynamicPwm::allocate(PinName n);
+  * DynamicPwm* pwm = DynamicPwm::allocate(MICROBIT_PIN_P0);
   *
   * // period now is 20ms
   * pwm->setPeriod(20);
@@ -201,6 +201,10 @@ MicroBitAccelerometer::MicroBitAccelerometer(MicroBitI2C& _i2c, uint16_t address
     this->shake.impulse_6 = 1;
     this->shake.impulse_8 = 1;
 
+    // Batch mode is disabled until requested.
+    this->batchSize = 0;
+    this->batchCount = 0;
+
     // Configure and enable the accelerometer.
     if (this->configure() == MICROBIT_OK)
         status |= MICROBIT_COMPONENT_RUNNING;
@@ -243,6 +247,18 @@ int MicroBitAccelerometer::whoAmI()
   */
 int MicroBitAccelerometer::updateSample()
 {
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+    // Samples are read in the background as the data ready line is asserted.
+    if(!(status & MICROBIT_ACCEL_INTERRUPT_ENABLED))
+    {
+        int1.fall(this, &MicroBitAccelerometer::onDataReady);
+        status |= MICROBIT_ACCEL_INTERRUPT_ENABLED;
+    }
+
+    // Catch up if we missed an edge, such as one before the interrupt was attached.
+    if(!int1)
+        startSampleRead();
+#else
     if(!(status & MICROBIT_ACCEL_ADDED_TO_IDLE))
     {
         fiber_add_idle_component(this);
@@ -253,47 +269,156 @@ int MicroBitAccelerometer::updateSample()
     // n.b. Default is Active LO. Interrupt is cleared in data read.
     if(!int1)
     {
-        int8_t data[6];
+        uint8_t data[6];
         int result;
 
-        result = readCommand(MMA8653_OUT_X_MSB, (uint8_t *)data, 6);
+        result = readCommand(MMA8653_OUT_X_MSB, data, 6);
         if (result !=0)
             return MICROBIT_I2C_ERROR;
 
-        // read MSB values...
-        sample.x = data[0];
-        sample.y = data[2];
-        sample.z = data[4];
+        processSample(data, us_ticker_read());
+    }
+#endif
 
-        // Normalize the data in the 0..1024 range.
-        sample.x *= 8;
-        sample.y *= 8;
-        sample.z *= 8;
+    return MICROBIT_OK;
+};
+
+/**
+  * Converts the raw contents of the output registers into a new sample, and
+  * signals that it is available.
+  *
+  * @param data The six output registers, starting with the X axis MSB.
+  *
+  * @param timestamp The time the sample became ready, in microseconds.
+  */
+void MicroBitAccelerometer::processSample(uint8_t *data, uint32_t timestamp)
+{
+    int8_t *sampleBytes = (int8_t *)data;
+
+    // read MSB values...
+    sample.x = sampleBytes[0];
+    sample.y = sampleBytes[2];
+    sample.z = sampleBytes[4];
+
+    // Normalize the data in the 0..1024 range.
+    sample.x *= 8;
+    sample.y *= 8;
+    sample.z *= 8;
 
 #if CONFIG_ENABLED(USE_ACCEL_LSB)
-        // Add in LSB values.
-        sample.x += (data[1] / 64);
-        sample.y += (data[3] / 64);
-        sample.z += (data[5] / 64);
+    // Add in LSB values.
+    sample.x += (sampleBytes[1] / 64);
+    sample.y += (sampleBytes[3] / 64);
+    sample.z += (sampleBytes[5] / 64);
 #endif
 
-        // Scale into millig (approx!)
-        sample.x *= this->sampleRange;
-        sample.y *= this->sampleRange;
-        sample.z *= this->sampleRange;
+    // Scale into millig (approx!)
+    sample.x *= this->sampleRange;
+    sample.y *= this->sampleRange;
+    sample.z *= this->sampleRange;
+
+    // Indicate that pitch and roll data is now stale, and needs to be recalculated if needed.
+    status &= ~MICROBIT_ACCEL_PITCH_ROLL_VALID;
+
+    // Update gesture tracking
+    updateGesture();
 
-        // Indicate that pitch and roll data is now stale, and needs to be recalculated if needed.
-        status &= ~MICROBIT_ACCEL_PITCH_ROLL_VALID;
+    if (batchSize)
+    {
+        MicroBitAccelerometerBatchSample s;
+
+        s.timestamp = timestamp;
+        s.x = sample.x;
+        s.y = sample.y;
+        s.z = sample.z;
 
-        // Update gesture tracking
-        updateGesture();
+        // If nobody is collecting the samples, drop the newest rather than disturb those already buffered.
+        if (batch.push(s) == MICROBIT_OK && ++batchCount >= batchSize)
+        {
+            batchCount = 0;
+            MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_BATCH_READY);
+        }
 
-        // Indicate that a new sample is available
-        MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
+        return;
     }
 
-    return MICROBIT_OK;
-};
+    // Indicate that a new sample is available
+    MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
+}
+
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+/**
+  * Interrupt handler for the data ready line. Begins a background read of the new sample.
+  */
+void MicroBitAccelerometer::onDataReady()
+{
+    startSampleRead();
+}
+
+/**
+  * Queues a background read of the output registers, unless one is already in progress.
+  */
+void MicroBitAccelerometer::startSampleRead()
+{
+    __disable_irq();
+
+    if(status & MICROBIT_ACCEL_SAMPLE_PENDING)
+    {
+        __enable_irq();
+        return;
+    }
+
+    status |= MICROBIT_ACCEL_SAMPLE_PENDING;
+
+    __enable_irq();
+
+    sampleTime = us_ticker_read();
+
+    sampleRegister = MMA8653_OUT_X_MSB;
+
+    transaction.address = address;
+    transaction.txData = &sampleRegister;
+    transaction.txLength = 1;
+    transaction.rxData = sampleData;
+    transaction.rxLength = 6;
+    transaction.callback = MicroBitAccelerometer::onSampleRead;
+    transaction.context = this;
+
+    if(i2c.submit(&transaction) != MICROBIT_OK)
+        status &= ~MICROBIT_ACCEL_SAMPLE_PENDING;
+}
+
+/**
+  * Called from interrupt context when a background read completes, to process the sample from the idle task.
+  *
+  * @param t The completed transaction.
+  */
+void MicroBitAccelerometer::onSampleRead(I2CTransaction *t)
+{
+    MicroBitAccelerometer *device = (MicroBitAccelerometer *)t->context;
+
+    // If the sample can't be processed, drop it. The next call to updateSample() will catch up.
+    if(t->status != MICROBIT_OK || fiber_defer(MicroBitAccelerometer::processSampleRead, device) != MICROBIT_OK)
+        device->status &= ~MICROBIT_ACCEL_SAMPLE_PENDING;
+}
+
+/**
+  * Processes a sample read in the background. Called from the idle task.
+  *
+  * @param device The instance that read the sample.
+  */
+void MicroBitAccelerometer::processSampleRead(void *device)
+{
+    MicroBitAccelerometer *d = (MicroBitAccelerometer *)device;
+
+    d->processSample(d->sampleData, d->sampleTime);
+    d->status &= ~MICROBIT_ACCEL_SAMPLE_PENDING;
+
+    // If another sample became ready while we were busy, the edge has already passed.
+    if(!d->int1)
+        d->startSampleRead();
+}
+#endif
 
 /**
   * A service function.
@@ -323,6 +448,7 @@ int MicroBitAccelerometer::instantaneousAccelerationSquared()
 uint16_t MicroBitAccelerometer::instantaneousPosture()
 {
     bool shakeDetected = false;
+    MMA8653Sample s = getSample();
 
     // Test for shake events.
     // We detect a shake by measuring zero crossings in each axis. In other words, if we see a strong acceleration to the left followed by
@@ -330,19 +456,19 @@ uint16_t MicroBitAccelerometer::instantaneousPosture()
     //
     // If we see enough zero crossings in succession (MICROBIT_ACCELEROMETER_SHAKE_COUNT_THRESHOLD), then we decide that the device
     // has been shaken.
-    if ((getX() < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.x) || (getX() > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.x))
+    if ((s.x < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.x) || (s.x > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.x))
     {
         shakeDetected = true;
         shake.x = !shake.x;
     }
 
-    if ((getY() < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.y) || (getY() > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.y))
+    if ((s.y < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.y) || (s.y > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.y))
     {
         shakeDetected = true;
         shake.y = !shake.y;
     }
 
-    if ((getZ() < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.z) || (getZ() > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.z))
+    if ((s.z < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.z) || (s.z > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.z))
     {
         shakeDetected = true;
         shake.z = !shake.z;
@@ -390,22 +516,22 @@ uint16_t MicroBitAccelerometer::instantaneousPosture()
         return MICROBIT_ACCELEROMETER_EVT_FREEFALL;
 
     // Determine our posture.
-    if (getX() < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (s.x < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
         return MICROBIT_ACCELEROMETER_EVT_TILT_LEFT;
 
-    if (getX() > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (s.x > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
         return MICROBIT_ACCELEROMETER_EVT_TILT_RIGHT;
 
-    if (getY() < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (s.y < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
         return MICROBIT_ACCELEROMETER_EVT_TILT_DOWN;
 
-    if (getY() > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (s.y > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
         return MICROBIT_ACCELEROMETER_EVT_TILT_UP;
 
-    if (getZ() < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (s.z < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
         return MICROBIT_ACCELEROMETER_EVT_FACE_UP;
 
-    if (getZ() > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (s.z > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
         return MICROBIT_ACCELEROMETER_EVT_FACE_DOWN;
 
     return MICROBIT_ACCELEROMETER_EVT_NONE;
@@ -542,32 +668,62 @@ int MicroBitAccelerometer::getRange()
 }
 
 /**
-  * Reads the value of the X axis from the latest update retrieved from the accelerometer.
+  * Reads all three axes from the latest update retrieved from the accelerometer.
+  *
+  * This checks for a new sample and applies the coordinate transform once, so is cheaper than
+  * calling getX(), getY() and getZ() in turn, and guarantees that all three values come from the same sample.
   *
   * @param system The coordinate system to use. By default, a simple cartesian system is provided.
   *
-  * @return The force measured in the X axis, in milli-g.
+  * @return The force measured in each axis, in milli-g.
   *
   * @code
-  * accelerometer.getX();
+  * MMA8653Sample s = accelerometer.getSample();
   * @endcode
   */
-int MicroBitAccelerometer::getX(MicroBitCoordinateSystem system)
+MMA8653Sample MicroBitAccelerometer::getSample(MicroBitCoordinateSystem system)
 {
+    MMA8653Sample s;
+
     updateSample();
 
     switch (system)
     {
         case SIMPLE_CARTESIAN:
-            return -sample.x;
+            s.x = -sample.x;
+            s.y = -sample.y;
+            s.z = sample.z;
+            break;
 
         case NORTH_EAST_DOWN:
-            return sample.y;
+            s.x = sample.y;
+            s.y = -sample.x;
+            s.z = -sample.z;
+            break;
 
         case RAW:
         default:
-            return sample.x;
+            s = sample;
+            break;
     }
+
+    return s;
+}
+
+/**
+  * Reads the value of the X axis from the latest update retrieved from the accelerometer.
+  *
+  * @param system The coordinate system to use. By default, a simple cartesian system is provided.
+  *
+  * @return The force measured in the X axis, in milli-g.
+  *
+  * @code
+  * accelerometer.getX();
+  * @endcode
+  */
+int MicroBitAccelerometer::getX(MicroBitCoordinateSystem system)
+{
+    return getSample(system).x;
 }
 
 /**
@@ -581,20 +737,7 @@ int MicroBitAccelerometer::getX(MicroBitCoordinateSystem system)
   */
 int MicroBitAccelerometer::getY(MicroBitCoordinateSystem system)
 {
-    updateSample();
-
-    switch (system)
-    {
-        case SIMPLE_CARTESIAN:
-            return -sample.y;
-
-        case NORTH_EAST_DOWN:
-            return -sample.x;
-
-        case RAW:
-        default:
-            return sample.y;
-    }
+    return getSample(system).y;
 }
 
 /**
@@ -608,18 +751,7 @@ int MicroBitAccelerometer::getY(MicroBitCoordinateSystem system)
   */
 int MicroBitAccelerometer::getZ(MicroBitCoordinateSystem system)
 {
-    updateSample();
-
-    switch (system)
-    {
-        case NORTH_EAST_DOWN:
-            return -sample.z;
-
-        case SIMPLE_CARTESIAN:
-        case RAW:
-        default:
-            return sample.z;
-    }
+    return getSample(system).z;
 }
 
 /**
@@ -633,7 +765,11 @@ int MicroBitAccelerometer::getZ(MicroBitCoordinateSystem system)
   */
 int MicroBitAccelerometer::getPitch()
 {
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    return (getPitchAngle() * 360) / MICROBIT_FIXED_ANGLE_TURN;
+#else
     return (int) ((360*getPitchRadians()) / (2*PI));
+#endif
 }
 
 /**
@@ -650,7 +786,32 @@ float MicroBitAccelerometer::getPitchRadians()
     if (!(status & MICROBIT_ACCEL_PITCH_ROLL_VALID))
         recalculatePitchRoll();
 
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    return pitch * (float) (2*PI / MICROBIT_FIXED_ANGLE_TURN);
+#else
+    return pitch;
+#endif
+}
+
+/**
+  * Provides a rotation compensated pitch of the device, based on the latest update retrieved from the accelerometer.
+  *
+  * @return The pitch of the device, as a binary angle where MICROBIT_FIXED_ANGLE_TURN units make one full turn.
+  *
+  * @code
+  * accelerometer.getPitchAngle();
+  * @endcode
+  */
+int MicroBitAccelerometer::getPitchAngle()
+{
+    if (!(status & MICROBIT_ACCEL_PITCH_ROLL_VALID))
+        recalculatePitchRoll();
+
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
     return pitch;
+#else
+    return (int) ((pitch * MICROBIT_FIXED_ANGLE_TURN) / (2*PI));
+#endif
 }
 
 /**
@@ -664,7 +825,11 @@ float MicroBitAccelerometer::getPitchRadians()
   */
 int MicroBitAccelerometer::getRoll()
 {
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    return (getRollAngle() * 360) / MICROBIT_FIXED_ANGLE_TURN;
+#else
     return (int) ((360*getRollRadians()) / (2*PI));
+#endif
 }
 
 /**
@@ -681,7 +846,32 @@ float MicroBitAccelerometer::getRollRadians()
     if (!(status & MICROBIT_ACCEL_PITCH_ROLL_VALID))
         recalculatePitchRoll();
 
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    return roll * (float) (2*PI / MICROBIT_FIXED_ANGLE_TURN);
+#else
     return roll;
+#endif
+}
+
+/**
+  * Provides a rotation compensated roll of the device, based on the latest update retrieved from the accelerometer.
+  *
+  * @return The roll of the device, as a binary angle where MICROBIT_FIXED_ANGLE_TURN units make one full turn.
+  *
+  * @code
+  * accelerometer.getRollAngle();
+  * @endcode
+  */
+int MicroBitAccelerometer::getRollAngle()
+{
+    if (!(status & MICROBIT_ACCEL_PITCH_ROLL_VALID))
+        recalculatePitchRoll();
+
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    return roll;
+#else
+    return (int) ((roll * MICROBIT_FIXED_ANGLE_TURN) / (2*PI));
+#endif
 }
 
 /**
@@ -692,12 +882,37 @@ float MicroBitAccelerometer::getRollRadians()
   */
 void MicroBitAccelerometer::recalculatePitchRoll()
 {
-    double x = (double) getX(NORTH_EAST_DOWN);
-    double y = (double) getY(NORTH_EAST_DOWN);
-    double z = (double) getZ(NORTH_EAST_DOWN);
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    MMA8653Sample s = getSample(NORTH_EAST_DOWN);
+    int x = s.x;
+    int y = s.y;
+    int z = s.z;
+    int sinRoll, cosRoll;
+
+    roll = microbit_fixed_atan2(y, z);
+    microbit_fixed_sincos(roll, sinRoll, cosRoll);
+
+    // atan(-x / d), expressed as an atan2() in the right half plane.
+    // Both terms are scaled by MICROBIT_FIXED_ONE, which is at most 2^29 for an 8g sample.
+    int n = -x * MICROBIT_FIXED_ONE;
+    int d = y*sinRoll + z*cosRoll;
+
+    if (d < 0)
+    {
+        n = -n;
+        d = -d;
+    }
+
+    pitch = microbit_fixed_atan2(n, d);
+#else
+    MMA8653Sample s = getSample(NORTH_EAST_DOWN);
+    double x = (double) s.x;
+    double y = (double) s.y;
+    double z = (double) s.z;
 
     roll = atan2(y, z);
     pitch = atan(-x / (y*sin(roll) + z*cos(roll)));
+#endif
 
     status |= MICROBIT_ACCEL_PITCH_ROLL_VALID;
 }
@@ -720,6 +935,108 @@ uint16_t MicroBitAccelerometer::getGesture()
     return lastGesture;
 }
 
+/**
+  * Enables or disables batch mode. In batch mode, each sample is timestamped and buffered for collection
+  * with readBatch(), and a single MICROBIT_ACCELEROMETER_EVT_BATCH_READY event is raised each time batchSize
+  * further samples have been buffered, in place of a MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE event per sample.
+  *
+  * @param batchSize The number of samples per batch, or zero to disable batch mode.
+  *
+  * @param capacity The number of samples that can be buffered. This must be at least batchSize.
+  *        Defaults to twice batchSize, so that one batch can be collected while the next is gathered.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the parameters are out of range,
+  *         or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+  *
+  * @code
+  * // 800Hz vibration logging, in batches of 100 samples.
+  * accelerometer.setPeriod(1);
+  * accelerometer.setBatchMode(100);
+  * @endcode
+  *
+  * @note Any buffered samples are discarded. Samples that arrive whilst the buffer is full are dropped.
+  *       For high sample rates, enable MICROBIT_SENSOR_INTERRUPT_SAMPLING.
+  */
+int MicroBitAccelerometer::setBatchMode(int batchSize, int capacity)
+{
+    if (batchSize < 0 || batchSize > MICROBIT_RING_BUFFER_MAX_CAPACITY)
+        return MICROBIT_INVALID_PARAMETER;
+
+    this->batchSize = 0;
+    this->batchCount = 0;
+
+    if (batchSize == 0)
+    {
+        batch.clear();
+        return MICROBIT_OK;
+    }
+
+    if (capacity == 0)
+        capacity = min(2 * batchSize, MICROBIT_RING_BUFFER_MAX_CAPACITY);
+
+    if (capacity < batchSize)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int result = batch.resize(capacity);
+    if (result != MICROBIT_OK)
+        return result;
+
+    this->batchSize = batchSize;
+
+    // Begin sampling, if we aren't already.
+    updateSample();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Reads the number of samples per batch.
+  *
+  * @return The batch size, or zero if batch mode is disabled.
+  */
+int MicroBitAccelerometer::getBatchSize()
+{
+    return batchSize;
+}
+
+/**
+  * Determines the number of buffered samples awaiting collection in batch mode.
+  *
+  * @return The number of samples that can be read with readBatch().
+  */
+int MicroBitAccelerometer::getBatchLevel()
+{
+    return batch.size();
+}
+
+/**
+  * Removes buffered samples in batch mode, oldest first.
+  *
+  * @param samples The location to store the samples.
+  *
+  * @param len The maximum number of samples to read.
+  *
+  * @return The number of samples read, or MICROBIT_INVALID_PARAMETER if samples is NULL or len is negative.
+  *
+  * @code
+  * MicroBitAccelerometerBatchSample samples[100];
+  *
+  * void onBatch(MicroBitEvent)
+  * {
+  *     int n = accelerometer.readBatch(samples, 100);
+  * }
+  *
+  * messageBus.listen(MICROBIT_ID_ACCELEROMETER, MICROBIT_ACCELEROMETER_EVT_BATCH_READY, onBatch);
+  * @endcode
+  */
+int MicroBitAccelerometer::readBatch(MicroBitAccelerometerBatchSample *samples, int len)
+{
+    if (samples == NULL || len < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return batch.pop(samples, len);
+}
+
 /**
   * A periodic callback invoked by the fiber scheduler idle thread.
   *
@@ -0,0 +1,364 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for MicroBitAnalogSampler.
+  *
+  * Periodically scans a set of analog pins in the background, storing each scan as a frame of samples.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitAnalogSampler.h"
+#include "MicroBitEvent.h"
+#include "ErrorNo.h"
+#include "MicroBitTrace.h"
+
+MicroBitAnalogSampler* MicroBitAnalogSampler::instance = NULL;
+
+/**
+  * Interrupt handler for the ADC.
+  */
+extern "C" void ADC_IRQHandler(void)
+{
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_ADC, 0);
+
+    if(MicroBitAnalogSampler::instance)
+        MicroBitAnalogSampler::instance->onConversion();
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_ADC, 0);
+}
+
+/**
+  * Determines the ADC input connected to the given pin.
+  *
+  * @param name The pin.
+  *
+  * @return The ADC input, or -1 if the pin is not connected to the ADC.
+  */
+static int analogInput(PinName name)
+{
+    // AIN0 and AIN1 are on P0.26 and P0.27. AIN2 to AIN7 are on P0.01 to P0.06.
+    if (name == P0_26)
+        return 0;
+
+    if (name == P0_27)
+        return 1;
+
+    if (name >= P0_1 && name <= P0_6)
+        return name - P0_1 + 2;
+
+    return -1;
+}
+
+/**
+  * Constructor.
+  *
+  * Create a representation of an analog sampler, with no pins.
+  *
+  * @param id the unique EventModel id of this component. Defaults to MICROBIT_ID_ANALOG_SAMPLER.
+  *
+  * @code
+  * MicroBitAnalogSampler sampler;
+  * @endcode
+  */
+MicroBitAnalogSampler::MicroBitAnalogSampler(uint16_t id) : trigger(), samples()
+{
+    this->id = id;
+    this->channels = 0;
+    this->channel = 0;
+    this->blockSize = 0;
+    this->blockCount = 0;
+    this->dropped = 0;
+}
+
+/**
+  * Adds a pin to the end of the list of pins scanned. The pin is configured for analog input.
+  *
+  * @param pin The pin to sample.
+  *
+  * @return The position of the pin's sample in each frame, MICROBIT_NOT_SUPPORTED if the pin is not connected to the ADC,
+  *         MICROBIT_NO_RESOURCES if every channel is in use, or MICROBIT_BUSY if sampling is in progress.
+  *
+  * @code
+  * sampler.addChannel(uBit.io.P0);
+  * sampler.addChannel(uBit.io.P1);
+  * @endcode
+  */
+int MicroBitAnalogSampler::addChannel(MicroBitPin &pin)
+{
+    if (instance == this)
+        return MICROBIT_BUSY;
+
+    int input = analogInput(pin.name);
+
+    if (input < 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    if (channels == MICROBIT_ANALOG_SAMPLER_MAX_CHANNELS)
+        return MICROBIT_NO_RESOURCES;
+
+    // Place the pin into its analog input state, releasing any other peripheral using it.
+    int result = pin.getAnalogValue();
+
+    if (result < 0)
+        return result;
+
+    pins[channels] = &pin;
+    inputs[channels] = input;
+
+    return channels++;
+}
+
+/**
+  * Removes all the pins from the list of pins scanned.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_BUSY if sampling is in progress.
+  */
+int MicroBitAnalogSampler::clearChannels()
+{
+    if (instance == this)
+        return MICROBIT_BUSY;
+
+    channels = 0;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the number of pins scanned, which is also the number of samples in each frame.
+  *
+  * @return The number of pins scanned.
+  */
+int MicroBitAnalogSampler::getChannels()
+{
+    return channels;
+}
+
+/**
+  * Starts sampling. Any frames left from an earlier run are discarded.
+  *
+  * @param period The time between the start of each scan, in microseconds. This must allow each pin
+  *               to be converted in turn, taking MICROBIT_ANALOG_SAMPLER_CONVERSION_TIME per pin.
+  *
+  * @param blockSize The number of frames in each block. A MICROBIT_ANALOG_SAMPLER_EVT_BLOCK_READY event is raised
+  *                  each time a block of frames has been stored.
+  *
+  * @param capacity The number of frames that may be held awaiting collection. If 0, space for four blocks is provided.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there are no pins or any parameter is out of range,
+  *         MICROBIT_BUSY if another instance is sampling, or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+  *
+  * @code
+  * // Sample at 2kHz, and collect the samples ten times a second.
+  * sampler.start(500, 200);
+  * @endcode
+  */
+int MicroBitAnalogSampler::start(int period, int blockSize, int capacity)
+{
+    if (instance != NULL)
+        return MICROBIT_BUSY;
+
+    if (capacity == 0)
+        capacity = blockSize * 4;
+
+    if (channels == 0 || period < channels * MICROBIT_ANALOG_SAMPLER_CONVERSION_TIME || blockSize < 1 || blockSize > 0xFFFF
+        || capacity < blockSize || capacity > MICROBIT_RING_BUFFER_MAX_CAPACITY / channels)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int result = samples.resize(capacity * channels);
+
+    if (result != MICROBIT_OK)
+        return result;
+
+    this->blockSize = blockSize;
+    this->blockCount = 0;
+    this->dropped = 0;
+    this->channel = channels;
+
+    instance = this;
+
+    NRF_ADC->EVENTS_END = 0;
+    NRF_ADC->INTENSET = ADC_INTENSET_END_Msk;
+    NVIC_ClearPendingIRQ(ADC_IRQn);
+    NVIC_EnableIRQ(ADC_IRQn);
+
+    trigger.attach_us(this, &MicroBitAnalogSampler::onTick, period);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops sampling. Frames already stored remain available to read().
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if this instance is not sampling.
+  */
+int MicroBitAnalogSampler::stop()
+{
+    if (instance != this)
+        return MICROBIT_INVALID_PARAMETER;
+
+    trigger.detach();
+
+    NVIC_DisableIRQ(ADC_IRQn);
+    NRF_ADC->INTENCLR = ADC_INTENSET_END_Msk;
+    NRF_ADC->TASKS_STOP = 1;
+    NRF_ADC->EVENTS_END = 0;
+
+    // Release the ADC, as MicroBitPin does, so that the pins may be used for other purposes.
+    NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Disabled;
+
+    instance = NULL;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Begins a conversion of the current channel.
+  */
+void MicroBitAnalogSampler::startConversion()
+{
+    NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit                            << ADC_CONFIG_RES_Pos) |
+                      (ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
+                      (ADC_CONFIG_REFSEL_SupplyOneThirdPrescaling      << ADC_CONFIG_REFSEL_Pos) |
+                      ((1 << inputs[channel])                          << ADC_CONFIG_PSEL_Pos) |
+                      (ADC_CONFIG_EXTREFSEL_None                       << ADC_CONFIG_EXTREFSEL_Pos);
+
+    NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Enabled;
+    NRF_ADC->TASKS_START = 1;
+}
+
+/**
+  * Periodic callback from the Ticker. Begins a scan of all the channels.
+  */
+void MicroBitAnalogSampler::onTick()
+{
+    // If the last scan is unfinished, it has overrun its period, or a conversion was aborted by another
+    // user of the ADC. Either way, abandon it, and start afresh.
+    if (channel < channels)
+    {
+        NRF_ADC->TASKS_STOP = 1;
+        NRF_ADC->EVENTS_END = 0;
+        dropped++;
+    }
+
+    channel = 0;
+    startConversion();
+}
+
+/**
+  * Interrupt handler for the ADC. Stores the result of the conversion, then begins the next.
+  */
+void MicroBitAnalogSampler::onConversion()
+{
+    if (!NRF_ADC->EVENTS_END)
+        return;
+
+    NRF_ADC->EVENTS_END = 0;
+
+    if (channel >= channels)
+        return;
+
+    frame[channel++] = NRF_ADC->RESULT;
+
+    if (channel < channels)
+    {
+        startConversion();
+        return;
+    }
+
+    // The scan is complete. A frame is stored whole, or not at all, so that the channels remain aligned.
+    if (samples.capacity() - samples.size() < channels)
+    {
+        dropped++;
+        return;
+    }
+
+    samples.push(frame, channels);
+
+    if (++blockCount >= blockSize)
+    {
+        blockCount = 0;
+        MicroBitEvent(id, MICROBIT_ANALOG_SAMPLER_EVT_BLOCK_READY, CREATE_AND_DEFER);
+    }
+}
+
+/**
+  * Removes stored frames, oldest first. The samples of each frame are in the order their pins were added.
+  *
+  * @param buffer The location to store the samples, each in the range 0 - 1023.
+  *
+  * @param len The size of the buffer, in samples. Only whole frames are read.
+  *
+  * @return The number of samples read, or MICROBIT_INVALID_PARAMETER if buffer is NULL or len is negative.
+  *
+  * @code
+  * uint16_t block[400];
+  *
+  * void onBlock(MicroBitEvent)
+  * {
+  *     int n = sampler.read(block, 400);
+  * }
+  *
+  * uBit.messageBus.listen(MICROBIT_ID_ANALOG_SAMPLER, MICROBIT_ANALOG_SAMPLER_EVT_BLOCK_READY, onBlock);
+  * @endcode
+  */
+int MicroBitAnalogSampler::read(uint16_t *buffer, int len)
+{
+    if (buffer == NULL || len < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (channels == 0)
+        return 0;
+
+    return samples.pop(buffer, len - len % channels);
+}
+
+/**
+  * Determines the number of stored frames awaiting collection.
+  *
+  * @return The number of frames that can currently be read.
+  */
+int MicroBitAnalogSampler::getFrames()
+{
+    return channels ? samples.size() / channels : 0;
+}
+
+/**
+  * Determines the number of frames lost since sampling was started, either because the buffer was full
+  * or because a scan had not finished by the time the next was due.
+  *
+  * @return The number of frames lost.
+  */
+int MicroBitAnalogSampler::getDropped()
+{
+    return dropped;
+}
+
+/**
+  * Destructor. Stops sampling, if in progress.
+  */
+MicroBitAnalogSampler::~MicroBitAnalogSampler()
+{
+    stop();
+}
@@ -0,0 +1,397 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for MicroBitBenchmark.
+  *
+  * Measures the cost of the runtime's hot paths on the device itself, and prints a machine readable report over serial.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitBenchmark.h"
+#include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitImage.h"
+#include "ErrorNo.h"
+
+// The number of small blocks allocated to fragment the heap, and their size in bytes.
+#define BENCHMARK_HEAP_BLOCKS       32
+#define BENCHMARK_HEAP_BLOCK_SIZE   16
+
+// The stack used by each level of recursion in the context switch benchmark, in bytes.
+#define BENCHMARK_STACK_FRAME       64
+
+// Set whilst the other fiber in the context switch benchmark should keep yielding.
+static volatile bool benchmarkSpinning = false;
+
+// The number of times the other fiber in the context switch benchmark has been scheduled.
+static volatile uint32_t benchmarkSwitches = 0;
+
+/**
+  * Handler for the listeners registered by the message bus benchmark. Counts the events received.
+  */
+static void benchmarkHandler(MicroBitEvent, void *count)
+{
+    (*(uint32_t *)count)++;
+}
+
+/**
+  * Consumes roughly the given amount of stack, then yields to the scheduler until the benchmark completes.
+  */
+static void benchmarkYield(int depth)
+{
+    volatile uint8_t frame[BENCHMARK_STACK_FRAME];
+    frame[0] = 0;
+
+    if (depth > BENCHMARK_STACK_FRAME)
+        benchmarkYield(depth - BENCHMARK_STACK_FRAME);
+    else
+        while (benchmarkSpinning)
+        {
+            benchmarkSwitches++;
+            schedule();
+        }
+
+    // Use the frame after the call, so it is not optimised into a tail call.
+    frame[0]++;
+}
+
+/**
+  * Entry point for the other fiber in the context switch benchmark.
+  */
+static void benchmarkFiber(void *depth)
+{
+    benchmarkYield((int)depth);
+}
+
+/**
+  * Constructor.
+  *
+  * @param serial The serial port to print results to, for example uBit.serial.
+  *
+  * @param iterations The number of times each operation is repeated. Defaults to MICROBIT_BENCHMARK_DEFAULT_ITERATIONS.
+  *
+  * @code
+  * MicroBitBenchmark benchmark(uBit.serial);
+  * benchmark.run(uBit.messageBus);
+  * @endcode
+  */
+MicroBitBenchmark::MicroBitBenchmark(RawSerial &serial, int iterations) : serial(serial)
+{
+    this->iterations = iterations > 0 ? iterations : MICROBIT_BENCHMARK_DEFAULT_ITERATIONS;
+}
+
+/**
+  * Prints a single result line.
+  *
+  * @param name The name of the benchmark.
+  *
+  * @param parameter The parameter the benchmark was run with, such as a number of listeners.
+  *
+  * @param operations The number of operations timed.
+  *
+  * @param time The total time taken, in microseconds.
+  */
+void MicroBitBenchmark::report(const char *name, int parameter, int operations, uint32_t time)
+{
+    uint32_t ns = operations > 0 ? (uint32_t)(((uint64_t)time * 1000) / operations) : 0;
+
+    serial.printf("benchmark,%s,%d,%d,%lu,%lu\r\n", name, parameter, operations, (unsigned long)time, (unsigned long)ns);
+}
+
+/**
+  * Runs every benchmark over a representative range of parameters.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param fs The file system to benchmark, or NULL to skip the file system benchmarks. Defaults to NULL.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory ran out.
+  */
+int MicroBitBenchmark::run(EventModel &bus, MicroBitFileSystem *fs)
+{
+    int result = MICROBIT_OK;
+
+    serial.printf("benchmark,name,parameter,operations,total_us,ns_per_op\r\n");
+
+    for (int f = 0; f <= 75 && result == MICROBIT_OK; f += 25)
+        result = heap(f);
+
+    for (int n = 1; n <= 16 && result == MICROBIT_OK; n *= 4)
+        result = messageBus(bus, n);
+
+    for (int d = 0; d <= 1024 && result == MICROBIT_OK; d += 256)
+        result = contextSwitch(d);
+
+    if (result == MICROBIT_OK)
+        result = imagePaste(5);
+
+    if (result == MICROBIT_OK)
+        result = imagePaste(20);
+
+    if (fs != NULL)
+    {
+        if (result == MICROBIT_OK)
+            result = fileSystem(*fs, 16);
+
+        if (result == MICROBIT_OK)
+            result = fileSystem(*fs, 256);
+    }
+
+    return result;
+}
+
+/**
+  * Measures the cost of a malloc and free pair, once the heap has been fragmented.
+  *
+  * @param fragmentation The percentage of small blocks freed between blocks that remain allocated, 0 to 100.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory ran out.
+  */
+int MicroBitBenchmark::heap(int fragmentation)
+{
+    void *blocks[BENCHMARK_HEAP_BLOCKS];
+    int result = MICROBIT_OK;
+
+    // Allocate a run of small blocks, then free a proportion of them spread evenly through the run.
+    // Later allocations of a larger size must then search past the holes left behind.
+    for (int i = 0; i < BENCHMARK_HEAP_BLOCKS; i++)
+        blocks[i] = malloc(BENCHMARK_HEAP_BLOCK_SIZE);
+
+    for (int i = 0; i < BENCHMARK_HEAP_BLOCKS; i++)
+    {
+        if (blocks[i] != NULL && (i * fragmentation) / 100 != ((i + 1) * fragmentation) / 100)
+        {
+            free(blocks[i]);
+            blocks[i] = NULL;
+        }
+    }
+
+    uint32_t start = (uint32_t) system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        void *p = malloc(BENCHMARK_HEAP_BLOCK_SIZE * 2);
+
+        if (p == NULL)
+        {
+            result = MICROBIT_NO_RESOURCES;
+            break;
+        }
+
+        free(p);
+    }
+
+    uint32_t time = (uint32_t) system_timer_current_time_us() - start;
+
+    for (int i = 0; i < BENCHMARK_HEAP_BLOCKS; i++)
+        if (blocks[i] != NULL)
+            free(blocks[i]);
+
+    if (result == MICROBIT_OK)
+        report("heap", fragmentation, iterations, time);
+
+    return result;
+}
+
+/**
+  * Measures the cost of sending an event on the message bus, when the chain holding its listeners
+  * contains the given number of listeners. Each event is delivered to one MESSAGE_BUS_LISTENER_IMMEDIATE listener.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param listeners The number of listeners to register.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if listeners is less than 1.
+  */
+int MicroBitBenchmark::messageBus(EventModel &bus, int listeners)
+{
+    uint32_t received = 0;
+
+    if (listeners < 1)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Listeners differ by value, so each event walks the chain to find the one listener it matches.
+    for (int i = 0; i < listeners; i++)
+        bus.listen(MICROBIT_ID_BENCHMARK, i + 1, benchmarkHandler, &received, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    uint32_t start = (uint32_t) system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+        bus.send(MicroBitEvent(MICROBIT_ID_BENCHMARK, (i % listeners) + 1, CREATE_ONLY));
+
+    uint32_t time = (uint32_t) system_timer_current_time_us() - start;
+
+    for (int i = 0; i < listeners; i++)
+        bus.ignore(MICROBIT_ID_BENCHMARK, i + 1, benchmarkHandler);
+
+    report("messagebus", listeners, received, time);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the cost of a context switch through schedule(), between this fiber and
+  * another fiber using the given amount of stack.
+  *
+  * @param depth The approximate stack used by the other fiber, in bytes.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the fiber could not be created.
+  */
+int MicroBitBenchmark::contextSwitch(int depth)
+{
+    // schedule() cannot fork, so if we were invoked in fork on block context, block once to obtain a fiber of our own.
+    if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB)
+        fiber_sleep(0);
+
+    benchmarkSpinning = true;
+    benchmarkSwitches = 0;
+
+    if (create_fiber(benchmarkFiber, (void *)depth) == NULL)
+    {
+        benchmarkSpinning = false;
+        return MICROBIT_NO_RESOURCES;
+    }
+
+    // Let the other fiber reach its full depth before timing begins.
+    schedule();
+
+    uint32_t switches = benchmarkSwitches;
+    uint32_t start = (uint32_t) system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+        schedule();
+
+    uint32_t time = (uint32_t) system_timer_current_time_us() - start;
+
+    // Each pass of the other fiber accounts for a switch to it and a switch back.
+    switches = (benchmarkSwitches - switches) * 2;
+
+    benchmarkSpinning = false;
+    schedule();
+
+    report("switch", depth, switches, time);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the cost of MicroBitImage::paste(), pasting a square image onto another of the same size.
+  *
+  * @param size The width and height of the images, in pixels.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if size is less than 1.
+  */
+int MicroBitBenchmark::imagePaste(int size)
+{
+    if (size < 1)
+        return MICROBIT_INVALID_PARAMETER;
+
+    MicroBitImage target(size, size);
+    MicroBitImage source(size, size);
+
+    uint32_t start = (uint32_t) system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+        target.paste(source);
+
+    uint32_t time = (uint32_t) system_timer_current_time_us() - start;
+
+    report("paste", size, iterations, time);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures file system throughput, by writing and then reading back a file of MICROBIT_BENCHMARK_FILE_SIZE bytes.
+  * The file is removed afterwards.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param chunk The number of bytes passed to each write() and read() call.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if chunk is out of range,
+  *         or the error returned by the file system.
+  */
+int MicroBitBenchmark::fileSystem(MicroBitFileSystem &fs, int chunk)
+{
+    int fd, result = MICROBIT_OK;
+    uint32_t start, time;
+
+    if (chunk < 1 || chunk > MICROBIT_BENCHMARK_FILE_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint8_t *buffer = (uint8_t *)malloc(chunk);
+
+    if (buffer == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    memset(buffer, 0x55, chunk);
+    fs.remove(MICROBIT_BENCHMARK_FILENAME);
+
+    // Time the writes, including the close that flushes any cached data to flash.
+    start = (uint32_t) system_timer_current_time_us();
+
+    fd = fs.open(MICROBIT_BENCHMARK_FILENAME, MB_WRITE | MB_CREAT);
+
+    for (int written = 0; fd >= 0 && written < MICROBIT_BENCHMARK_FILE_SIZE && result >= 0; written += chunk)
+        result = fs.write(fd, buffer, min(chunk, MICROBIT_BENCHMARK_FILE_SIZE - written));
+
+    if (fd >= 0)
+        fs.close(fd);
+
+    time = (uint32_t) system_timer_current_time_us() - start;
+
+    if (fd < 0 || result < 0)
+    {
+        free(buffer);
+        return fd < 0 ? fd : result;
+    }
+
+    report("fswrite", chunk, MICROBIT_BENCHMARK_FILE_SIZE, time);
+
+    // Then the reads of the same file.
+    start = (uint32_t) system_timer_current_time_us();
+
+    fd = fs.open(MICROBIT_BENCHMARK_FILENAME, MB_READ);
+
+    for (int read = 0; fd >= 0 && read < MICROBIT_BENCHMARK_FILE_SIZE && result > 0; read += result)
+        result = fs.read(fd, buffer, chunk);
+
+    if (fd >= 0)
+        fs.close(fd);
+
+    time = (uint32_t) system_timer_current_time_us() - start;
+
+    free(buffer);
+    fs.remove(MICROBIT_BENCHMARK_FILENAME);
+
+    if (fd < 0 || result < 0)
+        return fd < 0 ? fd : result;
+
+    report("fsread", chunk, MICROBIT_BENCHMARK_FILE_SIZE, time);
+
+    return MICROBIT_OK;
+}
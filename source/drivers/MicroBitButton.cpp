@@ -25,6 +25,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 #include "MicroBitButton.h"
+#include "MicroBitMultiButton.h"
 #include "MicroBitSystemTimer.h"
 
 /**
@@ -45,14 +46,48 @@ DEALINGS IN THE SOFTWARE.
   * buttonA(MICROBIT_PIN_BUTTON_A, MICROBIT_ID_BUTTON_A);
   * @endcode
   */
-MicroBitButton::MicroBitButton(PinName name, uint16_t id, MicroBitButtonEventConfiguration eventConfiguration, PinMode mode) : pin(name, mode)
+MicroBitButton::MicroBitButton(PinName name, uint16_t id, MicroBitButtonEventConfiguration eventConfiguration, PinMode mode) : pin(name)
 {
     this->id = id;
     this->name = name;
     this->eventConfiguration = eventConfiguration;
     this->downStartTime = 0;
     this->sigma = 0;
-    system_timer_add_component(this);
+    this->multiButton = NULL;
+
+    this->pin.mode(mode);
+
+#if CONFIG_ENABLED(MICROBIT_BUTTON_SENSE_ON_EDGE)
+    this->pin.rise(this, &MicroBitButton::onEdge);
+    this->pin.fall(this, &MicroBitButton::onEdge);
+#endif
+
+    // Sample until our state has settled, in case we are already pressed.
+    if (system_timer_add_component(this) == MICROBIT_OK)
+        status |= MICROBIT_BUTTON_STATE_SAMPLING;
+}
+
+/**
+  * Interrupt handler for an edge on the pin. Begins sampling the pin on each system tick, if we are not already.
+  */
+void MicroBitButton::onEdge()
+{
+    if (!(status & MICROBIT_BUTTON_STATE_SAMPLING) && system_timer_add_component(this) == MICROBIT_OK)
+        status |= MICROBIT_BUTTON_STATE_SAMPLING;
+}
+
+/**
+  * Determines if the debounced state of this button has settled, with no hold event outstanding,
+  * such that it need not be sampled again until the pin changes.
+  *
+  * @return true if this button is idle, false otherwise.
+  */
+bool MicroBitButton::isIdle()
+{
+    if (status & MICROBIT_BUTTON_STATE)
+        return sigma == MICROBIT_BUTTON_SIGMA_MAX && !pin && (status & MICROBIT_BUTTON_STATE_HOLD_TRIGGERED);
+
+    return sigma == MICROBIT_BUTTON_SIGMA_MIN && pin;
 }
 
 /**
@@ -109,12 +144,15 @@ void MicroBitButton::systemTick()
 
         //Record the time the button was pressed.
         downStartTime = system_timer_current_time();
+
+        if (multiButton)
+            multiButton->subButtonEvent(id, MICROBIT_BUTTON_EVT_DOWN);
     }
 
     // Check to see if we have on->off state change.
     if(sigma < MICROBIT_BUTTON_SIGMA_THRESH_LO && (status & MICROBIT_BUTTON_STATE))
     {
-        status = 0;
+        status &= MICROBIT_BUTTON_STATE_SAMPLING;
         MicroBitEvent evt(id,MICROBIT_BUTTON_EVT_UP);
 
        if (eventConfiguration == MICROBIT_BUTTON_ALL_EVENTS)
@@ -125,6 +163,9 @@ void MicroBitButton::systemTick()
            else
                MicroBitEvent evt(id,MICROBIT_BUTTON_EVT_CLICK);
        }
+
+        if (multiButton)
+            multiButton->subButtonEvent(id, MICROBIT_BUTTON_EVT_UP);
     }
 
     //if button is pressed and the hold triggered event state is not triggered AND we are greater than the button debounce value
@@ -135,7 +176,19 @@ void MicroBitButton::systemTick()
 
         //fire hold event
         MicroBitEvent evt(id,MICROBIT_BUTTON_EVT_HOLD);
+
+        if (multiButton)
+            multiButton->subButtonEvent(id, MICROBIT_BUTTON_EVT_HOLD);
     }
+
+#if CONFIG_ENABLED(MICROBIT_BUTTON_SENSE_ON_EDGE)
+    // Once settled, stop sampling until the next edge. Any edge from here on is handled after we return.
+    if (isIdle())
+    {
+        system_timer_remove_component(this);
+        status &= ~MICROBIT_BUTTON_STATE_SAMPLING;
+    }
+#endif
 }
 
 /**
@@ -153,10 +206,34 @@ int MicroBitButton::isPressed()
     return status & MICROBIT_BUTTON_STATE ? 1 : 0;
 }
 
+/**
+  * Retrieves the event bus ID of this button.
+  *
+  * @return The ID given to the constructor.
+  */
+uint16_t MicroBitButton::getId()
+{
+    return id;
+}
+
+/**
+  * Informs the given MicroBitMultiButton of each change in the state of this button directly from
+  * systemTick(), rather than through the EventModel. Used by MicroBitMultiButton.
+  *
+  * @param multiButton The MicroBitMultiButton to inform, or NULL to inform none.
+  */
+void MicroBitButton::setMultiButton(MicroBitMultiButton *multiButton)
+{
+    this->multiButton = multiButton;
+}
+
 /**
   * Destructor for MicroBitButton, where we deregister this instance from the array of fiber components.
   */
 MicroBitButton::~MicroBitButton()
 {
     system_timer_remove_component(this);
+
+    if (multiButton)
+        multiButton->detach(this);
 }
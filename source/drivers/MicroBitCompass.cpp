@@ -53,6 +53,10 @@ void MicroBitCompass::init(uint16_t id, uint16_t address)
     // Assume that we have no calibration information.
     status &= ~MICROBIT_COMPASS_STATUS_CALIBRATED;
 
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+    this->calibrationSamples = 0;
+#endif
+
     if(this->storage != NULL)
     {
         KeyValuePair *calibrationData =  storage->get("compassCal");
@@ -63,7 +67,12 @@ void MicroBitCompass::init(uint16_t id, uint16_t address)
 
             memcpy(&storedSample, calibrationData->value, sizeof(CompassSample));
 
-            setCalibration(storedSample);
+            average = storedSample;
+            status |= MICROBIT_COMPASS_STATUS_CALIBRATED;
+
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+            calibrationStored = storedSample;
+#endif
 
             delete calibrationData;
         }
@@ -305,13 +314,40 @@ int MicroBitCompass::read8(uint8_t reg)
   */
 int MicroBitCompass::tiltCompensatedBearing()
 {
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    int sinPhi, cosPhi, sinTheta, cosTheta;
+
+    microbit_fixed_sincos(accelerometer->getRollAngle(), sinPhi, cosPhi);
+    microbit_fixed_sincos(accelerometer->getPitchAngle(), sinTheta, cosTheta);
+
+    CompassSample s = getSample(NORTH_EAST_DOWN);
+    int64_t x = s.x;
+    int64_t y = s.y;
+    int64_t z = s.z;
+
+    // Normalised samples can exceed 2^21, so the products are formed in 64 bits, scaled by MICROBIT_FIXED_ONE.
+    int64_t n = z*sinPhi - y*cosPhi;
+    int64_t d = x*cosTheta + ((y*sinTheta) / MICROBIT_FIXED_ONE)*sinPhi + ((z*sinTheta) / MICROBIT_FIXED_ONE)*cosPhi;
+
+    // The angle depends only upon the ratio of the terms, so scale them back into range.
+    while (n > (1 << 30) || n < -(1 << 30) || d > (1 << 30) || d < -(1 << 30))
+    {
+        n /= 2;
+        d /= 2;
+    }
+
+    int bearing = microbit_fixed_atan2((int) n, (int) d) & (MICROBIT_FIXED_ANGLE_TURN - 1);
+
+    return (bearing * 360) / MICROBIT_FIXED_ANGLE_TURN;
+#else
     // Precompute the tilt compensation parameters to improve readability.
     float phi = accelerometer->getRollRadians();
     float theta = accelerometer->getPitchRadians();
 
-    float x = (float) getX(NORTH_EAST_DOWN);
-    float y = (float) getY(NORTH_EAST_DOWN);
-    float z = (float) getZ(NORTH_EAST_DOWN);
+    CompassSample s = getSample(NORTH_EAST_DOWN);
+    float x = (float) s.x;
+    float y = (float) s.y;
+    float z = (float) s.z;
 
     // Precompute cos and sin of pitch and roll angles to make the calculation a little more efficient.
     float sinPhi = sin(phi);
@@ -325,6 +361,7 @@ int MicroBitCompass::tiltCompensatedBearing()
         bearing += 360.0;
 
     return (int) bearing;
+#endif
 }
 
 /**
@@ -334,12 +371,18 @@ int MicroBitCompass::basicBearing()
 {
     updateSample();
 
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_TRIG)
+    int bearing = microbit_fixed_atan2(sample.y - average.y, sample.x - average.x) & (MICROBIT_FIXED_ANGLE_TURN - 1);
+
+    return ((MICROBIT_FIXED_ANGLE_TURN - bearing) * 360) / MICROBIT_FIXED_ANGLE_TURN;
+#else
     float bearing = (atan2((double)(sample.y - average.y),(double)(sample.x - average.x)))*180/PI;
 
     if (bearing < 0)
         bearing += 360.0;
 
     return (int)(360.0 - bearing);
+#endif
 }
 
 /**
@@ -362,8 +405,17 @@ int MicroBitCompass::heading()
     if(status & MICROBIT_COMPASS_STATUS_CALIBRATING)
         return MICROBIT_CALIBRATION_IN_PROGRESS;
 
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+    // Calibration happens in the background, so keep sampling until we have seen enough of the field.
+    if(!(status & MICROBIT_COMPASS_STATUS_CALIBRATED))
+    {
+        updateSample();
+        return MICROBIT_CALIBRATION_IN_PROGRESS;
+    }
+#else
     if(!(status & MICROBIT_COMPASS_STATUS_CALIBRATED))
         calibrate();
+#endif
 
     if(accelerometer != NULL)
         return tiltCompensatedBearing();
@@ -377,9 +429,23 @@ int MicroBitCompass::heading()
   *
   * @note Can be used to trigger manual updates, if the device is running without a scheduler.
   *       Also called internally by all get[X,Y,Z]() member functions.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the magnetometer could not be accessed.
   */
 int MicroBitCompass::updateSample()
 {
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+    // Samples are read in the background as the data ready line is asserted.
+    if(!(status & MICROBIT_COMPASS_STATUS_INTERRUPT_ENABLED))
+    {
+        int1.rise(this, &MicroBitCompass::onDataReady);
+        status |= MICROBIT_COMPASS_STATUS_INTERRUPT_ENABLED;
+    }
+
+    // Catch up if we missed an edge, such as one before the interrupt was attached.
+    if(int1)
+        startSampleRead();
+#else
     /**
       * Adds the compass to idle, if it hasn't been added already.
       * This is an optimisation so that the compass is only added on first 'use'.
@@ -394,17 +460,112 @@ int MicroBitCompass::updateSample()
     // Interrupt is cleared on data read of MAG_OUT_X_MSB.
     if(int1)
     {
-        sample.x = MAG3110_NORMALIZE_SAMPLE((int) read16(MAG_OUT_X_MSB));
-        sample.y = MAG3110_NORMALIZE_SAMPLE((int) read16(MAG_OUT_Y_MSB));
-        sample.z = MAG3110_NORMALIZE_SAMPLE((int) read16(MAG_OUT_Z_MSB));
+        uint8_t data[6];
+
+        // Read all six output registers in one burst, relying on the MAG3110 auto-incrementing the register address.
+        if (readCommand(MAG_OUT_X_MSB, data, 6) != MICROBIT_OK)
+            return MICROBIT_I2C_ERROR;
 
-        // Indicate that a new sample is available
-        MicroBitEvent e(id, MICROBIT_COMPASS_EVT_DATA_UPDATE);
+        processSample(data);
     }
+#endif
 
     return MICROBIT_OK;
 }
 
+/**
+  * Converts the raw contents of the output registers into a new sample, and
+  * signals that it is available.
+  *
+  * @param data The six output registers, starting with the X axis MSB.
+  */
+void MicroBitCompass::processSample(uint8_t *data)
+{
+    sample.x = MAG3110_NORMALIZE_SAMPLE((int) (int16_t) ((data[0] << 8) | data[1]));
+    sample.y = MAG3110_NORMALIZE_SAMPLE((int) (int16_t) ((data[2] << 8) | data[3]));
+    sample.z = MAG3110_NORMALIZE_SAMPLE((int) (int16_t) ((data[4] << 8) | data[5]));
+
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+    if(!(status & MICROBIT_COMPASS_STATUS_CALIBRATING))
+        updateOnlineCalibration();
+#endif
+
+    // Indicate that a new sample is available
+    MicroBitEvent e(id, MICROBIT_COMPASS_EVT_DATA_UPDATE);
+}
+
+#if CONFIG_ENABLED(MICROBIT_SENSOR_INTERRUPT_SAMPLING)
+/**
+  * Interrupt handler for the data ready line. Begins a background read of the new sample.
+  */
+void MicroBitCompass::onDataReady()
+{
+    startSampleRead();
+}
+
+/**
+  * Queues a background read of the output registers, unless one is already in progress.
+  */
+void MicroBitCompass::startSampleRead()
+{
+    __disable_irq();
+
+    if(status & MICROBIT_COMPASS_STATUS_SAMPLE_PENDING)
+    {
+        __enable_irq();
+        return;
+    }
+
+    status |= MICROBIT_COMPASS_STATUS_SAMPLE_PENDING;
+
+    __enable_irq();
+
+    sampleRegister = MAG_OUT_X_MSB;
+
+    transaction.address = address;
+    transaction.txData = &sampleRegister;
+    transaction.txLength = 1;
+    transaction.rxData = sampleData;
+    transaction.rxLength = 6;
+    transaction.callback = MicroBitCompass::onSampleRead;
+    transaction.context = this;
+
+    if(i2c.submit(&transaction) != MICROBIT_OK)
+        status &= ~MICROBIT_COMPASS_STATUS_SAMPLE_PENDING;
+}
+
+/**
+  * Called from interrupt context when a background read completes, to process the sample from the idle task.
+  *
+  * @param t The completed transaction.
+  */
+void MicroBitCompass::onSampleRead(I2CTransaction *t)
+{
+    MicroBitCompass *device = (MicroBitCompass *)t->context;
+
+    // If the sample can't be processed, drop it. The next call to updateSample() will catch up.
+    if(t->status != MICROBIT_OK || fiber_defer(MicroBitCompass::processSampleRead, device) != MICROBIT_OK)
+        device->status &= ~MICROBIT_COMPASS_STATUS_SAMPLE_PENDING;
+}
+
+/**
+  * Processes a sample read in the background. Called from the idle task.
+  *
+  * @param device The instance that read the sample.
+  */
+void MicroBitCompass::processSampleRead(void *device)
+{
+    MicroBitCompass *d = (MicroBitCompass *)device;
+
+    d->processSample(d->sampleData);
+    d->status &= ~MICROBIT_COMPASS_STATUS_SAMPLE_PENDING;
+
+    // If another sample became ready while we were busy, the edge has already passed.
+    if(d->int1)
+        d->startSampleRead();
+}
+#endif
+
 /**
   * Periodic callback from MicroBit idle thread.
   *
@@ -416,34 +577,53 @@ void MicroBitCompass::idleTick()
 }
 
 /**
-  * Reads the value of the X axis from the latest update retrieved from the magnetometer.
+  * Reads all three axes from the latest update retrieved from the magnetometer.
+  *
+  * This checks for a new sample and applies the coordinate transform once, so is cheaper than
+  * calling getX(), getY() and getZ() in turn, and guarantees that all three values come from the same sample.
   *
   * @param system The coordinate system to use. By default, a simple cartesian system is provided.
   *
-  * @return The magnetic force measured in the X axis, in nano teslas.
+  * @return The magnetic force measured in each axis, in nano teslas.
   *
   * @code
-  * compass.getX();
+  * CompassSample s = compass.getSample();
   * @endcode
   */
-int MicroBitCompass::getX(MicroBitCoordinateSystem system)
+CompassSample MicroBitCompass::getSample(MicroBitCoordinateSystem system)
 {
     updateSample();
 
     switch (system)
     {
         case SIMPLE_CARTESIAN:
-            return sample.x - average.x;
+            return CompassSample(sample.x - average.x, -(sample.y - average.y), -(sample.z - average.z));
 
         case NORTH_EAST_DOWN:
-            return -(sample.y - average.y);
+            return CompassSample(-(sample.y - average.y), sample.x - average.x, -(sample.z - average.z));
 
         case RAW:
         default:
-            return sample.x;
+            return sample;
     }
 }
 
+/**
+  * Reads the value of the X axis from the latest update retrieved from the magnetometer.
+  *
+  * @param system The coordinate system to use. By default, a simple cartesian system is provided.
+  *
+  * @return The magnetic force measured in the X axis, in nano teslas.
+  *
+  * @code
+  * compass.getX();
+  * @endcode
+  */
+int MicroBitCompass::getX(MicroBitCoordinateSystem system)
+{
+    return getSample(system).x;
+}
+
 /**
   * Reads the value of the Y axis from the latest update retrieved from the magnetometer.
   *
@@ -457,20 +637,7 @@ int MicroBitCompass::getX(MicroBitCoordinateSystem system)
   */
 int MicroBitCompass::getY(MicroBitCoordinateSystem system)
 {
-    updateSample();
-
-    switch (system)
-    {
-        case SIMPLE_CARTESIAN:
-            return -(sample.y - average.y);
-
-        case NORTH_EAST_DOWN:
-            return (sample.x - average.x);
-
-        case RAW:
-        default:
-            return sample.y;
-    }
+    return getSample(system).y;
 }
 
 /**
@@ -486,18 +653,7 @@ int MicroBitCompass::getY(MicroBitCoordinateSystem system)
   */
 int MicroBitCompass::getZ(MicroBitCoordinateSystem system)
 {
-    updateSample();
-
-    switch (system)
-    {
-        case SIMPLE_CARTESIAN:
-        case NORTH_EAST_DOWN:
-            return -(sample.z - average.z);
-
-        case RAW:
-        default:
-            return sample.z;
-    }
+    return getSample(system).z;
 }
 
 /**
@@ -511,9 +667,10 @@ int MicroBitCompass::getZ(MicroBitCoordinateSystem system)
   */
 int MicroBitCompass::getFieldStrength()
 {
-    double x = getX();
-    double y = getY();
-    double z = getZ();
+    CompassSample s = getSample();
+    double x = s.x;
+    double y = s.y;
+    double z = s.z;
 
     return (int) sqrt(x*x + y*y + z*z);
 }
@@ -702,13 +859,88 @@ int MicroBitCompass::calibrate()
   */
 void MicroBitCompass::setCalibration(CompassSample calibration)
 {
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+    storeCalibration(calibration);
+
+    // Start refining the new calibration afresh.
+    calibrationSamples = 0;
+#else
     if(this->storage != NULL)
         this->storage->put(ManagedString("compassCal"), (uint8_t *)&calibration, sizeof(CompassSample));
+#endif
 
     average = calibration;
     status |= MICROBIT_COMPASS_STATUS_CALIBRATED;
 }
 
+#if CONFIG_ENABLED(MICROBIT_COMPASS_ONLINE_CALIBRATION)
+/**
+  * Refines the calibration using the latest sample. Once every axis of interest has seen enough of the
+  * field, the offsets are taken as the centre of the extremes seen, and persisted if they have changed
+  * significantly.
+  *
+  * The Z axis often sees little rotation when the device is used flat, so its offset is only updated
+  * once it has seen enough of the field in its own right.
+  */
+void MicroBitCompass::updateOnlineCalibration()
+{
+    if (calibrationSamples == 0)
+    {
+        calibrationMin = sample;
+        calibrationMax = sample;
+    }
+
+    calibrationMin.x = min(calibrationMin.x, sample.x);
+    calibrationMin.y = min(calibrationMin.y, sample.y);
+    calibrationMin.z = min(calibrationMin.z, sample.z);
+    calibrationMax.x = max(calibrationMax.x, sample.x);
+    calibrationMax.y = max(calibrationMax.y, sample.y);
+    calibrationMax.z = max(calibrationMax.z, sample.z);
+
+    // Periodically draw the extremes in towards their centre, so that outliers are eventually forgotten.
+    if (++calibrationSamples > MICROBIT_COMPASS_ONLINE_CALIBRATION_DECAY)
+    {
+        int dx = (calibrationMax.x - calibrationMin.x) / 64;
+        int dy = (calibrationMax.y - calibrationMin.y) / 64;
+        int dz = (calibrationMax.z - calibrationMin.z) / 64;
+
+        calibrationMin = CompassSample(calibrationMin.x + dx, calibrationMin.y + dy, calibrationMin.z + dz);
+        calibrationMax = CompassSample(calibrationMax.x - dx, calibrationMax.y - dy, calibrationMax.z - dz);
+
+        calibrationSamples = 1;
+    }
+
+    if (calibrationMax.x - calibrationMin.x < MICROBIT_COMPASS_ONLINE_CALIBRATION_SPAN || calibrationMax.y - calibrationMin.y < MICROBIT_COMPASS_ONLINE_CALIBRATION_SPAN)
+        return;
+
+    CompassSample estimate((calibrationMin.x + calibrationMax.x) / 2, (calibrationMin.y + calibrationMax.y) / 2, average.z);
+
+    if (calibrationMax.z - calibrationMin.z >= MICROBIT_COMPASS_ONLINE_CALIBRATION_SPAN)
+        estimate.z = (calibrationMin.z + calibrationMax.z) / 2;
+
+    average = estimate;
+    status |= MICROBIT_COMPASS_STATUS_CALIBRATED;
+
+    if (abs(estimate.x - calibrationStored.x) > MICROBIT_COMPASS_ONLINE_CALIBRATION_THRESHOLD ||
+        abs(estimate.y - calibrationStored.y) > MICROBIT_COMPASS_ONLINE_CALIBRATION_THRESHOLD ||
+        abs(estimate.z - calibrationStored.z) > MICROBIT_COMPASS_ONLINE_CALIBRATION_THRESHOLD)
+        storeCalibration(estimate);
+}
+
+/**
+  * Writes the given calibration to persistent storage, if any.
+  *
+  * @param calibration The calibration to store.
+  */
+void MicroBitCompass::storeCalibration(CompassSample calibration)
+{
+    if(this->storage != NULL)
+        this->storage->put(ManagedString("compassCal"), (uint8_t *)&calibration, sizeof(CompassSample));
+
+    calibrationStored = calibration;
+}
+#endif
+
 /**
   * Provides the calibration data currently in use by the compass.
   *
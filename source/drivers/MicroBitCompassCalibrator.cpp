@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitCompassCalibrator.h"
 #include "EventModel.h"
 #include "Matrix4.h"
+#include "MicroBitFiber.h"
 
 /**
   * Constructor.
@@ -73,7 +74,7 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
 
     wait_ms(100);
 
-	Matrix4 X(PERIMETER_POINTS, 4);
+	FixedMatrix<PERIMETER_POINTS, 4> X;
     Point perimeter[PERIMETER_POINTS] = {{1,0,0}, {2,0,0}, {3,0,0}, {4,1,0}, {4,2,0}, {4,3,0}, {3,4,0}, {2,4,0}, {1,4,0}, {0,3,0}, {0,2,0}, {0,1,0}};
     Point cursor = {2,2,0};
 
@@ -97,8 +98,9 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
         cursor.on = (cursor.on + 1) % 4;
 
         // take a snapshot of the current accelerometer data.
-        int x = accelerometer.getX();
-        int y = accelerometer.getY();
+        MMA8653Sample s = accelerometer.getSample();
+        int x = s.x;
+        int y = s.y;
 
         // Wait a little whie for the button state to stabilise (one scheduler tick).
         wait_ms(10);
@@ -145,9 +147,11 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
             if (cursor.x == perimeter[i].x && cursor.y == perimeter[i].y && !perimeter[i].on)
             {
                 // Record the sample data for later processing...
-                X.set(samples, 0, compass.getX(RAW));
-                X.set(samples, 1, compass.getY(RAW));
-                X.set(samples, 2, compass.getZ(RAW));
+                CompassSample m = compass.getSample(RAW);
+
+                X.set(samples, 0, m.x);
+                X.set(samples, 1, m.y);
+                X.set(samples, 2, m.z);
                 X.set(samples, 3, 1);
 
                 // Record that this pixel has been visited.
@@ -163,17 +167,29 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
     // We use a Least Mean Squares approximation, as detailed in Freescale application note AN2426.
 
     // Firstly, calculate the square of each sample.
-	Matrix4 Y(X.height(), 1);
+	FixedMatrix<PERIMETER_POINTS, 1> Y;
 	for (int i = 0; i < X.height(); i++)
 	{
 		float v = X.get(i, 0)*X.get(i, 0) + X.get(i, 1)*X.get(i, 1) + X.get(i, 2)*X.get(i, 2);
 		Y.set(i, 0, v);
 	}
 
-    // Now perform a Least Squares Approximation.
-	Matrix4 Alpha = X.multiplyT(X).invert();
-	Matrix4 Gamma = X.multiplyT(Y);
-	Matrix4 Beta = Alpha.multiply(Gamma);
+    // The following is compute heavy, so give other fibers the chance to run between each stage.
+    fiber_yield_if_needed();
+
+    // Now perform a Least Squares Approximation. All the intermediate results are of fixed size, so are held on the stack.
+	FixedMatrix<4, 4> Alpha;
+	FixedMatrix<4, 1> Gamma;
+	FixedMatrix<4, 1> Beta;
+
+	X.multiplyT(X, Alpha);
+    fiber_yield_if_needed();
+
+	X.multiplyT(Y, Gamma);
+    fiber_yield_if_needed();
+
+	if (Alpha.invert(Alpha) == MICROBIT_OK)
+		Alpha.multiply(Gamma, Beta);
 
     // The result contains the approximate zero point of each axis, but doubled.
     // Halve each sample, and record this as the compass calibration data.
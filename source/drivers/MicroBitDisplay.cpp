@@ -37,6 +37,30 @@ DEALINGS IN THE SOFTWARE.
 
 const int greyScaleTimings[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH] = {1, 23, 70, 163, 351, 726, 1476, 2976};
 
+/**
+  * Gathers the column bits for one row of the display, with one term per column.
+  *
+  * The number of columns is fixed at compile time, so the compiler generates straight line code
+  * with constant indices and shifts, rather than a loop.
+  */
+template <int columns>
+struct MatrixRowRenderer
+{
+    static inline uint32_t columnBits(const uint8_t *bitmap, const uint16_t *index)
+    {
+        return MatrixRowRenderer<columns - 1>::columnBits(bitmap, index) | ((uint32_t)(bitmap[index[columns - 1]] != 0) << (columns - 1));
+    }
+};
+
+template <>
+struct MatrixRowRenderer<0>
+{
+    static inline uint32_t columnBits(const uint8_t *, const uint16_t *)
+    {
+        return 0;
+    }
+};
+
 /**
   * Constructor.
   *
@@ -76,12 +100,31 @@ MicroBitDisplay::MicroBitDisplay(uint16_t id, const MatrixMap &map) :
 
     LEDMatrix = new PortOut(Port0, row_mask | col_mask);
 
-    this->greyscaleBitMsk = 0x01;
+    // If we're driving the board's own LED matrix, render() can use the layout fixed at build time.
+    // We compare the layout rather than the address of the map, as each translation unit has its own copy of microbitMatrixMap.
+    if (matrixMap.rows == MICROBIT_DISPLAY_ROW_COUNT && matrixMap.columns == MICROBIT_DISPLAY_COLUMN_COUNT &&
+        matrixMap.rowStart == MICROBIT_DISPLAY_ROW1 && matrixMap.columnStart == MICROBIT_DISPLAY_COL1)
+        status |= MICROBIT_DISPLAY_BUILTIN_LAYOUT;
+
+    pixelIndex = new uint16_t[matrixMap.rows * matrixMap.columns];
+    updatePixelIndex();
+
+    frameBufferSize = image.getWidth() * image.getHeight();
+    frameBuffer = new uint8_t[frameBufferSize];
+    composing = false;
+    latchFrame();
+
     this->timingCount = 0;
     this->setBrightness(MICROBIT_DISPLAY_DEFAULT_BRIGHTNESS);
     this->mode = DISPLAY_MODE_BLACK_AND_WHITE;
     this->animationMode = ANIMATION_MODE_NONE;
+    this->waitQueue = NULL;
+    this->animationFiber = NULL;
+    this->animationQueue = NULL;
+    this->framesDue = 0;
+    this->animationStepTime = 0;
     this->lightSensor = NULL;
+    this->lightSenseFrame = 0;
 
 	system_timer_add_component(this);
 
@@ -109,15 +152,19 @@ void MicroBitDisplay::systemTick()
     strobeRow++;
 
     //reset the row counts and bit mask when we have hit the max.
-    if(strobeRow == matrixMap.rows)
+    //(this may be passed on leaving light sensing mode, which uses additional rows to take readings)
+    if(strobeRow >= matrixMap.rows)
         strobeRow = 0;
 
+    // Each frame is rendered from a single, consistent snapshot of the image.
+    if(strobeRow == 0)
+        latchFrame();
+
     if(mode == DISPLAY_MODE_BLACK_AND_WHITE)
         render();
 
     if(mode == DISPLAY_MODE_GREYSCALE)
     {
-        greyscaleBitMsk = 0x01;
         timingCount = 0;
         renderGreyscale();
     }
@@ -142,42 +189,37 @@ void MicroBitDisplay::render()
     }
 
     // Calculate the bitpattern to write.
-    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
+    uint32_t row_data;
     uint32_t col_data = 0;
 
-    for (int i = 0; i < matrixMap.columns; i++)
+    uint8_t *bitmap = frameBuffer;
+
+    if (status & MICROBIT_DISPLAY_BUILTIN_LAYOUT)
     {
-        int index = (i * matrixMap.rows) + strobeRow;
+        uint16_t *index = &pixelIndex[strobeRow * MICROBIT_DISPLAY_COLUMN_COUNT];
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
+        row_data = 0x01 << (MICROBIT_DISPLAY_ROW1 + strobeRow);
+        col_data = MatrixRowRenderer<MICROBIT_DISPLAY_COLUMN_COUNT>::columnBits(bitmap, index);
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
-        {
-                x = width - 1 - y;
-                y = t;
-        }
+        // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
+        col_data = ~col_data << MICROBIT_DISPLAY_COL1 & col_mask;
+    }
+    else
+    {
+        uint16_t *index = &pixelIndex[strobeRow * matrixMap.columns];
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
-        {
-                x = width - 1 - x;
-                y = height - 1 - y;
-        }
+        row_data = 0x01 << (matrixMap.rowStart + strobeRow);
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+        for (int i = 0; i < matrixMap.columns; i++)
         {
-                x = y;
-                y = height - 1 - t;
+            if(bitmap[index[i]])
+                col_data |= (1 << i);
         }
 
-        if(image.getBitmap()[y*(width*2)+x])
-            col_data |= (1 << i);
+        // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
+        col_data = ~col_data << matrixMap.columnStart & col_mask;
     }
 
-    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
-    col_data = ~col_data << matrixMap.columnStart & col_mask;
-
     // Write the new bit pattern
     *LEDMatrix = col_data | row_data;
 
@@ -190,23 +232,79 @@ void MicroBitDisplay::render()
         renderFinish();
 }
 
+/**
+  * Renders the display whilst interleaving light readings, which are taken once every
+  * MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES frames. All other frames are rendered back to back.
+  */
 void MicroBitDisplay::renderWithLightSense()
 {
-    //reset the row counts and bit mask when we have hit the max.
-    if(strobeRow == matrixMap.rows + 1)
+    if(strobeRow == matrixMap.rows)
     {
-        MicroBitEvent(id, MICROBIT_DISPLAY_EVT_LIGHT_SENSE);
-        strobeRow = 0;
+        if (++lightSenseFrame < MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES)
+        {
+            // No reading is due, so go straight on to the next frame.
+            strobeRow = 0;
+        }
+        else
+        {
+            // Hold the display dark for a tick, so that the LEDs settle before they are sampled.
+            lightSenseFrame = 0;
+            renderFinish();
+            this->animationUpdate();
+
+            strobeRow++;
+            return;
+        }
     }
-    else
+    else if(strobeRow == matrixMap.rows + 1)
     {
-        render();
+        // Take a reading. The light sensor holds the matrix pins until it completes, before the next tick.
+        if (lightSensor != NULL)
+            lightSensor->startSensing(MicroBitEvent(id, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, CREATE_ONLY));
+
         this->animationUpdate();
 
-        // Move on to the next row.
-        strobeRow++;
+        strobeRow = 0;
+        return;
+    }
+
+    // Each frame is rendered from a single, consistent snapshot of the image.
+    if(strobeRow == 0)
+        latchFrame();
+
+    render();
+    this->animationUpdate();
+
+    // Move on to the next row.
+    strobeRow++;
+}
+
+/**
+  * Calculates the bit pattern to write for each bit plane of the current row, for greyscale rendering.
+  */
+void MicroBitDisplay::updateGreyscalePlanes()
+{
+    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
+    uint32_t col_data[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH];
+
+    uint8_t *bitmap = frameBuffer;
+    uint16_t *index = &pixelIndex[strobeRow * matrixMap.columns];
+
+    for (int b = 0; b < MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH; b++)
+        col_data[b] = 0;
+
+    for (int i = 0; i < matrixMap.columns; i++)
+    {
+        int value = min(bitmap[index[i]], brightness);
+
+        for (int b = 0; value != 0; b++, value >>= 1)
+            if (value & 0x01)
+                col_data[b] |= (1 << i);
     }
 
+    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
+    for (int b = 0; b < MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH; b++)
+        greyscalePlanes[b] = (~col_data[b] << matrixMap.columnStart & col_mask) | row_data;
 }
 
 void MicroBitDisplay::renderGreyscale()
@@ -219,58 +317,92 @@ void MicroBitDisplay::renderGreyscale()
         return;
     }
 
-    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
-    uint32_t col_data = 0;
+    // Decompose the row into its bit planes once, at the start of the row.
+    // Each sub-frame is then a single write, held for a period proportional to the weight of its bit.
+    if(timingCount == 0)
+        updateGreyscalePlanes();
 
-    // Calculate the bitpattern to write.
-    for (int i = 0; i < matrixMap.columns; i++)
+    // Once every bit plane has been shown, the row is complete.
+    if(timingCount > MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH-1)
     {
-        int index = (i * matrixMap.rows) + strobeRow;
+        renderFinish();
+        return;
+    }
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
+    // Write the bit pattern for this bit plane
+    *LEDMatrix = greyscalePlanes[timingCount];
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
-        {
-                x = width - 1 - y;
-                y = t;
-        }
-
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
-        {
-                x = width - 1 - x;
-                y = height - 1 - y;
-        }
+    if(timingCount < 3)
+    {
+        wait_us(greyScaleTimings[timingCount++]);
+        renderGreyscale();
+        return;
+    }
+    renderTimer.attach_us(this,&MicroBitDisplay::renderGreyscale, greyScaleTimings[timingCount++]);
+}
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+/**
+  * Rebuilds the table mapping each LED drive position to the image pixel it displays, for the current rotation.
+  */
+void MicroBitDisplay::updatePixelIndex()
+{
+    for (int row = 0; row < matrixMap.rows; row++)
+    {
+        for (int i = 0; i < matrixMap.columns; i++)
         {
-                x = y;
-                y = height - 1 - t;
+            int index = (i * matrixMap.rows) + row;
+
+            int x = matrixMap.map[index].x;
+            int y = matrixMap.map[index].y;
+            int t = x;
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_90)
+            {
+                    x = width - 1 - y;
+                    y = t;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_180)
+            {
+                    x = width - 1 - x;
+                    y = height - 1 - y;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+            {
+                    x = y;
+                    y = height - 1 - t;
+            }
+
+            pixelIndex[row * matrixMap.columns + i] = y * (width * 2) + x;
         }
-
-        if(min(image.getBitmap()[y * (width * 2) + x],brightness) & greyscaleBitMsk)
-            col_data |= (1 << i);
     }
+}
 
-    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
-    col_data = ~col_data << matrixMap.columnStart & col_mask;
-
-    // Write the new bit pattern
-    *LEDMatrix = col_data | row_data;
-
-    if(timingCount > MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH-1)
+/**
+  * Takes a copy of the image to display as the next frame, unless an animation frame is being composed.
+  */
+void MicroBitDisplay::latchFrame()
+{
+    // If a frame is part way through composition, keep showing the last complete one.
+    if (composing)
         return;
 
-    greyscaleBitMsk <<= 1;
+    int size = min(frameBufferSize, image.getWidth() * image.getHeight());
 
-    if(timingCount < 3)
+    if (image.getFormat() == IMAGE_FORMAT_8BPP)
     {
-        wait_us(greyScaleTimings[timingCount++]);
-        renderGreyscale();
+        memcpy(frameBuffer, image.getBitmap(), size);
         return;
     }
-    renderTimer.attach_us(this,&MicroBitDisplay::renderGreyscale, greyScaleTimings[timingCount++]);
+
+    // Packed images are expanded to one byte per pixel, so the renderer need not know how the image is stored.
+    int width = image.getWidth();
+    uint8_t *p = frameBuffer;
+
+    for (int y = 0; y < image.getHeight() && p + width <= frameBuffer + size; y++)
+        for (int x = 0; x < width; x++)
+            *p++ = image.getPixelValue(x, y);
 }
 
 /**
@@ -289,23 +421,128 @@ MicroBitDisplay::animationUpdate()
     {
         animationTick = 0;
 
-        if (animationMode == ANIMATION_MODE_SCROLL_TEXT)
-            this->updateScrollText();
+        // If frames are composed by the animation fiber, just note that another is due.
+        // Otherwise compose it now, unless the previous frame is still being composed.
+        if (animationFiber != NULL)
+        {
+            if (framesDue < 0xFFFF)
+                framesDue++;
+        }
+        else if (!composing)
+        {
+            updateAnimation();
+        }
+    }
 
-        if (animationMode == ANIMATION_MODE_PRINT_TEXT)
-            this->updatePrintText();
+    // Wake the animation fiber if it has work to do. This is retried on every tick,
+    // in case a frame fell due just as the fiber was about to wait.
+    if (framesDue > 0 && animationQueue != NULL)
+        fiber_wake_one(&animationQueue);
+}
 
-        if (animationMode == ANIMATION_MODE_SCROLL_IMAGE)
-            this->updateScrollImage();
+/**
+  * Creates the fiber used to compose animation frames, if it is enabled and does not yet exist.
+  *
+  * Until it exists, frames are composed in the system timer interrupt. The fiber is only created from
+  * thread context while the display is enabled, as creating a fiber allocates memory.
+  */
+void MicroBitDisplay::startAnimationFiber()
+{
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_DEFERRED_ANIMATION)
+    if (animationFiber == NULL && (status & MICROBIT_COMPONENT_RUNNING) && fiber_scheduler_running() && !inInterruptContext())
+        animationFiber = create_fiber(MicroBitDisplay::animationTask, this);
+#endif
+}
+
+/**
+  * Retires the animation fiber, if it exists. The fiber exits, and its memory is released, once it next runs.
+  *
+  * Frames are then composed in the system timer interrupt, until the fiber is started again.
+  */
+void MicroBitDisplay::stopAnimationFiber()
+{
+    if (animationFiber == NULL)
+        return;
+
+    __disable_irq();
+    animationFiber = NULL;
+    framesDue = 0;
+    __enable_irq();
+
+    // Let the fiber see that it has been retired.
+    fiber_wake_one(&animationQueue);
+}
 
-        if (animationMode == ANIMATION_MODE_ANIMATE_IMAGE || animationMode == ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR)
-            this->updateAnimateImage();
+/**
+  * The animation fiber, which composes each animation frame as it falls due, outside of interrupt context.
+  *
+  * If the fiber falls behind, it catches up by composing the missed frames without showing them,
+  * spending no more than one frame period doing so. Any frames still outstanding are then dropped,
+  * so a costly animation runs more slowly, rather than falling ever further behind.
+  *
+  * @param display The MicroBitDisplay to update.
+  */
+void MicroBitDisplay::animationTask(void *display)
+{
+    MicroBitDisplay *d = (MicroBitDisplay *)display;
 
-        if(animationMode == ANIMATION_MODE_PRINT_CHARACTER)
+    // Run until retired by stopAnimationFiber(). A replacement may already have been started by then.
+    while (d->animationFiber == currentFiber)
+    {
+        if (d->framesDue == 0)
         {
-            animationMode = ANIMATION_MODE_NONE;
-            this->sendAnimationCompleteEvent();
+            fiber_wait_on_queue(&d->animationQueue);
+            continue;
         }
+
+        // Hold the current frame on the display until the new one is complete.
+        d->composing = true;
+
+        uint64_t start = system_timer_current_time_us();
+        uint32_t budget = (uint32_t)d->animationDelay * 1000;
+        uint32_t elapsed;
+
+        do
+        {
+            __disable_irq();
+            d->framesDue--;
+            __enable_irq();
+
+            d->updateAnimation();
+
+            elapsed = (uint32_t)(system_timer_current_time_us() - start);
+        } while (d->framesDue > 0 && elapsed < budget && d->animationMode != ANIMATION_MODE_NONE);
+
+        __disable_irq();
+        d->framesDue = 0;
+        __enable_irq();
+
+        d->animationStepTime = elapsed;
+        d->composing = false;
+    }
+}
+
+/**
+  * Moves any ongoing animation on to its next frame, composing that frame into the image.
+  */
+void MicroBitDisplay::updateAnimation()
+{
+    if (animationMode == ANIMATION_MODE_SCROLL_TEXT)
+        this->updateScrollText();
+
+    if (animationMode == ANIMATION_MODE_PRINT_TEXT)
+        this->updatePrintText();
+
+    if (animationMode == ANIMATION_MODE_SCROLL_IMAGE)
+        this->updateScrollImage();
+
+    if (animationMode == ANIMATION_MODE_ANIMATE_IMAGE || animationMode == ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR)
+        this->updateAnimateImage();
+
+    if(animationMode == ANIMATION_MODE_PRINT_CHARACTER)
+    {
+        animationMode = ANIMATION_MODE_NONE;
+        this->sendAnimationCompleteEvent();
     }
 }
 
@@ -319,7 +556,7 @@ void MicroBitDisplay::sendAnimationCompleteEvent()
     MicroBitEvent(id,MICROBIT_DISPLAY_EVT_ANIMATION_COMPLETE);
 
     // Wake up a fiber that was blocked on the animation (if any).
-    MicroBitEvent(MICROBIT_ID_NOTIFY_ONE, MICROBIT_DISPLAY_EVT_FREE);
+    fiber_wake_one(&waitQueue);
 }
 
 /**
@@ -429,12 +666,13 @@ void MicroBitDisplay::stopAnimation()
     if (animationMode != ANIMATION_MODE_NONE)
     {
         animationMode = ANIMATION_MODE_NONE;
+        framesDue = 0;
 
         // Indicate that we've completed an animation.
         MicroBitEvent(id,MICROBIT_DISPLAY_EVT_ANIMATION_COMPLETE);
 
         // Wake up aall fibers that may blocked on the animation (if any).
-        MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_DISPLAY_EVT_FREE);
+        fiber_wake_all(&waitQueue);
     }
 
     // Clear the display and setup the animation timers.
@@ -449,7 +687,7 @@ void MicroBitDisplay::waitForFreeDisplay()
 {
     // If there's an ongoing animation, wait for our turn to display.
     if (animationMode != ANIMATION_MODE_NONE && animationMode != ANIMATION_MODE_STOPPED)
-        fiber_wait_for_event(MICROBIT_ID_NOTIFY, MICROBIT_DISPLAY_EVT_FREE);
+        fiber_wait_on_queue(&waitQueue);
 }
 
 /**
@@ -493,6 +731,7 @@ int MicroBitDisplay::printCharAsync(char c, int delay)
         {
             animationDelay = delay;
             animationTick = 0;
+            startAnimationFiber();
             animationMode = ANIMATION_MODE_PRINT_CHARACTER;
         }
     }
@@ -534,6 +773,7 @@ int MicroBitDisplay::printAsync(ManagedString s, int delay)
         printingText = s;
         animationDelay = delay;
         animationTick = 0;
+        startAnimationFiber();
 
         animationMode = ANIMATION_MODE_PRINT_TEXT;
     }
@@ -577,6 +817,7 @@ int MicroBitDisplay::printAsync(MicroBitImage i, int x, int y, int alpha, int de
         {
             animationDelay = delay;
             animationTick = 0;
+            startAnimationFiber();
             animationMode = ANIMATION_MODE_PRINT_CHARACTER;
         }
     }
@@ -751,6 +992,7 @@ int MicroBitDisplay::scrollAsync(ManagedString s, int delay)
 
         animationDelay = delay;
         animationTick = 0;
+        startAnimationFiber();
         animationMode = ANIMATION_MODE_SCROLL_TEXT;
     }
     else
@@ -795,6 +1037,7 @@ int MicroBitDisplay::scrollAsync(MicroBitImage image, int delay, int stride)
 
         animationDelay = stride == 0 ? 0 : delay;
         animationTick = 0;
+        startAnimationFiber();
         animationMode = ANIMATION_MODE_SCROLL_IMAGE;
     }
     else
@@ -938,6 +1181,7 @@ int MicroBitDisplay::animateAsync(MicroBitImage image, int delay, int stride, in
 
         animationDelay = stride == 0 ? 0 : delay;
         animationTick = delay-1;
+        startAnimationFiber();
         animationMode = autoClear ? ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR : ANIMATION_MODE_ANIMATE_IMAGE;
     }
     else
@@ -1078,6 +1322,20 @@ int MicroBitDisplay::getBrightness()
     return this->brightness;
 }
 
+/**
+  * Fetches the time taken to compose the most recent animation frame, when frames are composed in a fiber.
+  *
+  * @return the time in microseconds, or 0 if no frame has been composed by the animation fiber.
+  *
+  * @code
+  * display.getAnimationStepTime(); //the cost of the last scroll step
+  * @endcode
+  */
+int MicroBitDisplay::getAnimationStepTime()
+{
+    return this->animationStepTime;
+}
+
 /**
   * Rotates the display to the given position.
   *
@@ -1090,6 +1348,7 @@ int MicroBitDisplay::getBrightness()
 void MicroBitDisplay::rotateTo(DisplayRotation rotation)
 {
     this->rotation = rotation;
+    updatePixelIndex();
 }
 
 /**
@@ -1116,9 +1375,13 @@ void MicroBitDisplay::setEnable(bool enableDisplay)
     {
         PortOut p(Port0, rmask | cmask);
         status |= MICROBIT_COMPONENT_RUNNING;
+
+        startAnimationFiber();
     }
     else
     {
+        stopAnimationFiber();
+
         PortIn p(Port0, rmask | cmask);
         p.mode(PullNone);
         status &= ~MICROBIT_COMPONENT_RUNNING;
@@ -1132,11 +1395,15 @@ void MicroBitDisplay::setEnable(bool enableDisplay)
   * display.enable(); //Enables the display mechanics
   * @endcode
   *
-  * @note Only enables the display if the display is currently disabled.
+  * @note Only enables the display if the display is currently disabled. The animation fiber is created
+  *       here in either case, if it does not yet exist.
   */
 void MicroBitDisplay::enable()
 {
     setEnable(true);
+
+    // The display starts out enabled, so create the animation fiber here too, rather than on first use.
+    startAnimationFiber();
 }
 
 /**
@@ -1233,4 +1500,7 @@ int MicroBitDisplay::readLightLevel()
 MicroBitDisplay::~MicroBitDisplay()
 {
     system_timer_remove_component(this);
+
+    delete[] pixelIndex;
+    delete[] frameBuffer;
 }
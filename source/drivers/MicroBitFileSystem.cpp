@@ -4,6 +4,7 @@
 #include "MicroBitStorage.h"        
 #include "MicroBitCompat.h"
 #include "ErrorNo.h"
+#include "MicroBitFiber.h"
 
 static uint32_t *defaultScratchPage = (uint32_t *)DEFAULT_SCRATCH_PAGE;
 
@@ -17,37 +18,92 @@ MicroBitFileSystem* MicroBitFileSystem::defaultFileSystem = NULL;
 uint16_t MicroBitFileSystem::getFreeBlock()
 {
     // Walk the File Table and allocate the first free block - starting immediately after the last block allocated,
-    // and wrapping around the filesystem space if we reach the end.
-    uint16_t block;
-    uint16_t deletedBlock = 0;
+    // and wrapping around the filesystem space if we reach the end. Pages with no free blocks are skipped whole.
+    int blocksPerPage = (PAGE_SIZE / MBFS_BLOCK_SIZE);
+    uint16_t block = (lastBlockAllocated + 1) % fileSystemSize;
+    uint16_t deletedPage = 0;
+    int freeBlocks, deletedBlocks;
+    int scanned = 0;
 
-    for (block = (lastBlockAllocated + 1) % fileSystemSize; block != lastBlockAllocated; block++)
+    while (scanned < fileSystemSize)
     {
-        if (fileSystemTable[block] == MBFS_UNUSED)
+        uint16_t page = block - (block % blocksPerPage);
+
+        getPageSummary(page, &freeBlocks, &deletedBlocks);
+
+        if (deletedBlocks && !deletedPage)
+            deletedPage = page;
+
+        for (; freeBlocks && block < page + blocksPerPage; block++, scanned++)
         {
-            lastBlockAllocated = block;
-            return block;
+            if (fileSystemTable[block] == MBFS_UNUSED)
+            {
+                lastBlockAllocated = block;
+                return block;
+            }
         }
 
-        if (fileSystemTable[block] == MBFS_DELETED)
-            deletedBlock = block;
+        scanned += page + blocksPerPage - block;
+        block = (page + blocksPerPage) % fileSystemSize;
     }
 
-    // if no UNUSED blocks are available, try to recycle one marked as DELETED.
-    block = deletedBlock;
-
+    // If no UNUSED blocks are available, try to recycle one marked as DELETED.
     // If no blocks are available - either UNUSED or marked as DELETED, then we're out of space and there's nothing we can do.
-    if (block)
+    if (deletedPage == 0)
+        return 0;
+
+    for (block = deletedPage; fileSystemTable[block] != MBFS_DELETED; block++);
+
+    // recycle the FileTable, such that we can mark all previously deleted blocks as re-usable.
+    // Better to do this in bulk, rather than on a block by block basis to improve efficiency. 
+    recycleFileTable();
+
+    // Record the block we just allocated, so we can round-robin around blocks for load balancing.
+    lastBlockAllocated = block;
+
+    return block;
+}
+
+/**
+  * Find a run of consecutive UNUSED logical blocks.
+  * The run starting at the given block is preferred, so that a file can be extended in place.
+  * Otherwise, the table is searched round robin from the last block allocated, to even out wear.
+  *
+  * @param start The preferred first block of the run.
+  * @param count The number of blocks required.
+  * @return the first block of the run on success, or zero if no such run is available.
+  */
+uint16_t MicroBitFileSystem::getFreeBlocks(uint16_t start, int count)
+{
+    int run = 0;
+    int scanned;
+    uint16_t block;
+
+    // Try the preferred location first.
+    for (block = start; block < fileSystemSize && run < count && fileSystemTable[block] == MBFS_UNUSED; block++)
+        run++;
+
+    if (run == count)
+        return start;
+
+    // Otherwise walk the whole table once. Runs cannot wrap, as they must be physically contiguous.
+    run = 0;
+    block = (lastBlockAllocated + 1) % fileSystemSize;
+
+    for (scanned = 0; scanned < fileSystemSize; scanned++)
     {
-        // recycle the FileTable, such that we can mark all previously deleted blocks as re-usable.
-        // Better to do this in bulk, rather than on a block by block basis to improve efficiency. 
-        recycleFileTable();
+        if (block == 0)
+            run = 0;
+
+        run = fileSystemTable[block] == MBFS_UNUSED ? run + 1 : 0;
 
-        // Record the block we just allocated, so we can round-robin around blocks for load balancing.
-        lastBlockAllocated = block;
+        if (run == count)
+            return block - (count - 1);
+
+        block = (block + 1) % fileSystemSize;
     }
 
-    return block;
+    return 0;
 }
 
 /**
@@ -59,6 +115,7 @@ uint32_t* MicroBitFileSystem::getFreePage()
 {
     // Walk the file table, starting at the last allocated block, looking for an unused page.
     int blocksPerPage = (PAGE_SIZE / MBFS_BLOCK_SIZE);
+    int freeBlocks, deletedBlocks;
 
     // get a handle on the next physical page.
     uint16_t currentPage = getBlockNumber(getPage(lastBlockAllocated));
@@ -68,33 +125,17 @@ uint32_t* MicroBitFileSystem::getFreePage()
     // Walk around the file table, looking for a free page.
     while (page != currentPage)
     {
-        bool empty = true;
-        bool deleted = false;
-        uint16_t next;
-
-        for (int i = 0; i < blocksPerPage; i++)
-        {
-            next = getNextFileBlock(page + i);
-            
-            if (next == MBFS_DELETED)
-                deleted = true;
-            
-            else if (next != MBFS_UNUSED)
-            {
-                empty = false;
-                break;
-            }
-        }
+        getPageSummary(page, &freeBlocks, &deletedBlocks);
 
         // See if we found one...
-        if (empty)
+        if (freeBlocks == blocksPerPage)
         {
             lastBlockAllocated = page;
             return getBlock(page);
         }
 
         // make note of the first unused but un-erased page we find (if any).
-        if (deleted && !recyclablePage)
+        if (deletedBlocks && freeBlocks + deletedBlocks == blocksPerPage && !recyclablePage)
             recyclablePage = page;
 
         page = (page + blocksPerPage) % fileSystemSize;
@@ -113,12 +154,162 @@ uint32_t* MicroBitFileSystem::getFreePage()
     return defaultScratchPage;
 }
 
+/**
+  * Rebuild the per-page counts of UNUSED and DELETED blocks from the file table, allocating them if necessary.
+  */
+void MicroBitFileSystem::buildPageSummary()
+{
+    int blocksPerPage = (PAGE_SIZE / MBFS_BLOCK_SIZE);
+    int pages = fileSystemSize / blocksPerPage;
+
+    status |= MBFS_STATUS_PAGES_COUNTED;
+
+    if (pageFreeBlocks == NULL)
+    {
+        pageFreeBlocks = (uint8_t *)malloc(pages);
+        pageDeletedBlocks = (uint8_t *)malloc(pages);
+
+        // If we don't have the RAM, fall back to scanning the file table.
+        if (pageFreeBlocks == NULL || pageDeletedBlocks == NULL)
+        {
+            free(pageFreeBlocks);
+            free(pageDeletedBlocks);
+            pageFreeBlocks = pageDeletedBlocks = NULL;
+            return;
+        }
+    }
+
+    for (int p = 0; p < pages; p++)
+    {
+        pageFreeBlocks[p] = 0;
+        pageDeletedBlocks[p] = 0;
+
+        for (int i = 0; i < blocksPerPage; i++)
+        {
+            uint16_t next = fileSystemTable[p * blocksPerPage + i];
+
+            if (next == MBFS_UNUSED)
+                pageFreeBlocks[p]++;
+
+            if (next == MBFS_DELETED)
+                pageDeletedBlocks[p]++;
+        }
+    }
+}
+
+/**
+  * Determine how many blocks of a physical page are UNUSED, and how many are DELETED.
+  *
+  * @param page The number of the first block in the page.
+  * @param freeBlocks Set to the number of UNUSED blocks in the page.
+  * @param deletedBlocks Set to the number of DELETED blocks in the page.
+  */
+void MicroBitFileSystem::getPageSummary(uint16_t page, int *freeBlocks, int *deletedBlocks)
+{
+    int blocksPerPage = (PAGE_SIZE / MBFS_BLOCK_SIZE);
+
+    // Counting may have been deferred at mount.
+    if ((status & MBFS_STATUS_PAGES_COUNTED) == 0)
+        buildPageSummary();
+
+    if (pageFreeBlocks)
+    {
+        *freeBlocks = pageFreeBlocks[page / blocksPerPage];
+        *deletedBlocks = pageDeletedBlocks[page / blocksPerPage];
+        return;
+    }
+
+    *freeBlocks = 0;
+    *deletedBlocks = 0;
+
+    for (int i = 0; i < blocksPerPage; i++)
+    {
+        uint16_t next = getNextFileBlock(page + i);
+
+        if (next == MBFS_UNUSED)
+            (*freeBlocks)++;
+
+        if (next == MBFS_DELETED)
+            (*deletedBlocks)++;
+    }
+}
+
+/**
+  * Calculate the checksum of a file system summary.
+  *
+  * @param summary The summary to check.
+  * @return the checksum of the summary.
+  */
+uint16_t MicroBitFileSystem::getSummaryChecksum(FileSystemSummary *summary)
+{
+    return summary->marker + summary->lastBlockAllocated + summary->freeBlocks + summary->deletedBlocks + summary->fileSystemTableSize;
+}
+
+/**
+  * Record a summary of the file table in the root directory, if there is not already an up to date one.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the root directory is full.
+  */
+int MicroBitFileSystem::writeSummary()
+{
+    FileSystemSummary summary;
+    DirectoryEntry *dirent;
+
+    if (mountSummary)
+        return MICROBIT_OK;
+
+    // Allocate the entry first, as extending the root directory changes the file table.
+    dirent = createDirectoryEntry(rootDirectory);
+    if (dirent == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    memset(&summary, 0, sizeof(FileSystemSummary));
+
+    for (uint16_t block = 0; block < fileSystemSize; block++)
+    {
+        if (fileSystemTable[block] == MBFS_UNUSED)
+            summary.freeBlocks++;
+
+        if (fileSystemTable[block] == MBFS_DELETED)
+            summary.deletedBlocks++;
+    }
+
+    summary.lastBlockAllocated = lastBlockAllocated;
+    summary.fileSystemTableSize = fileSystemTableSize;
+    summary.checksum = getSummaryChecksum(&summary);
+    summary.rootBlock = rootDirectory->first_block;
+    summary.flags = MBFS_DIRECTORY_ENTRY_VALID | MBFS_DIRECTORY_ENTRY_SUMMARY;
+    summary.fileSystemSize = fileSystemSize;
+
+    flash.flash_write(dirent, &summary, sizeof(FileSystemSummary));
+    mountSummary = (FileSystemSummary *)dirent;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Mark the summary of the file table as out of date, as the file table is about to change.
+  */
+void MicroBitFileSystem::invalidateSummary()
+{
+    uint16_t value = MBFS_DIRECTORY_ENTRY_DELETED;
+
+    if (mountSummary == NULL)
+        return;
+
+    // Clearing the flags only clears bits, so needs no erase.
+    flash.flash_write(&mountSummary->flags, &value, 2);
+    mountSummary = NULL;
+}
+
 
 /**
   * Constructor. Creates an instance of a MicroBitFileSystem.
   */
 MicroBitFileSystem::MicroBitFileSystem(uint32_t flashStart, int flashPages)
 {
+    cacheBytesAllocated = 0;
+
     // Attempt tp load an existing filesystem, if it exisits
     init(flashStart, flashPages);
 
@@ -154,6 +345,13 @@ int MicroBitFileSystem::init(uint32_t flashStart, int flashPages)
     lastBlockAllocated = 0;
     rootDirectory = NULL;
     openFiles = NULL;
+    pageFreeBlocks = NULL;
+    pageDeletedBlocks = NULL;
+    mountSummary = NULL;
+
+#if MBFS_DIRECTORY_INDEX_SIZE > 0
+    memset(directoryIndex, 0, sizeof(directoryIndex));
+#endif
 
     // If we have a zero length, then dynamically determine our geometry.
     if (flashStart == 0)
@@ -184,8 +382,18 @@ int MicroBitFileSystem::init(uint32_t flashStart, int flashPages)
         format();
     }
 
+    // Summarise the free space in each page, to speed up allocation.
+    // If the file table was summarised when last used, this is deferred until we first allocate.
+    if (mountSummary == NULL)
+        buildPageSummary();
+
+#if CONFIG_ENABLED(MBFS_BACKGROUND_GC)
+    // Collect deleted blocks when we're otherwise idle.
+    fiber_add_idle_component(this);
+#endif
+
     // indicate that we have a valid FileSystem
-    status = MBFS_STATUS_INITIALISED;
+    status |= MBFS_STATUS_INITIALISED;
     return MICROBIT_OK;
 }
 
@@ -214,6 +422,42 @@ int MicroBitFileSystem::load()
     fileSystemSize = root->length;
     fileSystemTableSize = calculateFileTableSize();
 
+    // Look for a summary of the file table, and index the files in the root directory.
+    // The first entry holds our signature, so is skipped.
+    uint16_t block = rootDirectory->first_block;
+
+    while (block != MBFS_EOF)
+    {
+        DirectoryEntry *dirent = (DirectoryEntry *)getBlock(block);
+
+        for (uint16_t entry = 0; entry < MBFS_BLOCK_SIZE / sizeof(DirectoryEntry); entry++, dirent++)
+        {
+            if (dirent->flags == (MBFS_DIRECTORY_ENTRY_VALID | MBFS_DIRECTORY_ENTRY_SUMMARY))
+            {
+                FileSystemSummary *summary = (FileSystemSummary *)dirent;
+
+                // Only trust a summary that is complete, and describes this file system.
+                // There should only ever be one, but retire any others we find.
+                invalidateSummary();
+                mountSummary = summary;
+
+                if (summary->checksum == getSummaryChecksum(summary) && summary->fileSystemSize == (uint32_t)fileSystemSize &&
+                    summary->fileSystemTableSize == fileSystemTableSize && summary->rootBlock == rootDirectory->first_block &&
+                    summary->lastBlockAllocated < fileSystemSize)
+                    lastBlockAllocated = summary->lastBlockAllocated;
+                else
+                    invalidateSummary();
+            }
+
+#if MBFS_DIRECTORY_INDEX_SIZE > 0
+            else if (dirent != rootDirectory && (dirent->flags & MBFS_DIRECTORY_ENTRY_VALID) && !(dirent->flags & MBFS_DIRECTORY_ENTRY_FREE))
+                indexDirectoryEntry(dirent, rootDirectory);
+#endif
+        }
+
+        block = getNextFileBlock(block);
+    }
+
     return MICROBIT_OK;
 }
 
@@ -276,6 +520,14 @@ DirectoryEntry* MicroBitFileSystem::getDirectoryEntry(char const * filename, con
     if (directory == NULL)
         directory = rootDirectory;
 
+#if MBFS_DIRECTORY_INDEX_SIZE > 0
+    // Try the RAM index first. The slot may be stale, so check it still refers to the file we want.
+    DirectoryIndexEntry *slot = &directoryIndex[getDirectoryIndexSlot(file, directory)];
+
+    if (slot->dirent && slot->directory == directory->first_block && (slot->dirent->flags & MBFS_DIRECTORY_ENTRY_VALID) && strcmp(slot->dirent->file_name, file) == 0)
+        return slot->dirent;
+#endif
+
     block = directory->first_block;
     dir = (Directory *) getBlock(block);
     dirent = &dir->entry[0];
@@ -295,7 +547,10 @@ DirectoryEntry* MicroBitFileSystem::getDirectoryEntry(char const * filename, con
 
         // Check for a valid match
         if (dirent->flags & MBFS_DIRECTORY_ENTRY_VALID && strcmp(dirent->file_name, file) == 0)
+        {
+            indexDirectoryEntry(dirent, directory);
             return dirent;
+        }
 
         // Move onto the next entry.
         dirent++;
@@ -304,6 +559,40 @@ DirectoryEntry* MicroBitFileSystem::getDirectoryEntry(char const * filename, con
     return NULL;
 }
 
+/**
+  * Determine the slot of the RAM directory index used for the given file.
+  *
+  * @param file The name of the file, without any path.
+  * @param directory The directory holding the file.
+  * @return The index of the slot for this file.
+  */
+int MicroBitFileSystem::getDirectoryIndexSlot(char const * file, const DirectoryEntry *directory)
+{
+    uint32_t hash = directory->first_block;
+
+    while (*file)
+        hash = hash * 31 + *file++;
+
+    return hash % max(MBFS_DIRECTORY_INDEX_SIZE, 1);
+}
+
+/**
+  * Record the location of a directory entry in the RAM directory index, so that it can be found without a directory scan.
+  * Does nothing if MBFS_DIRECTORY_INDEX_SIZE is zero.
+  *
+  * @param dirent The directory entry to record.
+  * @param directory The directory holding the entry.
+  */
+void MicroBitFileSystem::indexDirectoryEntry(DirectoryEntry *dirent, const DirectoryEntry *directory)
+{
+#if MBFS_DIRECTORY_INDEX_SIZE > 0
+    DirectoryIndexEntry *slot = &directoryIndex[getDirectoryIndexSlot(dirent->file_name, directory)];
+
+    slot->dirent = dirent;
+    slot->directory = directory->first_block;
+#endif
+}
+
 /**
   * Determine the number of logical blocks required to hold the file table.
   *
@@ -355,6 +644,41 @@ uint16_t MicroBitFileSystem::getNextFileBlock(uint16_t block)
     return fileSystemTable[block];
 }
 
+/**
+  * Retrieve the block of a file holding its current seek position.
+  *
+  * The walk starts from the last block used by this file descriptor if it lies at or before the seek position,
+  * or from the start of the file otherwise.
+  *
+  * @param file The file descriptor to search.
+  *
+  * @param position Set to the position, in bytes, of the first byte of the returned block.
+  *
+  * @return The block number holding the current seek position.
+  */
+uint16_t MicroBitFileSystem::getSeekBlock(FileDescriptor *file, uint32_t *position)
+{
+    uint16_t block = file->seekBlock;
+
+    *position = file->seekBlockPosition;
+
+    if (*position > file->seek)
+    {
+        block = file->dirent->first_block;
+        *position = 0;
+    }
+
+    // Walk the file table until we reach the block holding the seek position.
+    // A seek position on a block boundary is held at the end of the previous block, as the next may not yet exist.
+    while (file->seek - *position > MBFS_BLOCK_SIZE)
+    {
+        block = getNextFileBlock(block);
+        *position += MBFS_BLOCK_SIZE;
+    }
+
+    return block;
+}
+
 /**
   * Determine the logical block that contains the given address.
   *
@@ -376,6 +700,18 @@ uint16_t MicroBitFileSystem::getBlockNumber(void *address)
   */
 int MicroBitFileSystem::fileTableWrite(uint16_t block, uint16_t value)
 {
+    // Any summary of the file table in FLASH is now out of date.
+    invalidateSummary();
+
+    // Keep our per-page summary in step with the file table.
+    if (pageFreeBlocks)
+    {
+        int page = block / (PAGE_SIZE / MBFS_BLOCK_SIZE);
+
+        pageFreeBlocks[page] += (value == MBFS_UNUSED) - (fileSystemTable[block] == MBFS_UNUSED);
+        pageDeletedBlocks[page] += (value == MBFS_DELETED) - (fileSystemTable[block] == MBFS_DELETED);
+    }
+
     flash.flash_write(&fileSystemTable[block], &value, 2);
     return MICROBIT_OK;
 }
@@ -445,6 +781,10 @@ int MicroBitFileSystem::recycleBlock(uint16_t block, int type)
     uint8_t *write = (uint8_t *)scratch;
     uint16_t b = getBlockNumber(page);
 
+    // Refreshing a page of the file table turns DELETED entries to UNUSED, so any summary is out of date.
+    if (b < fileSystemTableSize)
+        invalidateSummary();
+
     for (int i = 0; i < PAGE_SIZE / MBFS_BLOCK_SIZE; i++)
     {
         // If we have an unused or deleted block, there's nothing to do - allow the block to be recycled.
@@ -516,7 +856,8 @@ int MicroBitFileSystem::recycleFileTable()
         if (block % (PAGE_SIZE / MBFS_BLOCK_SIZE) == 0)
             pageRecycled = false;
 
-        if (fileSystemTable[block] == MBFS_DELETED && !pageRecycled)
+        // Pages whose deleted blocks have already been erased (e.g. by collectGarbage()) need not be recycled again.
+        if (fileSystemTable[block] == MBFS_DELETED && !pageRecycled && !isBlockErased(block))
         {
             recycleBlock(block);
             pageRecycled = true;
@@ -527,9 +868,107 @@ int MicroBitFileSystem::recycleFileTable()
     for (uint16_t block = 0; getPage(block) < (uint32_t *)rootDirectory; block += PAGE_SIZE / MBFS_BLOCK_SIZE)
         recycleBlock(block);
 
+    // The file table has been rewritten wholesale, so recount it.
+    if (pageFreeBlocks)
+        buildPageSummary();
+
     return MICROBIT_OK;
 }
 
+/**
+  * Determines if the given block is fully erased, such that it can be reused without a page erase.
+  *
+  * @param block The block to test.
+  * @return true if every byte of the block is erased, false otherwise.
+  */
+bool MicroBitFileSystem::isBlockErased(uint16_t block)
+{
+    uint32_t *word = getBlock(block);
+
+    for (int i = 0; i < MBFS_BLOCK_SIZE / 4; i++)
+        if (word[i] != 0xFFFFFFFF)
+            return false;
+
+    return true;
+}
+
+/**
+  * Performs one step of garbage collection: erasing one page holding deleted blocks, or once all deleted
+  * blocks are erased, refreshing one page of the file table so that they are marked UNUSED.
+  *
+  * @return MICROBIT_OK if some work was done, or MICROBIT_NO_DATA if there was nothing to collect.
+  */
+int MicroBitFileSystem::collectGarbage()
+{
+    int blocksPerPage = (PAGE_SIZE / MBFS_BLOCK_SIZE);
+    int freeBlocks, deletedBlocks;
+    bool deleted = false;
+
+    // Find a page holding deleted blocks that are not yet erased.
+    for (uint16_t page = 0; page < fileSystemSize; page += blocksPerPage)
+    {
+        getPageSummary(page, &freeBlocks, &deletedBlocks);
+
+        if (deletedBlocks == 0)
+            continue;
+
+        deleted = true;
+
+        for (int i = 0; i < blocksPerPage; i++)
+        {
+            if (fileSystemTable[page + i] == MBFS_DELETED && !isBlockErased(page + i))
+            {
+                // If the page holds nothing else, we can simply erase it. Otherwise, preserve its valid blocks.
+                if (freeBlocks + deletedBlocks == blocksPerPage)
+                    flash.erase_page(getBlock(page));
+                else
+                    recycleBlock(page);
+
+                return MICROBIT_OK;
+            }
+        }
+    }
+
+    if (!deleted)
+        return MICROBIT_NO_DATA;
+
+    // Every deleted block is now erased, so they can be marked as UNUSED.
+    // Refresh the page of the file table holding the first DELETED entry. This recycles every DELETED entry on that page.
+    for (uint16_t block = 0; block < fileSystemSize; block++)
+    {
+        if (fileSystemTable[block] == MBFS_DELETED)
+        {
+            recycleBlock(getBlockNumber(&fileSystemTable[block]));
+            buildPageSummary();
+
+            return MICROBIT_OK;
+        }
+    }
+
+    return MICROBIT_NO_DATA;
+}
+
+/**
+  * Periodic callback from the MicroBit scheduler.
+  * Erases pages holding deleted blocks in the background, one step at a time, if MBFS_BACKGROUND_GC is enabled.
+  */
+void MicroBitFileSystem::idleTick()
+{
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return;
+
+    // An up to date summary tells us if there is anything to collect, without counting the file table.
+    if (mountSummary && mountSummary->deletedBlocks == 0)
+        return;
+
+    if ((status & MBFS_STATUS_PAGES_COUNTED) == 0)
+        buildPageSummary();
+
+    // Only collect garbage if we can cheaply tell there is some to collect.
+    if (pageFreeBlocks)
+        collectGarbage();
+}
+
 
 /**
   * Allocate a free DiretoryEntry in the given directory, extending and refreshing the directory block if necessary.
@@ -672,6 +1111,7 @@ DirectoryEntry* MicroBitFileSystem::createFile(char const * filename, DirectoryE
     // Push the new data back to FLASH memory
     flash.flash_write(dirent, &d, sizeof(DirectoryEntry));
     fileTableWrite(d.first_block, MBFS_EOF);
+    indexDirectoryEntry(dirent, directory);
     return dirent;
 }
 
@@ -755,12 +1195,15 @@ int MicroBitFileSystem::createDirectory(char const *name)
   *  - MB_READ : read from the file.
   *  - MB_WRITE : write to the file.
   *  - MB_CREAT : create a new file, if it doesn't already exist.
+  *  - MB_APPEND : start with the seek position at the end of the file.
+  *  - MB_LOG : append-only. Every write() goes to the end of the file, so only ever fills erased FLASH,
+  *    and the next block is linked as soon as one is filled. Best used with MB_WRITE for data logging.
   *
   * If a file is opened that doesn't exist, and MB_CREAT isn't passed,
   * an error is returned, otherwise the file is created.
   *
   * @param filename name of the file to open, must contain only printable characters.
-  * @param flags One or more of MB_READ, MB_WRITE or MB_CREAT. 
+  * @param flags One or more of MB_READ, MB_WRITE, MB_CREAT, MB_APPEND or MB_LOG.
   * @return return the file handle,MICROBIT_NOT_SUPPORTED if the file system has
   *         not been initialised MICROBIT_INVALID_PARAMETER if the filename is
   *         too large, MICROBIT_NO_RESOURCES if the file system is full.
@@ -836,10 +1279,18 @@ int MicroBitFileSystem::open(char const * filename, uint32_t flags)
     file->flags = (flags & ~(MB_CREAT));
     file->id = id;
     file->length = dirent->flags == MBFS_DIRECTORY_ENTRY_NEW ? 0 : dirent->length;
-    file->seek = (flags & MB_APPEND) ? file->length : 0;
+    file->seek = (flags & (MB_APPEND | MB_LOG)) ? file->length : 0;
     file->dirent = dirent;
     file->directory = directory;
+    file->seekBlock = dirent->first_block;
+    file->seekBlockPosition = 0;
     file->cacheLength = 0;
+    file->cacheSize = 0;
+    file->cache = NULL;
+
+    // Files we may write to are given a writeback cache, if there is RAM to spare.
+    if (file->flags & MB_WRITE)
+        allocateCache(file, MBFS_CACHE_SIZE);
 
     // Add the file descriptor to the chain of open files.
     file->next = openFiles;
@@ -906,6 +1357,7 @@ int MicroBitFileSystem::flush(int fd)
             flash.flash_write(&file->dirent->flags, &value, 2);
             newDirent = createDirectoryEntry(file->directory);
             flash.flash_write(newDirent, &d, sizeof(DirectoryEntry));
+            indexDirectoryEntry(newDirent, file->directory);
         }
     }
 
@@ -945,7 +1397,14 @@ int MicroBitFileSystem::close(int fd)
 
     // Remove the file descriptor from the list of open files, and free it.
     // n.b. we know this is safe, as flush() validates this.
-    delete getFileDescriptor(fd, true);
+    FileDescriptor *file = getFileDescriptor(fd, true);
+
+    allocateCache(file, 0);
+    delete file;
+
+    // Once every file is closed, record the state of the file table, so that we can mount quickly next time.
+    if (openFiles == NULL)
+        writeSummary();
 
     return MICROBIT_OK;
 }
@@ -987,20 +1446,27 @@ int MicroBitFileSystem::seek(int fd, int offset, uint8_t flags)
 
     if (file == NULL)
         return MICROBIT_INVALID_PARAMETER;
-    
-    // Flush any data in the writeback cache.
-    writeBack(file);
 
-    position = file->seek;
+    // Any cached data is held at the seek position, so the current position is really the end of the cache.
+    int cacheEnd = file->seek + file->cacheLength;
+
+    position = cacheEnd;
 
     if(flags == MB_SEEK_SET)
         position = offset;
     
     if(flags == MB_SEEK_END)
-        position = file->length + offset;
+        position = max(file->length, cacheEnd) + offset;
     
     if (flags == MB_SEEK_CUR)
-        position = file->seek + offset;
+        position = cacheEnd + offset;
+
+    // If we're not moving, there's no need to write back the cache yet. This keeps repeated appends cheap.
+    if (position == cacheEnd)
+        return position;
+
+    // Flush any data in the writeback cache.
+    writeBack(file);
     
     if (position < 0 || (uint32_t)position > file->length)
         return MICROBIT_INVALID_PARAMETER;
@@ -1010,6 +1476,44 @@ int MicroBitFileSystem::seek(int fd, int offset, uint8_t flags)
     return position;
 }
 
+/**
+  * Set the size of the writeback cache used for an open file.
+  *
+  * Writes smaller than the cache are gathered in RAM, and written to FLASH once the cache is full,
+  * or a block boundary is reached. Any cached data is written back before the cache is resized.
+  * The total RAM used is bounded by MBFS_CACHE_BUDGET.
+  *
+  * @param fd file handle, obtained with open()
+  * @param size the requested cache size in bytes, up to MBFS_BLOCK_SIZE. Zero disables caching for this file.
+  * @return the size of the cache now in use on success, MICROBIT_NOT_SUPPORTED if the file system
+  *         is not intiialised, MICROBIT_INVALID_PARAMETER if the size is invalid or the file handle is invalid.
+  *
+  * @code
+  * MicroBitFileSystem f;
+  * int fd = f.open("log.txt", MB_WRITE | MB_CREAT);
+  * f.setCacheSize(fd, MBFS_BLOCK_SIZE);
+  * @endcode
+  */
+int MicroBitFileSystem::setCacheSize(int fd, int size)
+{
+    FileDescriptor *file;
+
+    // Protect against accidental re-initialisation
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Ensure the file is open.
+    file = getFileDescriptor(fd);
+
+    if (file == NULL || size < 0 || size > MBFS_BLOCK_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Flush any data in the writeback cache before we replace it.
+    writeBack(file);
+
+    return allocateCache(file, size);
+}
+
 /**
   * Read data from the file.
   *
@@ -1061,14 +1565,7 @@ int MicroBitFileSystem::read(int fd, uint8_t* buffer, int size)
     size = min(size, file->length - file->seek);
 
     // Find the read position.
-    block = file->dirent->first_block; 
-
-    // Walk the file table until we reach the start block
-    while (file->seek - position > MBFS_BLOCK_SIZE)
-    {
-        block = getNextFileBlock(block);
-        position += MBFS_BLOCK_SIZE;
-    }
+    block = getSeekBlock(file, &position);
 
     // Once we have the correct start block, handle the byte offset.
     offset = file->seek - position;
@@ -1088,18 +1585,186 @@ int MicroBitFileSystem::read(int fd, uint8_t* buffer, int size)
         writePointer += segmentLength;
         offset += segmentLength;
 
-        if (offset == MBFS_BLOCK_SIZE)
+        if (offset == MBFS_BLOCK_SIZE && bytesCopied < size)
         {
             block = getNextFileBlock(block);
+            position += MBFS_BLOCK_SIZE;
             offset = 0;
         }
     }
 
     file->seek += bytesCopied;
+    file->seekBlock = block;
+    file->seekBlockPosition = position;
 
     return bytesCopied;
 }
 
+/**
+  * Obtain direct, read-only access to part of a file's contents, without copying.
+  *
+  * Files are held in memory mapped FLASH, so their contents can be read in place. This returns a pointer to
+  * the byte at the given offset, and the number of bytes from there that are contiguous in memory.
+  * Where a file's blocks are allocated consecutively, this may span several blocks, or the whole file.
+  * Call repeatedly, advancing the offset by the value returned each time, to visit every extent of the file.
+  *
+  * The seek position of the file is not affected. Any data held in the file's writeback cache is written back first.
+  *
+  * @param fd File handle, obtained with open()
+  * @param offset the position in the file, in bytes, of the first byte to access.
+  * @param data set to the address of the byte at the given offset.
+  * @return the number of contiguous bytes available at data, zero if the offset is at the end of the file,
+  *         MICROBIT_NOT_SUPPORTED if the file system is not initialised, or MICROBIT_INVALID_PARAMETER
+  *         if the file handle is invalid or the offset lies beyond the end of the file.
+  *
+  * @note The memory returned must not be written to, and reflects the file contents only until the file is next written or removed.
+  *
+  * @code
+  * MicroBitFileSystem f;
+  * int fd = f.open("image.bin", MB_READ);
+  * uint8_t *data;
+  * uint32_t offset = 0;
+  * int length;
+  *
+  * while ((length = f.map(fd, offset, &data)) > 0)
+  * {
+  *     process(data, length);
+  *     offset += length;
+  * }
+  * @endcode
+  */
+int MicroBitFileSystem::map(int fd, uint32_t offset, uint8_t **data)
+{
+    FileDescriptor *file;
+    uint16_t block;
+    uint32_t position = 0;
+    uint32_t length;
+
+    // Protect against accidental re-initialisation
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Ensure the file is open.
+    file = getFileDescriptor(fd);
+
+    if (file == NULL || data == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Make sure FLASH holds everything written so far.
+    writeBack(file);
+
+    if (offset > file->length)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (offset == file->length)
+        return 0;
+
+    // Walk the file table until we reach the block holding the given offset.
+    block = file->dirent->first_block;
+
+    while (offset - position >= MBFS_BLOCK_SIZE)
+    {
+        block = getNextFileBlock(block);
+        position += MBFS_BLOCK_SIZE;
+    }
+
+    *data = (uint8_t *)getBlock(block) + (offset - position);
+    length = MBFS_BLOCK_SIZE - (offset - position);
+
+    // Extend the extent over any following blocks that are physically adjacent.
+    while (offset + length < file->length && getNextFileBlock(block) == block + 1)
+    {
+        block++;
+        length += MBFS_BLOCK_SIZE;
+    }
+
+    return min(length, file->length - offset);
+}
+
+/**
+  * Reserve FLASH for a file up front, so that it can grow to at least the given size.
+  *
+  * Blocks are allocated as a single physically contiguous run where possible, following the
+  * last block of the file if that space is free. Later writes then fill the reserved blocks
+  * without further allocation, and a contiguous file can be accessed in one piece with map().
+  * If no contiguous run is available, blocks are allocated individually.
+  *
+  * The length of the file is not changed. Reserved blocks remain part of the file until it is removed.
+  *
+  * @param fd File handle, obtained with open()
+  * @param size The number of bytes the file should be able to hold.
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+  *         MICROBIT_INVALID_PARAMETER if the file handle is invalid or not open for writing, or
+  *         MICROBIT_NO_RESOURCES if the file system is full.
+  *
+  * @code
+  * MicroBitFileSystem f;
+  * int fd = f.open("image.bin", MB_WRITE | MB_CREAT);
+  * f.preallocate(fd, 4096);
+  * @endcode
+  */
+int MicroBitFileSystem::preallocate(int fd, uint32_t size)
+{
+    FileDescriptor *file;
+    uint16_t block, next, run;
+    int blocks = 1;
+    int needed;
+
+    // Protect against accidental re-initialisation
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Ensure the file is open, and writable.
+    file = getFileDescriptor(fd);
+
+    if (file == NULL || !(file->flags & MB_WRITE))
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Find the last block of the file, and how many more blocks we need.
+    block = file->dirent->first_block;
+
+    while ((next = getNextFileBlock(block)) != MBFS_EOF)
+    {
+        block = next;
+        blocks++;
+    }
+
+    needed = (int)((size + MBFS_BLOCK_SIZE - 1) / MBFS_BLOCK_SIZE) - blocks;
+
+    if (needed <= 0)
+        return MICROBIT_OK;
+
+    run = getFreeBlocks(block + 1, needed);
+
+    if (run)
+    {
+        // Chain the run from its tail, so that every entry is written only once, then attach it to the file.
+        fileTableWrite(run + needed - 1, MBFS_EOF);
+
+        for (int i = needed - 2; i >= 0; i--)
+            fileTableWrite(run + i, run + i + 1);
+
+        fileTableWrite(block, run);
+        lastBlockAllocated = run + needed - 1;
+
+        return MICROBIT_OK;
+    }
+
+    // No contiguous space, so fall back to allocating blocks one at a time.
+    while (needed--)
+    {
+        next = getFreeBlock();
+        if (next == 0)
+            return MICROBIT_NO_RESOURCES;
+
+        fileTableWrite(next, MBFS_EOF);
+        fileTableWrite(block, next);
+        block = next;
+    }
+
+    return MICROBIT_OK;
+}
+
 /**
   * Flush a given file's cache back to FLASH memory.
   *
@@ -1119,6 +1784,40 @@ int MicroBitFileSystem::writeBack(FileDescriptor *file)
     return 0;
 }
 
+/**
+  * Allocate a writeback cache for the given file, replacing any it already has.
+  * The cache may be smaller than requested, if MBFS_CACHE_BUDGET would otherwise be exceeded.
+  *
+  * @param file File descriptor to allocate a cache for. Any data in its existing cache must already have been written back.
+  * @param size The requested size of the cache, in bytes. Zero releases the cache.
+  * @return The size of the cache allocated, in bytes.
+  */
+int MicroBitFileSystem::allocateCache(FileDescriptor *file, int size)
+{
+    if (file->cache)
+    {
+        free(file->cache);
+        cacheBytesAllocated -= file->cacheSize;
+
+        file->cache = NULL;
+        file->cacheSize = 0;
+        file->cacheLength = 0;
+    }
+
+    size = min(size, MBFS_CACHE_BUDGET - cacheBytesAllocated);
+
+    if (size > 0)
+        file->cache = (uint8_t *)malloc(size);
+
+    if (file->cache)
+    {
+        file->cacheSize = size;
+        cacheBytesAllocated += size;
+    }
+
+    return file->cacheSize;
+}
+
 /**
   * Write a given buffer to the file provided.
   *
@@ -1137,15 +1836,8 @@ int MicroBitFileSystem::writeBuffer(FileDescriptor *file, uint8_t *buffer, int s
     int bytesCopied = 0;
     int segmentLength;
 
-    // Find the read position.
-    block = file->dirent->first_block;
-
-    // Walk the file table until we reach the start block
-    while (file->seek - position > MBFS_BLOCK_SIZE)
-    {
-        block = getNextFileBlock(block);
-        position += MBFS_BLOCK_SIZE;
-    }
+    // Find the write position.
+    block = getSeekBlock(file, &position);
 
     // Once we have the correct start block, handle the byte offset.
     offset = file->seek - position;
@@ -1167,23 +1859,55 @@ int MicroBitFileSystem::writeBuffer(FileDescriptor *file, uint8_t *buffer, int s
 
         if (offset == MBFS_BLOCK_SIZE && bytesCopied < size)
         {
-            newBlock = getFreeBlock();
-            if (newBlock == 0)
-                break;
+            // Continue into the next block of the file if there is one (e.g. linked ahead by MB_LOG), otherwise allocate one.
+            newBlock = getNextFileBlock(block);
+
+            if (newBlock == MBFS_EOF)
+            {
+                newBlock = getFreeBlock();
+                if (newBlock == 0)
+                    break;
 
-            fileTableWrite(newBlock, MBFS_EOF);
-            fileTableWrite(block, newBlock);
+                fileTableWrite(newBlock, MBFS_EOF);
+                fileTableWrite(block, newBlock);
+            }
 
             block = newBlock;
+            position += MBFS_BLOCK_SIZE;
 
             writePointer = (uint8_t *)getBlock(block);
             offset = 0;
         }
     }
 
+    // Append-only files link their next block as soon as one is full, so the next write starts in erased
+    // space at the start of a block, and is found without walking the file table.
+    if ((file->flags & MB_LOG) && offset == MBFS_BLOCK_SIZE)
+    {
+        newBlock = getNextFileBlock(block);
+
+        if (newBlock == MBFS_EOF)
+        {
+            newBlock = getFreeBlock();
+            if (newBlock != 0)
+            {
+                fileTableWrite(newBlock, MBFS_EOF);
+                fileTableWrite(block, newBlock);
+            }
+        }
+
+        if (newBlock != 0)
+        {
+            block = newBlock;
+            position += MBFS_BLOCK_SIZE;
+        }
+    }
+
     // update the filelength metadata and seek position such that multiple writes are sequential.
     file->length = max(file->length, file->seek + bytesCopied);
     file->seek += bytesCopied;
+    file->seekBlock = block;
+    file->seekBlockPosition = position;
 
     return bytesCopied;
 }
@@ -1251,23 +1975,29 @@ int MicroBitFileSystem::write(int fd, uint8_t* buffer, int size)
     if (file == NULL || buffer == NULL || size == 0)
         return MICROBIT_INVALID_PARAMETER;
 
+    // Append-only files are always written at the end. Any cached data is already there.
+    if ((file->flags & MB_LOG) && file->cacheLength == 0)
+        file->seek = file->length;
+
     // Determine how to handle the write. If the buffer size is less than our cache size, 
     // write the data via the cache. Otherwise, a direct write through is likely more efficient.
     // This may take a few iterations if the cache is already quite full.
-    if (size < MBFS_CACHE_SIZE)
+    if (file->cache && size < file->cacheSize)
     {
         while (bytesCopied < size)
         {
-            segmentSize = min(size, MBFS_CACHE_SIZE - file->cacheLength);
-            memcpy(&file->cache[file->cacheLength], buffer, segmentSize);
+            // Never let the cache span a block boundary, so that each write back touches a single block.
+            int blockSpace = MBFS_BLOCK_SIZE - (file->seek + file->cacheLength) % MBFS_BLOCK_SIZE;
+
+            segmentSize = min(size - bytesCopied, file->cacheSize - file->cacheLength);
+            segmentSize = min(segmentSize, blockSpace);
+            memcpy(&file->cache[file->cacheLength], buffer + bytesCopied, segmentSize);
 
             file->cacheLength += segmentSize;
             bytesCopied += segmentSize;
             
-            if (file->cacheLength == MBFS_CACHE_SIZE)
+            if (file->cacheLength == file->cacheSize || segmentSize == blockSpace)
                 writeBack(file);
-
-
         }
 
         return bytesCopied;
@@ -1325,3 +2055,127 @@ int MicroBitFileSystem::remove(char const * filename)
     return MICROBIT_OK;
 }
 
+
+/**
+  * Prepare to list the contents of a directory.
+  *
+  * No memory is allocated: all of the state of the listing is held in the given iterator.
+  *
+  * @param name The fully qualified name of the directory, or NULL or "" for the root directory.
+  *             A trailing "/" is optional.
+  * @param it The iterator to initialise, to be passed to readDirectory().
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+  *         or MICROBIT_INVALID_PARAMETER if the directory does not exist.
+  */
+int MicroBitFileSystem::openDirectory(char const *name, DirectoryIterator &it)
+{
+    DirectoryEntry *directory;
+
+    // Leave the iterator empty if anything goes wrong, so that readDirectory() returns nothing.
+    it.block = MBFS_EOF;
+    it.entry = 0;
+
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Resolve each level of the path ending in "/", then the last level if it has no trailing "/".
+    directory = getDirectoryOf(name);
+
+    if (directory && name && name[0] && name[strlen(name) - 1] != '/')
+        directory = getDirectoryEntry(name, directory);
+
+    if (directory == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Only the root directory and entries marked as directories can be listed.
+    if (directory != rootDirectory && (directory->flags & (MBFS_DIRECTORY_ENTRY_VALID | MBFS_DIRECTORY_ENTRY_DIRECTORY | MBFS_DIRECTORY_ENTRY_FREE)) != (MBFS_DIRECTORY_ENTRY_VALID | MBFS_DIRECTORY_ENTRY_DIRECTORY))
+        return MICROBIT_INVALID_PARAMETER;
+
+    it.block = directory->first_block;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Retrieve the next file or directory in a listing started with openDirectory().
+  *
+  * The directory blocks are walked once, in order. The entry returned refers directly to FLASH,
+  * so is only valid until the file system is next modified. Its length is that last written to FLASH,
+  * which is 0xffffffff for a file that has been created but not yet closed. Use stat() for the current length.
+  *
+  * @param it An iterator initialised by openDirectory().
+  * @return The next DirectoryEntry in the directory, or NULL if there are no more entries.
+  *
+  * @code
+  * MicroBitFileSystem f;
+  * DirectoryIterator it;
+  * DirectoryEntry const *dirent;
+  *
+  * if (f.openDirectory("logs", it) == MICROBIT_OK)
+  *     while ((dirent = f.readDirectory(it)) != NULL)
+  *         printf("%s\n", dirent->file_name);
+  * @endcode
+  */
+DirectoryEntry const * MicroBitFileSystem::readDirectory(DirectoryIterator &it)
+{
+    while (it.block != MBFS_EOF)
+    {
+        DirectoryEntry *dirent = &((Directory *)getBlock(it.block))->entry[it.entry];
+
+        // Advance the iterator, moving onto the next block of the directory at the end of this one.
+        if (++it.entry >= MBFS_BLOCK_SIZE / sizeof(DirectoryEntry))
+        {
+            it.block = getNextFileBlock(it.block);
+            it.entry = 0;
+        }
+
+        // Skip deleted and unused entries, file table summaries (which have an empty name), and the signature of the root directory.
+        if (dirent != rootDirectory && (dirent->flags & MBFS_DIRECTORY_ENTRY_VALID) && dirent->file_name[0] != 0 && (uint8_t)dirent->file_name[0] != 0xff)
+            return dirent;
+    }
+
+    return NULL;
+}
+
+/**
+  * Determine the length of a file, and optionally retrieve its DirectoryEntry, without opening it.
+  *
+  * The length reported includes any data written to a file that is currently open.
+  *
+  * @param filename The fully qualified name of the file or directory.
+  * @param dirent If not NULL, set to the DirectoryEntry of the file in FLASH, which is valid until the file system is next modified.
+  * @return The length of the file in bytes, MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+  *         or MICROBIT_INVALID_PARAMETER if the file does not exist.
+  */
+int MicroBitFileSystem::stat(char const *filename, DirectoryEntry const **dirent)
+{
+    DirectoryEntry *directory;
+    DirectoryEntry *entry;
+
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Reject invalid filenames, including those with no name after the last "/".
+    if (!isValidFilename(filename) || filename[strlen(filename) - 1] == '/')
+        return MICROBIT_INVALID_PARAMETER;
+
+    directory = getDirectoryOf(filename);
+
+    if (directory == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    entry = getDirectoryEntry(filename, directory);
+
+    if (entry == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (dirent)
+        *dirent = entry;
+
+    // An open file may hold a length not yet written to FLASH.
+    for (FileDescriptor *file = openFiles; file; file = file->next)
+        if (file->dirent == entry)
+            return file->length;
+
+    return entry->flags == MBFS_DIRECTORY_ENTRY_NEW ? 0 : entry->length;
+}
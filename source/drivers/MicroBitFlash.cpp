@@ -206,26 +206,44 @@ int MicroBitFlash::flash_write(void* address, void* from_buffer,
         end = PAGE_SIZE;
     }
 
-    uint32_t writeWord = 0;
+    // Assemble contiguous runs of words that differ from what is already in FLASH, and burn each run in one operation.
+    uint32_t burnBuffer[MICROBIT_FLASH_BURN_WORDS];
+    int burnStart = 0;
+    int burnLength = 0;
 
-    for(int i=start;i<end;i++) 
+    for(int w=start/4;w<end/4;w++)
     {
-        int byteOffset = i%4;
+        uint32_t writeWord = 0;
 
-        if(i >= offset && i < (offset + length)) 
+        for(int i=w*4;i<(w+1)*4;i++)
         {
-            // Write from buffer.
-            writeWord |= (((uint8_t *)from_buffer)[i-offset] << ((byteOffset)*8));
+            int byteOffset = i%4;
+
+            if(i >= offset && i < (offset + length)) 
+            {
+                // Write from buffer.
+                writeWord |= (((uint8_t *)from_buffer)[i-offset] << ((byteOffset)*8));
+            }
+            else 
+            {
+                writeWord |= (writeFrom[i] << ((byteOffset)*8));
+            }
         }
-        else 
+
+        bool burn = writeWord != pgAddr[w];
+
+        if (burn)
         {
-            writeWord |= (writeFrom[i] << ((byteOffset)*8));
+            if (burnLength == 0)
+                burnStart = w;
+
+            burnBuffer[burnLength++] = writeWord;
         }
 
-        if( ((i+1)%4) == 0) 
+        if (burnLength > 0 && (!burn || burnLength == MICROBIT_FLASH_BURN_WORDS || w == end/4 - 1))
         {
-            this->flash_burn(pgAddr + (i/4), &writeWord, 1);
-            writeWord = 0;
+            this->flash_burn(pgAddr + burnStart, burnBuffer, burnLength);
+            burnLength = 0;
         }
     }
 
@@ -26,9 +26,36 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitI2C.h"
 #include "ErrorNo.h"
+#include "MicroBitTrace.h"
+#include "MicroBitFiber.h"
 #include "twi_master.h"
 #include "nrf_delay.h"
 
+MicroBitI2C* MicroBitI2C::instance = NULL;
+
+/**
+  * Interrupt handlers for the I2C hardware. The TWI peripherals share their interrupts with SPI.
+  */
+extern "C" void SPI0_TWI0_IRQHandler(void)
+{
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_I2C, 0);
+
+    if(MicroBitI2C::instance)
+        MicroBitI2C::instance->onInterrupt();
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_I2C, 0);
+}
+
+extern "C" void SPI1_TWI1_IRQHandler(void)
+{
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_I2C, 0);
+
+    if(MicroBitI2C::instance)
+        MicroBitI2C::instance->onInterrupt();
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_I2C, 0);
+}
+
 /**
   * Constructor.
   *
@@ -54,6 +81,70 @@ DEALINGS IN THE SOFTWARE.
 MicroBitI2C::MicroBitI2C(PinName sda, PinName scl) : I2C(sda,scl)
 {
     this->retries = 0;
+    this->queueHead = NULL;
+    this->queueTail = NULL;
+    this->transactionRetries = 0;
+    this->busLocked = false;
+}
+
+/**
+  * Waits for any queued transactions to complete, then claims the bus for a blocking transfer.
+  */
+void MicroBitI2C::lockBus()
+{
+    // If we hold the bus across a repeated start, we still own it.
+    if(busLocked)
+        return;
+
+    while(1)
+    {
+        __disable_irq();
+
+        if(queueHead == NULL)
+        {
+            busLocked = true;
+            __enable_irq();
+            return;
+        }
+
+        __enable_irq();
+    }
+}
+
+/**
+  * Releases the bus after a blocking transfer, starting any transactions queued meanwhile.
+  *
+  * @param repeated true if the transfer ended without a stop, so the bus remains claimed.
+  */
+void MicroBitI2C::unlockBus(bool repeated)
+{
+    bool pending;
+
+    if(repeated)
+        return;
+
+    __disable_irq();
+    busLocked = false;
+    pending = (queueHead != NULL);
+    __enable_irq();
+
+    if(pending)
+        startTransaction();
+}
+
+/**
+  * Resets and restarts the I2C hardware, to recover from the PAN56 lockup.
+  */
+void MicroBitI2C::resetBus()
+{
+    _i2c.i2c->EVENTS_ERROR = 0;
+    _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
+    _i2c.i2c->POWER        = 0;
+    nrf_delay_us(5);
+    _i2c.i2c->POWER        = 1;
+    _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
+
+    twi_master_init_and_clear();
 }
 
 /**
@@ -71,22 +162,21 @@ MicroBitI2C::MicroBitI2C(PinName sda, PinName scl) : I2C(sda,scl)
   */
 int MicroBitI2C::read(int address, char *data, int length, bool repeated)
 {
+    // Let any queued transactions complete first, as they share the hardware.
+    lockBus();
+
     int result = I2C::read(address,data,length,repeated);
 
     //0 indicates a success, presume failure
     while(result != 0 && retries < MICROBIT_I2C_MAX_RETRIES)
     {
-        _i2c.i2c->EVENTS_ERROR = 0;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
-        _i2c.i2c->POWER        = 0;
-        nrf_delay_us(5);
-        _i2c.i2c->POWER        = 1;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
-        twi_master_init_and_clear();
+        resetBus();
         result = I2C::read(address,data,length,repeated);
         retries++;
     }
 
+    unlockBus(repeated && result == 0);
+
     if(result != 0)
         return MICROBIT_I2C_ERROR;
 
@@ -109,26 +199,259 @@ int MicroBitI2C::read(int address, char *data, int length, bool repeated)
   */
 int MicroBitI2C::write(int address, const char *data, int length, bool repeated)
 {
+    // Let any queued transactions complete first, as they share the hardware.
+    lockBus();
+
     int result = I2C::write(address,data,length,repeated);
 
     //0 indicates a success, presume failure
     while(result != 0 && retries < MICROBIT_I2C_MAX_RETRIES)
     {
-        _i2c.i2c->EVENTS_ERROR = 0;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
-        _i2c.i2c->POWER        = 0;
-        nrf_delay_us(5);
-        _i2c.i2c->POWER        = 1;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
-
-        twi_master_init_and_clear();
+        resetBus();
         result = I2C::write(address,data,length,repeated);
         retries++;
     }
 
+    unlockBus(repeated && result == 0);
+
     if(result != 0)
         return MICROBIT_I2C_ERROR;
 
     retries = 0;
     return MICROBIT_OK;
 }
+
+/**
+  * Queues a transaction to be performed in the background, driven by interrupts.
+  * Transactions are performed in the order submitted, so transfers for several devices can be
+  * queued together without blocking the caller.
+  *
+  * The transaction must remain valid until it completes. Its status is MICROBIT_BUSY until then.
+  * Blocking calls to read() and write() wait for any queued transactions to complete.
+  *
+  * @param t The transaction to perform.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the transaction is invalid.
+  *
+  * @code
+  * void onSample(I2CTransaction *t) { ... }
+  *
+  * uint8_t reg = 0x01;
+  * uint8_t data[6];
+  * I2CTransaction t = { 0x1C, &reg, 1, data, 6, onSample, NULL };
+  * i2c.submit(&t);
+  * @endcode
+  */
+int MicroBitI2C::submit(I2CTransaction *t)
+{
+    bool first;
+    bool idle;
+
+    if(t == NULL || t->txLength < 0 || t->rxLength < 0 || t->txLength + t->rxLength == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if((t->txLength && t->txData == NULL) || (t->rxLength && t->rxData == NULL))
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Hook up our interrupt handler on first use.
+    if(instance != this)
+    {
+        IRQn_Type irq = _i2c.i2c == NRF_TWI0 ? SPI0_TWI0_IRQn : SPI1_TWI1_IRQn;
+
+        instance = this;
+        NVIC_SetPriority(irq, MICROBIT_I2C_IRQ_PRIORITY);
+        NVIC_ClearPendingIRQ(irq);
+        NVIC_EnableIRQ(irq);
+    }
+
+    t->status = MICROBIT_BUSY;
+    t->next = NULL;
+
+    // Keep the high frequency clock running while the queue is busy. The hold is dropped again
+    // below if the queue already had one, and otherwise once the queue drains.
+    scheduler_idle_hold();
+
+    __disable_irq();
+
+    // If a blocking transfer owns the bus, the transaction starts once it is released.
+    first = (queueHead == NULL);
+
+    if(first)
+        queueHead = t;
+    else
+        queueTail->next = t;
+
+    queueTail = t;
+
+    idle = first && !busLocked;
+
+    __enable_irq();
+
+    if(!first)
+        scheduler_idle_release();
+
+    if(idle)
+        startTransaction();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Begins the transaction at the head of the queue.
+  */
+void MicroBitI2C::startTransaction()
+{
+    I2CTransaction *t = queueHead;
+    NRF_TWI_Type *twi = _i2c.i2c;
+
+    txIndex = 0;
+    rxIndex = 0;
+    transactionError = false;
+
+    twi->EVENTS_TXDSENT = 0;
+    twi->EVENTS_RXDREADY = 0;
+    twi->EVENTS_ERROR = 0;
+    twi->EVENTS_STOPPED = 0;
+
+    twi->ADDRESS = t->address >> 1;
+    twi->INTENSET = TWI_INTENSET_TXDSENT_Msk | TWI_INTENSET_RXDREADY_Msk | TWI_INTENSET_ERROR_Msk | TWI_INTENSET_STOPPED_Msk;
+
+    if(t->txLength)
+    {
+        twi->SHORTS = 0;
+        twi->TXD = t->txData[0];
+        twi->TASKS_STARTTX = 1;
+    }
+    else
+    {
+        startReceive();
+    }
+}
+
+/**
+  * Configures the hardware to receive the bytes of the current transaction.
+  */
+void MicroBitI2C::startReceive()
+{
+    NRF_TWI_Type *twi = _i2c.i2c;
+
+    // Suspend after each byte so that we can collect it, stopping automatically after the last.
+    twi->SHORTS = queueHead->rxLength == 1 ? TWI_SHORTS_BB_STOP_Msk : TWI_SHORTS_BB_SUSPEND_Msk;
+    twi->TASKS_STARTRX = 1;
+}
+
+/**
+  * Completes the transaction at the head of the queue, retrying it if it failed,
+  * and begins the next.
+  *
+  * @param status MICROBIT_OK on success, or MICROBIT_I2C_ERROR.
+  */
+void MicroBitI2C::completeTransaction(int status)
+{
+    I2CTransaction *t = queueHead;
+    NRF_TWI_Type *twi = _i2c.i2c;
+
+    twi->SHORTS = 0;
+
+    if(status != MICROBIT_OK && transactionRetries < MICROBIT_I2C_MAX_RETRIES)
+    {
+        transactionRetries++;
+        resetBus();
+        startTransaction();
+        return;
+    }
+
+    transactionRetries = 0;
+
+    // Start the next transaction before calling back, so that the callback may submit another.
+    queueHead = t->next;
+
+    if(queueHead)
+    {
+        startTransaction();
+    }
+    else
+    {
+        queueTail = NULL;
+
+        // Hand the hardware back to the blocking API, which polls for events.
+        twi->INTENCLR = TWI_INTENSET_TXDSENT_Msk | TWI_INTENSET_RXDREADY_Msk | TWI_INTENSET_ERROR_Msk | TWI_INTENSET_STOPPED_Msk;
+
+        // Let the idle task stop the high frequency clock again.
+        scheduler_idle_release();
+    }
+
+    t->status = status;
+
+    if(t->callback)
+        t->callback(t);
+}
+
+/**
+  * Interrupt handler for the I2C hardware, driving the transaction in progress.
+  *
+  * @note should only be called from the TWI interrupt handler.
+  */
+void MicroBitI2C::onInterrupt()
+{
+    NRF_TWI_Type *twi = _i2c.i2c;
+    I2CTransaction *t = queueHead;
+
+    if(t == NULL)
+    {
+        twi->INTENCLR = TWI_INTENSET_TXDSENT_Msk | TWI_INTENSET_RXDREADY_Msk | TWI_INTENSET_ERROR_Msk | TWI_INTENSET_STOPPED_Msk;
+        return;
+    }
+
+    // On an error (e.g. a NACK), stop the bus. The transaction completes once the bus has stopped.
+    if(twi->EVENTS_ERROR)
+    {
+        twi->EVENTS_ERROR = 0;
+        twi->ERRORSRC = twi->ERRORSRC;
+        transactionError = true;
+        twi->TASKS_STOP = 1;
+    }
+
+    if(twi->EVENTS_TXDSENT)
+    {
+        twi->EVENTS_TXDSENT = 0;
+
+        if(!transactionError)
+        {
+            txIndex++;
+
+            if(txIndex < t->txLength)
+                twi->TXD = t->txData[txIndex];
+            else if(t->rxLength)
+                startReceive();
+            else
+                twi->TASKS_STOP = 1;
+        }
+    }
+
+    if(twi->EVENTS_RXDREADY)
+    {
+        twi->EVENTS_RXDREADY = 0;
+
+        if(!transactionError && rxIndex < t->rxLength)
+        {
+            t->rxData[rxIndex++] = twi->RXD;
+
+            if(rxIndex == t->rxLength - 1)
+                twi->SHORTS = TWI_SHORTS_BB_STOP_Msk;
+
+            if(rxIndex < t->rxLength)
+            {
+                // PAN56: allow the hardware to settle before resuming.
+                nrf_delay_us(4);
+                twi->TASKS_RESUME = 1;
+            }
+        }
+    }
+
+    if(twi->EVENTS_STOPPED)
+    {
+        twi->EVENTS_STOPPED = 0;
+        completeTransaction(transactionError || rxIndex < t->rxLength ? MICROBIT_I2C_ERROR : MICROBIT_OK);
+    }
+}
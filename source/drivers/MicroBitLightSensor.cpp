@@ -38,11 +38,20 @@ DEALINGS IN THE SOFTWARE.
   * MICROBIT_LIGHT_SENSOR_AN_SET_TIME after.
   *
   * It will then read from the currently selected channel using the AnalogIn
-  * that was configured in the startSensing method.
+  * that was configured in the startSensing method, and update the moving
+  * average for that channel.
   */
 void MicroBitLightSensor::analogReady()
 {
-    this->results[chan] = this->sensePin->read_u16();
+    int sample = this->sensePin->read_u16();
+
+    // Seed the moving average with the first reading from each channel, so that it need not climb from zero.
+    if (sampled & (1 << chan))
+        results[chan] += sample - results[chan] / MICROBIT_LIGHT_SENSOR_SMOOTHING;
+    else
+        results[chan] = sample * MICROBIT_LIGHT_SENSOR_SMOOTHING;
+
+    sampled |= 1 << chan;
 
     analogDisable();
 
@@ -51,6 +60,18 @@ void MicroBitLightSensor::analogReady()
     chan++;
 
     chan = chan % MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+
+    // Only tell anyone about the light level once we have a full set of readings, and then only when it changes.
+    if (sampled == (1 << MICROBIT_LIGHT_SENSOR_CHAN_NUM) - 1)
+    {
+        int level = read();
+
+        if (level != lastLevel)
+        {
+            lastLevel = level;
+            MicroBitEvent(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE);
+        }
+    }
 }
 
 /**
@@ -87,12 +108,12 @@ MicroBitLightSensor::MicroBitLightSensor(const MatrixMap &map) :
 {
     this->chan = 0;
 
+    this->sampled = 0;
+    this->lastLevel = -1;
+
     for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
         results[i] = 0;
 
-    if (EventModel::defaultEventBus)
-        EventModel::defaultEventBus->listen(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, this, &MicroBitLightSensor::startSensing, MESSAGE_BUS_LISTENER_IMMEDIATE);
-
     this->sensePin = NULL;
 }
 
@@ -124,7 +145,7 @@ int MicroBitLightSensor::read()
     for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
         sum += results[i];
 
-    int average = sum / MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+    int average = sum / (MICROBIT_LIGHT_SENSOR_CHAN_NUM * MICROBIT_LIGHT_SENSOR_SMOOTHING);
 
     average = min(average, MICROBIT_LIGHT_SENSOR_MAX_VALUE);
 
@@ -142,8 +163,11 @@ int MicroBitLightSensor::read()
 }
 
 /**
-  * The method that is invoked by sending MICROBIT_DISPLAY_EVT_LIGHT_SENSE
-  * using the id MICROBIT_ID_DISPLAY.
+  * Takes a light reading from the next section of the display. This is invoked by MicroBitDisplay
+  * whilst the display is held dark, in DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE.
+  *
+  * When the resulting light level differs from the one last reported, a MICROBIT_DISPLAY_EVT_LIGHT_SENSE
+  * event is raised using the id MICROBIT_ID_DISPLAY.
   *
   * @note this can be manually driven by calling this member function, with
   *       a MicroBitEvent using the CREATE_ONLY option of the MicroBitEvent
@@ -171,10 +195,15 @@ void MicroBitLightSensor::startSensing(MicroBitEvent)
 /**
   * A destructor for MicroBitLightSensor.
   *
-  * The destructor removes the listener, used by MicroBitLightSensor from the default EventModel.
+  * The destructor cancels any reading in progress.
   */
 MicroBitLightSensor::~MicroBitLightSensor()
 {
-    if (EventModel::defaultEventBus)
-        EventModel::defaultEventBus->ignore(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, this, &MicroBitLightSensor::startSensing);
+    analogTrigger.detach();
+
+    if(this->sensePin != NULL)
+    {
+        delete this->sensePin;
+        analogDisable();
+    }
 }
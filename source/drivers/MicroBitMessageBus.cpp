@@ -51,6 +51,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitMessageBus.h"
 #include "MicroBitFiber.h"
 #include "ErrorNo.h"
+#include "MicroBitTrace.h"
 
 /**
   * Default constructor.
@@ -60,17 +61,120 @@ DEALINGS IN THE SOFTWARE.
   */
 MicroBitMessageBus::MicroBitMessageBus()
 {
-	this->listeners = NULL;
+	this->wildcardListeners = NULL;
+
+    for (int i = 0; i < MESSAGE_BUS_LISTENER_BUCKETS; i++)
+        this->listeners[i] = NULL;
+
+    this->deletePending = 0;
     this->evt_queue_head = NULL;
     this->evt_queue_tail = NULL;
     this->queueLength = 0;
+    this->queueHighWater = 0;
+    this->dropCount = 0;
+    this->deleteRetrying = false;
+
+#if MESSAGE_BUS_DROP_SOURCES > 0
+    for (int i = 0; i < MESSAGE_BUS_DROP_SOURCES; i++)
+    {
+        this->drops[i].id = MICROBIT_ID_ANY;
+        this->drops[i].count = 0;
+    }
+#endif
+
+#if MESSAGE_BUS_HIGH_WATER_MARK > 0
+    this->highWaterRaised = false;
+#endif
 
-	fiber_add_idle_component(this);
+	// We are only called when events are queued, or listeners are removed.
+	fiber_add_idle_component(this, MICROBIT_IDLE_ON_DEMAND);
 
 	if(EventModel::defaultEventBus == NULL)
 		EventModel::defaultEventBus = this;
 }
 
+/**
+  * Determines the chain of listeners that holds listeners for the given event ID.
+  *
+  * @param id The event ID of interest.
+  *
+  * @return A pointer to the head of the chain used to store listeners for the given ID.
+  */
+MicroBitListener** MicroBitMessageBus::listenerChain(uint16_t id)
+{
+    if (id == MICROBIT_ID_ANY)
+        return &wildcardListeners;
+
+    return &listeners[id & (MESSAGE_BUS_LISTENER_BUCKETS - 1)];
+}
+
+/**
+  * Runs the handler of a given MicroBitListener that has already been marked as busy,
+  * followed by any further events queued for it in the meantime.
+  *
+  * Internal function, used to enable parameterised callbacks through the fiber scheduler.
+  */
+static void async_callback_dispatch(void *param)
+{
+	MicroBitListener *listener = (MicroBitListener *)param;
+
+    while (1)
+    {
+        // Firstly, check for a method callback into an object.
+        if (listener->flags & MESSAGE_BUS_LISTENER_METHOD)
+            listener->cb_method()->fire(listener->evt);
+
+        // Now a parameterised C function
+        else if (listener->flags & MESSAGE_BUS_LISTENER_PARAMETERISED)
+            listener->cb_param(listener->evt, listener->cb_arg);
+
+        // We must have a plain C function
+        else
+            listener->cb(listener->evt);
+
+        // If there are more events to process, dequeue the next one and process it.
+        if ((listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY) && listener->evt_queue)
+        {
+            MicroBitEventQueueItem *item = listener->evt_queue;
+
+            listener->evt = item->evt;
+            listener->evt_queue = listener->evt_queue->next;
+            delete item;
+
+            // We spin the scheduler here, to preven any particular event handler from continuously holding onto resources.
+            schedule();
+        }
+        else
+            break;
+    }
+
+    // The fiber of exiting... clear our state.
+    listener->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
+}
+
+/**
+  * Runs the handler of a given MicroBitListener that has already been marked as busy, starting with the event
+  * at the head of its queue.
+  *
+  * Used as the entry point of fibers created for a listener in advance, as its evt field may be overwritten
+  * by later events before the fiber runs.
+  */
+static void async_callback_dispatch_queued(void *param)
+{
+	MicroBitListener *listener = (MicroBitListener *)param;
+    MicroBitEventQueueItem *item = listener->evt_queue;
+
+    // If the event could not be queued, the best we can do is deliver the latest.
+    if (item != NULL)
+    {
+        listener->evt = item->evt;
+        listener->evt_queue = item->next;
+        delete item;
+    }
+
+    async_callback_dispatch(listener);
+}
+
 /**
   * Invokes a callback on a given MicroBitListener
   *
@@ -90,7 +194,12 @@ void async_callback(void *param)
     {
         // Drop this event, if that's how we've been configured.
         if (listener->flags & MESSAGE_BUS_LISTENER_DROP_IF_BUSY)
+        {
+            if (listener->dropped < 0xFFFF)
+                listener->dropped++;
+
             return;
+        }
 
         // Queue this event up for later, if that's how we've been configured.
         if (listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY)
@@ -106,44 +215,162 @@ void async_callback(void *param)
     // Record that we have a fiber going into this listener...
     listener->flags |= MESSAGE_BUS_LISTENER_BUSY;
 
-    while (1)
+    async_callback_dispatch(listener);
+}
+
+/**
+  * Invokes a callback on a given MicroBitListener in fork on block context, such that a fiber
+  * is created only if the handler blocks.
+  *
+  * If MESSAGE_BUS_LISTENER_ADAPTIVE is enabled, a handler that is seen to block on consecutive events
+  * is instead given a fiber of its own straight away, avoiding the cost of an attempt that would fork anyway.
+  *
+  * @param listener The listener to invoke, with its evt field set to the event to deliver.
+  */
+static void async_invoke(MicroBitListener *listener)
+{
+    int priority = (int)((listener->flags & MESSAGE_BUS_LISTENER_PRIORITY_MASK) >> MESSAGE_BUS_LISTENER_PRIORITY_SHIFT) - 1;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_LISTENER_ADAPTIVE)
+    // If the handler is already running, async_callback decides what to do with the event, and tells us nothing about blocking.
+    if (listener->flags & MESSAGE_BUS_LISTENER_BUSY)
     {
-        // Firstly, check for a method callback into an object.
-        if (listener->flags & MESSAGE_BUS_LISTENER_METHOD)
-            listener->cb_method->fire(listener->evt);
+        invoke(async_callback, listener, priority);
+        return;
+    }
 
-        // Now a parameterised C function
-        else if (listener->flags & MESSAGE_BUS_LISTENER_PARAMETERISED)
-            listener->cb_param(listener->evt, listener->cb_arg);
+    if (listener->flags & MESSAGE_BUS_LISTENER_FORKING)
+    {
+        if (++listener->streak < MESSAGE_BUS_LISTENER_ADAPTIVE_RETRY)
+        {
+            // Mark the listener as busy now, so that further events are queued or dropped until the new fiber has run.
+            listener->flags |= MESSAGE_BUS_LISTENER_BUSY;
 
-        // We must have a plain C function
-        else
-            listener->cb(listener->evt);
+            Fiber *f = create_fiber(async_callback_dispatch_queued, listener);
 
-        // If there are more events to process, dequeue the next one and process it.
-        if ((listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY) && listener->evt_queue)
+            if (f != NULL)
+            {
+                if (priority != MICROBIT_FIBER_PRIORITY_INHERIT)
+                    fiber_set_priority(f, priority);
+
+                // Further events may overwrite listener->evt before the fiber runs, so hand it this one through the queue.
+                // The queue is empty whilst the listener is idle, and events that arrive before the fiber runs queue behind ours.
+                listener->queue(listener->evt);
+
+                return;
+            }
+
+            listener->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
+        }
+
+        // Periodically call the handler in fork on block context again, in case it no longer blocks.
+        // A single further block returns it to having a fiber of its own.
+        listener->flags &= ~MESSAGE_BUS_LISTENER_FORKING;
+        listener->streak = MESSAGE_BUS_LISTENER_ADAPTIVE_THRESHOLD - 1;
+    }
+
+    invoke(async_callback, listener, priority);
+
+    // If the handler blocked, the fiber forked to complete it still holds the listener busy.
+    if (listener->flags & MESSAGE_BUS_LISTENER_BUSY)
+    {
+        if (++listener->streak >= MESSAGE_BUS_LISTENER_ADAPTIVE_THRESHOLD)
         {
-            MicroBitEventQueueItem *item = listener->evt_queue;
+            listener->flags |= MESSAGE_BUS_LISTENER_FORKING;
+            listener->streak = 0;
+        }
+    }
+    else
+    {
+        listener->streak = 0;
+    }
+#else
+    invoke(async_callback, listener, priority);
+#endif
+}
 
-            listener->evt = item->evt;
-            listener->evt_queue = listener->evt_queue->next;
-            delete item;
+/**
+  * Records that an event has been dropped because the event queue was full.
+  *
+  * @param evt The event that was dropped.
+  */
+void MicroBitMessageBus::recordDrop(MicroBitEvent &evt)
+{
+    __disable_irq();
 
-            // We spin the scheduler here, to preven any particular event handler from continuously holding onto resources.
-            schedule();
+    dropCount++;
+
+#if MESSAGE_BUS_DROP_SOURCES > 0
+    MicroBitEventDropCount *slot = &drops[0];
+
+    // Find the entry for this source, or failing that, the entry with the fewest drops recorded.
+    for (int i = 0; i < MESSAGE_BUS_DROP_SOURCES; i++)
+    {
+        if (drops[i].id == evt.source && drops[i].count > 0)
+        {
+            slot = &drops[i];
+            break;
         }
-        else
+
+        if (drops[i].count < slot->count)
+            slot = &drops[i];
+    }
+
+    if (slot->id != evt.source || slot->count == 0)
+    {
+        slot->id = evt.source;
+        slot->count = 0;
+    }
+
+    if (slot->count < 0xFFFF)
+        slot->count++;
+#endif
+
+    __enable_irq();
+}
+
+/**
+  * Determines if all standard listeners that would receive the given event have been created with
+  * MESSAGE_BUS_LISTENER_COALESCE, such that only the latest identical event need be kept on the queue.
+  *
+  * @param l The head of the chain of listeners to inspect.
+  *
+  * @param evt The event of interest.
+  *
+  * @param matched Incremented for each listener that would receive the event.
+  *
+  * @return true if all matching listeners in the chain coalesce events, false otherwise.
+  */
+bool MicroBitMessageBus::coalescingChain(MicroBitListener *l, MicroBitEvent &evt, int &matched)
+{
+    for (; l != NULL; l = l->next)
+    {
+        if (l->id > evt.source && l->id != MICROBIT_ID_ANY)
             break;
+
+        if ((l->id == evt.source || l->id == MICROBIT_ID_ANY) && (l->value == evt.value || l->value == MICROBIT_EVT_ANY))
+        {
+            // Urgent listeners have already received the event, so are not affected.
+            if ((l->flags & MESSAGE_BUS_LISTENER_DELETING) || (l->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) == MESSAGE_BUS_LISTENER_IMMEDIATE)
+                continue;
+
+            if (!(l->flags & MESSAGE_BUS_LISTENER_COALESCE))
+                return false;
+
+            matched++;
+        }
     }
 
-    // The fiber of exiting... clear our state.
-    listener->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
+    return true;
 }
 
 /**
   * Queue the given event for processing at a later time.
   * Add the given event at the tail of our queue.
   *
+  * If all of the listeners that will receive the event have been created with MESSAGE_BUS_LISTENER_COALESCE,
+  * and an identical event (same source and value) is already queued, that event is replaced with the given one.
+  *
   * @param The event to queue.
   */
 void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
@@ -161,9 +388,32 @@ void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
     if (processingComplete)
         return;
 
+    // If our listeners are only interested in the latest value of this event, update any identical event already queued.
+    int matched = 0;
+
+    if (evt_queue_head != NULL && coalescingChain(wildcardListeners, evt, matched) && coalescingChain(*listenerChain(evt.source), evt, matched) && matched > 0)
+    {
+        __disable_irq();
+
+        for (MicroBitEventQueueItem *p = evt_queue_head; p != NULL; p = p->next)
+        {
+            if (p->evt.source == evt.source && p->evt.value == evt.value)
+            {
+                p->evt = evt;
+                __enable_irq();
+                return;
+            }
+        }
+
+        __enable_irq();
+    }
+
     // If we need to queue, but there is no space, then there's nothg we can do.
     if (queueLength >= MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH)
+    {
+        recordDrop(evt);
         return;
+    }
 
     // Otherwise, we need to queue this event for later processing...
     // We queue this event at the tail of the queue at the point where we entered queueEvent()
@@ -190,7 +440,26 @@ void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
 
     queueLength++;
 
+    if (queueLength > queueHighWater)
+        queueHighWater = queueLength;
+
+#if MESSAGE_BUS_HIGH_WATER_MARK > 0
+    bool raise = !highWaterRaised && queueLength >= MESSAGE_BUS_HIGH_WATER_MARK;
+
+    // Record that we've raised the event before doing so, as it is itself queued by this function.
+    if (raise)
+        highWaterRaised = true;
+#endif
+
     __enable_irq();
+
+    // Ensure the idle thread picks the event up.
+    fiber_wake_idle_component(this);
+
+#if MESSAGE_BUS_HIGH_WATER_MARK > 0
+    if (raise)
+        send(MicroBitEvent(MICROBIT_ID_MESSAGE_BUS, MESSAGE_BUS_EVT_HIGH_WATER, CREATE_ONLY));
+#endif
 }
 
 /**
@@ -213,6 +482,12 @@ MicroBitEventQueueItem* MicroBitMessageBus::dequeueEvent()
             evt_queue_tail = NULL;
 
         queueLength--;
+
+#if MESSAGE_BUS_HIGH_WATER_MARK > 0
+        // Allow the high water event to be raised again once the queue has drained.
+        if (queueLength < MESSAGE_BUS_HIGH_WATER_MARK / 2)
+            highWaterRaised = false;
+#endif
     }
 
     __enable_irq();
@@ -221,44 +496,168 @@ MicroBitEventQueueItem* MicroBitMessageBus::dequeueEvent()
     return item;
 }
 
+/**
+  * Extract all events from the event queue at once.
+  *
+  * @return a pointer to the MicroBitEventQueueItem that was at the head of the list, or NULL if the queue was empty.
+  */
+MicroBitEventQueueItem* MicroBitMessageBus::dequeueEvents()
+{
+    MicroBitEventQueueItem *item;
+
+    __disable_irq();
+
+    item = evt_queue_head;
+    evt_queue_head = NULL;
+    evt_queue_tail = NULL;
+    queueLength = 0;
+
+#if MESSAGE_BUS_HIGH_WATER_MARK > 0
+    highWaterRaised = false;
+#endif
+
+    __enable_irq();
+
+    return item;
+}
+
+/**
+  * Delivers the events gathered by processChain() in batch mode, by invoking each listener that
+  * has events queued but is not already busy. Each listener then processes its run of events in turn.
+  */
+void MicroBitMessageBus::dispatchBatch()
+{
+    for (int i = -1; i < MESSAGE_BUS_LISTENER_BUCKETS; i++)
+    {
+        for (MicroBitListener *l = i < 0 ? wildcardListeners : listeners[i]; l != NULL; l = l->next)
+        {
+            // Busy listeners will process their queue once their current handler completes.
+            if ((l->flags & MESSAGE_BUS_LISTENER_BUSY) || l->evt_queue == NULL)
+                continue;
+
+            // Discard events for any listener removed since the events were gathered.
+            if (l->flags & MESSAGE_BUS_LISTENER_DELETING)
+            {
+                while (l->evt_queue != NULL)
+                {
+                    MicroBitEventQueueItem *item = l->evt_queue;
+                    l->evt_queue = item->next;
+                    delete item;
+                }
+
+                continue;
+            }
+
+            MicroBitEventQueueItem *item = l->evt_queue;
+
+            l->evt = item->evt;
+            l->evt_queue = item->next;
+            delete item;
+
+            // A single event is handled in fork on block context, as usual.
+            if (l->evt_queue == NULL || !fiber_scheduler_running())
+            {
+                if (fiber_scheduler_running())
+                    async_invoke(l);
+                else
+                    async_callback(l);
+
+                continue;
+            }
+
+            // Otherwise, give the listener a fiber in which to work through its run of events.
+            l->flags |= MESSAGE_BUS_LISTENER_BUSY;
+
+            if (create_fiber(async_callback_dispatch, l) != NULL)
+                continue;
+
+            // If we're out of memory, deliver the first event as best we can and drop the rest.
+            l->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
+
+            while (l->evt_queue != NULL)
+            {
+                item = l->evt_queue;
+                l->evt_queue = item->next;
+                delete item;
+
+                if (l->dropped < 0xFFFF)
+                    l->dropped++;
+            }
+
+            async_invoke(l);
+        }
+    }
+}
+
 /**
   * Cleanup any MicroBitListeners marked for deletion from the list.
   *
-  * @return The number of listeners removed from the list.
+  * @return The number of listeners marked for deletion that are still busy, and so could not yet be removed.
   */
 int MicroBitMessageBus::deleteMarkedListeners()
 {
 	MicroBitListener *l, *p;
-    int removed = 0;
+    int busy = 0;
 
-	l = listeners;
-	p = NULL;
+    if (deletePending == 0)
+        return 0;
 
-    // Walk this list of event handlers. Delete any that match the given listener.
-    while (l != NULL)
+    for (int i = -1; i < MESSAGE_BUS_LISTENER_BUCKETS; i++)
     {
-        if ((l->flags & MESSAGE_BUS_LISTENER_DELETING) && !(l->flags & MESSAGE_BUS_LISTENER_BUSY))
+        MicroBitListener **chain = i < 0 ? &wildcardListeners : &listeners[i];
+        uint32_t chainBit = 1 << (i + 1);
+        int chainBusy = 0;
+
+        if (!(deletePending & chainBit))
+            continue;
+
+        // Clear this chain's bit before walking it, so that a listener marked by remove() while we walk
+        // (possibly from interrupt context) leaves the chain pending, rather than being lost.
+        __disable_irq();
+        deletePending &= ~chainBit;
+        __enable_irq();
+
+        l = *chain;
+        p = NULL;
+
+        // Walk this list of event handlers. Delete any that match the given listener.
+        while (l != NULL)
         {
-            if (p == NULL)
-                listeners = l->next;
-            else
-                p->next = l->next;
+            if ((l->flags & MESSAGE_BUS_LISTENER_DELETING) && (l->flags & MESSAGE_BUS_LISTENER_BUSY))
+                chainBusy++;
 
-            // delete the listener.
-            MicroBitListener *t = l;
-            l = l->next;
+            if ((l->flags & MESSAGE_BUS_LISTENER_DELETING) && !(l->flags & MESSAGE_BUS_LISTENER_BUSY))
+            {
+                if (p == NULL)
+                    *chain = l->next;
+                else
+                    p->next = l->next;
 
-            delete t;
-            removed++;
+                // delete the listener.
+                MicroBitListener *t = l;
+                l = l->next;
 
-            continue;
+                delete t;
+
+                continue;
+            }
+
+            p = l;
+            l = l->next;
         }
 
-        p = l;
-        l = l->next;
+        // Listeners still busy keep this chain pending, so they are reclaimed on a later pass.
+        if (chainBusy > 0)
+        {
+            __disable_irq();
+            deletePending |= chainBit;
+            __enable_irq();
+        }
+
+        busy += chainBusy;
     }
 
-    return removed;
+    return busy;
 }
 
 /**
@@ -266,11 +665,36 @@ int MicroBitMessageBus::deleteMarkedListeners()
   *
   * Process at least one event from the event queue, if it is not empty.
   * We then continue processing events until something appears on the runqueue.
+  *
+  * If MESSAGE_BUS_BATCH_DISPATCH is enabled, all events on the queue are processed together instead.
   */
 void MicroBitMessageBus::idleTick()
 {
-    // Clear out any listeners marked for deletion
-    this->deleteMarkedListeners();
+    // Clear out any listeners marked for deletion. Those still busy are removed on a later pass.
+    bool retry = this->deleteMarkedListeners() > 0;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_BATCH_DISPATCH)
+    MicroBitEventQueueItem *item = this->dequeueEvents();
+    bool delivered = item != NULL;
+
+    // Deliver each event in turn to listeners that accept it immediately, and gather
+    // it up for those that queue events, to be delivered once the whole batch is sorted.
+    while (item)
+    {
+        MicroBitEventQueueItem *next = item->next;
+
+        processChain(wildcardListeners, item->evt, false, true);
+
+        if (item->evt.source != MICROBIT_ID_ANY)
+            processChain(*listenerChain(item->evt.source), item->evt, false, true);
+
+        delete item;
+        item = next;
+    }
+
+    if (delivered)
+        this->dispatchBatch();
+#else
 
     MicroBitEventQueueItem *item = this->dequeueEvent();
 
@@ -292,6 +716,19 @@ void MicroBitMessageBus::idleTick()
         // Pull the next event to process, if there is one.
         item = this->dequeueEvent();
     }
+#endif
+
+    // We are only called when there is work to do, so ask to be called again if any events remain.
+    if (evt_queue_head != NULL)
+        fiber_wake_idle_component(this);
+
+    // Listeners removed whilst busy can wait for the processor to wake anyway. Waking ourselves for them would stop
+    // it sleeping at all, so instead we are called on every idle pass until they have gone.
+    if (retry != deleteRetrying)
+    {
+        deleteRetrying = retry;
+        fiber_add_idle_component(this, retry ? MICROBIT_IDLE_EVERY_PASS : MICROBIT_IDLE_ON_DEMAND);
+    }
 }
 
 /**
@@ -319,6 +756,7 @@ int MicroBitMessageBus::send(MicroBitEvent evt)
     // We simply queue processing of the event until we're scheduled in normal thread context.
     // We do this to avoid the possibility of executing event handler code in IRQ context, which may bring
     // hidden race conditions to kids code. Queuing all events ensures causal ordering (total ordering in fact).
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_EVENT, evt.source, evt.value);
     this->queueEvent(evt);
     return MICROBIT_OK;
 }
@@ -339,13 +777,45 @@ int MicroBitMessageBus::send(MicroBitEvent evt)
   */
 int MicroBitMessageBus::process(MicroBitEvent &evt, bool urgent)
 {
-	MicroBitListener *l;
+    int complete = 1;
+
+    // Wildcard listeners are held in their own chain, and are processed first.
+    // This maintains the ordering of listeners by ID.
+    if (!processChain(wildcardListeners, evt, urgent))
+        complete = 0;
+
+    if (evt.source != MICROBIT_ID_ANY && !processChain(*listenerChain(evt.source), evt, urgent))
+        complete = 0;
+
+    return complete;
+}
+
+/**
+  * Internal function, used to deliver the given event to all relevant recipients held in the
+  * given chain of listeners.
+  *
+  * @param l The head of the chain of listeners to process.
+  *
+  * @param evt The event to send.
+  *
+  * @param urgent The type of listeners to process.
+  *
+  * @param batch If true, the event is queued on any standard MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY listeners
+  *              rather than delivered, for later delivery by dispatchBatch(). Defaults to false.
+  *
+  * @return 1 if all matching listeners were processed, 0 if further processing is required.
+  */
+int MicroBitMessageBus::processChain(MicroBitListener *l, MicroBitEvent &evt, bool urgent, bool batch)
+{
     int complete = 1;
     bool listenerUrgent;
 
-    l = listeners;
     while (l != NULL)
     {
+        // Chains are held in increasing order of ID, so there can be no further matches once we've passed the ID of the event.
+        if (l->id > evt.source && l->id != MICROBIT_ID_ANY)
+            break;
+
 	    if((l->id == evt.source || l->id == MICROBIT_ID_ANY) && (l->value == evt.value || l->value == MICROBIT_EVT_ANY))
         {
             // If we're running under the fiber scheduler, then derive the THREADING_MODE for the callback based on the
@@ -358,17 +828,25 @@ int MicroBitMessageBus::process(MicroBitEvent &evt, bool urgent)
             // If we should process this event hander in this pass, then activate the listener.
             if(listenerUrgent == urgent && !(l->flags & MESSAGE_BUS_LISTENER_DELETING))
             {
-                l->evt = evt;
-
-                // OK, if this handler has regisitered itself as non-blocking, we just execute it directly...
-                // This is normally only done for trusted system components.
-                // Otherwise, we invoke it in a 'fork on block' context, that will automatically create a fiber
-                // should the event handler attempt a blocking operation, but doesn't have the overhead
-                // of creating a fiber needlessly. (cool huh?)
-				if (l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING || !fiber_scheduler_running())
-					async_callback(l);
-				else
-					invoke(async_callback, l);
+                // When processing a batch, gather up the events for listeners that would queue them anyway.
+                if (batch && (l->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY) && !(l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING))
+                {
+                    l->queue(evt);
+                }
+                else
+                {
+                    l->evt = evt;
+
+                    // OK, if this handler has regisitered itself as non-blocking, we just execute it directly...
+                    // This is normally only done for trusted system components.
+                    // Otherwise, we invoke it in a 'fork on block' context, that will automatically create a fiber
+                    // should the event handler attempt a blocking operation, but doesn't have the overhead
+                    // of creating a fiber needlessly. (cool huh?)
+                    if (l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING || !fiber_scheduler_running())
+                        async_callback(l);
+                    else
+                        async_invoke(l);
+                }
             }
             else
             {
@@ -392,13 +870,16 @@ int MicroBitMessageBus::process(MicroBitEvent &evt, bool urgent)
 int MicroBitMessageBus::add(MicroBitListener *newListener)
 {
 	MicroBitListener *l, *p;
+    MicroBitListener **chain;
     int methodCallback;
 
 	//handler can't be NULL!
 	if (newListener == NULL)
 		return MICROBIT_INVALID_PARAMETER;
 
-	l = listeners;
+    // Listeners are held in a chain selected by their ID.
+    chain = listenerChain(newListener->id);
+	l = *chain;
 
 	// Firstly, we treat a listener as an idempotent operation. Ensure we don't already have this handler
 	// registered in a that will already capture these events. If we do, silently ignore.
@@ -409,7 +890,7 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
     {
         methodCallback = (newListener->flags & MESSAGE_BUS_LISTENER_METHOD) && (l->flags & MESSAGE_BUS_LISTENER_METHOD);
 
-        if (l->id == newListener->id && l->value == newListener->value && (methodCallback ? *l->cb_method == *newListener->cb_method : l->cb == newListener->cb))
+        if (l->id == newListener->id && l->value == newListener->value && (methodCallback ? *l->cb_method() == *newListener->cb_method() : l->cb == newListener->cb))
         {
             // We have a perfect match for this event listener already registered.
             // If it's marked for deletion, we simply resurrect the listener, and we're done.
@@ -423,51 +904,29 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
         l = l->next;
     }
 
-    // We have a valid, new event handler. Add it to the list.
-	// if listeners is null - we can automatically add this listener to the list at the beginning...
-	if (listeners == NULL)
-	{
-		listeners = newListener;
-        MicroBitEvent(MICROBIT_ID_MESSAGE_BUS_LISTENER, newListener->id);
-
-		return MICROBIT_OK;
-	}
-
-	// We maintain an ordered list of listeners.
+	// We maintain an ordered chain of listeners.
 	// The chain is held stictly in increasing order of ID (first level), then value code (second level).
 	// Find the correct point in the chain for this event.
 	// Adding a listener is a rare occurance, so we just walk the list...
 
-	p = listeners;
-	l = listeners;
+	p = NULL;
+	l = *chain;
 
-	while (l != NULL && l->id < newListener->id)
+	while (l != NULL && (l->id < newListener->id || (l->id == newListener->id && l->value < newListener->value)))
 	{
 		p = l;
 		l = l->next;
 	}
 
-	while (l != NULL && l->id == newListener->id && l->value < newListener->value)
-	{
-		p = l;
-		l = l->next;
-	}
+    newListener->next = l;
 
 	//add at front of list
-	if (p == listeners && (newListener->id < p->id || (p->id == newListener->id && p->value > newListener->value)))
-	{
-		newListener->next = p;
-
-		//this new listener is now the front!
-		listeners = newListener;
-	}
+	if (p == NULL)
+		*chain = newListener;
 
 	//add after p
 	else
-	{
-		newListener->next = p->next;
 		p->next = newListener;
-	}
 
     MicroBitEvent(MICROBIT_ID_MESSAGE_BUS_LISTENER, newListener->id);
     return MICROBIT_OK;
@@ -482,6 +941,7 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
   */
 int MicroBitMessageBus::remove(MicroBitListener *listener)
 {
+	MicroBitListener **chain;
 	MicroBitListener *l;
     int removed = 0;
 
@@ -489,30 +949,46 @@ int MicroBitMessageBus::remove(MicroBitListener *listener)
 	if (listener == NULL)
 		return MICROBIT_INVALID_PARAMETER;
 
-	l = listeners;
-
-    // Walk this list of event handlers. Delete any that match the given listener.
-    while (l != NULL)
+    // A wildcard ID may match listeners in any chain. Otherwise, only the chain holding the given ID can match.
+    for (int i = -1; i < MESSAGE_BUS_LISTENER_BUCKETS; i++)
     {
-        if ((listener->flags & MESSAGE_BUS_LISTENER_METHOD) == (l->flags & MESSAGE_BUS_LISTENER_METHOD))
+        if (listener->id == MICROBIT_ID_ANY)
+            chain = i < 0 ? &wildcardListeners : &listeners[i];
+        else if (i < 0)
+            chain = listenerChain(listener->id);
+        else
+            break;
+
+        l = *chain;
+
+        // Walk this list of event handlers. Delete any that match the given listener.
+        while (l != NULL)
         {
-            if(((listener->flags & MESSAGE_BUS_LISTENER_METHOD) && (*l->cb_method == *listener->cb_method)) ||
-              ((!(listener->flags & MESSAGE_BUS_LISTENER_METHOD) && l->cb == listener->cb)))
+            if ((listener->flags & MESSAGE_BUS_LISTENER_METHOD) == (l->flags & MESSAGE_BUS_LISTENER_METHOD))
             {
-                if ((listener->id == MICROBIT_ID_ANY || listener->id == l->id) && (listener->value == MICROBIT_EVT_ANY || listener->value == l->value))
+                if(((listener->flags & MESSAGE_BUS_LISTENER_METHOD) && (*l->cb_method() == *listener->cb_method())) ||
+                  ((!(listener->flags & MESSAGE_BUS_LISTENER_METHOD) && l->cb == listener->cb)))
                 {
-                    // Found a match. mark this to be removed from the list.
-                    l->flags |= MESSAGE_BUS_LISTENER_DELETING;
-                    removed++;
+                    if ((listener->id == MICROBIT_ID_ANY || listener->id == l->id) && (listener->value == MICROBIT_EVT_ANY || listener->value == l->value))
+                    {
+                        // Found a match. mark this to be removed from the list.
+                        l->flags |= MESSAGE_BUS_LISTENER_DELETING;
+                        deletePending |= 1 << (chain == &wildcardListeners ? 0 : chain - listeners + 1);
+                        removed++;
+                    }
                 }
             }
-        }
 
-        l = l->next;
+            l = l->next;
+        }
     }
 
     if (removed > 0)
+    {
+        // The idle thread removes the listeners for good, once they are no longer busy.
+        fiber_wake_idle_component(this);
         return MICROBIT_OK;
+    }
     else
         return MICROBIT_INVALID_PARAMETER;
 }
@@ -526,18 +1002,63 @@ int MicroBitMessageBus::remove(MicroBitListener *listener)
   */
 MicroBitListener* MicroBitMessageBus::elementAt(int n)
 {
-    MicroBitListener *l = listeners;
-
-    while (n > 0)
+    // Enumerate the wildcard listeners first, followed by each chain in turn.
+    for (int i = -1; i < MESSAGE_BUS_LISTENER_BUCKETS; i++)
     {
-        if (l == NULL)
-            return NULL;
+        MicroBitListener *l = i < 0 ? wildcardListeners : listeners[i];
 
-        n--;
-        l = l->next;
+        while (l != NULL)
+        {
+            if (n == 0)
+                return l;
+
+            n--;
+            l = l->next;
+        }
     }
 
-    return l;
+    return NULL;
+}
+
+/**
+  * Determines the total number of events that have been dropped because the event queue was full.
+  *
+  * @return The number of events dropped since this MicroBitMessageBus was created.
+  *
+  * @note Events dropped by individual listeners are recorded in the dropped field of each MicroBitListener.
+  */
+uint32_t MicroBitMessageBus::getDropCount()
+{
+    return dropCount;
+}
+
+/**
+  * Determines the number of events from the given source that have been dropped because the event queue was full.
+  *
+  * @param id The ID of the component of interest.
+  *
+  * @return The number of events dropped from the given component, or 0 if it is not one of the
+  *         MESSAGE_BUS_DROP_SOURCES sources with recorded drops.
+  */
+int MicroBitMessageBus::getDropCount(uint16_t id)
+{
+#if MESSAGE_BUS_DROP_SOURCES > 0
+    for (int i = 0; i < MESSAGE_BUS_DROP_SOURCES; i++)
+        if (drops[i].id == id && drops[i].count > 0)
+            return drops[i].count;
+#endif
+
+    return 0;
+}
+
+/**
+  * Determines the greatest number of events that have been waiting on the event queue at any one time.
+  *
+  * @return The high water mark of the event queue.
+  */
+int MicroBitMessageBus::getQueueHighWaterMark()
+{
+    return queueHighWater;
 }
 
 /**
@@ -53,6 +53,8 @@ MicroBitMultiButton::MicroBitMultiButton(uint16_t button1, uint16_t button2, uin
     this->id = id;
     this->button1 = button1;
     this->button2 = button2;
+    this->subButton1 = NULL;
+    this->subButton2 = NULL;
     this->eventConfiguration = MICROBIT_BUTTON_SIMPLE_EVENTS;
 
     if (EventModel::defaultEventBus)
@@ -62,6 +64,71 @@ MicroBitMultiButton::MicroBitMultiButton(uint16_t button1, uint16_t button2, uin
     }
 }
 
+/**
+  * Constructor.
+  *
+  * Create a representation of a virtual button, that generates events based upon the combination
+  * of two given buttons. The buttons inform this MicroBitMultiButton of each change in their state directly
+  * from their systemTick(), so that no listeners are needed, and no events are dispatched to reach us.
+  *
+  * @param button1 the first button to watch.
+  *
+  * @param button2 the second button to watch.
+  *
+  * @param id the unique EventModel id of this MicroBitMultiButton instance.
+  *
+  * @code
+  * multiButton(buttonA, buttonB, MICROBIT_ID_BUTTON_AB);
+  * @endcode
+  */
+MicroBitMultiButton::MicroBitMultiButton(MicroBitButton &button1, MicroBitButton &button2, uint16_t id)
+{
+    this->id = id;
+    this->button1 = button1.getId();
+    this->button2 = button2.getId();
+    this->subButton1 = &button1;
+    this->subButton2 = &button2;
+    this->eventConfiguration = MICROBIT_BUTTON_SIMPLE_EVENTS;
+    this->status |= MICROBIT_MULTI_BUTTON_ATTACHED;
+
+    button1.setMultiButton(this);
+    button2.setMultiButton(this);
+}
+
+/**
+  * Destructor. Stops listening to, or being informed by, the two buttons.
+  */
+MicroBitMultiButton::~MicroBitMultiButton()
+{
+    if (status & MICROBIT_MULTI_BUTTON_ATTACHED)
+    {
+        if (subButton1)
+            subButton1->setMultiButton(NULL);
+
+        if (subButton2)
+            subButton2->setMultiButton(NULL);
+    }
+    else if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->ignore(button1, MICROBIT_EVT_ANY, this, &MicroBitMultiButton::onButtonEvent);
+        EventModel::defaultEventBus->ignore(button2, MICROBIT_EVT_ANY, this, &MicroBitMultiButton::onButtonEvent);
+    }
+}
+
+/**
+  * Stops being informed by the given button, typically as it is destroyed.
+  *
+  * @param button the button to forget.
+  */
+void MicroBitMultiButton::detach(MicroBitButton *button)
+{
+    if (button == subButton1)
+        subButton1 = NULL;
+
+    if (button == subButton2)
+        subButton2 = NULL;
+}
+
 /**
   * Retrieves the button id for the alternate button id given.
   *
@@ -233,10 +300,22 @@ void MicroBitMultiButton::setEventConfiguration(MicroBitButtonEventConfiguration
   */
 void MicroBitMultiButton::onButtonEvent(MicroBitEvent evt)
 {
-    int button = evt.source;
-    int otherButton = otherSubButton(button);
+    subButtonEvent(evt.source, evt.value);
+}
+
+/**
+  * Updates the state of this MicroBitMultiButton after a change in the state of one of its buttons,
+  * and generates any events for the combination.
+  *
+  * @param button the id of the button whose state has changed.
+  *
+  * @param value the MicroBitButton event describing the change (MICROBIT_BUTTON_EVT_DOWN, MICROBIT_BUTTON_EVT_UP or MICROBIT_BUTTON_EVT_HOLD).
+  */
+void MicroBitMultiButton::subButtonEvent(uint16_t button, uint16_t value)
+{
+    uint16_t otherButton = otherSubButton(button);
 
-    switch(evt.value)
+    switch(value)
     {
         case MICROBIT_BUTTON_EVT_DOWN:
             setButtonState(button, 1);
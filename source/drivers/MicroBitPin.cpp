@@ -34,7 +34,14 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitSystemTimer.h"
 #include "TimedInterruptIn.h"
 #include "DynamicPwm.h"
+#include "MicroBitTouchSensor.h"
 #include "ErrorNo.h"
+#include "MicroBitTrace.h"
+
+#if CONFIG_ENABLED(MICROBIT_PIN_TOUCH_CAPACITIVE)
+// The touch sensor shared by every pin in the touch state. Created on first use.
+static MicroBitTouchSensor *touchSensor = NULL;
+#endif
 
 /**
   * Constructor.
@@ -87,12 +94,20 @@ void MicroBitPin::disconnect()
     }
 
     if (status & IO_STATUS_ANALOG_OUT)
-        delete ((DynamicPwm *)pin);
+        ((DynamicPwm *)pin)->release();
 
     if (status & IO_STATUS_TOUCH_IN)
+#if CONFIG_ENABLED(MICROBIT_PIN_TOUCH_CAPACITIVE)
+        ((MicroBitTouchSensor *)pin)->removePin(name);
+#else
         delete ((MicroBitButton *)pin);
+#endif
+
+    // Stop any periodic callbacks before the edge counter they read is released.
+    if (status & IO_STATUS_EDGE_WINDOW)
+        system_timer_remove_component(this);
 
-    if ((status & IO_STATUS_EVENT_ON_EDGE) || (status & IO_STATUS_EVENT_PULSE_ON_EDGE))
+    if (status & IO_STATUS_TIMED_INTERRUPT)
         delete ((TimedInterruptIn *)pin);
 
     this->pin = NULL;
@@ -154,14 +169,14 @@ int MicroBitPin::getDigitalValue()
         return MICROBIT_NOT_SUPPORTED;
 
     // Move into a Digital input state if necessary.
-    if (!(status & (IO_STATUS_DIGITAL_IN | IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE)))
+    if (!(status & (IO_STATUS_DIGITAL_IN | IO_STATUS_TIMED_INTERRUPT)))
     {
         disconnect();
         pin = new DigitalIn(name, (PinMode)pullMode);
         status |= IO_STATUS_DIGITAL_IN;
     }
 
-    if(status & (IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE))
+    if(status & IO_STATUS_TIMED_INTERRUPT)
         return ((TimedInterruptIn *)pin)->read();
 
     return ((DigitalIn *)pin)->read();
@@ -191,7 +206,11 @@ int MicroBitPin::obtainAnalogChannel()
     // Move into an analogue input state if necessary, if we are no longer the focus of a DynamicPWM instance, allocate ourselves again!
     if (!(status & IO_STATUS_ANALOG_OUT) || !(((DynamicPwm *)pin)->getPinName() == name)){
         disconnect();
-        pin = (void *)new DynamicPwm(name);
+        pin = (void *)DynamicPwm::allocate(name);
+
+        if (pin == NULL)
+            return MICROBIT_NO_RESOURCES;
+
         status |= IO_STATUS_ANALOG_OUT;
     }
 
@@ -203,8 +222,8 @@ int MicroBitPin::obtainAnalogChannel()
   *
   * @param value the level to set on the output pin, in the range 0 - 1024
   *
-  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, or MICROBIT_NOT_SUPPORTED
-  *         if the given pin does not have analog capability.
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, MICROBIT_NO_RESOURCES if every
+  *         PWM channel is in use, or MICROBIT_NOT_SUPPORTED if the given pin does not have analog capability.
   */
 int MicroBitPin::setAnalogValue(int value)
 {
@@ -219,10 +238,12 @@ int MicroBitPin::setAnalogValue(int value)
     float level = (float)value / float(MICROBIT_PIN_MAX_OUTPUT);
 
     //obtain use of the DynamicPwm instance, if it has changed / configure if we do not have one
-    if(obtainAnalogChannel() == MICROBIT_OK)
-        return ((DynamicPwm *)pin)->write(level);
+    int result = obtainAnalogChannel();
 
-    return MICROBIT_OK;
+    if(result != MICROBIT_OK)
+        return result;
+
+    return ((DynamicPwm *)pin)->write(level);
 }
 
 /**
@@ -339,9 +360,13 @@ int MicroBitPin::isAnalog()
   * Configures this IO pin as a "makey makey" style touch sensor (if necessary)
   * and tests its current debounced state.
   *
+  * With MICROBIT_PIN_TOUCH_CAPACITIVE, the pin is measured capacitively by a MicroBitTouchSensor shared with
+  * other touched pins, so the pin need not be touched together with GND. Otherwise, it is sampled as a MicroBitButton.
+  *
   * Users can also subscribe to MicroBitButton events generated from this pin.
   *
-  * @return 1 if pin is touched, 0 if not, or MICROBIT_NOT_SUPPORTED if this pin does not support touch capability.
+  * @return 1 if pin is touched, 0 if not, MICROBIT_NO_RESOURCES if no more pins can be measured,
+  *         or MICROBIT_NOT_SUPPORTED if this pin does not support touch capability.
   *
   * @code
   * MicroBitMessageBus bus;
@@ -365,11 +390,27 @@ int MicroBitPin::isTouched()
     // Move into a touch input state if necessary.
     if (!(status & IO_STATUS_TOUCH_IN)){
         disconnect();
+#if CONFIG_ENABLED(MICROBIT_PIN_TOUCH_CAPACITIVE)
+        if (touchSensor == NULL)
+            touchSensor = new MicroBitTouchSensor();
+
+        int result = touchSensor->addPin(name, id);
+
+        if (result != MICROBIT_OK)
+            return result;
+
+        pin = touchSensor;
+#else
         pin = new MicroBitButton(name, id);
+#endif
         status |= IO_STATUS_TOUCH_IN;
     }
 
+#if CONFIG_ENABLED(MICROBIT_PIN_TOUCH_CAPACITIVE)
+    return ((MicroBitTouchSensor *)pin)->isTouched(name);
+#else
     return ((MicroBitButton *)pin)->isPressed();
+#endif
 }
 
 /**
@@ -378,8 +419,8 @@ int MicroBitPin::isTouched()
   *
   * @param pulseWidth the desired pulse width in microseconds.
   *
-  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, or MICROBIT_NOT_SUPPORTED
-  *         if the given pin does not have analog capability.
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, MICROBIT_NO_RESOURCES if every
+  *         PWM channel is in use, or MICROBIT_NOT_SUPPORTED if the given pin does not have analog capability.
   */
 int MicroBitPin::setServoPulseUs(int pulseWidth)
 {
@@ -392,16 +433,16 @@ int MicroBitPin::setServoPulseUs(int pulseWidth)
         return MICROBIT_INVALID_PARAMETER;
 
     //Check we still have the control over the DynamicPwm instance
-    if(obtainAnalogChannel() == MICROBIT_OK)
-    {
-        //check if the period is set to 20ms
-        if(((DynamicPwm *)pin)->getPeriodUs() != MICROBIT_DEFAULT_PWM_PERIOD)
-            ((DynamicPwm *)pin)->setPeriodUs(MICROBIT_DEFAULT_PWM_PERIOD);
+    int result = obtainAnalogChannel();
 
-        ((DynamicPwm *)pin)->pulsewidth_us(pulseWidth);
-    }
+    if(result != MICROBIT_OK)
+        return result;
 
-    return MICROBIT_OK;
+    //check if the period is set to 20ms
+    if(((DynamicPwm *)pin)->getPeriodUs() != MICROBIT_DEFAULT_PWM_PERIOD)
+        ((DynamicPwm *)pin)->setPeriodUs(MICROBIT_DEFAULT_PWM_PERIOD);
+
+    return ((DynamicPwm *)pin)->pulsewidth_us(pulseWidth);
 }
 
 /**
@@ -476,7 +517,7 @@ int MicroBitPin::setPull(PinMode pull)
         return MICROBIT_OK;
     }
 
-    if((status & IO_STATUS_EVENT_ON_EDGE) || (status & IO_STATUS_EVENT_PULSE_ON_EDGE))
+    if(status & IO_STATUS_TIMED_INTERRUPT)
     {
         ((TimedInterruptIn *)pin)->mode(pull);
         return MICROBIT_OK;
@@ -494,12 +535,12 @@ int MicroBitPin::setPull(PinMode pull)
 void MicroBitPin::pulseWidthEvent(int eventValue)
 {
     MicroBitEvent evt(id, eventValue, CREATE_ONLY);
-    uint64_t now = evt.timestamp;
+    uint64_t now = evt.getTimestamp();
     uint64_t previous = ((TimedInterruptIn *)pin)->getTimestamp();
 
     if (previous != 0)
     {
-        evt.timestamp -= previous;
+        evt.setTimestamp(now - previous);
         evt.fire();
     }
 
@@ -511,11 +552,20 @@ void MicroBitPin::pulseWidthEvent(int eventValue)
   */
 void MicroBitPin::onRise()
 {
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_PIN, id);
+
     if(status & IO_STATUS_EVENT_PULSE_ON_EDGE)
         pulseWidthEvent(MICROBIT_PIN_EVT_PULSE_LO);
 
     if(status & IO_STATUS_EVENT_ON_EDGE)
-        MicroBitEvent(id, MICROBIT_PIN_EVT_RISE);
+        MicroBitEvent(id, MICROBIT_PIN_EVT_RISE, CREATE_AND_DEFER);
+
+    if(status & IO_STATUS_EVENT_CAPTURE)
+        captureEvent(1);
+
+    ((TimedInterruptIn *)pin)->edgeCount++;
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_PIN, id);
 }
 
 /**
@@ -523,11 +573,53 @@ void MicroBitPin::onRise()
   */
 void MicroBitPin::onFall()
 {
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_PIN, id);
+
     if(status & IO_STATUS_EVENT_PULSE_ON_EDGE)
         pulseWidthEvent(MICROBIT_PIN_EVT_PULSE_HI);
 
     if(status & IO_STATUS_EVENT_ON_EDGE)
-        MicroBitEvent(id, MICROBIT_PIN_EVT_FALL);
+        MicroBitEvent(id, MICROBIT_PIN_EVT_FALL, CREATE_AND_DEFER);
+
+    if(status & IO_STATUS_EVENT_CAPTURE)
+        captureEvent(0);
+
+    ((TimedInterruptIn *)pin)->edgeCount++;
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_PIN, id);
+}
+
+/**
+  * Records an edge timestamped in hardware whilst in the MICROBIT_PIN_EVENT_ON_CAPTURE mode, and
+  * signals its arrival if the buffer was empty.
+  *
+  * @param level The level of the pin after the edge.
+  */
+void MicroBitPin::captureEvent(int level)
+{
+    if (((TimedInterruptIn *)pin)->captureEdge(level) == 1)
+        MicroBitEvent(id, MICROBIT_PIN_EVT_CAPTURE, CREATE_AND_DEFER);
+}
+
+/**
+  * Periodic callback from the system timer whilst in the MICROBIT_PIN_EVENT_ON_COUNT mode. Generates
+  * a single MICROBIT_PIN_EVT_EDGE_COUNT event summarising the edges seen during the last window.
+  */
+void MicroBitPin::systemTick()
+{
+    TimedInterruptIn *p = (TimedInterruptIn *)pin;
+    uint32_t count = p->edgeCount;
+    uint32_t edges = count - p->windowCount;
+
+    if (edges == 0)
+        return;
+
+    p->windowCount = count;
+
+    // As with pulse events, the timestamp carries the measurement.
+    MicroBitEvent evt(id, MICROBIT_PIN_EVT_EDGE_COUNT, CREATE_ONLY);
+    evt.setTimestamp(edges);
+    evt.fire();
 }
 
 /**
@@ -541,10 +633,13 @@ void MicroBitPin::onFall()
   */
 int MicroBitPin::enableRiseFallEvents(int eventType)
 {
-    // if we are in neither of the two modes, configure pin as a TimedInterruptIn.
-    if (!(status & (IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE)))
+    bool created = false;
+
+    // if we are in none of the event modes, configure pin as a TimedInterruptIn.
+    if (!(status & IO_STATUS_TIMED_INTERRUPT))
     {
         disconnect();
+        created = true;
         pin = new TimedInterruptIn(name);
 
         ((TimedInterruptIn *)pin)->mode((PinMode)pullMode);
@@ -552,13 +647,70 @@ int MicroBitPin::enableRiseFallEvents(int eventType)
         ((TimedInterruptIn *)pin)->fall(this, &MicroBitPin::onFall);
     }
 
-    status &= ~(IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE);
+    if (eventType == MICROBIT_PIN_EVENT_ON_CAPTURE)
+    {
+        int result = ((TimedInterruptIn *)pin)->enableCapture();
+
+        if (result != MICROBIT_OK)
+        {
+            // Leave a pin that was already generating events as it was. Otherwise, leave it disconnected.
+            if (created)
+            {
+                delete ((TimedInterruptIn *)pin);
+                pin = NULL;
+            }
+
+            return result;
+        }
+    }
+    else if (status & IO_STATUS_EVENT_CAPTURE)
+    {
+        ((TimedInterruptIn *)pin)->disableCapture();
+        ((TimedInterruptIn *)pin)->edges.clear();
+    }
+
+    if (eventType == MICROBIT_PIN_EVENT_ON_COUNT)
+    {
+        if (!(status & IO_STATUS_EVENT_COUNT))
+        {
+            // Begin a fresh window, so that edges seen in another mode are not reported.
+            ((TimedInterruptIn *)pin)->windowCount = ((TimedInterruptIn *)pin)->edgeCount;
+
+            status |= IO_STATUS_EVENT_COUNT;
+
+            int result = setEdgeWindow(MICROBIT_PIN_DEFAULT_EDGE_WINDOW);
+
+            if (result != MICROBIT_OK)
+            {
+                status &= ~IO_STATUS_EVENT_COUNT;
+
+                if (created)
+                {
+                    delete ((TimedInterruptIn *)pin);
+                    pin = NULL;
+                }
+
+                return result;
+            }
+        }
+    }
+    else if (status & IO_STATUS_EDGE_WINDOW)
+    {
+        system_timer_remove_component(this);
+        status &= ~IO_STATUS_EDGE_WINDOW;
+    }
+
+    status &= ~IO_STATUS_TIMED_INTERRUPT;
 
     // set our status bits accordingly.
     if(eventType == MICROBIT_PIN_EVENT_ON_EDGE)
         status |= IO_STATUS_EVENT_ON_EDGE;
     else if(eventType == MICROBIT_PIN_EVENT_ON_PULSE)
         status |= IO_STATUS_EVENT_PULSE_ON_EDGE;
+    else if(eventType == MICROBIT_PIN_EVENT_ON_CAPTURE)
+        status |= IO_STATUS_EVENT_CAPTURE;
+    else if(eventType == MICROBIT_PIN_EVENT_ON_COUNT)
+        status |= IO_STATUS_EVENT_COUNT;
 
     return MICROBIT_OK;
 }
@@ -571,7 +723,7 @@ int MicroBitPin::enableRiseFallEvents(int eventType)
   */
 int MicroBitPin::disableEvents()
 {
-    if (status & (IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE | IO_STATUS_TOUCH_IN))
+    if (status & (IO_STATUS_TIMED_INTERRUPT | IO_STATUS_TOUCH_IN))
         disconnect();
 
     return MICROBIT_OK;
@@ -583,9 +735,11 @@ int MicroBitPin::disableEvents()
   * MICROBIT_PIN_EVENT_ON_EDGE - Configures this pin to a digital input, and generates events whenever a rise/fall is detected on this pin. (MICROBIT_PIN_EVT_RISE, MICROBIT_PIN_EVT_FALL)
   * MICROBIT_PIN_EVENT_ON_PULSE - Configures this pin to a digital input, and generates events where the timestamp is the duration that this pin was either HI or LO. (MICROBIT_PIN_EVT_PULSE_HI, MICROBIT_PIN_EVT_PULSE_LO)
   * MICROBIT_PIN_EVENT_ON_TOUCH - Configures this pin as a makey makey style touch sensor, in the form of a MicroBitButton. Normal button events will be generated using the ID of this pin.
+  * MICROBIT_PIN_EVENT_ON_CAPTURE - Configures this pin to a digital input, and timestamps every edge in hardware into a buffer, to be collected with readCapture(). A MICROBIT_PIN_EVT_CAPTURE event is generated whenever edges arrive in an empty buffer. Only one pin may use this mode at a time.
+  * MICROBIT_PIN_EVENT_ON_COUNT - Configures this pin to a digital input, and counts edges without generating an event for each. A single MICROBIT_PIN_EVT_EDGE_COUNT event is generated for each window in which edges were seen, where the timestamp is the number of edges in that window. See setEdgeWindow().
   * MICROBIT_PIN_EVENT_NONE - Disables events for this pin.
   *
-  * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_NONE
+  * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_ON_CAPTURE, MICROBIT_PIN_EVENT_ON_COUNT, MICROBIT_PIN_EVENT_NONE
   *
   * @code
   * MicroBitMessageBus bus;
@@ -601,7 +755,10 @@ int MicroBitPin::disableEvents()
   * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_PULSE_HI, onPulse, MESSAGE_BUS_LISTENER_IMMEDIATE)
   * @endcode
   *
-  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the given eventype does not match
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the given eventype does not match,
+  *         MICROBIT_BUSY if MICROBIT_PIN_EVENT_ON_CAPTURE is requested whilst another pin or a software PWM channel is using TIMER1,
+  *         MICROBIT_NOT_SUPPORTED if MICROBIT_PIN_EVENT_ON_CAPTURE is requested whilst MICROBIT_PIN_CAPTURE is disabled,
+  *         or MICROBIT_NO_RESOURCES if MICROBIT_PIN_EVENT_ON_COUNT is requested and the system timer has no free slots.
   *
   * @note In the MICROBIT_PIN_EVENT_ON_PULSE mode, the smallest pulse that was reliably detected was 85us, around 5khz. If more precision is required,
   *       please use the InterruptIn class supplied by ARM mbed.
@@ -615,6 +772,10 @@ int MicroBitPin::eventOn(int eventType)
             enableRiseFallEvents(eventType);
             break;
 
+        case MICROBIT_PIN_EVENT_ON_CAPTURE:
+        case MICROBIT_PIN_EVENT_ON_COUNT:
+            return enableRiseFallEvents(eventType);
+
         case MICROBIT_PIN_EVENT_ON_TOUCH:
             isTouched();
             break;
@@ -629,3 +790,115 @@ int MicroBitPin::eventOn(int eventType)
 
     return MICROBIT_OK;
 }
+
+/**
+  * Removes edges timestamped in hardware, whilst in the MICROBIT_PIN_EVENT_ON_CAPTURE mode, oldest first.
+  *
+  * @param edges The location to store the edges.
+  *
+  * @param len The maximum number of edges to read.
+  *
+  * @return The number of edges read, MICROBIT_INVALID_PARAMETER if edges is NULL or len is negative,
+  *         or MICROBIT_NOT_SUPPORTED if this pin is not in the MICROBIT_PIN_EVENT_ON_CAPTURE mode.
+  *
+  * @code
+  * TimedEdge edges[32];
+  *
+  * void onCapture(MicroBitEvent)
+  * {
+  *     int n;
+  *
+  *     while ((n = P0.readCapture(edges, 32)) > 0)
+  *         decode(edges, n);
+  * }
+  *
+  * P0.eventOn(MICROBIT_PIN_EVENT_ON_CAPTURE);
+  * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_CAPTURE, onCapture);
+  * @endcode
+  */
+int MicroBitPin::readCapture(TimedEdge *edges, int len)
+{
+    if (!(status & IO_STATUS_EVENT_CAPTURE))
+        return MICROBIT_NOT_SUPPORTED;
+
+    if (edges == NULL || len < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return ((TimedInterruptIn *)pin)->edges.pop(edges, len);
+}
+
+/**
+  * Retrieves the total number of edges seen on this pin, whilst in any of the MICROBIT_PIN_EVENT_ON_EDGE,
+  * MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_CAPTURE or MICROBIT_PIN_EVENT_ON_COUNT modes.
+  *
+  * The count is reset whenever the pin leaves these modes. It wraps at 2^31, so intervals
+  * should be measured by taking the difference between two readings.
+  *
+  * @return The number of edges seen, or MICROBIT_NOT_SUPPORTED if this pin is not in one of these modes.
+  *
+  * @code
+  * P0.eventOn(MICROBIT_PIN_EVENT_ON_COUNT);
+  * int revolutions = P0.getEdgeCount() / 2;
+  * @endcode
+  */
+int MicroBitPin::getEdgeCount()
+{
+    if (!(status & IO_STATUS_TIMED_INTERRUPT))
+        return MICROBIT_NOT_SUPPORTED;
+
+    return ((TimedInterruptIn *)pin)->edgeCount & 0x7FFFFFFF;
+}
+
+/**
+  * Sets the window over which edges are aggregated into a single MICROBIT_PIN_EVT_EDGE_COUNT event,
+  * whilst in the MICROBIT_PIN_EVENT_ON_COUNT mode. No event is generated for a window without edges.
+  *
+  * @param period The length of the window, in milliseconds. This is rounded to a multiple of the system tick
+  *               period. If 0, no events are generated, but edges are still counted.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is negative, MICROBIT_NOT_SUPPORTED if this pin
+  *         is not in the MICROBIT_PIN_EVENT_ON_COUNT mode, or MICROBIT_NO_RESOURCES if the system timer has no free slots.
+  *
+  * @code
+  * void onCount(MicroBitEvent evt)
+  * {
+  *     int edges = evt.timestamp;
+  * }
+  *
+  * P0.eventOn(MICROBIT_PIN_EVENT_ON_COUNT);
+  * P0.setEdgeWindow(1000);
+  * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_EDGE_COUNT, onCount);
+  * @endcode
+  */
+int MicroBitPin::setEdgeWindow(int period)
+{
+    if (!(status & IO_STATUS_EVENT_COUNT))
+        return MICROBIT_NOT_SUPPORTED;
+
+    if (period < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (status & IO_STATUS_EDGE_WINDOW)
+    {
+        system_timer_remove_component(this);
+        status &= ~IO_STATUS_EDGE_WINDOW;
+    }
+
+    if (period == 0)
+        return MICROBIT_OK;
+
+    int ticks = period / system_timer_get_period();
+
+    if (ticks < 1)
+        ticks = 1;
+
+    if (ticks > 0xFFFF)
+        ticks = 0xFFFF;
+
+    int result = system_timer_add_component(this, ticks);
+
+    if (result == MICROBIT_OK)
+        status |= IO_STATUS_EDGE_WINDOW;
+
+    return result;
+}
@@ -30,7 +30,13 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitDevice.h"
 #include "ErrorNo.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 #include "MicroBitBLEManager.h"
+#include "MicroBitTrace.h"
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_BLE_COEXISTENCE)
+#include "nrf_soc.h"
+#endif
 
 /**
   * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -46,9 +52,8 @@ DEALINGS IN THE SOFTWARE.
   * TODO: Meshing should also be considered - again a GLOSSY approach may be effective here, and highly complementary to
   * the master/slave arachitecture of BLE.
   *
-  * TODO: This implementation may only operated whilst the BLE stack is disabled. The nrf51822 provides a timeslot API to allow
-  * BLE to cohabit with other protocols. Future work to allow this colocation would be benefical, and would also allow for the
-  * creation of wireless BLE bridges.
+  * NOTE: By default, this implementation may only operate whilst the BLE stack is disabled. If MICROBIT_RADIO_BLE_COEXISTENCE
+  * is enabled, it instead uses the SoftDevice timeslot API to cohabit with BLE, allowing the creation of wireless BLE bridges.
   *
   * NOTE: This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
   * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
@@ -57,20 +62,54 @@ DEALINGS IN THE SOFTWARE.
 
 MicroBitRadio* MicroBitRadio::instance = NULL;
 
-extern "C" void RADIO_IRQHandler(void)
+/**
+  * Determines if the BLE stack prevents us from using the radio.
+  *
+  * @return true if the BLE stack is running and we are not configured to share the radio with it.
+  */
+static inline bool radio_blocked_by_ble()
+{
+#if CONFIG_ENABLED(MICROBIT_RADIO_BLE_COEXISTENCE)
+    return false;
+#else
+    return ble_running();
+#endif
+}
+
+/**
+  * Handles the events of the RADIO hardware module. This is called by the RADIO interrupt directly
+  * when BLE is not running, and by the SoftDevice during our timeslots when it is.
+  */
+static void radio_event_handler()
 {
     if(NRF_RADIO->EVENTS_READY)
     {
         NRF_RADIO->EVENTS_READY = 0;
 
-        // Start listening and wait for the END event
+        // Start listening (or transmitting) and wait for the END event
         NRF_RADIO->TASKS_START = 1;
     }
 
+    if(NRF_RADIO->EVENTS_DISABLED)
+    {
+        NRF_RADIO->EVENTS_DISABLED = 0;
+
+        // The transceiver has been turned off, so that it can change direction.
+        MicroBitRadio::instance->turnaroundComplete();
+    }
+
     if(NRF_RADIO->EVENTS_END)
     {
         NRF_RADIO->EVENTS_END = 0;
-        if(NRF_RADIO->CRCSTATUS == 1)
+
+        if(MicroBitRadio::instance->isTransmitting())
+        {
+            MicroBitRadio::instance->txComplete();
+            return;
+        }
+
+        // Discard packets for protocols nobody is listening for, leaving the receive buffer in place.
+        if(NRF_RADIO->CRCSTATUS == 1 && MicroBitRadio::instance->isProtocolAccepted(MicroBitRadio::instance->getRxBuf()->protocol))
         {
             int sample = (int)NRF_RADIO->RSSISAMPLE;
 
@@ -85,16 +124,108 @@ extern "C" void RADIO_IRQHandler(void)
             // Set the new buffer for DMA
             NRF_RADIO->PACKETPTR = (uint32_t) MicroBitRadio::instance->getRxBuf();
         }
-        else
+        else if(NRF_RADIO->CRCSTATUS != 1)
         {
             MicroBitRadio::instance->setRSSI(0);
+            MicroBitRadio::instance->rxCrcError();
         }
 
-        // Start listening and wait for the END event
-        NRF_RADIO->TASKS_START = 1;
+        // Start listening and wait for the END event, unless we are turning around to transmit.
+        if(MicroBitRadio::instance->isReceiving())
+            NRF_RADIO->TASKS_START = 1;
     }
 }
 
+extern "C" void RADIO_IRQHandler(void)
+{
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_RADIO, 0);
+    radio_event_handler();
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_RADIO, 0);
+}
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_BLE_COEXISTENCE)
+static volatile bool timeslotSession = false;
+static nrf_radio_request_t timeslotRequest;
+static nrf_radio_signal_callback_return_param_t timeslotAction;
+
+/**
+  * Fills in a request for the earliest timeslot the SoftDevice can grant.
+  *
+  * @return The request.
+  */
+static nrf_radio_request_t *radio_timeslot_request()
+{
+    timeslotRequest.request_type = NRF_RADIO_REQ_TYPE_EARLIEST;
+    timeslotRequest.params.earliest.hfclk = NRF_RADIO_HFCLK_CFG_FORCE_XTAL;
+    timeslotRequest.params.earliest.priority = NRF_RADIO_PRIORITY_NORMAL;
+    timeslotRequest.params.earliest.length_us = MICROBIT_RADIO_TIMESLOT_LENGTH;
+    timeslotRequest.params.earliest.timeout_us = 1000000;
+
+    return &timeslotRequest;
+}
+
+/**
+  * Called by the SoftDevice, at the highest interrupt priority, as our timeslots progress.
+  *
+  * @param signal The reason for the call, one of NRF_RADIO_CALLBACK_SIGNAL_TYPE_*.
+  *
+  * @return What the SoftDevice should do next.
+  */
+static nrf_radio_signal_callback_return_param_t *radio_timeslot_callback(uint8_t signal)
+{
+    timeslotAction.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_NONE;
+
+    // If the radio has been disabled, hand the hardware straight back.
+    if (!timeslotSession)
+    {
+        NRF_TIMER0->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk;
+        MicroBitRadio::instance->timeslotEnd();
+
+        timeslotAction.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_END;
+        return &timeslotAction;
+    }
+
+    switch (signal)
+    {
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_START:
+            // TIMER0 is started from zero by the SoftDevice. Use it to warn us shortly before the timeslot ends.
+            NRF_TIMER0->CC[0] = MICROBIT_RADIO_TIMESLOT_LENGTH - 1000;
+            NRF_TIMER0->EVENTS_COMPARE[0] = 0;
+            NRF_TIMER0->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+            NVIC_EnableIRQ(TIMER0_IRQn);
+
+            MicroBitRadio::instance->timeslotStart();
+            break;
+
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_RADIO:
+            radio_event_handler();
+            break;
+
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_TIMER0:
+            // Ask for more time, if BLE can spare it.
+            NRF_TIMER0->EVENTS_COMPARE[0] = 0;
+            timeslotAction.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_EXTEND;
+            timeslotAction.params.extend.length_us = MICROBIT_RADIO_TIMESLOT_LENGTH;
+            break;
+
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_EXTEND_SUCCEEDED:
+            NRF_TIMER0->CC[0] += MICROBIT_RADIO_TIMESLOT_LENGTH;
+            break;
+
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_EXTEND_FAILED:
+            // BLE needs the radio back. Hand it over, and ask for the next gap.
+            NRF_TIMER0->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk;
+            MicroBitRadio::instance->timeslotEnd();
+
+            timeslotAction.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_REQUEST_AND_END;
+            timeslotAction.params.request.p_next = radio_timeslot_request();
+            break;
+    }
+
+    return &timeslotAction;
+}
+#endif
+
 /**
   * Constructor.
   *
@@ -103,15 +234,39 @@ extern "C" void RADIO_IRQHandler(void)
   * @note This class is demand activated, as a result most resources are only
   *       committed if send/recv or event registrations calls are made.
   */
-MicroBitRadio::MicroBitRadio(uint16_t id) : datagram(*this), event (*this)
+MicroBitRadio::MicroBitRadio(uint16_t id) : datagram(*this), event (*this), message(*this), reliable(*this), mesh(*this)
 {
     this->id = id;
     this->status = 0;
 	this->group = MICROBIT_RADIO_DEFAULT_GROUP;
-	this->queueDepth = 0;
     this->rssi = 0;
-    this->rxQueue = NULL;
     this->rxBuf = NULL;
+    this->rxPool = NULL;
+    this->rxFree = NULL;
+    this->radioState = MICROBIT_RADIO_STATE_RECEIVING;
+    this->txQueued = 0;
+    this->txSent = 0;
+    this->txPool = NULL;
+    this->txFree = NULL;
+    this->rxQueueDepth = MICROBIT_RADIO_MAXIMUM_RX_BUFFERS;
+    this->rxOverflowCount = 0;
+    this->rxCrcErrorCount = 0;
+
+    for (int i = 0; i < 8; i++)
+        this->rxProtocols[i] = 0xFFFFFFFF;
+
+    this->dutyPeriod = 0;
+    this->dutyWindow = 0;
+    this->dutyCoordinator = false;
+    this->dutySynced = false;
+    this->dutyAwake = true;
+    this->dutyOffset = 0;
+    this->dutyLastSync = 0;
+    this->dutyLastBeacon = 0;
+    this->txPower = MICROBIT_RADIO_DEFAULT_TX_POWER;
+    this->frequencyBand = MICROBIT_RADIO_DEFAULT_FREQUENCY;
+    this->inTimeslot = false;
+    this->timeslotRequested = 0;
 
     instance = this;
 }
@@ -128,7 +283,11 @@ int MicroBitRadio::setTransmitPower(int power)
     if (power < 0 || power >= MICROBIT_BLE_POWER_LEVELS)
         return MICROBIT_INVALID_PARAMETER;
 
-    NRF_RADIO->TXPOWER = (uint32_t)MICROBIT_BLE_POWER_LEVEL[power];
+    txPower = power;
+
+    // If BLE is running, the hardware is only ours during a timeslot. Otherwise, this is applied at the start of the next one.
+    if (!ble_running() || inTimeslot)
+        NRF_RADIO->TXPOWER = (uint32_t)MICROBIT_BLE_POWER_LEVEL[power];
 
     return MICROBIT_OK;
 }
@@ -143,13 +302,16 @@ int MicroBitRadio::setTransmitPower(int power)
   */
 int MicroBitRadio::setFrequencyBand(int band)
 {
-    if (ble_running())
+    if (radio_blocked_by_ble())
         return MICROBIT_NOT_SUPPORTED;
 
     if (band < 0 || band > 100)
         return MICROBIT_INVALID_PARAMETER;
 
-    NRF_RADIO->FREQUENCY = (uint32_t)band;
+    frequencyBand = band;
+
+    if (!ble_running() || inTimeslot)
+        NRF_RADIO->FREQUENCY = (uint32_t)band;
 
     return MICROBIT_OK;
 }
@@ -168,49 +330,323 @@ FrameBuffer* MicroBitRadio::getRxBuf()
 /**
   * Attempt to queue a buffer received by the radio hardware, if sufficient space is available.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if a replacement receiver buffer
-  *         could not be allocated (either by policy or memory exhaustion).
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the receive queue is full or no
+  *         spare receive buffer is available.
+  *
+  * @note should only be called from RADIO_IRQHandler...
   */
 int MicroBitRadio::queueRxBuf()
 {
     if (rxBuf == NULL)
         return MICROBIT_INVALID_PARAMETER;
 
-    if (queueDepth >= MICROBIT_RADIO_MAXIMUM_RX_BUFFERS)
+    // Ensure that a replacement buffer is available before queuing.
+    // These come from a fixed pool, so that we never allocate memory in interrupt context.
+    FrameBuffer *newRxBuf = rxQueue.size() < rxQueueDepth ? allocRxBuf() : NULL;
+
+    if (newRxBuf == NULL)
+    {
+        rxOverflowCount++;
         return MICROBIT_NO_RESOURCES;
+    }
 
     // Store the received RSSI value in the frame
     rxBuf->rssi = getRSSI();
+    rxBuf->next = NULL;
 
-    // Ensure that a replacement buffer is available before queuing.
-    FrameBuffer *newRxBuf = new FrameBuffer();
+    // We add to the tail of the queue to preserve causal ordering.
+    rxQueue.push(rxBuf);
 
-    if (newRxBuf == NULL)
+    // Use the new buffer for the receiver hardware. the old on will be passed on to higher layer protocols/apps.
+    rxBuf = newRxBuf;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Records that the packet just received failed its CRC check, and has been discarded.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+void MicroBitRadio::rxCrcError()
+{
+    rxCrcErrorCount++;
+}
+
+/**
+  * Takes an empty buffer from the receive pool.
+  *
+  * @return The buffer, or NULL if all are in use.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+FrameBuffer* MicroBitRadio::allocRxBuf()
+{
+    FrameBuffer *b = rxFree;
+
+    if (b != NULL)
+        rxFree = b->next;
+
+    return b;
+}
+
+/**
+  * Returns a buffer to the receive pool, once it is no longer needed.
+  *
+  * @param buffer The buffer to release.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is not from the receive pool.
+  *
+  * @note This is called automatically when a buffer is deleted.
+  */
+int MicroBitRadio::releaseRxBuf(FrameBuffer *buffer)
+{
+    if (rxPool == NULL || buffer < rxPool || buffer >= rxPool + MICROBIT_RADIO_RX_POOL_SIZE(rxQueueDepth))
+        return MICROBIT_INVALID_PARAMETER;
+
+    // The interrupt handler takes from the head of the free list, so protect it whilst we add to it.
+    __disable_irq();
+
+    buffer->next = rxFree;
+    rxFree = buffer;
+
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Releases a FrameBuffer. Buffers taken from the radio's receive pool are returned to it,
+  * so that packets returned by MicroBitRadio::recv() may be deleted as any other.
+  *
+  * @param p The buffer to release.
+  */
+void FrameBuffer::operator delete(void *p)
+{
+    if (p == NULL)
+        return;
+
+    if (MicroBitRadio::instance == NULL || MicroBitRadio::instance->releaseRxBuf((FrameBuffer *)p) != MICROBIT_OK)
+        ::operator delete(p);
+}
+
+/**
+  * Releases the packets the interrupt handler has finished transmitting, raising MICROBIT_RADIO_EVT_TX_COMPLETE for each.
+  *
+  * @note should only be called from thread context.
+  */
+void MicroBitRadio::releaseTxBuffers()
+{
+    FrameBuffer *b;
+
+    while (txDone.pop(b) == MICROBIT_OK)
+    {
+        releaseTxBuf(b);
+        MicroBitEvent(id, MICROBIT_RADIO_EVT_TX_COMPLETE);
+    }
+}
+
+/**
+  * Returns a transmit buffer to the pool.
+  *
+  * @param buffer The buffer to release.
+  */
+void MicroBitRadio::releaseTxBuf(FrameBuffer *buffer)
+{
+    // Interrupt handlers may take from the pool through send(), so protect it whilst we add to it.
+    __disable_irq();
+
+    buffer->next = txFree;
+    txFree = buffer;
+
+    __enable_irq();
+}
+
+/**
+  * Queues a copy of the given packet for transmission, starting the transmitter if it is idle.
+  *
+  * @param buffer The packet contents to transmit.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the transmit queue is full.
+  */
+int MicroBitRadio::queueTxBuf(FrameBuffer *buffer)
+{
+    FrameBuffer *b;
+
+    // Events are raised as buffers are released, so leave that to thread context.
+    if (!inInterruptContext())
+        releaseTxBuffers();
+
+    // Every buffer in the pool is either free, queued or awaiting release, so the rings can never overflow.
+    __disable_irq();
+
+    b = txFree;
+    if (b != NULL)
+        txFree = b->next;
+
+    __enable_irq();
+
+    if (b == NULL)
         return MICROBIT_NO_RESOURCES;
 
-    // We add to the tail of the queue to preserve causal ordering.
-    rxBuf->next = NULL;
+    memcpy(b, buffer, sizeof(FrameBuffer));
+
+    // Label the packet with our group. The hardware filters on the address prefix, but receivers may also inspect this.
+    b->group = group;
 
-    if (rxQueue == NULL)
+    // Packets may be queued from both fibers and interrupt handlers, so protect the queue whilst we add to it.
+    // If the receiver is in use, turn it off. The interrupt handler will then start the transmitter.
+    // Otherwise, the interrupt handler will find this packet once it has finished with those before it,
+    // or we will send it when we next wake.
+    __disable_irq();
+
+    txQueue.push(b);
+    txQueued++;
+
+    if (radioState == MICROBIT_RADIO_STATE_RECEIVING)
     {
-        rxQueue = rxBuf;
+        radioState = MICROBIT_RADIO_STATE_TURNAROUND_TO_TX;
+        NRF_RADIO->TASKS_DISABLE = 1;
     }
-    else
+
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Moves on from the packet just transmitted, starting the next one queued or returning the transceiver to receive mode.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+void MicroBitRadio::txComplete()
+{
+    FrameBuffer *b;
+
+    if (txQueue.pop(b) == MICROBIT_OK)
     {
-        FrameBuffer *p = rxQueue;
-        while (p->next != NULL)
-            p = p->next;
+        txDone.push(b);
+        txSent++;
 
-        p->next = rxBuf;
+        // Have the idle task release the buffer promptly, waking any fiber waiting in send().
+        fiber_wake_idle_component(this);
     }
 
-    // Increase our received packet count
-    queueDepth++;
+    // If there's more to send, start on it straight away. The transmitter is already enabled.
+    if (txQueue.peek(b) == MICROBIT_OK)
+    {
+        NRF_RADIO->PACKETPTR = (uint32_t) b;
+        NRF_RADIO->TASKS_START = 1;
+        return;
+    }
 
-    // Allocate a new buffer for the receiver hardware to use. the old on will be passed on to higher layer protocols/apps.
-    rxBuf = newRxBuf;
+    radioState = MICROBIT_RADIO_STATE_TURNAROUND_TO_RX;
+    NRF_RADIO->TASKS_DISABLE = 1;
+}
 
-    return MICROBIT_OK;
+/**
+  * Completes a turnaround of the transceiver, once it has been disabled, by enabling it in its new direction.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+void MicroBitRadio::turnaroundComplete()
+{
+    FrameBuffer *b;
+
+    // If we have been put to sleep, stay off until woken.
+    if (radioState == MICROBIT_RADIO_STATE_SLEEPING)
+        return;
+
+    // Packets may have been queued whilst we were turning around to receive, in which case send them first.
+    if (radioState != MICROBIT_RADIO_STATE_RECEIVING && txQueue.peek(b) == MICROBIT_OK)
+    {
+        radioState = MICROBIT_RADIO_STATE_TRANSMITTING;
+        NRF_RADIO->PACKETPTR = (uint32_t) b;
+        NRF_RADIO->TASKS_TXEN = 1;
+        return;
+    }
+
+    // If our wake window ended whilst we were transmitting, go back to sleep rather than listening.
+    if (!dutyAwake)
+    {
+        radioState = MICROBIT_RADIO_STATE_SLEEPING;
+        return;
+    }
+
+    radioState = MICROBIT_RADIO_STATE_RECEIVING;
+    NRF_RADIO->PACKETPTR = (uint32_t) rxBuf;
+    NRF_RADIO->TASKS_RXEN = 1;
+}
+
+/**
+  * Turns the transceiver on at the start of a wake window, first sending any packets deferred whilst it was asleep.
+  */
+void MicroBitRadio::wake()
+{
+    FrameBuffer *b;
+
+    __disable_irq();
+
+    dutyAwake = true;
+
+    // The transceiver is already disabled, so we can enable it directly in either direction.
+    // If BLE is running, we must instead wait for the SoftDevice to grant us a timeslot.
+    if (radioState == MICROBIT_RADIO_STATE_SLEEPING && (!ble_running() || inTimeslot))
+    {
+        if (txQueue.peek(b) == MICROBIT_OK)
+        {
+            radioState = MICROBIT_RADIO_STATE_TRANSMITTING;
+            NRF_RADIO->PACKETPTR = (uint32_t) b;
+            NRF_RADIO->TASKS_TXEN = 1;
+        }
+        else
+        {
+            radioState = MICROBIT_RADIO_STATE_RECEIVING;
+            NRF_RADIO->PACKETPTR = (uint32_t) rxBuf;
+            NRF_RADIO->TASKS_RXEN = 1;
+        }
+    }
+
+    __enable_irq();
+}
+
+/**
+  * Turns the transceiver off at the end of a wake window, once any transmission in progress is complete.
+  */
+void MicroBitRadio::sleep()
+{
+    __disable_irq();
+
+    dutyAwake = false;
+
+    // If we're transmitting (or about to), the interrupt handler will put us to sleep once the transmit queue is empty.
+    if (radioState == MICROBIT_RADIO_STATE_RECEIVING)
+    {
+        radioState = MICROBIT_RADIO_STATE_SLEEPING;
+        NRF_RADIO->TASKS_DISABLE = 1;
+    }
+
+    __enable_irq();
+}
+
+/**
+  * Determines if the transceiver is transmitting the packet at the head of the transmit queue.
+  *
+  * @return true if a packet is being transmitted, false otherwise.
+  */
+bool MicroBitRadio::isTransmitting()
+{
+    return radioState == MICROBIT_RADIO_STATE_TRANSMITTING;
+}
+
+/**
+  * Determines if the transceiver is listening for packets, rather than transmitting or changing direction.
+  *
+  * @return true if the receiver is in use, false otherwise.
+  */
+bool MicroBitRadio::isReceiving()
+{
+    return radioState == MICROBIT_RADIO_STATE_RECEIVING;
 }
 
 /**
@@ -248,36 +684,81 @@ int MicroBitRadio::getRSSI()
 }
 
 /**
-  * Initialises the radio for use as a multipoint sender/receiver
+  * Sets the maximum number of received packets held awaiting processing, and so the number of receive buffers
+  * allocated. Larger queues allow bursts of packets to be received between idle ticks, at the cost of
+  * 2 * sizeof(FrameBuffer) bytes of RAM for each extra packet.
   *
-  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  * @param depth The number of packets to queue, defaults to MICROBIT_RADIO_MAXIMUM_RX_BUFFERS.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if depth is less than 1 or too large, or
+  *         MICROBIT_NOT_SUPPORTED if the radio has already been enabled, as its buffers are allocated at that point.
   */
-int MicroBitRadio::enable()
+int MicroBitRadio::setRxQueueDepth(int depth)
 {
-    // If the device is already initialised, then there's nothing to do.
-    if (status & MICROBIT_RADIO_STATUS_INITIALISED)
-        return MICROBIT_OK;
+    if (depth < 1 || depth >= MICROBIT_RING_BUFFER_MAX_CAPACITY)
+        return MICROBIT_INVALID_PARAMETER;
 
-    // Only attempt to enable this radio mode if BLE is disabled.
-    if (ble_running())
+    if (rxPool != NULL)
         return MICROBIT_NOT_SUPPORTED;
 
-    // If this is the first time we've been enable, allocate out receive buffers.
-    if (rxBuf == NULL)
-        rxBuf = new FrameBuffer();
+    rxQueueDepth = depth;
 
-    if (rxBuf == NULL)
-        return MICROBIT_NO_RESOURCES;
+    return MICROBIT_OK;
+}
 
-    // Enable the High Frequency clock on the processor. This is a pre-requisite for
-    // the RADIO module. Without this clock, no communication is possible.
-    NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
-    NRF_CLOCK->TASKS_HFCLKSTART = 1;
-    while (NRF_CLOCK->EVENTS_HFCLKSTARTED == 0);
+/**
+  * Determines the maximum number of received packets held awaiting processing.
+  *
+  * @return The receive queue depth.
+  */
+int MicroBitRadio::getRxQueueDepth()
+{
+    return rxQueueDepth;
+}
+
+/**
+  * Determines the number of received packets dropped since the radio was created, or the counters last reset,
+  * because the receive queue was full.
+  *
+  * @return The number of packets dropped.
+  */
+uint32_t MicroBitRadio::getRxOverflowCount()
+{
+    return rxOverflowCount;
+}
+
+/**
+  * Determines the number of received packets dropped since the radio was created, or the counters last reset,
+  * because they were corrupted, and failed their CRC check.
+  *
+  * @return The number of packets dropped.
+  */
+uint32_t MicroBitRadio::getRxCrcErrorCount()
+{
+    return rxCrcErrorCount;
+}
+
+/**
+  * Resets the counts of received packets dropped to zero.
+  */
+void MicroBitRadio::resetRxCounters()
+{
+    __disable_irq();
+
+    rxOverflowCount = 0;
+    rxCrcErrorCount = 0;
+
+    __enable_irq();
+}
 
+/**
+  * Writes our configuration to the RADIO hardware module.
+  */
+void MicroBitRadio::configureHardware()
+{
     // Bring up the nrf51822 RADIO module in Nordic's proprietary 1MBps packet radio mode.
-    setTransmitPower(MICROBIT_RADIO_DEFAULT_TX_POWER);
-    setFrequencyBand(MICROBIT_RADIO_DEFAULT_FREQUENCY);
+    NRF_RADIO->TXPOWER = (uint32_t)MICROBIT_BLE_POWER_LEVEL[txPower];
+    NRF_RADIO->FREQUENCY = (uint32_t)frequencyBand;
 
     // Configure for 1Mbps throughput.
     // This may sound excessive, but running a high data rates reduces the chances of collisions...
@@ -290,8 +771,8 @@ int MicroBitRadio::enable()
     // address matching for us, and only generate an interrupt when a packet matching our group is received.
     NRF_RADIO->BASE0 = MICROBIT_RADIO_BASE_ADDRESS;
 
-    // Join the default group. This will configure the remaining byte in the RADIO hardware module.
-    setGroup(this->group);
+    // Join our group. This will configure the remaining byte in the RADIO hardware module.
+    NRF_RADIO->PREFIX0 = (uint32_t)group;
 
     // The RADIO hardware module supports the use of multiple addresses, but as we're running anonymously, we only need one.
     // Configure the RADIO module to use the default address (address 0) for both send and receive operations.
@@ -320,20 +801,167 @@ int MicroBitRadio::enable()
     // Set up the RADIO module to read and write from our internal buffer.
     NRF_RADIO->PACKETPTR = (uint32_t)rxBuf;
 
-    // Configure the hardware to issue an interrupt whenever a task is complete (e.g. send/receive).
-    NRF_RADIO->INTENSET = 0x00000008;
-    NVIC_ClearPendingIRQ(RADIO_IRQn);
-    NVIC_EnableIRQ(RADIO_IRQn);
+    // Configure the hardware to issue an interrupt whenever a task is complete (e.g. send/receive),
+    // and at each step of turning the transceiver around between receive and transmit.
+    NRF_RADIO->INTENSET = RADIO_INTENSET_READY_Msk | RADIO_INTENSET_END_Msk | RADIO_INTENSET_DISABLED_Msk;
+    NRF_RADIO->SHORTS = RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
+}
+
+/**
+  * Asks the SoftDevice for a timeslot, in which to use the radio whilst BLE is running.
+  */
+void MicroBitRadio::requestTimeslot()
+{
+#if CONFIG_ENABLED(MICROBIT_RADIO_BLE_COEXISTENCE)
+    timeslotRequested = (uint32_t) system_timer_current_time();
+    sd_radio_request(radio_timeslot_request());
+#endif
+}
+
+/**
+  * Takes control of the RADIO hardware module, at the start of a timeslot granted by the SoftDevice.
+  *
+  * @note should only be called from the timeslot callback...
+  */
+void MicroBitRadio::timeslotStart()
+{
+    inTimeslot = true;
 
-    NRF_RADIO->SHORTS |= RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
+    // The SoftDevice will have configured the hardware for BLE, so restore our own configuration.
+    configureHardware();
 
-    // Start listening for the next packet
+    NRF_RADIO->EVENTS_END = 0;
+    NRF_RADIO->EVENTS_DISABLED = 0;
     NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while(NRF_RADIO->EVENTS_READY == 0);
 
+    // Send anything queued since the last timeslot, then listen, unless the duty cycle has us asleep.
+    radioState = MICROBIT_RADIO_STATE_SLEEPING;
+
+    if (dutyAwake)
+        wake();
+}
+
+/**
+  * Hands the RADIO hardware module back to the SoftDevice, at the end of a timeslot.
+  * Any packet being received is lost. Any packet being transmitted is sent again in the next timeslot.
+  *
+  * @note should only be called from the timeslot callback...
+  */
+void MicroBitRadio::timeslotEnd()
+{
+    NRF_RADIO->INTENCLR = 0xFFFFFFFF;
+    NRF_RADIO->SHORTS = 0;
+
+    NRF_RADIO->EVENTS_DISABLED = 0;
+    NRF_RADIO->TASKS_DISABLE = 1;
+    while(NRF_RADIO->EVENTS_DISABLED == 0);
+    NRF_RADIO->EVENTS_DISABLED = 0;
+
+    radioState = MICROBIT_RADIO_STATE_SLEEPING;
+    inTimeslot = false;
+    timeslotRequested = (uint32_t) system_timer_current_time();
+}
+
+/**
+  * Initialises the radio for use as a multipoint sender/receiver
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  */
+int MicroBitRadio::enable()
+{
+    // If the device is already initialised, then there's nothing to do.
+    if (status & MICROBIT_RADIO_STATUS_INITIALISED)
+        return MICROBIT_OK;
+
+    // Only attempt to enable this radio mode if BLE is disabled, or we can share the radio with it.
+    if (radio_blocked_by_ble())
+        return MICROBIT_NOT_SUPPORTED;
+
+    // If this is the first time we've been enable, allocate out receive buffers.
+    if (rxPool == NULL)
+    {
+        if (rxQueue.resize(rxQueueDepth) != MICROBIT_OK ||
+            txQueue.resize(MICROBIT_RADIO_MAXIMUM_TX_BUFFERS) != MICROBIT_OK || txDone.resize(MICROBIT_RADIO_MAXIMUM_TX_BUFFERS) != MICROBIT_OK)
+            return MICROBIT_NO_RESOURCES;
+
+        rxPool = new FrameBuffer[MICROBIT_RADIO_RX_POOL_SIZE(rxQueueDepth)];
+        txPool = new FrameBuffer[MICROBIT_RADIO_MAXIMUM_TX_BUFFERS];
+
+        if (rxPool == NULL || txPool == NULL)
+        {
+            delete[] rxPool;
+            delete[] txPool;
+            rxPool = NULL;
+            txPool = NULL;
+
+            return MICROBIT_NO_RESOURCES;
+        }
+
+        // The first buffer is given to the hardware, and the rest are held for the interrupt handler to swap in.
+        rxBuf = &rxPool[0];
+        rxFree = NULL;
+
+        for (int i = MICROBIT_RADIO_RX_POOL_SIZE(rxQueueDepth) - 1; i > 0; i--)
+        {
+            rxPool[i].next = rxFree;
+            rxFree = &rxPool[i];
+        }
+
+        // Transmit buffers are taken from a fixed pool too, so that packets can be queued from interrupt context.
+        txFree = NULL;
+
+        for (int i = MICROBIT_RADIO_MAXIMUM_TX_BUFFERS - 1; i >= 0; i--)
+        {
+            txPool[i].next = txFree;
+            txFree = &txPool[i];
+        }
+    }
+
+    txPower = MICROBIT_RADIO_DEFAULT_TX_POWER;
+    frequencyBand = MICROBIT_RADIO_DEFAULT_FREQUENCY;
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_BLE_COEXISTENCE)
+    // If BLE is running, the SoftDevice owns the radio. Ask it to lend it to us in timeslots, and start asleep until then.
+    if (ble_running())
+    {
+        if (sd_radio_session_open(radio_timeslot_callback) != NRF_SUCCESS)
+            return MICROBIT_NOT_SUPPORTED;
+
+        timeslotSession = true;
+
+        radioState = MICROBIT_RADIO_STATE_SLEEPING;
+        dutyAwake = true;
+        requestTimeslot();
+
+        fiber_add_idle_component(this);
+        status |= MICROBIT_RADIO_STATUS_INITIALISED;
+
+        return MICROBIT_OK;
+    }
+#endif
+
+    // Enable the High Frequency clock on the processor. This is a pre-requisite for
+    // the RADIO module. Without this clock, no communication is possible.
+    NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
+    NRF_CLOCK->TASKS_HFCLKSTART = 1;
+    while (NRF_CLOCK->EVENTS_HFCLKSTARTED == 0);
+
+    // Keep the clock running while the processor sleeps, so that we can receive and duty cycle on time.
+    scheduler_idle_hold();
+
+    configureHardware();
+
+    NVIC_ClearPendingIRQ(RADIO_IRQn);
+    NVIC_EnableIRQ(RADIO_IRQn);
+
+    // Start listening for the next packet. The interrupt handler starts reception once the receiver is ready.
+    // If we are duty cycling, the system timer will put us to sleep at the end of the current window.
+    radioState = MICROBIT_RADIO_STATE_RECEIVING;
+    dutyAwake = true;
     NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+    NRF_RADIO->EVENTS_DISABLED = 0;
+    NRF_RADIO->EVENTS_READY = 0;
+    NRF_RADIO->TASKS_RXEN = 1;
 
     // register ourselves for a callback event, in order to empty the receive queue.
     fiber_add_idle_component(this);
@@ -352,18 +980,53 @@ int MicroBitRadio::enable()
 int MicroBitRadio::disable()
 {
     // Only attempt to enable.disable the radio if the protocol is alreayd running.
-    if (ble_running())
+    if (radio_blocked_by_ble())
         return MICROBIT_NOT_SUPPORTED;
 
     if (!(status & MICROBIT_RADIO_STATUS_INITIALISED))
         return MICROBIT_OK;
 
-    // Disable interrupts and STOP any ongoing packet reception.
-    NVIC_DisableIRQ(RADIO_IRQn);
+#if CONFIG_ENABLED(MICROBIT_RADIO_BLE_COEXISTENCE)
+    // If we are sharing the radio with BLE, give it back to the SoftDevice for good.
+    // Any timeslot in progress is ended at its next signal, as we are no longer initialised.
+    if (ble_running())
+    {
+        status &= ~MICROBIT_RADIO_STATUS_INITIALISED;
+        timeslotSession = false;
+        sd_radio_session_close();
 
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+        while(inTimeslot);
+    }
+    else
+#endif
+    {
+        // Disable interrupts and STOP any ongoing packet reception. If we're asleep, the transceiver is already off.
+        NVIC_DisableIRQ(RADIO_IRQn);
+
+        if (radioState != MICROBIT_RADIO_STATE_SLEEPING)
+        {
+            NRF_RADIO->EVENTS_DISABLED = 0;
+            NRF_RADIO->TASKS_DISABLE = 1;
+            while(NRF_RADIO->EVENTS_DISABLED == 0);
+        }
+
+        NRF_RADIO->EVENTS_DISABLED = 0;
+
+        scheduler_idle_release();
+    }
+
+    radioState = MICROBIT_RADIO_STATE_RECEIVING;
+
+    // Discard any packets that have not yet been sent.
+    FrameBuffer *b;
+
+    while (txQueue.pop(b) == MICROBIT_OK)
+    {
+        releaseTxBuf(b);
+        txSent++;
+    }
+
+    releaseTxBuffers();
 
     // deregister ourselves from the callback event used to empty the receive queue.
     fiber_remove_idle_component(this);
@@ -383,18 +1046,152 @@ int MicroBitRadio::disable()
   */
 int MicroBitRadio::setGroup(uint8_t group)
 {
-    if (ble_running())
+    if (radio_blocked_by_ble())
         return MICROBIT_NOT_SUPPORTED;
 
     // Record our group id locally
     this->group = group;
 
     // Also append it to the address of this device, to allow the RADIO module to filter for us.
-    NRF_RADIO->PREFIX0 = (uint32_t)group;
+    if (!ble_running() || inTimeslot)
+        NRF_RADIO->PREFIX0 = (uint32_t)group;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Chooses whether packets of the given protocol are accepted by the receiver.
+  *
+  * Packets of protocols that are not accepted are discarded by the interrupt handler as they arrive,
+  * without taking a receive buffer or a place in the receive queue. All protocols are accepted by default.
+  *
+  * @param protocol The protocol number, e.g. MICROBIT_RADIO_PROTOCOL_DATAGRAM.
+  *
+  * @param accept true to receive packets of this protocol, false to discard them.
+  */
+void MicroBitRadio::acceptProtocol(uint8_t protocol, bool accept)
+{
+    if (accept)
+        rxProtocols[protocol >> 5] |= 1UL << (protocol & 31);
+    else
+        rxProtocols[protocol >> 5] &= ~(1UL << (protocol & 31));
+}
+
+/**
+  * Determines if packets of the given protocol are accepted by the receiver.
+  *
+  * @param protocol The protocol number, e.g. MICROBIT_RADIO_PROTOCOL_DATAGRAM.
+  *
+  * @return true if packets of this protocol are received, false if they are discarded.
+  */
+bool MicroBitRadio::isProtocolAccepted(uint8_t protocol)
+{
+    return (rxProtocols[protocol >> 5] >> (protocol & 31)) & 1;
+}
+
+/**
+  * Configures a synchronised duty cycle, in which the radio is only awake for a short window at the start of
+  * each period, and turned off for the rest.
+  *
+  * One device, the coordinator, broadcasts a beacon carrying its time at the start of each window. The others
+  * adopt that time, so that all devices wake together. A device that has not heard a beacon for
+  * MICROBIT_RADIO_DUTY_CYCLE_SYNC_TIMEOUT periods stays awake until it does. Packets sent whilst the radio is
+  * asleep are held until the next window. send() deschedules the calling fiber until then, but returns at once
+  * when called from interrupt context, as sendAsync() always does.
+  *
+  * @param period The length of each cycle in milliseconds, or 0 to leave the radio awake permanently.
+  *
+  * @param window The time for which the radio is awake at the start of each cycle, in milliseconds.
+  *
+  * @param coordinator true if this device should send the beacons that others synchronise to. Defaults to false.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the window does not fit within the period,
+  *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  */
+int MicroBitRadio::setDutyCycle(int period, int window, bool coordinator)
+{
+    if (radio_blocked_by_ble())
+        return MICROBIT_NOT_SUPPORTED;
+
+    if (period == 0)
+    {
+        system_timer_remove_component(this);
+        dutyPeriod = 0;
+
+        if (status & MICROBIT_RADIO_STATUS_INITIALISED)
+            wake();
+
+        return MICROBIT_OK;
+    }
+
+    if (period < 0 || period > 0xFFFF || window <= 0 || window >= period)
+        return MICROBIT_INVALID_PARAMETER;
+
+    dutyPeriod = period;
+    dutyWindow = window;
+    dutyCoordinator = coordinator;
+    dutySynced = coordinator;
+
+    // The coordinator's time is the network time.
+    if (coordinator)
+        dutyOffset = 0;
+
+    system_timer_add_component(this);
 
     return MICROBIT_OK;
 }
 
+/**
+  * Determines the time agreed by the devices in a duty cycle: that of the coordinator.
+  *
+  * @return The network time in milliseconds, or the local time if no beacon has been heard.
+  */
+uint32_t MicroBitRadio::getNetworkTime()
+{
+    return (uint32_t) system_timer_current_time() + dutyOffset;
+}
+
+/**
+  * Periodic callback from the system timer. Turns the radio on and off, at the start and end of each wake window.
+  */
+void MicroBitRadio::systemTick()
+{
+    if (dutyPeriod == 0 || !(status & MICROBIT_RADIO_STATUS_INITIALISED))
+        return;
+
+    bool awake = getNetworkTime() % dutyPeriod < dutyWindow;
+
+    // If we have lost touch with the coordinator, listen continuously until we hear from it again.
+    if (!dutyCoordinator && (!dutySynced || (uint32_t) system_timer_current_time() - dutyLastSync > (uint32_t) dutyPeriod * MICROBIT_RADIO_DUTY_CYCLE_SYNC_TIMEOUT))
+        awake = true;
+
+    if (awake && !dutyAwake)
+        wake();
+
+    if (!awake && dutyAwake)
+        sleep();
+}
+
+/**
+  * Handles a beacon, adopting the network time it carries if we are following a duty cycle.
+  */
+void MicroBitRadio::beaconReceived()
+{
+    FrameBuffer *p = recv();
+
+    if (dutyPeriod && !dutyCoordinator && p->length >= sizeof(uint32_t) + MICROBIT_RADIO_HEADER_SIZE - 1)
+    {
+        uint32_t t = p->payload[0] | (p->payload[1] << 8) | (p->payload[2] << 16) | ((uint32_t)p->payload[3] << 24);
+        uint32_t now = (uint32_t) system_timer_current_time();
+
+        dutyOffset = (int32_t)(t - now);
+        dutyLastSync = now;
+        dutySynced = true;
+    }
+
+    delete p;
+}
+
 /**
   * A background, low priority callback that is triggered whenever the processor is idle.
   * Here, we empty our queue of received packets, and pass them onto higher level protocol handlers.
@@ -402,10 +1199,10 @@ int MicroBitRadio::setGroup(uint8_t group)
 void MicroBitRadio::idleTick()
 {
     // Walk the list of packets and process each one.
-    while(rxQueue)
-    {
-        FrameBuffer *p = rxQueue;
+    FrameBuffer *p;
 
+    while(rxQueue.peek(p) == MICROBIT_OK)
+    {
         switch (p->protocol)
         {
             case MICROBIT_RADIO_PROTOCOL_DATAGRAM:
@@ -416,18 +1213,72 @@ void MicroBitRadio::idleTick()
                 event.packetReceived();
                 break;
 
+            case MICROBIT_RADIO_PROTOCOL_MESSAGE:
+                message.packetReceived();
+                break;
+
+            case MICROBIT_RADIO_PROTOCOL_RELIABLE:
+                reliable.packetReceived();
+                break;
+
+            case MICROBIT_RADIO_PROTOCOL_BEACON:
+                beaconReceived();
+                break;
+
+            case MICROBIT_RADIO_PROTOCOL_MESH:
+                mesh.packetReceived();
+                break;
+
             default:
                 MicroBitEvent(MICROBIT_ID_RADIO_DATA_READY, p->protocol);
         }
 
         // If the packet was processed, it will have been recv'd, and taken from the queue.
         // If this was a packet for an unknown protocol, it will still be there, so simply free it.
-        if (p == rxQueue)
+        FrameBuffer *head;
+
+        if (rxQueue.peek(head) == MICROBIT_OK && head == p)
         {
             recv();
             delete p;
         }
     }
+
+    // If we are coordinating a duty cycle, announce the start of each wake window.
+    if (dutyPeriod && dutyCoordinator && dutyAwake)
+    {
+        uint32_t now = getNetworkTime();
+
+        if (now / dutyPeriod != dutyLastBeacon)
+        {
+            FrameBuffer buf;
+
+            dutyLastBeacon = now / dutyPeriod;
+
+            buf.length = sizeof(uint32_t) + MICROBIT_RADIO_HEADER_SIZE - 1;
+            buf.version = 1;
+            buf.group = 0;
+            buf.protocol = MICROBIT_RADIO_PROTOCOL_BEACON;
+            buf.payload[0] = now & 0xFF;
+            buf.payload[1] = (now >> 8) & 0xFF;
+            buf.payload[2] = (now >> 16) & 0xFF;
+            buf.payload[3] = now >> 24;
+
+            sendAsync(&buf);
+        }
+    }
+
+    // Send any batched events that are due, and release any buffers the interrupt handler has transmitted.
+#if CONFIG_ENABLED(MICROBIT_RADIO_BLE_COEXISTENCE)
+    // If the SoftDevice has not granted us a timeslot in a while, our request may have been blocked or cancelled. Ask again.
+    if (ble_running() && !inTimeslot && (uint32_t) system_timer_current_time() - timeslotRequested > MICROBIT_RADIO_TIMESLOT_RETRY)
+        requestTimeslot();
+#endif
+
+    event.idleTick();
+    reliable.idleTick();
+    mesh.idleTick();
+    releaseTxBuffers();
 }
 
 /**
@@ -437,7 +1288,7 @@ void MicroBitRadio::idleTick()
   */
 int MicroBitRadio::dataReady()
 {
-    return queueDepth;
+    return rxQueue.size();
 }
 
 /**
@@ -452,19 +1303,10 @@ int MicroBitRadio::dataReady()
   */
 FrameBuffer* MicroBitRadio::recv()
 {
-    FrameBuffer *p = rxQueue;
-
-    if (p)
-    {
-         // Protect shared resource from ISR activity
-        NVIC_DisableIRQ(RADIO_IRQn); 
+    FrameBuffer *p = NULL;
 
-        rxQueue = rxQueue->next;
-        queueDepth--;
-
-        // Allow ISR access to shared resource
-        NVIC_EnableIRQ(RADIO_IRQn);
-    }
+    // The interrupt handler only ever adds to the queue, so no further protection is needed.
+    rxQueue.pop(p);
 
     return p;
 }
@@ -473,61 +1315,96 @@ FrameBuffer* MicroBitRadio::recv()
   * Transmits the given buffer onto the broadcast radio.
   * The call will wait until the transmission of the packet has completed before returning.
   *
+  * A calling fiber is descheduled whilst it waits. If called from interrupt context, the transceiver is driven
+  * directly until the packet is sent. If the duty cycle has the radio asleep, or BLE is running and no timeslot
+  * is in progress, the packet is instead left queued to be sent in the next wake window or timeslot.
+  *
   * @param data The packet contents to transmit.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the packet is invalid, MICROBIT_NO_RESOURCES
+  *         if called from interrupt context whilst the transmit queue is full, or MICROBIT_NOT_SUPPORTED if the
+  *         BLE stack is running or the radio is not enabled.
   */
 int MicroBitRadio::send(FrameBuffer *buffer)
 {
-    if (ble_running())
-        return MICROBIT_NOT_SUPPORTED;
+    int result;
+    uint16_t ticket;
 
-    if (buffer == NULL)
-        return MICROBIT_INVALID_PARAMETER;
+    if (inInterruptContext())
+    {
+        // We cannot block, so there is no waiting for space in the transmit queue.
+        result = sendAsync(buffer);
 
-    if (buffer->length > MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1)
-        return MICROBIT_INVALID_PARAMETER;
+        if (result != MICROBIT_OK)
+            return result;
 
-    // Firstly, disable the Radio interrupt. We want to wait until the trasmission completes.
-    NVIC_DisableIRQ(RADIO_IRQn);
+        ticket = txQueued;
 
-    // Turn off the transceiver.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+        // We may be masking the radio interrupt, so service its events ourselves until our packet is sent.
+        // If the duty cycle has the radio asleep, the packet is left queued to be sent at the start of the next window.
+        // If BLE is running, the SoftDevice services the radio for us, above our priority, but only during a timeslot.
+        // Outside one the radio is asleep, so the packet is likewise left queued for the next timeslot.
+        while ((int16_t)(txSent - ticket) < 0 && radioState != MICROBIT_RADIO_STATE_SLEEPING)
+        {
+            if (!ble_running() && NVIC_GetPendingIRQ(RADIO_IRQn))
+            {
+                NVIC_ClearPendingIRQ(RADIO_IRQn);
+                radio_event_handler();
+            }
+        }
 
-    // Configure the radio to send the buffer provided.
-    NRF_RADIO->PACKETPTR = (uint32_t) buffer;
+        return MICROBIT_OK;
+    }
 
-    // Turn on the transmitter, and wait for it to signal that it's ready to use.
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_TXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0);
+    // Wait for space in the transmit queue, if others have filled it.
+    while ((result = sendAsync(buffer)) == MICROBIT_NO_RESOURCES && !txQueue.isEmpty())
+        waitForTxComplete();
 
-    // Start transmission and wait for end of packet.
-    NRF_RADIO->TASKS_START = 1;
-    NRF_RADIO->EVENTS_END = 0;
-    while(NRF_RADIO->EVENTS_END == 0);
+    if (result != MICROBIT_OK)
+        return result;
 
-    // Return the radio to using the default receive buffer
-    NRF_RADIO->PACKETPTR = (uint32_t) rxBuf;
+    // Then wait for our packet to be sent.
+    ticket = txQueued;
 
-    // Turn off the transmitter.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+    while ((int16_t)(txSent - ticket) < 0)
+        waitForTxComplete();
 
-    // Start listening for the next packet
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while(NRF_RADIO->EVENTS_READY == 0);
+    return MICROBIT_OK;
+}
 
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+/**
+  * Deschedules the calling fiber until the next MICROBIT_RADIO_EVT_TX_COMPLETE event.
+  *
+  * If the scheduler is not running, releases any packets already transmitted instead, so that the caller can poll.
+  */
+void MicroBitRadio::waitForTxComplete()
+{
+    if (fiber_wait_for_event(id, MICROBIT_RADIO_EVT_TX_COMPLETE) != MICROBIT_OK)
+        releaseTxBuffers();
+}
 
-    // Re-enable the Radio interrupt.
-    NVIC_ClearPendingIRQ(RADIO_IRQn);
-    NVIC_EnableIRQ(RADIO_IRQn);
+/**
+  * Queues the given buffer for transmission onto the broadcast radio, and returns immediately.
+  *
+  * A copy of the packet is taken, so the buffer may be reused as soon as this call returns.
+  * Packets are sent in the order queued. A MICROBIT_RADIO_EVT_TX_COMPLETE event is raised as each is sent.
+  *
+  * @param data The packet contents to transmit.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the packet is invalid, MICROBIT_NO_RESOURCES
+  *         if MICROBIT_RADIO_MAXIMUM_TX_BUFFERS packets are already queued or no memory is available, or
+  *         MICROBIT_NOT_SUPPORTED if the BLE stack is running or the radio is not enabled.
+  */
+int MicroBitRadio::sendAsync(FrameBuffer *buffer)
+{
+    if (radio_blocked_by_ble() || !(status & MICROBIT_RADIO_STATUS_INITIALISED))
+        return MICROBIT_NOT_SUPPORTED;
 
-    return MICROBIT_OK;
+    if (buffer == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (buffer->length > MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return queueTxBuf(buffer);
 }
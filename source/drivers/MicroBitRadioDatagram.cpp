@@ -49,6 +49,8 @@ DEALINGS IN THE SOFTWARE.
 MicroBitRadioDatagram::MicroBitRadioDatagram(MicroBitRadio &r) : radio(r)
 {
     this->rxQueue = NULL;
+    this->rxTail = NULL;
+    this->queueDepth = 0;
 }
 
 /**
@@ -71,6 +73,7 @@ int MicroBitRadioDatagram::recv(uint8_t *buf, int len)
     // Take the first buffer from the queue.
     FrameBuffer *p = rxQueue;
     rxQueue = rxQueue->next;
+    queueDepth--;
 
     int l = min(len, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1));
 
@@ -96,6 +99,7 @@ PacketBuffer MicroBitRadioDatagram::recv()
 
     FrameBuffer *p = rxQueue;
     rxQueue = rxQueue->next;
+    queueDepth--;
 
     PacketBuffer packet(p->payload, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1), p->rssi);
 
@@ -103,6 +107,27 @@ PacketBuffer MicroBitRadioDatagram::recv()
     return packet;
 }
 
+/**
+  * Takes the next packet from the receive queue, without copying it.
+  *
+  * The payload is held in the packet's payload field, and is length - (MICROBIT_RADIO_HEADER_SIZE - 1) bytes long.
+  * The caller owns the packet, and must delete it once finished with it. This returns it to the radio's receive pool.
+  *
+  * @return the packet, or NULL if none is available.
+  */
+FrameBuffer *MicroBitRadioDatagram::recvFrame()
+{
+    FrameBuffer *p = rxQueue;
+
+    if (p != NULL)
+    {
+        rxQueue = rxQueue->next;
+        queueDepth--;
+    }
+
+    return p;
+}
+
 /**
   * Transmits the given buffer onto the broadcast radio.
   *
@@ -148,6 +173,52 @@ int MicroBitRadioDatagram::send(PacketBuffer data)
     return send((uint8_t *)data.getBytes(), data.length());
 }
 
+/**
+  * Transmits the concatenation of the given buffers onto the broadcast radio, as a single packet.
+  *
+  * Each part is copied straight into the radio frame, so a packet built from separate headers and payloads
+  * need never be joined into one buffer first.
+  *
+  * This is a synchronous call that will wait until the transmission of the packet
+  * has completed before returning.
+  *
+  * @param parts The buffers to transmit, in order.
+  *
+  * @param count The number of buffers.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if parts is NULL,
+  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+  *
+  * @code
+  * PacketBuffer parts[2] = { header, body };
+  * radio.datagram.send(parts, 2);
+  * @endcode
+  */
+int MicroBitRadioDatagram::send(PacketBuffer *parts, int count)
+{
+    if (parts == NULL || count < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    FrameBuffer buf;
+    int len = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (len + parts[i].length() > MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1)
+            return MICROBIT_INVALID_PARAMETER;
+
+        memcpy(buf.payload + len, parts[i].getBytes(), parts[i].length());
+        len += parts[i].length();
+    }
+
+    buf.length = len + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf.version = 1;
+    buf.group = 0;
+    buf.protocol = MICROBIT_RADIO_PROTOCOL_DATAGRAM;
+
+    return radio.send(&buf);
+}
+
 /**
   * Transmits the given string onto the broadcast radio.
   *
@@ -172,32 +243,23 @@ int MicroBitRadioDatagram::send(ManagedString data)
 void MicroBitRadioDatagram::packetReceived()
 {
     FrameBuffer *packet = radio.recv();
-    int queueDepth = 0;
+
+    if (queueDepth >= radio.getRxQueueDepth())
+    {
+        delete packet;
+        return;
+    }
 
     // We add to the tail of the queue to preserve causal ordering.
     packet->next = NULL;
 
     if (rxQueue == NULL)
-    {
         rxQueue = packet;
-    }
     else
-    {
-        FrameBuffer *p = rxQueue;
-        while (p->next != NULL)
-        {
-            p = p->next;
-            queueDepth++;
-        }
-
-        if (queueDepth >= MICROBIT_RADIO_MAXIMUM_RX_BUFFERS)
-        {
-            delete packet;
-            return;
-        }
-
-        p->next = packet;
-    }
+        rxTail->next = packet;
+
+    rxTail = packet;
+    queueDepth++;
 
     MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM);
 }
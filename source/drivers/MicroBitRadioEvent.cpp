@@ -25,6 +25,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 #include "MicroBitRadio.h"
+#include "MicroBitSystemTimer.h"
 
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -51,6 +52,9 @@ DEALINGS IN THE SOFTWARE.
 MicroBitRadioEvent::MicroBitRadioEvent(MicroBitRadio &r) : radio(r)
 {
     this->suppressForwarding = false;
+    this->batchCount = 0;
+    this->batchDelay = 0;
+    this->batchStart = 0;
 }
 
 /**
@@ -144,10 +148,33 @@ int MicroBitRadioEvent::ignore(uint16_t id, uint16_t value, EventModel &eventBus
 void MicroBitRadioEvent::packetReceived()
 {
     FrameBuffer *p = radio.recv();
-    MicroBitEvent *e = (MicroBitEvent *) p->payload;
 
     suppressForwarding = true;
-    e->fire();
+
+    if (p->version == MICROBIT_RADIO_EVENT_VERSION_BATCH)
+    {
+        uint16_t *data = (uint16_t *) p->payload;
+        int count = (p->length - (MICROBIT_RADIO_HEADER_SIZE - 1)) / (2 * sizeof(uint16_t));
+
+        for (int i = 0; i < count; i++)
+            MicroBitEvent(data[2*i], data[2*i+1]);
+    }
+    else
+    {
+        // The sender's event layout depends on its MICROBIT_EVENT_TIMESTAMP_BITS, so decode by length.
+        // Events without a timestamp we can use carry the time at which they were received.
+        uint16_t *data = (uint16_t *) p->payload;
+        int length = p->length - (MICROBIT_RADIO_HEADER_SIZE - 1);
+        MicroBitEvent e(data[0], data[1], CREATE_ONLY);
+
+        if (length >= 16)
+            e.setTimestamp(*(uint64_t *)&p->payload[8]);
+        else if (length >= 8)
+            e.setTimestamp(*(uint32_t *)&p->payload[4]);
+
+        e.fire();
+    }
+
     suppressForwarding = false;
 
     delete p;
@@ -165,11 +192,139 @@ void MicroBitRadioEvent::eventReceived(MicroBitEvent e)
 
     FrameBuffer buf;
 
+    if (batchDelay)
+    {
+        int count = 0;
+
+        // Events may be raised from interrupt context, so protect the batch whilst we add to it.
+        // If that fills it, take a copy to send, so that new events can be gathered whilst it is sent.
+        __disable_irq();
+
+        if (batchCount == 0)
+            batchStart = (uint32_t) system_timer_current_time();
+
+        batch[2*batchCount] = e.source;
+        batch[2*batchCount+1] = e.value;
+        batchCount++;
+
+        if (batchCount >= MICROBIT_RADIO_EVENT_BATCH_SIZE)
+        {
+            count = batchCount;
+            memcpy(buf.payload, batch, count * 2 * sizeof(uint16_t));
+            batchCount = 0;
+        }
+
+        __enable_irq();
+
+        if (count)
+            sendBatch(&buf, count);
+
+        return;
+    }
+
     buf.length = sizeof(MicroBitEvent) + MICROBIT_RADIO_HEADER_SIZE - 1;
-    buf.version = 1;
+    buf.version = MICROBIT_RADIO_EVENT_VERSION_SINGLE;
     buf.group = 0;
     buf.protocol = MICROBIT_RADIO_PROTOCOL_EVENTBUS;
     memcpy(buf.payload, (const uint8_t *)&e, sizeof(MicroBitEvent));
 
     radio.send(&buf);
 }
+
+/**
+  * Enables or disables batching of the events forwarded onto the radio.
+  *
+  * When enabled, up to MICROBIT_RADIO_EVENT_BATCH_SIZE events are gathered into each packet, which is sent
+  * once it is full, or once the first event in it has waited for the given time. This greatly reduces the
+  * airtime and time spent sending bursts of events, at the cost of some latency, and of the sender's timestamps.
+  * Batched packets are understood by any micro:bit running this version or newer.
+  *
+  * @param delay The longest time an event may wait to be sent, in milliseconds, or 0 to send each event at once.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if delay is out of range.
+  */
+int MicroBitRadioEvent::setBatching(int delay)
+{
+    if (delay < 0 || delay > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    batchDelay = delay;
+
+    if (delay == 0)
+        flush();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Sends any events waiting in the batch immediately.
+  *
+  * @return MICROBIT_OK on success, or an error code from MicroBitRadio::sendAsync().
+  */
+int MicroBitRadioEvent::flush()
+{
+    FrameBuffer buf;
+
+    // Take a copy of the batch, so that new events can be gathered whilst it is sent.
+    __disable_irq();
+
+    int count = batchCount;
+    uint32_t start = batchStart;
+
+    memcpy(buf.payload, batch, count * 2 * sizeof(uint16_t));
+    batchCount = 0;
+
+    __enable_irq();
+
+    if (count == 0)
+        return MICROBIT_OK;
+
+    int result = sendBatch(&buf, count);
+
+    // If the transmit queue is full, put the events back ahead of any gathered since, to be retried on the next idle pass.
+    if (result == MICROBIT_NO_RESOURCES)
+    {
+        __disable_irq();
+
+        if (batchCount + count <= MICROBIT_RADIO_EVENT_BATCH_SIZE)
+        {
+            memmove(&batch[2*count], batch, batchCount * 2 * sizeof(uint16_t));
+            memcpy(batch, buf.payload, count * 2 * sizeof(uint16_t));
+            batchCount += count;
+            batchStart = start;
+        }
+
+        __enable_irq();
+    }
+
+    return result;
+}
+
+/**
+  * Transmits a batched packet of events.
+  *
+  * @param buf The packet to send, with the (source, value) pairs of the events already in its payload.
+  *
+  * @param count The number of events in the packet.
+  *
+  * @return MICROBIT_OK on success, or an error code from MicroBitRadio::sendAsync().
+  */
+int MicroBitRadioEvent::sendBatch(FrameBuffer *buf, int count)
+{
+    buf->length = count * 2 * sizeof(uint16_t) + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf->version = MICROBIT_RADIO_EVENT_VERSION_BATCH;
+    buf->group = 0;
+    buf->protocol = MICROBIT_RADIO_PROTOCOL_EVENTBUS;
+
+    // Batches are flushed from the idle task and from event handlers, neither of which may block, so just queue the packet.
+    return radio.sendAsync(buf);
+}
+
+/**
+  * Called by the radio whenever the processor is idle. Sends the batch once its delay has expired.
+  */
+void MicroBitRadioEvent::idleTick()
+{
+    if (batchCount && (uint32_t) system_timer_current_time() - batchStart >= batchDelay)
+        flush();
+}
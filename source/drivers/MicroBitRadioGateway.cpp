@@ -0,0 +1,241 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitRadioGateway.h"
+#include "EventModel.h"
+#include "NotifyEvents.h"
+
+/**
+  * Constructor.
+  *
+  * Creates a gateway that forwards datagrams received by the given radio over a serial line.
+  *
+  * @param r The radio from which datagrams are forwarded.
+  *
+  * @param s The serial line to which datagrams are forwarded.
+  */
+MicroBitRadioGateway::MicroBitRadioGateway(MicroBitRadio &r, MicroBitSerial &s) : radio(r)
+{
+    this->serial = &s;
+    this->uart = NULL;
+    this->txFrame = NULL;
+    this->txLength = 0;
+    this->running = false;
+}
+
+/**
+  * Constructor.
+  *
+  * Creates a gateway that forwards datagrams received by the given radio over the Bluetooth UART service.
+  *
+  * @param r The radio from which datagrams are forwarded.
+  *
+  * @param u The Bluetooth UART service to which datagrams are forwarded.
+  */
+MicroBitRadioGateway::MicroBitRadioGateway(MicroBitRadio &r, MicroBitUARTService &u) : radio(r)
+{
+    this->serial = NULL;
+    this->uart = &u;
+    this->txFrame = NULL;
+    this->txLength = 0;
+    this->running = false;
+}
+
+/**
+  * Destructor.
+  *
+  * Stops forwarding. A frame still being sent over serial keeps the gateway's receive buffer until
+  * it completes, so the gateway must not be destroyed until then.
+  */
+MicroBitRadioGateway::~MicroBitRadioGateway()
+{
+    stop();
+}
+
+/**
+  * Starts forwarding datagrams, including any already waiting to be received.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if there is no default event bus.
+  *
+  * @note Whilst started, the gateway receives every datagram. Calls to radio.datagram.recv() will find none.
+  */
+int MicroBitRadioGateway::start()
+{
+    if (EventModel::defaultEventBus == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    if (!running)
+    {
+        EventModel::defaultEventBus->listen(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, this, &MicroBitRadioGateway::onDatagram);
+
+        if (uart)
+            EventModel::defaultEventBus->listen(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY, this, &MicroBitRadioGateway::onUARTEmpty);
+
+        running = true;
+    }
+
+    forward();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops forwarding datagrams. Any frame already being sent is completed.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitRadioGateway::stop()
+{
+    if (!running)
+        return MICROBIT_OK;
+
+    running = false;
+
+    if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->ignore(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, this, &MicroBitRadioGateway::onDatagram);
+
+        if (uart)
+            EventModel::defaultEventBus->ignore(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY, this, &MicroBitRadioGateway::onUARTEmpty);
+    }
+
+    // A frame waiting for room in the Bluetooth UART will never now be sent.
+    if (uart && txFrame)
+    {
+        delete txFrame;
+        txFrame = NULL;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Event handler, called when the radio receives a datagram.
+  */
+void MicroBitRadioGateway::onDatagram(MicroBitEvent)
+{
+    forward();
+}
+
+/**
+  * Event handler, called when the Bluetooth UART has sent everything queued.
+  */
+void MicroBitRadioGateway::onUARTEmpty(MicroBitEvent)
+{
+    forward();
+}
+
+/**
+  * Forwards waiting datagrams for as long as the host link can accept them.
+  */
+void MicroBitRadioGateway::forward()
+{
+    while (running)
+    {
+        // Over serial, txFrame is in flight. Over Bluetooth, it is waiting for room in the UART's transmit queue.
+        if (txFrame == NULL)
+        {
+            txFrame = radio.datagram.recvFrame();
+
+            if (txFrame == NULL)
+                return;
+
+            txLength = frame(txFrame);
+        }
+        else if (serial)
+        {
+            return;
+        }
+
+        if (serial)
+        {
+            // The serial line hands the buffer back through txComplete(), once it has been sent.
+            if (serial->send((uint8_t *)txFrame, txLength, MicroBitRadioGateway::txComplete, this, ASYNC) < 0)
+            {
+                // Another fiber is sending in place. We can't wait in an event handler, so this datagram is lost.
+                delete txFrame;
+                txFrame = NULL;
+            }
+
+            return;
+        }
+
+        if (uart->txBufferFree() < txLength)
+        {
+            // Wait for the UART to drain, unless this frame could never fit.
+            if (uart->txBufferedSize() > 0)
+                return;
+        }
+        else
+        {
+            // If there is no connection, the datagram is simply discarded.
+            uart->send((uint8_t *)txFrame, txLength, ASYNC);
+        }
+
+        delete txFrame;
+        txFrame = NULL;
+    }
+}
+
+/**
+  * Called from the idle task once the serial line has sent txFrame.
+  *
+  * @param gateway The gateway whose frame has been sent.
+  */
+void MicroBitRadioGateway::txComplete(void *gateway)
+{
+    MicroBitRadioGateway *g = (MicroBitRadioGateway *)gateway;
+
+    // Returns the buffer to the radio's receive pool.
+    delete g->txFrame;
+    g->txFrame = NULL;
+
+    g->forward();
+}
+
+/**
+  * Writes the gateway frame header over the radio header of the given datagram.
+  *
+  * @param p The datagram.
+  *
+  * @return The length of the frame, starting at the first byte of p, in bytes.
+  */
+int MicroBitRadioGateway::frame(FrameBuffer *p)
+{
+    int len = p->length - (MICROBIT_RADIO_HEADER_SIZE - 1);
+    uint8_t *header = (uint8_t *)p;
+
+    // The header fields are read before any is overwritten, as they share the same bytes.
+    uint8_t group = p->group;
+    int8_t rssi = (int8_t) p->rssi;
+
+    header[0] = MICROBIT_RADIO_GATEWAY_SYNC;
+    header[1] = len;
+    header[2] = group;
+    header[3] = (uint8_t) rssi;
+
+    return MICROBIT_RADIO_HEADER_SIZE + len;
+}
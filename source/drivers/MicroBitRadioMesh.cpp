@@ -0,0 +1,271 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "MicroBitDevice.h"
+#include "MicroBitSystemTimer.h"
+
+/**
+ * Provides a simple flooding mesh, in which every micro:bit rebroadcasts the packets it hears, so that they reach
+ * devices beyond the range of the originator.
+ *
+ * Each packet carries its originator's address and a message id, which together identify it. Each micro:bit
+ * remembers the last MICROBIT_RADIO_MESH_HISTORY_SIZE packets it has seen, and ignores any repeats. Packets are
+ * rebroadcast until their time to live (TTL) is exhausted. To make collisions between relays less likely, each waits
+ * a random time before rebroadcasting; with no delay, relays rebroadcast as soon as they have processed a packet,
+ * which keeps the copies closely synchronised.
+ *
+ * Every packet is also delivered locally, exactly once, so a gateway simply receives from the mesh.
+ */
+
+/**
+  * Constructor.
+  *
+  * Creates an instance of a MicroBitRadioMesh, which offers the ability to
+  * send packets beyond the range of a single micro:bit.
+  *
+  * @param r The underlying radio module used to send and receive data.
+  */
+MicroBitRadioMesh::MicroBitRadioMesh(MicroBitRadio &r) : radio(r)
+{
+    this->txId = 0;
+    this->relay = true;
+    this->jitter = MICROBIT_RADIO_MESH_DEFAULT_JITTER;
+    this->historyNext = 0;
+    this->historyLength = 0;
+
+    for (int i = 0; i < MICROBIT_RADIO_MESH_RELAY_SLOTS; i++)
+        this->relayQueue[i] = NULL;
+
+    this->rxQueue = NULL;
+    this->rxTail = NULL;
+    this->rxQueueLength = 0;
+}
+
+/**
+  * Records that we've seen the given packet.
+  *
+  * @param origin The address of the packet's originator.
+  *
+  * @param id The packet's message id.
+  *
+  * @return true if the packet had already been seen, false otherwise.
+  */
+bool MicroBitRadioMesh::seen(uint16_t origin, uint8_t id)
+{
+    uint32_t key = ((uint32_t)origin << 8) | id;
+
+    for (int i = 0; i < historyLength; i++)
+        if (history[i] == key)
+            return true;
+
+    history[historyNext] = key;
+    historyNext = (historyNext + 1) % MICROBIT_RADIO_MESH_HISTORY_SIZE;
+
+    if (historyLength < MICROBIT_RADIO_MESH_HISTORY_SIZE)
+        historyLength++;
+
+    return false;
+}
+
+/**
+  * Sends the given data to every micro:bit in the mesh.
+  *
+  * @param buffer The data to send.
+  *
+  * @param len The number of bytes to send.
+  *
+  * @param ttl The number of times the packet may be rebroadcast. Defaults to MICROBIT_RADIO_MESH_DEFAULT_TTL.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes
+  *         to send is greater than MICROBIT_RADIO_MESH_MAX_PAYLOAD, or an error code from MicroBitRadio::send().
+  */
+int MicroBitRadioMesh::send(uint8_t *buffer, int len, int ttl)
+{
+    if (buffer == NULL || len < 0 || len > MICROBIT_RADIO_MESH_MAX_PAYLOAD || ttl < 0 || ttl > 255)
+        return MICROBIT_INVALID_PARAMETER;
+
+    FrameBuffer buf;
+    uint16_t address = MicroBitRadioReliable::getAddress();
+    uint8_t id = txId++;
+
+    // Remember our own packet, so that we ignore it when our neighbours rebroadcast it.
+    seen(address, id);
+
+    buf.length = len + MICROBIT_RADIO_MESH_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf.version = 1;
+    buf.group = 0;
+    buf.protocol = MICROBIT_RADIO_PROTOCOL_MESH;
+    buf.payload[0] = address & 0xFF;
+    buf.payload[1] = address >> 8;
+    buf.payload[2] = id;
+    buf.payload[3] = ttl;
+    memcpy(buf.payload + MICROBIT_RADIO_MESH_HEADER_SIZE, buffer, len);
+
+    return radio.send(&buf);
+}
+
+/**
+  * Sends the given data to every micro:bit in the mesh.
+  *
+  * @param data The data to send.
+  *
+  * @param ttl The number of times the packet may be rebroadcast. Defaults to MICROBIT_RADIO_MESH_DEFAULT_TTL.
+  *
+  * @return MICROBIT_OK on success, or an error code as for send(uint8_t *, int, int).
+  */
+int MicroBitRadioMesh::send(PacketBuffer data, int ttl)
+{
+    return send(data.getBytes(), data.length(), ttl);
+}
+
+/**
+  * Retrieves the oldest packet received from the mesh.
+  *
+  * @param origin If not NULL, set to the address of the micro:bit that originated the packet.
+  *
+  * @return The data received, or an empty PacketBuffer if no data is available.
+  */
+PacketBuffer MicroBitRadioMesh::recv(uint16_t *origin)
+{
+    if (rxQueue == NULL)
+        return PacketBuffer::EmptyPacket;
+
+    FrameBuffer *p = rxQueue;
+    rxQueue = rxQueue->next;
+    rxQueueLength--;
+
+    if (origin != NULL)
+        *origin = p->payload[0] | (p->payload[1] << 8);
+
+    PacketBuffer packet(p->payload + MICROBIT_RADIO_MESH_HEADER_SIZE, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1) - MICROBIT_RADIO_MESH_HEADER_SIZE, p->rssi);
+
+    delete p;
+    return packet;
+}
+
+/**
+  * Chooses whether we rebroadcast the packets of others. Relaying is enabled by default.
+  *
+  * @param enable true to rebroadcast packets, false to only send and receive them.
+  *
+  * @param jitter The upper bound of the random delay before each packet is rebroadcast, in milliseconds,
+  *        or 0 to rebroadcast as soon as possible. Defaults to MICROBIT_RADIO_MESH_DEFAULT_JITTER.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if jitter is out of range.
+  */
+int MicroBitRadioMesh::setRelay(bool enable, int jitter)
+{
+    if (jitter < 0 || jitter > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    this->relay = enable;
+    this->jitter = jitter;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Protocol handler callback. This is called when the radio receives a packet marked as using the mesh protocol.
+  */
+void MicroBitRadioMesh::packetReceived()
+{
+    FrameBuffer *p = radio.recv();
+
+    if (p->length < MICROBIT_RADIO_MESH_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1 || seen(p->payload[0] | (p->payload[1] << 8), p->payload[2]))
+    {
+        delete p;
+        return;
+    }
+
+    // Pass the packet on, if it has hops to spare and there's room to hold it. Otherwise, our neighbours will have to do without.
+    if (relay && p->payload[3] > 0)
+    {
+        for (int i = 0; i < MICROBIT_RADIO_MESH_RELAY_SLOTS; i++)
+        {
+            if (relayQueue[i] == NULL)
+            {
+                FrameBuffer *f = new FrameBuffer();
+
+                if (f != NULL)
+                {
+                    memcpy(f, p, sizeof(FrameBuffer));
+                    f->payload[3]--;
+
+                    relayQueue[i] = f;
+                    relayTime[i] = (uint32_t) system_timer_current_time() + (jitter ? microbit_random(jitter + 1) : 0);
+                }
+
+                break;
+            }
+        }
+    }
+
+    // Then deliver a copy locally, leaving the receive buffer free for the radio.
+    FrameBuffer *f = rxQueueLength < radio.getRxQueueDepth() ? new FrameBuffer() : NULL;
+
+    if (f != NULL)
+    {
+        memcpy(f, p, sizeof(FrameBuffer));
+        f->next = NULL;
+
+        if (rxQueue == NULL)
+            rxQueue = f;
+        else
+            rxTail->next = f;
+
+        rxTail = f;
+        rxQueueLength++;
+
+        MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_MESH);
+    }
+
+    delete p;
+
+    // Rebroadcast straight away if we can, rather than waiting for the next idle tick.
+    idleTick();
+}
+
+/**
+  * Called by the radio whenever the processor is idle. Rebroadcasts any packets that are due.
+  */
+void MicroBitRadioMesh::idleTick()
+{
+    uint32_t now = (uint32_t) system_timer_current_time();
+
+    for (int i = 0; i < MICROBIT_RADIO_MESH_RELAY_SLOTS; i++)
+    {
+        if (relayQueue[i] != NULL && (int32_t)(now - relayTime[i]) >= 0)
+        {
+            // If the transmit queue is full, try again next time.
+            if (radio.sendAsync(relayQueue[i]) == MICROBIT_OK)
+            {
+                delete relayQueue[i];
+                relayQueue[i] = NULL;
+            }
+        }
+    }
+}
@@ -0,0 +1,225 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "MicroBitDevice.h"
+
+/**
+ * Provides the ability to send messages larger than a single radio packet.
+ *
+ * Each message is split into a sequence of fragments, which are reassembled by the receiver into a single PacketBuffer.
+ * A MICROBIT_RADIO_EVT_MESSAGE event is raised once a message is complete. Messages that are missing fragments are
+ * discarded: as with MicroBitRadioDatagram, delivery is not guaranteed.
+ *
+ * Only one message is reassembled at a time, in a buffer of MICROBIT_RADIO_MESSAGE_MAX_SIZE bytes allocated
+ * when the first fragment arrives. Fragments of a new message, from this or any other sender, abandon a partial one.
+ */
+
+/**
+  * Constructor.
+  *
+  * Creates an instance of a MicroBitRadioMessage which offers the ability
+  * to broadcast messages larger than a single packet to other micro:bits in the vicinity.
+  *
+  * @param r The underlying radio module used to send and receive data.
+  */
+MicroBitRadioMessage::MicroBitRadioMessage(MicroBitRadio &r) : radio(r)
+{
+    this->txSeq = 0;
+    this->rxBuffer = NULL;
+    this->rxActive = false;
+    this->rxQueueHead = 0;
+    this->rxQueueLength = 0;
+}
+
+/**
+  * Retrieves the oldest complete message received.
+  *
+  * @return the message received, or an empty PacketBuffer if no message is available.
+  */
+PacketBuffer MicroBitRadioMessage::recv()
+{
+    if (rxQueueLength == 0)
+        return PacketBuffer::EmptyPacket;
+
+    PacketBuffer message = rxQueue[rxQueueHead];
+
+    // Release our reference, so the message is freed once the caller is done with it.
+    rxQueue[rxQueueHead] = PacketBuffer::EmptyPacket;
+    rxQueueHead = (rxQueueHead + 1) % MICROBIT_RADIO_MESSAGE_QUEUE_SIZE;
+    rxQueueLength--;
+
+    return message;
+}
+
+/**
+  * Transmits the given buffer onto the broadcast radio, as a sequence of fragments.
+  *
+  * The call returns once every fragment has been queued for transmission.
+  *
+  * @param buffer The message contents to transmit.
+  *
+  * @param len The number of bytes to transmit.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes
+  *         to transmit is greater than MICROBIT_RADIO_MESSAGE_MAX_SIZE, or an error code from MicroBitRadio::send().
+  */
+int MicroBitRadioMessage::send(uint8_t *buffer, int len)
+{
+    if (buffer == NULL || len < 0 || len > MICROBIT_RADIO_MESSAGE_MAX_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint16_t sender = (uint16_t) microbit_serial_number();
+    uint8_t seq = txSeq++;
+    int index = 0;
+    int offset = 0;
+
+    do
+    {
+        FrameBuffer buf;
+        int l = min(len - offset, MICROBIT_RADIO_MESSAGE_FRAGMENT_SIZE);
+        bool last = offset + l >= len;
+
+        buf.length = l + MICROBIT_RADIO_MESSAGE_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+        buf.version = 1;
+        buf.group = 0;
+        buf.protocol = MICROBIT_RADIO_PROTOCOL_MESSAGE;
+        buf.payload[0] = sender & 0xFF;
+        buf.payload[1] = sender >> 8;
+        buf.payload[2] = seq;
+        buf.payload[3] = index | (last ? MICROBIT_RADIO_MESSAGE_LAST_FRAGMENT : 0);
+        memcpy(buf.payload + MICROBIT_RADIO_MESSAGE_HEADER_SIZE, buffer + offset, l);
+
+        // Queue fragments back to back where we can. Once the transmit queue is full, send() waits for it to drain.
+        int result = radio.sendAsync(&buf);
+
+        if (result == MICROBIT_NO_RESOURCES)
+            result = radio.send(&buf);
+
+        if (result != MICROBIT_OK)
+            return result;
+
+        offset += l;
+        index++;
+    } while (offset < len);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Transmits the given buffer onto the broadcast radio, as a sequence of fragments.
+  *
+  * The call returns once every fragment has been queued for transmission.
+  *
+  * @param data The message contents to transmit.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the message is greater than
+  *         MICROBIT_RADIO_MESSAGE_MAX_SIZE bytes, or an error code from MicroBitRadio::send().
+  */
+int MicroBitRadioMessage::send(PacketBuffer data)
+{
+    return send(data.getBytes(), data.length());
+}
+
+/**
+  * Protocol handler callback. This is called when the radio receives a packet marked as a message fragment.
+  *
+  * This function adds the fragment to the message being reassembled, and queues the message for user
+  * reception once it is complete.
+  */
+void MicroBitRadioMessage::packetReceived()
+{
+    FrameBuffer *p = radio.recv();
+    int len = p->length - (MICROBIT_RADIO_HEADER_SIZE - 1) - MICROBIT_RADIO_MESSAGE_HEADER_SIZE;
+
+    uint16_t sender = p->payload[0] | (p->payload[1] << 8);
+    uint8_t seq = p->payload[2];
+    int index = p->payload[3] & ~MICROBIT_RADIO_MESSAGE_LAST_FRAGMENT;
+    bool last = (p->payload[3] & MICROBIT_RADIO_MESSAGE_LAST_FRAGMENT) != 0;
+    int offset = index * MICROBIT_RADIO_MESSAGE_FRAGMENT_SIZE;
+
+    // Discard malformed fragments: only the last may be short, and none may overflow the reassembly buffer.
+    if (len < 0 || (!last && len != MICROBIT_RADIO_MESSAGE_FRAGMENT_SIZE) || offset + len > MICROBIT_RADIO_MESSAGE_MAX_SIZE)
+    {
+        delete p;
+        return;
+    }
+
+    if (rxBuffer == NULL)
+    {
+        rxBuffer = new uint8_t[MICROBIT_RADIO_MESSAGE_MAX_SIZE];
+
+        if (rxBuffer == NULL)
+        {
+            delete p;
+            return;
+        }
+    }
+
+    // Fragments of a new message abandon any we had partly reassembled.
+    if (!rxActive || sender != rxSender || seq != rxSeq)
+    {
+        rxActive = true;
+        rxSender = sender;
+        rxSeq = seq;
+        rxReceived = 0;
+        rxTotal = 0;
+        rxLength = 0;
+        memset(rxFragments, 0, sizeof(rxFragments));
+    }
+
+    // Ignore any duplicates.
+    if (rxFragments[index / 32] & (1UL << (index % 32)))
+    {
+        delete p;
+        return;
+    }
+
+    memcpy(rxBuffer + offset, p->payload + MICROBIT_RADIO_MESSAGE_HEADER_SIZE, len);
+    rxFragments[index / 32] |= 1UL << (index % 32);
+    rxReceived++;
+
+    if (last)
+    {
+        rxTotal = index + 1;
+        rxLength = offset + len;
+    }
+
+    if (rxTotal && rxReceived == rxTotal)
+    {
+        rxActive = false;
+
+        if (rxQueueLength < MICROBIT_RADIO_MESSAGE_QUEUE_SIZE)
+        {
+            rxQueue[(rxQueueHead + rxQueueLength) % MICROBIT_RADIO_MESSAGE_QUEUE_SIZE] = PacketBuffer(rxBuffer, rxLength, p->rssi);
+            rxQueueLength++;
+
+            MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_MESSAGE);
+        }
+    }
+
+    delete p;
+}
@@ -0,0 +1,502 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "MicroBitDevice.h"
+#include "MicroBitSystemTimer.h"
+
+/**
+ * Provides reliable, ordered delivery of packets from one micro:bit to another.
+ *
+ * Each frame is addressed to a single micro:bit, and carries a sequence number. The receiver acknowledges the frames
+ * it has received, holding any that arrive out of order until those before them are received. The sender keeps up
+ * to MICROBIT_RADIO_RELIABLE_WINDOW frames in flight, resending only those that have not been acknowledged within
+ * MICROBIT_RADIO_RELIABLE_TIMEOUT milliseconds. If a frame has still not been acknowledged after
+ * MICROBIT_RADIO_RELIABLE_MAX_RETRIES attempts, those in flight are abandoned, and a MICROBIT_RADIO_EVT_RELIABLE_FAILED
+ * event is raised for each.
+ *
+ * Addresses are derived from the serial number of each micro:bit. See getAddress().
+ */
+
+/**
+  * Constructor.
+  *
+  * Creates an instance of a MicroBitRadioReliable, which offers the ability to
+  * send packets reliably to another micro:bit in the vicinity.
+  *
+  * @param r The underlying radio module used to send and receive data.
+  */
+MicroBitRadioReliable::MicroBitRadioReliable(MicroBitRadio &r) : radio(r)
+{
+    memset(peers, 0, sizeof(peers));
+    this->nextPeer = 0;
+
+    this->txDest = 0;
+    this->txBase = 0;
+    this->txNext = 0;
+    this->txCount = 0;
+    this->txWaiters = NULL;
+
+    for (int i = 0; i < MICROBIT_RADIO_RELIABLE_WINDOW; i++)
+        this->txWindow[i] = NULL;
+
+    this->rxQueue = NULL;
+    this->rxTail = NULL;
+    this->rxQueueLength = 0;
+}
+
+/**
+  * Determines the address of this micro:bit, to which others may send frames.
+  *
+  * @return This micro:bit's address.
+  */
+uint16_t MicroBitRadioReliable::getAddress()
+{
+    uint32_t serial = microbit_serial_number();
+
+    return (uint16_t)(serial ^ (serial >> 16));
+}
+
+/**
+  * Finds the entry for the given micro:bit, optionally creating one if none exists.
+  *
+  * @param address The address of the micro:bit.
+  *
+  * @param create true to replace the least recently created entry if there is none for this micro:bit.
+  *
+  * @return The entry, or NULL if none exists and create is false.
+  */
+MicroBitRadioReliablePeer *MicroBitRadioReliable::getPeer(uint16_t address, bool create)
+{
+    for (int i = 0; i < MICROBIT_RADIO_RELIABLE_PEERS; i++)
+        if (peers[i].used && peers[i].address == address)
+            return &peers[i];
+
+    if (!create)
+        return NULL;
+
+    // Never replace the entry for the micro:bit our frames in flight are addressed to.
+    MicroBitRadioReliablePeer *peer = &peers[nextPeer];
+    nextPeer = (nextPeer + 1) % MICROBIT_RADIO_RELIABLE_PEERS;
+
+    if (txCount && peer->used && peer->address == txDest)
+    {
+        peer = &peers[nextPeer];
+        nextPeer = (nextPeer + 1) % MICROBIT_RADIO_RELIABLE_PEERS;
+    }
+
+    releaseHeld(peer);
+
+    // Start from a random sequence number, so a receiver that remembers an earlier exchange is unlikely to mistake our frames for old ones.
+    peer->address = address;
+    peer->used = true;
+    peer->txSynced = false;
+    peer->rxSynced = false;
+    peer->txSeq = microbit_random(256);
+    peer->rxSeq = 0;
+
+    return peer;
+}
+
+/**
+  * Discards any frames received out of order from the given micro:bit.
+  *
+  * @param peer The entry for the micro:bit.
+  */
+void MicroBitRadioReliable::releaseHeld(MicroBitRadioReliablePeer *peer)
+{
+    for (int i = 0; i < MICROBIT_RADIO_RELIABLE_WINDOW; i++)
+    {
+        if (peer->held[i] != NULL)
+        {
+            delete peer->held[i];
+            peer->held[i] = NULL;
+        }
+    }
+}
+
+/**
+  * Sends the given data reliably to another micro:bit.
+  *
+  * The call returns once the frame has been sent for the first time, waiting first for space in the window
+  * if necessary. If frames are in flight to a different micro:bit, it waits for them to be acknowledged.
+  *
+  * @param destination The address of the micro:bit to send to.
+  *
+  * @param buffer The data to send.
+  *
+  * @param len The number of bytes to send.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes
+  *         to send is greater than MICROBIT_RADIO_RELIABLE_MAX_PAYLOAD, MICROBIT_NO_RESOURCES if no memory is
+  *         available, or MICROBIT_NOT_SUPPORTED if the fiber scheduler is not running.
+  */
+int MicroBitRadioReliable::send(uint16_t destination, uint8_t *buffer, int len)
+{
+    if (buffer == NULL || len < 0 || len > MICROBIT_RADIO_RELIABLE_MAX_PAYLOAD)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Acknowledgements are processed from the idle thread, so we must be able to block while we wait for them.
+    if (!fiber_scheduler_running())
+        return MICROBIT_NOT_SUPPORTED;
+
+    while (txCount && (txDest != destination || (uint8_t)(txNext - txBase) >= MICROBIT_RADIO_RELIABLE_WINDOW))
+        fiber_wait_on_queue(&txWaiters);
+
+    MicroBitRadioReliablePeer *peer = getPeer(destination, true);
+
+    if (txCount == 0)
+    {
+        txDest = destination;
+        txBase = peer->txSeq;
+        txNext = peer->txSeq;
+    }
+
+    FrameBuffer *f = new FrameBuffer();
+
+    if (f == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    uint16_t address = getAddress();
+
+    f->length = len + MICROBIT_RADIO_RELIABLE_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+    f->version = 1;
+    f->group = 0;
+    f->protocol = MICROBIT_RADIO_PROTOCOL_RELIABLE;
+    f->payload[0] = peer->txSynced ? 0 : MICROBIT_RADIO_RELIABLE_FLAG_SYN;
+    f->payload[1] = address & 0xFF;
+    f->payload[2] = address >> 8;
+    f->payload[3] = destination & 0xFF;
+    f->payload[4] = destination >> 8;
+    f->payload[5] = txNext;
+    memcpy(f->payload + MICROBIT_RADIO_RELIABLE_HEADER_SIZE, buffer, len);
+
+    int slot = txNext % MICROBIT_RADIO_RELIABLE_WINDOW;
+
+    txWindow[slot] = f;
+    txTime[slot] = (uint32_t) system_timer_current_time();
+    txRetries[slot] = 0;
+    txCount++;
+    txNext++;
+    peer->txSeq = txNext;
+
+    // If the transmit queue is full, the retransmit timer will send the frame later.
+    radio.sendAsync(f);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Sends the given data reliably to another micro:bit.
+  *
+  * @param destination The address of the micro:bit to send to.
+  *
+  * @param data The data to send.
+  *
+  * @return MICROBIT_OK on success, or an error code as for send(uint16_t, uint8_t *, int).
+  */
+int MicroBitRadioReliable::send(uint16_t destination, PacketBuffer data)
+{
+    return send(destination, data.getBytes(), data.length());
+}
+
+/**
+  * Retrieves the oldest frame received, in the order it was sent.
+  *
+  * @param sender If not NULL, set to the address of the micro:bit that sent the frame.
+  *
+  * @return The data received, or an empty PacketBuffer if no data is available.
+  */
+PacketBuffer MicroBitRadioReliable::recv(uint16_t *sender)
+{
+    if (rxQueue == NULL)
+        return PacketBuffer::EmptyPacket;
+
+    FrameBuffer *p = rxQueue;
+    rxQueue = rxQueue->next;
+    rxQueueLength--;
+
+    if (sender != NULL)
+        *sender = p->payload[1] | (p->payload[2] << 8);
+
+    PacketBuffer packet(p->payload + MICROBIT_RADIO_RELIABLE_HEADER_SIZE, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1) - MICROBIT_RADIO_RELIABLE_HEADER_SIZE, p->rssi);
+
+    delete p;
+    return packet;
+}
+
+/**
+  * Determines the number of frames we have sent that are yet to be acknowledged.
+  *
+  * @return The number of frames in flight.
+  */
+int MicroBitRadioReliable::pending()
+{
+    return txCount;
+}
+
+/**
+  * Abandons the frames in flight, after one has gone unacknowledged too many times.
+  */
+void MicroBitRadioReliable::abandon()
+{
+    for (int i = 0; i < MICROBIT_RADIO_RELIABLE_WINDOW; i++)
+    {
+        if (txWindow[i] != NULL)
+        {
+            delete txWindow[i];
+            txWindow[i] = NULL;
+
+            MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_FAILED);
+        }
+    }
+
+    txCount = 0;
+
+    // The receiver may be holding frames after the one lost, so move well clear of them and ask it to resynchronise.
+    MicroBitRadioReliablePeer *peer = getPeer(txDest, false);
+
+    if (peer != NULL)
+    {
+        peer->txSeq = txNext + 128;
+        peer->txSynced = false;
+    }
+
+    fiber_wake_all(&txWaiters);
+}
+
+/**
+  * Handles an acknowledgement of frames we have sent.
+  *
+  * @param p The acknowledgement received.
+  */
+void MicroBitRadioReliable::ackReceived(FrameBuffer *p)
+{
+    uint16_t source = p->payload[1] | (p->payload[2] << 8);
+
+    if (txCount == 0 || source != txDest || p->length < MICROBIT_RADIO_RELIABLE_HEADER_SIZE + 1 + MICROBIT_RADIO_HEADER_SIZE - 1)
+        return;
+
+    uint8_t ack = p->payload[5];
+    uint8_t received = p->payload[MICROBIT_RADIO_RELIABLE_HEADER_SIZE];
+
+    // Release every frame before the one expected next, and those after it marked as received out of order.
+    for (uint8_t seq = txBase; seq != txNext; seq++)
+    {
+        int slot = seq % MICROBIT_RADIO_RELIABLE_WINDOW;
+        uint8_t d = seq - ack;
+
+        if (txWindow[slot] != NULL && (d >= 128 || (d >= 1 && d <= 8 && (received & (1 << (d - 1))))))
+        {
+            delete txWindow[slot];
+            txWindow[slot] = NULL;
+            txCount--;
+        }
+    }
+
+    while (txBase != txNext && txWindow[txBase % MICROBIT_RADIO_RELIABLE_WINDOW] == NULL)
+        txBase++;
+
+    MicroBitRadioReliablePeer *peer = getPeer(txDest, false);
+
+    if (peer != NULL)
+        peer->txSynced = true;
+
+    fiber_wake_all(&txWaiters);
+}
+
+/**
+  * Takes a copy of the given frame, and queues it for recv().
+  *
+  * @param p The frame to deliver.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the queue is full or no memory is available.
+  */
+int MicroBitRadioReliable::deliver(FrameBuffer *p)
+{
+    if (rxQueueLength >= radio.getRxQueueDepth())
+        return MICROBIT_NO_RESOURCES;
+
+    FrameBuffer *f = new FrameBuffer();
+
+    if (f == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    memcpy(f, p, sizeof(FrameBuffer));
+    f->next = NULL;
+
+    if (rxQueue == NULL)
+        rxQueue = f;
+    else
+        rxTail->next = f;
+
+    rxTail = f;
+    rxQueueLength++;
+
+    MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_DATA);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Handles a data frame addressed to us, and acknowledges it if it was accepted.
+  *
+  * @param p The frame received.
+  */
+void MicroBitRadioReliable::dataReceived(FrameBuffer *p)
+{
+    uint16_t source = p->payload[1] | (p->payload[2] << 8);
+    uint8_t seq = p->payload[5];
+
+    MicroBitRadioReliablePeer *peer = getPeer(source, true);
+
+    // Adopt the sender's sequence numbers if we have not done so, or if this is not a repeat of a frame we have seen recently.
+    if (p->payload[0] & MICROBIT_RADIO_RELIABLE_FLAG_SYN)
+    {
+        if (!peer->rxSynced || (uint8_t)(seq - peer->rxSeq + MICROBIT_RADIO_RELIABLE_WINDOW) >= 2 * MICROBIT_RADIO_RELIABLE_WINDOW)
+        {
+            releaseHeld(peer);
+            peer->rxSeq = seq;
+            peer->rxSynced = true;
+        }
+    }
+
+    // If we have lost track of this sender, stay silent. It will ask us to resynchronise once it gives up.
+    if (!peer->rxSynced)
+        return;
+
+    uint8_t d = seq - peer->rxSeq;
+
+    if (d == 0)
+    {
+        // The frame expected next. Deliver it, and any held after it. If there's no space, the sender will try again later.
+        if (deliver(p) != MICROBIT_OK)
+            return;
+
+        peer->rxSeq++;
+
+        FrameBuffer *h;
+
+        while ((h = peer->held[peer->rxSeq % MICROBIT_RADIO_RELIABLE_WINDOW]) != NULL && deliver(h) == MICROBIT_OK)
+        {
+            delete h;
+            peer->held[peer->rxSeq % MICROBIT_RADIO_RELIABLE_WINDOW] = NULL;
+            peer->rxSeq++;
+        }
+    }
+    else if (d < MICROBIT_RADIO_RELIABLE_WINDOW)
+    {
+        // A later frame. Hold on to it, until those before it arrive.
+        int slot = seq % MICROBIT_RADIO_RELIABLE_WINDOW;
+
+        if (peer->held[slot] == NULL)
+        {
+            FrameBuffer *f = new FrameBuffer();
+
+            if (f == NULL)
+                return;
+
+            memcpy(f, p, sizeof(FrameBuffer));
+            peer->held[slot] = f;
+        }
+    }
+    else if (d < 128)
+    {
+        // Too far ahead of us to hold.
+        return;
+    }
+
+    // Acknowledge everything up to the frame we expect next, and those held after it (including repeats of earlier frames,
+    // whose acknowledgement may have been lost).
+    FrameBuffer ack;
+    uint16_t address = getAddress();
+    uint8_t received = 0;
+
+    for (int i = 1; i < MICROBIT_RADIO_RELIABLE_WINDOW; i++)
+        if (peer->held[(uint8_t)(peer->rxSeq + i) % MICROBIT_RADIO_RELIABLE_WINDOW] != NULL)
+            received |= 1 << (i - 1);
+
+    ack.length = MICROBIT_RADIO_RELIABLE_HEADER_SIZE + 1 + MICROBIT_RADIO_HEADER_SIZE - 1;
+    ack.version = 1;
+    ack.group = 0;
+    ack.protocol = MICROBIT_RADIO_PROTOCOL_RELIABLE;
+    ack.payload[0] = MICROBIT_RADIO_RELIABLE_FLAG_ACK;
+    ack.payload[1] = address & 0xFF;
+    ack.payload[2] = address >> 8;
+    ack.payload[3] = source & 0xFF;
+    ack.payload[4] = source >> 8;
+    ack.payload[5] = peer->rxSeq;
+    ack.payload[MICROBIT_RADIO_RELIABLE_HEADER_SIZE] = received;
+
+    radio.sendAsync(&ack);
+}
+
+/**
+  * Protocol handler callback. This is called when the radio receives a packet marked as using the reliable protocol.
+  */
+void MicroBitRadioReliable::packetReceived()
+{
+    FrameBuffer *p = radio.recv();
+
+    // Ignore frames that are malformed, or addressed to others.
+    if (p->length >= MICROBIT_RADIO_RELIABLE_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1 &&
+        (p->payload[3] | (p->payload[4] << 8)) == getAddress())
+    {
+        if (p->payload[0] & MICROBIT_RADIO_RELIABLE_FLAG_ACK)
+            ackReceived(p);
+        else
+            dataReceived(p);
+    }
+
+    delete p;
+}
+
+/**
+  * Called by the radio whenever the processor is idle. Resends any frames whose acknowledgement is overdue.
+  */
+void MicroBitRadioReliable::idleTick()
+{
+    if (txCount == 0)
+        return;
+
+    uint32_t now = (uint32_t) system_timer_current_time();
+
+    for (int i = 0; i < MICROBIT_RADIO_RELIABLE_WINDOW; i++)
+    {
+        if (txWindow[i] != NULL && now - txTime[i] >= MICROBIT_RADIO_RELIABLE_TIMEOUT)
+        {
+            if (txRetries[i] >= MICROBIT_RADIO_RELIABLE_MAX_RETRIES)
+            {
+                abandon();
+                return;
+            }
+
+            txRetries[i]++;
+            txTime[i] = now;
+            radio.sendAsync(txWindow[i]);
+        }
+    }
+}
@@ -29,11 +29,28 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitComponent.h"
 #include "MicroBitFiber.h"
 #include "NotifyEvents.h"
+#include "MicroBitHeapArena.h"
 
 uint8_t MicroBitSerial::status = 0;
 
+FiberMutex MicroBitSerial::rxMutex;
+FiberMutex MicroBitSerial::txMutex;
+
 int MicroBitSerial::baudrate = 0;
 
+/**
+  * Determines if the given memory lies within the system stack. Fibers without a dedicated stack all run there,
+  * so its contents are replaced by those of another fiber whenever the current one sleeps.
+  *
+  * @param p the memory to test.
+  *
+  * @return true if the memory is part of the system stack.
+  */
+static inline bool isSystemStack(const void *p)
+{
+    return (uintptr_t)p >= MICROBIT_HEAP_END && (uintptr_t)p < CORTEX_M0_STACK_BASE;
+}
+
 /**
   * Constructor.
   * Create an instance of MicroBitSerial
@@ -55,22 +72,33 @@ int MicroBitSerial::baudrate = 0;
   *
   *       Buffers aren't allocated until the first send or receive respectively.
   */
-MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uint8_t txBufferSize) : RawSerial(tx,rx), delimeters()
+MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uint8_t txBufferSize) : RawSerial(tx,rx)
 {
-    // + 1 so there is a usable buffer size, of the size the user requested.
-    this->rxBuffSize = rxBufferSize + 1;
-    this->txBuffSize = txBufferSize + 1;
+    this->rxBuffSize = rxBufferSize;
+    this->txBuffSize = txBufferSize;
 
-    this->rxBuff = NULL;
-    this->txBuff = NULL;
+    this->rxBuffHeadMatch = -1;
 
-    this->rxBuffHead = 0;
-    this->rxBuffTail = 0;
+    memclr(&stats, sizeof(stats));
 
-    this->txBuffHead = 0;
-    this->txBuffTail = 0;
+    this->rxLine = NULL;
+    this->rxLineSize = 0;
+    this->rxLineConsume = -1;
 
-    this->rxBuffHeadMatch = -1;
+    this->txData = NULL;
+    this->txDataLen = 0;
+    this->txDataOffset = 0;
+    this->txRelease = NULL;
+    this->txReleaseContext = NULL;
+    this->txIdleHeld = false;
+
+    this->rxReceived = 0;
+    this->rxScanned = 0;
+    this->rxProcessPending = false;
+    this->rxOverflow = false;
+
+    setDelimeters(ManagedString());
+    setTerminator(NULL, 0);
 
     this->baud(MICROBIT_SERIAL_DEFAULT_BAUD_RATE);
 
@@ -84,51 +112,229 @@ MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uin
   * An internal interrupt callback for MicroBitSerial configured for when a
   * character is received.
   *
-  * Each time a character is received fill our circular buffer!
+  * Moves every character waiting in the UART into our circular buffer, and leaves
+  * any matching against them to rxProcess(), outside of interrupt context.
   */
 void MicroBitSerial::dataReceived()
 {
     if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
         return;
 
-    //get the received character
-    char c = getc();
+#if CONFIG_ENABLED(MICROBIT_SERIAL_PROFILING)
+    uint32_t start = us_ticker_read();
+#endif
 
-    int delimeterOffset = 0;
-    int delimLength = this->delimeters.length();
+    stats.rxInterrupts++;
 
-    //iterate through our delimeters (if any) to see if there is a match
-    while(delimeterOffset < delimLength)
+    //drain the UART's receive FIFO, so that a burst of characters costs a single interrupt.
+    while(readable())
     {
-        //fire an event if there is to block any waiting fibers
-        if(this->delimeters.charAt(delimeterOffset) == c)
-            MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
+        //store the character, if there is space.
+        if(rxBuff.push(getc()) == MICROBIT_OK)
+        {
+            rxReceived++;
+            stats.rxBytes++;
+        }
+        else
+        {
+            rxOverflow = true;
+            stats.rxDropped++;
+        }
+    }
+
+    rxProcessLater();
+
+#if CONFIG_ENABLED(MICROBIT_SERIAL_PROFILING)
+    stats.rxInterruptTime += us_ticker_read() - start;
+#endif
+}
+
+/**
+  * Schedules a call to rxProcess() from the idle task, if one is needed and not already waiting.
+  */
+void MicroBitSerial::rxProcessLater()
+{
+    __disable_irq();
+
+    //only wake the idle task if there is someone to tell.
+    bool schedule = !rxProcessPending && (rxOverflow || rxBuffHeadMatch >= 0 || ((delimeterMatch || terminatorLength > 0) && rxScanned != rxReceived));
+
+    if(schedule)
+        rxProcessPending = true;
 
-        delimeterOffset++;
+    __enable_irq();
+
+    if(schedule && fiber_defer(MicroBitSerial::rxProcessDeferred, this) != MICROBIT_OK)
+        rxProcessPending = false;
+}
+
+/**
+  * The idle task's entry point into rxProcess().
+  *
+  * @param serial the MicroBitSerial instance to process.
+  */
+void MicroBitSerial::rxProcessDeferred(void *serial)
+{
+    ((MicroBitSerial *)serial)->rxProcess();
+}
+
+/**
+  * Checks the characters received since the last call against our delimeters and head match,
+  * and raises any events due as a result. Called from the idle task.
+  */
+void MicroBitSerial::rxProcess()
+{
+    __disable_irq();
+
+    rxProcessPending = false;
+
+    uint32_t received = rxReceived;
+    int buffered = rxBuff.size();
+    bool overflow = rxOverflow;
+    rxOverflow = false;
+
+    __enable_irq();
+
+    //the newest characters are at the end of the buffer. Any already read by a fiber need not be matched.
+    int unscanned = (int)(received - rxScanned);
+
+    //if a fiber has read characters we had not yet seen, any partial match of our terminator is broken.
+    if(unscanned > buffered)
+    {
+        unscanned = buffered;
+        terminatorState = 0;
     }
 
-    uint16_t newHead = (rxBuffHead + 1) % rxBuffSize;
+    rxScanned = received;
 
-    //look ahead to our newHead value to see if we are about to collide with the tail
-    if(newHead != rxBuffTail)
+    if(delimeterMatch || terminatorLength > 0)
     {
-        //if we are not, store the character, and update our actual head.
-        this->rxBuff[rxBuffHead] = c;
-        rxBuffHead = newHead;
+        uint8_t c;
+
+        for(int offset = buffered - unscanned; offset < buffered; offset++)
+        {
+            if(rxBuff.peek(c, offset) != MICROBIT_OK)
+                break;
+
+            //fire an event for each delimeter seen, to unblock any waiting fibers.
+            if(delimeterMap[c >> 5] & (1 << (c & 31)))
+                MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
 
-        //if we have any fibers waiting for a specific number of characters, unblock them
-        if(rxBuffHeadMatch >= 0)
-            if(rxBuffHead == rxBuffHeadMatch)
+            //advance our terminator state machine, falling back to the longest prefix still matched on a mismatch.
+            if(terminatorLength > 0)
             {
-                rxBuffHeadMatch = -1;
-                MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_HEAD_MATCH);
+                while(terminatorState > 0 && terminator[terminatorState] != c)
+                    terminatorState = terminatorFailure[terminatorState - 1];
+
+                if(terminator[terminatorState] == c)
+                    terminatorState++;
+
+                if(terminatorState == terminatorLength)
+                {
+                    terminatorState = 0;
+                    MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_TERMINATOR_MATCH);
+                }
             }
+        }
     }
-    else
-        //otherwise, our buffer is full, send an event to the user...
+
+    //if we have any fibers waiting for a specific number of characters, unblock them
+    if(rxBuffHeadMatch >= 0 && buffered >= rxBuffHeadMatch)
+    {
+        rxBuffHeadMatch = -1;
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_HEAD_MATCH);
+    }
+
+    //if our buffer was full, send an event to the user...
+    if(overflow)
         MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_RX_FULL);
 }
 
+/**
+  * Replaces the delimeters matched on receive.
+  *
+  * @param delimeters the characters to match received characters against, or an empty ManagedString for none.
+  */
+void MicroBitSerial::setDelimeters(ManagedString delimeters)
+{
+    delimeterMatch = false;
+
+    memclr(delimeterMap, sizeof(delimeterMap));
+
+    for(int i = 0; i < delimeters.length(); i++)
+    {
+        uint8_t c = delimeters.charAt(i);
+        delimeterMap[c >> 5] |= 1 << (c & 31);
+    }
+
+    delimeterMatch = delimeters.length() > 0;
+}
+
+/**
+  * Replaces the multi-byte terminator matched on receive. Any part of it already at the end
+  * of the rxBuff counts towards a match.
+  *
+  * @param terminator the sequence of characters to match.
+  *
+  * @param len the number of characters in the terminator, or 0 to match none.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the terminator is longer
+  *         than MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH.
+  */
+int MicroBitSerial::setTerminator(const char *terminator, int len)
+{
+    if(len > MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH)
+        return MICROBIT_INVALID_PARAMETER;
+
+    terminatorLength = 0;
+    terminatorState = 0;
+
+    if(len == 0)
+        return MICROBIT_OK;
+
+    memcpy(this->terminator, terminator, len);
+
+    //terminatorFailure[i] is the length of the longest proper prefix of terminator[0..i] that is also a suffix of it.
+    //on a mismatch after matching i + 1 characters, this is how many we can keep.
+    int k = 0;
+    terminatorFailure[0] = 0;
+
+    for(int i = 1; i < len; i++)
+    {
+        while(k > 0 && this->terminator[i] != this->terminator[k])
+            k = terminatorFailure[k - 1];
+
+        if(this->terminator[i] == this->terminator[k])
+            k++;
+
+        terminatorFailure[i] = k;
+    }
+
+    terminatorLength = len;
+
+    //rxProcess() will only see characters received after it last ran, so run the state machine over those before them
+    //here. Otherwise, a terminator that began to arrive before this call could never be matched.
+    __disable_irq();
+    int seen = rxBuff.size() - (int)(rxReceived - rxScanned);
+    __enable_irq();
+
+    uint8_t c;
+
+    for(int offset = 0; offset < seen && rxBuff.peek(c, offset) == MICROBIT_OK; offset++)
+    {
+        while(terminatorState > 0 && this->terminator[terminatorState] != c)
+            terminatorState = terminatorFailure[terminatorState - 1];
+
+        if(this->terminator[terminatorState] == c)
+            terminatorState++;
+
+        if(terminatorState == terminatorLength)
+            terminatorState = 0;
+    }
+
+    return MICROBIT_OK;
+}
+
 /**
   * An internal interrupt callback for MicroBitSerial.
   *
@@ -137,23 +343,123 @@ void MicroBitSerial::dataReceived()
   */
 void MicroBitSerial::dataWritten()
 {
-    if(txBuffTail == txBuffHead || !(status & MICROBIT_SERIAL_TX_BUFF_INIT))
+    uint8_t c;
+
+    if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT))
         return;
 
-    //send our current char
-    putc(txBuff[txBuffTail]);
+#if CONFIG_ENABLED(MICROBIT_SERIAL_PROFILING)
+    uint32_t start = us_ticker_read();
+#endif
+
+    stats.txInterrupts++;
+
+    //anything in our txBuff goes first, followed by any buffer we are sending in place.
+    if(txBuff.pop(c) != MICROBIT_OK)
+    {
+        if(txData == NULL)
+            return;
+
+        c = txData[txDataOffset++];
+
+        if(txDataOffset >= txDataLen)
+        {
+            txData = NULL;
 
-    uint16_t nextTail = (txBuffTail + 1) % txBuffSize;
+            //we may not free memory here, so leave releasing our reference to the idle task.
+            if(txPacket.length() > 0 || txRelease != NULL)
+                fiber_defer(MicroBitSerial::txPacketComplete, this);
+        }
+    }
+
+    //send our current char
+    putc(c);
+    stats.txBytes++;
 
     //unblock any waiting fibers that are waiting for transmission to finish.
-    if(nextTail == txBuffHead)
+    if(txBuff.isEmpty() && txData == NULL)
     {
-        MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
-        detach(Serial::TxIrq);
+        MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY, CREATE_AND_DEFER);
+        detachTx();
     }
 
-    //update our tail!
-    txBuffTail = nextTail;
+#if CONFIG_ENABLED(MICROBIT_SERIAL_PROFILING)
+    stats.txInterruptTime += us_ticker_read() - start;
+#endif
+}
+
+/**
+  * The idle task's entry point for releasing txPacket, once it has been transmitted.
+  *
+  * @param serial the MicroBitSerial instance whose packet is complete.
+  */
+void MicroBitSerial::txPacketComplete(void *serial)
+{
+    ((MicroBitSerial *)serial)->releaseTxData();
+}
+
+/**
+  * Releases the buffer last sent in place, if its transmission is complete.
+  */
+void MicroBitSerial::releaseTxData()
+{
+    if(txData != NULL)
+        return;
+
+    txPacket = PacketBuffer::EmptyPacket;
+
+    if(txRelease != NULL)
+    {
+        void (*release)(void *) = txRelease;
+        txRelease = NULL;
+
+        release(txReleaseContext);
+    }
+}
+
+/**
+  * Prepares to send a buffer in place: takes the transmit lock, initialises the txBuff if
+  * needed, and waits for any buffer already being sent in place, as permitted by the mode.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP.
+  *
+  * @return MICROBIT_OK with the transmit lock held, or MICROBIT_SERIAL_IN_USE or
+  *         MICROBIT_NO_RESOURCES with the lock released.
+  */
+int MicroBitSerial::lockTxDirect(MicroBitSerialMode mode)
+{
+    if(lockTx(mode) != MICROBIT_OK)
+        return MICROBIT_SERIAL_IN_USE;
+
+    //lazy initialisation of our tx buffer
+    if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT))
+    {
+        int result = initialiseTx();
+
+        if(result != MICROBIT_OK)
+        {
+            unlockTx();
+            return result;
+        }
+    }
+
+    //only one buffer can be sent in place at a time. Wait for any previous one, if we are allowed to.
+    while(txData != NULL)
+    {
+        if(mode == ASYNC)
+        {
+            unlockTx();
+            return MICROBIT_SERIAL_IN_USE;
+        }
+
+        if(mode == SYNC_SLEEP)
+            fiber_wait_for_event(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
+    }
+
+    //the idle task may not yet have released the last one.
+    releaseTxData();
+
+    return MICROBIT_OK;
 }
 
 /**
@@ -173,43 +479,108 @@ void MicroBitSerial::dataWritten()
   */
 int MicroBitSerial::setTxInterrupt(uint8_t *string, int len, MicroBitSerialMode mode)
 {
-    int copiedBytes = 0;
-
-    for(copiedBytes = 0; copiedBytes < len; copiedBytes++)
-    {
-        uint16_t nextHead = (txBuffHead + 1) % txBuffSize;
-        if(nextHead != txBuffTail)
-        {
-            this->txBuff[txBuffHead] = string[copiedBytes];
-            txBuffHead = nextHead;
-        }
-        else
-            break;
-    }
+    //bytes added behind a buffer being sent in place would overtake it, so wait for it to finish.
+    int copiedBytes = (txData == NULL) ? txBuff.push(string, len) : 0;
 
     if(mode != SYNC_SPINWAIT)
         fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
 
     //set the TX interrupt
-    attach(this, &MicroBitSerial::dataWritten, Serial::TxIrq);
+    attachTx();
 
     return copiedBytes;
 }
 
+/**
+  * An internal method to configure an interrupt on tx buffer, and transmit the given
+  * bytes from where they are, once everything in txBuff has been sent.
+  *
+  * @param data a pointer to the first byte to send. This must remain valid and unchanged
+  *        until transmission is complete.
+  *
+  * @param len the number of bytes to send.
+  *
+  * @param mode if SYNC_SLEEP, the current fiber context is configured to wake once transmission is complete.
+  */
+void MicroBitSerial::setTxDirect(uint8_t *data, int len, MicroBitSerialMode mode)
+{
+    txDataOffset = 0;
+    txDataLen = len;
+    txData = data;
+
+    if(mode == SYNC_SLEEP)
+        fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
+
+    //set the TX interrupt
+    attachTx();
+}
+
+/**
+  * Attaches the transmit interrupt, and prevents the idle task from stopping the high frequency
+  * clock until transmission is complete.
+  */
+void MicroBitSerial::attachTx()
+{
+    bool held;
+
+    // Take the hold first, so the clock can't stop between attaching and holding. Drop it again if we already had one.
+    scheduler_idle_hold();
+
+    __disable_irq();
+    held = txIdleHeld;
+    txIdleHeld = true;
+    attach(this, &MicroBitSerial::dataWritten, Serial::TxIrq);
+    __enable_irq();
+
+    if(held)
+        scheduler_idle_release();
+}
+
+/**
+  * Detaches the transmit interrupt, and releases the hold placed on the idle task by attachTx().
+  */
+void MicroBitSerial::detachTx()
+{
+    bool held;
+
+    __disable_irq();
+    detach(Serial::TxIrq);
+    held = txIdleHeld;
+    txIdleHeld = false;
+    __enable_irq();
+
+    if(held)
+        scheduler_idle_release();
+}
+
 /**
   * Locks the mutex so that others can't use this serial instance for reception
+  *
+  * @param mode if SYNC_SLEEP, the calling fiber waits its turn if another fiber holds the mutex.
+  *        Otherwise, this call fails immediately in that case. Defaults to ASYNC.
+  *
+  * @return MICROBIT_OK if the mutex is now held, or MICROBIT_SERIAL_IN_USE.
   */
-void MicroBitSerial::lockRx()
+int MicroBitSerial::lockRx(MicroBitSerialMode mode)
 {
-    status |= MICROBIT_SERIAL_RX_IN_USE;
+    int result = (mode == SYNC_SLEEP) ? rxMutex.lock() : rxMutex.tryLock();
+
+    return (result == MICROBIT_OK) ? MICROBIT_OK : MICROBIT_SERIAL_IN_USE;
 }
 
 /**
   * Locks the mutex so that others can't use this serial instance for transmission
+  *
+  * @param mode if SYNC_SLEEP, the calling fiber waits its turn if another fiber holds the mutex.
+  *        Otherwise, this call fails immediately in that case. Defaults to ASYNC.
+  *
+  * @return MICROBIT_OK if the mutex is now held, or MICROBIT_SERIAL_IN_USE.
   */
-void MicroBitSerial::lockTx()
+int MicroBitSerial::lockTx(MicroBitSerialMode mode)
 {
-    status |= MICROBIT_SERIAL_TX_IN_USE;
+    int result = (mode == SYNC_SLEEP) ? txMutex.lock() : txMutex.tryLock();
+
+    return (result == MICROBIT_OK) ? MICROBIT_OK : MICROBIT_SERIAL_IN_USE;
 }
 
 /**
@@ -217,7 +588,7 @@ void MicroBitSerial::lockTx()
   */
 void MicroBitSerial::unlockRx()
 {
-    status &= ~MICROBIT_SERIAL_RX_IN_USE;
+    rxMutex.unlock();
 }
 
 /**
@@ -225,7 +596,7 @@ void MicroBitSerial::unlockRx()
   */
 void MicroBitSerial::unlockTx()
 {
-    status &= ~MICROBIT_SERIAL_TX_IN_USE;
+    txMutex.unlock();
 }
 
 /**
@@ -238,16 +609,17 @@ int MicroBitSerial::initialiseRx()
     {
         //ensure that we receive no interrupts after freeing our buffer
         detach(Serial::RxIrq);
-        free(this->rxBuff);
     }
 
     status &= ~MICROBIT_SERIAL_RX_BUFF_INIT;
 
-    if((this->rxBuff = (uint8_t *)malloc(rxBuffSize)) == NULL)
-        return MICROBIT_NO_RESOURCES;
+    // Our buffers outlive any arena of the fiber that first uses them, so always use the heap.
+    MicroBitHeapArena::suspend();
+    int result = rxBuff.resize(rxBuffSize);
+    MicroBitHeapArena::resume();
 
-    this->rxBuffHead = 0;
-    this->rxBuffTail = 0;
+    if(result != MICROBIT_OK)
+        return result;
 
     //set the receive interrupt
     status |= MICROBIT_SERIAL_RX_BUFF_INIT;
@@ -265,17 +637,18 @@ int MicroBitSerial::initialiseTx()
     if((status & MICROBIT_SERIAL_TX_BUFF_INIT))
     {
         //ensure that we receive no interrupts after freeing our buffer
-        detach(Serial::TxIrq);
-        free(this->txBuff);
+        detachTx();
     }
 
     status &= ~MICROBIT_SERIAL_TX_BUFF_INIT;
 
-    if((this->txBuff = (uint8_t *)malloc(txBuffSize)) == NULL)
-        return MICROBIT_NO_RESOURCES;
+    // Our buffers outlive any arena of the fiber that first uses them, so always use the heap.
+    MicroBitHeapArena::suspend();
+    int result = txBuff.resize(txBuffSize);
+    MicroBitHeapArena::resume();
 
-    this->txBuffHead = 0;
-    this->txBuffTail = 0;
+    if(result != MICROBIT_OK)
+        return result;
 
     status |= MICROBIT_SERIAL_TX_BUFF_INIT;
 
@@ -336,41 +709,13 @@ int MicroBitSerial::getChar(MicroBitSerialMode mode)
             eventAfter(1, mode);
     }
 
-    char c = rxBuff[rxBuffTail];
+    uint8_t c = 0;
 
-    rxBuffTail = (rxBuffTail + 1) % rxBuffSize;
+    rxBuff.pop(c);
 
     return c;
 }
 
-/**
-  * An internal method that copies values from a circular buffer to a linear buffer.
-  *
-  * @param circularBuff a pointer to the source circular buffer
-  *
-  * @param circularBuffSize the size of the circular buffer
-  *
-  * @param linearBuff a pointer to the destination linear buffer
-  *
-  * @param tailPosition the tail position in the circular buffer you want to copy from
-  *
-  * @param headPosition the head position in the circular buffer you want to copy to
-  *
-  * @note this method assumes that the linear buffer has the appropriate amount of
-  *       memory to contain the copy operation
-  */
-void MicroBitSerial::circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition)
-{
-    int toBuffIndex = 0;
-
-    while(tailPosition != headPosition)
-    {
-        linearBuff[toBuffIndex++] = circularBuff[tailPosition];
-
-        tailPosition = (tailPosition + 1) % circularBuffSize;
-    }
-}
-
 /**
   * Sends a single character over the serial line.
   *
@@ -392,22 +737,23 @@ void MicroBitSerial::circularCopy(uint8_t *circularBuff, uint8_t circularBuffSiz
   *         Defaults to SYNC_SLEEP.
   *
   * @return the number of bytes written, or MICROBIT_SERIAL_IN_USE if another fiber
-  *         is using the serial instance for transmission.
+  *         is using the serial instance for transmission and the mode is not SYNC_SLEEP.
   */
 int MicroBitSerial::sendChar(char c, MicroBitSerialMode mode)
 {
-    if(txInUse())
+    if(lockTx(mode) != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockTx();
-
     //lazy initialisation of our tx buffer
     if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT))
     {
         int result = initialiseTx();
 
         if(result != MICROBIT_OK)
+        {
+            unlockTx();
             return result;
+        }
     }
 
     uint8_t toTransmit[2] =  { c, '\0'};
@@ -442,11 +788,13 @@ int MicroBitSerial::sendChar(char c, MicroBitSerialMode mode)
   *         Defaults to SYNC_SLEEP.
   *
   * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
-  *         is using the serial instance for transmission, MICROBIT_INVALID_PARAMETER
+  *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, MICROBIT_INVALID_PARAMETER
   *         if buffer is invalid, or the given bufferLen is <= 0.
   */
 int MicroBitSerial::send(ManagedString s, MicroBitSerialMode mode)
 {
+    // If MICROBIT_STRING_INLINE_LENGTH is set, the characters of a short string lie within our copy of it on the stack.
+    // The buffer overload sees this, and copies them through the txBuff rather than sending them in place.
     return send((uint8_t *)s.toCharArray(), s.length(), mode);
 }
 
@@ -473,18 +821,16 @@ int MicroBitSerial::send(ManagedString s, MicroBitSerialMode mode)
   *         Defaults to SYNC_SLEEP.
   *
   * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
-  *         is using the serial instance for transmission, MICROBIT_INVALID_PARAMETER
+  *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, MICROBIT_INVALID_PARAMETER
   *         if buffer is invalid, or the given bufferLen is <= 0.
   */
 int MicroBitSerial::send(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode)
 {
-    if(txInUse())
-        return MICROBIT_SERIAL_IN_USE;
-
     if(bufferLen <= 0 || buffer == NULL)
         return MICROBIT_INVALID_PARAMETER;
 
-    lockTx();
+    if(lockTx(mode) != MICROBIT_OK)
+        return MICROBIT_SERIAL_IN_USE;
 
     //lazy initialisation of our tx buffer
     if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT))
@@ -492,7 +838,22 @@ int MicroBitSerial::send(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode
         int result = initialiseTx();
 
         if(result != MICROBIT_OK)
+        {
+            unlockTx();
             return result;
+        }
+    }
+
+    //if we are to wait for completion anyway, send the caller's buffer in place. Whilst we sleep, other fibers reuse
+    //the system stack, so a buffer held there (including the characters of a short ManagedString) is copied instead.
+    if(txData == NULL && (mode == SYNC_SPINWAIT || (mode == SYNC_SLEEP && !isSystemStack(buffer))))
+    {
+        setTxDirect(buffer, bufferLen, mode);
+        send(mode);
+
+        unlockTx();
+
+        return bufferLen;
     }
 
     bool complete = false;
@@ -512,6 +873,112 @@ int MicroBitSerial::send(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode
     return bytesWritten;
 }
 
+/**
+  * Sends the contents of a PacketBuffer over the serial line, directly from the PacketBuffer
+  * rather than through the txBuff. A reference to the PacketBuffer is held until it has been sent,
+  * so the caller may release its own at any time. Completion is signalled by the event
+  * MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY.
+  *
+  * @param buffer the PacketBuffer to send.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+  *        gives a different behaviour:
+  *
+  *            ASYNC - transmission is started and this method returns immediately. If a
+  *                    PacketBuffer is already being sent, MICROBIT_SERIAL_IN_USE is returned.
+  *
+  *            SYNC_SPINWAIT - this method will spin (lock up the processor) until all bytes
+  *                            have been sent.
+  *
+  *            SYNC_SLEEP - the fiber sleeps until all bytes have been sent. This allows other fibers
+  *                         to continue execution.
+  *
+  *         Defaults to ASYNC.
+  *
+  * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
+  *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, or MICROBIT_INVALID_PARAMETER
+  *         if the buffer is empty.
+  *
+  * @code
+  * PacketBuffer log(64);
+  *
+  * // fill in the log...
+  *
+  * serial.send(log);
+  * @endcode
+  */
+int MicroBitSerial::send(PacketBuffer buffer, MicroBitSerialMode mode)
+{
+    if(buffer.length() <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int result = lockTxDirect(mode);
+
+    if(result != MICROBIT_OK)
+        return result;
+
+    txPacket = buffer;
+    setTxDirect(txPacket.getBytes(), txPacket.length(), mode);
+    send(mode);
+
+    unlockTx();
+
+    return buffer.length();
+}
+
+/**
+  * Sends the given bytes over the serial line directly from where they are, rather than through
+  * the txBuff, and hands them back once they have been sent. This allows buffers owned by another
+  * component, such as a radio receive buffer, to be forwarded without being copied.
+  *
+  * @param buffer a pointer to the first byte to send. This must remain valid and unchanged
+  *        until release is called.
+  *
+  * @param bufferLen the number of bytes to send.
+  *
+  * @param release called from the idle task with the given context once the last byte has been
+  *        written, or from clearTxBuffer() if the transmission is abandoned. May be NULL.
+  *
+  * @param context passed to release.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+  *        gives a different behaviour:
+  *
+  *            ASYNC - transmission is started and this method returns immediately. If a
+  *                    buffer is already being sent in place, MICROBIT_SERIAL_IN_USE is returned.
+  *
+  *            SYNC_SPINWAIT - this method will spin (lock up the processor) until all bytes
+  *                            have been sent.
+  *
+  *            SYNC_SLEEP - the fiber sleeps until all bytes have been sent. This allows other fibers
+  *                         to continue execution.
+  *
+  *         Defaults to ASYNC.
+  *
+  * @return the number of bytes written, MICROBIT_SERIAL_IN_USE if another fiber
+  *         is using the serial instance for transmission and the mode is not SYNC_SLEEP, or MICROBIT_INVALID_PARAMETER
+  *         if buffer is NULL, or the given bufferLen is <= 0. If an error is returned, release is not called.
+  */
+int MicroBitSerial::send(uint8_t *buffer, int bufferLen, void (*release)(void *), void *context, MicroBitSerialMode mode)
+{
+    if(buffer == NULL || bufferLen <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int result = lockTxDirect(mode);
+
+    if(result != MICROBIT_OK)
+        return result;
+
+    txRelease = release;
+    txReleaseContext = context;
+    setTxDirect(buffer, bufferLen, mode);
+    send(mode);
+
+    unlockTx();
+
+    return bufferLen;
+}
+
 /**
   * Reads a single character from the rxBuff
   *
@@ -531,24 +998,26 @@ int MicroBitSerial::send(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode
   *
   *         Defaults to SYNC_SLEEP.
   *
-  * @return a character, MICROBIT_SERIAL_IN_USE if another fiber is using the serial instance for reception,
+  * @return a character, MICROBIT_SERIAL_IN_USE if another fiber is using the serial instance for reception
+  *         and the mode is not SYNC_SLEEP,
   *         MICROBIT_NO_RESOURCES if buffer allocation did not complete successfully, or MICROBIT_NO_DATA if
   *         the rx buffer is empty and the mode given is ASYNC.
   */
 int MicroBitSerial::read(MicroBitSerialMode mode)
 {
-    if(rxInUse())
+    if(lockRx(mode) != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockRx();
-
     //lazy initialisation of our buffers
     if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
     {
         int result = initialiseRx();
 
         if(result != MICROBIT_OK)
+        {
+            unlockRx();
             return result;
+        }
     }
 
     int c = getChar(mode);
@@ -621,22 +1090,23 @@ ManagedString MicroBitSerial::read(int size, MicroBitSerialMode mode)
   *         Defaults to SYNC_SLEEP.
   *
   * @return the number of characters read, or MICROBIT_SERIAL_IN_USE if another fiber
-  *         is using the instance for receiving.
+  *         is using the instance for receiving and the mode is not SYNC_SLEEP.
   */
 int MicroBitSerial::read(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode)
 {
-    if(rxInUse())
+    if(lockRx(mode) != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockRx();
-
     //lazy initialisation of our rx buffer
     if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
     {
         int result = initialiseRx();
 
         if(result != MICROBIT_OK)
+        {
+            unlockRx();
             return result;
+        }
     }
 
     int bufferIndex = 0;
@@ -704,14 +1174,13 @@ int MicroBitSerial::read(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode
   *         Defaults to SYNC_SLEEP.
   *
   * @return A ManagedString containing the characters up to a delimeter, or an Empty ManagedString,
-  *         if another fiber is currently using this instance for reception.
+  *         if another fiber is currently using this instance for reception and the mode is not SYNC_SLEEP.
   *
   * @note delimeters are matched on a per byte basis.
   */
 ManagedString MicroBitSerial::readUntil(ManagedString delimeters, MicroBitSerialMode mode)
 {
-
-    if(rxInUse())
+    if(lockRx(mode) != MICROBIT_OK)
         return ManagedString();
 
     //lazy initialisation of our rx buffer
@@ -720,27 +1189,27 @@ ManagedString MicroBitSerial::readUntil(ManagedString delimeters, MicroBitSerial
         int result = initialiseRx();
 
         if(result != MICROBIT_OK)
+        {
+            unlockRx();
             return result;
+        }
     }
 
-    lockRx();
-
-    int localTail = rxBuffTail;
-    int preservedTail = rxBuffTail;
+    //offsets are relative to the oldest character in our buffer, so are unaffected by the receive interrupt.
+    int localOffset = 0;
 
     int foundIndex = -1;
 
+    uint8_t c;
+
     //ASYNC mode just iterates through our stored characters checking for any matches.
-    while(localTail != rxBuffHead && foundIndex  == -1)
+    while(foundIndex == -1 && rxBuff.peek(c, localOffset) == MICROBIT_OK)
     {
-        //we use localTail to prevent modification of the actual tail.
-        char c = rxBuff[localTail];
-
         for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
             if(delimeters.charAt(delimeterIterator) == c)
-                foundIndex = localTail;
+                foundIndex = localOffset;
 
-        localTail = (localTail + 1) % rxBuffSize;
+        localOffset++;
     }
 
     //if our mode is SYNC_SPINWAIT and we didn't see any matching characters in our buffer
@@ -749,42 +1218,50 @@ ManagedString MicroBitSerial::readUntil(ManagedString delimeters, MicroBitSerial
     {
         while(foundIndex == -1)
         {
-            while(localTail == rxBuffHead);
-
-            char c = rxBuff[localTail];
+            while(rxBuff.peek(c, localOffset) != MICROBIT_OK);
 
             for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
                 if(delimeters.charAt(delimeterIterator) == c)
-                    foundIndex = localTail;
+                    foundIndex = localOffset;
 
-            localTail = (localTail + 1) % rxBuffSize;
+            localOffset++;
         }
     }
 
     //if our mode is SYNC_SLEEP, we set up an event to be fired when we see a
-    //matching character.
+    //matching character, then check the characters that have arrived since.
     if(mode == SYNC_SLEEP && foundIndex == -1)
     {
-        eventOn(delimeters, mode);
+        while(foundIndex == -1)
+        {
+            eventOn(delimeters, mode);
 
-        foundIndex = rxBuffHead - 1;
+            while(foundIndex == -1 && rxBuff.peek(c, localOffset) == MICROBIT_OK)
+            {
+                for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
+                    if(delimeters.charAt(delimeterIterator) == c)
+                        foundIndex = localOffset;
+
+                localOffset++;
+            }
+        }
 
-        this->delimeters = ManagedString();
+        setDelimeters(ManagedString());
     }
 
     if(foundIndex >= 0)
     {
-        //calculate our local buffer size
-        int localBuffSize = (preservedTail > foundIndex) ? (rxBuffSize - preservedTail) + foundIndex : foundIndex - preservedTail;
+        //our local buffer holds everything before the matching character
+        int localBuffSize = foundIndex;
 
         uint8_t localBuff[localBuffSize + 1];
 
         memclr(&localBuff, localBuffSize + 1);
 
-        circularCopy(rxBuff, rxBuffSize, localBuff, preservedTail, foundIndex);
+        rxBuff.pop(localBuff, localBuffSize);
 
         //plus one for the character we listened for...
-        rxBuffTail = (rxBuffTail + localBuffSize + 1) % rxBuffSize;
+        rxBuff.pop(NULL, 1);
 
         unlockRx();
 
@@ -796,6 +1273,195 @@ ManagedString MicroBitSerial::readUntil(ManagedString delimeters, MicroBitSerial
     return ManagedString();
 }
 
+/**
+  * Reads the next line from the rxBuff without copying it, where possible. The line is returned as a pointer
+  * directly into the rxBuff, unless it wraps around the end of the rxBuff's storage, in which case only then is
+  * it copied (into a buffer allocated once and reused).
+  *
+  * The line remains valid, and this instance remains locked for reception, until releaseLine() is called.
+  * This must be called once the caller has finished with the line, whenever this method returns a value >= 0.
+  *
+  * @param line set to the first character of the line. The terminator is not included, and the line is not NUL terminated.
+  *
+  * @param terminator a NUL terminated sequence of up to MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH characters that ends each line e.g. "\r\n".
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+  *        gives a different behaviour:
+  *
+  *            ASYNC - If a complete line is already in the rxBuff, it is returned.
+  *                    Otherwise, MICROBIT_NO_DATA is returned immediately.
+  *
+  *            SYNC_SPINWAIT - If a complete line is already in the rxBuff, it is returned.
+  *                            Otherwise, this method will spin (lock up the processor) until one is received.
+  *
+  *            SYNC_SLEEP - If a complete line is already in the rxBuff, it is returned.
+  *                         Otherwise, the calling fiber sleeps until one is received.
+  *
+  *         Defaults to SYNC_SLEEP.
+  *
+  * @return the length of the line, MICROBIT_NO_DATA if no line is available and the mode is ASYNC, MICROBIT_SERIAL_IN_USE
+  *         if another fiber is currently using this instance for reception and the mode is not SYNC_SLEEP, or
+  *         MICROBIT_INVALID_PARAMETER if the terminator is empty or too long.
+  *
+  * @note If the rxBuff fills without a terminator being seen, its entire contents are returned as a line,
+  *       so that a line longer than the rxBuff cannot stall reception.
+  *
+  * @code
+  * uint8_t *line;
+  * int len = serial.readLine(line, "\r\n");
+  *
+  * if (len >= 0)
+  * {
+  *     // parse the line...
+  *     serial.releaseLine();
+  * }
+  * @endcode
+  */
+int MicroBitSerial::readLine(uint8_t *&line, const char *terminator, MicroBitSerialMode mode)
+{
+    int terminatorLen = terminator == NULL ? 0 : strlen(terminator);
+
+    if(terminatorLen == 0 || terminatorLen > MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if(lockRx(mode) != MICROBIT_OK)
+        return MICROBIT_SERIAL_IN_USE;
+
+    //lazy initialisation of our rx buffer
+    if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
+    {
+        int result = initialiseRx();
+
+        if(result != MICROBIT_OK)
+        {
+            unlockRx();
+            return result;
+        }
+    }
+
+    //offsets are relative to the oldest character in our buffer, so are unaffected by the receive interrupt.
+    int searchOffset = 0;
+    int lineLength = -1;
+    bool waiting = false;
+
+    //any terminator and byte count configured by the application, to restore once we stop waiting.
+    uint8_t savedTerminator[MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH];
+    int savedTerminatorLength = 0;
+    int savedHeadMatch = -1;
+
+    while(lineLength < 0)
+    {
+        uint8_t c;
+
+        //look for the terminator at each position not yet ruled out.
+        while(lineLength < 0 && rxBuff.peek(c, searchOffset + terminatorLen - 1) == MICROBIT_OK)
+        {
+            int matched = 0;
+
+            while(matched < terminatorLen && rxBuff.peek(c, searchOffset + matched) == MICROBIT_OK && c == (uint8_t)terminator[matched])
+                matched++;
+
+            if(matched == terminatorLen)
+                lineLength = searchOffset;
+            else
+                searchOffset++;
+        }
+
+        if(lineLength >= 0)
+            break;
+
+        //a line longer than our buffer is returned in pieces.
+        if(rxBuff.isFull())
+        {
+            lineLength = rxBuff.size();
+            terminatorLen = 0;
+            break;
+        }
+
+        if(mode == ASYNC)
+        {
+            unlockRx();
+            return MICROBIT_NO_DATA;
+        }
+
+        if(mode == SYNC_SLEEP)
+        {
+            //let rxProcess() wake us when the terminator arrives, or the buffer fills.
+            if(!waiting)
+            {
+                savedTerminatorLength = this->terminatorLength;
+                savedHeadMatch = rxBuffHeadMatch;
+                memcpy(savedTerminator, this->terminator, savedTerminatorLength);
+
+                setTerminator(terminator, terminatorLen);
+                waiting = true;
+            }
+
+            rxBuffHeadMatch = rxBuff.capacity();
+            rxProcessLater();
+
+            fiber_wait_for_event(MICROBIT_ID_SERIAL, MICROBIT_EVT_ANY);
+        }
+    }
+
+    if(waiting)
+    {
+        setTerminator((const char *)savedTerminator, savedTerminatorLength);
+        rxBuffHeadMatch = savedHeadMatch;
+
+        //a byte count reached while we waited is reported now, rather than on the next byte received.
+        rxProcessLater();
+    }
+
+    //hand out the line in place if we can, or copy it if the buffer wraps part way through.
+    uint8_t *run = NULL;
+
+    if(rxBuff.peekContiguous(run) >= lineLength)
+    {
+        line = run;
+    }
+    else
+    {
+        if(rxLine == NULL || rxLineSize < rxBuff.capacity())
+        {
+            delete[] rxLine;
+
+            rxLineSize = rxBuff.capacity();
+            MicroBitHeapArena::suspend();
+            rxLine = new uint8_t[rxLineSize];
+            MicroBitHeapArena::resume();
+        }
+
+        for(int i = 0; i < lineLength; i++)
+            rxBuff.peek(rxLine[i], i);
+
+        line = rxLine;
+    }
+
+    rxLineConsume = lineLength + terminatorLen;
+
+    return lineLength;
+}
+
+/**
+  * Removes the line returned by the last call to readLine() from the rxBuff, and unlocks this
+  * instance for reception.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if there is no line to release.
+  */
+int MicroBitSerial::releaseLine()
+{
+    if(rxLineConsume < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    rxBuff.pop(NULL, rxLineConsume);
+    rxLineConsume = -1;
+
+    unlockRx();
+
+    return MICROBIT_OK;
+}
+
 /**
   * A wrapper around the inherited method "baud" so we can trap the baud rate
   * as it changes and restore it if redirect() is called.
@@ -829,14 +1495,17 @@ void MicroBitSerial::baud(int baudrate)
   */
 int MicroBitSerial::redirect(PinName tx, PinName rx)
 {
-    if(txInUse() || rxInUse())
+    if(lockTx() != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockTx();
-    lockRx();
+    if(lockRx() != MICROBIT_OK)
+    {
+        unlockTx();
+        return MICROBIT_SERIAL_IN_USE;
+    }
 
     if(txBufferedSize() > 0)
-        detach(Serial::TxIrq);
+        detachTx();
 
     detach(Serial::RxIrq);
 
@@ -845,7 +1514,7 @@ int MicroBitSerial::redirect(PinName tx, PinName rx)
     attach(this, &MicroBitSerial::dataReceived, Serial::RxIrq);
 
     if(txBufferedSize() > 0)
-        attach(this, &MicroBitSerial::dataWritten, Serial::TxIrq);
+        attachTx();
 
     this->baud(this->baudrate);
 
@@ -880,7 +1549,10 @@ int MicroBitSerial::eventAfter(int len, MicroBitSerialMode mode)
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->rxBuffHeadMatch = (rxBuffHead + len) % rxBuffSize;
+    this->rxBuffHeadMatch = rxBuff.size() + len;
+
+    //the characters we need may have already arrived.
+    rxProcessLater();
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -915,8 +1587,11 @@ int MicroBitSerial::eventOn(ManagedString delimeters, MicroBitSerialMode mode)
     if(mode == SYNC_SPINWAIT)
         return MICROBIT_INVALID_PARAMETER;
 
-    //configure our head match...
-    this->delimeters = delimeters;
+    //configure our delimeters...
+    setDelimeters(delimeters);
+
+    //any characters received whilst we had no delimeters have not yet been checked.
+    rxProcessLater();
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -925,6 +1600,50 @@ int MicroBitSerial::eventOn(ManagedString delimeters, MicroBitSerialMode mode)
     return MICROBIT_OK;
 }
 
+/**
+  * Configures an event to be fired on a match with a multi-byte terminator, such as "\r\n".
+  *
+  * Will generate an event with the ID: MICROBIT_ID_SERIAL and the value MICROBIT_SERIAL_EVT_TERMINATOR_MATCH.
+  * Unlike eventOn(), the whole sequence must be received, in order, for a match.
+  * Matches do not overlap: "\r\n\r\n" contains two matches of "\r\n", and "aaaa" two matches of "aa".
+  *
+  * @param terminator the sequence of characters to match received characters against e.g. ManagedString("\r\n"),
+  *        or an empty ManagedString to stop matching.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+  *        gives a different behaviour:
+  *
+  *            ASYNC - Will configure the event and return immediately.
+  *
+  *            SYNC_SPINWAIT - will return MICROBIT_INVALID_PARAMETER
+  *
+  *            SYNC_SLEEP - Will configure the event and block the current fiber until the
+  *                         event is received.
+  *
+  * @return MICROBIT_INVALID_PARAMETER if the mode given is SYNC_SPINWAIT, or the terminator is longer than
+  *         MICROBIT_SERIAL_MAX_TERMINATOR_LENGTH, otherwise MICROBIT_OK.
+  */
+int MicroBitSerial::eventOnTerminator(ManagedString terminator, MicroBitSerialMode mode)
+{
+    if(mode == SYNC_SPINWAIT)
+        return MICROBIT_INVALID_PARAMETER;
+
+    //configure our terminator...
+    int result = setTerminator(terminator.toCharArray(), terminator.length());
+
+    if(result != MICROBIT_OK)
+        return result;
+
+    //any characters received whilst we had no terminator have not yet been checked.
+    rxProcessLater();
+
+    //block!
+    if(mode == SYNC_SLEEP && terminator.length() > 0)
+        fiber_wait_for_event(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_TERMINATOR_MATCH);
+
+    return MICROBIT_OK;
+}
+
 /**
   * Determines whether there is any data waiting in our Rx buffer.
   *
@@ -935,7 +1654,7 @@ int MicroBitSerial::eventOn(ManagedString delimeters, MicroBitSerialMode mode)
   */
 int MicroBitSerial::isReadable()
 {
-    return (rxBuffTail != rxBuffHead) ? 1 : 0;
+    return !rxBuff.isEmpty() ? 1 : 0;
 }
 
 /**
@@ -948,7 +1667,7 @@ int MicroBitSerial::isReadable()
   */
 int MicroBitSerial::isWriteable()
 {
-    return (txBuffHead != (txBuffTail - 1)) ? 1 : 0;
+    return !txBuff.isFull() ? 1 : 0;
 }
 
 /**
@@ -961,13 +1680,10 @@ int MicroBitSerial::isWriteable()
   */
 int MicroBitSerial::setRxBufferSize(uint8_t size)
 {
-    if(rxInUse())
+    if(lockRx() != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockRx();
-
-    // + 1 so there is a usable buffer size, of the size the user requested.
-    this->rxBuffSize = size + 1;
+    this->rxBuffSize = size;
 
     int result = initialiseRx();
 
@@ -986,13 +1702,10 @@ int MicroBitSerial::setRxBufferSize(uint8_t size)
   */
 int MicroBitSerial::setTxBufferSize(uint8_t size)
 {
-    if(txInUse())
+    if(lockTx() != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockTx();
-
-    // + 1 so there is a usable buffer size, of the size the user requested.
-    this->txBuffSize = size + 1;
+    this->txBuffSize = size;
 
     int result = initialiseTx();
 
@@ -1030,12 +1743,10 @@ int MicroBitSerial::getTxBufferSize()
   */
 int MicroBitSerial::clearRxBuffer()
 {
-    if(rxInUse())
+    if(lockRx() != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockRx();
-
-    rxBuffTail = rxBuffHead;
+    rxBuff.clear();
 
     unlockRx();
 
@@ -1051,12 +1762,16 @@ int MicroBitSerial::clearRxBuffer()
   */
 int MicroBitSerial::clearTxBuffer()
 {
-    if(txInUse())
+    if(lockTx() != MICROBIT_OK)
         return MICROBIT_SERIAL_IN_USE;
 
-    lockTx();
+    //stop the transmit interrupt first. It is the consumer of txBuff, and so the only side that may move its tail.
+    detachTx();
 
-    txBuffTail = txBuffHead;
+    //abandon anything still buffered, and any buffer being sent in place, now that the interrupt can no longer reach them.
+    txBuff.clear();
+    txData = NULL;
+    releaseTxData();
 
     unlockTx();
 
@@ -1071,10 +1786,7 @@ int MicroBitSerial::clearTxBuffer()
   */
 int MicroBitSerial::rxBufferedSize()
 {
-    if(rxBuffTail > rxBuffHead)
-        return (rxBuffSize - rxBuffTail) + rxBuffHead;
-
-    return rxBuffHead - rxBuffTail;
+    return rxBuff.size();
 }
 
 /**
@@ -1085,10 +1797,7 @@ int MicroBitSerial::rxBufferedSize()
   */
 int MicroBitSerial::txBufferedSize()
 {
-    if(txBuffTail > txBuffHead)
-        return (txBuffSize - txBuffTail) + txBuffHead;
-
-    return txBuffHead - txBuffTail;
+    return txBuff.size() + (txData != NULL ? txDataLen - txDataOffset : 0);
 }
 
 /**
@@ -1100,7 +1809,7 @@ int MicroBitSerial::txBufferedSize()
   */
 int MicroBitSerial::rxInUse()
 {
-    return (status & MICROBIT_SERIAL_RX_IN_USE);
+    return rxMutex.isLocked();
 }
 
 /**
@@ -1112,7 +1821,40 @@ int MicroBitSerial::rxInUse()
   */
 int MicroBitSerial::txInUse()
 {
-    return (status & MICROBIT_SERIAL_TX_IN_USE);
+    return txMutex.isLocked();
+}
+
+/**
+  * Reads the activity counters of this instance, for example to measure throughput and
+  * interrupt cost when validating changes on real hardware.
+  *
+  * @param stats The structure to populate with the current counters.
+  *
+  * @note Interrupt times are only recorded if MICROBIT_SERIAL_PROFILING is enabled, and are otherwise zero.
+  *
+  * @code
+  * MicroBitSerialStats s;
+  *
+  * serial.resetStats();
+  * // run a loopback test...
+  * serial.getStats(s);
+  * @endcode
+  */
+void MicroBitSerial::getStats(MicroBitSerialStats &stats)
+{
+    __disable_irq();
+    stats = this->stats;
+    __enable_irq();
+}
+
+/**
+  * Resets all the activity counters of this instance to zero.
+  */
+void MicroBitSerial::resetStats()
+{
+    __disable_irq();
+    memclr(&stats, sizeof(stats));
+    __enable_irq();
 }
 
 /**
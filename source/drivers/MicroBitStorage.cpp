@@ -42,8 +42,17 @@ DEALINGS IN THE SOFTWARE.
   */
 MicroBitStorage::MicroBitStorage()
 {
+    pending = NULL;
+    pendingCount = 0;
+
     //initialise our magic block, if required.
-    size();
+    getStorePage();
+
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
+    buildIndex();
+#endif
+
+    discardIncompleteRecords();
 }
 
 /**
@@ -85,148 +94,483 @@ void MicroBitStorage::flashWordWrite(uint32_t * address, uint32_t value)
 }
 
 /**
-  * Function for populating the scratch page with a KeyValueStore.
+  * Determines the number of KeyValuePair records that fit in the storage page.
+  *
+  * @return the capacity of the log, in records.
+  */
+int MicroBitStorage::getCapacity()
+{
+    return (NRF_FICR->CODEPAGESIZE - sizeof(KeyValueStore)) / sizeof(KeyValuePair);
+}
+
+/**
+  * Determines where a given record of the log is held in FLASH.
+  *
+  * @param page the storage or scratch page.
+  *
+  * @param index the position of the record in the log.
+  *
+  * @return a pointer to the record.
+  */
+KeyValuePair* MicroBitStorage::getRecord(uint32_t *page, int index)
+{
+    return (KeyValuePair *)(page + sizeof(KeyValueStore) / 4) + index;
+}
+
+/**
+  * Validates the storage page, returning its address.
+  *
+  * If the page holds no log, it is recovered from the scratch page if a compaction was
+  * interrupted, or formatted as an empty log otherwise.
   *
-  * @param store the KeyValueStore struct to write to the scratch page.
+  * @return the address of the storage page.
   */
-void MicroBitStorage::scratchKeyValueStore(KeyValueStore store)
+uint32_t* MicroBitStorage::getStorePage()
 {
-    //calculate our various offsets
-    uint32_t *s = (uint32_t *) &store;
     uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
+    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
     uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
-    int wordsToWrite = sizeof(KeyValueStore) / 4;
 
-    flashCopy(s, scratchPointer, wordsToWrite);
+    if(((KeyValueStore *)flashBlockPointer)->magic == MICROBIT_STORAGE_MAGIC)
+        return flashBlockPointer;
+
+    flashPageErase(flashBlockPointer);
+
+    //if we were interrupted while copying back a compacted log, finish the job.
+    if(((KeyValueStore *)scratchPointer)->magic == MICROBIT_STORAGE_MAGIC)
+    {
+        flashCopy(scratchPointer + sizeof(KeyValueStore) / 4, flashBlockPointer + sizeof(KeyValueStore) / 4, getCapacity() * sizeof(KeyValuePair) / 4);
+        flashCopy(scratchPointer, flashBlockPointer, sizeof(KeyValueStore) / 4);
+    }
+    else
+    {
+        flashWordWrite(flashBlockPointer, MICROBIT_STORAGE_MAGIC);
+    }
+
+    return flashBlockPointer;
 }
 
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
 /**
-  * Function for populating the scratch page with a KeyValuePair.
+  * Determines the slot of the index used by the given key.
   *
-  * @param pair the KeyValuePair struct to write to the scratch page.
+  * @param key the unique name used to identify a KeyValuePair in flash.
   *
-  * @param flashPointer the pointer in flash where this KeyValuePair resides. This pointer
-  * is used to determine the offset into the scratch page, where the KeyValuePair should
-  * be written.
+  * @return the slot holding the key, or the empty slot it should be placed in, or -1 if the index is full.
   */
-void MicroBitStorage::scratchKeyValuePair(KeyValuePair pair, uint32_t* flashPointer)
+int MicroBitStorage::getIndexSlot(const char *key)
 {
-    //we can only write using words
-    uint32_t *p = (uint32_t *) &pair;
+    uint32_t *page = getStorePage();
+    uint32_t hash = 5381;
 
-    //calculate our various offsets
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
+    for(int i = 0; i < MICROBIT_STORAGE_KEY_SIZE && key[i]; i++)
+        hash = hash * 33 + key[i];
 
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
+    int slot = hash % MICROBIT_STORAGE_INDEX_SIZE;
+
+    //open addressing - step on from the hashed slot until we find the key, or a free slot.
+    for(int i = 0; i < MICROBIT_STORAGE_INDEX_SIZE; i++)
+    {
+        if(keyIndex[slot] == 0 || strncmp((char *)getRecord(page, keyIndex[slot] - 1)->key, key, MICROBIT_STORAGE_KEY_SIZE) == 0)
+            return slot;
+
+        slot = (slot + 1) % MICROBIT_STORAGE_INDEX_SIZE;
+    }
+
+    return -1;
+}
+
+/**
+  * Rebuilds the index from the log held in flash.
+  */
+void MicroBitStorage::buildIndex()
+{
+    uint32_t *page = getStorePage();
+    int end;
+
+    memset(keyIndex, 0, sizeof(keyIndex));
+    indexed = false;
 
-    uint32_t flashPointerOffset = flashPointer - flashBlockPointer;
+    findRecord("", &end);
 
-    scratchPointer += flashPointerOffset;
+    for(int i = 0; i < end; i++)
+    {
+        if(isLive(page, i, end))
+        {
+            int slot = getIndexSlot((char *)getRecord(page, i)->key);
+
+            //if we run out of slots, fall back to searching the log.
+            if(slot < 0)
+                return;
 
-    //KeyValuePair is word aligned...
-    int wordsToWrite = sizeof(KeyValuePair) / 4;
+            keyIndex[slot] = i + 1;
+        }
+    }
 
-    flashCopy(p, scratchPointer, wordsToWrite);
+    logEnd = end;
+    indexed = true;
 }
 
 /**
-  * Places a given key, and it's corresponding value into flash at the earliest
-  * available point.
+  * Determines if the index still describes the log, which may have been changed by another instance.
   *
-  * @param key the unique name that should be used as an identifier for the given data.
-  *            The key is presumed to be null terminated.
+  * @return 1 if the index can be used, 0 otherwise.
+  */
+int MicroBitStorage::isIndexCurrent()
+{
+    uint32_t *page = getStorePage();
+
+    if(!indexed)
+        return 0;
+
+    //the log must end exactly where it did when we last updated the index.
+    if(logEnd < getCapacity() && !isErased(getRecord(page, logEnd)))
+        return 0;
+
+    if(logEnd > 0 && isErased(getRecord(page, logEnd - 1)))
+        return 0;
+
+    return 1;
+}
+#endif
+
+/**
+  * Searches the log for the latest record of the given key.
   *
-  * @param data a pointer to the beginning of the data to be persisted.
+  * @param key the unique name used to identify a KeyValuePair in flash.
   *
-  * @param dataSize the size of the data to be persisted
+  * @param end set to the index of the first unused record in the log.
   *
-  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-  *         MICROBIT_NO_RESOURCES if the storage page is full
+  * @return the index of the latest record holding the key, or -1 if the key is not stored.
   */
-int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
+int MicroBitStorage::findRecord(const char *key, int *end)
 {
-    KeyValuePair pair = KeyValuePair();
+    uint32_t *page = getStorePage();
+    int capacity = getCapacity();
+    int found = -1;
+    int i;
 
-    int keySize = strlen(key) + 1;
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
+    //use the index if we can, but never while it is being built.
+    if(indexed && !isIndexCurrent())
+        buildIndex();
 
-    if(keySize > (int)sizeof(pair.key) || dataSize > (int)sizeof(pair.value) || dataSize < 0)
-        return MICROBIT_INVALID_PARAMETER;
+    if(indexed)
+    {
+        int slot = getIndexSlot(key);
 
-    KeyValuePair *currentValue = get(key);
+        if(end)
+            *end = logEnd;
 
-    int upToDate = currentValue && (memcmp(currentValue->value, data, dataSize) == 0);
+        return (slot >= 0 && keyIndex[slot]) ? keyIndex[slot] - 1 : -1;
+    }
+#endif
 
-    if(currentValue)
-        delete currentValue;
+    for(i = 0; i < capacity; i++)
+    {
+        KeyValuePair *record = getRecord(page, i);
 
-    if(upToDate)
-        return MICROBIT_OK;
+        //the log ends at the first fully erased record.
+        if(record->key[0] == 0xFF && isErased(record))
+            break;
 
-    memcpy(pair.key, key, keySize);
-    memcpy(pair.value, data, dataSize);
+        //a removed key is marked by a record with an empty key, holding the key that was removed.
+        if(record->key[0] == 0 && strncmp((char *)record->value, key, MICROBIT_STORAGE_KEY_SIZE) == 0)
+            found = -1;
 
-    //calculate our various offsets.
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t *flashPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = flashPointer;
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
+        else if(strncmp((char *)record->key, key, MICROBIT_STORAGE_KEY_SIZE) == 0)
+            found = i;
+    }
 
-    uint32_t kvStoreSize = sizeof(KeyValueStore) / 4;
-    uint32_t kvPairSize = sizeof(KeyValuePair) / 4;
+    if(end)
+        *end = i;
 
-    int storeSize = size();
+    return found;
+}
 
-    //our KeyValueStore struct is always at 0
-    flashPointer += kvStoreSize;
+/**
+  * Determines if a record of the log holds the current value of its key.
+  *
+  * @param page the page holding the log.
+  *
+  * @param index the position of the record in the log.
+  *
+  * @param end the index of the first unused record in the log.
+  *
+  * @return 1 if the record is the latest one for a stored key, 0 otherwise.
+  */
+int MicroBitStorage::isLive(uint32_t *page, int index, int end)
+{
+    KeyValuePair *record = getRecord(page, index);
 
-    KeyValuePair storedPair = KeyValuePair();
+    //removals, and records whose key was never completely written, hold no value.
+    if(record->key[0] == 0 || record->key[0] == 0xFF)
+        return 0;
 
-    int found = 0;
+    for(int i = index + 1; i < end; i++)
+    {
+        KeyValuePair *later = getRecord(page, i);
 
-    //erase our scratch page
-    flashPageErase(scratchPointer);
+        if(strncmp((char *)later->key, (char *)record->key, MICROBIT_STORAGE_KEY_SIZE) == 0 ||
+           (later->key[0] == 0 && strncmp((char *)later->value, (char *)record->key, MICROBIT_STORAGE_KEY_SIZE) == 0))
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+  * Determines if a record is completely erased.
+  *
+  * @param record the record to test.
+  *
+  * @return 1 if every word of the record is erased, 0 otherwise.
+  */
+int MicroBitStorage::isErased(KeyValuePair *record)
+{
+    uint32_t *word = (uint32_t *)record;
+
+    for(int i = 0; i < (int)(sizeof(KeyValuePair) / 4); i++)
+        if(word[i] != 0xFFFFFFFF)
+            return 0;
+
+    return 1;
+}
 
-    //iterate through key value pairs in flash, writing them to the scratch page.
-    for(int i = 0; i < storeSize; i++)
+/**
+  * Writes a record to the given slot of the log.
+  *
+  * The value is written before the key, so a record interrupted by a reset is never
+  * mistaken for a valid one.
+  *
+  * @param record the unused slot to write to.
+  *
+  * @param pair the KeyValuePair to store.
+  */
+void MicroBitStorage::writeRecord(KeyValuePair *record, KeyValuePair *pair)
+{
+    flashCopy((uint32_t *)pair->value, (uint32_t *)record->value, sizeof(pair->value) / 4);
+    flashCopy((uint32_t *)pair->key, (uint32_t *)record->key, sizeof(pair->key) / 4);
+}
+
+/**
+  * Determines the key a record applies to.
+  *
+  * @param pair the record.
+  *
+  * @return the key stored, or for a removal, the key removed.
+  */
+const char* MicroBitStorage::getRecordKey(KeyValuePair *pair)
+{
+    return pair->key[0] ? (char *)pair->key : (char *)pair->value;
+}
+
+/**
+  * Determines if a record is superseded by one of a given set of new records.
+  *
+  * @param record the record to test.
+  *
+  * @param pairs the new records.
+  *
+  * @param count the number of new records.
+  *
+  * @return 1 if one of the new records applies to the same key, 0 otherwise.
+  */
+int MicroBitStorage::isReplaced(KeyValuePair *record, KeyValuePair *pairs, int count)
+{
+    for(int i = 0; i < count; i++)
+        if(strncmp((char *)record->key, getRecordKey(&pairs[i]), MICROBIT_STORAGE_KEY_SIZE) == 0)
+            return 1;
+
+    return 0;
+}
+
+/**
+  * Appends records to the log, compacting the log first if they do not fit.
+  *
+  * Several records are preceded by a marker holding their number, so that they are applied
+  * together or not at all. Compaction copies the current value of every key (other than those
+  * being written) into the scratch page, followed by the new records, then copies the result
+  * back to the storage page.
+  *
+  * @param pairs the records to store. Removals hold an empty key, followed by the key removed.
+  *
+  * @param count the number of records.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_RESOURCES if the storage page is full.
+  */
+int MicroBitStorage::appendRecords(KeyValuePair *pairs, int count)
+{
+    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
+    uint32_t *flashBlockPointer = getStorePage();
+    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
+    int capacity = getCapacity();
+    int live = 0;
+    int values = 0;
+    int end;
+
+    findRecord("", &end);
+
+    //the common case - there's room in the log, so just add to the end of it.
+    if(count == 1 && end < capacity)
     {
-        memcpy(&storedPair, flashPointer, sizeof(KeyValuePair));
+        writeRecord(getRecord(flashBlockPointer, end), pairs);
 
-        //check if the keys match...
-        if(strcmp((char *)storedPair.key, (char *)pair.key) == 0)
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
+        //point the index at the new record. Removals are rare, so simply rebuild the index for those.
+        if(indexed && pairs->key[0])
         {
-            found = 1;
-            //scratch our KeyValueStore struct so that it is preserved.
-            scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
-            scratchKeyValuePair(pair, flashPointer);
+            int slot = getIndexSlot((char *)pairs->key);
+
+            logEnd = end + 1;
+
+            if(slot < 0)
+                buildIndex();
+            else
+                keyIndex[slot] = end + 1;
         }
         else
         {
-            scratchKeyValuePair(storedPair, flashPointer);
+            buildIndex();
         }
+#endif
 
-        flashPointer += kvPairSize;
+        return MICROBIT_OK;
     }
 
-    if(!found)
+    //a group of records is preceeded by a marker, so that a group cut short by a reset can be discarded.
+    if(count > 1 && end + count < capacity)
     {
-        //if we haven't got a match for the key, check we can add a new KeyValuePair
-        if(storeSize == (int)((pg_size - kvStoreSize) / MICROBIT_STORAGE_BLOCK_SIZE))
-            return MICROBIT_NO_RESOURCES;
+        KeyValuePair marker = KeyValuePair();
+        marker.value[1] = count;
+
+        writeRecord(getRecord(flashBlockPointer, end), &marker);
 
-        storeSize += 1;
+        for(int i = 0; i < count; i++)
+            writeRecord(getRecord(flashBlockPointer, end + 1 + i), &pairs[i]);
 
-        //scratch our updated values.
-        scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
-        scratchKeyValuePair(pair, flashPointer);
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
+        buildIndex();
+#endif
+
+        return MICROBIT_OK;
     }
 
-    //erase our storage page
-    flashPageErase((uint32_t *)flashBlockPointer);
+    //otherwise, check the compacted log will have room.
+    for(int i = 0; i < count; i++)
+        if(pairs[i].key[0])
+            values++;
 
-    //copy from scratch to storage.
-    flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, kvStoreSize + (storeSize * kvPairSize));
+    for(int i = 0; i < end; i++)
+        if(isLive(flashBlockPointer, i, end) && !isReplaced(getRecord(flashBlockPointer, i), pairs, count))
+            live++;
+
+    if(live + values > capacity)
+        return MICROBIT_NO_RESOURCES;
+
+    //compact the log into our scratch page, placing the KeyValueStore struct last to mark it complete.
+    flashPageErase(scratchPointer);
+
+    live = 0;
+
+    for(int i = 0; i < end; i++)
+    {
+        KeyValuePair *record = getRecord(flashBlockPointer, i);
+
+        if(isLive(flashBlockPointer, i, end) && !isReplaced(record, pairs, count))
+            writeRecord(getRecord(scratchPointer, live++), record);
+    }
+
+    for(int i = 0; i < count; i++)
+        if(pairs[i].key[0])
+            writeRecord(getRecord(scratchPointer, live++), &pairs[i]);
+
+    flashWordWrite(scratchPointer, MICROBIT_STORAGE_MAGIC);
+
+    //then copy it back to the storage page, again leaving the KeyValueStore struct until last.
+    flashPageErase(flashBlockPointer);
+    flashCopy(scratchPointer + sizeof(KeyValueStore) / 4, flashBlockPointer + sizeof(KeyValueStore) / 4, live * sizeof(KeyValuePair) / 4);
+    flashWordWrite(flashBlockPointer, MICROBIT_STORAGE_MAGIC);
+
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
+    buildIndex();
+#endif
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Discards a group of records left incomplete at the end of the log, such as by a reset during commit().
+  * The records are cleared to zero, which needs no erase, and is ignored when reading the log.
+  */
+void MicroBitStorage::discardIncompleteRecords()
+{
+    uint32_t *flashBlockPointer = getStorePage();
+    uint32_t zero[sizeof(KeyValuePair) / 4];
+    int end;
+
+    memset(zero, 0, sizeof(zero));
+    findRecord("", &end);
+
+    for(int i = 0; i < end; i++)
+    {
+        KeyValuePair *record = getRecord(flashBlockPointer, i);
+
+        //a marker has an empty key and value, followed by the number of records in its group.
+        if(record->key[0] == 0 && record->value[0] == 0 && record->value[1] != 0)
+        {
+            if(i + record->value[1] < end)
+            {
+                i += record->value[1];
+                continue;
+            }
+
+            while(i < end)
+                flashCopy(zero, (uint32_t *)getRecord(flashBlockPointer, i++), sizeof(KeyValuePair) / 4);
+
+#if MICROBIT_STORAGE_INDEX_SIZE > 0
+            buildIndex();
+#endif
+        }
+    }
+}
+
+/**
+  * Finds the change to the given key held in the current transaction.
+  *
+  * @param key the unique name used to identify a KeyValuePair in flash.
+  *
+  * @return the pending record for the key, or NULL if there is none.
+  */
+KeyValuePair* MicroBitStorage::getPendingRecord(const char *key)
+{
+    for(int i = 0; i < pendingCount; i++)
+        if(strncmp(getRecordKey(&pending[i]), key, MICROBIT_STORAGE_KEY_SIZE) == 0)
+            return &pending[i];
+
+    return NULL;
+}
+
+/**
+  * Adds a change to the current transaction, replacing any earlier change to the same key.
+  *
+  * @param pair the new record.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_RESOURCES if the transaction is full.
+  */
+int MicroBitStorage::addPendingRecord(KeyValuePair *pair)
+{
+    KeyValuePair *record = getPendingRecord(getRecordKey(pair));
+
+    if(record == NULL)
+    {
+        if(pendingCount == MICROBIT_STORAGE_TRANSACTION_SIZE)
+            return MICROBIT_NO_RESOURCES;
+
+        record = &pending[pendingCount++];
+    }
+
+    memcpy(record, pair, sizeof(KeyValuePair));
 
     return MICROBIT_OK;
 }
@@ -236,12 +580,49 @@ int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
   * available point.
   *
   * @param key the unique name that should be used as an identifier for the given data.
+  *            The key is presumed to be null terminated.
   *
   * @param data a pointer to the beginning of the data to be persisted.
   *
   * @param dataSize the size of the data to be persisted
   *
-  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is empty or the key or size is too large,
+  *         MICROBIT_NO_RESOURCES if the storage page is full
+  */
+int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
+{
+    KeyValuePair pair = KeyValuePair();
+
+    int keySize = strlen(key) + 1;
+
+    if(keySize == 1 || keySize > (int)sizeof(pair.key) || dataSize > (int)sizeof(pair.value) || dataSize < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    const KeyValuePair *currentValue = find(key);
+
+    if(currentValue && memcmp(currentValue->value, data, dataSize) == 0)
+        return MICROBIT_OK;
+
+    memcpy(pair.key, key, keySize);
+    memcpy(pair.value, data, dataSize);
+
+    if(pending)
+        return addPendingRecord(&pair);
+
+    return appendRecords(&pair, 1);
+}
+
+/**
+  * Places a given key, and it's corresponding value into flash at the earliest
+  * available point.
+  *
+  * @param key the unique name that should be used as an identifier for the given data.
+  *
+  * @param data a pointer to the beginning of the data to be persisted.
+  *
+  * @param dataSize the size of the data to be persisted
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is empty or the key or size is too large,
   *         MICROBIT_NO_RESOURCES if the storage page is full
   */
 int MicroBitStorage::put(ManagedString key, uint8_t* data, int dataSize)
@@ -261,42 +642,15 @@ int MicroBitStorage::put(ManagedString key, uint8_t* data, int dataSize)
   */
 KeyValuePair* MicroBitStorage::get(const char* key)
 {
-    //calculate our offsets for our storage page
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
-
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
-
-    int storeSize = size();
+    const KeyValuePair *stored = find(key);
 
     //we haven't got anything stored, so return...
-    if(storeSize == 0)
+    if(stored == NULL)
         return NULL;
 
-    //our KeyValueStore struct is always at 0
-    flashBlockPointer += sizeof(KeyValueStore) / 4;
-
     KeyValuePair *pair = new KeyValuePair();
 
-    int i;
-
-    //iterate through flash until we have a match, or drop out.
-    for(i = 0; i < storeSize; i++)
-    {
-        memcpy(pair, flashBlockPointer, sizeof(KeyValuePair));
-
-        if(strcmp(key,(char *)pair->key) == 0)
-            break;
-
-        flashBlockPointer += sizeof(KeyValuePair) / 4;
-    }
-
-    //clean up
-    if(i == storeSize)
-    {
-        delete pair;
-        return NULL;
-    }
+    memcpy(pair, stored, sizeof(KeyValuePair));
 
     return pair;
 }
@@ -317,75 +671,78 @@ KeyValuePair* MicroBitStorage::get(ManagedString key)
 }
 
 /**
-  * Removes a KeyValuePair identified by a given key.
+  * Retreives a KeyValuePair identified by a given key, without allocating memory.
   *
   * @param key the unique name used to identify a KeyValuePair in flash.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-  *         was not found in flash.
+  * @param pair the buffer to copy the KeyValuePair into.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the key was not found in storage.
   */
-int MicroBitStorage::remove(const char* key)
+int MicroBitStorage::get(const char* key, KeyValuePair *pair)
 {
-    //calculate our various offsets
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t *flashPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = flashPointer;
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
+    const KeyValuePair *stored = find(key);
 
-    uint32_t kvStoreSize = sizeof(KeyValueStore) / 4;
-    uint32_t kvPairSize = sizeof(KeyValuePair) / 4;
+    if(stored == NULL)
+        return MICROBIT_NO_DATA;
 
-    int storeSize = size();
+    memcpy(pair, stored, sizeof(KeyValuePair));
 
-    //if we have no data, we have nothing to do.
-    if(storeSize == 0)
-        return MICROBIT_NO_DATA;
+    return MICROBIT_OK;
+}
 
-    //our KeyValueStore struct is always at 0
-    flashPointer += kvStoreSize;
-    scratchPointer += kvStoreSize;
+/**
+  * Finds a KeyValuePair identified by a given key, in place in flash.
+  *
+  * @param key the unique name used to identify a KeyValuePair in flash.
+  *
+  * @return a pointer to the KeyValuePair in flash, or NULL if the key was not found in storage.
+  *
+  * @note the pointer is only valid until the next put() or remove().
+  */
+const KeyValuePair* MicroBitStorage::find(const char* key)
+{
+    //changes in an open transaction take precedence over flash.
+    if(pending)
+    {
+        KeyValuePair *record = getPendingRecord(key);
 
-    KeyValuePair storedPair = KeyValuePair();
+        if(record)
+            return record->key[0] ? record : NULL;
+    }
 
-    int found = 0;
+    int position = findRecord(key, NULL);
 
-    //set up our scratch area
-    flashPageErase(scratchPointer);
+    if(position < 0)
+        return NULL;
 
-    //iterate through our flash copy pairs to scratch, unless there is a key patch
-    for(int i = 0; i < storeSize; i++)
-    {
-        memcpy(&storedPair, flashPointer, sizeof(KeyValuePair));
+    return getRecord(getStorePage(), position);
+}
 
-        //if we have a match, don't increment our scratchPointer
-        if(strcmp((char *)storedPair.key, (char *)key) == 0)
-        {
-            found = 1;
-            //write our new KeyValueStore data
-            scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize - 1));
-        }
-        else
-        {
-            //otherwise copy the KeyValuePair from our storage page.
-            flashCopy(flashPointer, scratchPointer, sizeof(KeyValuePair) / 4);
-            scratchPointer += sizeof(KeyValuePair) / 4;
-        }
+/**
+  * Removes a KeyValuePair identified by a given key.
+  *
+  * @param key the unique name used to identify a KeyValuePair in flash.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
+  *         was not found in flash.
+  */
+int MicroBitStorage::remove(const char* key)
+{
+    KeyValuePair pair = KeyValuePair();
 
-        flashPointer += sizeof(KeyValuePair) / 4;
-    }
+    int keySize = strlen(key) + 1;
 
-    //if we haven't got a match, write our old KeyValueStore struct
-    if(!found)
-    {
-        scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
+    if(keySize > (int)sizeof(pair.key) || find(key) == NULL)
         return MICROBIT_NO_DATA;
-    }
 
-    //copy scratch to our storage page
-    flashPageErase((uint32_t *)flashBlockPointer);
-    flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, kvStoreSize + (storeSize * kvPairSize));
+    //record the removal with an empty key, holding the key being removed.
+    memcpy(pair.value, key, keySize);
 
-    return MICROBIT_OK;
+    if(pending)
+        return addPendingRecord(&pair);
+
+    return appendRecords(&pair, 1);
 }
 
 /**
@@ -402,36 +759,75 @@ int MicroBitStorage::remove(ManagedString key)
 }
 
 /**
-  * The size of the flash based KeyValueStore.
+  * Starts a transaction. Subsequent calls to put() and remove() are held in RAM, and applied
+  * to flash together by commit(), in a single log append or page rewrite. Either all of the
+  * changes are stored, or, if a reset interrupts commit(), none of them are.
   *
-  * @return the number of entries in the key value store
+  * Values written in the transaction are returned by get() and find() until it is committed.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if a transaction is already open,
+  *         or MICROBIT_NO_RESOURCES if there is not enough memory.
+  *
+  * @code
+  * storage.begin();
+  * storage.put("x", (uint8_t *)&x, sizeof(x));
+  * storage.put("y", (uint8_t *)&y, sizeof(y));
+  * storage.commit();
+  * @endcode
   */
-int MicroBitStorage::size()
+int MicroBitStorage::begin()
 {
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
+    if(pending)
+        return MICROBIT_NOT_SUPPORTED;
 
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
+    pending = new KeyValuePair[MICROBIT_STORAGE_TRANSACTION_SIZE];
 
-    KeyValueStore store = KeyValueStore();
+    if(pending == NULL)
+        return MICROBIT_NO_RESOURCES;
 
-    //read our data!
-    memcpy(&store, flashBlockPointer, sizeof(KeyValueStore));
+    pendingCount = 0;
 
-    //if we haven't used flash before, we need to configure it
-    if(store.magic != MICROBIT_STORAGE_MAGIC)
-    {
-        store.magic = MICROBIT_STORAGE_MAGIC;
-        store.size = 0;
+    return MICROBIT_OK;
+}
+
+/**
+  * Applies every change made since begin() to flash, and closes the transaction.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if no transaction is open,
+  *         or MICROBIT_NO_RESOURCES if the storage page is full, in which case no changes are made.
+  */
+int MicroBitStorage::commit()
+{
+    int result = MICROBIT_OK;
+
+    if(pending == NULL)
+        return MICROBIT_INVALID_PARAMETER;
 
-        //erase the scratch page and write our new KeyValueStore
-        flashPageErase((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)));
-        scratchKeyValueStore(store);
+    if(pendingCount)
+        result = appendRecords(pending, pendingCount);
 
-        //erase flash, and copy the scratch page over
-        flashPageErase((uint32_t *)flashBlockPointer);
-        flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, pg_size/4);
-    }
+    delete[] pending;
+    pending = NULL;
+    pendingCount = 0;
+
+    return result;
+}
+
+/**
+  * The size of the flash based KeyValueStore.
+  *
+  * @return the number of entries in the key value store
+  */
+int MicroBitStorage::size()
+{
+    uint32_t *flashBlockPointer = getStorePage();
+    int storeSize = 0;
+    int end;
+
+    findRecord("", &end);
+
+    for(int i = 0; i < end; i++)
+        storeSize += isLive(flashBlockPointer, i, end);
 
-    return store.size;
+    return storeSize;
 }
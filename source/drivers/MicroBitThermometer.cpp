@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitThermometer.h"
 #include "MicroBitSystemTimer.h"
 #include "MicroBitFiber.h"
+#include "MicroBitTrace.h"
 
 /*
  * The underlying Nordic libraries that support BLE do not compile cleanly with the stringent GCC settings we employ
@@ -50,6 +51,33 @@ DEALINGS IN THE SOFTWARE.
 #pragma GCC diagnostic pop
 #endif
 
+MicroBitThermometer* MicroBitThermometer::instance = NULL;
+
+/**
+  * Interrupt handler for the temperature sensor.
+  */
+extern "C" void TEMP_IRQHandler(void)
+{
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_ENTER, MICROBIT_TRACE_ISR_TEMP, 0);
+
+    if(MicroBitThermometer::instance)
+        MicroBitThermometer::instance->onConversion();
+
+    MICROBIT_TRACE_RECORD(MICROBIT_TRACE_ISR_EXIT, MICROBIT_TRACE_ISR_TEMP, 0);
+}
+
+/**
+  * Determines the interval at which the idle thread need call us, for a given sample period.
+  *
+  * @param period The time between samples, in milliseconds.
+  *
+  * @return The interval to register with fiber_add_idle_component().
+  */
+static uint16_t idleInterval(uint32_t period)
+{
+    return period < MICROBIT_IDLE_ON_DEMAND ? period : MICROBIT_IDLE_ON_DEMAND - 1;
+}
+
 /**
   * Constructor.
   * Create new MicroBitThermometer that gives an indication of the current temperature.
@@ -70,6 +98,7 @@ MicroBitThermometer::MicroBitThermometer(MicroBitStorage& _storage, uint16_t id)
     this->samplePeriod = MICROBIT_THERMOMETER_PERIOD;
     this->sampleTime = 0;
     this->offset = 0;
+    this->temperature = MICROBIT_THERMOMETER_NO_SAMPLE;
 
     KeyValuePair *tempCalibration =  storage->get("tempCal");
 
@@ -97,6 +126,7 @@ MicroBitThermometer::MicroBitThermometer(uint16_t id) :
     this->samplePeriod = MICROBIT_THERMOMETER_PERIOD;
     this->sampleTime = 0;
     this->offset = 0;
+    this->temperature = MICROBIT_THERMOMETER_NO_SAMPLE;
 }
 
 /**
@@ -111,6 +141,8 @@ MicroBitThermometer::MicroBitThermometer(uint16_t id) :
 int MicroBitThermometer::getTemperature()
 {
     updateSample();
+    waitForSample();
+
     return temperature - offset;
 }
 
@@ -122,6 +154,9 @@ int MicroBitThermometer::getTemperature()
   * This call also will add the thermometer to fiber components to receive
   * periodic callbacks.
   *
+  * Unless Bluetooth is enabled, this only starts a conversion and returns immediately.
+  * The new sample is recorded from the sensor's interrupt, which raises MICROBIT_THERMOMETER_EVT_UPDATE.
+  *
   * @return MICROBIT_OK on success.
   */
 int MicroBitThermometer::updateSample()
@@ -130,14 +165,14 @@ int MicroBitThermometer::updateSample()
     {
         // If we're running under a fiber scheduer, register ourselves for a periodic callback to keep our data up to date.
         // Otherwise, we do just do this on demand, when polled through our read() interface.
-        fiber_add_idle_component(this);
+        // We need only be called once per sample period.
+        fiber_add_idle_component(this, idleInterval(samplePeriod));
         status |= MICROBIT_THERMOMETER_ADDED_TO_IDLE;
     }
 
-    // check if we need to update our sample...
-    if(isSampleNeeded())
+    // check if we need to update our sample, and that we're not already doing so...
+    if(isSampleNeeded() && !(status & MICROBIT_THERMOMETER_SAMPLING))
     {
-        int32_t processorTemperature;
         uint8_t sd_enabled;
 
         // For now, we just rely on the nrf senesor to be the most accurate.
@@ -148,38 +183,76 @@ int MicroBitThermometer::updateSample()
 
         if (sd_enabled)
         {
-            // If Bluetooth is enabled, we need to go through the Nordic software to safely do this
+            // If Bluetooth is enabled, we need to go through the Nordic software to safely do this.
+            // The SoftDevice owns the sensor, so this conversion is made synchronously.
+            int32_t processorTemperature;
+
             sd_temp_get(&processorTemperature);
+            recordSample(processorTemperature);
         }
         else
         {
-            // Othwerwise, we access the information directly...
-            uint32_t *TEMP = (uint32_t *)0x4000C508;
+            // Othwerwise, we start a conversion directly, and collect the result in onConversion().
+            status |= MICROBIT_THERMOMETER_SAMPLING;
+            instance = this;
+
+            NRF_TEMP->EVENTS_DATARDY = 0;
+            NRF_TEMP->INTENSET = TEMP_INTENSET_DATARDY_Msk;
+            NVIC_ClearPendingIRQ(TEMP_IRQn);
+            NVIC_EnableIRQ(TEMP_IRQn);
 
             NRF_TEMP->TASKS_START = 1;
+        }
+    }
 
-            while (NRF_TEMP->EVENTS_DATARDY == 0);
+    return MICROBIT_OK;
+};
 
-            NRF_TEMP->EVENTS_DATARDY = 0;
+/**
+  * Interrupt handler for the temperature sensor. Records the result of the conversion
+  * started by updateSample(), and raises MICROBIT_THERMOMETER_EVT_UPDATE.
+  */
+void MicroBitThermometer::onConversion()
+{
+    uint32_t *TEMP = (uint32_t *)0x4000C508;
 
-            processorTemperature = *TEMP;
+    NRF_TEMP->EVENTS_DATARDY = 0;
+    NRF_TEMP->INTENCLR = TEMP_INTENSET_DATARDY_Msk;
 
-            NRF_TEMP->TASKS_STOP = 1;
-        }
+    int32_t processorTemperature = *TEMP;
 
+    NRF_TEMP->TASKS_STOP = 1;
 
-        // Record our reading...
-        temperature = processorTemperature / 4;
+    status &= ~MICROBIT_THERMOMETER_SAMPLING;
+    recordSample(processorTemperature);
+}
+
+/**
+  * Records a new reading from the temperature sensor, schedules the next, and raises
+  * MICROBIT_THERMOMETER_EVT_UPDATE.
+  *
+  * @param processorTemperature The raw reading, in units of 0.25 degrees celsius.
+  */
+void MicroBitThermometer::recordSample(int32_t processorTemperature)
+{
+    // Record our reading...
+    temperature = processorTemperature / 4;
 
-        // Schedule our next sample.
-        sampleTime = system_timer_current_time() + samplePeriod;
+    // Schedule our next sample.
+    sampleTime = system_timer_current_time() + samplePeriod;
 
-        // Send an event to indicate that we'e updated our temperature.
-        MicroBitEvent e(id, MICROBIT_THERMOMETER_EVT_UPDATE);
-    }
+    // Send an event to indicate that we'e updated our temperature.
+    MicroBitEvent e(id, MICROBIT_THERMOMETER_EVT_UPDATE);
+}
 
-    return MICROBIT_OK;
-};
+/**
+  * Waits for the first conversion to complete, if no temperature has yet been read.
+  * A conversion takes tens of microseconds, so this only ever delays the very first reading.
+  */
+void MicroBitThermometer::waitForSample()
+{
+    while (temperature == MICROBIT_THERMOMETER_NO_SAMPLE && (status & MICROBIT_THERMOMETER_SAMPLING));
+}
 
 /**
   * Periodic callback from MicroBit idle thread.
@@ -213,6 +286,9 @@ void MicroBitThermometer::setPeriod(int period)
 {
     updateSample();
     samplePeriod = period;
+
+    // Update the interval at which the idle thread calls us.
+    fiber_add_idle_component(this, idleInterval(samplePeriod));
 }
 
 /**
@@ -264,5 +340,7 @@ int MicroBitThermometer::getOffset()
 int MicroBitThermometer::setCalibration(int calibrationTemp)
 {
     updateSample();
+    waitForSample();
+
     return setOffset(temperature - calibrationTemp);
 }
@@ -0,0 +1,399 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  * Class definition for MicroBitTouchSensor.
+  *
+  * Measures the capacitance of a set of pins by the time each takes to charge through its pull up resistor.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitTouchSensor.h"
+#include "MicroBitButton.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitEvent.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * Create a representation of a touch sensor, with no pins.
+  *
+  * @param id the unique EventModel id of this component. Defaults to MICROBIT_ID_TOUCH_SENSOR.
+  *
+  * @code
+  * MicroBitTouchSensor touch;
+  * @endcode
+  */
+MicroBitTouchSensor::MicroBitTouchSensor(uint16_t id)
+{
+    this->id = id;
+    this->count = 0;
+    this->thresholdHi = MICROBIT_TOUCH_SENSOR_THRESHOLD_HI;
+    this->thresholdLo = MICROBIT_TOUCH_SENSOR_THRESHOLD_LO;
+    this->period = 1;
+
+    setPeriod(MICROBIT_TOUCH_SENSOR_PERIOD);
+}
+
+/**
+  * Determines the channel measuring the given pin.
+  *
+  * @param name The pin.
+  *
+  * @return The channel, or NULL if the pin is not measured.
+  */
+MicroBitTouchChannel* MicroBitTouchSensor::getChannel(PinName name)
+{
+    for (int i = 0; i < count; i++)
+        if (channels[i].name == name)
+            return &channels[i];
+
+    return NULL;
+}
+
+/**
+  * Adds a pin to the set of pins measured. The pin is configured as an input with no pull, and its baseline
+  * is taken from the first measurement, so it should not be touched until then.
+  *
+  * @param name The pin to measure.
+  *
+  * @param id The id used for the events of this pin, typically that of the MicroBitPin.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if MICROBIT_TOUCH_SENSOR_MAX_PINS pins are already measured.
+  *
+  * @code
+  * touch.addPin(MICROBIT_PIN_P0, MICROBIT_ID_IO_P0);
+  * @endcode
+  */
+int MicroBitTouchSensor::addPin(PinName name, uint16_t id)
+{
+    MicroBitTouchChannel *c = getChannel(name);
+
+    if (c != NULL)
+    {
+        c->id = id;
+        return MICROBIT_OK;
+    }
+
+    if (count == MICROBIT_TOUCH_SENSOR_MAX_PINS)
+        return MICROBIT_NO_RESOURCES;
+
+    // Begin measuring with the first pin.
+    if (count == 0 && system_timer_add_component(this, period) != MICROBIT_OK)
+        return MICROBIT_NO_RESOURCES;
+
+    NRF_GPIO->PIN_CNF[name] = (GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos) |
+                              (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos) |
+                              (GPIO_PIN_CNF_PULL_Disabled << GPIO_PIN_CNF_PULL_Pos);
+
+    c = &channels[count];
+    c->name = name;
+    c->id = id;
+    c->reading = 0;
+    c->baseline = 0;
+    c->state = 0;
+    c->downStartTime = 0;
+
+    // The channel is complete before it is counted, so the timer interrupt never sees it half written.
+    count++;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Removes a pin from the set of pins measured.
+  *
+  * @param name The pin.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+  */
+int MicroBitTouchSensor::removePin(PinName name)
+{
+    MicroBitTouchChannel *c = getChannel(name);
+
+    if (c == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+
+    *c = channels[count - 1];
+    count--;
+
+    __enable_irq();
+
+    if (count == 0)
+        system_timer_remove_component(this);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Tests if the given pin is currently touched.
+  *
+  * @param name The pin.
+  *
+  * @return 1 if the pin is touched, 0 if not, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+  *
+  * @code
+  * if (touch.isTouched(MICROBIT_PIN_P0))
+  *     display.scroll("Touched!");
+  * @endcode
+  */
+int MicroBitTouchSensor::isTouched(PinName name)
+{
+    MicroBitTouchChannel *c = getChannel(name);
+
+    if (c == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return c->state & MICROBIT_BUTTON_STATE ? 1 : 0;
+}
+
+/**
+  * Retrieves the most recent charge time of the given pin. This, with getBaseline(), is useful when tuning thresholds.
+  *
+  * @param name The pin.
+  *
+  * @return The charge time, in iterations of the measurement loop, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+  */
+int MicroBitTouchSensor::getReading(PinName name)
+{
+    MicroBitTouchChannel *c = getChannel(name);
+
+    if (c == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return c->reading;
+}
+
+/**
+  * Retrieves the untouched charge time of the given pin.
+  *
+  * @param name The pin.
+  *
+  * @return The baseline charge time, in iterations of the measurement loop, or MICROBIT_INVALID_PARAMETER if the pin is not measured.
+  */
+int MicroBitTouchSensor::getBaseline(PinName name)
+{
+    MicroBitTouchChannel *c = getChannel(name);
+
+    if (c == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return c->baseline >> MICROBIT_TOUCH_SENSOR_BASELINE_SHIFT;
+}
+
+/**
+  * Sets the time between measurements.
+  *
+  * @param period The time between measurements, in milliseconds. This is rounded to a whole number of system ticks.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if period is not positive.
+  */
+int MicroBitTouchSensor::setPeriod(int period)
+{
+    if (period <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int tick = system_timer_get_period();
+
+    if (tick <= 0)
+        tick = SYSTEM_TICK_PERIOD_MS;
+
+    int ticks = (period + tick / 2) / tick;
+
+    this->period = ticks > 0 ? ticks : 1;
+
+    // Register again, so that the new period takes effect.
+    if (count > 0)
+    {
+        system_timer_remove_component(this);
+        system_timer_add_component(this, this->period);
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Retrieves the time between measurements.
+  *
+  * @return The time between measurements, in milliseconds.
+  */
+int MicroBitTouchSensor::getPeriod()
+{
+    int tick = system_timer_get_period();
+
+    if (tick <= 0)
+        tick = SYSTEM_TICK_PERIOD_MS;
+
+    return period * tick;
+}
+
+/**
+  * Sets the thresholds at which pins are touched and released.
+  *
+  * @param hi The percentage increase in charge time over the baseline at which a pin becomes touched.
+  *
+  * @param lo The percentage increase in charge time over the baseline below which a touched pin is released.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER unless 0 <= lo < hi <= 255.
+  *
+  * @code
+  * // Make the pins more sensitive.
+  * touch.setThreshold(20, 10);
+  * @endcode
+  */
+int MicroBitTouchSensor::setThreshold(int hi, int lo)
+{
+    if (lo < 0 || lo >= hi || hi > 255)
+        return MICROBIT_INVALID_PARAMETER;
+
+    thresholdHi = hi;
+    thresholdLo = lo;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the charge time of every pin, in a single pass.
+  */
+void MicroBitTouchSensor::measure()
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < count; i++)
+        mask |= 1 << channels[i].name;
+
+    // Discharge every pin to GND.
+    NRF_GPIO->OUTCLR = mask;
+    NRF_GPIO->DIRSET = mask;
+    wait_us(MICROBIT_TOUCH_SENSOR_DISCHARGE_TIME);
+
+    // Release them together, and note the iteration at which each is seen to have charged.
+    uint32_t pending = mask;
+    uint32_t t = 1;
+
+    NRF_GPIO->DIRCLR = mask;
+
+    while (pending && t < MICROBIT_TOUCH_SENSOR_TIMEOUT)
+    {
+        uint32_t charged = NRF_GPIO->IN & pending;
+
+        if (charged)
+        {
+            for (int i = 0; i < count; i++)
+                if (charged & (1 << channels[i].name))
+                    channels[i].reading = t;
+
+            pending &= ~charged;
+        }
+
+        t++;
+    }
+
+    for (int i = 0; i < count; i++)
+        if (pending & (1 << channels[i].name))
+            channels[i].reading = MICROBIT_TOUCH_SENSOR_TIMEOUT;
+}
+
+/**
+  * Updates the baseline and touch state of the given channel from its latest reading, raising events on any change.
+  *
+  * @param c The channel.
+  */
+void MicroBitTouchSensor::update(MicroBitTouchChannel &c)
+{
+    // The first reading of a pin is taken as its baseline.
+    if (c.baseline == 0)
+    {
+        c.baseline = (uint32_t)c.reading << MICROBIT_TOUCH_SENSOR_BASELINE_SHIFT;
+        return;
+    }
+
+    uint32_t baseline = c.baseline >> MICROBIT_TOUCH_SENSOR_BASELINE_SHIFT;
+    uint32_t hi = baseline + (baseline * thresholdHi) / 100 + 1;
+    uint32_t lo = baseline + (baseline * thresholdLo) / 100;
+
+    if (!(c.state & MICROBIT_BUTTON_STATE))
+    {
+        if (c.reading >= hi || c.reading >= MICROBIT_TOUCH_SENSOR_TIMEOUT)
+        {
+            c.state = MICROBIT_BUTTON_STATE;
+            c.downStartTime = system_timer_current_time();
+            MicroBitEvent evt(c.id, MICROBIT_BUTTON_EVT_DOWN);
+        }
+        else
+        {
+            // Follow slow drift whilst untouched, as a moving average.
+            c.baseline = c.baseline - baseline + c.reading;
+        }
+
+        return;
+    }
+
+    if (c.reading <= lo)
+    {
+        c.state = 0;
+        MicroBitEvent evt(c.id, MICROBIT_BUTTON_EVT_UP);
+
+        if ((system_timer_current_time() - c.downStartTime) >= MICROBIT_BUTTON_LONG_CLICK_TIME)
+            MicroBitEvent evt(c.id, MICROBIT_BUTTON_EVT_LONG_CLICK);
+        else
+            MicroBitEvent evt(c.id, MICROBIT_BUTTON_EVT_CLICK);
+
+        return;
+    }
+
+    if (!(c.state & MICROBIT_BUTTON_STATE_HOLD_TRIGGERED) && (system_timer_current_time() - c.downStartTime) >= MICROBIT_BUTTON_HOLD_TIME)
+    {
+        c.state |= MICROBIT_BUTTON_STATE_HOLD_TRIGGERED;
+        MicroBitEvent evt(c.id, MICROBIT_BUTTON_EVT_HOLD);
+    }
+}
+
+/**
+  * Periodic callback from MicroBit system timer.
+  *
+  * Measures every pin, and raises events on any change.
+  */
+void MicroBitTouchSensor::systemTick()
+{
+    if (count == 0)
+        return;
+
+    measure();
+
+    for (int i = 0; i < count; i++)
+        update(channels[i]);
+}
+
+/**
+  * Destructor, where we deregister this instance from the system timer.
+  */
+MicroBitTouchSensor::~MicroBitTouchSensor()
+{
+    system_timer_remove_component(this);
+}
@@ -24,6 +24,15 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 #include "TimedInterruptIn.h"
+#include "DynamicPwm.h"
+#include "MicroBitDevice.h"
+#include "MicroBitFiber.h"
+#include "ErrorNo.h"
+#include "nrf_soc.h"
+
+// The instance currently using hardware capture, if any.
+static TimedInterruptIn *captureOwner = NULL;
+
 /**
   * Constructor.
   *
@@ -31,7 +40,10 @@ DEALINGS IN THE SOFTWARE.
   */
 TimedInterruptIn::TimedInterruptIn(PinName name) : InterruptIn(name)
 {
-    timestamp = 0;
+    this->timestamp = 0;
+    this->name = name;
+    this->edgeCount = 0;
+    this->windowCount = 0;
 }
 
 /**
@@ -53,3 +65,127 @@ uint64_t TimedInterruptIn::getTimestamp()
 {
     return timestamp;
 }
+
+/**
+  * Enables hardware capture. Each edge on the pin is timestamped by TIMER1 via GPIOTE and PPI, free of
+  * interrupt latency. The rise and fall handlers can then record the edge with captureEdge().
+  *
+  * Only one instance may use hardware capture at a time, and not whilst TIMER1 is generating software PWM channels.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_BUSY if another instance is using hardware capture or TIMER1 is in use
+  *         by DynamicPwm, MICROBIT_NO_RESOURCES if the edge buffer could not be allocated, or MICROBIT_NOT_SUPPORTED
+  *         if MICROBIT_PIN_CAPTURE is disabled.
+  */
+int TimedInterruptIn::enableCapture()
+{
+#if !CONFIG_ENABLED(MICROBIT_PIN_CAPTURE)
+    return MICROBIT_NOT_SUPPORTED;
+#else
+    if (captureOwner == this)
+        return MICROBIT_OK;
+
+    if (captureOwner != NULL || DynamicPwm::getSoftwareChannelsInUse() > 0)
+        return MICROBIT_BUSY;
+
+    if (edges.resize(MICROBIT_PIN_CAPTURE_BUFFER_SIZE) != MICROBIT_OK)
+        return MICROBIT_NO_RESOURCES;
+
+    captureOwner = this;
+
+    // Captured times are only as accurate as the clock, so keep the crystal running while the processor sleeps.
+    scheduler_idle_hold();
+
+    // Run TIMER1 freely at 1MHz, so that captured values are in microseconds.
+    NRF_TIMER1->TASKS_STOP = 1;
+    NRF_TIMER1->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER1->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    NRF_TIMER1->PRESCALER = 4;
+    NRF_TIMER1->TASKS_CLEAR = 1;
+    NRF_TIMER1->TASKS_START = 1;
+
+    // Raise a GPIOTE event on each edge of the pin. The port event used by InterruptIn is unaffected.
+    NRF_GPIOTE->CONFIG[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) |
+                                                              ((uint32_t)name << GPIOTE_CONFIG_PSEL_Pos) |
+                                                              (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+
+    // Capture the timer on each such event. The PPI is protected whilst the SoftDevice is enabled.
+    if (ble_running())
+    {
+        sd_ppi_channel_assign(MICROBIT_PIN_CAPTURE_PPI_CHANNEL, &NRF_GPIOTE->EVENTS_IN[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL], &NRF_TIMER1->TASKS_CAPTURE[0]);
+        sd_ppi_channel_enable_set(1 << MICROBIT_PIN_CAPTURE_PPI_CHANNEL);
+    }
+    else
+    {
+        NRF_PPI->CH[MICROBIT_PIN_CAPTURE_PPI_CHANNEL].EEP = (uint32_t)&NRF_GPIOTE->EVENTS_IN[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL];
+        NRF_PPI->CH[MICROBIT_PIN_CAPTURE_PPI_CHANNEL].TEP = (uint32_t)&NRF_TIMER1->TASKS_CAPTURE[0];
+        NRF_PPI->CHENSET = 1 << MICROBIT_PIN_CAPTURE_PPI_CHANNEL;
+    }
+
+    return MICROBIT_OK;
+#endif
+}
+
+/**
+  * Disables hardware capture, releasing the timer, GPIOTE and PPI channels for use by another instance.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if this instance is not using hardware capture.
+  */
+int TimedInterruptIn::disableCapture()
+{
+    if (captureOwner != this)
+        return MICROBIT_INVALID_PARAMETER;
+
+#if CONFIG_ENABLED(MICROBIT_PIN_CAPTURE)
+    if (ble_running())
+        sd_ppi_channel_enable_clr(1 << MICROBIT_PIN_CAPTURE_PPI_CHANNEL);
+    else
+        NRF_PPI->CHENCLR = 1 << MICROBIT_PIN_CAPTURE_PPI_CHANNEL;
+
+    NRF_GPIOTE->CONFIG[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL] = GPIOTE_CONFIG_MODE_Disabled << GPIOTE_CONFIG_MODE_Pos;
+    NRF_TIMER1->TASKS_STOP = 1;
+
+    scheduler_idle_release();
+#endif
+    captureOwner = NULL;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Records the most recent edge captured in hardware. Called from the rise and fall handlers.
+  *
+  * @param level The level of the pin after the edge.
+  *
+  * @return The number of edges now waiting, or MICROBIT_NO_RESOURCES if the buffer is full and the edge was dropped.
+  */
+int TimedInterruptIn::captureEdge(int level)
+{
+    TimedEdge edge;
+
+    edge.timestamp = NRF_TIMER1->CC[0];
+    edge.level = level;
+
+    if (edges.push(edge) != MICROBIT_OK)
+        return MICROBIT_NO_RESOURCES;
+
+    return edges.size();
+}
+
+/**
+  * Determines if any instance is using hardware capture, and so holds TIMER1.
+  *
+  * @return true if hardware capture is in use, false otherwise.
+  */
+bool TimedInterruptIn::isCaptureActive()
+{
+    return captureOwner != NULL;
+}
+
+/**
+  * Destructor. Releases hardware capture, if in use.
+  */
+TimedInterruptIn::~TimedInterruptIn()
+{
+    if (captureOwner == this)
+        disableCapture();
+}
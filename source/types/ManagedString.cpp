@@ -50,7 +50,7 @@ DEALINGS IN THE SOFTWARE.
 #include "ManagedString.h"
 #include "MicroBitCompat.h"
 
-static const char empty[] __attribute__ ((aligned (4))) = "\xff\xff\0\0\0";
+MICROBIT_STRING_LITERAL(empty, "");
 
 /**
   * Internal constructor helper.
@@ -59,7 +59,34 @@ static const char empty[] __attribute__ ((aligned (4))) = "\xff\xff\0\0\0";
   */
 void ManagedString::initEmpty()
 {
-    ptr = (StringData*)(void*)empty;
+    ptr = (StringData*)(void*)&empty;
+}
+
+/**
+  * Internal constructor helper.
+  *
+  * Provides storage for a string of the given length, inline if it fits and otherwise on the heap.
+  *
+  * @param len The number of characters in the string.
+  *
+  * @return The location at which the len characters and their terminating null should be written.
+  */
+char *ManagedString::initBuffer(int len)
+{
+#if MICROBIT_STRING_INLINE_LENGTH > 0
+    if (len <= MICROBIT_STRING_INLINE_LENGTH)
+    {
+        ptr = (StringData *) inlineData;
+        ptr->refCount = 0xffff;
+        ptr->len = len;
+        return ptr->data;
+    }
+#endif
+
+    ptr = (StringData *) malloc(4+len+1);
+    ptr->init();
+    ptr->len = len;
+    return ptr->data;
 }
 
 /**
@@ -72,10 +99,38 @@ void ManagedString::initString(const char *str)
     // Initialise this ManagedString as a new string, using the data provided.
     // We assume the string is sane, and null terminated.
     int len = strlen(str);
-    ptr = (StringData *) malloc(4+len+1);
-    ptr->init();
-    ptr->len = len;
-    memcpy(ptr->data, str, len+1);
+    memcpy(initBuffer(len), str, len+1);
+}
+
+/**
+  * Internal constructor helper.
+  *
+  * Makes this ManagedString identical to the one supplied, sharing its character buffer unless it is held inline.
+  */
+void ManagedString::initCopy(const ManagedString &s)
+{
+    if (s.isInline())
+    {
+        memcpy(initBuffer(s.length()), s.toCharArray(), s.length()+1);
+        return;
+    }
+
+    ptr = s.ptr;
+    ptr->incr();
+}
+
+/**
+  * Determines if this ManagedString holds its characters inline.
+  *
+  * @return true if the string is held inline, false if it is on the heap or in flash.
+  */
+bool ManagedString::isInline() const
+{
+#if MICROBIT_STRING_INLINE_LENGTH > 0
+    return ptr == (StringData *) inlineData;
+#else
+    return false;
+#endif
 }
 
 /**
@@ -83,6 +138,7 @@ void ManagedString::initString(const char *str)
   * Create a managed string from a specially prepared string literal.
   *
   * @param ptr The literal - first two bytes should be 0xff, then the length in little endian, then the literal. The literal has to be 4-byte aligned.
+  *        MICROBIT_STRING_LITERAL lays one out from an ordinary string literal.
   *
   * @code
   * static const char hello[] __attribute__ ((aligned (4))) = "\xff\xff\x05\x00" "Hello";
@@ -99,10 +155,20 @@ ManagedString::ManagedString(StringData *p)
   * Get current ptr, do not decr() it, and set the current instance to empty string.
   *
   * This is to be used by specialized runtimes which pass StringData around.
+  * A string held inline is first copied to the heap, so the result always outlives this instance.
   */
 StringData* ManagedString::leakData()
 {
     StringData *res = ptr;
+
+    if (isInline())
+    {
+        res = (StringData *) malloc(4+length()+1);
+        res->init();
+        res->len = length();
+        memcpy(res->data, toCharArray(), length()+1);
+    }
+
     initEmpty();
     return res;
 }
@@ -186,14 +252,12 @@ ManagedString::ManagedString(const ManagedString &s1, const ManagedString &s2)
     int len = s1.length() + s2.length();
 
     // Create a new buffer for holding the new string data.
-    ptr = (StringData*) malloc(4+len+1);
-    ptr->init();
-    ptr->len = len;
+    char *data = initBuffer(len);
 
     // Enter the data, and terminate the string.
-    memcpy(ptr->data, s1.toCharArray(), s1.length());
-    memcpy(ptr->data + s1.length(), s2.toCharArray(), s2.length());
-    ptr->data[len] = 0;
+    memcpy(data, s1.toCharArray(), s1.length());
+    memcpy(data + s1.length(), s2.toCharArray(), s2.length());
+    data[len] = 0;
 }
 
 
@@ -216,13 +280,10 @@ ManagedString::ManagedString(PacketBuffer buffer)
     }
 
     // Allocate a new buffer ( just in case the data is not NULL terminated).
-    ptr = (StringData*) malloc(4+buffer.length()+1);
-    ptr->init();
+    char *data = initBuffer(buffer.length());
 
-    // Store the length of the new string
-    ptr->len = buffer.length();
-    memcpy(ptr->data, buffer.getBytes(), buffer.length());
-    ptr->data[buffer.length()] = 0;
+    memcpy(data, buffer.getBytes(), buffer.length());
+    data[buffer.length()] = 0;
 }
 
 /**
@@ -251,19 +312,18 @@ ManagedString::ManagedString(const char *str, const int16_t length)
 
 
     // Allocate a new buffer, and create a NULL terminated string.
-    ptr = (StringData*) malloc(4+length+1);
-    ptr->init();
-    // Store the length of the new string
-    ptr->len = length;
-    memcpy(ptr->data, str, length);
-    ptr->data[length] = 0;
+    char *data = initBuffer(length);
+
+    memcpy(data, str, length);
+    data[length] = 0;
 }
 
 /**
   * Copy constructor.
   * Makes a new ManagedString identical to the one supplied.
   *
-  * Shares the character buffer and reference count with the supplied ManagedString.
+  * Shares the character buffer and reference count with the supplied ManagedString,
+  * or copies it if it is short enough to be held inline.
   *
   * @param s The ManagedString to copy.
   *
@@ -274,8 +334,7 @@ ManagedString::ManagedString(const char *str, const int16_t length)
   */
 ManagedString::ManagedString(const ManagedString &s)
 {
-    ptr = s.ptr;
-    ptr->incr();
+    initCopy(s);
 }
 
 
@@ -327,12 +386,11 @@ ManagedString::~ManagedString()
   */
 ManagedString& ManagedString::operator = (const ManagedString& s)
 {
-    if (this->ptr == s.ptr)
+    if (this == &s || this->ptr == s.ptr)
         return *this;
 
     ptr->decr();
-    ptr = s.ptr;
-    ptr->incr();
+    initCopy(s);
 
     return *this;
 }
@@ -493,4 +551,4 @@ char ManagedString::charAt(int16_t index)
 /**
   * Empty string constant literal
   */
-ManagedString ManagedString::EmptyString((StringData*)(void*)empty);
+ManagedString ManagedString::EmptyString((StringData*)(void*)&empty);
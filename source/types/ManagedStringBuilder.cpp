@@ -0,0 +1,299 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  * Class definition for a ManagedStringBuilder.
+  *
+  * Builds a string from many parts in a single growable buffer.
+  */
+#include <string.h>
+#include <stdlib.h>
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedStringBuilder.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * Create an empty ManagedStringBuilder.
+  *
+  * @param capacity The number of characters to reserve space for. If 0, no space is allocated until the first append.
+  *
+  * @code
+  * ManagedStringBuilder b(64);
+  * @endcode
+  */
+ManagedStringBuilder::ManagedStringBuilder(int capacity)
+{
+    this->buffer = NULL;
+    this->capacity = 0;
+
+    if (capacity > 0)
+        reserve(capacity);
+}
+
+/**
+  * Moves the string built so far into a new buffer of the given capacity.
+  *
+  * @param capacity The number of characters the new buffer can hold, which must be at least length().
+  */
+void ManagedStringBuilder::resize(int capacity)
+{
+    StringData *b = (StringData *) malloc(4 + capacity + 1);
+    b->init();
+
+    if (buffer != NULL)
+    {
+        b->len = buffer->len;
+        memcpy(b->data, buffer->data, buffer->len + 1);
+        free(buffer);
+    }
+    else
+    {
+        b->len = 0;
+        b->data[0] = 0;
+    }
+
+    buffer = b;
+    this->capacity = capacity;
+}
+
+/**
+  * Ensures the buffer can hold at least the given number of characters, growing it if necessary.
+  *
+  * @param size The number of characters required.
+  *
+  * @return true if the buffer can hold size characters, false if size exceeds MANAGED_STRING_BUILDER_MAX_CAPACITY.
+  */
+bool ManagedStringBuilder::grow(int size)
+{
+    if (buffer != NULL && size <= capacity)
+        return true;
+
+    if (size > MANAGED_STRING_BUILDER_MAX_CAPACITY)
+        return false;
+
+    // Double the capacity each time, so that a long series of appends copies each character only a few times.
+    int newCapacity = capacity ? capacity * 2 : MANAGED_STRING_BUILDER_MIN_CAPACITY;
+
+    if (newCapacity < size)
+        newCapacity = size;
+
+    if (newCapacity > MANAGED_STRING_BUILDER_MAX_CAPACITY)
+        newCapacity = MANAGED_STRING_BUILDER_MAX_CAPACITY;
+
+    resize(newCapacity);
+
+    return true;
+}
+
+/**
+  * Ensures the builder can hold at least the given number of characters without growing.
+  *
+  * @param capacity The number of characters to reserve space for.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if capacity is negative or exceeds MANAGED_STRING_BUILDER_MAX_CAPACITY.
+  */
+int ManagedStringBuilder::reserve(int capacity)
+{
+    if (capacity < 0 || capacity > MANAGED_STRING_BUILDER_MAX_CAPACITY)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Reserve exactly what was asked for, rather than doubling.
+    if (buffer == NULL || capacity > this->capacity)
+        resize(capacity);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Appends the given characters.
+  *
+  * @param str The characters to append.
+  *
+  * @param len The number of characters to append.
+  *
+  * @return this ManagedStringBuilder, so that appends may be chained. Characters beyond MANAGED_STRING_BUILDER_MAX_CAPACITY are discarded.
+  */
+ManagedStringBuilder& ManagedStringBuilder::append(const char *str, int len)
+{
+    if (str == NULL || len <= 0)
+        return *this;
+
+    int size = length() + len;
+
+    if (size > MANAGED_STRING_BUILDER_MAX_CAPACITY)
+    {
+        size = MANAGED_STRING_BUILDER_MAX_CAPACITY;
+        len = size - length();
+    }
+
+    grow(size);
+
+    memcpy(buffer->data + buffer->len, str, len);
+    buffer->len = size;
+    buffer->data[size] = 0;
+
+    return *this;
+}
+
+/**
+  * Appends the given null terminated string.
+  *
+  * @param str The string to append. NULL is ignored.
+  *
+  * @return this ManagedStringBuilder, so that appends may be chained.
+  *
+  * @code
+  * b.append("x=");
+  * @endcode
+  */
+ManagedStringBuilder& ManagedStringBuilder::append(const char *str)
+{
+    if (str == NULL)
+        return *this;
+
+    return append(str, strlen(str));
+}
+
+/**
+  * Appends the given ManagedString.
+  *
+  * @param s The string to append.
+  *
+  * @return this ManagedStringBuilder, so that appends may be chained.
+  */
+ManagedStringBuilder& ManagedStringBuilder::append(const ManagedString &s)
+{
+    return append(s.toCharArray(), s.length());
+}
+
+/**
+  * Appends a single character.
+  *
+  * @param c The character to append.
+  *
+  * @return this ManagedStringBuilder, so that appends may be chained.
+  */
+ManagedStringBuilder& ManagedStringBuilder::append(char c)
+{
+    return append(&c, 1);
+}
+
+/**
+  * Appends the given integer, in decimal, without allocating an intermediate ManagedString.
+  *
+  * @param value The integer to append.
+  *
+  * @return this ManagedStringBuilder, so that appends may be chained.
+  *
+  * @code
+  * b.append("t=").append(1234);    // "t=1234"
+  * @endcode
+  */
+ManagedStringBuilder& ManagedStringBuilder::append(int value)
+{
+    char str[12];
+
+    itoa(value, str);
+
+    return append(str);
+}
+
+/**
+  * Determines the length of the string built so far.
+  *
+  * @return The number of characters held.
+  */
+int ManagedStringBuilder::length() const
+{
+    return buffer ? buffer->len : 0;
+}
+
+/**
+  * Provides the string built so far, without creating a ManagedString. This suits calls that take
+  * a character array and length, such as MicroBitFile::write().
+  *
+  * @return The characters held, with a terminating null. This remains valid until the builder is next changed.
+  */
+const char *ManagedStringBuilder::toCharArray() const
+{
+    return buffer ? buffer->data : "";
+}
+
+/**
+  * Discards the string built so far, keeping the buffer for reuse.
+  */
+void ManagedStringBuilder::clear()
+{
+    if (buffer == NULL)
+        return;
+
+    buffer->len = 0;
+    buffer->data[0] = 0;
+}
+
+/**
+  * Creates a ManagedString holding the string built so far, and empties the builder.
+  *
+  * A string short enough to be held inline by ManagedString is copied, and the buffer is kept for reuse.
+  * Otherwise, the buffer itself is passed to the ManagedString, without copying.
+  *
+  * @return The string built.
+  *
+  * @code
+  * ManagedString s = b.toManagedString();
+  * @endcode
+  */
+ManagedString ManagedStringBuilder::toManagedString()
+{
+    if (length() <= MICROBIT_STRING_INLINE_LENGTH)
+    {
+        ManagedString s(toCharArray(), length());
+        clear();
+        return s;
+    }
+
+    // The ManagedString takes a reference of its own, so release ours, leaving it the only one.
+    ManagedString s(buffer);
+    buffer->decr();
+
+    buffer = NULL;
+    capacity = 0;
+
+    return s;
+}
+
+/**
+  * Destructor. Frees the buffer, unless it has been passed to a ManagedString.
+  */
+ManagedStringBuilder::~ManagedStringBuilder()
+{
+    if (buffer != NULL)
+        free(buffer);
+}
@@ -0,0 +1,360 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Lancaster University, UK.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  * Class definition for a ManagedStringView.
+  *
+  * Refers to a range of characters within a ManagedString, without copying them.
+  */
+#include <string.h>
+#include <limits.h>
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedStringView.h"
+#include "ErrorNo.h"
+
+/**
+  * Determines if the given character is whitespace, for the purposes of trim().
+  */
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+  * Default constructor.
+  *
+  * Create an empty view.
+  */
+ManagedStringView::ManagedStringView()
+{
+    this->start = 0;
+    this->len = 0;
+}
+
+/**
+  * Constructor.
+  *
+  * Create a view of the whole of the given string.
+  *
+  * @param s The string to view.
+  */
+ManagedStringView::ManagedStringView(const ManagedString &s) : source(s)
+{
+    this->start = 0;
+    this->len = s.length();
+}
+
+/**
+  * Constructor.
+  *
+  * Create a view of part of the given string. The range is clipped to the bounds of the string.
+  *
+  * @param s The string to view.
+  *
+  * @param start The index of the first character of the view.
+  *
+  * @param length The number of characters in the view.
+  */
+ManagedStringView::ManagedStringView(const ManagedString &s, int start, int length) : source(s)
+{
+    if (start < 0)
+        start = 0;
+
+    if (start > s.length())
+        start = s.length();
+
+    if (length < 0)
+        length = 0;
+
+    if (length > s.length() - start)
+        length = s.length() - start;
+
+    this->start = start;
+    this->len = length;
+}
+
+/**
+  * Provides the characters of this view.
+  *
+  * @return The first character of the view. This is not null terminated.
+  */
+const char *ManagedStringView::getBytes() const
+{
+    return source.toCharArray() + start;
+}
+
+/**
+  * Determines the number of characters in this view.
+  *
+  * @return The length of the view.
+  */
+int ManagedStringView::length() const
+{
+    return len;
+}
+
+/**
+  * Provides the character at the given position within this view.
+  *
+  * @param index The position of the character, indexed from zero.
+  *
+  * @return The character, or zero if index is invalid.
+  */
+char ManagedStringView::charAt(int index) const
+{
+    return (index >= 0 && index < len) ? getBytes()[index] : 0;
+}
+
+/**
+  * Creates a view of part of this view, referring to the same ManagedString. Nothing is copied.
+  *
+  * @param start The index of the first character, relative to this view.
+  *
+  * @param length The number of characters. The range is clipped to the end of this view. Defaults to the rest of the view.
+  *
+  * @return The requested view.
+  *
+  * @code
+  * ManagedStringView cmd("SET 42");
+  * cmd.substring(4);          // "42"
+  * @endcode
+  */
+ManagedStringView ManagedStringView::substring(int start, int length) const
+{
+    if (start < 0)
+        start = 0;
+
+    if (start > len)
+        start = len;
+
+    if (length > len - start)
+        length = len - start;
+
+    return ManagedStringView(source, this->start + start, length);
+}
+
+/**
+  * Creates a view of this view without any leading or trailing spaces, tabs, carriage returns or newlines.
+  *
+  * @return The trimmed view.
+  */
+ManagedStringView ManagedStringView::trim() const
+{
+    const char *p = getBytes();
+    int first = 0;
+    int last = len;
+
+    while (first < last && isSpace(p[first]))
+        first++;
+
+    while (last > first && isSpace(p[last - 1]))
+        last--;
+
+    return substring(first, last - first);
+}
+
+/**
+  * Finds the first occurrence of the given character.
+  *
+  * @param c The character to find.
+  *
+  * @param from The index at which to begin the search. Defaults to the start of the view.
+  *
+  * @return The index of the character within this view, or -1 if it is not found.
+  */
+int ManagedStringView::indexOf(char c, int from) const
+{
+    if (from < 0)
+        from = 0;
+
+    if (from >= len)
+        return -1;
+
+    const char *p = (const char *) memchr(getBytes() + from, c, len - from);
+
+    return p ? p - getBytes() : -1;
+}
+
+/**
+  * Finds the first occurrence of the given string.
+  *
+  * @param str The null terminated string to find.
+  *
+  * @param from The index at which to begin the search. Defaults to the start of the view.
+  *
+  * @return The index of the string within this view, or -1 if it is not found.
+  */
+int ManagedStringView::indexOf(const char *str, int from) const
+{
+    if (str == NULL)
+        return -1;
+
+    if (from < 0)
+        from = 0;
+
+    int n = strlen(str);
+    const char *p = getBytes();
+
+    for (int i = from; i + n <= len; i++)
+        if (memcmp(p + i, str, n) == 0)
+            return i;
+
+    return -1;
+}
+
+/**
+  * Tests if this view begins with the given string.
+  *
+  * @param str The null terminated string to test for.
+  *
+  * @return true if this view begins with str, false otherwise.
+  */
+bool ManagedStringView::startsWith(const char *str) const
+{
+    if (str == NULL)
+        return false;
+
+    int n = strlen(str);
+
+    return n <= len && memcmp(getBytes(), str, n) == 0;
+}
+
+/**
+  * Compares this view with another, in the manner of strcmp().
+  *
+  * @param v The view to compare against.
+  *
+  * @return A negative value if this view is alphabetically before v, zero if they are equal, or a positive value otherwise.
+  */
+int ManagedStringView::compare(const ManagedStringView &v) const
+{
+    int n = len < v.len ? len : v.len;
+    int result = memcmp(getBytes(), v.getBytes(), n);
+
+    if (result != 0)
+        return result;
+
+    return len - v.len;
+}
+
+/**
+  * Equality operation.
+  *
+  * @param v The view to test ourselves against.
+  *
+  * @return true if the views hold the same characters, false otherwise.
+  */
+bool ManagedStringView::operator== (const ManagedStringView &v) const
+{
+    return len == v.len && memcmp(getBytes(), v.getBytes(), len) == 0;
+}
+
+/**
+  * Equality operation.
+  *
+  * @param str The null terminated string to test ourselves against.
+  *
+  * @return true if this view holds the same characters as str, false otherwise.
+  *
+  * @code
+  * if (cmd.substring(0, 3) == "SET")
+  *     ...
+  * @endcode
+  */
+bool ManagedStringView::operator== (const char *str) const
+{
+    if (str == NULL)
+        return false;
+
+    return strncmp(getBytes(), str, len) == 0 && str[len] == 0;
+}
+
+/**
+  * Parses this view as a decimal integer, with an optional leading sign.
+  *
+  * @param value The location to store the result.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if value is NULL, or the view is empty,
+  *         holds anything other than the integer, or holds a value outside the range of an int.
+  */
+int ManagedStringView::toInt(int *value) const
+{
+    if (value == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    const char *p = getBytes();
+    int i = 0;
+    bool negative = false;
+
+    if (i < len && (p[i] == '-' || p[i] == '+'))
+        negative = p[i++] == '-';
+
+    if (i == len)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Accumulate as a negative number, which has the greater range.
+    int result = 0;
+
+    for (; i < len; i++)
+    {
+        if (p[i] < '0' || p[i] > '9')
+            return MICROBIT_INVALID_PARAMETER;
+
+        int digit = p[i] - '0';
+
+        if (result < (INT_MIN + digit) / 10)
+            return MICROBIT_INVALID_PARAMETER;
+
+        result = result * 10 - digit;
+    }
+
+    if (!negative)
+    {
+        if (result == INT_MIN)
+            return MICROBIT_INVALID_PARAMETER;
+
+        result = -result;
+    }
+
+    *value = result;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Creates a ManagedString holding the characters of this view. If the view covers the whole of its
+  * ManagedString, that string is returned. Otherwise, the characters are copied.
+  *
+  * @return The characters of this view, as a ManagedString.
+  */
+ManagedString ManagedStringView::toManagedString() const
+{
+    if (start == 0 && len == source.length())
+        return source;
+
+    return ManagedString(getBytes(), len);
+}
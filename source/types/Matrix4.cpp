@@ -93,6 +93,38 @@ Matrix4::Matrix4(const Matrix4 &matrix)
 
 }
 
+/**
+  * Copy assignment operator.
+  * Makes this matrix an identical copy of the given matrix. Existing storage is reused if it is the right size.
+  *
+  * @param matrix The matrix to copy.
+  *
+  * @return A reference to this matrix.
+  */
+Matrix4& Matrix4::operator=(const Matrix4 &matrix)
+{
+	if (this == &matrix)
+		return *this;
+
+	int size = matrix.rows * matrix.cols;
+
+	if (size != rows * cols)
+	{
+		if (data != NULL)
+			delete[] data;
+
+		data = size > 0 ? new float[size] : NULL;
+	}
+
+	this->rows = matrix.rows;
+	this->cols = matrix.cols;
+
+	for (int i = 0; i < size; i++)
+		data[i] = matrix.data[i];
+
+	return *this;
+}
+
 /**
   * Determines the number of columns in this matrix.
   *
@@ -176,13 +208,51 @@ Matrix4 Matrix4::transpose()
 {
 	Matrix4 result = Matrix4(cols, rows);
 
-	for (int i = 0; i < width(); i++)
-		for (int j = 0; j < height(); j++)
-			result.set(i, j, get(j, i));
+	transpose(result);
 
 	return result;
 }
 
+/**
+  * Transposes this matrix into the given matrix, without allocating memory.
+  *
+  * @param result The matrix to store the result in, which must have the transposed dimensions of this matrix.
+  *        This may be the matrix itself, if it is square.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if result is not of the right size.
+  *
+  * @code
+  * matrix.transpose(matrix);     // in place.
+  * @endcode
+  */
+int Matrix4::transpose(Matrix4 &result)
+{
+	if (result.rows != cols || result.cols != rows)
+		return MICROBIT_INVALID_PARAMETER;
+
+	if (&result == this)
+	{
+		// Square, so swap elements across the diagonal.
+		for (int i = 0; i < rows; i++)
+		{
+			for (int j = i + 1; j < cols; j++)
+			{
+				float v = data[cols * i + j];
+				data[cols * i + j] = data[cols * j + i];
+				data[cols * j + i] = v;
+			}
+		}
+
+		return MICROBIT_OK;
+	}
+
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < cols; j++)
+			result.data[rows * j + i] = data[cols * i + j];
+
+	return MICROBIT_OK;
+}
+
 /**
   * Multiplies this matrix with the given matrix (if possible).
   *
@@ -206,6 +276,36 @@ Matrix4 Matrix4::multiply(Matrix4 &matrix, bool transpose)
 
 	Matrix4 result(h, matrix.width());
 
+	multiply(matrix, result, transpose);
+
+	return result;
+}
+
+/**
+  * Multiplies this matrix with the given matrix into a third matrix, without allocating memory.
+  *
+  * @param matrix the matrix to multiply this matrix's values against.
+  *
+  * @param result The matrix to store the result in, which must be of the right size.
+  *        This must not be either of the matrices being multiplied.
+  *
+  * @param transpose Transpose this matrix before multiplication. Defaults to false.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the matrices are not of compatible sizes.
+  *
+  * @code
+  * Matrix4 result(a.height(), b.width());
+  * a.multiply(b, result);
+  * @endcode
+  */
+int Matrix4::multiply(Matrix4 &matrix, Matrix4 &result, bool transpose)
+{
+    int w = transpose ? height() : width();
+    int h = transpose ? width() : height();
+
+	if (w != matrix.height() || result.height() != h || result.width() != matrix.width() || &result == this || &result == &matrix)
+		return MICROBIT_INVALID_PARAMETER;
+
 	for (int r = 0; r < result.height(); r++)
 	{
 		for (int c = 0; c < result.width(); c++)
@@ -213,18 +313,18 @@ Matrix4 Matrix4::multiply(Matrix4 &matrix, bool transpose)
 			float v = 0.0;
 
 			for (int i = 0; i < w; i++)
-				v += (transpose ? get(i, r) : get(r, i)) * matrix.get(i, c);
+				v += (transpose ? data[cols * i + r] : data[cols * r + i]) * matrix.data[matrix.cols * i + c];
 
-			result.set(r, c, v);
+			result.data[result.cols * r + c] = v;
 		}
 	}
 
-	return result;
+	return MICROBIT_OK;
 }
 
 /**
-  * Performs an optimised inversion of a 4x4 matrix.
-  * Only 4x4 matrices are supported by this operation.
+  * Performs an optimised inversion of a 3x3 or 4x4 matrix.
+  * Only 3x3 and 4x4 matrices are supported by this operation.
   *
   * @return the resultant matrix. An empty matrix is returned if the operation canot be completed.
   *
@@ -234,40 +334,118 @@ Matrix4 Matrix4::multiply(Matrix4 &matrix, bool transpose)
   */
 Matrix4 Matrix4::invert()
 {
-	// We only support square matrices of size 4...
-	if (width() != height() || width() != 4)
+	// We only support square matrices of size 3 or 4...
+	if (width() != height() || (width() != 3 && width() != 4))
 		return Matrix4(0, 0);
 
 	Matrix4 result(width(), height());
 
-	result.data[0] = data[5] * data[10] * data[15] - data[5] * data[11] * data[14] - data[9] * data[6] * data[15] + data[9] * data[7] * data[14] + data[13] * data[6] * data[11] - data[13] * data[7] * data[10];
-	result.data[1] = -data[1] * data[10] * data[15] + data[1] * data[11] * data[14] + data[9] * data[2] * data[15] - data[9] * data[3] * data[14] - data[13] * data[2] * data[11] + data[13] * data[3] * data[10];
-	result.data[2] = data[1] * data[6] * data[15] - data[1] * data[7] * data[14] - data[5] * data[2] * data[15] + data[5] * data[3] * data[14] + data[13] * data[2] * data[7] - data[13] * data[3] * data[6];
-	result.data[3] = -data[1] * data[6] * data[11] + data[1] * data[7] * data[10] + data[5] * data[2] * data[11] - data[5] * data[3] * data[10] - data[9] * data[2] * data[7] + data[9] * data[3] * data[6];
-	result.data[4] = -data[4] * data[10] * data[15] + data[4] * data[11] * data[14] + data[8] * data[6] * data[15] - data[8] * data[7] * data[14] - data[12] * data[6] * data[11] + data[12] * data[7] * data[10];
-	result.data[5] = data[0] * data[10] * data[15] - data[0] * data[11] * data[14] - data[8] * data[2] * data[15] + data[8] * data[3] * data[14] + data[12] * data[2] * data[11] - data[12] * data[3] * data[10];
-	result.data[6] = -data[0] * data[6] * data[15] + data[0] * data[7] * data[14] + data[4] * data[2] * data[15] - data[4] * data[3] * data[14] - data[12] * data[2] * data[7] + data[12] * data[3] * data[6];
-	result.data[7] = data[0] * data[6] * data[11] - data[0] * data[7] * data[10] - data[4] * data[2] * data[11] + data[4] * data[3] * data[10] + data[8] * data[2] * data[7] - data[8] * data[3] * data[6];
-	result.data[8] = data[4] * data[9] * data[15] - data[4] * data[11] * data[13] - data[8] * data[5] * data[15] + data[8] * data[7] * data[13] + data[12] * data[5] * data[11] - data[12] * data[7] * data[9];
-	result.data[9] = -data[0] * data[9] * data[15] + data[0] * data[11] * data[13] + data[8] * data[1] * data[15] - data[8] * data[3] * data[13] - data[12] * data[1] * data[11] + data[12] * data[3] * data[9];
-	result.data[10] = data[0] * data[5] * data[15] - data[0] * data[7] * data[13] - data[4] * data[1] * data[15] + data[4] * data[3] * data[13] + data[12] * data[1] * data[7] - data[12] * data[3] * data[5];
-	result.data[11] = -data[0] * data[5] * data[11] + data[0] * data[7] * data[9] + data[4] * data[1] * data[11] - data[4] * data[3] * data[9] - data[8] * data[1] * data[7] + data[8] * data[3] * data[5];
-	result.data[12] = -data[4] * data[9] * data[14] + data[4] * data[10] * data[13] + data[8] * data[5] * data[14] - data[8] * data[6] * data[13] - data[12] * data[5] * data[10] + data[12] * data[6] * data[9];
-	result.data[13] = data[0] * data[9] * data[14] - data[0] * data[10] * data[13] - data[8] * data[1] * data[14] + data[8] * data[2] * data[13] + data[12] * data[1] * data[10] - data[12] * data[2] * data[9];
-	result.data[14] = -data[0] * data[5] * data[14] + data[0] * data[6] * data[13] + data[4] * data[1] * data[14] - data[4] * data[2] * data[13] - data[12] * data[1] * data[6] + data[12] * data[2] * data[5];
-	result.data[15] = data[0] * data[5] * data[10] - data[0] * data[6] * data[9] - data[4] * data[1] * data[10] + data[4] * data[2] * data[9] + data[8] * data[1] * data[6] - data[8] * data[2] * data[5];
-
-	float det = data[0] * result.data[0] + data[1] * result.data[4] + data[2] * result.data[8] + data[3] * result.data[12];
+	if (invert(result) != MICROBIT_OK)
+		return Matrix4(0, 0);
+
+	return result;
+}
+
+/**
+  * Inverts this 3x3 or 4x4 matrix into the given matrix, without allocating memory.
+  *
+  * @param result The matrix to store the result in, which must be of the same size. This may be the matrix itself.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if result is not of the right size,
+  *         MICROBIT_NOT_SUPPORTED if this matrix is not 3x3 or 4x4, or MICROBIT_NO_DATA if it is singular.
+  *
+  * @code
+  * matrix.invert(matrix);        // in place.
+  * @endcode
+  */
+int Matrix4::invert(Matrix4 &result)
+{
+	if (width() != height() || (width() != 3 && width() != 4))
+		return MICROBIT_NOT_SUPPORTED;
+
+	if (result.width() != width() || result.height() != height())
+		return MICROBIT_INVALID_PARAMETER;
+
+	return width() == 3 ? invert3(data, result.data) : invert4(data, result.data);
+}
+
+/**
+  * Inverts a 3x3 matrix, held in row major order.
+  *
+  * @param m The matrix to invert.
+  *
+  * @param result The location to store the inverse. This may be the same as m.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the matrix is singular.
+  */
+int Matrix4::invert3(const float *m, float *result)
+{
+	float r[9];
+
+	r[0] = m[4] * m[8] - m[5] * m[7];
+	r[1] = m[2] * m[7] - m[1] * m[8];
+	r[2] = m[1] * m[5] - m[2] * m[4];
+	r[3] = m[5] * m[6] - m[3] * m[8];
+	r[4] = m[0] * m[8] - m[2] * m[6];
+	r[5] = m[2] * m[3] - m[0] * m[5];
+	r[6] = m[3] * m[7] - m[4] * m[6];
+	r[7] = m[1] * m[6] - m[0] * m[7];
+	r[8] = m[0] * m[4] - m[1] * m[3];
+
+	float det = m[0] * r[0] + m[1] * r[3] + m[2] * r[6];
 
 	if (det == 0)
-		return Matrix4(0, 0);
+		return MICROBIT_NO_DATA;
+
+	det = 1.0f / det;
+
+	for (int i = 0; i < 9; i++)
+		result[i] = r[i] * det;
+
+	return MICROBIT_OK;
+}
+
+/**
+  * Inverts a 4x4 matrix, held in row major order.
+  *
+  * @param m The matrix to invert.
+  *
+  * @param result The location to store the inverse. This may be the same as m.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the matrix is singular.
+  */
+int Matrix4::invert4(const float *m, float *result)
+{
+	float r[16];
+
+	r[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	r[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	r[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	r[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	r[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	r[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	r[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	r[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	r[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	r[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	r[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	r[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	r[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	r[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	r[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	r[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float det = m[0] * r[0] + m[1] * r[4] + m[2] * r[8] + m[3] * r[12];
+
+	if (det == 0)
+		return MICROBIT_NO_DATA;
 
 	det = 1.0f / det;
 
 	for (int i = 0; i < 16; i++)
-		result.data[i] *= det;
+		result[i] = r[i] * det;
 
-	return result;
+	return MICROBIT_OK;
 }
 
 /**
@@ -279,7 +457,7 @@ Matrix4::~Matrix4()
 {
 	if (data != NULL)
 	{
-		delete data;
+		delete[] data;
 		data = NULL;
 	}
 }
@@ -32,9 +32,30 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitEvent.h"
 #include "MicroBitSystemTimer.h"
 #include "EventModel.h"
+#include "MicroBitFiber.h"
+#include "MicroBitHeapArena.h"
 
 EventModel* EventModel::defaultEventBus = NULL;
 
+#if MICROBIT_EVENT_QUEUE_POOL_SIZE > 0
+// Storage for the pool of MicroBitEventQueueItems. Whilst free, the first word of each item refers to the next free item.
+static uint32_t eventQueuePool[MICROBIT_EVENT_QUEUE_POOL_SIZE][(sizeof(MicroBitEventQueueItem) + 3) / 4];
+static void *eventQueueFreeList = NULL;
+static bool eventQueuePoolInitialised = false;
+#endif
+
+/**
+  * Fires an event created with CREATE_AND_DEFER, once called from the idle task.
+  *
+  * @param arg The source and value of the event, packed into a single word.
+  */
+static void fire_deferred_event(void *arg)
+{
+    uint32_t packed = (uint32_t) arg;
+
+    MicroBitEvent((uint16_t)(packed >> 16), (uint16_t)(packed & 0xFFFF));
+}
+
 /**
   * Constructor.
   *
@@ -45,6 +66,8 @@ EventModel* EventModel::defaultEventBus = NULL;
   * @param mode Optional definition of how the event should be processed after construction (if at all):
   *                 CREATE_ONLY: MicroBitEvent is initialised, and no further processing takes place.
   *                 CREATE_AND_FIRE: MicroBitEvent is initialised, and its event handlers are immediately fired (not suitable for use in interrupts!).
+  *                 CREATE_AND_DEFER: MicroBitEvent is initialised, and fired later from the idle task using fiber_defer().
+  *                                   Intended for use in interrupts. The event delivered carries the time at which it was fired.
   *
   * @code
   * // Create and launch an event using the default configuration
@@ -58,7 +81,11 @@ MicroBitEvent::MicroBitEvent(uint16_t source, uint16_t value, MicroBitEventLaunc
 {
     this->source = source;
     this->value = value;
-    this->timestamp = system_timer_current_time_us();
+    this->setTimestamp(system_timer_current_time_us());
+
+    // If the work can't be deferred, fall back to firing the event now rather than losing it.
+    if(mode == CREATE_AND_DEFER && fiber_defer(fire_deferred_event, (void *)(((uint32_t) source << 16) | value)) == MICROBIT_OK)
+        return;
 
     if(mode != CREATE_ONLY)
         this->fire();
@@ -71,7 +98,7 @@ MicroBitEvent::MicroBitEvent()
 {
     this->source = 0;
     this->value = 0;
-    this->timestamp = system_timer_current_time_us();
+    this->setTimestamp(system_timer_current_time_us());
 }
 
 /**
@@ -83,6 +110,43 @@ void MicroBitEvent::fire()
 		EventModel::defaultEventBus->send(*this);
 }
 
+/**
+  * Retrieves the time at which this event was generated, regardless of MICROBIT_EVENT_TIMESTAMP_BITS.
+  *
+  * With a 32 bit timestamp, the upper bits are reconstructed from the current time, assuming that the
+  * event is less than 71 minutes old. With no timestamp, the current time is returned.
+  *
+  * @return The time at which the event was generated, in microseconds since power on.
+  */
+uint64_t MicroBitEvent::getTimestamp() const
+{
+#if MICROBIT_EVENT_TIMESTAMP_BITS == 64
+    return timestamp;
+#elif MICROBIT_EVENT_TIMESTAMP_BITS == 32
+    uint64_t now = system_timer_current_time_us();
+    return now - (uint32_t)((uint32_t)now - timestamp);
+#else
+    return system_timer_current_time_us();
+#endif
+}
+
+/**
+  * Sets the timestamp of this event, truncating it to MICROBIT_EVENT_TIMESTAMP_BITS.
+  * This has no effect if events carry no timestamp.
+  *
+  * @param t The new timestamp.
+  */
+void MicroBitEvent::setTimestamp(uint64_t t)
+{
+#if MICROBIT_EVENT_TIMESTAMP_BITS == 64
+    timestamp = t;
+#elif MICROBIT_EVENT_TIMESTAMP_BITS == 32
+    timestamp = (uint32_t) t;
+#else
+    (void) t;
+#endif
+}
+
 
 /**
   * Constructor.
@@ -95,3 +159,77 @@ MicroBitEventQueueItem::MicroBitEventQueueItem(MicroBitEvent evt)
     this->evt = evt;
 	this->next = NULL;
 }
+
+/**
+  * Allocates storage for a MicroBitEventQueueItem.
+  *
+  * Items are taken from a statically allocated pool of MICROBIT_EVENT_QUEUE_POOL_SIZE items where possible,
+  * such that queuing an event does not normally require a heap allocation. If the pool is exhausted,
+  * the item is allocated from the heap.
+  *
+  * @param size The amount of memory required, in bytes.
+  *
+  * @return A pointer to the memory allocated, or NULL if no memory is available.
+  */
+void *MicroBitEventQueueItem::operator new(size_t size)
+{
+#if MICROBIT_EVENT_QUEUE_POOL_SIZE > 0
+    void *item = NULL;
+
+    // This may be called from interrupt context, so ensure no race conditions.
+    __disable_irq();
+
+    // Thread all items in the pool onto the free list on first use.
+    if (!eventQueuePoolInitialised)
+    {
+        for (int i = 0; i < MICROBIT_EVENT_QUEUE_POOL_SIZE; i++)
+        {
+            *(void **)eventQueuePool[i] = eventQueueFreeList;
+            eventQueueFreeList = eventQueuePool[i];
+        }
+
+        eventQueuePoolInitialised = true;
+    }
+
+    if (size <= sizeof(eventQueuePool[0]) && eventQueueFreeList != NULL)
+    {
+        item = eventQueueFreeList;
+        eventQueueFreeList = *(void **)item;
+    }
+
+    __enable_irq();
+
+    if (item != NULL)
+        return item;
+#endif
+
+    // Queued events may be processed after any arena of the current fiber is destroyed, so always use the heap.
+    MicroBitHeapArena::suspend();
+    void *p = malloc(size);
+    MicroBitHeapArena::resume();
+
+    return p;
+}
+
+/**
+  * Releases storage for a MicroBitEventQueueItem, returning it to the pool if it was taken from there.
+  *
+  * @param ptr The memory to release.
+  */
+void MicroBitEventQueueItem::operator delete(void *ptr)
+{
+#if MICROBIT_EVENT_QUEUE_POOL_SIZE > 0
+    if (ptr >= (void *)eventQueuePool[0] && ptr < (void *)eventQueuePool[MICROBIT_EVENT_QUEUE_POOL_SIZE])
+    {
+        __disable_irq();
+
+        *(void **)ptr = eventQueueFreeList;
+        eventQueueFreeList = ptr;
+
+        __enable_irq();
+        return;
+    }
+#endif
+
+    free(ptr);
+}
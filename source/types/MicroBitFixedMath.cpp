@@ -0,0 +1,197 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Fixed point trigonometry, for use in place of the floating point library on processors without an FPU.
+  *
+  * Both functions are implemented using CORDIC, which needs only shifts and additions. Internally,
+  * angles are held with an extra 8 bits of precision, so that rounding errors in the rotations do not
+  * accumulate into the result.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitFixedMath.h"
+
+// The number of CORDIC rotations to perform. Each one adds roughly one bit of precision.
+#define CORDIC_ITERATIONS                   20
+
+// Internal angles, where 2^24 units make one full turn.
+#define CORDIC_ANGLE_SHIFT                  8
+#define CORDIC_QUARTER_TURN                 (1 << 22)
+#define CORDIC_HALF_TURN                    (1 << 23)
+
+// The reciprocal of the CORDIC gain after CORDIC_ITERATIONS rotations, in Q30.
+#define CORDIC_INVERSE_GAIN                 652032874
+
+// Vectors are scaled to have their largest component within this range, to maximise precision without overflow.
+#define CORDIC_VECTOR_MIN                   (1 << 27)
+#define CORDIC_VECTOR_MAX                   (1 << 28)
+
+// atan(2^-i), as internal angles.
+static const int32_t cordicAngles[CORDIC_ITERATIONS] =
+{
+    2097152, 1238021, 654136, 332050, 166669, 83416, 41718, 20860, 10430, 5215,
+    2608, 1304, 652, 326, 163, 81, 41, 20, 10, 5
+};
+
+/**
+  * Computes the angle of the vector (x, y) from the positive X axis, in the manner of atan2(y, x).
+  *
+  * @param y The Y component of the vector.
+  *
+  * @param x The X component of the vector.
+  *
+  * @return The angle, as a binary angle between -MICROBIT_FIXED_ANGLE_TURN/2 and MICROBIT_FIXED_ANGLE_TURN/2 - 1.
+  *         Zero is returned if both components are zero.
+  *
+  * @code
+  * microbit_fixed_atan2(1, 1);     // returns 8192, which is 45 degrees.
+  * @endcode
+  */
+int microbit_fixed_atan2(int y, int x)
+{
+    int32_t angle = 0;
+    int32_t t;
+
+    if (x == 0 && y == 0)
+        return 0;
+
+    // Scale the vector into range. The angle is unaffected.
+    while ((x > CORDIC_VECTOR_MAX || x < -CORDIC_VECTOR_MAX || y > CORDIC_VECTOR_MAX || y < -CORDIC_VECTOR_MAX))
+    {
+        x >>= 1;
+        y >>= 1;
+    }
+
+    while (x < CORDIC_VECTOR_MIN && x > -CORDIC_VECTOR_MIN && y < CORDIC_VECTOR_MIN && y > -CORDIC_VECTOR_MIN)
+    {
+        x <<= 1;
+        y <<= 1;
+    }
+
+    // Rotate the vector into the right half plane, where CORDIC converges.
+    if (x < 0)
+    {
+        t = x;
+
+        if (y >= 0)
+        {
+            x = y;
+            y = -t;
+            angle = CORDIC_QUARTER_TURN;
+        }
+        else
+        {
+            x = -y;
+            y = t;
+            angle = -CORDIC_QUARTER_TURN;
+        }
+    }
+
+    // Rotate the vector onto the X axis, accumulating the angle turned through.
+    for (int i = 0; i < CORDIC_ITERATIONS; i++)
+    {
+        t = x;
+
+        if (y > 0)
+        {
+            x += y >> i;
+            y -= t >> i;
+            angle += cordicAngles[i];
+        }
+        else
+        {
+            x -= y >> i;
+            y += t >> i;
+            angle -= cordicAngles[i];
+        }
+    }
+
+    // Round to a binary angle. A result of exactly half a turn is folded to -half a turn.
+    angle = (angle + (1 << (CORDIC_ANGLE_SHIFT - 1))) >> CORDIC_ANGLE_SHIFT;
+
+    if (angle >= MICROBIT_FIXED_ANGLE_TURN / 2)
+        angle -= MICROBIT_FIXED_ANGLE_TURN;
+
+    return angle;
+}
+
+/**
+  * Computes the sine and cosine of the given angle.
+  *
+  * @param angle The angle, as a binary angle. Only the lowest 16 bits are significant.
+  *
+  * @param sine Set to the sine of the angle, where 1.0 == MICROBIT_FIXED_ONE.
+  *
+  * @param cosine Set to the cosine of the angle, where 1.0 == MICROBIT_FIXED_ONE.
+  */
+void microbit_fixed_sincos(int angle, int &sine, int &cosine)
+{
+    int32_t z = ((int32_t)(int16_t)angle) << CORDIC_ANGLE_SHIFT;
+    int32_t x = CORDIC_INVERSE_GAIN;
+    int32_t y = 0;
+    int32_t t;
+    bool negate = false;
+
+    // Fold the angle into the right half plane, where CORDIC converges.
+    if (z > CORDIC_QUARTER_TURN)
+    {
+        z -= CORDIC_HALF_TURN;
+        negate = true;
+    }
+    else if (z < -CORDIC_QUARTER_TURN)
+    {
+        z += CORDIC_HALF_TURN;
+        negate = true;
+    }
+
+    // Rotate the unit vector through the angle.
+    for (int i = 0; i < CORDIC_ITERATIONS; i++)
+    {
+        t = x;
+
+        if (z >= 0)
+        {
+            x -= y >> i;
+            y += t >> i;
+            z -= cordicAngles[i];
+        }
+        else
+        {
+            x += y >> i;
+            y -= t >> i;
+            z += cordicAngles[i];
+        }
+    }
+
+    if (negate)
+    {
+        x = -x;
+        y = -y;
+    }
+
+    // Round from Q30 to the output precision.
+    cosine = (x + (1 << 13)) >> 14;
+    sine = (y + (1 << 13)) >> 14;
+}
@@ -41,9 +41,142 @@ DEALINGS IN THE SOFTWARE.
 /**
   * The null image. We actally create a small one byte buffer here, just to keep NULL pointers out of the equation.
   */
-static const uint16_t empty[] __attribute__ ((aligned (4))) = { 0xffff, 1, 1, 0, };
+MICROBIT_IMAGE_LITERAL(empty, IMAGE_FORMAT_8BPP, 1, 1, 0);
 MicroBitImage MicroBitImage::EmptyImage((ImageData*)(void*)empty);
 
+/**
+  * Copies the non-zero pixels of one row of an 8 bit per pixel image to another.
+  *
+  * Where both rows share the same word alignment, four pixels are tested and merged at a time.
+  *
+  * @param pOut The first pixel to write.
+  *
+  * @param pIn The first pixel to read.
+  *
+  * @param len The number of pixels to consider.
+  *
+  * @return The number of pixels written.
+  */
+static int pasteRowTransparent(uint8_t *pOut, const uint8_t *pIn, int len)
+{
+    int written = 0;
+
+    if ((((uint32_t)pOut ^ (uint32_t)pIn) & 3) == 0)
+    {
+        // Handle any leading pixels one at a time, until we reach a word boundary.
+        while (len > 0 && ((uint32_t)pIn & 3))
+        {
+            if (*pIn)
+            {
+                *pOut = *pIn;
+                written++;
+            }
+
+            pIn++;
+            pOut++;
+            len--;
+        }
+
+        while (len >= 4)
+        {
+            uint32_t v = *(const uint32_t *)pIn;
+
+            // Wholly transparent words are common, and need no work at all.
+            if (v)
+            {
+                // Set the top bit of each byte that is non-zero. No carry can pass from one byte to the next.
+                uint32_t t = ((((v & 0x7F7F7F7F) + 0x7F7F7F7F) | v) & 0x80808080) >> 7;
+                uint32_t mask = t * 0xFF;
+
+                *(uint32_t *)pOut = (*(uint32_t *)pOut & ~mask) | (v & mask);
+                written += (t * 0x01010101) >> 24;
+            }
+
+            pIn += 4;
+            pOut += 4;
+            len -= 4;
+        }
+    }
+
+    // Handle the remaining pixels one at a time.
+    while (len > 0)
+    {
+        if (*pIn)
+        {
+            *pOut = *pIn;
+            written++;
+        }
+
+        pIn++;
+        pOut++;
+        len--;
+    }
+
+    return written;
+}
+
+/**
+  * Shifts a row of a packed image towards its leftmost pixel, filling the vacated pixels with zero.
+  *
+  * The row is treated as a string of bits, so a whole byte of pixels is moved at a time.
+  *
+  * @param row The first byte of the row.
+  *
+  * @param len The number of bytes in the row.
+  *
+  * @param bits The distance to shift, in bits. Must be less than the number of bits in the row.
+  */
+static void shiftPackedRowLeft(uint8_t *row, int len, int bits)
+{
+    int offset = bits >> 3;
+    int r = bits & 7;
+    int i = 0;
+
+    // Every byte in this part of the row is built from two source bytes within the row.
+    for (; i + offset + 1 < len; i++)
+        row[i] = (row[i + offset] >> r) | (row[i + offset + 1] << (8 - r));
+
+    // The last source byte (which may be the only one) has zeros beyond it.
+    row[i] = row[i + offset] >> r;
+
+    for (i++; i < len; i++)
+        row[i] = 0;
+}
+
+/**
+  * Shifts a row of a packed image towards its rightmost pixel, filling the vacated pixels with zero.
+  *
+  * The row is treated as a string of bits, so a whole byte of pixels is moved at a time.
+  *
+  * @param row The first byte of the row.
+  *
+  * @param len The number of bytes in the row.
+  *
+  * @param bits The distance to shift, in bits. Must be less than the number of bits in the row.
+  *
+  * @param used The number of bits of the row that hold pixels. Any bits beyond these are cleared.
+  */
+static void shiftPackedRowRight(uint8_t *row, int len, int bits, int used)
+{
+    int offset = bits >> 3;
+    int r = bits & 7;
+    int i = len - 1;
+
+    // Every byte in this part of the row is built from two source bytes within the row.
+    for (; i - offset - 1 >= 0; i--)
+        row[i] = (row[i - offset] << r) | (row[i - offset - 1] >> (8 - r));
+
+    // The first source byte has zeros before it.
+    row[i] = row[i - offset] << r;
+
+    for (i--; i >= 0; i--)
+        row[i] = 0;
+
+    // Keep the unused bits at the end of the row clear, so that images can be compared byte by byte.
+    if (used & 7)
+        row[len - 1] &= (1 << (used & 7)) - 1;
+}
+
 /**
   * Default Constructor.
   * Creates a new reference to the empty MicroBitImage bitmap
@@ -67,8 +200,11 @@ MicroBitImage::MicroBitImage()
   *
   * @param y the height of the image.
   *
+  * @param format the MicroBitImageFormat in which to store the image. Defaults to IMAGE_FORMAT_8BPP.
+  *
   * Bitmap buffer is linear, with 8 bits per pixel, row by row,
   * top to bottom with no word alignment. Stride is therefore the image width in pixels.
+  * Packed formats hold several pixels per byte, with each row starting on a byte boundary.
   * in where w and h are width and height respectively, the layout is therefore:
   *
   * |[0,0]...[w,o][1,0]...[w,1]  ...  [[w,h]
@@ -78,9 +214,9 @@ MicroBitImage::MicroBitImage()
   * TODO: Consider an immutable flavour, which might save us RAM for animation spritesheets...
   * ...as these could be kept in FLASH.
   */
-MicroBitImage::MicroBitImage(const int16_t x, const int16_t y)
+MicroBitImage::MicroBitImage(const int16_t x, const int16_t y, MicroBitImageFormat format)
 {
-    this->init(x,y,NULL);
+    this->init(x,y,NULL,format);
 }
 
 /**
@@ -165,7 +301,7 @@ MicroBitImage::MicroBitImage(const char *s)
         parseReadPtr++;
     }
 
-    this->init(width, height, NULL);
+    this->init(width, height, NULL, IMAGE_FORMAT_8BPP);
 
     // Second pass: collect the data.
     parseReadPtr = s;
@@ -200,6 +336,8 @@ MicroBitImage::MicroBitImage(const char *s)
   *
   * @param ptr The literal - first two bytes should be 0xff, then width, 0, height, 0, and the bitmap. Width and height are 16 bit. The literal has to be 4-byte aligned.
   *
+  * A literal held in flash uses no RAM until the image is first modified, at which point this image takes its own copy.
+  *
   * @code
   * static const uint8_t heart[] __attribute__ ((aligned (4))) = { 0xff, 0xff, 10, 0, 5, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, }; // a cute heart
   * MicroBitImage i((ImageData*)(void*)heart);
@@ -232,16 +370,19 @@ ImageData *MicroBitImage::leakData()
   *
   * @param y the height of the image.
   *
-  * @param bitmap a 2D array representing the image.
+  * @param bitmap a 2D array representing the image, with one byte per pixel.
+  *
+  * @param format the MicroBitImageFormat in which to store the image. Defaults to IMAGE_FORMAT_8BPP.
   *
   * @code
   * const uint8_t heart[] = { 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, }; // a cute heart
   * MicroBitImage i(10,5,heart);
+  * MicroBitImage small(10,5,heart,IMAGE_FORMAT_1BPP); // the same heart, in 10 bytes
   * @endcode
   */
-MicroBitImage::MicroBitImage(const int16_t x, const int16_t y, const uint8_t *bitmap)
+MicroBitImage::MicroBitImage(const int16_t x, const int16_t y, const uint8_t *bitmap, MicroBitImageFormat format)
 {
-    this->init(x,y,bitmap);
+    this->init(x,y,bitmap,format);
 }
 
 /**
@@ -270,30 +411,117 @@ void MicroBitImage::init_empty()
   * @param y the height of the image
   *
   * @param bitmap an array of integers that make up an image.
+  *
+  * @param format the MicroBitImageFormat in which to store the image.
   */
-void MicroBitImage::init(const int16_t x, const int16_t y, const uint8_t *bitmap)
+void MicroBitImage::init(const int16_t x, const int16_t y, const uint8_t *bitmap, MicroBitImageFormat format)
 {
     //sanity check size of image - you cannot have a negative sizes
-    if(x < 0 || y < 0)
+    if(x < 0 || y < 0 || y > MICROBIT_IMAGE_MAX_HEIGHT)
     {
         init_empty();
         return;
     }
 
+    int stride = MICROBIT_IMAGE_STRIDE(format, x);
 
     // Create a copy of the array
-    ptr = (ImageData*)malloc(sizeof(ImageData) + x * y);
+    ptr = (ImageData*)malloc(sizeof(ImageData) + stride * y);
     ptr->init();
     ptr->width = x;
     ptr->height = y;
+    ptr->format = format;
 
     // create a linear buffer to represent the image. We could use a jagged/2D array here, but experimentation
     // showed this had a negative effect on memory management (heap fragmentation etc).
 
+    // Always clear first, so that the unused bits at the end of each row of a packed image are zero.
+    this->clear();
+
     if (bitmap)
         this->printImage(x,y,bitmap);
-    else
-        this->clear();
+}
+
+/**
+  * Ensures this image may be modified, by taking a private copy in RAM of any bitmap held in flash.
+  *
+  * Other images that reference the same flash bitmap are unaffected.
+  */
+void MicroBitImage::makeWritable()
+{
+    if (!ptr->isReadOnly())
+        return;
+
+    int size = getBitmapSize();
+
+    ImageData *p = (ImageData*)malloc(sizeof(ImageData) + size);
+    p->init();
+    p->width = ptr->width;
+    p->height = ptr->height;
+    p->format = ptr->format;
+    memcpy(p->data, ptr->data, size);
+
+    // Images in flash are not reference counted, so there is nothing to release.
+    ptr = p;
+}
+
+/**
+  * Reads a pixel, without bounds checking.
+  *
+  * @param x The x co-ordinate of the pixel to read.
+  *
+  * @param y The y co-ordinate of the pixel to read.
+  *
+  * @return The brightness of the pixel (0-255).
+  */
+uint8_t MicroBitImage::readPixel(int x, int y) const
+{
+    const uint8_t *row = ptr->data + y * getStride();
+
+    if (ptr->format == IMAGE_FORMAT_1BPP)
+        return (row[x >> 3] & (1 << (x & 7))) ? 255 : 0;
+
+    if (ptr->format == IMAGE_FORMAT_4BPP)
+        return ((row[x >> 1] >> ((x & 1) << 2)) & 0x0F) * 17;
+
+    return row[x];
+}
+
+/**
+  * Writes a pixel, without bounds checking.
+  *
+  * @param x The x co-ordinate of the pixel to write.
+  *
+  * @param y The y co-ordinate of the pixel to write.
+  *
+  * @param value The brightness of the pixel (0-255). This is rounded up to the nearest level the image can represent.
+  */
+void MicroBitImage::writePixel(int x, int y, uint8_t value)
+{
+    uint8_t *row = ptr->data + y * getStride();
+
+    if (ptr->format == IMAGE_FORMAT_1BPP)
+    {
+        if (value)
+            row[x >> 3] |= 1 << (x & 7);
+        else
+            row[x >> 3] &= ~(1 << (x & 7));
+
+        return;
+    }
+
+    if (ptr->format == IMAGE_FORMAT_4BPP)
+    {
+        // Round up, so that any pixel that is lit remains lit.
+        int shift = (x & 1) << 2;
+        uint8_t level = (value + 16) / 17;
+
+        row[x >> 1] = (row[x >> 1] & ~(0x0F << shift)) | (level << shift);
+
+        return;
+    }
+
+    row[x] = value;
 }
 
 /**
@@ -350,7 +578,7 @@ bool MicroBitImage::operator== (const MicroBitImage& i)
     if (ptr == i.ptr)
         return true;
     else
-        return (ptr->width == i.ptr->width && ptr->height == i.ptr->height && (memcmp(getBitmap(), i.ptr->data, getSize())==0));
+        return (ptr->width == i.ptr->width && ptr->height == i.ptr->height && ptr->format == i.ptr->format && (memcmp(getBitmap(), i.ptr->data, getBitmapSize())==0));
 }
 
 
@@ -364,7 +592,8 @@ bool MicroBitImage::operator== (const MicroBitImage& i)
   */
 void MicroBitImage::clear()
 {
-    memclr(getBitmap(), getSize());
+    makeWritable();
+    memclr(getBitmap(), getBitmapSize());
 }
 
 /**
@@ -391,7 +620,8 @@ int MicroBitImage::setPixelValue(int16_t x , int16_t y, uint8_t value)
     if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    this->getBitmap()[y*getWidth()+x] = value;
+    makeWritable();
+    writePixel(x, y, value);
     return MICROBIT_OK;
 }
 
@@ -415,7 +645,7 @@ int MicroBitImage::getPixelValue(int16_t x , int16_t y)
     if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    return this->getBitmap()[y*getWidth()+x];
+    return readPixel(x, y);
 }
 
 /**
@@ -452,9 +682,25 @@ int MicroBitImage::printImage(int16_t width, int16_t height, const uint8_t *bitm
     pixelsToCopyX = min(width,this->getWidth());
     pixelsToCopyY = min(height,this->getHeight());
 
+    makeWritable();
+
     pIn = bitmap;
     pOut = this->getBitmap();
 
+    // Packed images need each pixel converting as it is stored.
+    if (getFormat() != IMAGE_FORMAT_8BPP)
+    {
+        for (int i=0; i<pixelsToCopyY; i++)
+        {
+            for (int j=0; j<pixelsToCopyX; j++)
+                writePixel(j, i, pIn[j]);
+
+            pIn += width;
+        }
+
+        return MICROBIT_OK;
+    }
+
     // Copy the image, stride by stride.
     for (int i=0; i<pixelsToCopyY; i++)
     {
@@ -498,10 +744,37 @@ int MicroBitImage::paste(const MicroBitImage &image, int16_t x, int16_t y, uint8
     if (x >= getWidth() || y >= getHeight() || x+image.getWidth() <= 0 || y+image.getHeight() <= 0)
         return 0;
 
+    makeWritable();
+
     //Calculate the number of byte we need to copy in each dimension.
     cx = x < 0 ? min(image.getWidth() + x, getWidth()) : min(image.getWidth(), getWidth() - x);
     cy = y < 0 ? min(image.getHeight() + y, getHeight()) : min(image.getHeight(), getHeight() - y);
 
+    // If either image is packed, convert pixel by pixel.
+    if (getFormat() != IMAGE_FORMAT_8BPP || image.getFormat() != IMAGE_FORMAT_8BPP)
+    {
+        int inX = (x < 0) ? -x : 0;
+        int inY = (y < 0) ? -y : 0;
+        int outX = (x > 0) ? x : 0;
+        int outY = (y > 0) ? y : 0;
+
+        for (int i=0; i<cy; i++)
+        {
+            for (int j=0; j<cx; j++)
+            {
+                uint8_t v = image.readPixel(inX + j, inY + i);
+
+                if (alpha && v == 0)
+                    continue;
+
+                writePixel(outX + j, outY + i, v);
+                pxWritten++;
+            }
+        }
+
+        return pxWritten;
+    }
+
     // Calculate sane start pointer.
     pIn = image.ptr->data;
     pIn += (x < 0) ? -x : 0;
@@ -519,14 +792,7 @@ int MicroBitImage::paste(const MicroBitImage &image, int16_t x, int16_t y, uint8
     {
         for (int i=0; i<cy; i++)
         {
-            for (int j=0; j<cx; j++)
-            {
-                // Copy this byte if appropriate.
-                if (*(pIn+j) != 0){
-                    *(pOut+j) = *(pIn+j);
-                    pxWritten++;
-                }
-            }
+            pxWritten += pasteRowTransparent(pOut, pIn, cx);
 
             pIn += image.getWidth();
             pOut += getWidth();
@@ -565,35 +831,43 @@ int MicroBitImage::paste(const MicroBitImage &image, int16_t x, int16_t y, uint8
   */
 int MicroBitImage::print(char c, int16_t x, int16_t y)
 {
-    unsigned char v;
-    int x1, y1;
-
     MicroBitFont font = MicroBitFont::getSystemFont();
 
     // Sanity check. Silently ignore anything out of bounds.
     if (x >= getWidth() || y >= getHeight() || c < MICROBIT_FONT_ASCII_START || c > font.asciiEnd)
         return MICROBIT_INVALID_PARAMETER;
 
+    makeWritable();
+
+    // Determine the part of the character that lies within this image, so the loops below need no bounds checks.
+    int colStart = max(0, -x);
+    int colEnd = min(MICROBIT_FONT_WIDTH, getWidth() - x);
+    int rowStart = max(0, -y);
+    int rowEnd = min(MICROBIT_FONT_HEIGHT, getHeight() - y);
+
     // Paste.
-    int offset = (c-MICROBIT_FONT_ASCII_START) * 5;
+    const unsigned char *glyph = font.characters + (c-MICROBIT_FONT_ASCII_START) * 5;
 
-    for (int row=0; row<MICROBIT_FONT_HEIGHT; row++)
+    if (getFormat() != IMAGE_FORMAT_8BPP)
     {
-        v = (char)*(font.characters + offset);
+        for (int row = rowStart; row < rowEnd; row++)
+            for (int col = colStart; col < colEnd; col++)
+                writePixel(x + col, y + row, (glyph[row] & (0x10 >> col)) ? 255 : 0);
+
+        return MICROBIT_OK;
+    }
 
-        offset++;
+    // Start from the first visible pixel. With a negative x, the character's own origin lies before the bitmap.
+    uint8_t *pOut = getBitmap() + (y + rowStart) * getWidth() + x + colStart;
 
-        // Update our Y co-ord write position
-        y1 = y+row;
+    for (int row = rowStart; row < rowEnd; row++)
+    {
+        unsigned char v = glyph[row];
 
-        for (int col = 0; col < MICROBIT_FONT_WIDTH; col++)
-        {
-            // Update our X co-ord write position
-            x1 = x+col;
+        for (int col = colStart; col < colEnd; col++)
+            pOut[col - colStart] = (v & (0x10 >> col)) ? 255 : 0;
 
-            if (x1 < getWidth() && y1 < getHeight())
-                this->getBitmap()[y1*getWidth()+x1] = (v & (0x10 >> col)) ? 255 : 0;
-        }
+        pOut += getWidth();
     }
 
     return MICROBIT_OK;
@@ -615,7 +889,7 @@ int MicroBitImage::print(char c, int16_t x, int16_t y)
   */
 int MicroBitImage::shiftLeft(int16_t n)
 {
-    uint8_t *p = getBitmap();
+    uint8_t *p;
     int pixels = getWidth()-n;
 
     if (n <= 0 )
@@ -627,6 +901,23 @@ int MicroBitImage::shiftLeft(int16_t n)
         return MICROBIT_OK;
     }
 
+    makeWritable();
+    p = getBitmap();
+
+    if (getFormat() != IMAGE_FORMAT_8BPP)
+    {
+        int bpp = getFormat() == IMAGE_FORMAT_1BPP ? 1 : 4;
+        int stride = getStride();
+
+        for (int y = 0; y < getHeight(); y++)
+        {
+            shiftPackedRowLeft(p, stride, n * bpp);
+            p += stride;
+        }
+
+        return MICROBIT_OK;
+    }
+
     for (int y = 0; y < getHeight(); y++)
     {
         // Copy, and blank fill the rightmost column.
@@ -654,7 +945,7 @@ int MicroBitImage::shiftLeft(int16_t n)
   */
 int MicroBitImage::shiftRight(int16_t n)
 {
-    uint8_t *p = getBitmap();
+    uint8_t *p;
     int pixels = getWidth()-n;
 
     if (n <= 0)
@@ -666,6 +957,23 @@ int MicroBitImage::shiftRight(int16_t n)
         return MICROBIT_OK;
     }
 
+    makeWritable();
+    p = getBitmap();
+
+    if (getFormat() != IMAGE_FORMAT_8BPP)
+    {
+        int bpp = getFormat() == IMAGE_FORMAT_1BPP ? 1 : 4;
+        int stride = getStride();
+
+        for (int y = 0; y < getHeight(); y++)
+        {
+            shiftPackedRowRight(p, stride, n * bpp, getWidth() * bpp);
+            p += stride;
+        }
+
+        return MICROBIT_OK;
+    }
+
     for (int y = 0; y < getHeight(); y++)
     {
         // Copy, and blank fill the leftmost column.
@@ -704,19 +1012,24 @@ int MicroBitImage::shiftUp(int16_t n)
         return MICROBIT_OK;
     }
 
+    makeWritable();
+
+    // Rows always start on a byte boundary, so whole rows can be moved whatever the format.
+    int stride = getStride();
+
     pOut = getBitmap();
-    pIn = getBitmap()+getWidth()*n;
+    pIn = getBitmap()+stride*n;
 
     for (int y = 0; y < getHeight(); y++)
     {
         // Copy, and blank fill the leftmost column.
         if (y < getHeight()-n)
-            memcpy(pOut, pIn, getWidth());
+            memcpy(pOut, pIn, stride);
         else
-            memclr(pOut, getWidth());
+            memclr(pOut, stride);
 
-        pIn += getWidth();
-        pOut += getWidth();
+        pIn += stride;
+        pOut += stride;
     }
 
     return MICROBIT_OK;
@@ -749,19 +1062,24 @@ int MicroBitImage::shiftDown(int16_t n)
         return MICROBIT_OK;
     }
 
-    pOut = getBitmap() + getWidth()*(getHeight()-1);
-    pIn = pOut - getWidth()*n;
+    makeWritable();
+
+    // Rows always start on a byte boundary, so whole rows can be moved whatever the format.
+    int stride = getStride();
+
+    pOut = getBitmap() + stride*(getHeight()-1);
+    pIn = pOut - stride*n;
 
     for (int y = 0; y < getHeight(); y++)
     {
         // Copy, and blank fill the leftmost column.
         if (y < getHeight()-n)
-            memcpy(pOut, pIn, getWidth());
+            memcpy(pOut, pIn, stride);
         else
-            memclr(pOut, getWidth());
+            memclr(pOut, stride);
 
-        pIn -= getWidth();
-        pOut -= getWidth();
+        pIn -= stride;
+        pOut -= stride;
     }
 
     return MICROBIT_OK;
@@ -787,14 +1105,13 @@ ManagedString MicroBitImage::toString()
 
     parseBuffer[stringSize] = '\0';
 
-    uint8_t *bitmapPtr = getBitmap();
-
     int parseIndex = 0;
     int widthCount = 0;
+    int heightCount = 0;
 
     while (parseIndex < stringSize)
     {
-        if(*bitmapPtr)
+        if(readPixel(widthCount, heightCount))
             parseBuffer[parseIndex] = '1';
         else
             parseBuffer[parseIndex] = '0';
@@ -805,6 +1122,7 @@ ManagedString MicroBitImage::toString()
         {
             parseBuffer[parseIndex] = '\n';
             widthCount = 0;
+            heightCount++;
         }
         else
         {
@@ -813,7 +1131,6 @@ ManagedString MicroBitImage::toString()
         }
 
         parseIndex++;
-        bitmapPtr++;
     }
 
     return ManagedString(parseBuffer);
@@ -859,13 +1176,17 @@ MicroBitImage MicroBitImage::crop(int startx, int starty, int cropWidth, int cro
     //go through row by row and select our image.
     for (int i = starty; i < newHeight; i++)
     {
-        memcpy(pastePointer, copyPointer, newWidth);
+        if (getFormat() == IMAGE_FORMAT_8BPP)
+            memcpy(pastePointer, copyPointer, newWidth);
+        else
+            for (int j = 0; j < newWidth; j++)
+                pastePointer[j] = (startx + j < getWidth()) ? readPixel(startx + j, i) : 0;
 
         copyPointer += getWidth();
         pastePointer += newHeight;
     }
 
-    return MicroBitImage(newWidth, newHeight, cropped);
+    return MicroBitImage(newWidth, newHeight, cropped, getFormat());
 }
 
 /**
@@ -883,5 +1204,9 @@ bool MicroBitImage::isReadOnly()
   */
 MicroBitImage MicroBitImage::clone()
 {
-    return MicroBitImage(getWidth(), getHeight(), getBitmap());
+    MicroBitImage image(getWidth(), getHeight(), getFormat());
+
+    memcpy(image.getBitmap(), getBitmap(), getBitmapSize());
+
+    return image;
 }
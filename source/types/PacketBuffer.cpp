@@ -58,6 +58,23 @@ PacketBuffer::PacketBuffer(int length)
     this->init(NULL, length, 0);
 }
 
+/**
+  * Constructor.
+  * Creates a new PacketBuffer of the given size, with space reserved before it for headers to be prepended.
+  *
+  * @param length The length of the buffer to create.
+  *
+  * @param headroom The number of bytes to reserve before the buffer. The length and headroom together may not exceed 255 bytes.
+  *
+  * @code
+  * PacketBuffer p(16, 4);      // Creates a PacketBuffer 16 bytes long, that can grow to 20 bytes by prepend().
+  * @endcode
+  */
+PacketBuffer::PacketBuffer(int length, int headroom)
+{
+    this->init(NULL, length, 0, headroom);
+}
+
 /**
   * Constructor.
   * Creates an empty Packet Buffer of the given size,
@@ -93,6 +110,8 @@ PacketBuffer::PacketBuffer(uint8_t *data, int length, int rssi)
 PacketBuffer::PacketBuffer(const PacketBuffer &buffer)
 {
     ptr = buffer.ptr;
+    offset = buffer.offset;
+    size = buffer.size;
     ptr->incr();
 }
 
@@ -104,21 +123,33 @@ PacketBuffer::PacketBuffer(const PacketBuffer &buffer)
   * @param length The length of the buffer to create.
   *
   * @param rssi The radio signal strength at the time this packet was recieved.
+  *
+  * @param headroom The number of bytes to reserve before the buffer. Defaults to 0.
   */
-void PacketBuffer::init(uint8_t *data, int length, int rssi)
+void PacketBuffer::init(uint8_t *data, int length, int rssi, int headroom)
 {
     if (length < 0)
         length = 0;
 
-    ptr = (PacketData *) malloc(sizeof(PacketData) + length);
+    // The payload, including headroom, is limited to 255 bytes. Give up any headroom that doesn't fit.
+    if (headroom < 0 || length > 255)
+        headroom = 0;
+
+    if (length + headroom > 255)
+        headroom = 255 - length;
+
+    ptr = (PacketData *) malloc(sizeof(PacketData) + headroom + length);
     ptr->init();
 
-    ptr->length = length;
+    ptr->length = headroom + length;
     ptr->rssi = rssi;
 
+    offset = headroom;
+    size = length;
+
     // Copy in the data buffer, if provided.
     if (data)
-        memcpy(ptr->payload, data, length);
+        memcpy(ptr->payload + offset, data, length);
 }
 
 /**
@@ -153,6 +184,9 @@ PacketBuffer::~PacketBuffer()
   */
 PacketBuffer& PacketBuffer::operator = (const PacketBuffer &p)
 {
+    offset = p.offset;
+    size = p.size;
+
     if(ptr == p.ptr)
         return *this;
 
@@ -177,7 +211,7 @@ PacketBuffer& PacketBuffer::operator = (const PacketBuffer &p)
   */
 uint8_t PacketBuffer::operator [] (int i) const
 {
-    return ptr->payload[i];
+    return ptr->payload[offset + i];
 }
 
 /**
@@ -194,7 +228,7 @@ uint8_t PacketBuffer::operator [] (int i) const
   */
 uint8_t& PacketBuffer::operator [] (int i)
 {
-    return ptr->payload[i];
+    return ptr->payload[offset + i];
 }
 
 /**
@@ -218,10 +252,10 @@ uint8_t& PacketBuffer::operator [] (int i)
   */
 bool PacketBuffer::operator== (const PacketBuffer& p)
 {
-    if (ptr == p.ptr)
+    if (ptr == p.ptr && offset == p.offset && size == p.size)
         return true;
     else
-        return (ptr->length == p.ptr->length && (memcmp(ptr->payload, p.ptr->payload, ptr->length)==0));
+        return (size == p.size && (memcmp(ptr->payload + offset, p.ptr->payload + p.offset, size)==0));
 }
 
 /**
@@ -240,9 +274,9 @@ bool PacketBuffer::operator== (const PacketBuffer& p)
   */
 int PacketBuffer::setByte(int position, uint8_t value)
 {
-    if (position < ptr->length)
+    if (position >= 0 && position < size)
     {
-        ptr->payload[position] = value;
+        ptr->payload[offset + position] = value;
         return MICROBIT_OK;
     }
     else
@@ -266,8 +300,8 @@ int PacketBuffer::setByte(int position, uint8_t value)
   */
 int PacketBuffer::getByte(int position)
 {
-    if (position < ptr->length)
-        return ptr->payload[position];
+    if (position >= 0 && position < size)
+        return ptr->payload[offset + position];
     else
         return MICROBIT_INVALID_PARAMETER;
 }
@@ -279,7 +313,7 @@ int PacketBuffer::getByte(int position)
   */
 uint8_t*PacketBuffer::getBytes()
 {
-    return ptr->payload;
+    return ptr->payload + offset;
 }
 
 /**
@@ -294,7 +328,7 @@ uint8_t*PacketBuffer::getBytes()
   */
 int PacketBuffer::length()
 {
-    return ptr->length;
+    return size;
 }
 
 /**
@@ -325,3 +359,96 @@ void PacketBuffer::setRSSI(uint8_t rssi)
 {
     ptr->rssi = rssi;
 }
+
+/**
+  * Creates a PacketBuffer referring to part of this one. The bytes are shared rather than copied,
+  * so changes made through either are seen by both.
+  *
+  * @param offset The index of the first byte of the slice.
+  *
+  * @param length The number of bytes in the slice. The slice is clipped to the end of this buffer. Defaults to the rest of the buffer.
+  *
+  * @return The slice.
+  *
+  * @code
+  * PacketBuffer packet = radio.datagram.recv();
+  * PacketBuffer body = packet.slice(2);         // Everything after a two byte header.
+  * @endcode
+  */
+PacketBuffer PacketBuffer::slice(int offset, int length)
+{
+    PacketBuffer p(*this);
+
+    if (offset < 0)
+        offset = 0;
+
+    if (offset > size)
+        offset = size;
+
+    if (length < 0)
+        length = 0;
+
+    if (length > size - offset)
+        length = size - offset;
+
+    p.offset = this->offset + offset;
+    p.size = length;
+
+    return p;
+}
+
+/**
+  * Determines the number of bytes that may be prepended to this buffer without copying it.
+  *
+  * @return The number of bytes available before the start of this buffer.
+  */
+int PacketBuffer::getHeadroom()
+{
+    return offset;
+}
+
+/**
+  * Extends this buffer by the given number of bytes at its start, to hold a header. The headroom
+  * before the buffer is used if there is enough. Otherwise, the buffer is copied into a new payload,
+  * which is no longer shared with any other PacketBuffer.
+  *
+  * @param length The number of bytes to add.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if length is negative, or the buffer would exceed 255 bytes.
+  *
+  * @code
+  * PacketBuffer p(16, 2);
+  * p.prepend(2);           // p is now 18 bytes long, without any copy.
+  * p[0] = 0x42;
+  * @endcode
+  */
+int PacketBuffer::prepend(int length)
+{
+    if (length < 0 || size + length > 255)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (length <= offset)
+    {
+        offset -= length;
+        size += length;
+        return MICROBIT_OK;
+    }
+
+    PacketData *old = ptr;
+    uint8_t *data = ptr->payload + offset;
+    int oldSize = size;
+
+    ptr = (PacketData *) malloc(sizeof(PacketData) + length + oldSize);
+    ptr->init();
+    ptr->length = length + oldSize;
+    ptr->rssi = old->rssi;
+
+    memcpy(ptr->payload + length, data, oldSize);
+
+    offset = 0;
+    size = length + oldSize;
+
+    old->decr();
+
+    return MICROBIT_OK;
+}